@@ -16,6 +16,8 @@
 #include "auo_video.h"
 #include "auo_frm.h"
 #include "convert.h"
+#include "convert_csp.h"
+#include "rgy_util.h"
 
 //音声の16bit->8bit変換の選択
 func_audio_16to8 get_audio_16to8_func(BOOL split) {
@@ -64,6 +66,37 @@ static const int BIT16 = 16;
 
 #define ENABLE_NV12 1
 
+//YC48からの変換は、NVEncCoreの変換関数(convert_csp)を行方向に分割して並列に実行する
+//SIMD関数の選択はNVEncCore側で行う
+static RGYConvertCSP g_convert_yc48;
+
+static void convert_yc48_core(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height, int interlaced) {
+    const int pixel_size = (RGY_CSP_BIT_DEPTH[g_convert_yc48.getFunc()->csp_to] > 8) ? sizeof(short) : sizeof(BYTE);
+    void *dst[3] = { pixel_data->data[0], pixel_data->data[1], pixel_data->data[2] };
+    const void *src[3] = { frame, nullptr, nullptr };
+    int crop[4] = { 0 };
+    g_convert_yc48.run(interlaced, dst, src, width, width * (int)sizeof(PIXEL_YC), width * (int)sizeof(PIXEL_YC), width * pixel_size, height, height, crop);
+}
+static void convert_yc48_core_p(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
+    convert_yc48_core(frame, pixel_data, width, height, 0);
+}
+static void convert_yc48_core_i(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
+    convert_yc48_core(frame, pixel_data, width, height, 1);
+}
+
+static RGY_CSP yc48_core_output_csp(const COVERT_FUNC_INFO *func_info) {
+    if (func_info->input_from_aviutl != CF_YC48
+        || (func_info->func != convert_yc48_core_p && func_info->func != convert_yc48_core_i)) {
+        return RGY_CSP_NA;
+    }
+    switch (func_info->output_csp) {
+    case OUT_CSP_NV12:   return (func_info->bit_depth > 8) ? RGY_CSP_P010      : RGY_CSP_NA;
+    case OUT_CSP_NV16:   return (func_info->bit_depth > 8) ? RGY_CSP_P210      : RGY_CSP_NA;
+    case OUT_CSP_YUV444: return (func_info->bit_depth > 8) ? RGY_CSP_YUV444_16 : RGY_CSP_YUV444;
+    default:             return RGY_CSP_NA;
+    }
+}
+
 //変換関数のテーブル
 //上からチェックするので、より厳しい条件で速い関数を上に書くこと
 static const COVERT_FUNC_INFO FUNC_TABLE[] = {
@@ -101,45 +134,15 @@ static const COVERT_FUNC_INFO FUNC_TABLE[] = {
 #endif
 #if ENABLE_NV12
     //YC48 -> nv12 (16bit)
-    { CF_YC48, OUT_CSP_NV12,   BIT16, P,  1,  AVX2|AVX,             convert_yc48_to_nv12_16bit_avx2 },
-    { CF_YC48, OUT_CSP_NV12,   BIT16, P,  1,  AVX|SSE41|SSSE3|SSE2, convert_yc48_to_nv12_16bit_avx },
-    { CF_YC48, OUT_CSP_NV12,   BIT16, P,  8,  SSE41|SSSE3|SSE2,     convert_yc48_to_nv12_16bit_sse41_mod8 },
-    { CF_YC48, OUT_CSP_NV12,   BIT16, P,  1,  SSE41|SSSE3|SSE2,     convert_yc48_to_nv12_16bit_sse41 },
-    { CF_YC48, OUT_CSP_NV12,   BIT16, P,  8,  SSSE3|SSE2,           convert_yc48_to_nv12_16bit_ssse3_mod8 },
-    { CF_YC48, OUT_CSP_NV12,   BIT16, P,  1,  SSSE3|SSE2,           convert_yc48_to_nv12_16bit_ssse3 },
-    { CF_YC48, OUT_CSP_NV12,   BIT16, P,  8,  SSE2,                 convert_yc48_to_nv12_16bit_sse2_mod8 },
-    { CF_YC48, OUT_CSP_NV12,   BIT16, P,  1,  SSE2,                 convert_yc48_to_nv12_16bit_sse2 },
+    { CF_YC48, OUT_CSP_NV12,   BIT16, P,  1,  SSE2,                 convert_yc48_core_p },
     { CF_YC48, OUT_CSP_NV12,   BIT16, P,  1,  NONE,                 convert_yc48_to_nv12_16bit },
 
-    { CF_YC48, OUT_CSP_NV12,   BIT16, I,  1,  AVX2|AVX,             convert_yc48_to_nv12_i_16bit_avx2 },
-    { CF_YC48, OUT_CSP_NV12,   BIT16, I,  1,  AVX|SSE41|SSSE3|SSE2, convert_yc48_to_nv12_i_16bit_avx },
-    { CF_YC48, OUT_CSP_NV12,   BIT16, I,  8,  SSE41|SSSE3|SSE2,     convert_yc48_to_nv12_i_16bit_sse41_mod8 },
-    { CF_YC48, OUT_CSP_NV12,   BIT16, I,  1,  SSE41|SSSE3|SSE2,     convert_yc48_to_nv12_i_16bit_sse41 },
-    { CF_YC48, OUT_CSP_NV12,   BIT16, I,  8,  SSSE3|SSE2,           convert_yc48_to_nv12_i_16bit_ssse3_mod8 },
-    { CF_YC48, OUT_CSP_NV12,   BIT16, I,  1,  SSSE3|SSE2,           convert_yc48_to_nv12_i_16bit_ssse3 },
-    { CF_YC48, OUT_CSP_NV12,   BIT16, I,  8,  SSE2,                 convert_yc48_to_nv12_i_16bit_sse2_mod8 },
-    { CF_YC48, OUT_CSP_NV12,   BIT16, I,  1,  SSE2,                 convert_yc48_to_nv12_i_16bit_sse2 },
+    { CF_YC48, OUT_CSP_NV12,   BIT16, I,  1,  SSE2,                 convert_yc48_core_i },
     { CF_YC48, OUT_CSP_NV12,   BIT16, I,  1,  NONE,                 convert_yc48_to_nv12_i_16bit },
 #else
     //YC48 -> yv12 (16bit)
-    { CF_YC48, OUT_CSP_YV12,   BIT16, P,  1,  AVX2|AVX,             convert_yc48_to_yv12_16bit_avx2 },
-    { CF_YC48, OUT_CSP_YV12,   BIT16, P,  1,  AVX|SSE41|SSSE3|SSE2, convert_yc48_to_yv12_16bit_avx },
-    { CF_YC48, OUT_CSP_YV12,   BIT16, P,  8,  SSE41|SSSE3|SSE2,     convert_yc48_to_yv12_16bit_sse41_mod8 },
-    { CF_YC48, OUT_CSP_YV12,   BIT16, P,  1,  SSE41|SSSE3|SSE2,     convert_yc48_to_yv12_16bit_sse41 },
-    { CF_YC48, OUT_CSP_YV12,   BIT16, P,  8,  SSSE3|SSE2,           convert_yc48_to_yv12_16bit_ssse3_mod8 },
-    { CF_YC48, OUT_CSP_YV12,   BIT16, P,  1,  SSSE3|SSE2,           convert_yc48_to_yv12_16bit_ssse3 },
-    { CF_YC48, OUT_CSP_YV12,   BIT16, P,  8,  SSE2,                 convert_yc48_to_yv12_16bit_sse2_mod8 },
-    { CF_YC48, OUT_CSP_YV12,   BIT16, P,  1,  SSE2,                 convert_yc48_to_yv12_16bit_sse2 },
     { CF_YC48, OUT_CSP_YV12,   BIT16, P,  1,  NONE,                 convert_yc48_to_yv12_16bit },
 
-    { CF_YC48, OUT_CSP_YV12,   BIT16, I,  1,  AVX2|AVX,             convert_yc48_to_yv12_i_16bit_avx2 },
-    { CF_YC48, OUT_CSP_YV12,   BIT16, I,  1,  AVX|SSE41|SSSE3|SSE2, convert_yc48_to_yv12_i_16bit_avx },
-    { CF_YC48, OUT_CSP_YV12,   BIT16, I,  8,  SSE41|SSSE3|SSE2,     convert_yc48_to_yv12_i_16bit_sse41_mod8 },
-    { CF_YC48, OUT_CSP_YV12,   BIT16, I,  1,  SSE41|SSSE3|SSE2,     convert_yc48_to_yv12_i_16bit_sse41 },
-    { CF_YC48, OUT_CSP_YV12,   BIT16, I,  8,  SSSE3|SSE2,           convert_yc48_to_yv12_i_16bit_ssse3_mod8 },
-    { CF_YC48, OUT_CSP_YV12,   BIT16, I,  1,  SSSE3|SSE2,           convert_yc48_to_yv12_i_16bit_ssse3 },
-    { CF_YC48, OUT_CSP_YV12,   BIT16, I,  8,  SSE2,                 convert_yc48_to_yv12_i_16bit_sse2_mod8 },
-    { CF_YC48, OUT_CSP_YV12,   BIT16, I,  1,  SSE2,                 convert_yc48_to_yv12_i_16bit_sse2 },
     { CF_YC48, OUT_CSP_YV12,   BIT16, I,  1,  NONE,                 convert_yc48_to_yv12_i_16bit },
 
     //YC48 -> yv12 (10bit)
@@ -154,38 +157,21 @@ static const COVERT_FUNC_INFO FUNC_TABLE[] = {
     { CF_YUY2, OUT_CSP_NV16,   BIT_8, A,  1,  SSE2,                 convert_yuy2_to_nv16_sse2 },
     { CF_YUY2, OUT_CSP_NV16,   BIT_8, A,  1,  NONE,                 convert_yuy2_to_nv16 },
     //YC48 -> nv16(16bit)
-    { CF_YC48, OUT_CSP_NV16,   BIT16, A,  1,  AVX2|AVX,             convert_yc48_to_nv16_16bit_avx2 },
-    { CF_YC48, OUT_CSP_NV16,   BIT16, A,  1,  AVX|SSE41|SSSE3|SSE2, convert_yc48_to_nv16_16bit_avx },
-    { CF_YC48, OUT_CSP_NV16,   BIT16, A,  8,  SSE41|SSSE3|SSE2,     convert_yc48_to_nv16_16bit_sse41_mod8 },
-    { CF_YC48, OUT_CSP_NV16,   BIT16, A,  1,  SSE41|SSSE3|SSE2,     convert_yc48_to_nv16_16bit_sse41 },
-    { CF_YC48, OUT_CSP_NV16,   BIT16, A,  8,  SSSE3|SSE2,           convert_yc48_to_nv16_16bit_ssse3_mod8 },
-    { CF_YC48, OUT_CSP_NV16,   BIT16, A,  1,  SSSE3|SSE2,           convert_yc48_to_nv16_16bit_ssse3 },
-    { CF_YC48, OUT_CSP_NV16,   BIT16, A,  8,  SSE2,                 convert_yc48_to_nv16_16bit_sse2_mod8 },
-    { CF_YC48, OUT_CSP_NV16,   BIT16, A,  1,  SSE2,                 convert_yc48_to_nv16_16bit_sse2 },
+    { CF_YC48, OUT_CSP_NV16,   BIT16, A,  1,  SSE2,                 convert_yc48_core_p },
     { CF_YC48, OUT_CSP_NV16,   BIT16, A,  1,  NONE,                 convert_yc48_to_nv16_16bit },
 #else
     //YUY2 -> yuv422(8bit)
     { CF_YUY2, OUT_CSP_YUV422, BIT_8, A,  1,  NONE,                 convert_yuy2_to_yuv422 },
 #endif
     //YC48 -> yuv444(8bit)
-    { CF_YC48, OUT_CSP_YUV444, BIT_8, A,  1,  AVX2|AVX,             convert_yc48_to_yuv444_avx2 },
-    { CF_YC48, OUT_CSP_YUV444, BIT_8, A,  1,  AVX|SSE41|SSSE3|SSE2, convert_yc48_to_yuv444_avx },
-    { CF_YC48, OUT_CSP_YUV444, BIT_8, A, 16,  SSE41|SSSE3|SSE2,     convert_yc48_to_yuv444_sse41_mod16 },
-    { CF_YC48, OUT_CSP_YUV444, BIT_8, A,  1,  SSE41|SSSE3|SSE2,     convert_yc48_to_yuv444_sse41 },
-    { CF_YC48, OUT_CSP_YUV444, BIT_8, A, 16,  SSE2,                 convert_yc48_to_yuv444_sse2_mod16 },
-    { CF_YC48, OUT_CSP_YUV444, BIT_8, A,  1,  SSE2,                 convert_yc48_to_yuv444_sse2 },
+    { CF_YC48, OUT_CSP_YUV444, BIT_8, A,  1,  SSE2,                 convert_yc48_core_p },
     { CF_YC48, OUT_CSP_YUV444, BIT_8, A,  1,  NONE,                 convert_yc48_to_yuv444 },
     
     //YC48 -> yuv444(10bit)
     { CF_YC48, OUT_CSP_YUV444, BIT10, A,  1,  NONE,                 convert_yc48_to_yuv444_10bit },
 
     //YC48 -> yuv444(16bit)
-    { CF_YC48, OUT_CSP_YUV444, BIT16, A,  1,  AVX2|AVX,             convert_yc48_to_yuv444_16bit_avx2 },
-    { CF_YC48, OUT_CSP_YUV444, BIT16, A,  1,  AVX|SSE41|SSSE3|SSE2, convert_yc48_to_yuv444_16bit_avx },
-    { CF_YC48, OUT_CSP_YUV444, BIT16, A,  8,  SSE41|SSSE3|SSE2,     convert_yc48_to_yuv444_16bit_sse41_mod8 },
-    { CF_YC48, OUT_CSP_YUV444, BIT16, A,  1,  SSE41|SSSE3|SSE2,     convert_yc48_to_yuv444_16bit_sse41 },
-    { CF_YC48, OUT_CSP_YUV444, BIT16, A,  8,  SSE2,                 convert_yc48_to_yuv444_16bit_sse2_mod8 },
-    { CF_YC48, OUT_CSP_YUV444, BIT16, A,  1,  SSE2,                 convert_yc48_to_yuv444_16bit_sse2 },
+    { CF_YC48, OUT_CSP_YUV444, BIT16, A,  1,  SSE2,                 convert_yc48_core_p },
     { CF_YC48, OUT_CSP_YUV444, BIT16, A,  1,  NONE,                 convert_yc48_to_yuv444_16bit },
 
     //Copy RGB
@@ -211,7 +197,12 @@ static void build_simd_info(DWORD simd, char *buf, DWORD nSize) {
 
 static void auo_write_func_info(const COVERT_FUNC_INFO *func_info) {
     char simd_buf[128];
-    build_simd_info(func_info->SIMD, simd_buf, _countof(simd_buf));
+    if (yc48_core_output_csp(func_info) != RGY_CSP_NA) {
+        sprintf_s(simd_buf, _countof(simd_buf), ", using %s, %d thread(s)",
+            tchar_to_string(get_simd_str(g_convert_yc48.getFunc()->simd)).c_str(), g_convert_yc48.threads());
+    } else {
+        build_simd_info(func_info->SIMD, simd_buf, _countof(simd_buf));
+    }
 
     if (func_info->output_csp == OUT_CSP_YUY2) {
         write_log_auo_line_fmt(LOG_INFO, "Passing YUY2", simd_buf);
@@ -250,6 +241,11 @@ static void auo_write_func_info(const COVERT_FUNC_INFO *func_info) {
 #pragma warning( push )
 #pragma warning( disable: 4189 )
 //使用する関数を選択する
+//DLLアンロード時(ローダーロック中)にスレッドの終了待ちをしないよう、出力終了時に明示的に解放する
+void release_convert_func() {
+    g_convert_yc48.close();
+}
+
 func_convert_frame get_convert_func(int width, int input_csp, int bit_depth, BOOL interlaced, int output_csp) {
     const DWORD availableSIMD = get_availableSIMD();
 
@@ -268,6 +264,10 @@ func_convert_frame get_convert_func(int width, int input_csp, int bit_depth, BOO
             continue;
         if ((FUNC_TABLE[i].SIMD & availableSIMD) != FUNC_TABLE[i].SIMD)
             continue;
+        const RGY_CSP core_csp = yc48_core_output_csp(&FUNC_TABLE[i]);
+        if (core_csp != RGY_CSP_NA
+            && g_convert_yc48.getFunc(RGY_CSP_YC48, core_csp, false) == nullptr)
+            continue;
 
         func_info = &FUNC_TABLE[i];
         break;
@@ -281,15 +281,55 @@ func_convert_frame get_convert_func(int width, int input_csp, int bit_depth, BOO
 }
 #pragma warning( pop )
 
-BOOL malloc_pixel_data(CONVERT_CF_DATA * const pixel_data, int width, int height, int output_csp, int bit_depth) {
-    BOOL ret = TRUE;
+DWORD get_pixel_data_plane_size(int width, int height, int bit_depth) {
     const int to_yv12 = FALSE; // (output_csp == OUT_CSP_YV12);
     const DWORD pixel_size = (bit_depth > 8) ? sizeof(short) : sizeof(BYTE);
     const DWORD simd_check = get_availableSIMD();
     const DWORD align_size = (simd_check & AUO_SIMD_SSE2) ? ((simd_check & AUO_SIMD_AVX2) ? (32<<to_yv12) : (16<<to_yv12)) : 1;
 #define ALIGN_NEXT(i, align) (((i) + (align-1)) & (~(align-1))) //alignは2の累乗(1,2,4,8,16,32...)
-    const DWORD frame_size = ALIGN_NEXT(width * height * pixel_size + (ALIGN_NEXT(width, align_size / pixel_size) - width) * 2 * pixel_size, align_size);
+    return ALIGN_NEXT(width * height * pixel_size + (ALIGN_NEXT(width, align_size / pixel_size) - width) * 2 * pixel_size, align_size);
 #undef ALIGN_NEXT
+}
+
+DWORD get_pixel_data_size(int width, int height, int output_csp, int bit_depth) {
+    const DWORD frame_size = get_pixel_data_plane_size(width, height, bit_depth);
+    switch (output_csp) {
+        case OUT_CSP_YUY2:
+        case OUT_CSP_NV16:   return frame_size * 2;
+        case OUT_CSP_YUV444:
+        case OUT_CSP_RGB:    return frame_size * 3;
+        case OUT_CSP_NV12:
+        default:             return frame_size * 3 / 2;
+    }
+}
+
+//bufはmalloc_pixel_dataと同じアライメントで、get_pixel_data_size()以上の大きさであること
+void set_pixel_data_ptr(CONVERT_CF_DATA * const pixel_data, BYTE *buf, int width, int height, int output_csp, int bit_depth) {
+    const DWORD frame_size = get_pixel_data_plane_size(width, height, bit_depth);
+    ZeroMemory(pixel_data->data, sizeof(pixel_data->data));
+    pixel_data->data[0] = buf;
+    switch (output_csp) {
+        case OUT_CSP_YUY2:
+        case OUT_CSP_RGB:
+            break;
+        case OUT_CSP_YUV444:
+            pixel_data->data[1] = pixel_data->data[0] + frame_size;
+            pixel_data->data[2] = pixel_data->data[1] + frame_size;
+            break;
+        case OUT_CSP_NV16:
+        case OUT_CSP_NV12:
+        default:
+            pixel_data->data[1] = pixel_data->data[0] + frame_size;
+            break;
+    }
+}
+
+BOOL malloc_pixel_data(CONVERT_CF_DATA * const pixel_data, int width, int height, int output_csp, int bit_depth) {
+    BOOL ret = TRUE;
+    const int to_yv12 = FALSE; // (output_csp == OUT_CSP_YV12);
+    const DWORD simd_check = get_availableSIMD();
+    const DWORD align_size = (simd_check & AUO_SIMD_SSE2) ? ((simd_check & AUO_SIMD_AVX2) ? (32<<to_yv12) : (16<<to_yv12)) : 1;
+    const DWORD frame_size = get_pixel_data_plane_size(width, height, bit_depth);
 
     ZeroMemory(pixel_data->data, sizeof(pixel_data->data));
     switch (output_csp) {
@@ -58,6 +58,7 @@
 #include "auo_convert.h"
 #include "auo_video.h"
 #include "auo_audio_parallel.h"
+#include "rgy_frame_shm.h"
 
 #include "NVEncParam.h"
 #include "NVEncCmd.h"
@@ -203,7 +204,32 @@ static void build_full_cmd(char *cmd, size_t nSize, const CONF_GUIEX *conf, cons
     //出力ファイル
     sprintf_s(cmd + strlen(cmd), nSize - strlen(cmd), " -o \"%s\"", pe->temp_filename);
     //入力
-    sprintf_s(cmd + strlen(cmd), nSize - strlen(cmd), " --y4m -i -");
+    if (0 == strcmp(input, PIPE_FN)) {
+        sprintf_s(cmd + strlen(cmd), nSize - strlen(cmd), " --y4m -i -");
+    } else {
+        sprintf_s(cmd + strlen(cmd), nSize - strlen(cmd), " --shm -i \"%s\"", input);
+    }
+}
+
+//共有メモリでの映像受け渡しを準備する
+//  スロットにはconvert_frameの出力をそのまま書き込むので、malloc_pixel_dataと同じ配置とする
+static RGY_ERR video_output_create_shm(RGYFrameShm *frame_shm, const OUTPUT_INFO *oip, int output_csp, bool output_highbit_depth, RGY_CSP rgy_output_csp, RGY_PICSTRUCT picstruct) {
+    const int bit_depth = (output_highbit_depth) ? 16 : 8;
+    const DWORD plane_size = get_pixel_data_plane_size(oip->w, oip->h, bit_depth);
+    RGYFrameShmInfo info = { 0 };
+    info.width  = oip->w;
+    info.height = oip->h;
+    info.csp    = rgy_output_csp;
+    info.picstruct = picstruct;
+    info.fpsN   = oip->rate;
+    info.fpsD   = oip->scale;
+    info.frames = oip->n;
+    info.pitch  = oip->w * ((output_highbit_depth) ? (int)sizeof(short) : (int)sizeof(BYTE));
+    info.planeOffset[0] = 0;
+    info.planeOffset[1] = plane_size;
+    info.planeOffset[2] = (output_csp == OUT_CSP_YUV444) ? plane_size * 2 : 0;
+    info.frameSize = get_pixel_data_size(oip->w, oip->h, output_csp, bit_depth);
+    return frame_shm->create(RGYFrameShm::genName(_T("NVEncAuo")), info, RGY_FRAME_SHM_SLOTS_DEFAULT);
 }
 
 static void set_pixel_data(CONVERT_CF_DATA *pixel_data, const CONF_GUIEX *conf, int w, int h, bool output_highbit_depth, RGY_CSP rgy_output_csp) {
@@ -444,21 +470,31 @@ static DWORD video_output_inside(CONF_GUIEX *conf, const OUTPUT_INFO *oip, PRM_E
         ret |= AUO_RESULT_ERROR; error_select_convert_func(oip->w, oip->h, output_highbit_depth, interlaced, output_csp);
         return ret;
     }
-    //映像バッファ用メモリ確保
-    if (!malloc_pixel_data(&pixel_data, oip->w, oip->h, output_csp, (output_highbit_depth) ? 16 : 8)) {
+    //共有メモリでの受け渡しを準備、失敗したらパイプを使用する
+    RGYFrameShm frame_shm;
+    bool use_shm = false;
+    if (sys_dat->exstg->s_local.video_shm_transfer) {
+        use_shm = RGY_ERR_NONE == video_output_create_shm(&frame_shm, oip, output_csp, output_highbit_depth, rgy_output_csp, (interlaced) ? enc_prm.input.picstruct : RGY_PICSTRUCT_FRAME);
+        if (!use_shm) {
+            warning_video_shm_failed();
+        }
+    }
+    //映像バッファ用メモリ確保 (共有メモリ使用時はスロットを直接映像バッファとする)
+    if (!use_shm && !malloc_pixel_data(&pixel_data, oip->w, oip->h, output_csp, (output_highbit_depth) ? 16 : 8)) {
         ret |= AUO_RESULT_ERROR; error_malloc_pixel_data();
+        release_convert_func();
         return ret;
     }
 
     //コマンドライン生成
-    build_full_cmd(exe_cmd, _countof(exe_cmd), conf, &enc_prm, oip, pe, sys_dat, PIPE_FN);
+    build_full_cmd(exe_cmd, _countof(exe_cmd), conf, &enc_prm, oip, pe, sys_dat, (use_shm) ? frame_shm.name().c_str() : PIPE_FN);
     write_log_auo_line(LOG_INFO, "NVEncC options...");
     write_args(exe_cmd);
     sprintf_s(exe_args, _countof(exe_args), "\"%s\" %s", sys_dat->exstg->s_vid.fullpath, exe_cmd);
     remove(pe->temp_filename); //ファイルサイズチェックの時に旧ファイルを参照してしまうのを回避
 
     //パイプの設定
-    pipes.stdIn.mode = AUO_PIPE_ENABLE;
+    pipes.stdIn.mode = (use_shm) ? AUO_PIPE_DISABLE : AUO_PIPE_ENABLE;
     pipes.stdErr.mode = AUO_PIPE_ENABLE;
     pipes.stdIn.bufferSize = pixel_data.total_size * 2;
     
@@ -482,15 +518,22 @@ static DWORD video_output_inside(CONF_GUIEX *conf, const OUTPUT_INFO *oip, PRM_E
     } else if ((rp_ret = RunProcess(exe_args, exe_dir, &pi_enc, &pipes, GetPriorityClass(pe->h_p_aviutl), TRUE, FALSE)) != RP_SUCCESS) {
         ret |= AUO_RESULT_ERROR; error_run_process("NVEncC", rp_ret);
         //書き込みスレッドを開始
-    } else if (video_output_create_thread(&thread_data, &pixel_data, pipes.f_stdin)) {
+    } else if (!use_shm && video_output_create_thread(&thread_data, &pixel_data, pipes.f_stdin)) {
         ret |= AUO_RESULT_ERROR; error_video_output_thread_start();
     } else {
         //全て正常
+        if (use_shm) {
+            //NVEncCが共有メモリを開く前に終了した場合も、待機を打ち切れるようにする
+            frame_shm.setPeerProcess(pi_enc.dwProcessId);
+        }
         int i = 0;
         void *frame = NULL;
         int *next_jitter = NULL;
         bool enc_pause = false;
         BOOL copy_frame = false, drop = false;
+        RGYFrameShmSlot *shm_slot = nullptr;
+        uint8_t *shm_data = nullptr;
+        const uint8_t *shm_data_prev = nullptr;
         const DWORD aviutl_color_fmt = COLORFORMATS[get_aviutl_color_format(output_highbit_depth, rgy_output_csp)].FOURCC;
 
         //Aviutlの時間を取得
@@ -501,7 +544,8 @@ static DWORD video_output_inside(CONF_GUIEX *conf, const OUTPUT_INFO *oip, PRM_E
         while (WaitForInputIdle(pi_enc.hProcess, LOG_UPDATE_INTERVAL) == WAIT_TIMEOUT)
             log_process_events();
 
-        write_y4m_header(pipes.f_stdin, oip, rgy_output_csp);
+        if (!use_shm)
+            write_y4m_header(pipes.f_stdin, oip, rgy_output_csp);
 
         //ログウィンドウ側から制御を可能に
         DWORD tm_vid_enc_start = timeGetTime();
@@ -535,11 +579,28 @@ static DWORD video_output_inside(CONF_GUIEX *conf, const OUTPUT_INFO *oip, PRM_E
                 log_process_events();
             }
 
-            //標準入力への書き込み完了をチェック
-            while (WAIT_TIMEOUT == WaitForSingleObject(thread_data.he_out_fin, LOG_UPDATE_INTERVAL)) {
-                ret |= (oip->func_is_abort()) ? AUO_RESULT_ABORT : AUO_RESULT_SUCCESS;
-                ReadLogEnc(&pipes, pe->drop_count, i);
-                log_process_events();
+            if (use_shm) {
+                //共有メモリの空きスロットを取得 (ドロップしたフレームのスロットは取得済みのまま再利用する)
+                RGY_ERR shm_err = RGY_ERR_NONE;
+                while (nullptr == shm_slot
+                    && RGY_WRN_DEVICE_BUSY == (shm_err = frame_shm.acquireWrite(&shm_slot, &shm_data, LOG_UPDATE_INTERVAL))
+                    && !ret) {
+                    ret |= (oip->func_is_abort()) ? AUO_RESULT_ABORT : AUO_RESULT_SUCCESS;
+                    ReadLogEnc(&pipes, pe->drop_count, i);
+                    log_process_events();
+                }
+                if (shm_err != RGY_ERR_NONE && shm_err != RGY_WRN_DEVICE_BUSY) {
+                    //NVEncCが終了した
+                    ret |= AUO_RESULT_ERROR; error_x264_dead();
+                    break;
+                }
+            } else {
+                //標準入力への書き込み完了をチェック
+                while (WAIT_TIMEOUT == WaitForSingleObject(thread_data.he_out_fin, LOG_UPDATE_INTERVAL)) {
+                    ret |= (oip->func_is_abort()) ? AUO_RESULT_ABORT : AUO_RESULT_SUCCESS;
+                    ReadLogEnc(&pipes, pe->drop_count, i);
+                    log_process_events();
+                }
             }
 
             //中断・エラー等をチェック
@@ -557,7 +618,27 @@ static DWORD video_output_inside(CONF_GUIEX *conf, const OUTPUT_INFO *oip, PRM_E
 
             drop |= (afs & copy_frame);
 
-            if (!drop) {
+            if (use_shm) {
+                if (!drop) {
+                    //スロットに直接変換する、コピーフレームの場合は前のスロットの中身をコピーする
+                    if (copy_frame && shm_data_prev) {
+                        memcpy(shm_data, shm_data_prev, frame_shm.info()->frameSize);
+                    } else {
+                        set_pixel_data_ptr(&pixel_data, shm_data, oip->w, oip->h, output_csp, (output_highbit_depth) ? 16 : 8);
+                        convert_frame(frame, &pixel_data, oip->w, oip->h);  /// YUY2/YC48->NV12/YUV444変換, RGBコピー
+                    }
+                    shm_slot->pts = i - pe->drop_count;
+                    shm_slot->duration = 1;
+                    shm_slot->picstruct = frame_shm.info()->picstruct;
+                    shm_slot->frameIdx = i;
+                    shm_data_prev = shm_data;
+                    frame_shm.submitWrite();
+                    shm_slot = nullptr;
+                } else {
+                    *(next_jitter - 1) = DROP_FRAME_FLAG;
+                    pe->drop_count++;
+                }
+            } else if (!drop) {
                 //コピーフレームの場合は、映像バッファの中身を更新せず、そのままパイプに流す
                 if (!copy_frame)
                     convert_frame(frame, &pixel_data, oip->w, oip->h);  /// YUY2/YC48->NV12/YUV444変換, RGBコピー
@@ -579,6 +660,20 @@ static DWORD video_output_inside(CONF_GUIEX *conf, const OUTPUT_INFO *oip, PRM_E
 
         //書き込みスレッドを終了
         video_output_close_thread(&thread_data, ret);
+        //変換用スレッドを終了
+        release_convert_func();
+
+        if (use_shm) {
+            //入力の終了を通知、中断・エラー時はNVEncCにも中断を通知する
+            RGY_ERR shm_err = RGY_WRN_DEVICE_BUSY;
+            while (!ret && RGY_WRN_DEVICE_BUSY == (shm_err = frame_shm.finish(LOG_UPDATE_INTERVAL))) {
+                ret |= (oip->func_is_abort()) ? AUO_RESULT_ABORT : AUO_RESULT_SUCCESS;
+                ReadLogEnc(&pipes, pe->drop_count, i);
+                log_process_events();
+            }
+            if (ret || shm_err != RGY_ERR_NONE)
+                frame_shm.setAbort();
+        }
 
         //ログウィンドウからのx264制御を無効化
         disable_enc_control();
@@ -37,24 +37,3 @@ void convert_yuy2_to_nv16_avx(void *frame, CONVERT_CF_DATA *pixel_data, const in
     return convert_yuy2_to_nv16_simd<FALSE>(frame, pixel_data, width, height);
 }
 
-void convert_yc48_to_nv12_16bit_avx(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    return convert_yc48_to_nv12_16bit_simd<FALSE>(frame, pixel_data, width, height);
-}
-void convert_yc48_to_nv12_i_16bit_avx(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    return convert_yc48_to_nv12_i_16bit_simd<FALSE>(frame, pixel_data, width, height);
-}
-void convert_yc48_to_yv12_16bit_avx(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    return convert_yc48_to_yv12_16bit_simd<FALSE>(frame, pixel_data, width, height);
-}
-void convert_yc48_to_yv12_i_16bit_avx(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    return convert_yc48_to_yv12_i_16bit_simd<FALSE>(frame, pixel_data, width, height);
-}
-void convert_yc48_to_nv16_16bit_avx(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    return convert_yc48_to_nv16_16bit_simd<FALSE>(frame, pixel_data, width, height);
-}
-void convert_yc48_to_yuv444_avx(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    return convert_yc48_to_yuv444_simd<FALSE>(frame, pixel_data, width, height);
-}
-void convert_yc48_to_yuv444_16bit_avx(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    return convert_yc48_to_yuv444_16bit_simd<FALSE>(frame, pixel_data, width, height);
-}
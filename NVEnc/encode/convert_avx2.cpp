@@ -347,399 +347,6 @@ void convert_yuy2_to_yv12_i_avx2(void *frame, CONVERT_CF_DATA *pixel_data, const
     _mm256_zeroupper();
 }
 
-static __forceinline void gather_y_uv_from_yc48(__m256i& y0, __m256i& y1, __m256i y2) {
-    const int MASK_INT_Y  = 0x80 + 0x10 + 0x02;
-    const int MASK_INT_UV = 0x40 + 0x20 + 0x01;
-    __m256i y3 = y0;
-    __m256i y4 = y1;
-    __m256i y5 = y2;
-            
-    y0 = _mm256_blend_epi32(y3, y4, 0xf0);                    // 384, 0
-    y1 = _mm256_permute2x128_si256(y3, y5, (0x02<<4) + 0x01); // 512, 128
-    y2 = _mm256_blend_epi32(y4, y5, 0xf0);                    // 640, 256
-
-    y3 = _mm256_blend_epi16(y0, y1, MASK_INT_Y);
-    y3 = _mm256_blend_epi16(y3, y2, MASK_INT_Y>>2);
-
-    y1 = _mm256_blend_epi16(y0, y1, MASK_INT_UV);
-    y1 = _mm256_blend_epi16(y1, y2, MASK_INT_UV>>2);
-    y1 = _mm256_alignr_epi8(y1, y1, 2);
-    y1 = _mm256_shuffle_epi32(y1, _MM_SHUFFLE(1, 2, 3, 0));//UV1行目
-
-    y0 = _mm256_shuffle_epi8(y3, yC_SUFFLE_YCP_Y);
-}
-
-static __forceinline __m256i convert_y_range_from_yc48(__m256i y0, __m256i yC_Y_MA_16, int Y_RSH_16, const __m256i& yC_YCC, const __m256i& yC_pw_one) {
-    __m256i y7;
-
-    y7 = _mm256_unpackhi_epi16(y0, yC_pw_one);
-    y0 = _mm256_unpacklo_epi16(y0, yC_pw_one);
-
-    y0 = _mm256_madd_epi16(y0, yC_Y_MA_16);
-    y7 = _mm256_madd_epi16(y7, yC_Y_MA_16);
-    y0 = _mm256_srai_epi32(y0, Y_RSH_16);
-    y7 = _mm256_srai_epi32(y7, Y_RSH_16);
-    y0 = _mm256_add_epi32(y0, yC_YCC);
-    y7 = _mm256_add_epi32(y7, yC_YCC);
-
-    y0 = _mm256_packus_epi32(y0, y7);
-
-    return y0;
-}
-static __forceinline __m256i convert_uv_range_after_adding_offset(__m256i y0, const __m256i& yC_UV_MA_16, int UV_RSH_16, const __m256i& yC_YCC, const __m256i& yC_pw_one) {
-    __m256i y7;
-    y7 = _mm256_unpackhi_epi16(y0, yC_pw_one);
-    y0 = _mm256_unpacklo_epi16(y0, yC_pw_one);
-
-    y0 = _mm256_madd_epi16(y0, yC_UV_MA_16);
-    y7 = _mm256_madd_epi16(y7, yC_UV_MA_16);
-    y0 = _mm256_srai_epi32(y0, UV_RSH_16);
-    y7 = _mm256_srai_epi32(y7, UV_RSH_16);
-    y0 = _mm256_add_epi32(y0, yC_YCC);
-    y7 = _mm256_add_epi32(y7, yC_YCC);
-
-    y0 = _mm256_packus_epi32(y0, y7);
-
-    return y0;
-}
-static __forceinline __m256i convert_uv_range_from_yc48(__m256i y0, const __m256i& yC_UV_OFFSET_x1, const __m256i& yC_UV_MA_16, int UV_RSH_16, const __m256i& yC_YCC, const __m256i& yC_pw_one) {
-    y0 = _mm256_add_epi16(y0, yC_UV_OFFSET_x1);
-
-    return convert_uv_range_after_adding_offset(y0, yC_UV_MA_16, UV_RSH_16, yC_YCC, yC_pw_one);
-}
-static __forceinline __m256i convert_uv_range_from_yc48_yuv420p(__m256i y0, __m256i y1, const __m256i& yC_UV_OFFSET_x2, __m256i yC_UV_MA_16, int UV_RSH_16, const __m256i& yC_YCC, const __m256i& yC_pw_one) {
-    y0 = _mm256_add_epi16(y0, y1);
-    y0 = _mm256_add_epi16(y0, yC_UV_OFFSET_x2);
-
-    return convert_uv_range_after_adding_offset(y0, yC_UV_MA_16, UV_RSH_16, yC_YCC, yC_pw_one);
-}
-static __forceinline __m256i convert_uv_range_from_yc48_420i(__m256i y0, __m256i y1, const __m256i& yC_UV_OFFSET_x1, const __m256i& yC_UV_MA_16_0, const __m256i& yC_UV_MA_16_1, int UV_RSH_16, const __m256i& yC_YCC, const __m256i& yC_pw_one) {
-    __m256i y2, y3, y6, y7;
-
-    y0 = _mm256_add_epi16(y0, yC_UV_OFFSET_x1);
-    y1 = _mm256_add_epi16(y1, yC_UV_OFFSET_x1);
-
-    y7 = _mm256_unpackhi_epi16(y0, yC_pw_one);
-    y6 = _mm256_unpacklo_epi16(y0, yC_pw_one);
-    y3 = _mm256_unpackhi_epi16(y1, yC_pw_one);
-    y2 = _mm256_unpacklo_epi16(y1, yC_pw_one);
-
-    y6 = _mm256_madd_epi16(y6, yC_UV_MA_16_0);
-    y7 = _mm256_madd_epi16(y7, yC_UV_MA_16_0);
-    y2 = _mm256_madd_epi16(y2, yC_UV_MA_16_1);
-    y3 = _mm256_madd_epi16(y3, yC_UV_MA_16_1);
-    y0 = _mm256_add_epi32(y6, y2);
-    y7 = _mm256_add_epi32(y7, y3);
-    y0 = _mm256_srai_epi32(y0, UV_RSH_16);
-    y7 = _mm256_srai_epi32(y7, UV_RSH_16);
-    y0 = _mm256_add_epi32(y0, yC_YCC);
-    y7 = _mm256_add_epi32(y7, yC_YCC);
-
-    y0 = _mm256_packus_epi32(y0, y7);
-
-    return y0;
-}
-
-void convert_yc48_to_nv12_16bit_avx2(void *pixel, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    int x, y;
-    short *dst_Y = (short *)pixel_data->data[0];
-    short *dst_C = (short *)pixel_data->data[1];
-    short *ycp, *ycpw;
-    short *Y = NULL, *C = NULL;
-    const __m256i yC_pw_one = _mm256_set1_epi16(1);
-    const __m256i yC_YCC = _mm256_set1_epi32(1<<LSFT_YCC_16);
-    __m256i y0, y1, y2, y3;
-    for (y = 0; y < height; y += 2) {
-        ycp = (short*)pixel + width * y * 3;
-        ycpw= ycp + width*3;
-        Y   = (short*)dst_Y + width * y;
-        C   = (short*)dst_C + width * y / 2;
-        for (x = 0; x < width; x += 16, ycp += 48, ycpw += 48) {
-            y1 = _mm256_loadu_si256((__m256i *)(ycp +  0)); // 128, 0
-            y2 = _mm256_loadu_si256((__m256i *)(ycp + 16)); // 384, 256
-            y3 = _mm256_loadu_si256((__m256i *)(ycp + 32)); // 640, 512
-
-            gather_y_uv_from_yc48(y1, y2, y3);
-            y0 = y2;
-
-            _mm256_storeu_si256((__m256i *)(Y + x), convert_y_range_from_yc48(y1, yC_Y_L_MA_16, Y_L_RSH_16, yC_YCC, yC_pw_one));
-
-            y1 = _mm256_loadu_si256((__m256i *)(ycpw +  0));
-            y2 = _mm256_loadu_si256((__m256i *)(ycpw + 16));
-            y3 = _mm256_loadu_si256((__m256i *)(ycpw + 32));
-
-            gather_y_uv_from_yc48(y1, y2, y3);
-
-            _mm256_storeu_si256((__m256i *)(Y + x + width), convert_y_range_from_yc48(y1, yC_Y_L_MA_16, Y_L_RSH_16, yC_YCC, yC_pw_one));
-
-            _mm256_storeu_si256((__m256i *)(C + x), convert_uv_range_from_yc48_yuv420p(y0, y2,  _mm256_set1_epi16(UV_OFFSET_x2), yC_UV_L_MA_16_420P, UV_L_RSH_16_420P, yC_YCC, yC_pw_one));
-        }
-    }
-    _mm256_zeroupper();
-}
-
-void convert_yc48_to_nv12_i_16bit_avx2(void *pixel, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    int x, y, i;
-    short *dst_Y = (short *)pixel_data->data[0];
-    short *dst_C = (short *)pixel_data->data[1];
-    short *ycp, *ycpw;
-    short *Y = NULL, *C = NULL;
-    const __m256i yC_pw_one = _mm256_set1_epi16(1);
-    const __m256i yC_YCC = _mm256_set1_epi32(1<<LSFT_YCC_16);
-    __m256i y0, y1, y2, y3;
-    for (y = 0; y < height; y += 4) {
-        for (i = 0; i < 2; i++) {
-            ycp = (short*)pixel + width * (y + i) * 3;
-            ycpw= ycp + width*2*3;
-            Y   = (short*)dst_Y + width * (y + i);
-            C   = (short*)dst_C + width * (y + i*2) / 2;
-            for (x = 0; x < width; x += 16, ycp += 48, ycpw += 48) {
-                y1 = _mm256_loadu_si256((__m256i *)(ycp +  0)); // 128, 0
-                y2 = _mm256_loadu_si256((__m256i *)(ycp + 16)); // 384, 256
-                y3 = _mm256_loadu_si256((__m256i *)(ycp + 32)); // 640, 512
-
-                gather_y_uv_from_yc48(y1, y2, y3);
-                y0 = y2;
-
-                _mm256_storeu_si256((__m256i *)(Y + x), convert_y_range_from_yc48(y1, yC_Y_L_MA_16, Y_L_RSH_16, yC_YCC, yC_pw_one));
-
-                y1 = _mm256_loadu_si256((__m256i *)(ycpw +  0));
-                y2 = _mm256_loadu_si256((__m256i *)(ycpw + 16));
-                y3 = _mm256_loadu_si256((__m256i *)(ycpw + 32));
-
-                gather_y_uv_from_yc48(y1, y2, y3);
-
-                _mm256_storeu_si256((__m256i *)(Y + x + width*2), convert_y_range_from_yc48(y1, yC_Y_L_MA_16, Y_L_RSH_16, yC_YCC, yC_pw_one));
-
-                _mm256_storeu_si256((__m256i *)(C + x), convert_uv_range_from_yc48_420i(y0, y2, _mm256_set1_epi16(UV_OFFSET_x1), yC_UV_L_MA_16_420I(i), yC_UV_L_MA_16_420I((i+1)&0x01), UV_L_RSH_16_420I, yC_YCC, yC_pw_one));
-            }
-        }
-    }
-    _mm256_zeroupper();
-}
-
-void convert_yc48_to_yv12_16bit_avx2(void *pixel, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    int x, y;
-    short *dst_Y = (short *)pixel_data->data[0];
-    short *dst_U = (short *)pixel_data->data[1];
-    short *dst_V = (short *)pixel_data->data[2];
-    short *ycp, *ycpw;
-    short *Y = NULL, *U = NULL, *V = NULL;
-    const __m256i yC_pw_one = _mm256_set1_epi16(1);
-    const __m256i yC_YCC = _mm256_set1_epi32(1<<LSFT_YCC_16);
-    __m256i y0, y1, y2, y3, y4;
-    for (y = 0; y < height; y += 2) {
-        ycp = (short*)pixel + width * y * 3;
-        ycpw= ycp + width*3;
-        Y   = (short*)dst_Y + width * y;
-        U   = (short*)dst_U + width * y / 4;
-        V   = (short*)dst_V + width * y / 4;
-        for (x = 0; x < width; x += 32, ycp += 96, ycpw += 96) {
-            y1 = _mm256_loadu_si256((__m256i *)(ycp +  0)); // 128, 0
-            y2 = _mm256_loadu_si256((__m256i *)(ycp + 16)); // 384, 256
-            y3 = _mm256_loadu_si256((__m256i *)(ycp + 32)); // 640, 512
-
-            gather_y_uv_from_yc48(y1, y2, y3);
-            y0 = y2;
-
-            _mm256_storeu_si256((__m256i *)(Y + x), convert_y_range_from_yc48(y1, yC_Y_L_MA_16, Y_L_RSH_16, yC_YCC, yC_pw_one));
-
-            y1 = _mm256_loadu_si256((__m256i *)(ycpw +  0));
-            y2 = _mm256_loadu_si256((__m256i *)(ycpw + 16));
-            y3 = _mm256_loadu_si256((__m256i *)(ycpw + 32));
-
-            gather_y_uv_from_yc48(y1, y2, y3);
-
-            _mm256_storeu_si256((__m256i *)(Y + x + width), convert_y_range_from_yc48(y1, yC_Y_L_MA_16, Y_L_RSH_16, yC_YCC, yC_pw_one));
-
-            y4 = convert_uv_range_from_yc48_yuv420p(y0, y2,  _mm256_set1_epi16(UV_OFFSET_x2), yC_UV_L_MA_16_420P, UV_L_RSH_16_420P, yC_YCC, yC_pw_one);
-            
-            y1 = _mm256_loadu_si256((__m256i *)(ycp + 48)); // 128, 0
-            y2 = _mm256_loadu_si256((__m256i *)(ycp + 64)); // 384, 256
-            y3 = _mm256_loadu_si256((__m256i *)(ycp + 80)); // 640, 512
-
-            gather_y_uv_from_yc48(y1, y2, y3);
-            y0 = y2;
-
-            _mm256_storeu_si256((__m256i *)(Y + x + 16), convert_y_range_from_yc48(y1, yC_Y_L_MA_16, Y_L_RSH_16, yC_YCC, yC_pw_one));
-
-            y1 = _mm256_loadu_si256((__m256i *)(ycpw + 48));
-            y2 = _mm256_loadu_si256((__m256i *)(ycpw + 64));
-            y3 = _mm256_loadu_si256((__m256i *)(ycpw + 80));
-
-            gather_y_uv_from_yc48(y1, y2, y3);
-
-            _mm256_storeu_si256((__m256i *)(Y + x + 16 + width), convert_y_range_from_yc48(y1, yC_Y_L_MA_16, Y_L_RSH_16, yC_YCC, yC_pw_one));
-
-            y0 = convert_uv_range_from_yc48_yuv420p(y0, y2,  _mm256_set1_epi16(UV_OFFSET_x2), yC_UV_L_MA_16_420P, UV_L_RSH_16_420P, yC_YCC, yC_pw_one);
-
-            separate_low_up_16bit(y4, y0);
-
-            _mm256_storeu_si256((__m256i *)(U + (x>>1)), y4);
-            _mm256_storeu_si256((__m256i *)(V + (x>>1)), y0);
-        }
-    }
-    _mm256_zeroupper();
-}
-
-void convert_yc48_to_yv12_i_16bit_avx2(void *pixel, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    int x, y, i;
-    short *dst_Y = (short *)pixel_data->data[0];
-    short *dst_U = (short *)pixel_data->data[1];
-    short *dst_V = (short *)pixel_data->data[2];
-    short *ycp, *ycpw;
-    short *Y = NULL, *U = NULL, *V = NULL;
-    const __m256i yC_pw_one = _mm256_set1_epi16(1);
-    const __m256i yC_YCC = _mm256_set1_epi32(1<<LSFT_YCC_16);
-    __m256i y0, y1, y2, y3, y4;
-    for (y = 0; y < height; y += 4) {
-        for (i = 0; i < 2; i++) {
-            ycp = (short*)pixel + width * (y + i) * 3;
-            ycpw= ycp + width*2*3;
-            Y   = (short*)dst_Y + width * (y + i);
-            U   = (short*)dst_U + width * (y + i*2) / 4;
-            V   = (short*)dst_V + width * (y + i*2) / 4;
-            for (x = 0; x < width; x += 32, ycp += 96, ycpw += 96) {
-                y1 = _mm256_loadu_si256((__m256i *)(ycp +  0)); // 128, 0
-                y2 = _mm256_loadu_si256((__m256i *)(ycp + 16)); // 384, 256
-                y3 = _mm256_loadu_si256((__m256i *)(ycp + 32)); // 640, 512
-
-                gather_y_uv_from_yc48(y1, y2, y3);
-                y0 = y2;
-
-                _mm256_storeu_si256((__m256i *)(Y + x), convert_y_range_from_yc48(y1, yC_Y_L_MA_16, Y_L_RSH_16, yC_YCC, yC_pw_one));
-
-                y1 = _mm256_loadu_si256((__m256i *)(ycpw +  0));
-                y2 = _mm256_loadu_si256((__m256i *)(ycpw + 16));
-                y3 = _mm256_loadu_si256((__m256i *)(ycpw + 32));
-
-                gather_y_uv_from_yc48(y1, y2, y3);
-
-                _mm256_storeu_si256((__m256i *)(Y + x + width*2), convert_y_range_from_yc48(y1, yC_Y_L_MA_16, Y_L_RSH_16, yC_YCC, yC_pw_one));
-
-                y4 = convert_uv_range_from_yc48_420i(y0, y2, _mm256_set1_epi16(UV_OFFSET_x1), yC_UV_L_MA_16_420I(i), yC_UV_L_MA_16_420I((i+1)&0x01), UV_L_RSH_16_420I, yC_YCC, yC_pw_one);
-                
-                y1 = _mm256_loadu_si256((__m256i *)(ycp + 48)); // 128, 0
-                y2 = _mm256_loadu_si256((__m256i *)(ycp + 64)); // 384, 256
-                y3 = _mm256_loadu_si256((__m256i *)(ycp + 80)); // 640, 512
-
-                gather_y_uv_from_yc48(y1, y2, y3);
-                y0 = y2;
-
-                _mm256_storeu_si256((__m256i *)(Y + x + 16), convert_y_range_from_yc48(y1, yC_Y_L_MA_16, Y_L_RSH_16, yC_YCC, yC_pw_one));
-
-                y1 = _mm256_loadu_si256((__m256i *)(ycpw + 48));
-                y2 = _mm256_loadu_si256((__m256i *)(ycpw + 64));
-                y3 = _mm256_loadu_si256((__m256i *)(ycpw + 80));
-
-                gather_y_uv_from_yc48(y1, y2, y3);
-
-                _mm256_storeu_si256((__m256i *)(Y + x + 16 + width*2), convert_y_range_from_yc48(y1, yC_Y_L_MA_16, Y_L_RSH_16, yC_YCC, yC_pw_one));
-
-                y0 = convert_uv_range_from_yc48_420i(y0, y2, _mm256_set1_epi16(UV_OFFSET_x1), yC_UV_L_MA_16_420I(i), yC_UV_L_MA_16_420I((i+1)&0x01), UV_L_RSH_16_420I, yC_YCC, yC_pw_one);
-
-                separate_low_up_16bit(y4, y0);
-
-                _mm256_storeu_si256((__m256i *)(U + (x>>1)), y4);
-                _mm256_storeu_si256((__m256i *)(V + (x>>1)), y0);
-            }
-        }
-    }
-    _mm256_zeroupper();
-}
-
-static __forceinline void gather_y_u_v_from_yc48(__m256i& y0, __m256i& y1, __m256i& y2) {
-    __m256i y3, y4, y5;
-    const int MASK_INT = 0x40 + 0x08 + 0x01;
-    y3 = _mm256_blend_epi32(y0, y1, 0xf0);                    // 384, 0
-    y4 = _mm256_permute2x128_si256(y0, y2, (0x02<<4) + 0x01); // 512, 128
-    y5 = _mm256_blend_epi32(y1, y2, 0xf0);                    // 640, 256
-
-    y0 = _mm256_blend_epi16(y5, y3, MASK_INT);
-    y1 = _mm256_blend_epi16(y4, y5, MASK_INT);
-    y2 = _mm256_blend_epi16(y3, y4, MASK_INT);
-
-    y0 = _mm256_blend_epi16(y0, y4, MASK_INT<<1);
-    y1 = _mm256_blend_epi16(y1, y3, MASK_INT<<1);
-    y2 = _mm256_blend_epi16(y2, y5, MASK_INT<<1);
-
-    y0 = _mm256_shuffle_epi8(y0, yC_SUFFLE_YCP_Y);
-    y1 = _mm256_shuffle_epi8(y1, _mm256_alignr_epi8(yC_SUFFLE_YCP_Y, yC_SUFFLE_YCP_Y, 6));
-    y2 = _mm256_shuffle_epi8(y2, _mm256_alignr_epi8(yC_SUFFLE_YCP_Y, yC_SUFFLE_YCP_Y, 12));
-}
-void convert_yc48_to_yuv444_avx2(void *pixel, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    BYTE *Y = (BYTE *)pixel_data->data[0];
-    BYTE *U = (BYTE *)pixel_data->data[1];
-    BYTE *V = (BYTE *)pixel_data->data[2];
-    short *ycp;
-    short *const ycp_fin = (short *)pixel + width * height * 3;
-    const __m256i yC_pw_one = _mm256_set1_epi16(1);
-    const __m256i yC_YCC = _mm256_set1_epi32(1<<LSFT_YCC_16);
-    __m256i y1, y2, y3, yY, yU, yV;
-    for (ycp = (short *)pixel; ycp < ycp_fin; ycp += 96, Y += 32, U += 32, V += 32) {
-        y1 = _mm256_loadu_si256((__m256i *)(ycp +  0));
-        y2 = _mm256_loadu_si256((__m256i *)(ycp + 16));
-        y3 = _mm256_loadu_si256((__m256i *)(ycp + 32));
-
-        gather_y_u_v_from_yc48(y1, y2, y3);
-
-        y1 = convert_y_range_from_yc48(y1, yC_Y_L_MA_16, Y_L_RSH_16, yC_YCC, yC_pw_one);
-        y2 = convert_uv_range_from_yc48(y2, _mm256_set1_epi16(UV_OFFSET_x1), yC_UV_L_MA_16_444, UV_L_RSH_16_444, yC_YCC, yC_pw_one);
-        y3 = convert_uv_range_from_yc48(y3, _mm256_set1_epi16(UV_OFFSET_x1), yC_UV_L_MA_16_444, UV_L_RSH_16_444, yC_YCC, yC_pw_one);
-        yY = _mm256_srli_epi16(y1, 8);
-        yU = _mm256_srli_epi16(y2, 8);
-        yV = _mm256_srli_epi16(y3, 8);
-        
-        y1 = _mm256_loadu_si256((__m256i *)(ycp + 48));
-        y2 = _mm256_loadu_si256((__m256i *)(ycp + 64));
-        y3 = _mm256_loadu_si256((__m256i *)(ycp + 80));
-
-        gather_y_u_v_from_yc48(y1, y2, y3);
-
-        y1 = convert_y_range_from_yc48(y1, yC_Y_L_MA_16, Y_L_RSH_16, yC_YCC, yC_pw_one);
-        y2 = convert_uv_range_from_yc48(y2, _mm256_set1_epi16(UV_OFFSET_x1), yC_UV_L_MA_16_444, UV_L_RSH_16_444, yC_YCC, yC_pw_one);
-        y3 = convert_uv_range_from_yc48(y3, _mm256_set1_epi16(UV_OFFSET_x1), yC_UV_L_MA_16_444, UV_L_RSH_16_444, yC_YCC, yC_pw_one);
-        y1 = _mm256_srli_epi16(y1, 8);
-        y2 = _mm256_srli_epi16(y2, 8);
-        y3 = _mm256_srli_epi16(y3, 8);
-
-        yY = _mm256_packus_epi16(yY, y1);
-        yU = _mm256_packus_epi16(yU, y2);
-        yV = _mm256_packus_epi16(yV, y3);
-
-        yY = _mm256_permute4x64_epi64(yY, _MM_SHUFFLE(3,1,2,0));
-        yU = _mm256_permute4x64_epi64(yU, _MM_SHUFFLE(3,1,2,0));
-        yV = _mm256_permute4x64_epi64(yV, _MM_SHUFFLE(3,1,2,0));
-
-        _mm256_storeu_si256((__m256i *)Y, yY);
-        _mm256_storeu_si256((__m256i *)U, yU);
-        _mm256_storeu_si256((__m256i *)V, yV);
-    }
-    _mm256_zeroupper();
-}
-void convert_yc48_to_yuv444_16bit_avx2(void *pixel, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    short *Y = (short *)pixel_data->data[0];
-    short *U = (short *)pixel_data->data[1];
-    short *V = (short *)pixel_data->data[2];
-    short *ycp;
-    short *const ycp_fin = (short *)pixel + width * height * 3;
-    const __m256i yC_pw_one = _mm256_set1_epi16(1);
-    const __m256i yC_YCC = _mm256_set1_epi32(1<<LSFT_YCC_16);
-    __m256i y1, y2, y3;
-    for (ycp = (short *)pixel; ycp < ycp_fin; ycp += 48, Y += 16, U += 16, V += 16) {
-        y1 = _mm256_loadu_si256((__m256i *)(ycp +  0));
-        y2 = _mm256_loadu_si256((__m256i *)(ycp + 16));
-        y3 = _mm256_loadu_si256((__m256i *)(ycp + 32));
-
-        gather_y_u_v_from_yc48(y1, y2, y3);
-
-        _mm256_storeu_si256((__m256i *)Y, convert_y_range_from_yc48(y1, yC_Y_L_MA_16, Y_L_RSH_16, yC_YCC, yC_pw_one));
-        _mm256_storeu_si256((__m256i *)U, convert_uv_range_from_yc48(y2, _mm256_set1_epi16(UV_OFFSET_x1), yC_UV_L_MA_16_444, UV_L_RSH_16_444, yC_YCC, yC_pw_one));
-        _mm256_storeu_si256((__m256i *)V, convert_uv_range_from_yc48(y3, _mm256_set1_epi16(UV_OFFSET_x1), yC_UV_L_MA_16_444, UV_L_RSH_16_444, yC_YCC, yC_pw_one));
-    }
-    _mm256_zeroupper();
-}
-
 void convert_yuy2_to_nv16_avx2(void *pixel, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
     BYTE *p = (BYTE *)pixel;
     BYTE * const p_fin = p + width * height * 2;
@@ -757,187 +364,3 @@ void convert_yuy2_to_nv16_avx2(void *pixel, CONVERT_CF_DATA *pixel_data, const i
     }
     _mm256_zeroupper();
 }
-
-void convert_yc48_to_nv16_16bit_avx2(void *pixel, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    short *dst_Y = (short *)pixel_data->data[0];
-    short *dst_C = (short *)pixel_data->data[1];
-    short *ycp = (short *)pixel;
-    short * const ycp_fin = ycp + width * height * 3;
-    const __m256i yC_pw_one = _mm256_set1_epi16(1);
-    const __m256i yC_YCC = _mm256_set1_epi32(1<<LSFT_YCC_16);
-    __m256i y1, y2, y3;
-    for (; ycp < ycp_fin; ycp += 48, dst_Y += 16, dst_C += 16) {
-        y1 = _mm256_loadu_si256((__m256i *)(ycp +  0));
-        y2 = _mm256_loadu_si256((__m256i *)(ycp + 16));
-        y3 = _mm256_loadu_si256((__m256i *)(ycp + 32));
-
-        gather_y_uv_from_yc48(y1, y2, y3);
-
-        _mm256_storeu_si256((__m256i *)dst_Y, convert_y_range_from_yc48(y1, yC_Y_L_MA_16, Y_L_RSH_16, yC_YCC, yC_pw_one));
-        _mm256_storeu_si256((__m256i *)dst_C, convert_uv_range_from_yc48(y2, _mm256_set1_epi16(UV_OFFSET_x1), yC_UV_L_MA_16_444, UV_L_RSH_16_444, yC_YCC, yC_pw_one));
-    }
-    _mm256_zeroupper();
-}
-void convert_lw48_to_nv12_16bit_avx2(void *pixel, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    int x, y;
-    short *dst_Y = (short *)pixel_data->data[0];
-    short *dst_C = (short *)pixel_data->data[1];
-    short *ycp, *ycpw;
-    short *Y = NULL, *C = NULL;
-    __m256i y0, y1, y2, y3;
-    for (y = 0; y < height; y += 2) {
-        ycp = (short*)pixel + width * y * 3;
-        ycpw= ycp + width*3;
-        Y   = (short*)dst_Y + width * y;
-        C   = (short*)dst_C + width * y / 2;
-        for (x = 0; x < width; x += 16, ycp += 48, ycpw += 48) {
-            y1 = _mm256_loadu_si256((__m256i *)(ycp +  0)); // 128, 0
-            y2 = _mm256_loadu_si256((__m256i *)(ycp + 16)); // 384, 256
-            y3 = _mm256_loadu_si256((__m256i *)(ycp + 32)); // 640, 512
-
-            gather_y_uv_from_yc48(y1, y2, y3);
-            y0 = y2;
-
-            _mm256_storeu_si256((__m256i *)(Y + x), y1);
-
-            y1 = _mm256_loadu_si256((__m256i *)(ycpw +  0));
-            y2 = _mm256_loadu_si256((__m256i *)(ycpw + 16));
-            y3 = _mm256_loadu_si256((__m256i *)(ycpw + 32));
-
-            gather_y_uv_from_yc48(y1, y2, y3);
-
-            _mm256_storeu_si256((__m256i *)(Y + x + width), y1);
-
-            y0 = _mm256_avg_epu16(y0, y2);
-
-            _mm256_storeu_si256((__m256i *)(C + x), y0);
-        }
-    }
-    _mm256_zeroupper();
-}
-
-void convert_lw48_to_nv12_i_16bit_avx2(void *pixel, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    int x, y, i;
-    short *dst_Y = (short *)pixel_data->data[0];
-    short *dst_C = (short *)pixel_data->data[1];
-    short *ycp, *ycpw;
-    short *Y = NULL, *C = NULL;
-    __m256i y0, y1, y2, y3;
-    for (y = 0; y < height; y += 4) {
-        for (i = 0; i < 2; i++) {
-            ycp = (short*)pixel + width * (y + i) * 3;
-            ycpw= ycp + width*2*3;
-            Y   = (short*)dst_Y + width * (y + i);
-            C   = (short*)dst_C + width * (y + i*2) / 2;
-            for (x = 0; x < width; x += 16, ycp += 48, ycpw += 48) {
-                y1 = _mm256_loadu_si256((__m256i *)(ycp +  0)); // 128, 0
-                y2 = _mm256_loadu_si256((__m256i *)(ycp + 16)); // 384, 256
-                y3 = _mm256_loadu_si256((__m256i *)(ycp + 32)); // 640, 512
-
-                gather_y_uv_from_yc48(y1, y2, y3);
-                y0 = y2;
-
-                _mm256_storeu_si256((__m256i *)(Y + x), y1);
-
-                y1 = _mm256_loadu_si256((__m256i *)(ycpw +  0));
-                y2 = _mm256_loadu_si256((__m256i *)(ycpw + 16));
-                y3 = _mm256_loadu_si256((__m256i *)(ycpw + 32));
-
-                gather_y_uv_from_yc48(y1, y2, y3);
-
-                _mm256_storeu_si256((__m256i *)(Y + x + width*2), y1);
-
-                y1 = _mm256_unpacklo_epi16(y0, y2);
-                y0 = _mm256_unpackhi_epi16(y0, y2);
-                y1 = _mm256_madd_epi16(y1, yC_INTERLACE_WEIGHT(i));
-                y0 = _mm256_madd_epi16(y0, yC_INTERLACE_WEIGHT(i));
-                y1 = _mm256_srli_epi32(y1, 2);
-                y0 = _mm256_srli_epi32(y0, 2);
-                y1 = _mm256_packus_epi32(y1, y0);
-
-                _mm256_storeu_si256((__m256i *)(C + x), y1);
-            }
-        }
-    }
-    _mm256_zeroupper();
-}
-void convert_lw48_to_nv16_16bit_avx2(void *pixel, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    short *dst_Y = (short *)pixel_data->data[0];
-    short *dst_C = (short *)pixel_data->data[1];
-    short *ycp = (short *)pixel;
-    short * const ycp_fin = ycp + width * height * 3;
-    __m256i y1, y2, y3;
-    for (; ycp < ycp_fin; ycp += 48, dst_Y += 16, dst_C += 16) {
-        y1 = _mm256_loadu_si256((__m256i *)(ycp +  0));
-        y2 = _mm256_loadu_si256((__m256i *)(ycp + 16));
-        y3 = _mm256_loadu_si256((__m256i *)(ycp + 32));
-
-        gather_y_uv_from_yc48(y1, y2, y3);
-
-        _mm256_storeu_si256((__m256i *)dst_Y, y1);
-        _mm256_storeu_si256((__m256i *)dst_C, y2);
-    }
-    _mm256_zeroupper();
-}
-void convert_lw48_to_yuv444_avx2(void *pixel, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    BYTE *Y = (BYTE *)pixel_data->data[0];
-    BYTE *U = (BYTE *)pixel_data->data[1];
-    BYTE *V = (BYTE *)pixel_data->data[2];
-    short *ycp;
-    short *const ycp_fin = (short *)pixel + width * height * 3;
-    __m256i y1, y2, y3, yY, yU, yV;
-    for (ycp = (short *)pixel; ycp < ycp_fin; ycp += 96, Y += 16, U += 16, V += 16) {
-        y1 = _mm256_loadu_si256((__m256i *)(ycp +  0));
-        y2 = _mm256_loadu_si256((__m256i *)(ycp + 16));
-        y3 = _mm256_loadu_si256((__m256i *)(ycp + 32));
-
-        gather_y_u_v_from_yc48(y1, y2, y3);
-
-        yY = _mm256_srli_epi16(y1, 8);
-        yU = _mm256_srli_epi16(y2, 8);
-        yV = _mm256_srli_epi16(y3, 8);
-        
-        y1 = _mm256_loadu_si256((__m256i *)(ycp + 48));
-        y2 = _mm256_loadu_si256((__m256i *)(ycp + 64));
-        y3 = _mm256_loadu_si256((__m256i *)(ycp + 80));
-
-        gather_y_u_v_from_yc48(y1, y2, y3);
-
-        y1 = _mm256_srli_epi16(y1, 8);
-        y2 = _mm256_srli_epi16(y2, 8);
-        y3 = _mm256_srli_epi16(y3, 8);
-
-        yY = _mm256_packus_epi16(yY, y1);
-        yU = _mm256_packus_epi16(yU, y2);
-        yV = _mm256_packus_epi16(yV, y3);
-
-        yY = _mm256_permute4x64_epi64(yY, _MM_SHUFFLE(3,1,2,0));
-        yU = _mm256_permute4x64_epi64(yU, _MM_SHUFFLE(3,1,2,0));
-        yV = _mm256_permute4x64_epi64(yV, _MM_SHUFFLE(3,1,2,0));
-
-        _mm256_storeu_si256((__m256i *)Y, yY);
-        _mm256_storeu_si256((__m256i *)U, yU);
-        _mm256_storeu_si256((__m256i *)V, yV);
-    }
-    _mm256_zeroupper();
-}
-void convert_lw48_to_yuv444_16bit_avx2(void *pixel, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    short *Y = (short *)pixel_data->data[0];
-    short *U = (short *)pixel_data->data[1];
-    short *V = (short *)pixel_data->data[2];
-    short *ycp;
-    short *const ycp_fin = (short *)pixel + width * height * 3;
-    __m256i y1, y2, y3;
-    for (ycp = (short *)pixel; ycp < ycp_fin; ycp += 48, Y += 16, U += 16, V += 16) {
-        y1 = _mm256_loadu_si256((__m256i *)(ycp +  0));
-        y2 = _mm256_loadu_si256((__m256i *)(ycp + 16));
-        y3 = _mm256_loadu_si256((__m256i *)(ycp + 32));
-
-        gather_y_u_v_from_yc48(y1, y2, y3);
-
-        _mm256_storeu_si256((__m256i *)Y, y1);
-        _mm256_storeu_si256((__m256i *)U, y2);
-        _mm256_storeu_si256((__m256i *)V, y3);
-    }
-    _mm256_zeroupper();
-}
@@ -44,45 +44,3 @@ void convert_yuy2_to_nv16_sse2(void *frame, CONVERT_CF_DATA *pixel_data, const i
     return convert_yuy2_to_nv16_simd<FALSE>(frame, pixel_data, width, height);
 }
 
-void convert_yc48_to_nv12_16bit_sse2_mod8(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    return convert_yc48_to_nv12_16bit_simd<TRUE>(frame, pixel_data, width, height);
-}
-void convert_yc48_to_nv12_16bit_sse2(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    return convert_yc48_to_nv12_16bit_simd<FALSE>(frame, pixel_data, width, height);
-}
-void convert_yc48_to_nv12_i_16bit_sse2_mod8(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    return convert_yc48_to_nv12_i_16bit_simd<TRUE>(frame, pixel_data, width, height);
-}
-void convert_yc48_to_nv12_i_16bit_sse2(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    return convert_yc48_to_nv12_i_16bit_simd<FALSE>(frame, pixel_data, width, height);
-}
-void convert_yc48_to_yv12_16bit_sse2_mod8(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    return convert_yc48_to_yv12_16bit_simd<TRUE>(frame, pixel_data, width, height);
-}
-void convert_yc48_to_yv12_16bit_sse2(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    return convert_yc48_to_yv12_16bit_simd<FALSE>(frame, pixel_data, width, height);
-}
-void convert_yc48_to_yv12_i_16bit_sse2_mod8(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    return convert_yc48_to_yv12_i_16bit_simd<TRUE>(frame, pixel_data, width, height);
-}
-void convert_yc48_to_yv12_i_16bit_sse2(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    return convert_yc48_to_yv12_i_16bit_simd<FALSE>(frame, pixel_data, width, height);
-}
-void convert_yc48_to_nv16_16bit_sse2_mod8(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    return convert_yc48_to_nv16_16bit_simd<TRUE>(frame, pixel_data, width, height);
-}
-void convert_yc48_to_nv16_16bit_sse2(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    return convert_yc48_to_nv16_16bit_simd<FALSE>(frame, pixel_data, width, height);
-}
-void convert_yc48_to_yuv444_sse2_mod16(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    return convert_yc48_to_yuv444_simd<TRUE>(frame, pixel_data, width, height);
-}
-void convert_yc48_to_yuv444_sse2(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    return convert_yc48_to_yuv444_simd<FALSE>(frame, pixel_data, width, height);
-}
-void convert_yc48_to_yuv444_16bit_sse2_mod8(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    return convert_yc48_to_yuv444_16bit_simd<TRUE>(frame, pixel_data, width, height);
-}
-void convert_yc48_to_yuv444_16bit_sse2(void *frame, CONVERT_CF_DATA *pixel_data, const int width, const int height) {
-    return convert_yc48_to_yuv444_16bit_simd<FALSE>(frame, pixel_data, width, height);
-}
@@ -135,6 +135,10 @@ void warning_auo_tcfile_failed() {
     write_log_auo_line(LOG_WARNING, "タイムコードファイル作成に失敗しました。");
 }
 
+void warning_video_shm_failed() {
+    write_log_auo_line(LOG_WARNING, "映像受け渡し用の共有メモリの作成に失敗しました。パイプで受け渡しを行います。");
+}
+
 void error_malloc_pixel_data() {
     write_log_auo_line(LOG_ERROR, "映像バッファ用メモリ確保に失敗しました。");
 }
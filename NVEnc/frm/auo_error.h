@@ -43,6 +43,7 @@ void error_run_process(const char *exe_name, int rp_ret);
 void error_video_output_thread_start();
 void warning_auto_qpfile_failed();
 void warning_auo_tcfile_failed();
+void warning_video_shm_failed();
 void error_open_wavfile();
 void warning_audio_length();
 
@@ -485,6 +485,7 @@ void guiEx_settings::load_local() {
     s_local.get_relative_path         = GetPrivateProfileInt(   ini_section_main, "get_relative_path",        DEFAULT_SAVE_RELATIVE_PATH,    conf_fileName);
     s_local.run_bat_minimized         = GetPrivateProfileInt(   ini_section_main, "run_bat_minimized",        DEFAULT_RUN_BAT_MINIMIZED,     conf_fileName);
     s_local.default_audio_encoder     = GetPrivateProfileInt(   ini_section_main, "default_audio_encoder",    DEFAULT_AUDIO_ENCODER,         conf_fileName);
+    s_local.video_shm_transfer        = GetPrivateProfileInt(   ini_section_main, "video_shm_transfer",       DEFAULT_VIDEO_SHM_TRANSFER,    conf_fileName);
 
     
     GetFontInfo(ini_section_main, "conf_font", &s_local.conf_font, conf_fileName);
@@ -566,6 +567,7 @@ void guiEx_settings::save_local() {
     WritePrivateProfileIntWithDefault(   ini_section_main, "get_relative_path",         s_local.get_relative_path,        DEFAULT_SAVE_RELATIVE_PATH,    conf_fileName);
     WritePrivateProfileIntWithDefault(   ini_section_main, "run_bat_minimized",         s_local.run_bat_minimized,        DEFAULT_RUN_BAT_MINIMIZED,     conf_fileName);
     WritePrivateProfileIntWithDefault(   ini_section_main, "default_audio_encoder",     s_local.default_audio_encoder,    DEFAULT_AUDIO_ENCODER,         conf_fileName);
+    WritePrivateProfileIntWithDefault(   ini_section_main, "video_shm_transfer",        s_local.video_shm_transfer,       DEFAULT_VIDEO_SHM_TRANSFER,    conf_fileName);
 
 
     WriteFontInfo(ini_section_main, "conf_font", &s_local.conf_font, conf_fileName);
@@ -47,6 +47,7 @@ static const BOOL   DEFAULT_AUDIO_ENCODER         = 8;
 static const BOOL   DEFAULT_THREAD_TUNING         = 0;
 
 static const BOOL   DEFAULT_RUN_BAT_MINIMIZED     = 0;
+static const BOOL   DEFAULT_VIDEO_SHM_TRANSFER    = 1;
 
 static const int    DEFAULT_LOG_LEVEL            = 0;
 static const BOOL   DEFAULT_LOG_WINE_COMPAT      = 0;
@@ -268,6 +269,7 @@ typedef struct {
     BOOL   thread_tuning;                       //スレッドチューニング
 
     BOOL   run_bat_minimized;                   //エンコ前後バッチ処理を最小化で実行
+    BOOL   video_shm_transfer;                  //映像の受け渡しにパイプではなく共有メモリを使用する
     char   custom_tmp_dir[MAX_PATH_LEN];        //一時フォルダ
     char   custom_audio_tmp_dir[MAX_PATH_LEN];  //音声用一時フォルダ
     char   custom_mp4box_tmp_dir[MAX_PATH_LEN]; //mp4box用一時フォルダ
@@ -47,6 +47,7 @@
 #include "NVEncFilterAfs.h"
 #include "NVEncCmd.h"
 #include "rgy_util.h"
+#include "rgy_io_bench.h"
 
 #if ENABLE_CPP_REGEX
 #include <regex>
@@ -189,6 +190,22 @@ static tstring help() {
         _T("   --check-protocols            show in/out protocols available\n")
         _T("   --check-filters              show filters available\n")
 #endif
+        _T("   --io-bench [<param1>=<value>][,<param2>=<value>][...]\n")
+        _T("                                measure throughput of readers/writers\n")
+        _T("                                  with synthetic input (GPU not used)\n")
+        _T("    params\n")
+        _T("      w=<int>, h=<int>            resolution (default: 1920x1080)\n")
+        _T("      depth=<int>                 bit depth, 8/9/10/12/14 (default: 8)\n")
+        _T("      frames=<int>                number of frames (default: 120)\n")
+        _T("      gop=<int>                   IDR interval (default: 30)\n")
+        _T("      fps=<int>/<int>             framerate (default: 30000/1001)\n")
+        _T("      reader=<string>[:<string>]  raw, y4m, avi, avcodec, none\n")
+        _T("      writer=<string>[:<string>]  null, raw, mp4, mkv, ts, none\n")
+        _T("      framepos=<int>              frames to measure the frame position list\n")
+        _T("                                  of avcodec reader (default: 0 = off)\n")
+        _T("      dir=<string>                directory for temporary files\n")
+        _T("      output=<string>             csv file for results (default: stdout)\n")
+        _T("      keep=<bool>                 keep temporary files (default: false)\n")
         _T("\n"));
     str += strsprintf(_T("\n")
         _T("Basic Encoding Options: \n")
@@ -201,6 +218,10 @@ static tstring help() {
         _T(" Input formats (auto detected from extension of not set)\n")
         _T("   --raw                        set input as raw format\n")
         _T("   --y4m                        set input as y4m format\n")
+#if ENABLE_SHM_READER
+        _T("   --shm                        read frames from shared memory,\n")
+        _T("                                 input filename is the name of it\n")
+#endif
 #if ENABLE_AVI_READER
         _T("   --avi                        set input as avi format\n")
 #endif
@@ -258,6 +279,8 @@ static tstring help() {
         _T("   --audio-codec [<int>?]<string>\n")
         _T("                                encode audio to specified format.\n")
         _T("                                  in [<int>?], specify track number to encode.\n")
+        _T("                                  \"faw\" extracts aac from FAW (16bit pcm)\n")
+        _T("                                  without decoding / encoding.\n")
         _T("   --audio-bitrate [<int>?]<int>\n")
         _T("                                set encode bitrate for audio (kbps).\n")
         _T("                                  in [<int>?], specify track number of audio.\n")
@@ -307,6 +330,12 @@ static tstring help() {
         _T("                                set audio filter.\n")
         _T("                                  in [<int>?], specify track number of audio.\n")
         _T("   --chapter-copy               copy chapter to output file.\n")
+        _T("   --remux                      copy video stream (H.264/HEVC) without encoding,\n")
+        _T("                                 audio/subtitle/chapter options could be used as usual.\n")
+        _T("                                 only avhw/avsw reader and avcodec muxer.\n")
+        _T("   --bitstream-stats            analyze video stream (H.264/HEVC) without decoding,\n")
+        _T("                                 and output per frame stats to output file (csv).\n")
+        _T("                                 only avhw/avsw reader.\n")
         _T("   --chapter <string>           set chapter from file specified.\n")
         _T("   --sub-copy [<int>[,...]]     copy subtitle to output file.\n")
         _T("                                 these could be only used with\n")
@@ -320,17 +349,58 @@ static tstring help() {
         _T("                                 vfr      ... honor source timestamp and enable vfr output.\n")
         _T("                                              only available for avsw/avhw reader,\n")
         _T("                                              and could not be used with --trim.\n")
+        _T("   --dedup [<param1>=<value>][,<param2>=<value>][...]\n")
+        _T("                                drop duplicated frames and extend the duration\n")
+        _T("                                 of the previous frame (vfr output).\n")
+        _T("                                 requires frames decoded on CPU (avsw/raw/y4m/avs/vpy)\n")
+        _T("                                 and avcodec muxer.\n")
+        _T("    params\n")
+        _T("      threshold=<float>          mean abs diff per pixel of 16x16 luma block\n")
+        _T("                                 to be treated as duplicate (default: %.1f)\n")
+        _T("      max-drop=<int>             max number of frames dropped in a row\n")
+        _T("                                 0 = unlimited (default: %d)\n")
+        _T("   --psnr                       measure psnr of the output against the input.\n")
+        _T("   --ssim                       measure ssim of the output against the input.\n")
+        _T("                                 output is decoded on CPU in parallel with encoding.\n")
+        _T("                                 requires frames decoded on CPU (avsw/raw/y4m/avs/vpy)\n")
+        _T("                                 and output without resize.\n")
+        _T("   --metric-log <string>        output per frame psnr/ssim to the file (csv).\n")
+        _T("   --metric-ref <string>        measure psnr/ssim of the input (H.264/HEVC)\n")
+        _T("                                 against the reference file without encoding,\n")
+        _T("                                 and output per frame results to output file (csv).\n")
+        _T("                                 does not use GPU, --crop is applied to the reference.\n")
         _T("-m,--mux-option <string1>:<string2>\n")
         _T("                                set muxer option name and value.\n")
         _T("                                 these could be only used with\n")
-        _T("                                 avhw/avsw reader and avcodec muxer.\n"),
-        DEFAULT_IGNORE_DECODE_ERROR);
+        _T("                                 avhw/avsw reader and avcodec muxer.\n")
+        _T("   --fmp4 [<param1>=<value>][,<param2>=<value>][...]\n")
+        _T("                                output fragmented mp4 (CMAF), which could be used\n")
+        _T("                                 by other applications during encoding.\n")
+        _T("    params\n")
+        _T("      frag=<int>                 length of fragment in ms,\n")
+        _T("                                 or \"idr\" to split at every IDR (default: idr)\n")
+        _T("      segment=<float>            split into segment files of the length in seconds,\n")
+        _T("                                 and write hls playlist (default: 0 = no split)\n"),
+        DEFAULT_IGNORE_DECODE_ERROR, DEDUP_DEFAULT_THRESHOLD, DEDUP_DEFAULT_MAX_DROP);
 #endif
     str += strsprintf(_T("")
         _T("   --input-res <int>x<int>        set input resolution\n")
         _T("   --crop <int>,<int>,<int>,<int> crop pixels from left,top,right,bottom\n")
         _T("                                    left crop is unavailable with avhw reader\n")
+        _T("   --crop auto[:<int>]          detect black borders from sampled frames\n")
+        _T("                                 and crop them, optionally set the number\n")
+        _T("                                 of frames to analyze (default: 12).\n")
+        _T("                                 supported with avhw/avsw/raw/y4m reader.\n")
         _T("   --output-res <int>x<int>     set output resolution\n")
+        _T("   --output-rendition <param1>=<value1>[,<param2>=<value2>],...\n")
+        _T("                                 add an output of the abr ladder, which\n")
+        _T("                                 shares decode and vpp with the main output.\n")
+        _T("                                 could be set multiple times.\n")
+        _T("    params\n")
+        _T("      output=<string>           output file name (required).\n")
+        _T("      res=<int>x<int>           output resolution (required).\n")
+        _T("      bitrate=<int>             bitrate in kbps.\n")
+        _T("      max-bitrate=<int>         max bitrate in kbps.\n")
         _T("   --fps <int>/<int> or <float> set framerate\n")
         _T("\n")
         _T("-c,--codec <string>             set output codec\n")
@@ -427,7 +497,8 @@ static tstring help() {
         _T("   --fullrange                  set fullrange\n")
         _T("   --max-cll <int>,<int>        set MaxCLL and MaxFall in nits. e.g. \"1000,300\"\n")
         _T("   --master-display <string>    set Mastering display data.\n")
-        _T("      e.g. \"G(13250,34500)B(7500,3000)R(34000,16000)WP(15635,16450)L(10000000,1)\"\n"));
+        _T("      e.g. \"G(13250,34500)B(7500,3000)R(34000,16000)WP(15635,16450)L(10000000,1)\"\n")
+        _T("   --dhdr10-info <string>       set HDR10+ dynamic metadata from file.\n"));
 
     str += strsprintf(_T("\n")
         _T("   --interlace <string>         set input as interlaced\n")
@@ -531,7 +602,8 @@ static tstring help() {
         _T("      tune=<bool>   (調整モード)       show scan result   (default=%s)\n")
         _T("      rff=<bool>                       rff flag aware     (default=%s)\n")
         _T("      timecode=<bool>                  output timecode    (default=%s)\n")
-        _T("      log=<bool>                       output log         (default=%s)\n"),
+        _T("      log=<bool>                       output log         (default=%s)\n")
+        _T("      cpu=<bool>                       process on cpu     (default=%s)\n"),
         FILTER_DEFAULT_AFS_CLIP_TB, FILTER_DEFAULT_AFS_CLIP_TB,
         FILTER_DEFAULT_AFS_CLIP_LR, FILTER_DEFAULT_AFS_CLIP_LR,
         FILTER_DEFAULT_AFS_METHOD_SWITCH, FILTER_DEFAULT_AFS_COEFF_SHIFT,
@@ -545,7 +617,8 @@ static tstring help() {
         FILTER_DEFAULT_AFS_TUNE    ? _T("on") : _T("off"),
         FILTER_DEFAULT_AFS_RFF     ? _T("on") : _T("off"),
         FILTER_DEFAULT_AFS_TIMECODE ? _T("on") : _T("off"),
-        FILTER_DEFAULT_AFS_LOG      ? _T("on") : _T("off"));
+        FILTER_DEFAULT_AFS_LOG      ? _T("on") : _T("off"),
+        FILTER_DEFAULT_AFS_CPU      ? _T("on") : _T("off"));
     str += strsprintf(_T("\n")
         _T("   --vpp-rff                    apply rff flag, with avhw reader only.\n"));
     str += strsprintf(_T("\n")
@@ -570,8 +643,16 @@ static tstring help() {
         _T("   --vpp-delogo-depth <int>     set delogo depth [default:%d]\n")
         _T("   --vpp-delogo-y  <int>        set delogo y  param\n")
         _T("   --vpp-delogo-cb <int>        set delogo cb param\n")
-        _T("   --vpp-delogo-cr <int>        set delogo cr param\n"),
-        FILTER_DEFAULT_DELOGO_DEPTH);
+        _T("   --vpp-delogo-cr <int>        set delogo cr param\n")
+        _T("   --vpp-delogo-auto-fade       estimate logo fade per frame,\n")
+        _T("                                 and skip frames without logo\n")
+        _T("   --vpp-delogo-log <string>    output per frame logo detection log\n")
+        _T("   --vpp-delogo-auto-select [<int>]\n")
+        _T("                                 select logo from logo pack by the content\n")
+        _T("                                 of first <int> frames [default:%d]\n")
+        _T("                                 used when logo is not selected, or not\n")
+        _T("                                 found by the auto select file.\n"),
+        FILTER_DEFAULT_DELOGO_DEPTH, FILTER_DEFAULT_DELOGO_AUTO_SELECT_FRAMES);
     str += strsprintf(_T("")
         _T("   --vpp-perf-monitor           check duration of each filter.\n")
         _T("                                  may decrease overall transcode performance.\n"));
@@ -589,6 +670,33 @@ static tstring help() {
         _T("                                 default %d MB (0-%d)\n"),
         DEFAULT_OUTPUT_BUF, RGY_OUTPUT_BUF_MB_MAX
     );
+    str += strsprintf(_T("")
+        _T("   --bitstream-thread <int>     retrieve bitstream from encoder in a separate thread\n")
+        _T("                                 -1: auto (= default)\n")
+        _T("                                  0: disable\n")
+        _T("                                  1: use one thread\n"));
+    str += strsprintf(_T("")
+        _T("   --input-staging-depth <int>  set number of pinned host buffers used to\n")
+        _T("                                 upload input frames (%d-%d).\n")
+        _T("                                 default: auto (tuned by transfer speed)\n"),
+        RGY_STAGING_RING_DEPTH_MIN, RGY_STAGING_RING_DEPTH_MAX
+    );
+    str += strsprintf(_T("")
+        _T("   --avs-prefetch <int>         set number of frames to read ahead from avs\n")
+        _T("                                 in a separate thread (0-%d, 0: disable).\n")
+        _T("                                 default: %d\n"),
+        RGY_AVS_PREFETCH_MAX, RGY_AVS_PREFETCH_DEFAULT
+    );
+    str += strsprintf(_T("")
+        _T("   --thread-affinity [<thread>=]<string>[,...]\n")
+        _T("                                set cpu affinity of threads (default: all).\n")
+        _T("                                 thread : all, main, decoder, input, output, audio,\n")
+        _T("                                          bitstream\n")
+        _T("                                 string : all      ... no restriction\n")
+        _T("                                          numa     ... cpus on the numa node\n")
+        _T("                                                       which the gpu is attached\n")
+        _T("                                          node<n>  ... cpus on numa node <n>\n")
+        _T("                                          0x<hex>  ... cpus set by bit mask\n"));
     str += strsprintf(_T("")
         _T("   --max-procfps <int>         limit encoding speed for lower utilization.\n")
         _T("                                 default:0 (no limit)\n"));
@@ -644,6 +752,9 @@ static tstring help() {
         _T("                                 gpu         ... monitor all gpu info\n")
 #endif //#if defined(_WIN32) || defined(_WIN64)
         _T("                                 queue       ... queue usage\n")
+        _T("                                 queue_stage ... input staging buffer usage\n")
+        _T("                                 vid_out_buf ... output bitstream buffer alloc/copy count\n")
+        _T("                                 prefetch    ... avs prefetch hit/miss count and stall time\n")
         _T("                                 mem_private ... private memory (MB)\n")
         _T("                                 mem_virtual ... virtual memory (MB)\n")
         _T("                                 mem         ... monitor all memory info\n")
@@ -865,6 +976,16 @@ int parse_print_options(const TCHAR *option_name, const TCHAR *arg1) {
         show_nvenc_features(deviceid);
         return 1;
     }
+    if (IS_OPTION("io-bench")) {
+        RGYIOBenchPrm prm;
+        tstring err;
+        if (prm.parse((arg1 && arg1[0] != '-') ? arg1 : _T(""), err)) {
+            _ftprintf(stderr, _T("Error: --io-bench: %s\n"), err.c_str());
+            return -1;
+        }
+        auto pLog = std::make_shared<RGYLog>(nullptr, RGY_LOG_INFO);
+        return (run_io_bench(prm, pLog) == 0) ? 1 : -1;
+    }
 #if ENABLE_AVSW_READER
     if (0 == _tcscmp(option_name, _T("check-avversion"))) {
         _ftprintf(stdout, _T("%s\n"), getAVVersions().c_str());
@@ -1000,7 +1121,14 @@ int _tmain(int argc, TCHAR **argv) {
     int ret = 1;
 
     NVEncCore nvEnc;
-    if (   NV_ENC_SUCCESS == nvEnc.Initialize(&encPrm)
+    if (encPrm.bRemux || encPrm.bBitstreamStats || encPrm.sMetricRef.length() > 0) {
+        //エンコードを行わず、そのままコピーする (あるいは解析のみ行う)
+        if (NV_ENC_SUCCESS == nvEnc.InitRemux(&encPrm)) {
+            nvEnc.SetAbortFlagPointer(&g_signal_abort);
+            set_signal_handler();
+            ret = (NV_ENC_SUCCESS == nvEnc.Remux()) ? 0 : 1;
+        }
+    } else if (   NV_ENC_SUCCESS == nvEnc.Initialize(&encPrm)
         && NV_ENC_SUCCESS == nvEnc.InitEncode(&encPrm)) {
         nvEnc.SetAbortFlagPointer(&g_signal_abort);
         set_signal_handler();
@@ -0,0 +1,195 @@
+﻿// -----------------------------------------------------------------------------------------
+// NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+//
+// The MIT License
+//
+// Copyright (c) 2014-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// ------------------------------------------------------------------------------------------
+#include "NVEncBitstreamCollector.h"
+
+NVEncBitstreamCollector::NVEncBitstreamCollector() :
+    m_funcs(),
+    m_thread(),
+    m_mtx(),
+    m_cvPushed(),
+    m_cvCollected(),
+    m_qEncoding(),
+    m_qCollected(),
+    m_bitstream(RGYBitstreamInit()),
+    m_nFrames(0),
+    m_err(NV_ENC_SUCCESS),
+    m_bFinish(false),
+    m_bAbort(false) {
+}
+
+NVEncBitstreamCollector::~NVEncBitstreamCollector() {
+    abort();
+    m_bitstream.clear();
+}
+
+NVENCSTATUS NVEncBitstreamCollector::start(const Funcs& funcs) {
+    if (m_thread.joinable()) {
+        return NV_ENC_ERR_INVALID_CALL;
+    }
+    if (!funcs.waitFin || !funcs.copy || !funcs.write) {
+        return NV_ENC_ERR_INVALID_PARAM;
+    }
+    m_funcs = funcs;
+    m_qEncoding.clear();
+    m_qCollected.clear();
+    m_nFrames = 0;
+    m_err = NV_ENC_SUCCESS;
+    m_bFinish = false;
+    m_bAbort = false;
+    m_thread = std::thread(&NVEncBitstreamCollector::run, this);
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NVEncBitstreamCollector::push(const EncodeBuffer *pEncodeBuffer) {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (m_err != NV_ENC_SUCCESS) {
+        return m_err;
+    }
+    if (!m_thread.joinable() || m_bFinish) {
+        return NV_ENC_ERR_INVALID_CALL;
+    }
+    m_qEncoding.push_back(pEncodeBuffer);
+    m_cvPushed.notify_one();
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NVEncBitstreamCollector::waitOldest(const EncodeBuffer *pEncodeBuffer) {
+    std::unique_lock<std::mutex> lock(m_mtx);
+    //取り出しが終了するまで待機する
+    //エラー時もスレッドは出力バッファを順に処理済みとするので、ここで待機し続けることはない
+    m_cvCollected.wait(lock, [this]() {
+        return m_qCollected.size() > 0 || m_qEncoding.size() == 0 || !m_thread.joinable();
+    });
+    if (m_qCollected.size() == 0) {
+        //pushされていない出力バッファ (エンコーダへの投入に失敗したもの)
+        return (m_err != NV_ENC_SUCCESS) ? m_err : NV_ENC_ERR_INVALID_CALL;
+    }
+    if (m_qCollected.front() != pEncodeBuffer) {
+        //投入順と異なる順序で出力バッファを再利用しようとしている
+        m_err = NV_ENC_ERR_GENERIC;
+        return m_err;
+    }
+    m_qCollected.pop_front();
+    return m_err;
+}
+
+NVENCSTATUS NVEncBitstreamCollector::finish() {
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_bFinish = true;
+        m_cvPushed.notify_one();
+    }
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_cvCollected.notify_all();
+    return m_err;
+}
+
+void NVEncBitstreamCollector::abort() {
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_bAbort = true;
+    }
+    finish();
+}
+
+size_t NVEncBitstreamCollector::pending() {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_qEncoding.size();
+}
+
+int64_t NVEncBitstreamCollector::frames() {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_nFrames;
+}
+
+NVENCSTATUS NVEncBitstreamCollector::error() {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_err;
+}
+
+void NVEncBitstreamCollector::setError(NVENCSTATUS sts) {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (m_err == NV_ENC_SUCCESS) {
+        m_err = sts;
+    }
+}
+
+void NVEncBitstreamCollector::run() {
+    for (;;) {
+        const EncodeBuffer *pEncodeBuffer = nullptr;
+        NVENCSTATUS sts = NV_ENC_SUCCESS;
+        {
+            std::unique_lock<std::mutex> lock(m_mtx);
+            m_cvPushed.wait(lock, [this]() {
+                return m_qEncoding.size() > 0 || m_bFinish;
+            });
+            if (m_qEncoding.size() == 0) {
+                break;
+            }
+            pEncodeBuffer = m_qEncoding.front();
+            sts = m_err;
+        }
+        //エラー後は取り出しを行わず、出力バッファを処理済みとする
+        bool bCollected = false;
+        if (sts == NV_ENC_SUCCESS) {
+            while ((sts = m_funcs.waitFin(pEncodeBuffer, NVENC_BITSTREAM_COLLECT_WAIT_MS)) == NV_ENC_ERR_ENCODER_BUSY) {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                if (m_bAbort) {
+                    sts = NV_ENC_ERR_ENCODER_BUSY;
+                    break;
+                }
+            }
+            if (sts == NV_ENC_SUCCESS) {
+                m_bitstream.setSize(0);
+                sts = m_funcs.copy(pEncodeBuffer, &m_bitstream);
+                bCollected = (sts == NV_ENC_SUCCESS);
+            }
+        }
+        {
+            //ビットストリームはコピー済みなので、出力の前に出力バッファを再利用可能とする
+            std::lock_guard<std::mutex> lock(m_mtx);
+            if (sts != NV_ENC_SUCCESS && m_err == NV_ENC_SUCCESS) {
+                m_err = sts;
+            }
+            m_qEncoding.pop_front();
+            m_qCollected.push_back(pEncodeBuffer);
+            m_cvCollected.notify_all();
+        }
+        if (bCollected && m_bitstream.size() > 0) {
+            if (NV_ENC_SUCCESS != (sts = m_funcs.write(&m_bitstream))) {
+                setError(sts);
+            } else {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                m_nFrames++;
+            }
+        }
+    }
+}
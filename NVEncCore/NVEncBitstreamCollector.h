@@ -0,0 +1,100 @@
+﻿// -----------------------------------------------------------------------------------------
+// NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+//
+// The MIT License
+//
+// Copyright (c) 2014-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// ------------------------------------------------------------------------------------------
+#pragma once
+#ifndef __NVENC_BITSTREAM_COLLECTOR_H__
+#define __NVENC_BITSTREAM_COLLECTOR_H__
+
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "NVEncUtil.h"
+#include "NVEncoderPerf.h"
+
+//エンコードの終了を待機する間隔 (ms)、この間隔で中断の確認を行う
+static const uint32_t NVENC_BITSTREAM_COLLECT_WAIT_MS = 100;
+
+//エンコードを開始した出力バッファを別スレッドで待機し、ビットストリームを取り出して出力に渡す
+//  メインループはエンコーダへのフレーム投入を続け、出力バッファを再利用するときにのみ取り出しの終了を待つ
+//  出力バッファは投入順に処理し、出力の順序も投入順となる
+//  エンコーダAPIの呼び出しはFuncsとして与えるので、エンコーダなしで動作を確認できる
+class NVEncBitstreamCollector {
+public:
+    struct Funcs {
+        //出力バッファのエンコードの終了を待機する (timeoutMsで終了しなければ、NV_ENC_ERR_ENCODER_BUSYを返す)
+        std::function<NVENCSTATUS(const EncodeBuffer *pEncodeBuffer, uint32_t timeoutMs)> waitFin;
+        //出力バッファをロックしてビットストリームをコピーし、アンロックする
+        std::function<NVENCSTATUS(const EncodeBuffer *pEncodeBuffer, RGYBitstream *pBitstream)> copy;
+        //ビットストリームを出力する
+        std::function<NVENCSTATUS(RGYBitstream *pBitstream)> write;
+    };
+
+    NVEncBitstreamCollector();
+    ~NVEncBitstreamCollector();
+
+    //取り出しスレッドを開始する
+    NVENCSTATUS start(const Funcs& funcs);
+    //エンコードを開始した出力バッファを追加する
+    NVENCSTATUS push(const EncodeBuffer *pEncodeBuffer);
+    //最も古い出力バッファ(pEncodeBuffer)からの取り出しの終了を待機する
+    //終了すれば、pEncodeBufferは再利用可能
+    NVENCSTATUS waitOldest(const EncodeBuffer *pEncodeBuffer);
+    //すべての出力バッファの処理を待って、スレッドを終了する
+    NVENCSTATUS finish();
+    //エンコードの終了を待たずに、スレッドを終了する
+    void abort();
+
+    //取り出しの終了していない出力バッファの数
+    size_t pending();
+    //出力したフレーム数
+    int64_t frames();
+    //エラーの状態
+    NVENCSTATUS error();
+    HANDLE threadHandle() {
+        return (m_thread.joinable()) ? (HANDLE)m_thread.native_handle() : NULL;
+    }
+protected:
+    void run();
+    void setError(NVENCSTATUS sts);
+
+    Funcs m_funcs;
+    std::thread m_thread;
+    std::mutex m_mtx;
+    std::condition_variable m_cvPushed;    //出力バッファが追加された
+    std::condition_variable m_cvCollected; //出力バッファからの取り出しが終了した
+    std::deque<const EncodeBuffer *> m_qEncoding;  //取り出し待ちの出力バッファ
+    std::deque<const EncodeBuffer *> m_qCollected; //取り出しが終了し、再利用可能な出力バッファ
+    RGYBitstream m_bitstream; //取り出したビットストリームのコピー先 (使いまわす)
+    int64_t m_nFrames;
+    NVENCSTATUS m_err;
+    bool m_bFinish;
+    bool m_bAbort;
+};
+
+#endif //__NVENC_BITSTREAM_COLLECTOR_H__
@@ -35,6 +35,7 @@
 #include <shellapi.h>
 #include "rgy_version.h"
 #include "rgy_perf_monitor.h"
+#include "rgy_staging_ring.h"
 #include "NVEncParam.h"
 #include "NVEncCmd.h"
 #include "NVEncFilterAfs.h"
@@ -252,12 +253,82 @@ int parse_one_option(const TCHAR *option_name, const TCHAR* strInput[], int& i,
         }
         return 0;
     }
+    if (IS_OPTION("output-rendition")) {
+        i++;
+        NVEncRenditionParam rendition;
+        for (const auto& param : split(strInput[i], _T(","))) {
+            auto pos = param.find_first_of(_T("="));
+            if (pos != std::string::npos) {
+                auto param_arg = param.substr(0, pos);
+                auto param_val = param.substr(pos+1);
+                std::transform(param_arg.begin(), param_arg.end(), param_arg.begin(), tolower);
+                if (param_arg == _T("output")) {
+                    rendition.outputFilename = param_val;
+                    continue;
+                }
+                if (param_arg == _T("res")) {
+                    int a[2] = { 0 };
+                    if (   2 == _stscanf_s(param_val.c_str(), _T("%dx%d"), &a[0], &a[1])
+                        || 2 == _stscanf_s(param_val.c_str(), _T("%d:%d"), &a[0], &a[1])) {
+                        rendition.width  = a[0];
+                        rendition.height = a[1];
+                    } else {
+                        SET_ERR(strInput[0], _T("Unknown value"), option_name, strInput[i]);
+                        return -1;
+                    }
+                    continue;
+                }
+                if (param_arg == _T("bitrate")) {
+                    try {
+                        rendition.bitrate = std::stoi(param_val);
+                    } catch (...) {
+                        SET_ERR(strInput[0], _T("Unknown value"), option_name, strInput[i]);
+                        return -1;
+                    }
+                    continue;
+                }
+                if (param_arg == _T("max-bitrate")) {
+                    try {
+                        rendition.maxBitrate = std::stoi(param_val);
+                    } catch (...) {
+                        SET_ERR(strInput[0], _T("Unknown value"), option_name, strInput[i]);
+                        return -1;
+                    }
+                    continue;
+                }
+            }
+            SET_ERR(strInput[0], _T("Unknown value"), option_name, strInput[i]);
+            return -1;
+        }
+        if (rendition.outputFilename.length() == 0
+            || rendition.width <= 0 || rendition.height <= 0
+            || rendition.bitrate < 0 || rendition.maxBitrate < 0) {
+            SET_ERR(strInput[0], _T("Invalid value"), option_name, strInput[i]);
+            return -1;
+        }
+        pParams->renditions.push_back(rendition);
+        return 0;
+    }
     if (IS_OPTION("crop")) {
         i++;
         sInputCrop a = { 0 };
-        if (   4 == _stscanf_s(strInput[i], _T("%d,%d,%d,%d"), &a.c[0], &a.c[1], &a.c[2], &a.c[3])
+        int value = 0;
+        //指定値で上書きされないよう、自動検出の場合はcropを初期化しておく
+        if (0 == _tcsncmp(strInput[i], _T("auto"), 4)) {
+            memset(&pParams->input.crop, 0, sizeof(pParams->input.crop));
+        }
+        if (0 == _tcscmp(strInput[i], _T("auto"))) {
+            pParams->nAutoCrop = RGY_AUTOCROP_SAMPLES_DEFAULT;
+        } else if (1 == _stscanf_s(strInput[i], _T("auto:%d"), &value)) {
+            if (value <= 0 || RGY_AUTOCROP_SAMPLES_MAX < value) {
+                SET_ERR(strInput[0], _T("Invalid value"), option_name, strInput[i]);
+                return -1;
+            }
+            pParams->nAutoCrop = value;
+        } else if (4 == _stscanf_s(strInput[i], _T("%d,%d,%d,%d"), &a.c[0], &a.c[1], &a.c[2], &a.c[3])
             || 4 == _stscanf_s(strInput[i], _T("%d:%d:%d:%d"), &a.c[0], &a.c[1], &a.c[2], &a.c[3])) {
             memcpy(&pParams->input.crop, &a, sizeof(a));
+            pParams->nAutoCrop = 0;
         } else {
             SET_ERR(strInput[0], _T("Unknown value"), option_name, strInput[i]);
             return -1;
@@ -279,6 +350,10 @@ int parse_one_option(const TCHAR *option_name, const TCHAR* strInput[], int& i,
         pParams->input.type = RGY_INPUT_FMT_RAW;
         return 0;
     }
+    if (IS_OPTION("shm")) {
+        pParams->input.type = RGY_INPUT_FMT_SHM;
+        return 0;
+    }
     if (IS_OPTION("y4m")) {
         pParams->input.type = RGY_INPUT_FMT_Y4M;
 #if ENABLE_AVI_READER
@@ -750,6 +825,42 @@ int parse_one_option(const TCHAR *option_name, const TCHAR* strInput[], int& i,
         pParams->bCopyChapter = TRUE;
         return 0;
     }
+    if (0 == _tcscmp(option_name, _T("remux"))) {
+        pParams->bRemux = true;
+        return 0;
+    }
+    if (0 == _tcscmp(option_name, _T("bitstream-stats"))) {
+        pParams->bBitstreamStats = true;
+        return 0;
+    }
+    if (0 == _tcscmp(option_name, _T("psnr"))) {
+        pParams->bMetricPsnr = true;
+        return 0;
+    }
+    if (0 == _tcscmp(option_name, _T("ssim"))) {
+        pParams->bMetricSsim = true;
+        return 0;
+    }
+    if (0 == _tcscmp(option_name, _T("metric-log"))) {
+        if (i+1 < nArgNum && strInput[i+1][0] != _T('-')) {
+            i++;
+            pParams->sMetricLog = strInput[i];
+        } else {
+            SET_ERR(strInput[0], _T("Invalid value"), option_name, strInput[i+1]);
+            return 1;
+        }
+        return 0;
+    }
+    if (0 == _tcscmp(option_name, _T("metric-ref"))) {
+        if (i+1 < nArgNum && strInput[i+1][0] != _T('-')) {
+            i++;
+            pParams->sMetricRef = strInput[i];
+        } else {
+            SET_ERR(strInput[0], _T("Invalid value"), option_name, strInput[i+1]);
+            return 1;
+        }
+        return 0;
+    }
     if (0 == _tcscmp(option_name, _T("chapter"))) {
         if (i+1 < nArgNum && strInput[i+1][0] != _T('-')) {
             i++;
@@ -805,6 +916,61 @@ int parse_one_option(const TCHAR *option_name, const TCHAR* strInput[], int& i,
         }
         return 0;
     }
+    if (IS_OPTION("dedup")) {
+        pParams->dedup.enable = true;
+        if (i+1 >= nArgNum || strInput[i+1][0] == _T('-')) {
+            return 0;
+        }
+        i++;
+        for (const auto& param : split(strInput[i], _T(","))) {
+            auto pos = param.find_first_of(_T("="));
+            if (pos != std::string::npos) {
+                auto param_arg = param.substr(0, pos);
+                auto param_val = param.substr(pos+1);
+                std::transform(param_arg.begin(), param_arg.end(), param_arg.begin(), tolower);
+                if (param_arg == _T("enable")) {
+                    if (param_val == _T("true")) {
+                        pParams->dedup.enable = true;
+                    } else if (param_val == _T("false")) {
+                        pParams->dedup.enable = false;
+                    } else {
+                        SET_ERR(strInput[0], _T("Unknown value"), option_name, strInput[i]);
+                        return -1;
+                    }
+                    continue;
+                }
+                if (param_arg == _T("threshold")) {
+                    try {
+                        pParams->dedup.threshold = std::stof(param_val);
+                    } catch (...) {
+                        SET_ERR(strInput[0], _T("Unknown value"), option_name, strInput[i]);
+                        return -1;
+                    }
+                    if (pParams->dedup.threshold < 0.0f) {
+                        SET_ERR(strInput[0], _T("Invalid value"), option_name, strInput[i]);
+                        return -1;
+                    }
+                    continue;
+                }
+                if (param_arg == _T("max-drop")) {
+                    try {
+                        pParams->dedup.maxDrop = std::stoi(param_val);
+                    } catch (...) {
+                        SET_ERR(strInput[0], _T("Unknown value"), option_name, strInput[i]);
+                        return -1;
+                    }
+                    if (pParams->dedup.maxDrop < 0) {
+                        SET_ERR(strInput[0], _T("Invalid value"), option_name, strInput[i]);
+                        return -1;
+                    }
+                    continue;
+                }
+                SET_ERR(strInput[0], _T("Unknown value"), option_name, strInput[i]);
+                return -1;
+            }
+        }
+        return 0;
+    }
     if (0 == _tcscmp(option_name, _T("mux-option"))) {
         if (i+1 < nArgNum && strInput[i+1][0] != _T('-')) {
             i++;
@@ -824,6 +990,65 @@ int parse_one_option(const TCHAR *option_name, const TCHAR* strInput[], int& i,
         }
         return 0;
     }
+    if (IS_OPTION("fmp4")) {
+        pParams->fmp4.enable = true;
+        if (i+1 >= nArgNum || strInput[i+1][0] == _T('-')) {
+            return 0;
+        }
+        i++;
+        for (const auto& param : split(strInput[i], _T(","))) {
+            auto pos = param.find_first_of(_T("="));
+            if (pos != std::string::npos) {
+                auto param_arg = param.substr(0, pos);
+                auto param_val = param.substr(pos+1);
+                std::transform(param_arg.begin(), param_arg.end(), param_arg.begin(), tolower);
+                if (param_arg == _T("enable")) {
+                    if (param_val == _T("true")) {
+                        pParams->fmp4.enable = true;
+                    } else if (param_val == _T("false")) {
+                        pParams->fmp4.enable = false;
+                    } else {
+                        SET_ERR(strInput[0], _T("Unknown value"), option_name, strInput[i]);
+                        return -1;
+                    }
+                    continue;
+                }
+                if (param_arg == _T("frag")) {
+                    if (param_val == _T("idr")) {
+                        pParams->fmp4.fragMs = 0;
+                        continue;
+                    }
+                    try {
+                        pParams->fmp4.fragMs = std::stoi(param_val);
+                    } catch (...) {
+                        SET_ERR(strInput[0], _T("Unknown value"), option_name, strInput[i]);
+                        return -1;
+                    }
+                    if (pParams->fmp4.fragMs < 0) {
+                        SET_ERR(strInput[0], _T("Invalid value"), option_name, strInput[i]);
+                        return -1;
+                    }
+                    continue;
+                }
+                if (param_arg == _T("segment")) {
+                    try {
+                        pParams->fmp4.segmentSec = std::stof(param_val);
+                    } catch (...) {
+                        SET_ERR(strInput[0], _T("Unknown value"), option_name, strInput[i]);
+                        return -1;
+                    }
+                    if (pParams->fmp4.segmentSec < 0.0f) {
+                        SET_ERR(strInput[0], _T("Invalid value"), option_name, strInput[i]);
+                        return -1;
+                    }
+                    continue;
+                }
+                SET_ERR(strInput[0], _T("Unknown value"), option_name, strInput[i]);
+                return -1;
+            }
+        }
+        return 0;
+    }
     if (IS_OPTION("cqp")) {
         i++;
         int a[3] = { 0 };
@@ -1313,6 +1538,29 @@ int parse_one_option(const TCHAR *option_name, const TCHAR* strInput[], int& i,
         pParams->vpp.delogo.nMode = DELOGO_MODE_ADD;
         return 0;
     }
+    if (IS_OPTION("vpp-delogo-auto-fade")) {
+        pParams->vpp.delogo.bAutoFade = true;
+        return 0;
+    }
+    if (IS_OPTION("vpp-delogo-auto-select")) {
+        if (i+1 >= nArgNum || strInput[i+1][0] == _T('-')) {
+            pParams->vpp.delogo.nAutoSelectFrames = FILTER_DEFAULT_DELOGO_AUTO_SELECT_FRAMES;
+            return 0;
+        }
+        i++;
+        int value;
+        if (1 != _stscanf_s(strInput[i], _T("%d"), &value) || value < 0) {
+            SET_ERR(strInput[0], _T("Unknown value"), option_name, strInput[i]);
+            return -1;
+        }
+        pParams->vpp.delogo.nAutoSelectFrames = value;
+        return 0;
+    }
+    if (IS_OPTION("vpp-delogo-log")) {
+        i++;
+        pParams->vpp.delogo.pLogPath = _tcsdup(strInput[i]);
+        return 0;
+    }
     if (IS_OPTION("vpp-delogo-pos")) {
         i++;
         int posOffsetX, posOffsetY;
@@ -1852,6 +2100,10 @@ int parse_one_option(const TCHAR *option_name, const TCHAR* strInput[], int& i,
                     pParams->vpp.afs.log = (param_val == _T("true")) || (param_val == _T("on"));
                     continue;
                 }
+                if (param_arg == _T("cpu")) {
+                    pParams->vpp.afs.cpu = (param_val == _T("true")) || (param_val == _T("on"));
+                    continue;
+                }
                 if (param_arg == _T("ini")) {
                     continue;
                 }
@@ -2218,6 +2470,11 @@ int parse_one_option(const TCHAR *option_name, const TCHAR* strInput[], int& i,
         pParams->sMasterDisplay = tchar_to_string(strInput[i]);
         return 0;
     }
+    if (IS_OPTION("dhdr10-info")) {
+        i++;
+        pParams->sDynamicHdr10plus = strInput[i];
+        return 0;
+    }
     if (IS_OPTION("output-depth")) {
         i++;
         int value = 0;
@@ -2281,6 +2538,16 @@ int parse_one_option(const TCHAR *option_name, const TCHAR* strInput[], int& i,
         }
         return 0;
     }
+    if (IS_OPTION("thread-affinity")) {
+        i++;
+        RGYThreadAffinity affinity;
+        if (affinity.parse(strInput[i])) {
+            SET_ERR(strInput[0], _T("Unknown value"), option_name, strInput[i]);
+            return -1;
+        }
+        pParams->threadAffinity = affinity;
+        return 0;
+    }
     if (IS_OPTION("max-procfps")) {
         i++;
         int value = 0;
@@ -2370,6 +2637,52 @@ int parse_one_option(const TCHAR *option_name, const TCHAR* strInput[], int& i,
         pParams->nOutputThread = value;
         return 0;
     }
+    if (0 == _tcscmp(option_name, _T("bitstream-thread"))) {
+        i++;
+        int value = 0;
+        if (1 != _stscanf_s(strInput[i], _T("%d"), &value)) {
+            SET_ERR(strInput[0], _T("Unknown value"), option_name, strInput[i]);
+            return 1;
+        }
+        if (value < -1 || value >= 2) {
+            SET_ERR(strInput[0], _T("Invalid value"), option_name, strInput[i]);
+            return 1;
+        }
+        pParams->nBitstreamThread = value;
+        return 0;
+    }
+    if (0 == _tcscmp(option_name, _T("input-staging-depth"))) {
+        i++;
+        if (0 == _tcscmp(strInput[i], _T("auto"))) {
+            pParams->nInputStagingDepth = 0;
+            return 0;
+        }
+        int value = 0;
+        if (1 != _stscanf_s(strInput[i], _T("%d"), &value)) {
+            SET_ERR(strInput[0], _T("Unknown value"), option_name, strInput[i]);
+            return 1;
+        }
+        if (value != 0 && (value < RGY_STAGING_RING_DEPTH_MIN || RGY_STAGING_RING_DEPTH_MAX < value)) {
+            SET_ERR(strInput[0], _T("Invalid value"), option_name, strInput[i]);
+            return 1;
+        }
+        pParams->nInputStagingDepth = value;
+        return 0;
+    }
+    if (0 == _tcscmp(option_name, _T("avs-prefetch"))) {
+        i++;
+        int value = 0;
+        if (1 != _stscanf_s(strInput[i], _T("%d"), &value)) {
+            SET_ERR(strInput[0], _T("Unknown value"), option_name, strInput[i]);
+            return 1;
+        }
+        if (value < 0 || RGY_AVS_PREFETCH_MAX < value) {
+            SET_ERR(strInput[0], _T("Invalid value"), option_name, strInput[i]);
+            return 1;
+        }
+        pParams->nAvsPrefetch = value;
+        return 0;
+    }
     if (0 == _tcscmp(option_name, _T("audio-thread"))) {
         i++;
         int value = 0;
@@ -2593,12 +2906,18 @@ tstring gen_cmd(const InEncodeVideoParam *pParams, const NV_ENC_CODEC_CONFIG cod
     case RGY_INPUT_FMT_VPY_MT: cmd << _T(" --vpy-mt"); break;
     case RGY_INPUT_FMT_AVHW:   cmd << _T(" --avhw"); break;
     case RGY_INPUT_FMT_AVSW:   cmd << _T(" --avsw"); break;
+    case RGY_INPUT_FMT_SHM:    cmd << _T(" --shm"); break;
     default: break;
     }
     if (save_disabled_prm || pParams->input.picstruct != RGY_PICSTRUCT_FRAME) {
         OPT_LST(_T("--interlace"), input.picstruct, list_interlaced);
     }
-    if (cropEnabled(pParams->input.crop)) {
+    if (pParams->nAutoCrop > 0) {
+        cmd << _T(" --crop auto");
+        if (pParams->nAutoCrop != RGY_AUTOCROP_SAMPLES_DEFAULT) {
+            cmd << _T(":") << pParams->nAutoCrop;
+        }
+    } else if (cropEnabled(pParams->input.crop)) {
         cmd << _T(" --crop ") << pParams->input.crop.e.left << _T(",") << pParams->input.crop.e.up
             << _T(",") << pParams->input.crop.e.right << _T(",") << pParams->input.crop.e.bottom;
     }
@@ -2611,6 +2930,15 @@ tstring gen_cmd(const InEncodeVideoParam *pParams, const NV_ENC_CODEC_CONFIG cod
     if (pParams->input.dstWidth * pParams->input.dstHeight > 0) {
         cmd << _T(" --output-res ") << pParams->input.dstWidth << _T("x") << pParams->input.dstHeight;
     }
+    for (const auto& rendition : pParams->renditions) {
+        cmd << _T(" --output-rendition output=\"") << rendition.outputFilename << _T("\",res=") << rendition.width << _T("x") << rendition.height;
+        if (rendition.bitrate > 0) {
+            cmd << _T(",bitrate=") << rendition.bitrate;
+        }
+        if (rendition.maxBitrate > 0) {
+            cmd << _T(",max-bitrate=") << rendition.maxBitrate;
+        }
+    }
     if (save_disabled_prm) {
         switch (pParams->encConfig.rcParams.rateControlMode) {
         case NV_ENC_PARAMS_RC_CBR:
@@ -2701,6 +3029,7 @@ tstring gen_cmd(const InEncodeVideoParam *pParams, const NV_ENC_CODEC_CONFIG cod
         OPT_LST_HEVC(_T("--transfer"), _T(":hevc"), hevcVUIParameters.transferCharacteristics, list_transfer);
         OPT_STR(_T("--max-cll"), sMaxCll);
         OPT_STR(_T("--master-display"), sMasterDisplay);
+        OPT_STR_PATH(_T("--dhdr10-info"), sDynamicHdr10plus);
         OPT_LST_HEVC(_T("--cu-max"), _T(""), maxCUSize, list_hevc_cu_size);
         OPT_LST_HEVC(_T("--cu-min"), _T(""), minCUSize, list_hevc_cu_size);
     }
@@ -2847,6 +3176,12 @@ tstring gen_cmd(const InEncodeVideoParam *pParams, const NV_ENC_CODEC_CONFIG cod
     tmp.str(tstring());
     OPT_STR_PATH(_T("--chapter"), sChapterFile);
     OPT_BOOL(_T("--chapter-copy"), _T(""), bCopyChapter);
+    OPT_BOOL(_T("--remux"), _T(""), bRemux);
+    OPT_BOOL(_T("--bitstream-stats"), _T(""), bBitstreamStats);
+    OPT_BOOL(_T("--psnr"), _T(""), bMetricPsnr);
+    OPT_BOOL(_T("--ssim"), _T(""), bMetricSsim);
+    OPT_STR_PATH(_T("--metric-log"), sMetricLog);
+    OPT_STR_PATH(_T("--metric-ref"), sMetricRef);
     //OPT_BOOL(_T("--chapter-no-trim"), _T(""), bChapterNoTrim);
     OPT_LST(_T("--avsync"), nAVSyncMode, list_avsync);
 #endif //#if ENABLE_AVSW_READER
@@ -2862,6 +3197,36 @@ tstring gen_cmd(const InEncodeVideoParam *pParams, const NV_ENC_CODEC_CONFIG cod
 #define ADD_CHAR(str, opt) if ((pParams->opt) && _tcslen(pParams->opt)) tmp << _T(",") << (str) << _T("=") << (pParams->opt);
 #define ADD_STR(str, opt) if (pParams->opt.length() > 0) tmp << _T(",") << (str) << _T("=") << (pParams->opt.c_str());
 
+    if (pParams->dedup != encPrmDefault.dedup) {
+        tmp.str(tstring());
+        if (!pParams->dedup.enable && save_disabled_prm) {
+            tmp << _T(",enable=false");
+        }
+        if (pParams->dedup.enable || save_disabled_prm) {
+            ADD_FLOAT(_T("threshold"), dedup.threshold, 3);
+            ADD_NUM(_T("max-drop"), dedup.maxDrop);
+        }
+        if (!tmp.str().empty()) {
+            cmd << _T(" --dedup ") << tmp.str().substr(1);
+        } else if (pParams->dedup.enable) {
+            cmd << _T(" --dedup");
+        }
+    }
+    if (pParams->fmp4 != encPrmDefault.fmp4) {
+        tmp.str(tstring());
+        if (!pParams->fmp4.enable && save_disabled_prm) {
+            tmp << _T(",enable=false");
+        }
+        if (pParams->fmp4.enable || save_disabled_prm) {
+            ADD_NUM(_T("frag"), fmp4.fragMs);
+            ADD_FLOAT(_T("segment"), fmp4.segmentSec, 3);
+        }
+        if (!tmp.str().empty()) {
+            cmd << _T(" --fmp4 ") << tmp.str().substr(1);
+        } else if (pParams->fmp4.enable) {
+            cmd << _T(" --fmp4");
+        }
+    }
     if (pParams->vpp.afs != encPrmDefault.vpp.afs) {
         tmp.str(tstring());
         if (!pParams->vpp.afs.enable && save_disabled_prm) {
@@ -2887,6 +3252,7 @@ tstring gen_cmd(const InEncodeVideoParam *pParams, const NV_ENC_CODEC_CONFIG cod
             ADD_BOOL(_T("rff"), vpp.afs.rff);
             ADD_BOOL(_T("timecode"), vpp.afs.timecode);
             ADD_BOOL(_T("log"), vpp.afs.log);
+            ADD_BOOL(_T("cpu"), vpp.afs.cpu);
         }
         if (!tmp.str().empty()) {
             cmd << _T(" --vpp-afs ") << tmp.str().substr(1);
@@ -3022,13 +3388,22 @@ tstring gen_cmd(const InEncodeVideoParam *pParams, const NV_ENC_CODEC_CONFIG cod
     OPT_NUM(_T("--vpp-delogo-y"), vpp.delogo.nYOffset);
     OPT_NUM(_T("--vpp-delogo-cb"), vpp.delogo.nCbOffset);
     OPT_NUM(_T("--vpp-delogo-cr"), vpp.delogo.nCrOffset);
+    OPT_BOOL(_T("--vpp-delogo-auto-fade"), _T(""), vpp.delogo.bAutoFade);
+    OPT_CHAR_PATH(_T("--vpp-delogo-log"), vpp.delogo.pLogPath);
+    OPT_NUM(_T("--vpp-delogo-auto-select"), vpp.delogo.nAutoSelectFrames);
     OPT_BOOL(_T("--vpp-perf-monitor"), _T("--no-vpp-perf-monitor"), vpp.bCheckPerformance);
 
     OPT_LST(_T("--cuda-schedule"), nCudaSchedule, list_cuda_schedule);
     OPT_NUM(_T("--output-buf"), nOutputBufSizeMB);
     OPT_NUM(_T("--output-thread"), nOutputThread);
     OPT_NUM(_T("--input-thread"), nInputThread);
+    OPT_NUM(_T("--input-staging-depth"), nInputStagingDepth);
+    OPT_NUM(_T("--avs-prefetch"), nAvsPrefetch);
+    OPT_NUM(_T("--bitstream-thread"), nBitstreamThread);
     OPT_NUM(_T("--audio-thread"), nAudioThread);
+    if (pParams->threadAffinity != encPrmDefault.threadAffinity) {
+        cmd << _T(" --thread-affinity ") << pParams->threadAffinity.to_string();
+    }
     OPT_NUM(_T("--max-procfps"), nProcSpeedLimit);
     OPT_STR_PATH(_T("--log"), logfile);
     OPT_LST(_T("--log-level"), loglevel, list_log_level);
@@ -37,6 +37,7 @@
 #include <string>
 #include <algorithm>
 #include <thread>
+#include <chrono>
 #include <tchar.h>
 #pragma warning(push)
 #pragma warning(disable: 4819)
@@ -57,6 +58,8 @@
 #include "rgy_input_avs.h"
 #include "rgy_input_vpy.h"
 #include "rgy_input_avcodec.h"
+#include "rgy_input_shm.h"
+#include "rgy_autocrop.h"
 #include "rgy_output.h"
 #include "rgy_output_avcodec.h"
 #include "NVEncParam.h"
@@ -126,7 +129,7 @@ public:
     }
     void setHostFrameInfo(
         const FrameInfo& frameInfo, //入力フレームへのポインタと情報
-        shared_ptr<void> heTransferFin //入力フレームに関連付けられたイベント、このフレームが不要になったらSetする
+        shared_ptr<void> heTransferFin //入力フレームのバッファの参照、このフレームが不要になったら解放する
     ) {
         m_pInfo.reset();
         memset(&m_oVPP, 0, sizeof(m_oVPP));
@@ -326,6 +329,13 @@ NVEncCore::NVEncCore() {
     m_uEncodeBufferCount = 16;
     m_pDevice = nullptr;
     m_nDeviceId = 0;
+    m_nGPUNumaNode = -1;
+    m_nInputStagingDepth = 0;
+    m_nInputHostBufferSize = 0;
+    m_nBitstreamThread = RGY_OUTPUT_THREAD_AUTO;
+    m_nEncodeFrameIdx = 0;
+    m_pRenditionParent = nullptr;
+    m_nRenditionIndex = -1;
     m_pAbortByUser = nullptr;
     m_trimParam.list.clear();
     m_trimParam.offset = 0;
@@ -337,6 +347,23 @@ NVEncCore::NVEncCore() {
     memset(&m_stEncodeBuffer, 0, sizeof(m_stEncodeBuffer));
 }
 
+void NVEncCore::setThreadAffinity(RGYThreadType type, HANDLE thread) {
+    if (thread == NULL) {
+        return;
+    }
+    const auto mask = m_threadAffinity.getMask(type, m_nGPUNumaNode);
+    if (mask.empty()) {
+        return;
+    }
+    if (rgy_set_thread_affinity(thread, mask)) {
+        PrintMes(RGY_LOG_INFO, _T("Set thread affinity of %s thread: %s (cpu %s).\n"),
+            get_chr_from_value(list_thread_type, type), m_threadAffinity.get(type).to_string().c_str(), mask.to_string().c_str());
+    } else {
+        PrintMes(RGY_LOG_WARN, _T("Failed to set thread affinity of %s thread: %s (cpu %s).\n"),
+            get_chr_from_value(list_thread_type, type), m_threadAffinity.get(type).to_string().c_str(), mask.to_string().c_str());
+    }
+}
+
 NVEncCore::~NVEncCore() {
     Deinitialize();
 
@@ -497,6 +524,48 @@ NVENCSTATUS NVEncCore::InitInput(InEncodeVideoParam *inputParam) {
         PrintMes(RGY_LOG_ERROR, _T("avsw reader not compiled in this binary.\n"));
         return NV_ENC_ERR_UNSUPPORTED_PARAM;
     }
+    if (inputParam->input.type == RGY_INPUT_FMT_SHM && !ENABLE_SHM_READER) {
+        PrintMes(RGY_LOG_ERROR, _T("shm reader not compiled in this binary.\n"));
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+    }
+
+    //映像をデコードせず、パケットのまま読み込むか
+    const bool bVideoCopy = inputParam->bRemux || inputParam->bBitstreamStats || inputParam->sMetricRef.length() > 0;
+
+    //重複フレームの間引きはCPU側でフレームを比較するため、HWデコードは使用しない
+    if (inputParam->dedup.enable && !bVideoCopy) {
+        if (inputParam->input.type == RGY_INPUT_FMT_AVHW) {
+            PrintMes(RGY_LOG_ERROR, _T("--dedup cannot be used with avhw reader, use avsw reader instead.\n"));
+            return NV_ENC_ERR_UNSUPPORTED_PARAM;
+        }
+        if (inputParam->input.type == RGY_INPUT_FMT_AVANY) {
+            PrintMes(RGY_LOG_DEBUG, _T("avsw reader selected for --dedup.\n"));
+            inputParam->input.type = RGY_INPUT_FMT_AVSW;
+        }
+    }
+    //PSNR/SSIMの計測も、CPU上の入力フレームを比較元とする
+    const bool bMetric = inputParam->bMetricPsnr || inputParam->bMetricSsim || inputParam->sMetricLog.length() > 0;
+    if (bMetric && !bVideoCopy) {
+        if (inputParam->input.type == RGY_INPUT_FMT_AVHW) {
+            PrintMes(RGY_LOG_ERROR, _T("--psnr/--ssim cannot be used with avhw reader, use avsw reader instead.\n"));
+            return NV_ENC_ERR_UNSUPPORTED_PARAM;
+        }
+        if (inputParam->input.type == RGY_INPUT_FMT_AVANY) {
+            PrintMes(RGY_LOG_DEBUG, _T("avsw reader selected for --psnr/--ssim.\n"));
+            inputParam->input.type = RGY_INPUT_FMT_AVSW;
+        }
+    }
+
+    //黒帯を自動検出し、入力を開く前にcropを設定する
+    if (inputParam->nAutoCrop > 0 && !bVideoCopy) {
+        sInputCrop autoCrop = { 0 };
+        if (RGY_ERR_NONE == RGYAutoCropDetect(&autoCrop, inputParam->inputFilename.c_str(), &inputParam->input, inputParam->fSeekSec, inputParam->nAutoCrop, m_pNVLog)) {
+            inputParam->input.crop = autoCrop;
+            PrintMes(RGY_LOG_INFO, _T("autocrop: %d,%d,%d,%d\n"), autoCrop.e.left, autoCrop.e.up, autoCrop.e.right, autoCrop.e.bottom);
+        } else {
+            PrintMes(RGY_LOG_WARN, _T("autocrop: black borders could not be detected, encode without crop.\n"));
+        }
+    }
 
 #if ENABLE_AVSW_READER
     AvcodecReaderPrm inputInfoAVCuvid = { 0 };
@@ -504,6 +573,9 @@ NVENCSTATUS NVEncCore::InitInput(InEncodeVideoParam *inputParam) {
     for (const auto& gpu : m_GPUList) {
         HWDecCodecCsp.push_back(std::make_pair(gpu.id, gpu.cuvid_csp));
     }
+#endif
+#if ENABLE_AVISYNTH_READER
+    RGYInputAvsPrm inputInfoAvs = { 0 };
 #endif
     void *pInputPrm = nullptr;
 
@@ -516,6 +588,9 @@ NVENCSTATUS NVEncCore::InitInput(InEncodeVideoParam *inputParam) {
 #endif //ENABLE_AVI_READER
 #if ENABLE_AVISYNTH_READER
     case RGY_INPUT_FMT_AVS:
+        inputInfoAvs.prefetch = inputParam->nAvsPrefetch;
+        inputInfoAvs.pQueueInfo = (m_pPerfMonitor) ? m_pPerfMonitor->GetQueueInfoPtr() : nullptr;
+        pInputPrm = &inputInfoAvs;
         PrintMes(RGY_LOG_DEBUG, _T("avs reader selected.\n"));
         m_pFileReader.reset(new RGYInputAvs());
         break;
@@ -555,12 +630,21 @@ NVENCSTATUS NVEncCore::InitInput(InEncodeVideoParam *inputParam) {
         inputInfoAVCuvid.nInputThread = inputParam->nInputThread;
         inputInfoAVCuvid.pQueueInfo = (m_pPerfMonitor) ? m_pPerfMonitor->GetQueueInfoPtr() : nullptr;
         inputInfoAVCuvid.pHWDecCodecCsp = &HWDecCodecCsp;
+        inputInfoAVCuvid.bVideoCopy = bVideoCopy;
         inputInfoAVCuvid.bVideoDetectPulldown = !inputParam->vpp.rff && !inputParam->vpp.afs.enable && inputParam->nAVSyncMode == RGY_AVSYNC_ASSUME_CFR;
+        //エンコード時にptsからフレーム情報を参照する場合 (NVEncCore::Encodeを参照)
+        inputInfoAVCuvid.bFramePosLookup = (inputParam->nAVSyncMode & (RGY_AVSYNC_VFR | RGY_AVSYNC_FORCE_CFR)) || inputParam->vpp.rff || (inputParam->vpp.afs.enable && inputParam->vpp.afs.rff);
         pInputPrm = &inputInfoAVCuvid;
         PrintMes(RGY_LOG_DEBUG, _T("avhw reader selected.\n"));
         m_pFileReader.reset(new RGYInputAvcodec());
         break;
 #endif //#if ENABLE_AVSW_READER
+#if ENABLE_SHM_READER
+    case RGY_INPUT_FMT_SHM:
+        PrintMes(RGY_LOG_DEBUG, _T("shm reader selected.\n"));
+        m_pFileReader.reset(new RGYInputShm());
+        break;
+#endif //#if ENABLE_SHM_READER
     case RGY_INPUT_FMT_RAW:
     case RGY_INPUT_FMT_Y4M:
     default:
@@ -709,18 +793,51 @@ NVENCSTATUS NVEncCore::InitInput(InEncodeVideoParam *inputParam) {
 #pragma warning(pop)
 
 NVENCSTATUS NVEncCore::InitOutput(InEncodeVideoParam *inputParams, NV_ENC_BUFFER_FORMAT encBufferFormat) {
-    int sts = 0;
-    bool stdoutUsed = false;
     const auto outputVideoInfo = videooutputinfo(m_stCodecGUID, encBufferFormat,
         m_uEncWidth, m_uEncHeight,
         &m_stEncConfig, m_stPicStruct,
         std::make_pair(inputParams->par[0], inputParams->par[1]),
         std::make_pair(m_stCreateEncodeParams.frameRateNum, m_stCreateEncodeParams.frameRateDen));
+    return InitOutput(inputParams, outputVideoInfo);
+}
+
+NVENCSTATUS NVEncCore::InitOutput(InEncodeVideoParam *inputParams, const VideoInfo& outputVideoInfo) {
+    int sts = 0;
+    bool stdoutUsed = false;
     HEVCHDRSei hedrsei;
     if (hedrsei.parse(inputParams->sMaxCll, inputParams->sMasterDisplay)) {
         PrintMes(RGY_LOG_ERROR, _T("Failed to parse HEVC HDR10 metadata.\n"));
         return NV_ENC_ERR_UNSUPPORTED_PARAM;
     }
+    if (inputParams->sDynamicHdr10plus.length() > 0) {
+        if (outputVideoInfo.codec != RGY_CODEC_HEVC) {
+            PrintMes(RGY_LOG_ERROR, _T("--dhdr10-info can be used only with HEVC.\n"));
+            return NV_ENC_ERR_UNSUPPORTED_PARAM;
+        }
+        //HDR10+のメタデータはエンコードしたフレームの順番で対応づけられるので、
+        //入力フレームとエンコードするフレームが1対1に対応しない場合はずれてしまう
+        if (inputParams->nTrimCount > 0) {
+            PrintMes(RGY_LOG_ERROR, _T("--dhdr10-info cannot be used with --trim.\n"));
+            return NV_ENC_ERR_UNSUPPORTED_PARAM;
+        }
+        if (inputParams->nAVSyncMode & RGY_AVSYNC_FORCE_CFR) {
+            PrintMes(RGY_LOG_ERROR, _T("--dhdr10-info cannot be used with --avsync forcecfr.\n"));
+            return NV_ENC_ERR_UNSUPPORTED_PARAM;
+        }
+        if (inputParams->vpp.afs.enable
+            || inputParams->vpp.rff
+            || inputParams->vpp.deinterlace == cudaVideoDeinterlaceMode_Bob) {
+            PrintMes(RGY_LOG_ERROR, _T("--dhdr10-info cannot be used with filters which change the frame count (--vpp-afs, --vpp-rff, --vpp-deinterlace bob).\n"));
+            return NV_ENC_ERR_UNSUPPORTED_PARAM;
+        }
+        m_hdr10plus = std::make_shared<RGYHDR10Plus>();
+        const auto err = m_hdr10plus->init(inputParams->sDynamicHdr10plus);
+        if (err != RGY_ERR_NONE) {
+            PrintMes(RGY_LOG_ERROR, _T("Failed to load HDR10+ dynamic metadata from \"%s\": %s.\n"), inputParams->sDynamicHdr10plus.c_str(), get_err_mes(err));
+            return NV_ENC_ERR_GENERIC;
+        }
+        PrintMes(RGY_LOG_DEBUG, _T("Loaded HDR10+ dynamic metadata: %d frames.\n"), m_hdr10plus->frames());
+    }
 #if ENABLE_AVSW_READER
     vector<int> streamTrackUsed; //使用した音声/字幕のトラックIDを保存する
     bool useH264ESOutput =
@@ -751,6 +868,11 @@ NVENCSTATUS NVEncCore::InitOutput(InEncodeVideoParam *inputParams, NV_ENC_BUFFER
         writerPrm.pMuxVidTsLogFile        = inputParams->pMuxVidTsLogFile;
         writerPrm.rBitstreamTimebase      = av_make_q(m_outputTimebase);
         writerPrm.pHEVCHdrSei             = &hedrsei;
+        writerPrm.pHDR10plus              = m_hdr10plus;
+        if (inputParams->fmp4.enable) {
+            writerPrm.nFmp4FragMs         = inputParams->fmp4.fragMs;
+            writerPrm.dFmp4SegmentSec     = inputParams->fmp4.segmentSec;
+        }
         if (inputParams->pMuxOpt > 0) {
             writerPrm.vMuxOpt = *inputParams->pMuxOpt;
         }
@@ -845,14 +967,18 @@ NVENCSTATUS NVEncCore::InitOutput(InEncodeVideoParam *inputParams, NV_ENC_BUFFER
     } else if (inputParams->nAVMux & (RGY_MUX_AUDIO | RGY_MUX_SUBTITLE)) {
         PrintMes(RGY_LOG_ERROR, _T("Audio mux cannot be used alone, should be use with video mux.\n"));
         return NV_ENC_ERR_GENERIC;
+    } else if (inputParams->fmp4.enable) {
+        PrintMes(RGY_LOG_ERROR, _T("--fmp4 requires mp4 output, but output is raw elementary stream.\n"));
+        return NV_ENC_ERR_GENERIC;
     } else {
 #endif //ENABLE_AVSW_READER
         m_pFileWriter = std::make_shared<RGYOutputRaw>();
         RGYOutputRawPrm rawPrm;
         rawPrm.nBufSizeMB = inputParams->nOutputBufSizeMB;
         rawPrm.bBenchmark = false;
-        rawPrm.codecId = inputParams->codec == NV_ENC_H264 ? RGY_CODEC_H264 : RGY_CODEC_HEVC;
+        rawPrm.codecId = outputVideoInfo.codec;
         rawPrm.seiNal = hedrsei.gen_nal();
+        rawPrm.hdr10plus = m_hdr10plus;
         sts = m_pFileWriter->Init(inputParams->outputFilename.c_str(), &outputVideoInfo, &rawPrm, m_pNVLog, m_pStatus);
         if (sts != 0) {
             PrintMes(RGY_LOG_ERROR, m_pFileWriter->GetOutputMessage());
@@ -940,6 +1066,71 @@ NVENCSTATUS NVEncCore::InitOutput(InEncodeVideoParam *inputParams, NV_ENC_BUFFER
     return NV_ENC_SUCCESS;
 }
 
+#if ENABLE_AVSW_READER
+void NVEncCore::InitStreamPacketRoutes() {
+    m_pStreamReaders.clear();
+    m_streamPacketRoutes.clear();
+    if (m_pFileWriterListAudio.size() == 0) {
+        return;
+    }
+    if (auto pAVCodecReader = std::dynamic_pointer_cast<RGYInputAvcodec>(m_pFileReader)) {
+        m_pStreamReaders.push_back(pAVCodecReader);
+    }
+    //音声ファイルリーダーからのトラックを結合する
+    for (const auto& reader : m_AudioReaders) {
+        if (auto pAVCodecReader = std::dynamic_pointer_cast<RGYInputAvcodec>(reader)) {
+            m_pStreamReaders.push_back(pAVCodecReader);
+        }
+    }
+    //サブストリームは同じトラックのキューを共有するので、トラックごとに1つだけ登録する
+    for (const auto& pStreamReader : m_pStreamReaders) {
+        for (const auto& stream : pStreamReader->GetInputStreamInfo()) {
+            auto pQueue = pStreamReader->GetStreamPacketQueue(stream.nTrackId);
+            if (pQueue == nullptr
+                || std::any_of(m_streamPacketRoutes.begin(), m_streamPacketRoutes.end(), [pQueue](const StreamPacketRoute& route) { return route.pQueue == pQueue; })) {
+                continue;
+            }
+            StreamPacketRoute route = { stream.nTrackId, pQueue, nullptr };
+            for (auto pWriter : m_pFileWriterListAudio) {
+                auto pAVCodecWriter = std::dynamic_pointer_cast<RGYOutputAvcodec>(pWriter);
+                if (pAVCodecWriter) {
+                    auto trackIdList = pAVCodecWriter->GetStreamTrackIdList();
+                    if (std::find(trackIdList.begin(), trackIdList.end(), stream.nTrackId) != trackIdList.end()) {
+                        route.pWriter = pAVCodecWriter;
+                    }
+                }
+            }
+            m_streamPacketRoutes.push_back(route);
+        }
+    }
+}
+
+int NVEncCore::ExtractStreamPackets() {
+    if (m_pFileWriterListAudio.size() == 0) {
+        return 0;
+    }
+    for (const auto& pStreamReader : m_pStreamReaders) {
+        pStreamReader->LoadStreamDataPackets();
+    }
+    //パケットをトラックごとのキューから直接各Writerに渡す
+    //取り出しはこのスレッドで行い、Writer側の音声処理スレッドへの受け渡しはWriteNextPacketが行う
+    AVPacket pkt;
+    for (const auto& route : m_streamPacketRoutes) {
+        while (route.pQueue->front_copy_and_pop_no_lock(&pkt)) {
+            if (route.pWriter == nullptr) {
+                PrintMes(RGY_LOG_ERROR, _T("Failed to find writer for audio track %d\n"), route.nTrackId);
+                av_packet_unref(&pkt);
+                return 1;
+            }
+            if (0 != route.pWriter->WriteNextPacket(&pkt)) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+#endif //#if ENABLE_AVSW_READER
+
 NVENCSTATUS NVEncCore::InitCuda(int cudaSchedule) {
     //ひとまず、これまでのすべてのエラーをflush
     auto cudaerr = cudaGetLastError();
@@ -1306,6 +1497,11 @@ NVENCSTATUS NVEncCore::ProcessOutput(const EncodeBuffer *pEncodeBuffer) {
     if (pEncodeBuffer->stOutputBfr.hBitstreamBuffer == NULL && pEncodeBuffer->stOutputBfr.bEOSFlag == FALSE) {
         return NV_ENC_ERR_INVALID_PARAM;
     }
+    if (m_pBitstreamCollector) {
+        //取り出しスレッドがビットストリームをコピーし終えるのを待つ
+        NVTXRANGE(ProcessOutputWait);
+        return m_pBitstreamCollector->waitOldest(pEncodeBuffer);
+    }
 
     if (pEncodeBuffer->stOutputBfr.bWaitOnEvent == TRUE) {
         if (!pEncodeBuffer->stOutputBfr.hOutputEvent) {
@@ -1327,6 +1523,11 @@ NVENCSTATUS NVEncCore::ProcessOutput(const EncodeBuffer *pEncodeBuffer) {
     NVENCSTATUS nvStatus = m_pEncodeAPI->nvEncLockBitstream(m_hEncoder, &lockBitstreamData);
     if (nvStatus == NV_ENC_SUCCESS) {
         RGYBitstream bitstream = RGYBitstreamInit(lockBitstreamData);
+#if ENABLE_AVSW_READER
+        if (m_pQualityMetric) {
+            m_pQualityMetric->addBitstream(&bitstream);
+        }
+#endif //#if ENABLE_AVSW_READER
         m_pFileWriter->WriteNextFrame(&bitstream);
         nvStatus = m_pEncodeAPI->nvEncUnlockBitstream(m_hEncoder, pEncodeBuffer->stOutputBfr.hBitstreamBuffer);
     } else {
@@ -1337,6 +1538,90 @@ NVENCSTATUS NVEncCore::ProcessOutput(const EncodeBuffer *pEncodeBuffer) {
     return nvStatus;
 }
 
+NVENCSTATUS NVEncCore::InitBitstreamCollector() {
+#if ENABLE_AVSW_READER
+    //出力スレッドを使用しない場合、音声・字幕はメインスレッドから直接muxされるので、
+    //取り出しスレッドから映像を同時にmuxすると競合してしまう
+    auto pAVCodecWriter = std::dynamic_pointer_cast<RGYOutputAvcodec>(m_pFileWriter);
+    if (pAVCodecWriter && !pAVCodecWriter->outputThreadRunning()
+        && std::find(m_pFileWriterListAudio.begin(), m_pFileWriterListAudio.end(), m_pFileWriter) != m_pFileWriterListAudio.end()) {
+        PrintMes((m_nBitstreamThread > 0) ? RGY_LOG_WARN : RGY_LOG_DEBUG,
+            _T("bitstream thread disabled, as audio/subtitle is muxed without output thread.\n"));
+        return NV_ENC_SUCCESS;
+    }
+#endif //#if ENABLE_AVSW_READER
+    NVEncBitstreamCollector::Funcs funcs;
+    funcs.waitFin = [](const EncodeBuffer *pEncodeBuffer, uint32_t timeoutMs) {
+        if (pEncodeBuffer->stOutputBfr.bWaitOnEvent == TRUE) {
+            if (!pEncodeBuffer->stOutputBfr.hOutputEvent) {
+                return NV_ENC_ERR_INVALID_PARAM;
+            }
+            if (WaitForSingleObject(pEncodeBuffer->stOutputBfr.hOutputEvent, timeoutMs) == WAIT_TIMEOUT) {
+                return NV_ENC_ERR_ENCODER_BUSY;
+            }
+        }
+        return NV_ENC_SUCCESS;
+    };
+    funcs.copy = [this](const EncodeBuffer *pEncodeBuffer, RGYBitstream *pBitstream) {
+        NVTXRANGE(ProcessOutput);
+        NV_ENC_LOCK_BITSTREAM lockBitstreamData;
+        INIT_CONFIG(lockBitstreamData, NV_ENC_LOCK_BITSTREAM);
+        lockBitstreamData.outputBitstream = pEncodeBuffer->stOutputBfr.hBitstreamBuffer;
+        lockBitstreamData.doNotWait = false;
+
+        NVENCSTATUS nvStatus = m_pEncodeAPI->nvEncLockBitstream(m_hEncoder, &lockBitstreamData);
+        if (nvStatus != NV_ENC_SUCCESS) {
+            NVPrintFuncError(_T("nvEncLockBitstream"), nvStatus);
+            return nvStatus;
+        }
+        //アンロック後も使えるよう、ビットストリームをコピーしておく
+        //出力側がコピーせずにバッファごと受け取れるよう、末尾に余白を確保しておく
+        //また、出力側でSEIを挿入できるよう、先頭側にも余白を確保しておく
+        const RGYBitstream bitstream = RGYBitstreamInit(lockBitstreamData);
+        if (bitstream.size() > 0 && pBitstream->bufsize() < RGY_BITSTREAM_HEADROOM + bitstream.size() + RGY_BITSTREAM_PADDING
+            && pBitstream->init(RGY_BITSTREAM_HEADROOM + bitstream.size() * 2 + RGY_BITSTREAM_PADDING) != RGY_ERR_NONE) {
+            nvStatus = NV_ENC_ERR_OUT_OF_MEMORY;
+        }
+        if (nvStatus == NV_ENC_SUCCESS && bitstream.size() > 0) {
+            pBitstream->setOffset(RGY_BITSTREAM_HEADROOM);
+            pBitstream->setSize(bitstream.size());
+            memcpy(pBitstream->data(), bitstream.data(), bitstream.size());
+        }
+        pBitstream->setDts(bitstream.dts());
+        pBitstream->setPts(bitstream.pts());
+        pBitstream->setDataflag(RGY_BITSTREAM_FLAG_TRANSFERABLE);
+        pBitstream->setAvgQP(lockBitstreamData.frameAvgQP);
+        pBitstream->setFrametype(bitstream.frametype());
+        pBitstream->setPicstruct(bitstream.picstruct());
+        pBitstream->setFrameIdx(lockBitstreamData.frameIdx);
+        pBitstream->setDuration(lockBitstreamData.outputDuration);
+        auto nvStatusUnlock = m_pEncodeAPI->nvEncUnlockBitstream(m_hEncoder, pEncodeBuffer->stOutputBfr.hBitstreamBuffer);
+        return (nvStatus != NV_ENC_SUCCESS) ? nvStatus : nvStatusUnlock;
+    };
+    funcs.write = [this](RGYBitstream *pBitstream) {
+#if ENABLE_AVSW_READER
+        //writerがバッファを引き取る場合があるので、書き出す前に渡す
+        if (m_pQualityMetric) {
+            m_pQualityMetric->addBitstream(pBitstream);
+        }
+#endif //#if ENABLE_AVSW_READER
+        m_pFileWriter->WriteNextFrame(pBitstream);
+        return NV_ENC_SUCCESS;
+    };
+    m_pBitstreamCollector.reset(new NVEncBitstreamCollector());
+    auto nvStatus = m_pBitstreamCollector->start(funcs);
+    if (nvStatus != NV_ENC_SUCCESS) {
+        PrintMes(RGY_LOG_ERROR, _T("Failed to start bitstream thread: %s\n"), char_to_tstring(_nvencGetErrorEnum(nvStatus)).c_str());
+        m_pBitstreamCollector.reset();
+        return nvStatus;
+    }
+    if (m_threadAffinity.enabled()) {
+        setThreadAffinity(RGY_THREAD_BITSTREAM, m_pBitstreamCollector->threadHandle());
+    }
+    PrintMes(RGY_LOG_DEBUG, _T("Started bitstream thread.\n"));
+    return NV_ENC_SUCCESS;
+}
+
 NVENCSTATUS NVEncCore::FlushEncoder() {
     NVENCSTATUS nvStatus = NvEncFlushEncoderQueue(m_stEOSOutputBfr.hOutputEvent);
     if (nvStatus != NV_ENC_SUCCESS) {
@@ -1361,10 +1646,30 @@ NVENCSTATUS NVEncCore::FlushEncoder() {
 NVENCSTATUS NVEncCore::Deinitialize() {
     NVENCSTATUS nvStatus = NV_ENC_SUCCESS;
 
+    //ABRラダーの追加の出力はデバイスを共有しているので、先に終了する
+    CloseRenditions(true);
+    m_renditions.clear();
+    m_renditionStatus.clear();
+    if (m_fanoutFrames.size()) {
+        NVEncCtxAutoLock(ctxlock(m_ctxLock));
+        m_fanoutFrames.clear();
+    }
+
+    //出力を参照しているので、先に取り出しスレッドを終了する
+    m_pBitstreamCollector.reset();
+#if ENABLE_AVSW_READER
+    m_streamPacketRoutes.clear();
+    m_pStreamReaders.clear();
+    m_pQualityMetric.reset();
+    m_pMetricRefReader.reset();
+#endif //#if ENABLE_AVSW_READER
     m_AudioReaders.clear();
     m_pFileReader.reset();
     m_pFileWriter.reset();
     m_pFileWriterListAudio.clear();
+    m_hdr10plus.reset();
+    m_bsAnalyzer.reset();
+    m_fpBitstreamStats.reset();
 
     if (m_vpFilters.size()) {
         NVEncCtxAutoLock(ctxlock(m_ctxLock));
@@ -1378,7 +1683,10 @@ NVENCSTATUS NVEncCore::Deinitialize() {
     m_cuvidDec.reset();
 
     if (m_ctxLock) {
-        cuvidCtxLockDestroy(m_ctxLock);
+        //ABRラダーの追加の出力では、分配元と共有しているので破棄しない
+        if (!m_pRenditionParent) {
+            cuvidCtxLockDestroy(m_ctxLock);
+        }
         m_ctxLock = nullptr;
     }
 #endif //#if ENABLE_AVSW_READER
@@ -1386,11 +1694,12 @@ NVENCSTATUS NVEncCore::Deinitialize() {
     m_pStatus.reset();
 
     if (m_pDevice) {
-        CUresult cuResult = CUDA_SUCCESS;
-        cuResult = cuCtxDestroy((CUcontext)m_pDevice);
-        if (cuResult != CUDA_SUCCESS)
-            PrintMes(RGY_LOG_ERROR, _T("cuCtxDestroy error:0x%x: %s\n"), cuResult, char_to_tstring(_cudaGetErrorEnum(cuResult)).c_str());
-
+        if (!m_pRenditionParent) {
+            CUresult cuResult = CUDA_SUCCESS;
+            cuResult = cuCtxDestroy((CUcontext)m_pDevice);
+            if (cuResult != CUDA_SUCCESS)
+                PrintMes(RGY_LOG_ERROR, _T("cuCtxDestroy error:0x%x: %s\n"), cuResult, char_to_tstring(_cudaGetErrorEnum(cuResult)).c_str());
+        }
         m_pDevice = NULL;
     }
 
@@ -1491,12 +1800,16 @@ NVENCSTATUS NVEncCore::AllocateIOBuffers(uint32_t uInputWidth, uint32_t uInputHe
         m_stEncodeBuffer[i].stOutputBfr.bWaitOnEvent = true;
     }
 
+    //ABRラダーの追加の出力は、分配元からGPU上のフレームを受け取るのでステージングバッファは不要
 #if ENABLE_AVSW_READER
-    if (!m_cuvidDec) {
+    if (!m_cuvidDec && !m_pRenditionParent) {
 #else
-    {
+    if (!m_pRenditionParent) {
 #endif //#if ENABLE_AVSW_READER
-        m_inputHostBuffer.resize(PIPELINE_DEPTH);
+        //段数を自動調整する場合は、上限までのスロットを用意しておき、pinnedメモリは使用する段数分だけ確保する
+        const bool stagingAutoTune = m_nInputStagingDepth <= 0;
+        const int stagingDepth = (stagingAutoTune) ? PIPELINE_DEPTH : m_nInputStagingDepth;
+        m_inputHostBuffer.resize((stagingAutoTune) ? RGY_STAGING_RING_DEPTH_MAX : m_nInputStagingDepth);
         int bufWidth  = pInputInfo->srcWidth  - pInputInfo->crop.e.left - pInputInfo->crop.e.right;
         int bufHeight = pInputInfo->srcHeight - pInputInfo->crop.e.bottom - pInputInfo->crop.e.up;
         int bufPitch = 0;
@@ -1559,17 +1872,17 @@ NVENCSTATUS NVEncCore::AllocateIOBuffers(uint32_t uInputWidth, uint32_t uInputHe
             m_inputHostBuffer[i].frameInfo.duration = 0;
             m_inputHostBuffer[i].frameInfo.timestamp = 0;
             m_inputHostBuffer[i].frameInfo.deivce_mem = false;
-            m_inputHostBuffer[i].heTransferFin = unique_ptr<void, handle_deleter>(CreateEvent(NULL, FALSE, TRUE, NULL), handle_deleter());
-
-#if ENABLE_AVSW_READER
-            CCtxAutoLock ctxLock(m_ctxLock);
-#endif //#if ENABLE_AVSW_READER
-            auto cudaret = cudaMallocHost(&m_inputHostBuffer[i].frameInfo.ptr, bufSize);
-            if (cudaret != cudaSuccess) {
-                PrintMes(RGY_LOG_ERROR, _T("Error cudaEventRecord: %d (%s).\n"), cudaret, char_to_tstring(_cudaGetErrorEnum(cudaret)).c_str());
-                return NV_ENC_ERR_GENERIC;
+            m_inputHostBuffer[i].frameInfo.ptr = nullptr;
+        }
+        m_nInputHostBufferSize = bufSize;
+        for (int i = 0; i < stagingDepth; i++) {
+            if (NV_ENC_SUCCESS != (nvStatus = AllocateInputHostBuffer(i))) {
+                return nvStatus;
             }
         }
+        m_inputStagingRing.init(stagingDepth, (int)m_inputHostBuffer.size(), stagingAutoTune);
+        PrintMes(RGY_LOG_DEBUG, _T("Input staging buffers: %d%s (max %d), %d bytes each.\n"),
+            stagingDepth, (stagingAutoTune) ? _T(" auto") : _T(""), (int)m_inputHostBuffer.size(), bufSize);
     }
 
     m_stEOSOutputBfr.bEOSFlag = TRUE;
@@ -1581,7 +1894,34 @@ NVENCSTATUS NVEncCore::AllocateIOBuffers(uint32_t uInputWidth, uint32_t uInputHe
     return NV_ENC_SUCCESS;
 }
 
+NVENCSTATUS NVEncCore::AllocateInputHostBuffer(int slot) {
+    auto& inputFrameBuf = m_inputHostBuffer[slot];
+    if (inputFrameBuf.frameInfo.ptr) {
+        return NV_ENC_SUCCESS;
+    }
+#if ENABLE_AVSW_READER
+    CCtxAutoLock ctxLock(m_ctxLock);
+#endif //#if ENABLE_AVSW_READER
+    auto cudaret = cudaMallocHost(&inputFrameBuf.frameInfo.ptr, m_nInputHostBufferSize);
+    if (cudaret != cudaSuccess) {
+        inputFrameBuf.frameInfo.ptr = nullptr;
+        PrintMes(RGY_LOG_ERROR, _T("Error cudaMallocHost: %d (%s).\n"), cudaret, char_to_tstring(_cudaGetErrorEnum(cudaret)).c_str());
+        return NV_ENC_ERR_OUT_OF_MEMORY;
+    }
+    return NV_ENC_SUCCESS;
+}
+
 NVENCSTATUS NVEncCore::ReleaseIOBuffers() {
+    for (auto& inputFrameBuf : m_inputHostBuffer) {
+        if (inputFrameBuf.frameInfo.ptr) {
+#if ENABLE_AVSW_READER
+            CCtxAutoLock ctxLock(m_ctxLock);
+#endif //#if ENABLE_AVSW_READER
+            cudaFreeHost(inputFrameBuf.frameInfo.ptr);
+            inputFrameBuf.frameInfo.ptr = nullptr;
+        }
+    }
+    m_inputHostBuffer.clear();
     for (uint32_t i = 0; i < m_uEncodeBufferCount; i++) {
         if (m_stEncodeBuffer[i].stInputBfr.pNV12devPtr) {
 #if ENABLE_AVSW_READER
@@ -2593,6 +2933,9 @@ NVENCSTATUS NVEncCore::InitFilters(const InEncodeVideoParam *inputParam) {
             param->Cb            = (short)inputParam->vpp.delogo.nCbOffset;
             param->Cr            = (short)inputParam->vpp.delogo.nCrOffset;
             param->mode          = inputParam->vpp.delogo.nMode;
+            param->autoFade      = inputParam->vpp.delogo.bAutoFade;
+            param->logPath       = inputParam->vpp.delogo.pLogPath;
+            param->autoSelectFrames = inputParam->vpp.delogo.nAutoSelectFrames;
             param->frameIn = inputFrame;
             param->frameOut = inputFrame;
             param->bOutOverwrite = true;
@@ -3027,7 +3370,11 @@ NVENCSTATUS NVEncCore::InitDevice(const InEncodeVideoParam *inputParam) {
         return nvStatus;
     }
     PrintMes(RGY_LOG_DEBUG, _T("InitCuda: Success.\n"));
+    return InitEncodeSession();
+}
 
+NVENCSTATUS NVEncCore::InitEncodeSession() {
+    auto nvStatus = NV_ENC_SUCCESS;
     MYPROC nvEncodeAPICreateInstance; // function pointer to create instance in nvEncodeAPI
     if (NULL == (nvEncodeAPICreateInstance = (MYPROC)GetProcAddress(m_hinstLib, "NvEncodeAPICreateInstance"))) {
         PrintMes(RGY_LOG_ERROR, FOR_AUO ? _T("NvEncodeAPICreateInstanceのアドレス取得に失敗しました。\n") : _T("Failed to get address of NvEncodeAPICreateInstance.\n"));
@@ -3169,6 +3516,26 @@ NVENCSTATUS NVEncCore::InitEncode(InEncodeVideoParam *inputParam) {
             m_pPerfMonitor.reset();
         }
     }
+
+    //GPUの接続されたNUMAノードを確認し、必要ならメインスレッドをそこに制限する
+    //pinnedメモリはそれを確保したスレッドの実行ノードに配置されるので、AllocateIOBuffersより前に行う
+    m_threadAffinity = inputParam->threadAffinity;
+    if (selectedGpu != m_GPUList.end()) {
+        m_nGPUNumaNode = rgy_pci_device_numa_node(selectedGpu->pciBusId.c_str());
+        PrintMes(RGY_LOG_DEBUG, _T("GPU #%d (%s) is attached to NUMA node %d (total %d nodes).\n"),
+            m_nDeviceId, char_to_tstring(selectedGpu->pciBusId).c_str(), m_nGPUNumaNode, rgy_numa_node_count());
+    }
+    if (m_threadAffinity.enabled()) {
+        if (m_nGPUNumaNode < 0) {
+            for (int i = 0; i < RGY_THREAD_TYPE_MAX; i++) {
+                if (m_threadAffinity.get((RGYThreadType)i).mode == RGY_THREAD_AFFINITY_MODE_NUMA) {
+                    PrintMes(RGY_LOG_WARN, _T("Failed to get NUMA node of the GPU, thread-affinity \"numa\" will be ignored.\n"));
+                    break;
+                }
+            }
+        }
+        setThreadAffinity(RGY_THREAD_MAIN, (HANDLE)GetCurrentThread());
+    }
     
     //作成したデバイスの情報をfeature取得
     if (NV_ENC_SUCCESS != (nvStatus = createDeviceFeatureList(false))) {
@@ -3202,6 +3569,8 @@ NVENCSTATUS NVEncCore::InitEncode(InEncodeVideoParam *inputParam) {
         encBufferFormat = (inputParam->yuv444) ? NV_ENC_BUFFER_FORMAT_YUV444_PL : NV_ENC_BUFFER_FORMAT_NV12_PL;
     }
     m_nAVSyncMode = inputParam->nAVSyncMode;
+    m_nInputStagingDepth = inputParam->nInputStagingDepth;
+    m_nBitstreamThread = inputParam->nBitstreamThread;
     if (NV_ENC_SUCCESS != (nvStatus = AllocateIOBuffers(m_uEncWidth, m_uEncHeight, encBufferFormat, &inputParam->input))) {
         return nvStatus;
     }
@@ -3213,112 +3582,651 @@ NVENCSTATUS NVEncCore::InitEncode(InEncodeVideoParam *inputParam) {
         return nvStatus;
     }
     PrintMes(RGY_LOG_DEBUG, _T("InitOutput: Success.\n"), inputParam->outputFilename.c_str());
-    return nvStatus;
-}
-
-NVENCSTATUS NVEncCore::Initialize(InEncodeVideoParam *inputParam) {
-    NVENCSTATUS nvStatus = NV_ENC_SUCCESS;
 
-    InitLog(inputParam);
+    if (NV_ENC_SUCCESS != (nvStatus = InitFrameDedup(inputParam))) {
+        return nvStatus;
+    }
 
-    if (NULL == m_hinstLib) {
-        if (NULL == (m_hinstLib = LoadLibrary(NVENCODE_API_DLL))) {
-#if FOR_AUO
-            PrintMes(RGY_LOG_ERROR, _T("%sがシステムに存在しません。\n"), NVENCODE_API_DLL);
-            PrintMes(RGY_LOG_ERROR, _T("NVIDIAのドライバが動作条件を満たしているか確認して下さい。"));
-#else
-            PrintMes(RGY_LOG_ERROR, _T("%s does not exists in your system.\n"), NVENCODE_API_DLL);
-            PrintMes(RGY_LOG_ERROR, _T("Please check if the GPU driver is propery installed."));
-#endif
-            return NV_ENC_ERR_OUT_OF_MEMORY;
-        }
+    if (NV_ENC_SUCCESS != (nvStatus = InitQualityMetric(inputParam))) {
+        return nvStatus;
     }
-    PrintMes(RGY_LOG_DEBUG, _T("Loaded %s.\n"), NVENCODE_API_DLL);
 
-    //m_pDeviceを初期化
-    if (!check_if_nvcuda_dll_available()) {
-        PrintMes(RGY_LOG_ERROR,
-            FOR_AUO ? _T("CUDAが使用できないため、NVEncによるエンコードが行えません。(check_if_nvcuda_dll_available)\n") : _T("CUDA not available.\n"));
-        return NV_ENC_ERR_UNSUPPORTED_DEVICE;
+    //ABRラダーの追加の出力を作成
+    if (NV_ENC_SUCCESS != (nvStatus = InitRenditions(inputParam, encBufferFormat))) {
+        return nvStatus;
     }
-    m_nDeviceId = inputParam->deviceID;
-    //入力などにも渡すため、まずはインスタンスを作っておく必要がある
-    m_pPerfMonitor = std::unique_ptr<CPerfMonitor>(new CPerfMonitor());
     return nvStatus;
 }
 
-NVENCSTATUS NVEncCore::NvEncEncodeFrame(EncodeBuffer *pEncodeBuffer, uint64_t timestamp, uint64_t duration) {
-    
-    NV_ENC_PIC_PARAMS encPicParams;
-    INIT_CONFIG(encPicParams, NV_ENC_PIC_PARAMS);
-
-    encPicParams.inputBuffer = pEncodeBuffer->stInputBfr.hInputSurface;
-    encPicParams.bufferFmt = pEncodeBuffer->stInputBfr.bufferFmt;
-    encPicParams.inputWidth = m_uEncWidth;
-    encPicParams.inputHeight = m_uEncHeight;
-    encPicParams.inputPitch = pEncodeBuffer->stInputBfr.uNV12Stride;
-    encPicParams.outputBitstream = pEncodeBuffer->stOutputBfr.hBitstreamBuffer;
-    encPicParams.completionEvent = pEncodeBuffer->stOutputBfr.hOutputEvent;
-    encPicParams.inputTimeStamp = timestamp;
-    encPicParams.inputDuration = duration;
-    encPicParams.pictureStruct = m_stPicStruct;
-    //encPicParams.qpDeltaMap = qpDeltaMapArray;
-    //encPicParams.qpDeltaMapSize = qpDeltaMapArraySize;
-
-    //if (encPicCommand)
-    //{
-    //    if (encPicCommand->bForceIDR)
-    //    {
-    //        encPicParams.encodePicFlags |= NV_ENC_PIC_FLAG_FORCEIDR;
-    //    }
-
-    //    if (encPicCommand->bForceIntraRefresh)
-    //    {
-    //        if (codecGUID == NV_ENC_CODEC_HEVC_GUID)
-    //        {
-    //            encPicParams.codecPicParams.hevcPicParams.forceIntraRefreshWithFrameCnt = encPicCommand->intraRefreshDuration;
-    //        }
-    //        else
-    //        {
-    //            encPicParams.codecPicParams.h264PicParams.forceIntraRefreshWithFrameCnt = encPicCommand->intraRefreshDuration;
-    //        }
-    //    }
-    //}
-
-    NVENCSTATUS nvStatus = m_pEncodeAPI->nvEncEncodePicture(m_hEncoder, &encPicParams);
-    if (nvStatus != NV_ENC_SUCCESS && nvStatus != NV_ENC_ERR_NEED_MORE_INPUT) {
-        PrintMes(RGY_LOG_ERROR, FOR_AUO ? _T("フレームの投入に失敗しました。\n") : _T("Failed to add frame into the encoder.\n"));
-        return nvStatus;
+NVENCSTATUS NVEncCore::InitFrameDedup(const InEncodeVideoParam *inputParam) {
+    if (!inputParam->dedup.enable) {
+        return NV_ENC_SUCCESS;
     }
-
+    if (m_inputHostBuffer.size() == 0) {
+        PrintMes(RGY_LOG_ERROR, _T("--dedup can only be used when the input is decoded on CPU.\n"));
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+    }
+    if (m_nAVSyncMode & RGY_AVSYNC_FORCE_CFR) {
+        PrintMes(RGY_LOG_ERROR, _T("--dedup cannot be used with --avsync forcecfr.\n"));
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+    }
+    if (inputParam->vpp.afs.enable) {
+        PrintMes(RGY_LOG_ERROR, _T("--dedup cannot be used with --vpp-afs.\n"));
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+    }
+    //HDR10+のメタデータはエンコードしたフレームの順番で対応づけられるので、フレームを間引くとずれてしまう
+    if (inputParam->sDynamicHdr10plus.length() > 0) {
+        PrintMes(RGY_LOG_ERROR, _T("--dedup cannot be used with --dhdr10-info.\n"));
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+    }
+    //間引いたフレームの分の時間はtimestampでのみ表現されるので、timestampを書き出せるmuxerが必要
+#if ENABLE_AVSW_READER
+    const bool bAvcodecWriter = std::dynamic_pointer_cast<RGYOutputAvcodec>(m_pFileWriter) != nullptr;
+#else
+    const bool bAvcodecWriter = false;
+#endif //#if ENABLE_AVSW_READER
+    if (!bAvcodecWriter) {
+        PrintMes(RGY_LOG_ERROR, _T("--dedup requires the output to be muxed by avcodec (mp4, mkv, etc.), raw output cannot keep the timestamps.\n"));
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+    }
+    m_pFrameDedup.reset(new RGYFrameDedup());
+    m_pFrameDedup->init(inputParam->dedup.threshold, inputParam->dedup.maxDrop);
+    PrintMes(RGY_LOG_DEBUG, _T("dedup: threshold %.2f, max-drop %d.\n"), inputParam->dedup.threshold, inputParam->dedup.maxDrop);
     return NV_ENC_SUCCESS;
 }
 
-#pragma warning(push)
-#pragma warning(disable: 4100)
-NVENCSTATUS NVEncCore::EncodeFrame(EncodeFrameConfig *pEncodeFrame, uint64_t timestamp, uint64_t duration) {
-    NVENCSTATUS nvStatus = NV_ENC_SUCCESS;
+NVENCSTATUS NVEncCore::InitQualityMetric(const InEncodeVideoParam *inputParam) {
+    if (!inputParam->bMetricPsnr && !inputParam->bMetricSsim && inputParam->sMetricLog.length() == 0) {
+        return NV_ENC_SUCCESS;
+    }
 #if ENABLE_AVSW_READER
-    EncodeBuffer *pEncodeBuffer = m_EncodeBufferQueue.GetAvailable();
-    if (!pEncodeBuffer) {
-        pEncodeBuffer = m_EncodeBufferQueue.GetPending();
-        ProcessOutput(pEncodeBuffer);
-        PrintMes(RGY_LOG_TRACE, _T("Output frame %d\n"), m_pStatus->m_sData.frameOut);
-        if (pEncodeBuffer->stInputBfr.hInputSurface) {
-            nvStatus = NvEncUnmapInputResource(pEncodeBuffer->stInputBfr.hInputSurface);
-            if (nvStatus != NV_ENC_SUCCESS) {
-                PrintMes(RGY_LOG_ERROR, _T("Failed to Unmap input buffer %p: %s\n"), pEncodeBuffer->stInputBfr.hInputSurface, char_to_tstring(_nvencGetErrorEnum(nvStatus)).c_str());
-                return nvStatus;
-            }
-            pEncodeBuffer->stInputBfr.hInputSurface = NULL;
-        }
-        pEncodeBuffer = m_EncodeBufferQueue.GetAvailable();
+    //エンコーダに渡す前のCPU上のフレームを比較元として保持する
+    if (m_inputHostBuffer.size() == 0) {
+        PrintMes(RGY_LOG_ERROR, _T("--psnr/--ssim can only be used when the input is decoded on CPU.\n"));
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
     }
-
-    // encode width and height
-    unsigned int dwWidth  = pEncodeBuffer->stInputBfr.dwWidth;
-    unsigned int dwHeight = pEncodeBuffer->stInputBfr.dwHeight;
-
+    //入力フレームとエンコード結果をtimestampで1対1に対応付けるので、フレーム数やtimestampを変更するフィルタは使用できない
+    if (inputParam->vpp.afs.enable
+        || inputParam->vpp.rff
+        || inputParam->vpp.deinterlace == cudaVideoDeinterlaceMode_Bob) {
+        PrintMes(RGY_LOG_ERROR, _T("--psnr/--ssim cannot be used with filters which change the frame count or timestamps (--vpp-afs, --vpp-rff, --vpp-deinterlace bob).\n"));
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+    }
+    //CPUでデコードする場合、--cropは読み込み時に適用済みなので、ステージングバッファはcrop後のサイズとなる
+    const auto& inputFrame = m_inputHostBuffer[0].frameInfo;
+    const auto& crop = inputParam->input.crop;
+    const int croppedWidth  = inputParam->input.srcWidth  - crop.e.left - crop.e.right;
+    const int croppedHeight = inputParam->input.srcHeight - crop.e.up   - crop.e.bottom;
+    if (inputFrame.width != croppedWidth || inputFrame.height != croppedHeight) {
+        PrintMes(RGY_LOG_ERROR, _T("--psnr/--ssim: input frame %dx%d does not match the size after --crop %d,%d,%d,%d (%dx%d).\n"),
+            inputFrame.width, inputFrame.height, crop.e.left, crop.e.up, crop.e.right, crop.e.bottom, croppedWidth, croppedHeight);
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+    }
+    if (inputFrame.width != (int)m_uEncWidth || inputFrame.height != (int)m_uEncHeight) {
+        if (cropEnabled(crop)) {
+            PrintMes(RGY_LOG_ERROR, _T("--psnr/--ssim cannot be used when the output is resized after --crop (%dx%d, cropped %dx%d -> %dx%d).\n"),
+                inputParam->input.srcWidth, inputParam->input.srcHeight, inputFrame.width, inputFrame.height, m_uEncWidth, m_uEncHeight);
+        } else {
+            PrintMes(RGY_LOG_ERROR, _T("--psnr/--ssim cannot be used when the output is resized (%dx%d -> %dx%d).\n"),
+                inputFrame.width, inputFrame.height, m_uEncWidth, m_uEncHeight);
+        }
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+    }
+    const bool bOutputHighBitDepth = inputParam->codec == NV_ENC_HEVC && inputParam->encConfig.encodeCodecConfig.hevcConfig.pixelBitDepthMinus8 > 0;
+    RGYQualityMetricParam prm;
+    prm.codec = (inputParam->codec == NV_ENC_HEVC) ? RGY_CODEC_HEVC : RGY_CODEC_H264;
+    prm.width = m_uEncWidth;
+    prm.height = m_uEncHeight;
+    prm.chromafmt = (inputParam->yuv444) ? RGY_CHROMAFMT_YUV444 : RGY_CHROMAFMT_YUV420;
+    prm.bitdepth = (bOutputHighBitDepth) ? 10 : 8;
+    prm.sourceCsp = inputFrame.csp;
+    prm.matchTolerance = 0; //入力フレームのtimestampがそのままエンコーダに渡される
+    //--metric-logのみ指定された場合は、両方を計測する
+    prm.psnr = inputParam->bMetricPsnr || !inputParam->bMetricSsim;
+    prm.ssim = inputParam->bMetricSsim || !inputParam->bMetricPsnr;
+    prm.perFrameFile = inputParam->sMetricLog;
+    m_pQualityMetric.reset(new RGYQualityMetric());
+    if (RGY_ERR_NONE != m_pQualityMetric->init(prm, m_pNVLog)) {
+        m_pQualityMetric.reset();
+        return NV_ENC_ERR_GENERIC;
+    }
+    return NV_ENC_SUCCESS;
+#else
+    PrintMes(RGY_LOG_ERROR, _T("--psnr/--ssim not supported in this build.\n"));
+    return NV_ENC_ERR_UNSUPPORTED_PARAM;
+#endif //#if ENABLE_AVSW_READER
+}
+
+NVENCSTATUS NVEncCore::InitRenditions(const InEncodeVideoParam *inputParam, NV_ENC_BUFFER_FORMAT encBufferFormat) {
+    if (inputParam->renditions.size() == 0) {
+        return NV_ENC_SUCCESS;
+    }
+#if ENABLE_AVSW_READER
+    if (m_stPicStruct != NV_ENC_PIC_STRUCT_FRAME) {
+        PrintMes(RGY_LOG_ERROR, _T("--output-rendition cannot be used with interlaced encoding.\n"));
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+    }
+    if (!m_pLastFilterParam) {
+        PrintMes(RGY_LOG_ERROR, _T("Unexpected error at InitRenditions().\n"));
+        return NV_ENC_ERR_GENERIC;
+    }
+    //メインの出力の最後のフィルタ(エンコードバッファへのコピー)への入力を分配する
+    //デコードとvppフィルタの処理はメインの出力で1回のみ行い、追加の出力ではリサイズとエンコードバッファへのコピーのみを行う
+    FrameInfo fanoutFrame = m_pLastFilterParam->frameIn;
+    fanoutFrame.ptr = nullptr;
+    fanoutFrame.pitch = 0;
+    fanoutFrame.deivce_mem = true;
+    {
+        NVEncCtxAutoLock(ctxlock(m_ctxLock));
+        //一番遅い追加の出力がある程度遅れても、メインの出力が待機しないだけのスロットを用意する
+        const int fanoutSlots = PIPELINE_DEPTH * 2;
+        for (int i = 0; i < fanoutSlots; i++) {
+            unique_ptr<CUFrameBuf> frame(new CUFrameBuf(fanoutFrame));
+            auto cudaerr = frame->alloc();
+            if (cudaerr != cudaSuccess) {
+                PrintMes(RGY_LOG_ERROR, _T("Failed to allocate memory for rendition: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
+                return NV_ENC_ERR_OUT_OF_MEMORY;
+            }
+            m_fanoutFrames.push_back(std::move(frame));
+        }
+    }
+
+    for (int i = 0; i < (int)inputParam->renditions.size(); i++) {
+        const auto& rendition = inputParam->renditions[i];
+        if (rendition.outputFilename == _T("-")) {
+            PrintMes(RGY_LOG_ERROR, _T("stdout cannot be used for --output-rendition.\n"));
+            return NV_ENC_ERR_INVALID_PARAM;
+        }
+        //追加の出力はメインの出力のレート制御モードを引き継ぐので、固定品質ではビットレートの指定が反映されない
+        if (m_stEncConfig.rcParams.rateControlMode == NV_ENC_PARAMS_RC_CONSTQP
+            && (rendition.bitrate > 0 || rendition.maxBitrate > 0)) {
+            PrintMes(RGY_LOG_ERROR, _T("bitrate/max-bitrate of --output-rendition cannot be used when the main output is encoded by --cqp or --lossless, use --cbr or --vbr.\n"));
+            return NV_ENC_ERR_INVALID_PARAM;
+        }
+        InEncodeVideoParam renditionParam = *inputParam;
+        renditionParam.outputFilename = rendition.outputFilename;
+        renditionParam.renditions.clear();
+        renditionParam.input.srcWidth  = fanoutFrame.width;
+        renditionParam.input.srcHeight = fanoutFrame.height;
+        renditionParam.input.dstWidth  = rendition.width;
+        renditionParam.input.dstHeight = rendition.height;
+        renditionParam.input.picstruct = RGY_PICSTRUCT_FRAME;
+        memset(&renditionParam.input.crop, 0, sizeof(renditionParam.input.crop));
+        //vppフィルタはメインの出力で適用済み
+        renditionParam.vpp.deinterlace = cudaVideoDeinterlaceMode_Weave;
+        renditionParam.vpp.afs.enable = false;
+        renditionParam.vpp.rff = false;
+        //音声・字幕はメインの出力にのみmuxする
+        renditionParam.nAVMux &= ~(RGY_MUX_AUDIO | RGY_MUX_SUBTITLE);
+        renditionParam.nAudioSelectCount = 0;
+        renditionParam.ppAudioSelectList = nullptr;
+        renditionParam.nSubtitleSelectCount = 0;
+        renditionParam.pSubtitleSelect = nullptr;
+        renditionParam.pMuxVidTsLogFile = nullptr;
+        //ビットレートの指定がなければ、メインの出力の設定を画素数比で変換して使用する
+        auto& rcParams = renditionParam.encConfig.rcParams;
+        const double pixelRatio = (rendition.width * rendition.height) / (double)(m_uEncWidth * m_uEncHeight);
+        const uint32_t mainBitrate = rcParams.averageBitRate;
+        rcParams.averageBitRate = (rendition.bitrate > 0) ? rendition.bitrate * 1000 : (uint32_t)(rcParams.averageBitRate * pixelRatio + 0.5);
+        rcParams.maxBitRate = (rendition.maxBitrate > 0) ? rendition.maxBitrate * 1000 : (uint32_t)(rcParams.maxBitRate * pixelRatio + 0.5);
+        if (mainBitrate > 0) {
+            const double bitrateRatio = rcParams.averageBitRate / (double)mainBitrate;
+            rcParams.vbvBufferSize   = (uint32_t)(rcParams.vbvBufferSize * bitrateRatio + 0.5);
+            rcParams.vbvInitialDelay = (uint32_t)(rcParams.vbvInitialDelay * bitrateRatio + 0.5);
+        }
+
+        unique_ptr<NVEncCore> renditionCore(new NVEncCore());
+        auto nvStatus = renditionCore->InitRendition(this, i, renditionParam, fanoutFrame, encBufferFormat);
+        if (nvStatus != NV_ENC_SUCCESS) {
+            PrintMes(RGY_LOG_ERROR, _T("Failed to initialize rendition #%d: \"%s\".\n"), i+1, rendition.outputFilename.c_str());
+            return nvStatus;
+        }
+        PrintMes(RGY_LOG_DEBUG, _T("Initialized rendition #%d: %dx%d, %d kbps, \"%s\".\n"),
+            i+1, rendition.width, rendition.height, rcParams.averageBitRate / 1000, rendition.outputFilename.c_str());
+        m_renditions.push_back(std::move(renditionCore));
+    }
+    if (m_frameFanout.init((int)m_fanoutFrames.size(), (int)m_renditions.size())) {
+        PrintMes(RGY_LOG_ERROR, _T("Failed to initialize frame fanout for renditions.\n"));
+        return NV_ENC_ERR_GENERIC;
+    }
+    m_renditionStatus.assign(m_renditions.size(), NV_ENC_SUCCESS);
+    PrintMes(RGY_LOG_DEBUG, _T("InitRenditions: %d renditions, %d fanout slots (%dx%d %s).\n"),
+        (int)m_renditions.size(), (int)m_fanoutFrames.size(), fanoutFrame.width, fanoutFrame.height, RGY_CSP_NAMES[fanoutFrame.csp]);
+    return NV_ENC_SUCCESS;
+#else
+    UNREFERENCED_PARAMETER(encBufferFormat);
+    PrintMes(RGY_LOG_ERROR, _T("--output-rendition is not supported in this build.\n"));
+    return NV_ENC_ERR_UNIMPLEMENTED;
+#endif //#if ENABLE_AVSW_READER
+}
+
+NVENCSTATUS NVEncCore::InitRendition(NVEncCore *parent, int index, const InEncodeVideoParam& renditionParam, const FrameInfo& frameIn, NV_ENC_BUFFER_FORMAT encBufferFormat) {
+    NVENCSTATUS nvStatus = NV_ENC_SUCCESS;
+    m_pRenditionParent = parent;
+    m_nRenditionIndex = index;
+    m_renditionParam = renditionParam;
+    m_pNVLog = parent->m_pNVLog;
+    m_pAbortByUser = parent->m_pAbortByUser;
+
+    //デバイス・CUDAコンテキストは分配元のものを共有する
+    m_GPUList = parent->m_GPUList;
+    m_nDeviceId = parent->m_nDeviceId;
+    m_nGPUNumaNode = parent->m_nGPUNumaNode;
+    m_threadAffinity = parent->m_threadAffinity;
+    m_cudaSchedule = parent->m_cudaSchedule;
+    m_device = parent->m_device;
+    m_cuContextCurr = parent->m_cuContextCurr;
+    m_ctxLock = parent->m_ctxLock;
+    m_pDevice = parent->m_pDevice;
+
+    //入力の情報も分配元のものを使用する
+    m_pFileReader = parent->m_pFileReader;
+    m_trimParam = parent->m_trimParam;
+    m_inputFps = parent->m_inputFps;
+    m_outputTimebase = parent->m_outputTimebase;
+    m_nAVSyncMode = parent->m_nAVSyncMode;
+    m_nBitstreamThread = m_renditionParam.nBitstreamThread;
+
+    if (NULL == (m_hinstLib = LoadLibrary(NVENCODE_API_DLL))) {
+        PrintMes(RGY_LOG_ERROR, _T("%s does not exists in your system.\n"), NVENCODE_API_DLL);
+        return NV_ENC_ERR_OUT_OF_MEMORY;
+    }
+    if (NV_ENC_SUCCESS != (nvStatus = InitEncodeSession())) {
+        return nvStatus;
+    }
+    if (NV_ENC_SUCCESS != (nvStatus = createDeviceFeatureList(false))) {
+        return nvStatus;
+    }
+
+    //進捗表示はメインの出力のみで行い、結果は名前をつけて区別する
+    const auto& mainStatus = parent->m_pStatus->m_sData;
+    m_pStatus.reset(new EncodeStatus());
+    m_pStatus->Init(mainStatus.outputFPSRate, mainStatus.outputFPSScale, mainStatus.frameTotal, m_pNVLog, nullptr);
+    m_pStatus->SetName(strsprintf(_T("rendition #%d: %dx%d"), index+1, m_renditionParam.input.dstWidth, m_renditionParam.input.dstHeight));
+    m_pStatus->SetDisplay(false);
+
+    if (NV_ENC_SUCCESS != (nvStatus = InitRenditionFilters(&m_renditionParam, frameIn))) {
+        return nvStatus;
+    }
+    if (NV_ENC_SUCCESS != (nvStatus = CreateEncoder(&m_renditionParam))) {
+        return nvStatus;
+    }
+    if (NV_ENC_SUCCESS != (nvStatus = AllocateIOBuffers(m_uEncWidth, m_uEncHeight, encBufferFormat, &m_renditionParam.input))) {
+        return nvStatus;
+    }
+    if (NV_ENC_SUCCESS != (nvStatus = InitOutput(&m_renditionParam, encBufferFormat))) {
+        PrintMes(RGY_LOG_ERROR, _T("Failed to open output file: \"%s\"\n"), m_renditionParam.outputFilename.c_str());
+        return nvStatus;
+    }
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NVEncCore::InitRenditionFilters(const InEncodeVideoParam *inputParam, const FrameInfo& frameIn) {
+    FrameInfo inputFrame = frameIn;
+    m_uEncWidth  = inputParam->input.dstWidth;
+    m_uEncHeight = inputParam->input.dstHeight;
+    m_stPicStruct = NV_ENC_PIC_STRUCT_FRAME;
+
+    auto add_filter = [&](unique_ptr<NVEncFilter> filter, shared_ptr<NVEncFilterParam> param) {
+        NVEncCtxAutoLock(cxtlock(m_ctxLock));
+        auto sts = filter->init(param, m_pNVLog);
+        if (sts != NV_ENC_SUCCESS) {
+            return sts;
+        }
+        //フィルタチェーンに追加
+        m_vpFilters.push_back(std::move(filter));
+        //パラメータ情報を更新
+        m_pLastFilterParam = param;
+        //入力フレーム情報を更新
+        inputFrame = param->frameOut;
+        return NV_ENC_SUCCESS;
+    };
+    const auto encCsp = GetEncoderCSP(inputParam);
+    auto filterCsp = encCsp;
+    switch (filterCsp) {
+    case RGY_CSP_NV12: filterCsp = RGY_CSP_YV12; break;
+    case RGY_CSP_P010: filterCsp = RGY_CSP_YV12_16; break;
+    default: break;
+    }
+    NVENCSTATUS sts = NV_ENC_SUCCESS;
+    const bool bResizeRequired = (int)m_uEncWidth != inputFrame.width || (int)m_uEncHeight != inputFrame.height;
+    //リサイズフィルタが対応する色空間に変換
+    if (bResizeRequired && inputFrame.csp != filterCsp) {
+        shared_ptr<NVEncFilterParamCrop> param(new NVEncFilterParamCrop());
+        param->frameIn = inputFrame;
+        param->frameOut.csp = filterCsp;
+        param->frameOut.deivce_mem = true;
+        param->bOutOverwrite = false;
+        if (NV_ENC_SUCCESS != (sts = add_filter(unique_ptr<NVEncFilter>(new NVEncFilterCspCrop()), param))) {
+            return sts;
+        }
+    }
+    //リサイズ
+    if (bResizeRequired) {
+        shared_ptr<NVEncFilterParamResize> param(new NVEncFilterParamResize());
+        param->interp = (inputParam->vpp.resizeInterp != NPPI_INTER_UNDEFINED) ? inputParam->vpp.resizeInterp : RESIZE_CUDA_SPLINE36;
+#if _M_IX86
+        if (param->interp <= NPPI_INTER_MAX) {
+            param->interp = RESIZE_CUDA_SPLINE36;
+            PrintMes(RGY_LOG_WARN, _T("npp resize filters not supported in x86, switching to %s.\n"), get_chr_from_value(list_nppi_resize, param->interp));
+        }
+#endif
+        param->frameIn = inputFrame;
+        param->frameOut = inputFrame;
+        param->frameOut.width = m_uEncWidth;
+        param->frameOut.height = m_uEncHeight;
+        param->bOutOverwrite = false;
+        if (NV_ENC_SUCCESS != (sts = add_filter(unique_ptr<NVEncFilter>(new NVEncFilterResize()), param))) {
+            return sts;
+        }
+    }
+    //最後のフィルタ (エンコードバッファへのコピー)
+    {
+        shared_ptr<NVEncFilterParamCrop> param(new NVEncFilterParamCrop());
+        param->frameIn = inputFrame;
+        param->frameOut.csp = encCsp;
+        param->frameOut.deivce_mem = true;
+        param->bOutOverwrite = false;
+        if (NV_ENC_SUCCESS != (sts = add_filter(unique_ptr<NVEncFilter>(new NVEncFilterCspCrop()), param))) {
+            return sts;
+        }
+    }
+    {
+        NVEncCtxAutoLock(cxtlock(m_ctxLock));
+        for (auto& filter : m_vpFilters) {
+            filter->CheckPerformance(inputParam->vpp.bCheckPerformance);
+        }
+    }
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NVEncCore::FanoutFrame(const FrameInfo *pFrameInfo) {
+    //一番遅い追加の出力がスロットを解放するまで待機する
+    //追加の出力はフィルタの実行にctxlockを使用するので、ロックを取得する前に待機すること
+    const int slot = m_frameFanout.acquire();
+    if (slot < 0) {
+        PrintMes(RGY_LOG_ERROR, _T("Encoding of rendition stopped.\n"));
+        return NV_ENC_ERR_GENERIC;
+    }
+    auto& fanoutFrame = m_fanoutFrames[slot];
+    {
+        NVEncCtxAutoLock(ctxlock(m_ctxLock));
+        const auto frameInfoEx = getFrameInfoExtra(pFrameInfo);
+        auto cudaerr = cudaMemcpy2DAsync(fanoutFrame->frame.ptr, fanoutFrame->frame.pitch,
+            pFrameInfo->ptr, pFrameInfo->pitch,
+            frameInfoEx.width_byte, frameInfoEx.height_total, getCudaMemcpyKind(pFrameInfo->deivce_mem, true));
+        if (cudaerr == cudaSuccess) {
+            cudaerr = cudaEventRecord(fanoutFrame->event);
+        }
+        if (cudaerr != cudaSuccess) {
+            PrintMes(RGY_LOG_ERROR, _T("Failed to copy frame for rendition: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
+            m_frameFanout.abort();
+            return NV_ENC_ERR_GENERIC;
+        }
+    }
+    fanoutFrame->frame.timestamp = pFrameInfo->timestamp;
+    fanoutFrame->frame.duration  = pFrameInfo->duration;
+    fanoutFrame->frame.flags     = pFrameInfo->flags;
+    fanoutFrame->frame.picstruct = pFrameInfo->picstruct;
+    m_frameFanout.publish(slot);
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NVEncCore::EncodeRendition() {
+    NVENCSTATUS nvStatus = NV_ENC_SUCCESS;
+    auto& frameFanout = m_pRenditionParent->m_frameFanout;
+    const auto& fanoutFrames = m_pRenditionParent->m_fanoutFrames;
+    m_pStatus->SetStart();
+
+    //フィルタの終了(=分配されたフレームの使用の終了)を示すイベント
+    const int cudaEventFlags = (m_cudaSchedule & CU_CTX_SCHED_BLOCKING_SYNC) ? cudaEventBlockingSync : cudaEventDefault;
+    unique_ptr<cudaEvent_t, cudaevent_deleter> filterFin;
+    {
+        //ctxlockした状態でcudaEventCreateを行わないと、イベントは正常に動作しない
+        NVEncCtxAutoLock(ctxlock(m_ctxLock));
+        filterFin = std::unique_ptr<cudaEvent_t, cudaevent_deleter>(new cudaEvent_t(), cudaevent_deleter());
+        auto cudaret = cudaEventCreateWithFlags(filterFin.get(), cudaEventFlags | cudaEventDisableTiming);
+        if (cudaret != cudaSuccess) {
+            PrintMes(RGY_LOG_ERROR, _T("Error cudaEventCreate: %d (%s).\n"), cudaret, char_to_tstring(_cudaGetErrorEnum(cudaret)).c_str());
+            return NV_ENC_ERR_GENERIC;
+        }
+    }
+    if (m_nBitstreamThread != 0) {
+        if (NV_ENC_SUCCESS != (nvStatus = InitBitstreamCollector())) {
+            return nvStatus;
+        }
+    }
+
+    auto encode_frame = [&](int slot) {
+        //エンコードバッファを取得
+        EncodeBuffer *pEncodeBuffer = m_EncodeBufferQueue.GetAvailable();
+        if (!pEncodeBuffer) {
+            pEncodeBuffer = m_EncodeBufferQueue.GetPending();
+            ProcessOutput(pEncodeBuffer);
+            if (pEncodeBuffer->stInputBfr.hInputSurface) {
+                auto nvencret = NvEncUnmapInputResource(pEncodeBuffer->stInputBfr.hInputSurface);
+                if (nvencret != NV_ENC_SUCCESS) {
+                    PrintMes(RGY_LOG_ERROR, _T("Failed to Unmap input buffer %p: %s\n"), pEncodeBuffer->stInputBfr.hInputSurface, char_to_tstring(_nvencGetErrorEnum(nvencret)).c_str());
+                    return nvencret;
+                }
+                pEncodeBuffer->stInputBfr.hInputSurface = nullptr;
+            }
+            pEncodeBuffer = m_EncodeBufferQueue.GetAvailable();
+            if (!pEncodeBuffer) {
+                PrintMes(RGY_LOG_ERROR, _T("Error get enc buffer from queue.\n"));
+                return NV_ENC_ERR_GENERIC;
+            }
+        }
+        FrameInfo encFrameInfo = { 0 };
+        encFrameInfo.ptr = (uint8_t *)pEncodeBuffer->stInputBfr.pNV12devPtr;
+        encFrameInfo.pitch = pEncodeBuffer->stInputBfr.uNV12Stride;
+        encFrameInfo.width = pEncodeBuffer->stInputBfr.dwWidth;
+        encFrameInfo.height = pEncodeBuffer->stInputBfr.dwHeight;
+        encFrameInfo.deivce_mem = true;
+        encFrameInfo.csp = getEncCsp(pEncodeBuffer->stInputBfr.bufferFmt);
+        {
+            NVEncCtxAutoLock(ctxlock(m_ctxLock));
+            //分配元でのフレームのコピーの終了を待ってからフィルタを実行する
+            auto cudaret = cudaStreamWaitEvent(0, fanoutFrames[slot]->event, 0);
+            if (cudaret != cudaSuccess) {
+                PrintMes(RGY_LOG_ERROR, _T("Error cudaStreamWaitEvent: %d (%s).\n"), cudaret, char_to_tstring(_cudaGetErrorEnum(cudaret)).c_str());
+                return NV_ENC_ERR_GENERIC;
+            }
+            FrameInfo frameInfo = fanoutFrames[slot]->frame;
+            for (uint32_t ifilter = 0; ifilter < m_vpFilters.size(); ifilter++) {
+                int nOutFrames = 0;
+                FrameInfo *outInfo[16] = { 0 };
+                //最後のフィルタはエンコードバッファに直接出力する
+                if (ifilter == m_vpFilters.size() - 1) {
+                    outInfo[0] = &encFrameInfo;
+                }
+                auto sts_filter = m_vpFilters[ifilter]->filter(&frameInfo, (FrameInfo **)&outInfo, &nOutFrames);
+                if (sts_filter != NV_ENC_SUCCESS) {
+                    PrintMes(RGY_LOG_ERROR, _T("Error while running filter \"%s\".\n"), m_vpFilters[ifilter]->name().c_str());
+                    return sts_filter;
+                }
+                frameInfo = *(outInfo[0]);
+            }
+            cudaret = cudaEventRecord(*filterFin);
+            if (cudaret != cudaSuccess) {
+                PrintMes(RGY_LOG_ERROR, _T("Error cudaEventRecord: %d (%s).\n"), cudaret, char_to_tstring(_cudaGetErrorEnum(cudaret)).c_str());
+                return NV_ENC_ERR_GENERIC;
+            }
+        }
+        //エンコードバッファへのコピーまで終了するのを待機 (これで分配されたフレームは使用済みとなる)
+        cudaEventSynchronize(*filterFin);
+        auto nvencret = NvEncMapInputResource(pEncodeBuffer->stInputBfr.nvRegisteredResource, &pEncodeBuffer->stInputBfr.hInputSurface);
+        if (nvencret != NV_ENC_SUCCESS) {
+            PrintMes(RGY_LOG_ERROR, _T("Failed to Map input buffer %p\n"), pEncodeBuffer->stInputBfr.hInputSurface);
+            return nvencret;
+        }
+        return NvEncEncodeFrame(pEncodeBuffer, encFrameInfo.timestamp, encFrameInfo.duration);
+    };
+
+    int nEncodeFrames = 0;
+    for (int slot = 0; nvStatus == NV_ENC_SUCCESS && (slot = frameFanout.pop(m_nRenditionIndex)) >= 0; nEncodeFrames++) {
+        nvStatus = encode_frame(slot);
+        frameFanout.release(slot);
+    }
+    //分配元が中断した場合
+    if (nvStatus == NV_ENC_SUCCESS && frameFanout.aborted()) {
+        nvStatus = NV_ENC_ERR_GENERIC;
+    }
+    //FlushEncoderはかならず行わないと、NvEncDestroyEncoderで異常終了する
+    if (nEncodeFrames > 0 || nvStatus == NV_ENC_SUCCESS) {
+        auto encstatus = FlushEncoder();
+        if (encstatus != NV_ENC_SUCCESS) {
+            PrintMes(RGY_LOG_ERROR, _T("Error FlushEncoder: %d.\n"), encstatus);
+            if (nvStatus == NV_ENC_SUCCESS) {
+                nvStatus = encstatus;
+            }
+        }
+    }
+    if (m_pBitstreamCollector) {
+        auto encstatus = m_pBitstreamCollector->finish();
+        if (encstatus != NV_ENC_SUCCESS) {
+            PrintMes(RGY_LOG_ERROR, _T("Error in bitstream thread: %s.\n"), char_to_tstring(_nvencGetErrorEnum(encstatus)).c_str());
+            if (nvStatus == NV_ENC_SUCCESS) {
+                nvStatus = encstatus;
+            }
+        }
+        m_pBitstreamCollector.reset();
+    }
+    m_pFileWriter->Close();
+    return nvStatus;
+}
+
+NVENCSTATUS NVEncCore::CloseRenditions(bool abort) {
+    if (abort) {
+        m_frameFanout.abort();
+    }
+    for (auto& th : m_thRenditions) {
+        if (th.joinable()) {
+            th.join();
+        }
+    }
+    m_thRenditions.clear();
+    NVENCSTATUS nvStatus = NV_ENC_SUCCESS;
+    for (int i = 0; i < (int)m_renditionStatus.size(); i++) {
+        if (m_renditionStatus[i] != NV_ENC_SUCCESS) {
+            PrintMes(RGY_LOG_DEBUG, _T("Rendition #%d finished with error: %s.\n"), i+1, char_to_tstring(_nvencGetErrorEnum(m_renditionStatus[i])).c_str());
+            if (nvStatus == NV_ENC_SUCCESS) {
+                nvStatus = m_renditionStatus[i];
+            }
+        }
+    }
+    return nvStatus;
+}
+
+NVENCSTATUS NVEncCore::Initialize(InEncodeVideoParam *inputParam) {
+    NVENCSTATUS nvStatus = NV_ENC_SUCCESS;
+
+    InitLog(inputParam);
+
+    if (NULL == m_hinstLib) {
+        if (NULL == (m_hinstLib = LoadLibrary(NVENCODE_API_DLL))) {
+#if FOR_AUO
+            PrintMes(RGY_LOG_ERROR, _T("%sがシステムに存在しません。\n"), NVENCODE_API_DLL);
+            PrintMes(RGY_LOG_ERROR, _T("NVIDIAのドライバが動作条件を満たしているか確認して下さい。"));
+#else
+            PrintMes(RGY_LOG_ERROR, _T("%s does not exists in your system.\n"), NVENCODE_API_DLL);
+            PrintMes(RGY_LOG_ERROR, _T("Please check if the GPU driver is propery installed."));
+#endif
+            return NV_ENC_ERR_OUT_OF_MEMORY;
+        }
+    }
+    PrintMes(RGY_LOG_DEBUG, _T("Loaded %s.\n"), NVENCODE_API_DLL);
+
+    //m_pDeviceを初期化
+    if (!check_if_nvcuda_dll_available()) {
+        PrintMes(RGY_LOG_ERROR,
+            FOR_AUO ? _T("CUDAが使用できないため、NVEncによるエンコードが行えません。(check_if_nvcuda_dll_available)\n") : _T("CUDA not available.\n"));
+        return NV_ENC_ERR_UNSUPPORTED_DEVICE;
+    }
+    m_nDeviceId = inputParam->deviceID;
+    //入力などにも渡すため、まずはインスタンスを作っておく必要がある
+    m_pPerfMonitor = std::unique_ptr<CPerfMonitor>(new CPerfMonitor());
+    return nvStatus;
+}
+
+NVENCSTATUS NVEncCore::NvEncEncodeFrame(EncodeBuffer *pEncodeBuffer, uint64_t timestamp, uint64_t duration) {
+    
+    NV_ENC_PIC_PARAMS encPicParams;
+    INIT_CONFIG(encPicParams, NV_ENC_PIC_PARAMS);
+
+    encPicParams.inputBuffer = pEncodeBuffer->stInputBfr.hInputSurface;
+    encPicParams.bufferFmt = pEncodeBuffer->stInputBfr.bufferFmt;
+    encPicParams.inputWidth = m_uEncWidth;
+    encPicParams.inputHeight = m_uEncHeight;
+    encPicParams.inputPitch = pEncodeBuffer->stInputBfr.uNV12Stride;
+    encPicParams.outputBitstream = pEncodeBuffer->stOutputBfr.hBitstreamBuffer;
+    encPicParams.completionEvent = pEncodeBuffer->stOutputBfr.hOutputEvent;
+    encPicParams.inputTimeStamp = timestamp;
+    encPicParams.inputDuration = duration;
+    encPicParams.pictureStruct = m_stPicStruct;
+    //出力側でフレームごとのメタデータを対応づけられるよう、入力順の番号をつけておく
+    encPicParams.frameIdx = m_nEncodeFrameIdx++;
+    //encPicParams.qpDeltaMap = qpDeltaMapArray;
+    //encPicParams.qpDeltaMapSize = qpDeltaMapArraySize;
+
+    //if (encPicCommand)
+    //{
+    //    if (encPicCommand->bForceIDR)
+    //    {
+    //        encPicParams.encodePicFlags |= NV_ENC_PIC_FLAG_FORCEIDR;
+    //    }
+
+    //    if (encPicCommand->bForceIntraRefresh)
+    //    {
+    //        if (codecGUID == NV_ENC_CODEC_HEVC_GUID)
+    //        {
+    //            encPicParams.codecPicParams.hevcPicParams.forceIntraRefreshWithFrameCnt = encPicCommand->intraRefreshDuration;
+    //        }
+    //        else
+    //        {
+    //            encPicParams.codecPicParams.h264PicParams.forceIntraRefreshWithFrameCnt = encPicCommand->intraRefreshDuration;
+    //        }
+    //    }
+    //}
+
+    NVENCSTATUS nvStatus = m_pEncodeAPI->nvEncEncodePicture(m_hEncoder, &encPicParams);
+    if (nvStatus != NV_ENC_SUCCESS && nvStatus != NV_ENC_ERR_NEED_MORE_INPUT) {
+        PrintMes(RGY_LOG_ERROR, FOR_AUO ? _T("フレームの投入に失敗しました。\n") : _T("Failed to add frame into the encoder.\n"));
+        return nvStatus;
+    }
+    if (m_pBitstreamCollector) {
+        //出力バッファは取り出しスレッドで待機する
+        return m_pBitstreamCollector->push(pEncodeBuffer);
+    }
+
+    return NV_ENC_SUCCESS;
+}
+
+#pragma warning(push)
+#pragma warning(disable: 4100)
+NVENCSTATUS NVEncCore::EncodeFrame(EncodeFrameConfig *pEncodeFrame, uint64_t timestamp, uint64_t duration) {
+    NVENCSTATUS nvStatus = NV_ENC_SUCCESS;
+#if ENABLE_AVSW_READER
+    EncodeBuffer *pEncodeBuffer = m_EncodeBufferQueue.GetAvailable();
+    if (!pEncodeBuffer) {
+        pEncodeBuffer = m_EncodeBufferQueue.GetPending();
+        ProcessOutput(pEncodeBuffer);
+        PrintMes(RGY_LOG_TRACE, _T("Output frame %d\n"), m_pStatus->m_sData.frameOut);
+        if (pEncodeBuffer->stInputBfr.hInputSurface) {
+            nvStatus = NvEncUnmapInputResource(pEncodeBuffer->stInputBfr.hInputSurface);
+            if (nvStatus != NV_ENC_SUCCESS) {
+                PrintMes(RGY_LOG_ERROR, _T("Failed to Unmap input buffer %p: %s\n"), pEncodeBuffer->stInputBfr.hInputSurface, char_to_tstring(_nvencGetErrorEnum(nvStatus)).c_str());
+                return nvStatus;
+            }
+            pEncodeBuffer->stInputBfr.hInputSurface = NULL;
+        }
+        pEncodeBuffer = m_EncodeBufferQueue.GetAvailable();
+    }
+
+    // encode width and height
+    unsigned int dwWidth  = pEncodeBuffer->stInputBfr.dwWidth;
+    unsigned int dwHeight = pEncodeBuffer->stInputBfr.dwHeight;
+
     cuvidCtxLock(m_ctxLock, 0);
     assert(pEncodeFrame->width == dwWidth && pEncodeFrame->height == dwHeight);
 
@@ -3347,6 +4255,11 @@ NVENCSTATUS NVEncCore::EncodeFrame(EncodeFrameConfig *pEncodeFrame, uint64_t tim
 #pragma warning(pop)
 
 #if 1
+//ステージングバッファの使用時間の計測用
+static inline int64_t staging_time_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 NVENCSTATUS NVEncCore::Encode() {
     NVENCSTATUS nvStatus = NV_ENC_SUCCESS;
     const uint32_t nPipelineDepth = PIPELINE_DEPTH;
@@ -3429,52 +4342,10 @@ NVENCSTATUS NVEncCore::Encode() {
     //cuvidデコード時は、timebaseの分子はかならず1
     const auto srcTimebase = (pStreamIn) ? rgy_rational<int>((m_cuvidDec) ? 1 : pStreamIn->time_base.num, pStreamIn->time_base.den) : rgy_rational<int>();
 
-    //streamのindexから必要なwriteへのポインタを返すテーブルを作成
-    std::map<int, shared_ptr<RGYOutputAvcodec>> pWriterForAudioStreams;
-    for (auto pWriter : m_pFileWriterListAudio) {
-        auto pAVCodecWriter = std::dynamic_pointer_cast<RGYOutputAvcodec>(pWriter);
-        if (pAVCodecWriter) {
-            auto trackIdList = pAVCodecWriter->GetStreamTrackIdList();
-            for (auto trackID : trackIdList) {
-                pWriterForAudioStreams[trackID] = pAVCodecWriter;
-            }
-        }
-    }
-
-    auto extract_audio =[&]() {
-        int sts = 0;
-        if (m_pFileWriterListAudio.size()) {
-            auto pAVCodecReader = std::dynamic_pointer_cast<RGYInputAvcodec>(m_pFileReader);
-            vector<AVPacket> packetList;
-            if (pAVCodecReader != nullptr) {
-                packetList = pAVCodecReader->GetStreamDataPackets();
-            }
-            //音声ファイルリーダーからのトラックを結合する
-            for (const auto& reader : m_AudioReaders) {
-                auto pReader = std::dynamic_pointer_cast<RGYInputAvcodec>(reader);
-                if (pReader != nullptr) {
-                    vector_cat(packetList, pReader->GetStreamDataPackets());
-                }
-            }
-            //パケットを各Writerに分配する
-            for (uint32_t i = 0; i < packetList.size(); i++) {
-                const int nTrackId = (int16_t)(packetList[i].flags >> 16);
-                if (pWriterForAudioStreams.count(nTrackId)) {
-                    auto pWriter = pWriterForAudioStreams[nTrackId];
-                    if (pWriter == nullptr) {
-                        PrintMes(RGY_LOG_ERROR, _T("Invalid writer found for audio track %d\n"), nTrackId);
-                        return 1;
-                    }
-                    if (0 != (sts = pWriter->WriteNextPacket(&packetList[i]))) {
-                        return 1;
-                    }
-                } else {
-                    PrintMes(RGY_LOG_ERROR, _T("Failed to find writer for audio track %d\n"), nTrackId);
-                    return 1;
-                }
-            }
-        }
-        return 0;
+    //音声・字幕のトラックごとに、読み込み側のパケットキューと出力先のWriterを対応づける
+    InitStreamPacketRoutes();
+    auto extract_audio = [this]() {
+        return ExtractStreamPackets();
     };
 
     std::thread th_input;
@@ -3500,7 +4371,7 @@ NVENCSTATUS NVEncCore::Encode() {
         PrintMes(RGY_LOG_DEBUG, _T("Started Encode thread\n"));
     }
 
-    if (m_pPerfMonitor) {
+    {
         HANDLE thOutput = NULL;
         HANDLE thInput = NULL;
         HANDLE thAudProc = NULL;
@@ -3515,10 +4386,40 @@ NVENCSTATUS NVEncCore::Encode() {
             thAudProc = pAVCodecWriter->getThreadHandleAudProcess();
             thAudEnc = pAVCodecWriter->getThreadHandleAudEncode();
         }
-        m_pPerfMonitor->SetThreadHandles((HANDLE)(th_input.native_handle()), thInput, thOutput, thAudProc, thAudEnc);
+        if (m_threadAffinity.enabled()) {
+            if (th_input.joinable()) {
+                setThreadAffinity(RGY_THREAD_DECODER, (HANDLE)(th_input.native_handle()));
+            }
+            setThreadAffinity(RGY_THREAD_INPUT,  thInput);
+            setThreadAffinity(RGY_THREAD_OUTPUT, thOutput);
+            setThreadAffinity(RGY_THREAD_AUDIO,  thAudProc);
+            setThreadAffinity(RGY_THREAD_AUDIO,  thAudEnc);
+        }
+        if (m_pPerfMonitor) {
+            m_pPerfMonitor->SetThreadHandles((HANDLE)(th_input.native_handle()), thInput, thOutput, thAudProc, thAudEnc);
+        }
     }
     int64_t nOutFirstPts = -1; //入力のptsに対する補正 (スケール: m_outputTimebase)
 #endif //#if ENABLE_AVSW_READER
+    //エンコーダからのビットストリームの取り出しを別スレッドで行い、フレームの投入を止めないようにする
+    if (m_nBitstreamThread != 0) {
+        if (NV_ENC_SUCCESS != (nvStatus = InitBitstreamCollector())) {
+            return nvStatus;
+        }
+    }
+    //ABRラダーの追加の出力のエンコードスレッドを開始
+    for (int i = 0; i < (int)m_renditions.size(); i++) {
+        m_thRenditions.push_back(std::thread([this, i]() {
+            m_renditionStatus[i] = m_renditions[i]->EncodeRendition();
+            if (m_renditionStatus[i] != NV_ENC_SUCCESS) {
+                //分配元が待機し続けないように中断する
+                m_frameFanout.abort();
+            }
+        }));
+        if (m_threadAffinity.enabled()) {
+            setThreadAffinity(RGY_THREAD_MAIN, (HANDLE)(m_thRenditions.back().native_handle()));
+        }
+    }
     int64_t nOutEstimatedPts = 0; //固定fpsを仮定した時のfps (スケール: m_outputTimebase)
     const int64_t nOutFrameDuration = std::max<int64_t>(1, rational_rescale(1, m_inputFps.inv(), m_outputTimebase)); //固定fpsを仮定した時の1フレームのduration (スケール: m_outputTimebase)
 
@@ -3747,6 +4648,13 @@ NVENCSTATUS NVEncCore::Encode() {
         if (bDrain) {
             return NV_ENC_SUCCESS; //最後までbDrain = trueなら、drain完了
         }
+        //ABRラダーの追加の出力にフレームを分配
+        if (m_renditions.size() > 0) {
+            auto sts_fanout = FanoutFrame(&frameInfo);
+            if (sts_fanout != NV_ENC_SUCCESS) {
+                return sts_fanout;
+            }
+        }
 
         //エンコードバッファを取得
         EncodeBuffer *pEncodeBuffer = m_EncodeBufferQueue.GetAvailable();
@@ -3850,6 +4758,22 @@ NVENCSTATUS NVEncCore::Encode() {
     deque<unique_ptr<FrameBufferDataIn>> dqInFrames;
     deque<unique_ptr<FrameBufferDataEnc>> dqEncFrames;
     int nEncodeFrames = 0;
+
+    //重複フレームの間引き
+    //直前に残したフレームを保持しておき、重複したフレームは破棄して、その表示時間を保持したフレームに加える
+    //保持したフレームのステージングバッファは、次に残すフレームが決まるまで解放されない
+    unique_ptr<FrameBufferDataIn> dedupHold;
+    auto dedup_frame = [&](unique_ptr<FrameBufferDataIn>& frame) {
+        if (dedupHold) {
+            if (m_pFrameDedup->drop(dedupHold->getFrameInfo(), frame->getFrameInfo())) {
+                dedupHold->setDuration(frame->getTimeStamp() + frame->getDuration() - dedupHold->getTimeStamp());
+                m_pStatus->m_sData.frameDrop++;
+                return;
+            }
+            dqInFrames.push_back(std::move(dedupHold));
+        }
+        dedupHold = std::move(frame);
+    };
     bool bInputEmpty = false;
     bool bFilterEmpty = false;
     for (int nInputFrame = 0, nFilterFrame = 0; nvStatus == NV_ENC_SUCCESS && !bInputEmpty && !bFilterEmpty; ) {
@@ -3866,7 +4790,9 @@ NVENCSTATUS NVEncCore::Encode() {
 #endif //#if ENABLE_AVSW_READER
 
         //転送の終了状況を確認、可能ならリソースの開放を行う
-        auto cuerr = check_inframe_transfer(nPipelineDepth);
+        //入力がホストメモリの場合は、ステージングバッファの段数まで転送を積んでおける
+        const uint32_t nTransferDepth = (m_inputHostBuffer.size()) ? (uint32_t)m_inputStagingRing.depth() : nPipelineDepth;
+        auto cuerr = check_inframe_transfer(nTransferDepth);
         if (cuerr != cudaSuccess) {
             PrintMes(RGY_LOG_ERROR, _T("Error cudaEventSynchronize: %d (%s).\n"), cuerr, char_to_tstring(_cudaGetErrorEnum(cuerr)).c_str());
             return NV_ENC_ERR_GENERIC;
@@ -3900,30 +4826,49 @@ NVENCSTATUS NVEncCore::Encode() {
         } else
 #endif //#if ENABLE_AVSW_READER
         if (m_inputHostBuffer.size()) {
-            auto& inputFrameBuf = m_inputHostBuffer[nInputFrame % m_inputHostBuffer.size()];
-            if (inputFrameBuf.heTransferFin) {
-                //対象バッファの転送が終了しているかを確認
-                while (WaitForSingleObject(inputFrameBuf.heTransferFin.get(), 0) == WAIT_TIMEOUT) {
-                    cuerr = check_inframe_transfer(nPipelineDepth);
-                    if (cuerr != cudaSuccess) {
-                        PrintMes(RGY_LOG_ERROR, _T("Error cudaEventSynchronize: %d (%s).\n"), cuerr, char_to_tstring(_cudaGetErrorEnum(cuerr)).c_str());
-                        return NV_ENC_ERR_GENERIC;
-                    }
+            //空いているステージングバッファを取得、なければ最も古い転送の終了を待機する
+            int stagingSlot = -1;
+            while ((stagingSlot = m_inputStagingRing.acquire()) < 0) {
+                if (dqFrameTransferData.size() == 0) {
+                    PrintMes(RGY_LOG_ERROR, _T("No input staging buffer available.\n"));
+                    return NV_ENC_ERR_GENERIC;
+                }
+                const auto waitStart = staging_time_us();
+                cuerr = check_inframe_transfer(1);
+                if (cuerr != cudaSuccess) {
+                    PrintMes(RGY_LOG_ERROR, _T("Error cudaEventSynchronize: %d (%s).\n"), cuerr, char_to_tstring(_cudaGetErrorEnum(cuerr)).c_str());
+                    return NV_ENC_ERR_GENERIC;
                 }
+                m_inputStagingRing.stall(staging_time_us() - waitStart);
+            }
+            //段数を増やした場合は、ここで初めてpinnedメモリを確保する
+            if (NV_ENC_SUCCESS != (nvStatus = AllocateInputHostBuffer(stagingSlot))) {
+                m_inputStagingRing.release(stagingSlot, staging_time_us());
+                return nvStatus;
             }
+            //このバッファが不要になったら(転送が終了したら)、スロットを解放する
+            auto stagingRelease = shared_ptr<void>(m_inputHostBuffer[stagingSlot].frameInfo.ptr, [this, stagingSlot](void *ptr) {
+                UNREFERENCED_PARAMETER(ptr);
+                m_inputStagingRing.release(stagingSlot, staging_time_us());
+            });
             NVTXRANGE(LoadNextFrame);
-            RGYFrame frame = RGYFrameInit(inputFrameBuf.frameInfo);
+            RGYFrame frame = RGYFrameInit(m_inputHostBuffer[stagingSlot].frameInfo);
             auto rgy_err = m_pFileReader->LoadNextFrame(&frame);
             if (rgy_err != RGY_ERR_NONE) {
                 if (rgy_err != RGY_ERR_MORE_DATA) { //RGY_ERR_MORE_DATAは読み込みの正常終了を示す
                     nvStatus = err_to_nv(rgy_err);
                 }
                 bInputEmpty = true;
+            } else {
+                m_inputStagingRing.submit(stagingSlot, staging_time_us());
             }
-            auto heTransferFin = shared_ptr<void>(inputFrameBuf.heTransferFin.get(), [&](void *ptr) {
-                SetEvent((HANDLE)ptr);
-            });
-            inputFrame.setHostFrameInfo(frame.getInfo(), heTransferFin);
+            if (m_pPerfMonitor) {
+                const auto stagingStats = m_inputStagingRing.stats();
+                auto pQueueInfo = m_pPerfMonitor->GetQueueInfoPtr();
+                pQueueInfo->usage_vid_stage = stagingStats.inflight;
+                pQueueInfo->depth_vid_stage = stagingStats.depth;
+            }
+            inputFrame.setHostFrameInfo(frame.getInfo(), stagingRelease);
         } else {
             PrintMes(RGY_LOG_ERROR, _T("Unexpected error at Encode().\n"));
             return NV_ENC_ERR_GENERIC;
@@ -3937,14 +4882,28 @@ NVENCSTATUS NVEncCore::Encode() {
             auto decFrames = check_pts(&inputFrame);
 
             for (auto idf = decFrames.begin(); idf != decFrames.end(); idf++) {
-                dqInFrames.push_back(std::move(*idf));
+                if (m_pFrameDedup) {
+                    dedup_frame(*idf);
+                } else {
+                    dqInFrames.push_back(std::move(*idf));
+                }
             }
         }
         inputFrame.resetCuvidInfo();
+        //入力が終了したら、保持しているフレームを送る
+        if (bInputEmpty && dedupHold) {
+            dqInFrames.push_back(std::move(dedupHold));
+        }
 
         while (((dqInFrames.size() || bInputEmpty) && !bFilterEmpty) && nvStatus == NV_ENC_SUCCESS) {
             const bool bDrain = (dqInFrames.size()) ? false : bInputEmpty;
             auto& inframe = (dqInFrames.size()) ? dqInFrames.front() : dummyFrame;
+#if ENABLE_AVSW_READER
+            if (m_pQualityMetric && !bDrain && inframe->inputIsHost()) {
+                //ステージングバッファは再利用されるので、フィルタに渡す前に比較元としてコピーしておく
+                m_pQualityMetric->addSource(inframe->getFrameInfo());
+            }
+#endif //#if ENABLE_AVSW_READER
             bool bDrainFin = bDrain;
             if (NV_ENC_SUCCESS != (nvStatus = filter_frame(nFilterFrame, inframe, dqEncFrames, bDrainFin))) {
                 break;
@@ -3980,6 +4939,14 @@ NVENCSTATUS NVEncCore::Encode() {
         }
         dqEncFrames.pop_front();
     }
+    //ABRラダーの追加の出力に、これ以上フレームがないことを通知する
+    if (m_renditions.size() > 0) {
+        if (nvStatus == NV_ENC_SUCCESS) {
+            m_frameFanout.finish();
+        } else {
+            m_frameFanout.abort();
+        }
+    }
 
 #if ENABLE_AVSW_READER
     if (th_input.joinable()) {
@@ -4015,9 +4982,74 @@ NVENCSTATUS NVEncCore::Encode() {
             PrintMes(RGY_LOG_DEBUG, _T("Flushed Encoder\n"));
         }
     }
+    if (m_pBitstreamCollector) {
+        //残りのビットストリームを出力し終えるまで待機する
+        encstatus = m_pBitstreamCollector->finish();
+        if (encstatus != NV_ENC_SUCCESS) {
+            PrintMes(RGY_LOG_ERROR, _T("Error in bitstream thread: %s.\n"), char_to_tstring(_nvencGetErrorEnum(encstatus)).c_str());
+            if (nvStatus == NV_ENC_SUCCESS) {
+                nvStatus = encstatus;
+            }
+        }
+        PrintMes(RGY_LOG_DEBUG, _T("Bitstream thread: %lld frames.\n"), (long long)m_pBitstreamCollector->frames());
+        m_pBitstreamCollector.reset();
+    }
+    //ABRラダーの追加の出力の終了を待機
+    if (m_renditions.size() > 0) {
+        encstatus = CloseRenditions(false);
+        if (encstatus != NV_ENC_SUCCESS) {
+            PrintMes(RGY_LOG_ERROR, _T("Error in encoding rendition: %s.\n"), char_to_tstring(_nvencGetErrorEnum(encstatus)).c_str());
+            if (nvStatus == NV_ENC_SUCCESS) {
+                nvStatus = encstatus;
+            }
+        }
+    }
     m_pFileWriter->Close();
     m_pFileReader->Close();
     m_pStatus->WriteResults();
+    for (auto& rendition : m_renditions) {
+        rendition->m_pStatus->WriteResults();
+    }
+    if (m_renditions.size() > 0) {
+        const auto fanoutStats = m_frameFanout.stats();
+        PrintMes(RGY_LOG_DEBUG, _T("Rendition fanout: %lld frames, %d slots, stall %lld times (%.1f ms).\n"),
+            (long long)fanoutStats.frames, m_frameFanout.slots(), (long long)fanoutStats.stalls, fanoutStats.stallUs * 0.001);
+        for (int i = 0; i < m_frameFanout.outputs(); i++) {
+            const auto outputStats = m_frameFanout.stats(i);
+            PrintMes(RGY_LOG_DEBUG, _T("  rendition #%d: %lld frames, wait %.1f ms, max queue %d.\n"),
+                i+1, (long long)outputStats.frames, outputStats.waitUs * 0.001, outputStats.maxQueue);
+        }
+    }
+    if (m_pFrameDedup) {
+        const auto dedupStats = m_pFrameDedup->stats();
+        PrintMes(RGY_LOG_INFO, _T("dedup: dropped %lld of %lld frames (%.1f%%), longest run %d, kept by max-drop %lld, %.1f us/frame.\n"),
+            (long long)dedupStats.dropped, (long long)dedupStats.frames + 1,
+            dedupStats.dropped * 100.0 / (std::max)(dedupStats.frames + 1, (int64_t)1),
+            dedupStats.maxRun, (long long)dedupStats.forced,
+            dedupStats.analyzeUs / (std::max)(dedupStats.frames, (int64_t)1));
+    }
+#if ENABLE_AVSW_READER
+    if (m_pQualityMetric) {
+        if (nvStatus == NV_ENC_ERR_ABORT) {
+            m_pQualityMetric->close();
+        } else {
+            //デコード待ちのフレームを処理してから結果を表示する
+            //計測の失敗はエンコード結果には影響しないので、エラーにはしない
+            auto err = m_pQualityMetric->finish();
+            if (err != RGY_ERR_NONE) {
+                PrintMes(RGY_LOG_WARN, _T("metric: stopped by error: %s.\n"), get_err_mes(err));
+            }
+            m_pQualityMetric->printResult();
+        }
+        m_pQualityMetric.reset();
+    }
+#endif //#if ENABLE_AVSW_READER
+    if (m_inputHostBuffer.size()) {
+        const auto stagingStats = m_inputStagingRing.stats();
+        PrintMes(RGY_LOG_DEBUG, _T("Input staging: depth %d (max %d), read %.1f us/frame, in use %.1f us/frame, stall %lld times (%.1f ms).\n"),
+            stagingStats.depth, stagingStats.maxDepth, stagingStats.avgPeriodUs, stagingStats.avgInflightUs,
+            (long long)stagingStats.stalls, stagingStats.stallUs * 0.001);
+    }
     vector<std::pair<tstring, double>> filter_result;
     for (auto& filter : m_vpFilters) {
         auto avgtime = filter->GetAvgTimeElapsed();
@@ -4058,52 +5090,10 @@ NVENCSTATUS NVEncCore::Encode() {
         pVideoCtx = pReader->GetInputVideoCodecCtx();
     }
 
-    //streamのindexから必要なwriteへのポインタを返すテーブルを作成
-    std::map<int, shared_ptr<RGYOutputAvcodec>> pWriterForAudioStreams;
-    for (auto pWriter : m_pFileWriterListAudio) {
-        auto pAVCodecWriter = std::dynamic_pointer_cast<RGYOutputAvcodec>(pWriter);
-        if (pAVCodecWriter) {
-            auto trackIdList = pAVCodecWriter->GetStreamTrackIdList();
-            for (auto trackID : trackIdList) {
-                pWriterForAudioStreams[trackID] = pAVCodecWriter;
-            }
-        }
-    }
-
-    auto extract_audio =[&]() {
-        int sts = 0;
-        if (m_pFileWriterListAudio.size()) {
-            auto pAVCodecReader = std::dynamic_pointer_cast<RGYInputAvcodec>(m_pFileReader);
-            vector<AVPacket> packetList;
-            if (pAVCodecReader != nullptr) {
-                packetList = pAVCodecReader->GetStreamDataPackets();
-            }
-            //音声ファイルリーダーからのトラックを結合する
-            for (const auto& reader : m_AudioReaders) {
-                auto pReader = std::dynamic_pointer_cast<RGYInputAvcodec>(reader);
-                if (pReader != nullptr) {
-                    vector_cat(packetList, pReader->GetStreamDataPackets());
-                }
-            }
-            //パケットを各Writerに分配する
-            for (uint32_t i = 0; i < packetList.size(); i++) {
-                const int nTrackId = (int16_t)(packetList[i].flags >> 16);
-                if (pWriterForAudioStreams.count(nTrackId)) {
-                    auto pWriter = pWriterForAudioStreams[nTrackId];
-                    if (pWriter == nullptr) {
-                        PrintMes(RGY_LOG_ERROR, _T("Invalid writer found for audio track %d\n"), nTrackId);
-                        return 1;
-                    }
-                    if (0 != (sts = pWriter->WriteNextPacket(&packetList[i]))) {
-                        return 1;
-                    }
-                } else {
-                    PrintMes(RGY_LOG_ERROR, _T("Failed to find writer for audio track %d\n"), nTrackId);
-                    return 1;
-                }
-            }
-        }
-        return 0;
+    //音声・字幕のトラックごとに、読み込み側のパケットキューと出力先のWriterを対応づける
+    InitStreamPacketRoutes();
+    auto extract_audio = [this]() {
+        return ExtractStreamPackets();
     };
 
     if (m_cuvidDec) {
@@ -4310,6 +5300,394 @@ NVENCSTATUS NVEncCore::Encode() {
 }
 #endif
 
+NVENCSTATUS NVEncCore::InitRemux(InEncodeVideoParam *inputParam) {
+    InitLog(inputParam);
+#if ENABLE_AVSW_READER
+    m_nAVSyncMode = inputParam->nAVSyncMode;
+    m_nProcSpeedLimit = inputParam->nProcSpeedLimit;
+
+    const bool bStatsOnly = inputParam->bBitstreamStats;
+    const bool bMetricOnly = !bStatsOnly && inputParam->sMetricRef.length() > 0;
+    const TCHAR *modeName = (bStatsOnly) ? _T("--bitstream-stats") : ((bMetricOnly) ? _T("--metric-ref") : _T("--remux"));
+
+    //GPUを使用しないため、パフォーマンスモニタは使用しない
+    if (inputParam->nPerfMonitorSelect || inputParam->nPerfMonitorSelectMatplot) {
+        PrintMes(RGY_LOG_WARN, _T("--perf-monitor cannot be used with %s, disabled.\n"), modeName);
+        inputParam->nPerfMonitorSelect = 0;
+        inputParam->nPerfMonitorSelectMatplot = 0;
+    }
+    if (inputParam->nTrimCount > 0) {
+        PrintMes(RGY_LOG_ERROR, _T("--trim cannot be used with %s.\n"), modeName);
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+    }
+    if (bStatsOnly || bMetricOnly) {
+        //映像の解析のみ行うので、音声・字幕・チャプターは読み込まない
+        if (inputParam->nAudioSelectCount > 0 || inputParam->nSubtitleSelectCount > 0 || inputParam->bCopyChapter) {
+            PrintMes(RGY_LOG_WARN, _T("audio/subtitle/chapter options are ignored with %s.\n"), modeName);
+            inputParam->nAudioSelectCount = 0;
+            inputParam->nSubtitleSelectCount = 0;
+            inputParam->bCopyChapter = false;
+        }
+    } else if (inputParam->sDynamicHdr10plus.length() > 0) {
+        //フレームの表示順の番号がわからないため、対応づけられない
+        PrintMes(RGY_LOG_ERROR, _T("--dhdr10-info cannot be used with --remux.\n"));
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+    }
+    if (inputParam->input.type == RGY_INPUT_FMT_AUTO) {
+        inputParam->input.type = RGY_INPUT_FMT_AVANY;
+    }
+    if (inputParam->input.type != RGY_INPUT_FMT_AVANY
+        && inputParam->input.type != RGY_INPUT_FMT_AVHW
+        && inputParam->input.type != RGY_INPUT_FMT_AVSW) {
+        PrintMes(RGY_LOG_ERROR, _T("%s can only be used with avhw / avsw reader.\n"), modeName);
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+    }
+
+    //入力ファイルを開き、入力情報も取得
+    NVENCSTATUS nvStatus = NV_ENC_SUCCESS;
+    if (NV_ENC_SUCCESS != (nvStatus = InitInput(inputParam))) {
+        PrintMes(RGY_LOG_ERROR, _T("Failed to open input file.\n"));
+        return nvStatus;
+    }
+    PrintMes(RGY_LOG_DEBUG, _T("InitInput: Success.\n"));
+
+    auto pAVCodecReader = std::dynamic_pointer_cast<RGYInputAvcodec>(m_pFileReader);
+    if (pAVCodecReader == nullptr) {
+        PrintMes(RGY_LOG_ERROR, _T("%s can only be used with avhw / avsw reader.\n"), modeName);
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+    }
+    const auto inputCodec = m_pFileReader->getInputCodec();
+    if (inputCodec != RGY_CODEC_H264 && inputCodec != RGY_CODEC_HEVC) {
+        PrintMes(RGY_LOG_ERROR, _T("%s supports only H.264/HEVC video stream.\n"), modeName);
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+    }
+    if (bStatsOnly) {
+        //出力ファイルには、フレームごとの解析結果を書き出す
+        m_bsAnalyzer.reset(new RGYBitstreamAnalyzer());
+        m_bsAnalyzer->init(inputCodec);
+        FILE *fp = nullptr;
+        if (_tfopen_s(&fp, inputParam->outputFilename.c_str(), _T("w")) || fp == nullptr) {
+            PrintMes(RGY_LOG_ERROR, _T("Failed to open output file \"%s\".\n"), inputParam->outputFilename.c_str());
+            return NV_ENC_ERR_GENERIC;
+        }
+        m_fpBitstreamStats = unique_ptr<FILE, fp_deleter>(fp, fp_deleter());
+        _ftprintf(m_fpBitstreamStats.get(), _T("frame,type,poc,qp,ref_l0,ref_l1,bytes,slices,slice_bytes\n"));
+        PrintMes(RGY_LOG_INFO, _T("%s\n"), m_pFileReader->GetInputMessage());
+        PrintMes(RGY_LOG_INFO, _T("Output:       %s (bitstream stats)\n"), inputParam->outputFilename.c_str());
+        return NV_ENC_SUCCESS;
+    }
+    //ptsをそのまま使用するので、timestampに問題がある場合は使用できない
+    const auto timestamp_status = pAVCodecReader->GetFramePosList()->getStreamPtsStatus();
+    if ((timestamp_status & (~RGY_PTS_NORMAL)) != 0) {
+        PrintMes(RGY_LOG_ERROR, _T("timestamp not acquired successfully from input steram, %s cannot be used. [0x%x]\n"), modeName, (uint32_t)timestamp_status);
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+    }
+    if (bMetricOnly) {
+        //出力ファイルには、フレームごとの計測結果を書き出す
+        if (NV_ENC_SUCCESS != (nvStatus = InitMetricRef(inputParam))) {
+            return nvStatus;
+        }
+        PrintMes(RGY_LOG_INFO, _T("%s\n"), m_pFileReader->GetInputMessage());
+        PrintMes(RGY_LOG_INFO, _T("Reference:    %s\n"), m_pMetricRefReader->GetInputMessage());
+        PrintMes(RGY_LOG_INFO, _T("Output:       %s (psnr/ssim)\n"), inputParam->outputFilename.c_str());
+        return NV_ENC_SUCCESS;
+    }
+
+    //出力の情報は、入力ストリームのものをそのまま使用する
+    const AVStream *pStreamIn = pAVCodecReader->GetInputVideoStream();
+    const AVCodecParameters *codecpar = pStreamIn->codecpar;
+    VideoInfo outputVideoInfo;
+    memset(&outputVideoInfo, 0, sizeof(outputVideoInfo));
+    outputVideoInfo.codec = inputCodec;
+    outputVideoInfo.codecLevel = codecpar->level;
+    outputVideoInfo.codecProfile = codecpar->profile;
+    outputVideoInfo.videoDelay = codecpar->video_delay;
+    outputVideoInfo.dstWidth = inputParam->input.srcWidth;
+    outputVideoInfo.dstHeight = inputParam->input.srcHeight;
+    outputVideoInfo.fpsN = inputParam->input.fpsN;
+    outputVideoInfo.fpsD = inputParam->input.fpsD;
+    if (inputParam->par[0] > 0 && inputParam->par[1] > 0) {
+        outputVideoInfo.sar[0] = inputParam->par[0];
+        outputVideoInfo.sar[1] = inputParam->par[1];
+    } else {
+        outputVideoInfo.sar[0] = inputParam->input.sar[0];
+        outputVideoInfo.sar[1] = inputParam->input.sar[1];
+    }
+    adjust_sar(&outputVideoInfo.sar[0], &outputVideoInfo.sar[1], outputVideoInfo.dstWidth, outputVideoInfo.dstHeight);
+    outputVideoInfo.picstruct = inputParam->input.picstruct;
+    outputVideoInfo.csp = inputParam->input.csp;
+    outputVideoInfo.vui.descriptpresent = 1;
+    outputVideoInfo.vui.colorprim = codecpar->color_primaries;
+    outputVideoInfo.vui.matrix = codecpar->color_space;
+    outputVideoInfo.vui.transfer = codecpar->color_trc;
+    outputVideoInfo.vui.fullrange = codecpar->color_range == AVCOL_RANGE_JPEG;
+    outputVideoInfo.vui.chromaloc = codecpar->chroma_location;
+
+    //入力streamのtimebaseをそのまま使用する
+    m_outputTimebase = to_rgy(pStreamIn->time_base);
+    if (NV_ENC_SUCCESS != (nvStatus = InitOutput(inputParam, outputVideoInfo))) {
+        PrintMes(RGY_LOG_ERROR, _T("Failed to initialize file writer(s).\n"));
+        return nvStatus;
+    }
+    PrintMes(RGY_LOG_DEBUG, _T("InitOutput: Success.\n"));
+
+    PrintMes(RGY_LOG_INFO, _T("%s\n"), m_pFileReader->GetInputMessage());
+    PrintMes(RGY_LOG_INFO, _T("Output:       %s, %dx%d, %d/%d fps (copy)\n"),
+        CodecToStr(inputCodec).c_str(), outputVideoInfo.dstWidth, outputVideoInfo.dstHeight, outputVideoInfo.fpsN, outputVideoInfo.fpsD);
+    return NV_ENC_SUCCESS;
+#else
+    PrintMes(RGY_LOG_ERROR, _T("--remux not supported in this build.\n"));
+    return NV_ENC_ERR_INVALID_CALL;
+#endif //#if ENABLE_AVSW_READER
+}
+
+NVENCSTATUS NVEncCore::InitMetricRef(const InEncodeVideoParam *inputParam) {
+#if ENABLE_AVSW_READER
+    auto pAVCodecReader = std::dynamic_pointer_cast<RGYInputAvcodec>(m_pFileReader);
+    const AVStream *pStreamIn = pAVCodecReader->GetInputVideoStream();
+    const auto desc = av_pix_fmt_desc_get((AVPixelFormat)pStreamIn->codecpar->format);
+    const bool yuv444 = desc && desc->log2_chroma_w == 0 && desc->log2_chroma_h == 0;
+    const bool yuv420 = desc && desc->log2_chroma_w == 1 && desc->log2_chroma_h == 1;
+    if (desc == nullptr || (desc->flags & AV_PIX_FMT_FLAG_RGB) || desc->nb_components < 3 || !(yuv420 || yuv444)) {
+        PrintMes(RGY_LOG_ERROR, _T("--metric-ref: unsupported pixel format of the input stream.\n"));
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+    }
+    const int bitdepth = desc->comp[0].depth;
+
+    //比較元の動画は、エンコード時の入力と同じ形式に変換して読み込む
+    //  --cropは比較元の動画に適用する
+    VideoInfo refInfo;
+    memset(&refInfo, 0, sizeof(refInfo));
+    refInfo.type = RGY_INPUT_FMT_AVSW;
+    refInfo.csp = (bitdepth > 8) ? ((yuv444) ? RGY_CSP_YUV444_16 : RGY_CSP_P010) : ((yuv444) ? RGY_CSP_YUV444 : RGY_CSP_NV12);
+    refInfo.crop = inputParam->input.crop;
+    AvcodecReaderPrm refPrm = { 0 };
+    refPrm.bReadVideo = true;
+    refPrm.nAVSyncMode = RGY_AVSYNC_ASSUME_CFR;
+    refPrm.nInputThread = inputParam->nInputThread;
+    auto refStatus = std::make_shared<EncodeStatus>();
+    refStatus->Init(inputParam->input.fpsN, inputParam->input.fpsD, 0, m_pNVLog, nullptr);
+    refStatus->SetDisplay(false);
+    m_pMetricRefReader = std::make_shared<RGYInputAvcodec>();
+    if (RGY_ERR_NONE != m_pMetricRefReader->Init(inputParam->sMetricRef.c_str(), &refInfo, &refPrm, m_pNVLog, refStatus)) {
+        PrintMes(RGY_LOG_ERROR, _T("--metric-ref: failed to open \"%s\": %s\n"), inputParam->sMetricRef.c_str(), m_pMetricRefReader->GetInputMessage());
+        return NV_ENC_ERR_GENERIC;
+    }
+    refInfo = m_pMetricRefReader->GetInputFrameInfo();
+    const int refWidth  = refInfo.srcWidth  - refInfo.crop.e.left - refInfo.crop.e.right;
+    const int refHeight = refInfo.srcHeight - refInfo.crop.e.up   - refInfo.crop.e.bottom;
+    if (refWidth != pStreamIn->codecpar->width || refHeight != pStreamIn->codecpar->height) {
+        PrintMes(RGY_LOG_ERROR, _T("--metric-ref: size of the reference %dx%d does not match the input %dx%d, use --crop to adjust the reference.\n"),
+            refWidth, refHeight, pStreamIn->codecpar->width, pStreamIn->codecpar->height);
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+    }
+
+    RGYQualityMetricParam prm;
+    prm.codec = m_pFileReader->getInputCodec();
+    prm.width = refWidth;
+    prm.height = refHeight;
+    prm.chromafmt = (yuv444) ? RGY_CHROMAFMT_YUV444 : RGY_CHROMAFMT_YUV420;
+    prm.bitdepth = bitdepth;
+    prm.sourceCsp = refInfo.csp;
+    //比較元の動画のtimestampは、入力のtimebaseに変換するので、丸め誤差を許容する
+    prm.matchTolerance = rational_rescale(1, rgy_rational<int>(inputParam->input.fpsD, inputParam->input.fpsN), to_rgy(pStreamIn->time_base)) / 2;
+    prm.psnr = inputParam->bMetricPsnr || !inputParam->bMetricSsim;
+    prm.ssim = inputParam->bMetricSsim || !inputParam->bMetricPsnr;
+    prm.perFrameFile = inputParam->outputFilename;
+    m_pQualityMetric.reset(new RGYQualityMetric());
+    if (RGY_ERR_NONE != m_pQualityMetric->init(prm, m_pNVLog)) {
+        m_pQualityMetric.reset();
+        return NV_ENC_ERR_GENERIC;
+    }
+    return NV_ENC_SUCCESS;
+#else
+    return NV_ENC_ERR_INVALID_CALL;
+#endif //#if ENABLE_AVSW_READER
+}
+
+NVENCSTATUS NVEncCore::Remux() {
+#if ENABLE_AVSW_READER
+    NVENCSTATUS nvStatus = NV_ENC_SUCCESS;
+    m_pStatus->SetStart();
+    InitStreamPacketRoutes();
+
+    auto pAVCodecReader = std::dynamic_pointer_cast<RGYInputAvcodec>(m_pFileReader);
+    const int64_t nFirstKeyPts = pAVCodecReader->GetVideoFirstKeyPts();
+    const RGY_CODEC codec = m_pFileReader->getInputCodec();
+
+    //--metric-ref: 比較元の動画のフレームは、対応する出力がデコードされる前に登録しておく必要があるので、
+    //入力のパケットのptsに追いつくまで先に読み込む
+    unique_ptr<uint8_t, aligned_malloc_deleter> refBuffer;
+    RGYFrame refFrame = RGYFrameInit();
+    rgy_rational<int> refTimebase, refFrameTime;
+    const auto streamTimebase = to_rgy(pAVCodecReader->GetInputVideoStream()->time_base);
+    int64_t refFirstPts = AV_NOPTS_VALUE;
+    int64_t refLastPts = -1;
+    int refFrames = 0;
+    bool refEof = true;
+    if (m_pQualityMetric) {
+        const auto refInfo = m_pMetricRefReader->GetInputFrameInfo();
+        const int pitch = ALIGN(refInfo.srcWidth * ((RGY_CSP_BIT_DEPTH[refInfo.csp] > 8) ? 2 : 1), 64);
+        refBuffer.reset((uint8_t *)_aligned_malloc((size_t)pitch * refInfo.srcHeight * 3, 64));
+        refFrame.set(refBuffer.get(),
+            refInfo.srcWidth - refInfo.crop.e.left - refInfo.crop.e.right,
+            refInfo.srcHeight - refInfo.crop.e.up - refInfo.crop.e.bottom, pitch, refInfo.csp);
+        refTimebase = to_rgy(std::dynamic_pointer_cast<RGYInputAvcodec>(m_pMetricRefReader)->GetInputVideoStream()->time_base);
+        refFrameTime = rgy_rational<int>(refInfo.fpsD, refInfo.fpsN);
+        refEof = false;
+    }
+    auto load_ref_frames = [&](int64_t pts) {
+        while (!refEof && refLastPts <= pts) {
+            auto err = m_pMetricRefReader->LoadNextFrame(&refFrame);
+            if (err == RGY_ERR_MORE_DATA) {
+                refEof = true;
+                break;
+            } else if (err != RGY_ERR_NONE) {
+                return err;
+            }
+            //比較元の動画のtimestampは、先頭を0として入力のtimebaseに変換する
+            //timestampがない場合は、フレームレートから求める
+            const int64_t refPts = (int64_t)refFrame.timestamp();
+            if (refPts != AV_NOPTS_VALUE && refFirstPts == AV_NOPTS_VALUE) {
+                refFirstPts = refPts;
+            }
+            refLastPts = (refPts != AV_NOPTS_VALUE)
+                ? rational_rescale(refPts - refFirstPts, refTimebase, streamTimebase)
+                : rational_rescale(refFrames, refFrameTime, streamTimebase);
+            refFrames++;
+            refFrame.setTimestamp(refLastPts);
+            if (RGY_ERR_NONE != (err = m_pQualityMetric->addSource(refFrame.getInfo()))) {
+                return err;
+            }
+        }
+        return RGY_ERR_NONE;
+    };
+
+    //映像はデコード・エンコードせず、パケットをそのまま出力に渡す
+    CProcSpeedControl speedCtrl(m_nProcSpeedLimit);
+    RGYBitstream bitstream = RGYBitstreamInit();
+    for (int nFrame = 0; nvStatus == NV_ENC_SUCCESS; ) {
+        if (m_pAbortByUser && *m_pAbortByUser) {
+            nvStatus = NV_ENC_ERR_ABORT;
+            break;
+        }
+        speedCtrl.wait();
+        if (0 != ExtractStreamPackets()) {
+            nvStatus = NV_ENC_ERR_GENERIC;
+            break;
+        }
+        auto sts = m_pFileReader->LoadNextFrame(nullptr);
+        if (sts == RGY_ERR_MORE_DATA) {
+            break; //ファイルの終わりに到達
+        } else if (sts != RGY_ERR_NONE) {
+            PrintMes(RGY_LOG_ERROR, _T("Error in reader: %s.\n"), get_err_mes(sts));
+            nvStatus = NV_ENC_ERR_GENERIC;
+            break;
+        }
+        sts = m_pFileReader->GetNextBitstream(&bitstream);
+        if (sts == RGY_ERR_MORE_BITSTREAM || bitstream.size() == 0) {
+            continue;
+        } else if (sts != RGY_ERR_NONE) {
+            PrintMes(RGY_LOG_ERROR, _T("Failed to get video packet: %s.\n"), get_err_mes(sts));
+            nvStatus = NV_ENC_ERR_GENERIC;
+            break;
+        }
+        bitstream.setPts(bitstream.pts() - nFirstKeyPts);
+        bitstream.setDts(bitstream.dts() - nFirstKeyPts);
+        if (nFrame == 0) {
+            //出力のヘッダ作成のため、最初のフレームにはSPS等が必要
+            const auto nal_list = (codec == RGY_CODEC_HEVC)
+                ? parse_nal_unit_hevc(bitstream.data(), (uint32_t)bitstream.size())
+                : parse_nal_unit_h264(bitstream.data(), (uint32_t)bitstream.size());
+            const uint8_t nal_sps = (codec == RGY_CODEC_HEVC) ? NALU_HEVC_SPS : NALU_H264_SPS;
+            if (std::none_of(nal_list.begin(), nal_list.end(), [nal_sps](const nal_info& info) { return info.type == nal_sps; })) {
+                RGYBitstream header = RGYBitstreamInit();
+                if (RGY_ERR_NONE != (sts = m_pFileReader->GetHeader(&header))
+                    || RGY_ERR_NONE != (sts = header.append(&bitstream))) {
+                    PrintMes(RGY_LOG_ERROR, _T("Failed to get video header: %s.\n"), get_err_mes(sts));
+                    header.clear();
+                    nvStatus = NV_ENC_ERR_GENERIC;
+                    break;
+                }
+                header.setPts(bitstream.pts());
+                header.setDts(bitstream.dts());
+                header.setDuration(bitstream.duration());
+                header.setFrametype(bitstream.frametype());
+                bitstream.clear();
+                bitstream = header;
+                PrintMes(RGY_LOG_DEBUG, _T("Added video header to the first packet.\n"));
+            }
+        }
+        if (m_bsAnalyzer) {
+            //--bitstream-stats: 解析結果のみを出力する
+            RGYBitstreamAUInfo info;
+            if (RGY_ERR_NONE != (sts = m_bsAnalyzer->analyze(bitstream.data(), (uint32_t)bitstream.size(), info))) {
+                PrintMes(RGY_LOG_WARN, _T("Failed to parse video packet #%d: %s.\n"), nFrame, get_err_mes(sts));
+            }
+            tstring sliceBytes;
+            for (const auto size : info.sliceSize) {
+                sliceBytes += strsprintf(_T("%s%u"), (sliceBytes.length() > 0) ? _T(":") : _T(""), size);
+            }
+            _ftprintf(m_fpBitstreamStats.get(), _T("%d,%s,%d,%d,%d,%d,%u,%d,%s\n"), nFrame,
+                rgy_frametype_str(info.frametype), info.poc, info.qp, info.refCount[0], info.refCount[1],
+                info.bytes, (int)info.sliceSize.size(), sliceBytes.c_str());
+            m_pStatus->SetOutputData(info.frametype, info.bytes, info.qp);
+            bitstream.setSize(0);
+            bitstream.setOffset(0);
+        } else if (m_pQualityMetric) {
+            //--metric-ref: デコードして比較元の動画と比較する
+            if (RGY_ERR_NONE != (sts = load_ref_frames(bitstream.pts()))
+                || RGY_ERR_NONE != (sts = m_pQualityMetric->addBitstream(&bitstream))) {
+                PrintMes(RGY_LOG_ERROR, _T("Failed to measure psnr/ssim: %s.\n"), get_err_mes(sts));
+                nvStatus = NV_ENC_ERR_GENERIC;
+                break;
+            }
+            m_pStatus->SetOutputData(bitstream.frametype(), (uint32_t)bitstream.size(), 0);
+            bitstream.setSize(0);
+            bitstream.setOffset(0);
+        } else if (RGY_ERR_NONE != (sts = m_pFileWriter->WriteNextFrame(&bitstream))) {
+            PrintMes(RGY_LOG_ERROR, _T("Failed to write video packet: %s.\n"), get_err_mes(sts));
+            nvStatus = NV_ENC_ERR_GENERIC;
+            break;
+        }
+        nFrame++;
+    }
+    bitstream.clear();
+    if (nvStatus == NV_ENC_SUCCESS && 0 != ExtractStreamPackets()) {
+        nvStatus = NV_ENC_ERR_GENERIC;
+    }
+    for (const auto& writer : m_pFileWriterListAudio) {
+        auto pAVCodecWriter = std::dynamic_pointer_cast<RGYOutputAvcodec>(writer);
+        if (pAVCodecWriter != nullptr) {
+            //キャッシュされたパケットを書き出す
+            pAVCodecWriter->WriteNextPacket(nullptr);
+        }
+    }
+    PrintMes(RGY_LOG_INFO, _T("                                                                             \n"));
+    if (m_pFileWriter) {
+        m_pFileWriter->Close();
+    }
+    m_fpBitstreamStats.reset();
+    if (m_pQualityMetric) {
+        auto sts = m_pQualityMetric->finish();
+        if (sts != RGY_ERR_NONE && nvStatus == NV_ENC_SUCCESS) {
+            PrintMes(RGY_LOG_ERROR, _T("Failed to measure psnr/ssim: %s.\n"), get_err_mes(sts));
+            nvStatus = NV_ENC_ERR_GENERIC;
+        }
+        m_pMetricRefReader->Close();
+    }
+    m_pFileReader->Close();
+    m_pStatus->WriteResults();
+    if (m_pQualityMetric) {
+        m_pQualityMetric->printResult();
+        m_pQualityMetric.reset();
+    }
+    return nvStatus;
+#else
+    return NV_ENC_ERR_INVALID_CALL;
+#endif //#if ENABLE_AVSW_READER
+}
+
 tstring NVEncCore::GetEncodingParamsInfo(int output_level) {
     tstring str;
     auto add_str =[output_level, &str](int info_level, const TCHAR *fmt, ...) {
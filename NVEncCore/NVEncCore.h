@@ -37,11 +37,20 @@
 #include <vector>
 #include <list>
 #include <string>
+#include <thread>
 #include "rgy_input.h"
 #include "rgy_output.h"
 #include "rgy_status.h"
 #include "rgy_log.h"
 #include "rgy_bitstream.h"
+#include "rgy_bitstream_analyzer.h"
+#include "rgy_thread_affinity.h"
+#include "rgy_staging_ring.h"
+#include "rgy_frame_fanout.h"
+#include "rgy_frame_dedup.h"
+#include "rgy_quality_metric.h"
+#include "rgy_queue.h"
+#include "NVEncBitstreamCollector.h"
 #include "NVEncUtil.h"
 #include "NVEncParam.h"
 #include "CuvidDecode.h"
@@ -65,9 +74,13 @@ typedef NVENCSTATUS (NVENCAPI *MYPROC)(NV_ENCODE_API_FUNCTION_LIST*);
 
 bool check_if_nvcuda_dll_available();
 
+#if ENABLE_AVSW_READER
+class RGYInputAvcodec;
+class RGYOutputAvcodec;
+#endif //#if ENABLE_AVSW_READER
+
 struct InputFrameBufInfo {
-    FrameInfo frameInfo; //入力フレームへのポインタと情報
-    std::unique_ptr<void, handle_deleter> heTransferFin; //入力フレームに関連付けられたイベント、このフレームが不要になったらSetする
+    FrameInfo frameInfo; //入力フレームへのポインタと情報 (ptrはm_inputStagingRingのスロットのpinnedメモリ)
 };
 
 class NVEncCodecFeature {
@@ -147,6 +160,14 @@ public:
     //エンコードを実行
     virtual NVENCSTATUS Encode();
 
+    //remuxの初期化 (エンコードを行わず、映像・音声・字幕をそのままコピーする、GPUは使用しない)
+    //  --bitstream-statsの場合は、出力は行わず映像の解析のみ行う
+    //  --metric-refの場合は、出力は行わず映像をデコードして比較元の動画とのPSNR/SSIMを計測する
+    virtual NVENCSTATUS InitRemux(InEncodeVideoParam *inputParam);
+
+    //remuxを実行
+    virtual NVENCSTATUS Remux();
+
     //エンコーダのClose・リソース開放
     virtual NVENCSTATUS Deinitialize();
 
@@ -184,6 +205,17 @@ protected:
     //エンコーダへの入力を初期化
     virtual NVENCSTATUS InitOutput(InEncodeVideoParam *inputParam, NV_ENC_BUFFER_FORMAT encBufferFormat);
 
+    //指定した映像の出力情報で出力を初期化
+    NVENCSTATUS InitOutput(InEncodeVideoParam *inputParam, const VideoInfo& outputVideoInfo);
+
+#if ENABLE_AVSW_READER
+    //音声・字幕のトラックごとに、読み込み側のパケットキューと出力先のWriterを対応づける
+    void InitStreamPacketRoutes();
+
+    //音声・字幕パケットを読み込み側のキューから各Writerに渡す
+    int ExtractStreamPackets();
+#endif //#if ENABLE_AVSW_READER
+
     //ログを初期化
     virtual NVENCSTATUS InitLog(const InEncodeVideoParam *inputParam);
 
@@ -196,6 +228,9 @@ protected:
     //CUDAインターフェースを初期化
     NVENCSTATUS InitCuda(int cudaSchedule);
 
+    //NVEnc APIのインスタンスを作成し、エンコードセッションを開く
+    NVENCSTATUS InitEncodeSession();
+
     //inputParamからエンコーダに渡すパラメータを設定
     NVENCSTATUS SetInputParam(const InEncodeVideoParam *inputParam);
 
@@ -211,6 +246,9 @@ protected:
     //入出力用バッファを確保
     NVENCSTATUS AllocateIOBuffers(uint32_t uInputWidth, uint32_t uInputHeight, NV_ENC_BUFFER_FORMAT inputFormat, const VideoInfo *pInputInfo);
 
+    //入力フレームのステージングバッファ(pinnedメモリ)を確保
+    NVENCSTATUS AllocateInputHostBuffer(int slot);
+
     //フレームを1枚エンコーダに投入(非同期)
     //NVENCSTATUS EncodeFrame(uint64_t timestamp);
 
@@ -228,6 +266,36 @@ protected:
     //フレームの出力と集計
     NVENCSTATUS ProcessOutput(const EncodeBuffer *pEncodeBuffer);
 
+    //ビットストリームの取り出しスレッドを開始
+    NVENCSTATUS InitBitstreamCollector();
+
+    //重複フレームの間引きを初期化
+    NVENCSTATUS InitFrameDedup(const InEncodeVideoParam *inputParam);
+
+    //出力のPSNR/SSIMの計測を初期化
+    NVENCSTATUS InitQualityMetric(const InEncodeVideoParam *inputParam);
+
+    //--metric-ref: 比較元の動画を開き、エンコード済みの動画との比較を初期化
+    NVENCSTATUS InitMetricRef(const InEncodeVideoParam *inputParam);
+
+    //ABRラダーの追加の出力を作成
+    NVENCSTATUS InitRenditions(const InEncodeVideoParam *inputParam, NV_ENC_BUFFER_FORMAT encBufferFormat);
+
+    //ABRラダーの追加の出力として初期化 (parentのデバイス・入力を共有し、parentから分配されたフレームをエンコードする)
+    NVENCSTATUS InitRendition(NVEncCore *parent, int index, const InEncodeVideoParam& renditionParam, const FrameInfo& frameIn, NV_ENC_BUFFER_FORMAT encBufferFormat);
+
+    //ABRラダーの追加の出力のフィルタを作成 (リサイズとエンコードバッファへのコピー)
+    NVENCSTATUS InitRenditionFilters(const InEncodeVideoParam *inputParam, const FrameInfo& frameIn);
+
+    //ABRラダーの追加の出力へフレームを分配
+    NVENCSTATUS FanoutFrame(const FrameInfo *pFrameInfo);
+
+    //ABRラダーの追加の出力のエンコードを実行 (追加の出力ごとのスレッドで実行)
+    NVENCSTATUS EncodeRendition();
+
+    //ABRラダーの追加の出力のエンコードの終了を待機
+    NVENCSTATUS CloseRenditions(bool abort);
+
     //cuvidでのリサイズを有効にするか
     bool enableCuvidResize(const InEncodeVideoParam *inputParam);
 
@@ -237,6 +305,9 @@ protected:
     //vpp-afsのrffが使用されているか
     bool VppAfsRffAware();
 
+    //指定したスレッドに--thread-affinityの設定を適用する
+    void setThreadAffinity(RGYThreadType type, HANDLE thread);
+
     std::list<NVGPUInfo>         m_GPUList;               //GPUのリスト
 
     bool                        *m_pAbortByUser;          //ユーザーからの中断指令
@@ -247,25 +318,57 @@ protected:
     CUcontext                    m_cuContextCurr;         //CUDAコンテキスト
     CUvideoctxlock               m_ctxLock;               //CUDAロック
     int                          m_nDeviceId;             //DeviceId
+    int                          m_nGPUNumaNode;          //GPUの接続されたNUMAノード (不明なら-1)
+    RGYThreadAffinity            m_threadAffinity;        //各スレッドのaffinity
     void                        *m_pDevice;               //デバイスインスタンス
     NV_ENCODE_API_FUNCTION_LIST *m_pEncodeAPI;            //NVEnc APIの関数リスト
     HINSTANCE                    m_hinstLib;              //nvEncodeAPI.dllのモジュールハンドル
     void                        *m_hEncoder;              //エンコーダのインスタンス
     NV_ENC_INITIALIZE_PARAMS     m_stCreateEncodeParams;  //エンコーダの初期化パラメータ
 
-    vector<InputFrameBufInfo>    m_inputHostBuffer;
+    vector<InputFrameBufInfo>    m_inputHostBuffer;       //入力フレームのステージングバッファ
+    RGYStagingRing               m_inputStagingRing;      //ステージングバッファの使用状況と段数の管理
+    int                          m_nInputStagingDepth;    //ステージングバッファの段数 (0で自動)
+    int                          m_nInputHostBufferSize;  //ステージングバッファ1枚のサイズ
+    unique_ptr<NVEncBitstreamCollector> m_pBitstreamCollector; //ビットストリームの取り出しスレッド
+    int                          m_nBitstreamThread;      //ビットストリームの取り出しスレッドを使用するか (-1: 自動, 0: 使用しない, 1: 使用する)
+    unique_ptr<RGYFrameDedup>    m_pFrameDedup;           //重複フレームの間引き (無効ならnullptr)
+    uint32_t                     m_nEncodeFrameIdx;       //エンコーダに投入したフレームの番号
+
+    NVEncCore                   *m_pRenditionParent;      //ABRラダーの追加の出力の場合、フレームの分配元 (メインの出力ならnullptr)
+    int                          m_nRenditionIndex;       //ABRラダーの追加の出力のインデックス
+    RGYFrameFanout               m_frameFanout;           //ABRラダーの追加の出力へのフレームの分配管理
+    vector<unique_ptr<CUFrameBuf>> m_fanoutFrames;        //ABRラダーの追加の出力へ分配するフレームのプール
+    vector<unique_ptr<NVEncCore>> m_renditions;           //ABRラダーの追加の出力
+    vector<std::thread>          m_thRenditions;          //ABRラダーの追加の出力のエンコードスレッド
+    vector<NVENCSTATUS>          m_renditionStatus;       //ABRラダーの追加の出力のエンコード結果
+    InEncodeVideoParam           m_renditionParam;        //ABRラダーの追加の出力の設定 (出力の初期化後も参照されるので保持しておく)
 
     sTrimParam                    m_trimParam;
     shared_ptr<RGYInput>          m_pFileReader;           //動画読み込み
     vector<shared_ptr<RGYInput>>  m_AudioReaders;
     shared_ptr<RGYOutput>         m_pFileWriter;           //動画書き出し
     vector<shared_ptr<RGYOutput>> m_pFileWriterListAudio;
+    shared_ptr<RGYHDR10Plus>      m_hdr10plus;             //HDR10+の動的メタデータ
+    unique_ptr<RGYBitstreamAnalyzer> m_bsAnalyzer;         //--bitstream-stats用の解析
+    unique_ptr<FILE, fp_deleter>  m_fpBitstreamStats;      //--bitstream-statsの出力先
     shared_ptr<EncodeStatus>      m_pStatus;               //エンコードステータス管理
     shared_ptr<CPerfMonitor>      m_pPerfMonitor;
     NV_ENC_PIC_STRUCT             m_stPicStruct;           //エンコードフレーム情報(プログレッシブ/インタレ)
     NV_ENC_CONFIG                 m_stEncConfig;           //エンコード設定
 #if ENABLE_AVSW_READER
     vector<unique_ptr<AVChapter>> m_AVChapterFromFile;   //ファイルから読み込んだチャプター
+
+    //音声・字幕のトラックの読み込み側のキューと出力先の対応
+    struct StreamPacketRoute {
+        int nTrackId;
+        RGYQueueSPSP<AVPacket> *pQueue;
+        shared_ptr<RGYOutputAvcodec> pWriter;
+    };
+    vector<shared_ptr<RGYInputAvcodec>> m_pStreamReaders;  //音声・字幕を読み込むリーダー
+    vector<StreamPacketRoute>     m_streamPacketRoutes;    //音声・字幕のトラックごとの出力先
+    unique_ptr<RGYQualityMetric>  m_pQualityMetric;        //出力のPSNR/SSIMの計測 (無効ならnullptr)
+    shared_ptr<RGYInput>          m_pMetricRefReader;      //--metric-refの比較元の動画
 #endif //#if ENABLE_AVSW_READER
 
     vector<unique_ptr<NVEncFilter>> m_vpFilters;
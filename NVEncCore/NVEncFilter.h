@@ -421,6 +421,8 @@ public:
     virtual ~NVEncFilterParamResize() {};
 };
 
+class NVEncFilterResizeCpu;
+
 class NVEncFilterResize : public NVEncFilter {
 public:
     NVEncFilterResize();
@@ -430,10 +432,15 @@ protected:
     virtual NVENCSTATUS run_filter(const FrameInfo *pInputFrame, FrameInfo **ppOutputFrames, int *pOutputFrameNum) override;
     NVENCSTATUS resizeYV12(FrameInfo *pOutputFrame, const FrameInfo *pInputFrame);
     NVENCSTATUS resizeYUV444(FrameInfo *pOutputFrame, const FrameInfo *pInputFrame);
+    //RESIZE_CPU_xxx: ホストメモリにコピーしてCPUでリサイズする (NVEncFilterResizeCpu.cpp)
+    NVENCSTATUS resizeCpu(FrameInfo *pOutputFrame, const FrameInfo *pInputFrame);
     virtual void close() override;
 
     bool m_bInterlacedWarn;
     CUMemBuf m_weightSpline36;
+    shared_ptr<NVEncFilterResizeCpu> m_resizeCpu;
+    FrameInfo m_cpuFrame[2]; //入力, 出力
+    unique_ptr<uint8_t, aligned_malloc_deleter> m_cpuBuf[2];
 };
 
 
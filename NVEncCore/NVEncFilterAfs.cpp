@@ -30,13 +30,11 @@
 #include <array>
 #include "convert_csp.h"
 #include "NVEncFilterAfs.h"
+#include "NVEncFilterAfsCpu.h"
 #include "NVEncParam.h"
 #include "afs_stg.h"
 #pragma warning (push)
 
-static void afs_get_motion_count_simd(int *motion_count, const uint8_t *ptr, const AFS_SCAN_CLIP *clip, int pitch, int scan_w, int scan_h, int tb_order);
-static void afs_get_stripe_count_simd(int *stripe_count, const uint8_t *ptr, const AFS_SCAN_CLIP *clip, int pitch, int scan_w, int scan_h, int tb_order);
-
 template<typename T>
 T max3(T a, T b, T c) {
     return std::max(std::max(a, b), c);
@@ -459,7 +457,10 @@ NVEncFilterAfs::NVEncFilterAfs() :
     m_status(),
     m_streamsts(),
     m_count_motion(),
-    m_fpTimecode() {
+    m_fpTimecode(),
+    m_afsCpu(),
+    m_afsCpuIn(),
+    m_afsCpuOut() {
     m_sFilterName = _T("afs");
 }
 
@@ -717,57 +718,75 @@ NVENCSTATUS NVEncFilterAfs::init(shared_ptr<NVEncFilterParam> pParam, shared_ptr
     AddMessage(RGY_LOG_DEBUG, _T("allocated output buffer: %dx%d, pitch %d, %s.\n"),
         m_pFrameBuf[0]->frame.width, m_pFrameBuf[0]->frame.height, m_pFrameBuf[0]->frame.pitch, RGY_CSP_NAMES[m_pFrameBuf[0]->frame.csp]);
 
-    if (CUDA_SUCCESS != (cudaerr = m_source.alloc(pAfsParam->frameOut))) {
-        AddMessage(RGY_LOG_ERROR, _T("failed to allocate memory: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
-        return NV_ENC_ERR_OUT_OF_MEMORY;
-    }
-    AddMessage(RGY_LOG_DEBUG, _T("allocated source buffer: %dx%d, pitch %d, %s.\n"),
-        m_source.get(0)->frame.width, m_source.get(0)->frame.height, m_source.get(0)->frame.pitch, RGY_CSP_NAMES[m_source.get(0)->frame.csp]);
+    if (pAfsParam->afs.cpu) {
+        //CPU版はホストメモリで処理するので、GPU版のキャッシュは確保しない
+        m_afsCpu.reset(new NVEncFilterAfsCpu());
+        auto sts_cpu = m_afsCpu->init(pAfsParam->afs, pAfsParam->frameOut, pAfsParam->inFps, pAfsParam->outTimebase, 0, pPrintMes);
+        if (sts_cpu != NV_ENC_SUCCESS) {
+            AddMessage(RGY_LOG_ERROR, _T("failed to initialize afs(cpu).\n"));
+            return sts_cpu;
+        }
+        m_afsCpuIn.reset(new afsCpuFrame());
+        m_afsCpuOut.reset(new afsCpuFrame());
+        if (m_afsCpuIn->alloc(pAfsParam->frameOut) || m_afsCpuOut->alloc(pAfsParam->frameOut)) {
+            AddMessage(RGY_LOG_ERROR, _T("failed to allocate host memory.\n"));
+            return NV_ENC_ERR_OUT_OF_MEMORY;
+        }
+        AddMessage(RGY_LOG_DEBUG, _T("allocated host buffer: %dx%d, pitch %d, %s.\n"),
+            m_afsCpuIn->frame.width, m_afsCpuIn->frame.height, m_afsCpuIn->frame.pitch, RGY_CSP_NAMES[m_afsCpuIn->frame.csp]);
+    } else {
+        if (CUDA_SUCCESS != (cudaerr = m_source.alloc(pAfsParam->frameOut))) {
+            AddMessage(RGY_LOG_ERROR, _T("failed to allocate memory: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
+            return NV_ENC_ERR_OUT_OF_MEMORY;
+        }
+        AddMessage(RGY_LOG_DEBUG, _T("allocated source buffer: %dx%d, pitch %d, %s.\n"),
+            m_source.get(0)->frame.width, m_source.get(0)->frame.height, m_source.get(0)->frame.pitch, RGY_CSP_NAMES[m_source.get(0)->frame.csp]);
 
-    if (CUDA_SUCCESS != (cudaerr = m_scan.alloc(pAfsParam->frameOut))) {
-        AddMessage(RGY_LOG_ERROR, _T("failed to allocate memory: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
-        return NV_ENC_ERR_OUT_OF_MEMORY;
-    }
-    AddMessage(RGY_LOG_DEBUG, _T("allocated scan buffer: %dx%d, pitch %d, %s.\n"),
-        m_scan.get(0)->map.frame.width, m_scan.get(0)->map.frame.height, m_scan.get(0)->map.frame.pitch, RGY_CSP_NAMES[m_scan.get(0)->map.frame.csp]);
+        if (CUDA_SUCCESS != (cudaerr = m_scan.alloc(pAfsParam->frameOut))) {
+            AddMessage(RGY_LOG_ERROR, _T("failed to allocate memory: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
+            return NV_ENC_ERR_OUT_OF_MEMORY;
+        }
+        AddMessage(RGY_LOG_DEBUG, _T("allocated scan buffer: %dx%d, pitch %d, %s.\n"),
+            m_scan.get(0)->map.frame.width, m_scan.get(0)->map.frame.height, m_scan.get(0)->map.frame.pitch, RGY_CSP_NAMES[m_scan.get(0)->map.frame.csp]);
 
-    if (CUDA_SUCCESS != (cudaerr = m_stripe.alloc(pAfsParam->frameOut))) {
-        AddMessage(RGY_LOG_ERROR, _T("failed to allocate memory: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
-        return NV_ENC_ERR_OUT_OF_MEMORY;
-    }
-    AddMessage(RGY_LOG_DEBUG, _T("allocated stripe buffer: %dx%d, pitch %d, %s.\n"),
-        m_stripe.get(0)->map.frame.width, m_stripe.get(0)->map.frame.height, m_stripe.get(0)->map.frame.pitch, RGY_CSP_NAMES[m_stripe.get(0)->map.frame.csp]);
+        if (CUDA_SUCCESS != (cudaerr = m_stripe.alloc(pAfsParam->frameOut))) {
+            AddMessage(RGY_LOG_ERROR, _T("failed to allocate memory: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
+            return NV_ENC_ERR_OUT_OF_MEMORY;
+        }
+        AddMessage(RGY_LOG_DEBUG, _T("allocated stripe buffer: %dx%d, pitch %d, %s.\n"),
+            m_stripe.get(0)->map.frame.width, m_stripe.get(0)->map.frame.height, m_stripe.get(0)->map.frame.pitch, RGY_CSP_NAMES[m_stripe.get(0)->map.frame.csp]);
 
-    m_streamAnalyze = std::unique_ptr<cudaStream_t, cudastream_deleter>(new cudaStream_t(), cudastream_deleter());
-    if (CUDA_SUCCESS != (cudaerr = cudaStreamCreateWithFlags(m_streamAnalyze.get(), cudaStreamNonBlocking))) {
-        AddMessage(RGY_LOG_ERROR, _T("failed to cudaStreamCreateWithFlags: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
-        return NV_ENC_ERR_OUT_OF_MEMORY;
-    }
+        m_streamAnalyze = std::unique_ptr<cudaStream_t, cudastream_deleter>(new cudaStream_t(), cudastream_deleter());
+        if (CUDA_SUCCESS != (cudaerr = cudaStreamCreateWithFlags(m_streamAnalyze.get(), cudaStreamNonBlocking))) {
+            AddMessage(RGY_LOG_ERROR, _T("failed to cudaStreamCreateWithFlags: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
+            return NV_ENC_ERR_OUT_OF_MEMORY;
+        }
 
-    m_streamCopy = std::unique_ptr<cudaStream_t, cudastream_deleter>(new cudaStream_t(), cudastream_deleter());
-    if (CUDA_SUCCESS != (cudaerr = cudaStreamCreateWithFlags(m_streamCopy.get(), cudaStreamNonBlocking))) {
-        AddMessage(RGY_LOG_ERROR, _T("failed to cudaStreamCreateWithFlags: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
-        return NV_ENC_ERR_OUT_OF_MEMORY;
-    }
+        m_streamCopy = std::unique_ptr<cudaStream_t, cudastream_deleter>(new cudaStream_t(), cudastream_deleter());
+        if (CUDA_SUCCESS != (cudaerr = cudaStreamCreateWithFlags(m_streamCopy.get(), cudaStreamNonBlocking))) {
+            AddMessage(RGY_LOG_ERROR, _T("failed to cudaStreamCreateWithFlags: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
+            return NV_ENC_ERR_OUT_OF_MEMORY;
+        }
 
-    const uint32_t cudaEventFlags = (pAfsParam->cudaSchedule & CU_CTX_SCHED_BLOCKING_SYNC) ? cudaEventBlockingSync : 0;
+        const uint32_t cudaEventFlags = (pAfsParam->cudaSchedule & CU_CTX_SCHED_BLOCKING_SYNC) ? cudaEventBlockingSync : 0;
 
-    m_eventSrcAdd = std::unique_ptr<cudaEvent_t, cudaevent_deleter>(new cudaEvent_t(), cudaevent_deleter());
-    if (CUDA_SUCCESS != (cudaerr = cudaEventCreateWithFlags(m_eventSrcAdd.get(), cudaEventFlags | cudaEventDisableTiming))) {
-        AddMessage(RGY_LOG_ERROR, _T("failed to cudaEventCreateWithFlags: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
-        return NV_ENC_ERR_OUT_OF_MEMORY;
-    }
+        m_eventSrcAdd = std::unique_ptr<cudaEvent_t, cudaevent_deleter>(new cudaEvent_t(), cudaevent_deleter());
+        if (CUDA_SUCCESS != (cudaerr = cudaEventCreateWithFlags(m_eventSrcAdd.get(), cudaEventFlags | cudaEventDisableTiming))) {
+            AddMessage(RGY_LOG_ERROR, _T("failed to cudaEventCreateWithFlags: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
+            return NV_ENC_ERR_OUT_OF_MEMORY;
+        }
 
-    m_eventScanFrame = std::unique_ptr<cudaEvent_t, cudaevent_deleter>(new cudaEvent_t(), cudaevent_deleter());
-    if (CUDA_SUCCESS != (cudaerr = cudaEventCreateWithFlags(m_eventScanFrame.get(), cudaEventFlags | cudaEventDisableTiming))) {
-        AddMessage(RGY_LOG_ERROR, _T("failed to cudaEventCreateWithFlags: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
-        return NV_ENC_ERR_OUT_OF_MEMORY;
-    }
+        m_eventScanFrame = std::unique_ptr<cudaEvent_t, cudaevent_deleter>(new cudaEvent_t(), cudaevent_deleter());
+        if (CUDA_SUCCESS != (cudaerr = cudaEventCreateWithFlags(m_eventScanFrame.get(), cudaEventFlags | cudaEventDisableTiming))) {
+            AddMessage(RGY_LOG_ERROR, _T("failed to cudaEventCreateWithFlags: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
+            return NV_ENC_ERR_OUT_OF_MEMORY;
+        }
 
-    m_eventMergeScan = std::unique_ptr<cudaEvent_t, cudaevent_deleter>(new cudaEvent_t(), cudaevent_deleter());
-    if (CUDA_SUCCESS != (cudaerr = cudaEventCreateWithFlags(m_eventMergeScan.get(), cudaEventFlags | cudaEventDisableTiming))) {
-        AddMessage(RGY_LOG_ERROR, _T("failed to cudaEventCreateWithFlags: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
-        return NV_ENC_ERR_OUT_OF_MEMORY;
+        m_eventMergeScan = std::unique_ptr<cudaEvent_t, cudaevent_deleter>(new cudaEvent_t(), cudaevent_deleter());
+        if (CUDA_SUCCESS != (cudaerr = cudaEventCreateWithFlags(m_eventMergeScan.get(), cudaEventFlags | cudaEventDisableTiming))) {
+            AddMessage(RGY_LOG_ERROR, _T("failed to cudaEventCreateWithFlags: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
+            return NV_ENC_ERR_OUT_OF_MEMORY;
+        }
     }
 
     pAfsParam->frameOut.picstruct = RGY_PICSTRUCT_FRAME;
@@ -787,7 +806,7 @@ NVENCSTATUS NVEncFilterAfs::init(shared_ptr<NVEncFilterParam> pParam, shared_ptr
 
     if (pAfsParam->afs.log) {
         const tstring log_filename = PathRemoveExtensionS(pAfsParam->outFilename) + _T(".afslog.csv");
-        if (m_streamsts.open_log(log_filename)) {
+        if ((m_afsCpu) ? m_afsCpu->open_log(log_filename) : m_streamsts.open_log(log_filename)) {
             errno_t error = errno;
             AddMessage(RGY_LOG_ERROR, _T("failed to open afs log file \"%s\": %s.\n"), log_filename.c_str(), _tcserror(error));
             return NV_ENC_ERR_GENERIC; // Couldn't open file
@@ -800,12 +819,12 @@ NVENCSTATUS NVEncFilterAfs::init(shared_ptr<NVEncFilterParam> pParam, shared_ptr
         _T("afs: clip(T %d, B %d, L %d, R %d), switch %d, coeff_shift %d\n")
         _T("                    thre(shift %d, deint %d, Ymotion %d, Cmotion %d)\n")
         _T("                    level %d, shift %s, drop %s, smooth %s, force24 %s\n")
-        _T("                    tune %s, tb_order %d(%s), rff %s, timecode %s, log %s"),
+        _T("                    tune %s, tb_order %d(%s), rff %s, timecode %s, log %s, cpu %s"),
         pAfsParam->afs.clip.top, pAfsParam->afs.clip.bottom , pAfsParam->afs.clip.left, pAfsParam->afs.clip.right,
         pAfsParam->afs.method_switch, pAfsParam->afs.coeff_shift,
         pAfsParam->afs.thre_shift, pAfsParam->afs.thre_deint, pAfsParam->afs.thre_Ymotion, pAfsParam->afs.thre_Cmotion,
         pAfsParam->afs.analyze, ON_OFF(pAfsParam->afs.shift), ON_OFF(pAfsParam->afs.drop), ON_OFF(pAfsParam->afs.smooth), ON_OFF(pAfsParam->afs.force24),
-        ON_OFF(pAfsParam->afs.tune), pAfsParam->afs.tb_order, pAfsParam->afs.tb_order ? _T("tff") : _T("bff"), ON_OFF(pAfsParam->afs.rff), ON_OFF(pAfsParam->afs.timecode), ON_OFF(pAfsParam->afs.log));
+        ON_OFF(pAfsParam->afs.tune), pAfsParam->afs.tb_order, pAfsParam->afs.tb_order ? _T("tff") : _T("bff"), ON_OFF(pAfsParam->afs.rff), ON_OFF(pAfsParam->afs.timecode), ON_OFF(pAfsParam->afs.log), ON_OFF(pAfsParam->afs.cpu));
 #undef ON_OFF
     m_pParam = pParam;
     return sts;
@@ -886,7 +905,7 @@ cudaError_t NVEncFilterAfs::count_motion(AFS_SCAN_DATA *sp, const AFS_SCAN_CLIP
     sp->ff_motion = count0;
     sp->lf_motion = count1;
     //AddMessage(RGY_LOG_INFO, _T("count_motion[%6d]: %6d - %6d (ff,lf)"), sp->frame, sp->ff_motion, sp->lf_motion);
-#if 0
+#if AFS_CPU_CHECK
     uint8_t *ptr = nullptr;
     if (cudaSuccess != (cudaerr = cudaMallocHost(&ptr, sp->map.frame.pitch * sp->map.frame.height))) {
         AddMessage(RGY_LOG_ERROR, _T("failed cudaMallocHost: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
@@ -898,7 +917,7 @@ cudaError_t NVEncFilterAfs::count_motion(AFS_SCAN_DATA *sp, const AFS_SCAN_CLIP
     }
 
     int motion_count[2] = { 0, 0 };
-    afs_get_motion_count_simd(motion_count, ptr, &sp->clip, sp->map.frame.pitch, sp->map.frame.width, sp->map.frame.height, sp->tb_order);
+    afs_get_motion_count(motion_count, ptr, &sp->clip, sp->map.frame.pitch, sp->map.frame.width, sp->map.frame.height, sp->tb_order);
     AddMessage((count0 == motion_count[0] && count1 == motion_count[1]) ? RGY_LOG_INFO : RGY_LOG_ERROR, _T("count_motion(ret, debug) = (%6d, %6d) / (%6d, %6d)\n"), count0, motion_count[0], count1, motion_count[1]);
     if (cudaSuccess != (cudaerr = cudaFreeHost(ptr))) {
         AddMessage(RGY_LOG_ERROR, _T("failed cudaFreeHost: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
@@ -976,7 +995,7 @@ cudaError_t NVEncFilterAfs::count_stripe(AFS_STRIPE_DATA *sp, const AFS_SCAN_CLI
     sp->count0 = count0;
     sp->count1 = count1;
     //AddMessage(RGY_LOG_INFO, _T("count_stripe[%6d]: %6d - %6d"), sp->frame, count0, count1);
-#if 0
+#if AFS_CPU_CHECK
     uint8_t *ptr = nullptr;
     if (cudaSuccess != (cudaerr = cudaMallocHost(&ptr, sp->map.frame.pitch * sp->map.frame.height))) {
         AddMessage(RGY_LOG_ERROR, _T("failed cudaMallocHost: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
@@ -988,7 +1007,7 @@ cudaError_t NVEncFilterAfs::count_stripe(AFS_STRIPE_DATA *sp, const AFS_SCAN_CLI
     }
 
     int stripe_count[2] = { 0, 0 };
-    afs_get_stripe_count_simd(stripe_count, ptr, clip, sp->map.frame.pitch, sp->map.frame.width, sp->map.frame.height, tb_order);
+    afs_get_stripe_count(stripe_count, ptr, clip, sp->map.frame.pitch, sp->map.frame.width, sp->map.frame.height, tb_order);
     AddMessage((count0 == stripe_count[0] && count1 == stripe_count[1]) ? RGY_LOG_INFO : RGY_LOG_ERROR, _T("count_stripe(ret, debug) = (%6d, %6d) / (%6d, %6d)\n"), count0, stripe_count[0], count1, stripe_count[1]);
     if (cudaSuccess != (cudaerr = cudaFreeHost(ptr))) {
         AddMessage(RGY_LOG_ERROR, _T("failed cudaFreeHost: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
@@ -1099,6 +1118,9 @@ NVENCSTATUS NVEncFilterAfs::run_filter(const FrameInfo *pInputFrame, FrameInfo *
         AddMessage(RGY_LOG_ERROR, _T("Invalid parameter type.\n"));
         return NV_ENC_ERR_INVALID_PARAM;
     }
+    if (m_afsCpu) {
+        return run_filter_cpu(pInputFrame, ppOutputFrames, pOutputFrameNum, pAfsParam.get());
+    }
 
     const int iframe = m_source.inframe();
     if (pInputFrame->ptr == nullptr && m_nFrame >= iframe) {
@@ -1248,6 +1270,68 @@ NVENCSTATUS NVEncFilterAfs::run_filter(const FrameInfo *pInputFrame, FrameInfo *
     return sts;
 }
 
+NVENCSTATUS NVEncFilterAfs::run_filter_cpu(const FrameInfo *pInputFrame, FrameInfo **ppOutputFrames, int *pOutputFrameNum, const NVEncFilterParamAfs *pAfsPrm) {
+    *pOutputFrameNum = 0;
+    ppOutputFrames[0] = nullptr;
+
+    //入力フレームをホストメモリにコピーする
+    const FrameInfo *pCpuInput = nullptr;
+    if (pInputFrame->ptr != nullptr) {
+        const auto memcpyKind = getCudaMemcpyKind(pInputFrame->deivce_mem, m_pFrameBuf[0]->frame.deivce_mem);
+        if (memcpyKind != cudaMemcpyDeviceToDevice) {
+            AddMessage(RGY_LOG_ERROR, _T("only supported on device memory.\n"));
+            return NV_ENC_ERR_UNSUPPORTED_PARAM;
+        }
+        if (m_pParam->frameOut.csp != m_pParam->frameIn.csp) {
+            AddMessage(RGY_LOG_ERROR, _T("csp does not match.\n"));
+            return NV_ENC_ERR_UNSUPPORTED_PARAM;
+        }
+        auto& hostIn = m_afsCpuIn->frame;
+        const auto frameInfoEx = getFrameInfoExtra(pInputFrame);
+        auto cudaerr = cudaMemcpy2D(hostIn.ptr, hostIn.pitch, pInputFrame->ptr, pInputFrame->pitch,
+            frameInfoEx.width_byte, frameInfoEx.height_total, cudaMemcpyDeviceToHost);
+        if (cudaerr != cudaSuccess) {
+            AddMessage(RGY_LOG_ERROR, _T("failed to copy frame to host: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
+            return NV_ENC_ERR_INVALID_CALL;
+        }
+        hostIn.timestamp = pInputFrame->timestamp;
+        hostIn.duration  = pInputFrame->duration;
+        hostIn.picstruct = pInputFrame->picstruct;
+        hostIn.flags     = pInputFrame->flags;
+        pCpuInput = &hostIn;
+    }
+
+    int nCpuOutput = 0;
+    auto sts = m_afsCpu->run(pCpuInput, &m_afsCpuOut->frame, &nCpuOutput);
+    if (sts != NV_ENC_SUCCESS || nCpuOutput == 0) {
+        return sts;
+    }
+
+    //結果をデバイスメモリに戻す
+    CUFrameBuf *pOutFrame = m_pFrameBuf[m_nFrameIdx].get();
+    ppOutputFrames[0] = &pOutFrame->frame;
+    m_nFrameIdx = (m_nFrameIdx + 1) % m_pFrameBuf.size();
+    *pOutputFrameNum = 1;
+
+    const auto& hostOut = m_afsCpuOut->frame;
+    const auto frameInfoEx = getFrameInfoExtra(&hostOut);
+    auto cudaerr = cudaMemcpy2D(pOutFrame->frame.ptr, pOutFrame->frame.pitch, hostOut.ptr, hostOut.pitch,
+        frameInfoEx.width_byte, frameInfoEx.height_total, cudaMemcpyHostToDevice);
+    if (cudaerr != cudaSuccess) {
+        AddMessage(RGY_LOG_ERROR, _T("failed to copy frame to device: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
+        return NV_ENC_ERR_INVALID_CALL;
+    }
+    pOutFrame->frame.flags     = hostOut.flags;
+    pOutFrame->frame.picstruct = hostOut.picstruct;
+    pOutFrame->frame.duration  = hostOut.duration;
+    pOutFrame->frame.timestamp = hostOut.timestamp;
+    if (pAfsPrm->afs.timecode) {
+        write_timecode(hostOut.timestamp, pAfsPrm->outTimebase);
+    }
+    m_nFrame++;
+    return NV_ENC_SUCCESS;
+}
+
 cudaError_t NVEncFilterAfs::copy_frame(CUFrameBuf *pOut, CUFrameBuf *p0, cudaStream_t stream) {
     const auto frameOutInfoEx = getFrameInfoExtra(&p0->frame);
     static const auto supportedCspYV12   = make_array<RGY_CSP>(RGY_CSP_YV12, RGY_CSP_YV12_09, RGY_CSP_YV12_10, RGY_CSP_YV12_12, RGY_CSP_YV12_14, RGY_CSP_YV12_16);
@@ -1330,83 +1414,8 @@ void NVEncFilterAfs::close() {
     m_status.clear();
     m_count_motion.clear();
     m_fpTimecode.reset();
+    m_afsCpu.reset();
+    m_afsCpuIn.reset();
+    m_afsCpuOut.reset();
     AddMessage(RGY_LOG_DEBUG, _T("closed afs filter.\n"));
 }
-
-static inline BOOL is_latter_field(int pos_y, int tb_order) {
-    return ((pos_y & 1) == tb_order);
-}
-
-static void afs_get_stripe_count_simd(int *stripe_count, const uint8_t *ptr, const AFS_SCAN_CLIP *clip, int pitch, int scan_w, int scan_h, int tb_order) {
-    static const _declspec(align(16)) BYTE STRIPE_COUNT_CHECK_MASK[][16] = {
-        { 0x50, 0x50, 0x50, 0x50, 0x50, 0x50, 0x50, 0x50, 0x50, 0x50, 0x50, 0x50, 0x50, 0x50, 0x50, 0x50 },
-        { 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60 },
-    };
-    const int y_fin = scan_h - clip->bottom - ((scan_h - clip->top - clip->bottom) & 1);
-    const uint32_t check_mask[2] = { 0x50, 0x60 };
-    __m128i xZero = _mm_setzero_si128();
-    __m128i xMask, x0, x1;
-    for (int pos_y = clip->top; pos_y < y_fin; pos_y++) {
-        const uint8_t *sip = ptr + pos_y * pitch + clip->left;
-        const int first_field_flag = !is_latter_field(pos_y, tb_order);
-        xMask = _mm_load_si128((const __m128i*)STRIPE_COUNT_CHECK_MASK[first_field_flag]);
-        const int x_count = scan_w - clip->right - clip->left;
-        const uint8_t *sip_fin = sip + (x_count & ~31);
-        for (; sip < sip_fin; sip += 32) {
-            x0 = _mm_loadu_si128((const __m128i*)(sip +  0));
-            x1 = _mm_loadu_si128((const __m128i*)(sip + 16));
-            x0 = _mm_and_si128(x0, xMask);
-            x1 = _mm_and_si128(x1, xMask);
-            x0 = _mm_cmpeq_epi8(x0, xZero);
-            x1 = _mm_cmpeq_epi8(x1, xZero);
-            uint32_t count0 = _mm_movemask_epi8(x0);
-            uint32_t count1 = _mm_movemask_epi8(x1);
-            stripe_count[first_field_flag] += popcnt32(((count1 << 16) | count0));
-        }
-        if (x_count & 16) {
-            x0 = _mm_loadu_si128((const __m128i*)sip);
-            x0 = _mm_and_si128(x0, xMask);
-            x0 = _mm_cmpeq_epi8(x0, xZero);
-            uint32_t count0 = _mm_movemask_epi8(x0);
-            stripe_count[first_field_flag] += popcnt32(count0);
-            sip += 16;
-        }
-        sip_fin = sip + (x_count & 15);
-        for (; sip < sip_fin; sip++)
-            stripe_count[first_field_flag] += (!(*sip & check_mask[first_field_flag]));
-    }
-}
-
-static void afs_get_motion_count_simd(int *motion_count, const uint8_t *ptr, const AFS_SCAN_CLIP *clip, int pitch, int scan_w, int scan_h, int tb_order) {
-    const int y_fin = scan_h - clip->bottom - ((scan_h - clip->top - clip->bottom) & 1);
-    __m128i xMotion = _mm_set1_epi8(0x40);
-    __m128i x0, x1;
-    for (int pos_y = clip->top; pos_y < y_fin; pos_y++) {
-        const uint8_t *sip = ptr + pos_y * pitch + clip->left;
-        const int is_latter_feild = is_latter_field(pos_y, tb_order);
-        const int x_count = scan_w - clip->right - clip->left;
-        const uint8_t *sip_fin = sip + (x_count & ~31);
-        for (; sip < sip_fin; sip += 32) {
-            x0 = _mm_loadu_si128((const __m128i*)(sip +  0));
-            x1 = _mm_loadu_si128((const __m128i*)(sip + 16));
-            x0 = _mm_andnot_si128(x0, xMotion);
-            x1 = _mm_andnot_si128(x1, xMotion);
-            x0 = _mm_cmpeq_epi8(x0, xMotion);
-            x1 = _mm_cmpeq_epi8(x1, xMotion);
-            uint32_t count0 = _mm_movemask_epi8(x0);
-            uint32_t count1 = _mm_movemask_epi8(x1);
-            motion_count[is_latter_feild] += popcnt32(((count1 << 16) | count0));
-        }
-        if (x_count & 16) {
-            x0 = _mm_loadu_si128((const __m128i*)sip);
-            x0 = _mm_andnot_si128(x0, xMotion);
-            x0 = _mm_cmpeq_epi8(x0, xMotion);
-            uint32_t count0 = _mm_movemask_epi8(x0);
-            motion_count[is_latter_feild] += popcnt32(count0);
-            sip += 16;
-        }
-        sip_fin = sip + (x_count & 15);
-        for (; sip < sip_fin; sip++)
-            motion_count[is_latter_feild] += ((~*sip & 0x40) >> 6);
-    }
-}
\ No newline at end of file
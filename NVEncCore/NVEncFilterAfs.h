@@ -224,6 +224,9 @@ private:
     unique_ptr<FILE, fp_deleter> m_fpLog;
 };
 
+class NVEncFilterAfsCpu;
+struct afsCpuFrame;
+
 class NVEncFilterAfs : public NVEncFilter {
 public:
     NVEncFilterAfs();
@@ -234,6 +237,7 @@ public:
 protected:
     virtual NVENCSTATUS run_filter(const FrameInfo *pInputFrame, FrameInfo **ppOutputFrames, int *pOutputFrameNum) override;
     virtual void close() override;
+    NVENCSTATUS run_filter_cpu(const FrameInfo *pInputFrame, FrameInfo **ppOutputFrames, int *pOutputFrameNum, const NVEncFilterParamAfs *pAfsPrm);
     NVENCSTATUS check_param(shared_ptr<NVEncFilterParamAfs> pAfsParam);
 
     cudaError_t analyze_stripe(CUFrameBuf *p0, CUFrameBuf *p1, AFS_SCAN_DATA *sp, CUMemBufPair *count_motion, const NVEncFilterParamAfs *pAfsPrm, cudaStream_t stream);
@@ -272,4 +276,9 @@ protected:
     afsStreamStatus m_streamsts;
     CUMemBufPair    m_count_motion;
     unique_ptr<FILE, fp_deleter> m_fpTimecode;
+
+    //cpu=trueの場合のCPU版 (入出力はホストメモリを経由する)
+    unique_ptr<NVEncFilterAfsCpu> m_afsCpu;
+    unique_ptr<afsCpuFrame> m_afsCpuIn;
+    unique_ptr<afsCpuFrame> m_afsCpuOut;
 };
@@ -0,0 +1,1146 @@
+﻿// -----------------------------------------------------------------------------------------
+// NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+//
+// The MIT License
+//
+// Copyright (c) 2014-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// ------------------------------------------------------------------------------------------
+
+#include <array>
+#include <algorithm>
+#include <emmintrin.h>
+#include "convert_csp.h"
+#include "rgy_simd.h"
+#include "NVEncFilterAfsCpu.h"
+
+//avx2版 (NVEncFilterAfsCpu_avx2.cpp)
+void afs_analyze_row8_avx2(uint8_t *flags, const uint8_t *p0c, const uint8_t *p0m, const uint8_t *p1c, const uint8_t *p1m,
+    int width, int has_prev, int shift_first_p0m, int thre_motion, int thre_deint, int thre_shift);
+void afs_gen_merge_row_avx2(uint8_t *mask0, uint8_t *mask_or, const uint8_t *const flags[3][4], int width);
+void afs_combine_row_avx2(uint8_t *dst, const uint8_t *mask_or4, const uint8_t *mask3, const uint8_t *mask2, const uint8_t *mask1, const uint8_t *mask0, int width);
+void afs_merge_scan_row_avx2(uint8_t *dst, const uint8_t *p0m, const uint8_t *p0c, const uint8_t *p0p, const uint8_t *p1m, const uint8_t *p1c, const uint8_t *p1p, int width);
+void afs_filter_h1_row_avx2(uint8_t *dst, const uint8_t *src, int width);
+void afs_filter_v1_row_avx2(uint8_t *dst, const uint8_t *srcm, const uint8_t *srcc, const uint8_t *srcp, int width);
+void afs_filter_h2_row_avx2(uint8_t *dst, const uint8_t *src, int width);
+void afs_filter_v2_row_avx2(uint8_t *dst, const uint8_t *srcm, const uint8_t *srcc, const uint8_t *srcp, int width);
+void afs_count_motion_avx2(int count[2], const uint8_t *ptr, int pitch, int x_start, int x_end, int y_start, int y_end, int tb_order);
+void afs_count_stripe_avx2(int count[2], const uint8_t *ptr, int pitch, int x_start, int x_end, int y_start, int y_end, int tb_order);
+
+static inline int is_latter_field(int pos_y, int tb_order) {
+    return ((pos_y & 1) == tb_order);
+}
+
+//--- 差分情報の作成 ---------------------------------------------------------------------
+template<typename T>
+static void afs_analyze_row_c(uint8_t *flags, const T *p0c, const T *p0m, const T *p1c, const T *p1m,
+    int width, int has_prev, int shift_first_p0m, int thre_motion, int thre_deint, int thre_shift) {
+    for (int x = 0; x < width; x++) {
+        //motion
+        const int abs_motion = std::abs((int)p0c[x] - (int)p1c[x]);
+        uint8_t flag = ((thre_motion > abs_motion) ? 0x08 : 0x00) | ((thre_shift > abs_motion) ? 0x80 : 0x00);
+        if (has_prev) {
+            //non-shift
+            const int ns0 = p0c[x];
+            const int ns1 = p0m[x];
+            const int abs_ns = std::abs(ns0 - ns1);
+            flag |= ((ns0 >= ns1) ? 0x40 : 0x00) | ((abs_ns > thre_deint) ? 0x10 : 0x00) | ((abs_ns > thre_shift) ? 0x20 : 0x00);
+            //shift
+            const int s0 = (shift_first_p0m) ? p0m[x] : p1m[x];
+            const int s1 = (shift_first_p0m) ? p1c[x] : p0c[x];
+            const int abs_s = std::abs(s0 - s1);
+            flag |= ((s0 >= s1) ? 0x04 : 0x00) | ((abs_s > thre_deint) ? 0x01 : 0x00) | ((abs_s > thre_shift) ? 0x02 : 0x00);
+        }
+        flags[x] = flag;
+    }
+}
+
+void afs_analyze_row8_c(uint8_t *flags, const uint8_t *p0c, const uint8_t *p0m, const uint8_t *p1c, const uint8_t *p1m,
+    int width, int has_prev, int shift_first_p0m, int thre_motion, int thre_deint, int thre_shift) {
+    afs_analyze_row_c<uint8_t>(flags, p0c, p0m, p1c, p1m, width, has_prev, shift_first_p0m, thre_motion, thre_deint, thre_shift);
+}
+
+//yuv420の色差 (補間済みの正規化値) 用
+static void afs_analyze_row_float(uint8_t *flags, const float *p0c, const float *p0m, const float *p1c, const float *p1m,
+    int width, int has_prev, int shift_first_p0m, float thre_motion, float thre_deint, float thre_shift) {
+    for (int x = 0; x < width; x++) {
+        const float abs_motion = std::abs(p0c[x] - p1c[x]);
+        uint8_t flag = ((thre_motion > abs_motion) ? 0x08 : 0x00) | ((thre_shift > abs_motion) ? 0x80 : 0x00);
+        if (has_prev) {
+            const float ns0 = p0c[x];
+            const float ns1 = p0m[x];
+            const float abs_ns = std::abs(ns1 - ns0);
+            flag |= ((ns0 >= ns1) ? 0x40 : 0x00) | ((abs_ns > thre_deint) ? 0x10 : 0x00) | ((abs_ns > thre_shift) ? 0x20 : 0x00);
+            const float s0 = (shift_first_p0m) ? p0m[x] : p1m[x];
+            const float s1 = (shift_first_p0m) ? p1c[x] : p0c[x];
+            const float abs_s = std::abs(s1 - s0);
+            flag |= ((s0 >= s1) ? 0x04 : 0x00) | ((abs_s > thre_deint) ? 0x01 : 0x00) | ((abs_s > thre_shift) ? 0x02 : 0x00);
+        }
+        flags[x] = flag;
+    }
+}
+
+//flags: y-3, y-2, y-1, y の4行分の差分情報から、y行目の判定マスクを作成する
+static inline uint8_t afs_gen_flag(uint8_t f3, uint8_t f2, uint8_t f1, uint8_t f0) {
+    uint8_t cs = f3 & 0x22;
+    uint8_t m = ((f2 ^ f3) & 0x44) >> 1;
+    cs &= m;
+    uint8_t cd = f2 & 0x11;
+    cs += f2 & 0x22;
+
+    m = (f1 ^ f2) & 0x44;
+    m |= m << 1;
+    m |= m >> 2;
+    cd &= m;
+    cs &= m;
+    cd += f1 & 0x11;
+    cs += f1 & 0x22;
+
+    m = (f0 ^ f1) & 0x44;
+    m |= m << 1;
+    m |= m >> 2;
+    cd &= m;
+    cs &= m;
+    cd += f0 & 0x11;
+    cs += f0 & 0x22;
+
+    return ((f0 & 0x88) >> 1)
+        | (((cd & 0x70) > 0x20) ? 0x01 : 0x00)
+        | (((cs & 0xE0) > 0x60) ? 0x10 : 0x00)
+        | (((cd & 0x07) > 0x02) ? 0x02 : 0x00)
+        | (((cs & 0x0E) > 0x06) ? 0x20 : 0x00);
+}
+
+void afs_gen_merge_row_c(uint8_t *mask0, uint8_t *mask_or, const uint8_t *const flags[3][4], int width) {
+    for (int x = 0; x < width; x++) {
+        const uint8_t y = afs_gen_flag(flags[0][0][x], flags[0][1][x], flags[0][2][x], flags[0][3][x]);
+        const uint8_t u = afs_gen_flag(flags[1][0][x], flags[1][1][x], flags[1][2][x], flags[1][3][x]);
+        const uint8_t v = afs_gen_flag(flags[2][0][x], flags[2][1][x], flags[2][2][x], flags[2][3][x]);
+        mask0[x]   = ((y & u & v) & 0xcc) | ((y | u | v) & 0x33);
+        mask_or[x] = (y | u | v) & 0x33;
+    }
+}
+
+void afs_combine_row_c(uint8_t *dst, const uint8_t *mask_or4, const uint8_t *mask3, const uint8_t *mask2, const uint8_t *mask1, const uint8_t *mask0, int width) {
+    for (int x = 0; x < width; x++) {
+        dst[x] = (mask_or4[x] & 0x30) | ((mask3[x] | mask2[x] | mask1[x]) & 0x33) | mask0[x];
+    }
+}
+
+void afs_merge_scan_row_c(uint8_t *dst, const uint8_t *p0m, const uint8_t *p0c, const uint8_t *p0p, const uint8_t *p1m, const uint8_t *p1c, const uint8_t *p1p, int width) {
+    for (int x = 0; x < width; x++) {
+        const uint8_t m4 = (p0m[x] | p0p[x] | 0xf3) & p0c[x];
+        const uint8_t m5 = (p1m[x] | p1p[x] | 0xf3) & p1c[x];
+        dst[x] = (m4 & m5 & 0x44) | (~p0c[x] & 0x33);
+    }
+}
+
+void afs_filter_h1_row_c(uint8_t *dst, const uint8_t *src, int width) {
+    for (int x = 0; x < width; x++) {
+        const uint8_t l = src[std::max(x - 1, 0)];
+        const uint8_t r = src[std::min(x + 1, width - 1)];
+        dst[x] = src[x] | ((l | r) & 0x03) | ((l & r) & 0x04);
+    }
+}
+
+void afs_filter_v1_row_c(uint8_t *dst, const uint8_t *srcm, const uint8_t *srcc, const uint8_t *srcp, int width) {
+    for (int x = 0; x < width; x++) {
+        dst[x] = srcc[x] | (srcm[x] & srcp[x] & 0x07);
+    }
+}
+
+void afs_filter_h2_row_c(uint8_t *dst, const uint8_t *src, int width) {
+    for (int x = 0; x < width; x++) {
+        const uint8_t l = src[std::max(x - 1, 0)];
+        const uint8_t r = src[std::min(x + 1, width - 1)];
+        dst[x] = src[x] & ((l & r) | 0xf8);
+    }
+}
+
+void afs_filter_v2_row_c(uint8_t *dst, const uint8_t *srcm, const uint8_t *srcc, const uint8_t *srcp, int width) {
+    for (int x = 0; x < width; x++) {
+        dst[x] = srcc[x] & ((srcm[x] & srcp[x]) | 0xf8);
+    }
+}
+
+static void afs_count_motion_sse2(int count[2], const uint8_t *ptr, int pitch, int x_start, int x_end, int y_start, int y_end, int tb_order) {
+    __m128i xMotion = _mm_set1_epi8(0x40);
+    __m128i x0, x1;
+    const int x_count = x_end - x_start;
+    for (int pos_y = y_start; pos_y < y_end; pos_y++) {
+        const uint8_t *sip = ptr + pos_y * pitch + x_start;
+        const int is_latter_feild = is_latter_field(pos_y, tb_order);
+        const uint8_t *sip_fin = sip + (x_count & ~31);
+        for (; sip < sip_fin; sip += 32) {
+            x0 = _mm_loadu_si128((const __m128i*)(sip +  0));
+            x1 = _mm_loadu_si128((const __m128i*)(sip + 16));
+            x0 = _mm_andnot_si128(x0, xMotion);
+            x1 = _mm_andnot_si128(x1, xMotion);
+            x0 = _mm_cmpeq_epi8(x0, xMotion);
+            x1 = _mm_cmpeq_epi8(x1, xMotion);
+            uint32_t count0 = _mm_movemask_epi8(x0);
+            uint32_t count1 = _mm_movemask_epi8(x1);
+            count[is_latter_feild] += popcnt32(((count1 << 16) | count0));
+        }
+        if (x_count & 16) {
+            x0 = _mm_loadu_si128((const __m128i*)sip);
+            x0 = _mm_andnot_si128(x0, xMotion);
+            x0 = _mm_cmpeq_epi8(x0, xMotion);
+            uint32_t count0 = _mm_movemask_epi8(x0);
+            count[is_latter_feild] += popcnt32(count0);
+            sip += 16;
+        }
+        sip_fin = sip + (x_count & 15);
+        for (; sip < sip_fin; sip++)
+            count[is_latter_feild] += ((~*sip & 0x40) >> 6);
+    }
+}
+
+static void afs_count_stripe_sse2(int count[2], const uint8_t *ptr, int pitch, int x_start, int x_end, int y_start, int y_end, int tb_order) {
+    const uint32_t check_mask[2] = { 0x50, 0x60 };
+    __m128i xZero = _mm_setzero_si128();
+    __m128i xMask, x0, x1;
+    const int x_count = x_end - x_start;
+    for (int pos_y = y_start; pos_y < y_end; pos_y++) {
+        const uint8_t *sip = ptr + pos_y * pitch + x_start;
+        const int first_field_flag = !is_latter_field(pos_y, tb_order);
+        xMask = _mm_set1_epi8((char)check_mask[first_field_flag]);
+        const uint8_t *sip_fin = sip + (x_count & ~31);
+        for (; sip < sip_fin; sip += 32) {
+            x0 = _mm_loadu_si128((const __m128i*)(sip +  0));
+            x1 = _mm_loadu_si128((const __m128i*)(sip + 16));
+            x0 = _mm_and_si128(x0, xMask);
+            x1 = _mm_and_si128(x1, xMask);
+            x0 = _mm_cmpeq_epi8(x0, xZero);
+            x1 = _mm_cmpeq_epi8(x1, xZero);
+            uint32_t count0 = _mm_movemask_epi8(x0);
+            uint32_t count1 = _mm_movemask_epi8(x1);
+            count[first_field_flag] += popcnt32(((count1 << 16) | count0));
+        }
+        if (x_count & 16) {
+            x0 = _mm_loadu_si128((const __m128i*)sip);
+            x0 = _mm_and_si128(x0, xMask);
+            x0 = _mm_cmpeq_epi8(x0, xZero);
+            uint32_t count0 = _mm_movemask_epi8(x0);
+            count[first_field_flag] += popcnt32(count0);
+            sip += 16;
+        }
+        sip_fin = sip + (x_count & 15);
+        for (; sip < sip_fin; sip++)
+            count[first_field_flag] += (!(*sip & check_mask[first_field_flag]));
+    }
+}
+
+const afsCpuFuncs *get_afs_cpu_funcs() {
+    static const afsCpuFuncs FUNC_SSE2 = {
+        afs_analyze_row8_c,
+        afs_gen_merge_row_c,
+        afs_combine_row_c,
+        afs_merge_scan_row_c,
+        afs_filter_h1_row_c,
+        afs_filter_v1_row_c,
+        afs_filter_h2_row_c,
+        afs_filter_v2_row_c,
+        afs_count_motion_sse2,
+        afs_count_stripe_sse2
+    };
+    static const afsCpuFuncs FUNC_AVX2 = {
+        afs_analyze_row8_avx2,
+        afs_gen_merge_row_avx2,
+        afs_combine_row_avx2,
+        afs_merge_scan_row_avx2,
+        afs_filter_h1_row_avx2,
+        afs_filter_v1_row_avx2,
+        afs_filter_h2_row_avx2,
+        afs_filter_v2_row_avx2,
+        afs_count_motion_avx2,
+        afs_count_stripe_avx2
+    };
+    return (get_availableSIMD() & AVX2) ? &FUNC_AVX2 : &FUNC_SSE2;
+}
+
+void afs_get_motion_count(int motion_count[2], const uint8_t *ptr, const AFS_SCAN_CLIP *clip, int pitch, int scan_w, int scan_h, int tb_order) {
+    const int y_fin = scan_h - clip->bottom - ((scan_h - clip->top - clip->bottom) & 1);
+    get_afs_cpu_funcs()->count_motion(motion_count, ptr, pitch, clip->left, scan_w - clip->right, clip->top, y_fin, tb_order);
+}
+
+void afs_get_stripe_count(int stripe_count[2], const uint8_t *ptr, const AFS_SCAN_CLIP *clip, int pitch, int scan_w, int scan_h, int tb_order) {
+    const int y_fin = scan_h - clip->bottom - ((scan_h - clip->top - clip->bottom) & 1);
+    get_afs_cpu_funcs()->count_stripe(stripe_count, ptr, pitch, clip->left, scan_w - clip->right, clip->top, y_fin, tb_order);
+}
+
+//--- バッファ ---------------------------------------------------------------------------
+int afsCpuFrame::alloc(const FrameInfo& frameInfo) {
+    frame = frameInfo;
+    frame.deivce_mem = false;
+    frame.pitch = ALIGN(getFrameInfoExtra(&frame).width_byte, 64);
+    //yuv420の色差もY面と同じpitchで確保する
+    const int frame_size = frame.pitch * frame.height * ((RGY_CSP_CHROMA_FORMAT[frame.csp] == RGY_CHROMAFMT_YUV420) ? 2 : 3);
+    buf.reset((uint8_t *)_aligned_malloc(frame_size, 64));
+    frame.ptr = buf.get();
+    return (buf) ? 0 : 1;
+}
+
+int afsCpuMap::alloc(int width, int height) {
+    pitch = ALIGN(width, 64);
+    buf.reset((uint8_t *)_aligned_malloc(pitch * height, 64));
+    if (!buf) {
+        return 1;
+    }
+    memset(buf.get(), 0, pitch * height);
+    return 0;
+}
+
+//--- 各プレーンへのアクセス -------------------------------------------------------------
+struct afsCpuPlane {
+    uint8_t *ptr;
+    int pitch;
+    int width;
+    int height;
+
+    template<typename T>
+    T *row(int y) const {
+        return (T *)(ptr + pitch * clamp(y, 0, height - 1));
+    }
+};
+
+static inline bool afs_cpu_yuv420(RGY_CSP csp) {
+    return RGY_CSP_CHROMA_FORMAT[csp] == RGY_CHROMAFMT_YUV420;
+}
+
+static afsCpuPlane afs_cpu_plane(const FrameInfo *frame, int iplane) {
+    afsCpuPlane plane;
+    const bool yuv420 = afs_cpu_yuv420(frame->csp);
+    plane.pitch  = frame->pitch;
+    plane.width  = (iplane && yuv420) ? frame->width  >> 1 : frame->width;
+    plane.height = (iplane && yuv420) ? frame->height >> 1 : frame->height;
+    plane.ptr = (uint8_t *)frame->ptr;
+    if (iplane == 1) {
+        plane.ptr += frame->pitch * frame->height;
+    } else if (iplane == 2) {
+        plane.ptr += frame->pitch * frame->height * ((yuv420) ? 3 : 4) / 2;
+    }
+    return plane;
+}
+
+static void afs_cpu_copy_frame(const FrameInfo *dst, const FrameInfo *src) {
+    const int pixel_size = (RGY_CSP_BIT_DEPTH[src->csp] > 8) ? 2 : 1;
+    for (int j = 0; j < 3; j++) {
+        const auto planeDst = afs_cpu_plane(dst, j);
+        const auto planeSrc = afs_cpu_plane(src, j);
+        for (int y = 0; y < planeSrc.height; y++) {
+            memcpy(planeDst.ptr + planeDst.pitch * y, planeSrc.ptr + planeSrc.pitch * y, planeSrc.width * pixel_size);
+        }
+    }
+}
+
+//yuv420の色差を、GPU版のテクスチャ参照と同様に輝度の位置に補間して正規化値で取得する
+template<typename T>
+static void afs_get_uv_row(float *dst, const afsCpuPlane& plane, int iy, int width) {
+    static const float WEIGHT[4] = { 0.875f, 0.625f, 0.375f, 0.125f };
+    const float norm = 1.0f / (float)((1 << (sizeof(T) * 8)) - 1);
+    const int field = iy & 1;
+    const int field_h = std::max(plane.height >> 1, 1);
+    const int k = (iy - 2) >> 2;
+    const float a = WEIGHT[iy & 3];
+    const T *row0 = plane.row<T>(2 * clamp(k,     0, field_h - 1) + field);
+    const T *row1 = plane.row<T>(2 * clamp(k + 1, 0, field_h - 1) + field);
+    const int cw = plane.width;
+    for (int x = 0; x < width; x++) {
+        const int cx0 = std::min(x >> 1, cw - 1);
+        float v = (1.0f - a) * row0[cx0] + a * row1[cx0];
+        if (x & 1) {
+            const int cx1 = std::min(cx0 + 1, cw - 1);
+            v = 0.5f * (v + ((1.0f - a) * row0[cx1] + a * row1[cx1]));
+        }
+        dst[x] = v * norm;
+    }
+}
+
+//--- CPU版afs ---------------------------------------------------------------------------
+NVEncFilterAfsCpu::NVEncFilterAfsCpu() :
+    m_afs(),
+    m_frameInfo(),
+    m_inFps(),
+    m_outTimebase(),
+    m_func(nullptr),
+    m_pool(),
+    m_bands(1),
+    m_nFramesInput(0),
+    m_nFrame(0),
+    m_nPts(0),
+    m_source(),
+    m_scan(),
+    m_stripe(),
+    m_stripeFiltered(),
+    m_filterTmp(),
+    m_status(),
+    m_streamsts(),
+    m_pPrintMes() {
+}
+
+NVEncFilterAfsCpu::~NVEncFilterAfsCpu() {
+    close();
+}
+
+void NVEncFilterAfsCpu::AddMessage(int log_level, const TCHAR *format, ...) {
+    if (m_pPrintMes == nullptr || log_level < m_pPrintMes->getLogLevel()) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int len = _vsctprintf(format, args) + 1; // _vscprintf doesn't count terminating '\0'
+    tstring buffer;
+    buffer.resize(len, _T('\0'));
+    _vstprintf_s(&buffer[0], len, format, args);
+    va_end(args);
+
+    auto lines = split(buffer, _T("\n"));
+    for (const auto& line : lines) {
+        if (line[0] != _T('\0')) {
+            m_pPrintMes->write(log_level, (tstring(_T("afs(cpu): ")) + line + _T("\n")).c_str());
+        }
+    }
+}
+
+void NVEncFilterAfsCpu::band_range(int band, int bands, int height, int *y_start, int *y_end) const {
+    //合成時に2行単位(yuv420の色差は4行単位)で処理するため、4行単位で分割する
+    const int h4 = (height + 3) >> 2;
+    *y_start = std::min(height, ((h4 * band)       / bands) << 2);
+    *y_end   = std::min(height, ((h4 * (band + 1)) / bands) << 2);
+}
+
+NVENCSTATUS NVEncFilterAfsCpu::init(const VppAfs& afs, const FrameInfo& frameInfo, rgy_rational<int> inFps, rgy_rational<int> outTimebase, int threads, shared_ptr<RGYLog> pPrintMes) {
+    close();
+    m_pPrintMes = pPrintMes;
+    static const auto supportedCsp = make_array<RGY_CSP>(
+        RGY_CSP_YV12, RGY_CSP_YV12_09, RGY_CSP_YV12_10, RGY_CSP_YV12_12, RGY_CSP_YV12_14, RGY_CSP_YV12_16,
+        RGY_CSP_YUV444, RGY_CSP_YUV444_09, RGY_CSP_YUV444_10, RGY_CSP_YUV444_12, RGY_CSP_YUV444_14, RGY_CSP_YUV444_16);
+    if (std::find(supportedCsp.begin(), supportedCsp.end(), frameInfo.csp) == supportedCsp.end()) {
+        AddMessage(RGY_LOG_ERROR, _T("unsupported csp: %s.\n"), RGY_CSP_NAMES[frameInfo.csp]);
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+    }
+    if (frameInfo.width <= 0 || frameInfo.height <= 0
+        || afs.clip.top < 0 || afs.clip.bottom < 0 || afs.clip.top + afs.clip.bottom >= frameInfo.height
+        || afs.clip.left < 0 || afs.clip.right < 0 || afs.clip.left + afs.clip.right >= frameInfo.width
+        || afs.analyze < 0 || afs.analyze > 5) {
+        AddMessage(RGY_LOG_ERROR, _T("Invalid parameter.\n"));
+        return NV_ENC_ERR_INVALID_PARAM;
+    }
+    m_afs = afs;
+    if (!m_afs.shift) {
+        m_afs.drop = false;
+        m_afs.smooth = false;
+    }
+    m_frameInfo = frameInfo;
+    m_inFps = inFps;
+    m_outTimebase = outTimebase;
+    m_func = get_afs_cpu_funcs();
+
+    for (int i = 0; i < _countof(m_source); i++) {
+        if (m_source[i].alloc(frameInfo)) {
+            AddMessage(RGY_LOG_ERROR, _T("failed to allocate memory.\n"));
+            return NV_ENC_ERR_OUT_OF_MEMORY;
+        }
+    }
+    for (int i = 0; i < _countof(m_scan); i++) {
+        if (m_scan[i].map.alloc(frameInfo.width, frameInfo.height)) {
+            AddMessage(RGY_LOG_ERROR, _T("failed to allocate memory.\n"));
+            return NV_ENC_ERR_OUT_OF_MEMORY;
+        }
+        m_scan[i].status = 0;
+    }
+    for (int i = 0; i < _countof(m_stripe); i++) {
+        if (m_stripe[i].map.alloc(frameInfo.width, frameInfo.height)) {
+            AddMessage(RGY_LOG_ERROR, _T("failed to allocate memory.\n"));
+            return NV_ENC_ERR_OUT_OF_MEMORY;
+        }
+        m_stripe[i].status = 0;
+    }
+    if (m_stripeFiltered.map.alloc(frameInfo.width, frameInfo.height)
+        || m_filterTmp[0].alloc(frameInfo.width, frameInfo.height)
+        || m_filterTmp[1].alloc(frameInfo.width, frameInfo.height)) {
+        AddMessage(RGY_LOG_ERROR, _T("failed to allocate memory.\n"));
+        return NV_ENC_ERR_OUT_OF_MEMORY;
+    }
+
+    if (threads <= 0) {
+        threads = (int)std::thread::hardware_concurrency();
+    }
+    //1バンドあたり最低でも32行程度は確保する
+    threads = clamp(threads, 1, std::max(1, frameInfo.height / 32));
+    m_pool.init(threads);
+    m_bands = m_pool.threads();
+    m_nFramesInput = 0;
+    m_nFrame = 0;
+    m_nPts = 0;
+    AddMessage(RGY_LOG_DEBUG, _T("initialized: %dx%d, %s, %d threads, %s.\n"),
+        frameInfo.width, frameInfo.height, RGY_CSP_NAMES[frameInfo.csp], m_bands, (m_func->analyze_row8 == afs_analyze_row8_c) ? _T("sse2") : _T("avx2"));
+    return NV_ENC_SUCCESS;
+}
+
+void NVEncFilterAfsCpu::motion_count(int iframe, int *ff_motion, int *lf_motion) {
+    const auto sp = scan(iframe);
+    *ff_motion = sp->ff_motion;
+    *lf_motion = sp->lf_motion;
+}
+
+void NVEncFilterAfsCpu::add_source(const FrameInfo *pInputFrame) {
+    auto dst = &m_source[m_nFramesInput & (AFS_SOURCE_CACHE_NUM-1)];
+    afs_cpu_copy_frame(&dst->frame, pInputFrame);
+    dst->frame.timestamp = pInputFrame->timestamp;
+    dst->frame.duration = pInputFrame->duration;
+    dst->frame.picstruct = pInputFrame->picstruct;
+    dst->frame.flags = pInputFrame->flags;
+    m_nFramesInput++;
+}
+
+void NVEncFilterAfsCpu::expire_stripe(int iframe) {
+    auto stp = stripe(iframe);
+    if (stp->frame == iframe && stp->status > 0) {
+        stp->status = 0;
+    }
+}
+
+bool NVEncFilterAfsCpu::scan_frame_result_cached(int iframe) {
+    auto sp = scan(iframe);
+    const int mode = m_afs.analyze == 0 ? 0 : 1;
+    return sp->status > 0 && sp->frame == iframe && sp->tb_order == m_afs.tb_order && sp->thre_shift == m_afs.thre_shift &&
+        ((mode == 0) ||
+        (mode == 1 && sp->mode == 1 && sp->thre_deint == m_afs.thre_deint && sp->thre_Ymotion == m_afs.thre_Ymotion && sp->thre_Cmotion == m_afs.thre_Cmotion));
+}
+
+void NVEncFilterAfsCpu::scan_frame(int iframe, int force) {
+    if (!force && scan_frame_result_cached(iframe)) {
+        return;
+    }
+    auto p1 = source(iframe-1);
+    auto p0 = source(iframe);
+    auto sp = scan(iframe);
+
+    const int mode = m_afs.analyze == 0 ? 0 : 1;
+    expire_stripe(iframe - 1);
+    expire_stripe(iframe);
+    sp->status = 1;
+    sp->frame = iframe, sp->mode = mode, sp->tb_order = m_afs.tb_order;
+    sp->thre_shift = m_afs.thre_shift, sp->thre_deint = m_afs.thre_deint;
+    sp->thre_Ymotion = m_afs.thre_Ymotion, sp->thre_Cmotion = m_afs.thre_Cmotion;
+    sp->clip = m_afs.clip;
+    analyze_stripe(sp, &p0->frame, &p1->frame);
+}
+
+template<typename T>
+struct afsCpuAnalyzeThreshold {
+    int shift, deint, Ymotion, Cmotion;
+    float shiftf, deintf, Cmotionf;
+
+    afsCpuAnalyzeThreshold(const VppAfs& afs, int bit_depth) {
+        //YC48 -> yuv420/yuv444(bit_depth)へのスケーリング
+        const int thre_rsft = 12 - (bit_depth - 8);
+        const int thre_max = (1 << (sizeof(T) * 8 - 1)) - 1;
+        shift   = clamp((afs.thre_shift   * 219 +  383) >> thre_rsft, 0, thre_max);
+        deint   = clamp((afs.thre_deint   * 219 +  383) >> thre_rsft, 0, thre_max);
+        Ymotion = clamp((afs.thre_Ymotion * 219 +  383) >> thre_rsft, 0, thre_max);
+        Cmotion = clamp((afs.thre_Cmotion * 224 + 2112) >> thre_rsft, 0, thre_max);
+        //yuv420の色差は正規化値で比較する
+        const float thre_mul = (224.0f / (float)(4096 >> (bit_depth - 8))) * (1.0f / (1 << (sizeof(T) * 8)));
+        shiftf   = std::max(0.0f, afs.thre_shift   * thre_mul);
+        deintf   = std::max(0.0f, afs.thre_deint   * thre_mul);
+        Cmotionf = std::max(0.0f, afs.thre_Cmotion * thre_mul);
+    }
+};
+
+template<typename T>
+static void afs_analyze_band(const afsCpuFuncs *func, afsCpuMap *map, int count[2], const FrameInfo *p0, const FrameInfo *p1,
+    const afsCpuAnalyzeThreshold<T>& thre, int tb_order, const AFS_SCAN_CLIP *clip, int y0, int y1) {
+    static const int RING = 8;
+    const int width = p0->width;
+    const int height = p0->height;
+    const bool yuv420 = afs_cpu_yuv420(p0->csp);
+    const int width_a = ALIGN(width, 64);
+    std::vector<uint8_t> work(width_a * (3 * RING + 2 * RING));
+    uint8_t *flags[3][RING];
+    uint8_t *mask0[RING], *mask_or[RING];
+    for (int i = 0; i < RING; i++) {
+        for (int j = 0; j < 3; j++) {
+            flags[j][i] = work.data() + width_a * (j * RING + i);
+        }
+        mask0[i]   = work.data() + width_a * (3 * RING + i);
+        mask_or[i] = work.data() + width_a * (4 * RING + i);
+    }
+    std::vector<float> workf((yuv420) ? width * 4 : 0);
+
+    afsCpuPlane plane0[3], plane1[3];
+    for (int j = 0; j < 3; j++) {
+        plane0[j] = afs_cpu_plane(p0, j);
+        plane1[j] = afs_cpu_plane(p1, j);
+    }
+    //運動量のカウント範囲 (偶数行に揃える)
+    const int count_y_fin = height - clip->bottom - ((height - clip->top - clip->bottom) & 1);
+    const int count_y0 = std::max(y0, clip->top);
+    const int count_y1 = std::min(y1, count_y_fin);
+
+    for (int y = y0 - 3; y < y1 + 4; y++) {
+        const int r = y & (RING-1);
+        const int has_prev = y >= 1;
+        const int shift_first_p0m = (tb_order) ? (y & 1) : !(y & 1);
+        for (int j = 0; j < 3; j++) {
+            if (j > 0 && yuv420) {
+                float *p0c = workf.data(), *p0m = p0c + width, *p1c = p0m + width, *p1m = p1c + width;
+                afs_get_uv_row<T>(p0c, plane0[j], y, width);
+                afs_get_uv_row<T>(p1c, plane1[j], y, width);
+                if (has_prev) {
+                    afs_get_uv_row<T>(p0m, plane0[j], y - 1, width);
+                    afs_get_uv_row<T>(p1m, plane1[j], y - 1, width);
+                }
+                afs_analyze_row_float(flags[j][r], p0c, p0m, p1c, p1m, width, has_prev, shift_first_p0m, thre.Cmotionf, thre.deintf, thre.shiftf);
+            } else {
+                const int thre_motion = (j == 0) ? thre.Ymotion : thre.Cmotion;
+                const T *p0c = plane0[j].template row<T>(y), *p0m = plane0[j].template row<T>(y - 1);
+                const T *p1c = plane1[j].template row<T>(y), *p1m = plane1[j].template row<T>(y - 1);
+                if (sizeof(T) == 1) {
+                    func->analyze_row8(flags[j][r], (const uint8_t *)p0c, (const uint8_t *)p0m, (const uint8_t *)p1c, (const uint8_t *)p1m,
+                        width, has_prev, shift_first_p0m, thre_motion, thre.deint, thre.shift);
+                } else {
+                    afs_analyze_row_c<T>(flags[j][r], p0c, p0m, p1c, p1m, width, has_prev, shift_first_p0m, thre_motion, thre.deint, thre.shift);
+                }
+            }
+        }
+        if (y >= y0) {
+            const uint8_t *const f[3][4] = {
+                { flags[0][(y-3) & (RING-1)], flags[0][(y-2) & (RING-1)], flags[0][(y-1) & (RING-1)], flags[0][r] },
+                { flags[1][(y-3) & (RING-1)], flags[1][(y-2) & (RING-1)], flags[1][(y-1) & (RING-1)], flags[1][r] },
+                { flags[2][(y-3) & (RING-1)], flags[2][(y-2) & (RING-1)], flags[2][(y-1) & (RING-1)], flags[2][r] }
+            };
+            func->gen_merge_row(mask0[r], mask_or[r], f, width);
+        }
+        if (y >= y0 + 4) {
+            const int yo = y - 4;
+            func->combine_row(map->ptr(yo), mask_or[r],
+                mask0[(yo+3) & (RING-1)], mask0[(yo+2) & (RING-1)], mask0[(yo+1) & (RING-1)], mask0[yo & (RING-1)], width);
+        }
+    }
+    if (count_y0 < count_y1) {
+        func->count_motion(count, map->ptr(0), map->pitch, clip->left, width - clip->right, count_y0, count_y1, tb_order);
+    }
+}
+
+void NVEncFilterAfsCpu::analyze_stripe(afsCpuScanData *sp, const FrameInfo *p0, const FrameInfo *p1) {
+    const int bit_depth = RGY_CSP_BIT_DEPTH[m_frameInfo.csp];
+    const int height = m_frameInfo.height;
+    std::vector<std::array<int, 2>> count(m_bands, { 0, 0 });
+    if (bit_depth > 8) {
+        const afsCpuAnalyzeThreshold<uint16_t> thre(m_afs, bit_depth);
+        m_pool.run(m_bands, [&](int band) {
+            int y0 = 0, y1 = 0;
+            band_range(band, m_bands, height, &y0, &y1);
+            afs_analyze_band<uint16_t>(m_func, &sp->map, count[band].data(), p0, p1, thre, sp->tb_order, &sp->clip, y0, y1);
+        });
+    } else {
+        const afsCpuAnalyzeThreshold<uint8_t> thre(m_afs, bit_depth);
+        m_pool.run(m_bands, [&](int band) {
+            int y0 = 0, y1 = 0;
+            band_range(band, m_bands, height, &y0, &y1);
+            afs_analyze_band<uint8_t>(m_func, &sp->map, count[band].data(), p0, p1, thre, sp->tb_order, &sp->clip, y0, y1);
+        });
+    }
+    sp->ff_motion = 0;
+    sp->lf_motion = 0;
+    for (const auto& c : count) {
+        sp->ff_motion += c[0];
+        sp->lf_motion += c[1];
+    }
+#if AFS_CPU_CHECK
+    int motion_count[2] = { 0, 0 };
+    afs_get_motion_count(motion_count, sp->map.ptr(0), &sp->clip, sp->map.pitch, m_frameInfo.width, height, sp->tb_order);
+    AddMessage((sp->ff_motion == motion_count[0] && sp->lf_motion == motion_count[1]) ? RGY_LOG_INFO : RGY_LOG_ERROR,
+        _T("count_motion(ret, debug) = (%6d, %6d) / (%6d, %6d)\n"), sp->ff_motion, motion_count[0], sp->lf_motion, motion_count[1]);
+#endif
+}
+
+void NVEncFilterAfsCpu::merge_scan(afsCpuStripeData *sp, const afsCpuScanData *sp0, const afsCpuScanData *sp1) {
+    const int width = m_frameInfo.width;
+    const int height = m_frameInfo.height;
+    const AFS_SCAN_CLIP *clip = &m_afs.clip;
+    const int count_y_fin = height - clip->bottom - ((height - clip->top - clip->bottom) & 1);
+    std::vector<std::array<int, 2>> count(m_bands, { 0, 0 });
+    m_pool.run(m_bands, [&](int band) {
+        int y0 = 0, y1 = 0;
+        band_range(band, m_bands, height, &y0, &y1);
+        for (int y = y0; y < y1; y++) {
+            const int ym = std::max(y - 1, 0);
+            const int yp = std::min(y + 1, height - 1);
+            m_func->merge_scan_row(sp->map.ptr(y),
+                sp0->map.ptr(ym), sp0->map.ptr(y), sp0->map.ptr(yp),
+                sp1->map.ptr(ym), sp1->map.ptr(y), sp1->map.ptr(yp), width);
+        }
+        const int count_y0 = std::max(y0, clip->top);
+        const int count_y1 = std::min(y1, count_y_fin);
+        if (count_y0 < count_y1) {
+            m_func->count_stripe(count[band].data(), sp->map.ptr(0), sp->map.pitch, clip->left, width - clip->right, count_y0, count_y1, m_afs.tb_order);
+        }
+    });
+    sp->count0 = 0;
+    sp->count1 = 0;
+    for (const auto& c : count) {
+        sp->count0 += c[0];
+        sp->count1 += c[1];
+    }
+}
+
+void NVEncFilterAfsCpu::get_stripe_info(int iframe, int mode) {
+    afsCpuStripeData *sp = stripe(iframe);
+    if (sp->status > mode && sp->status < 4 && sp->frame == iframe) {
+        return;
+    }
+    merge_scan(sp, scan(iframe), scan(iframe + 1));
+    sp->status = 3;
+    sp->frame = iframe;
+}
+
+afsCpuStripeData *NVEncFilterAfsCpu::filter_stripe(int iframe) {
+    auto sip = stripe(iframe);
+    if (m_afs.analyze <= 1) {
+        return sip;
+    }
+    auto dst = &m_stripeFiltered;
+    dst->count0 = sip->count0;
+    dst->count1 = sip->count1;
+    dst->frame  = sip->frame;
+    dst->status = 1;
+
+    const int width = m_frameInfo.width;
+    const int height = m_frameInfo.height;
+    //垂直方向のフィルタは前後の行を参照するので、段ごとに全バンドの終了を待つ
+    auto filter_h = [&](afsCpuMap *pDst, const afsCpuMap *pSrc, funcAfsFilterHRow func) {
+        m_pool.run(m_bands, [&](int band) {
+            int y0 = 0, y1 = 0;
+            band_range(band, m_bands, height, &y0, &y1);
+            for (int y = y0; y < y1; y++) {
+                func(pDst->ptr(y), pSrc->ptr(y), width);
+            }
+        });
+    };
+    auto filter_v = [&](afsCpuMap *pDst, const afsCpuMap *pSrc, funcAfsFilterVRow func) {
+        m_pool.run(m_bands, [&](int band) {
+            int y0 = 0, y1 = 0;
+            band_range(band, m_bands, height, &y0, &y1);
+            for (int y = y0; y < y1; y++) {
+                func(pDst->ptr(y), pSrc->ptr(std::max(y - 1, 0)), pSrc->ptr(y), pSrc->ptr(std::min(y + 1, height - 1)), width);
+            }
+        });
+    };
+    filter_h(&m_filterTmp[0], &sip->map,      m_func->filter_h1_row);
+    filter_v(&m_filterTmp[1], &m_filterTmp[0], m_func->filter_v1_row);
+    filter_h(&m_filterTmp[0], &m_filterTmp[1], m_func->filter_h2_row);
+    filter_v(&dst->map,       &m_filterTmp[0], m_func->filter_v2_row);
+    return dst;
+}
+
+int NVEncFilterAfsCpu::detect_telecine_cross(int iframe) {
+    using std::max;
+    const int coeff_shift = m_afs.coeff_shift;
+    const afsCpuScanData *sp1 = scan(iframe - 1);
+    const afsCpuScanData *sp2 = scan(iframe + 0);
+    const afsCpuScanData *sp3 = scan(iframe + 1);
+    const afsCpuScanData *sp4 = scan(iframe + 2);
+    auto absdiff = [](int a, int b) { return std::abs(a - b); };
+    auto max3 = [](int a, int b, int c) { return max(max(a, b), c); };
+    int shift = 0;
+
+    if (max(absdiff(sp1->lf_motion + sp2->lf_motion, sp2->ff_motion),
+        absdiff(sp3->ff_motion + sp4->ff_motion, sp3->lf_motion)) * coeff_shift >
+        max3(absdiff(sp1->ff_motion + sp2->ff_motion, sp1->lf_motion),
+            absdiff(sp2->ff_motion + sp3->ff_motion, sp2->lf_motion),
+            absdiff(sp3->lf_motion + sp4->lf_motion, sp4->ff_motion)) * 256)
+        if (max(sp2->lf_motion, sp3->ff_motion) * coeff_shift > sp2->ff_motion * 256)
+            shift = 1;
+
+    if (max(absdiff(sp1->lf_motion + sp2->lf_motion, sp2->ff_motion),
+        absdiff(sp3->ff_motion + sp4->ff_motion, sp3->lf_motion)) * coeff_shift >
+        max3(absdiff(sp1->ff_motion + sp2->ff_motion, sp1->lf_motion),
+            absdiff(sp2->lf_motion + sp3->lf_motion, sp3->ff_motion),
+            absdiff(sp3->lf_motion + sp4->lf_motion, sp4->ff_motion)) * 256)
+        if (max(sp2->lf_motion, sp3->ff_motion) * coeff_shift > sp3->lf_motion * 256)
+            shift = 1;
+
+    return shift;
+}
+
+void NVEncFilterAfsCpu::analyze_frame(int iframe, int reverse[4], int assume_shift[4], int result_stat[4]) {
+    for (int i = 0; i < 4; i++) {
+        assume_shift[i] = detect_telecine_cross(iframe + i);
+    }
+
+    const afsCpuScanData *scp = scan(iframe);
+    const int scan_w = m_frameInfo.width;
+    const int scan_h = m_frameInfo.height;
+    int total = 0;
+    if (scan_h - scp->clip.bottom - ((scan_h - scp->clip.top - scp->clip.bottom) & 1) > scp->clip.top && scan_w - scp->clip.right > scp->clip.left)
+        total = (scan_h - scp->clip.bottom - ((scan_h - scp->clip.top - scp->clip.bottom) & 1) - scp->clip.top) * (scan_w - scp->clip.right - scp->clip.left);
+    const int threshold = (total * m_afs.method_switch) >> 12;
+
+    for (int i = 0; i < 4; i++) {
+        get_stripe_info(iframe + i, 0);
+        const afsCpuStripeData *stp = stripe(iframe + i);
+        result_stat[i] = (stp->count0 * m_afs.coeff_shift > stp->count1 * 256) ? 1 : 0;
+        if (threshold > stp->count1 && threshold > stp->count0)
+            result_stat[i] += 2;
+    }
+
+    static const uint8_t FLAG_SHIFT[4] = { AFS_FLAG_SHIFT0, AFS_FLAG_SHIFT1, AFS_FLAG_SHIFT2, AFS_FLAG_SHIFT3 };
+    uint8_t status = AFS_STATUS_DEFAULT;
+    for (int i = 0; i < 4; i++) {
+        if (result_stat[i] & 2)
+            status |= assume_shift[i] ? FLAG_SHIFT[i] : 0;
+        else
+            status |= (result_stat[i] & 1) ? FLAG_SHIFT[i] : 0;
+        if (reverse[i]) status ^= FLAG_SHIFT[i];
+    }
+
+    const auto& frameinfo = source(iframe)->frame;
+    if (!interlaced(frameinfo)) {
+        status |= AFS_FLAG_PROGRESSIVE;
+        if (frameinfo.flags & RGY_FRAME_FLAG_RFF) status |= AFS_FLAG_RFF;
+    }
+    if (m_afs.drop) {
+        if (interlaced(frameinfo)) status |= AFS_FLAG_FRAME_DROP;
+        if (m_afs.smooth) status |= AFS_FLAG_SMOOTHING;
+    }
+    if (m_afs.force24) status |= AFS_FLAG_FORCE24;
+    if (iframe < 1) status &= AFS_MASK_SHIFT0;
+
+    m_status[iframe] = status;
+}
+
+//--- 合成 -------------------------------------------------------------------------------
+static inline int afs_pix_blend(int s1, int s2, int s3, uint8_t flag, uint8_t mask) {
+    return ((flag & mask) == 0) ? (s1 + s3 + s2 * 2 + 2) >> 2 : s2;
+}
+
+static inline int afs_pix_mie_inter(int a, int b, int c, int d) {
+    return (a + b + c + d + 2) >> 2;
+}
+
+static inline int afs_pix_mie_spot(int a, int b, int c, int d, int s) {
+    return (afs_pix_mie_inter(a, b, c, d) + s + 1) >> 1;
+}
+
+static inline int afs_pix_deint(int s1, int s3, int s4, int s5, int s7, uint8_t flag, uint8_t mask, int max_val) {
+    const int tmp2 = s1 + s7;
+    const int tmp3 = s3 + s5;
+    const int tmp = clamp((tmp3 + ((tmp3 - tmp2) >> 3) + 1) >> 1, 0, max_val);
+    return ((flag & mask) == 0) ? tmp : s4;
+}
+
+//y行目の合成に使用する行 (1始まりで lines[1] - lines[7]) を求める
+template<int mode>
+static void afs_synthesize_lines(int lines[8], int y, int height) {
+    const int yc = y & ~1;
+    int h[8];
+    if (mode == 4) {
+        h[3] = yc;
+        h[2] = h[3] + ((yc - 1 >= 0) ? -1 : 1);
+        h[1] = h[2] + ((yc - 2 >= 0) ? -1 : 1);
+        h[0] = h[1] + ((yc - 3 >= 0) ? -1 : 1);
+        h[4] = h[3] + ((yc < height - 1) ? 1 : -1);
+        h[5] = h[4] + ((yc < height - 2) ? 1 : -1);
+        h[6] = h[5] + ((yc < height - 3) ? 1 : -1);
+        h[7] = h[6] + ((yc < height - 4) ? 1 : -1);
+    } else {
+        h[1] = yc;
+        h[0] = (yc - 1 >= 0) ? yc - 1 : yc + 1;
+        h[2] = (yc < height - 1) ? yc + 1 : yc - 1;
+        h[3] = (yc < height - 2) ? h[2] + 1 : h[2] - 1;
+        h[4] = h[5] = h[6] = h[7] = h[3];
+    }
+    //偶数行はh1-h7、奇数行はh2-h8を使う
+    for (int i = 1; i < 8; i++) {
+        lines[i] = clamp(h[std::min(i - 1 + (y & 1), 7)], 0, height - 1);
+    }
+}
+
+template<typename T, int mode>
+static void afs_synthesize_plane(const afsCpuPlane& dst, const afsCpuPlane& src0, const afsCpuPlane& src1,
+    const afsCpuMap *sip, bool chroma420, int tb_order, uint8_t status, int y0, int y1, int max_val) {
+    const int width = dst.width;
+    const int height = dst.height;
+    const int sip_height = (chroma420) ? height * 2 : height;
+    const bool shift0 = (status & AFS_FLAG_SHIFT0) != 0;
+    for (int y = y0; y < y1; y++) {
+        T *ptr_dst = dst.row<T>(y);
+        const int latter = (y + tb_order + 1) & 1;
+        if (mode == 0) {
+            const afsCpuPlane& src = (latter && shift0) ? src1 : src0;
+            memcpy(ptr_dst, src.row<T>(y), width * sizeof(T));
+            continue;
+        }
+        int lines[8];
+        afs_synthesize_lines<mode>(lines, y, height);
+        const T *p0[8], *p1[8];
+        for (int i = 1; i < 8; i++) {
+            p0[i] = src0.row<T>(lines[i]);
+            p1[i] = src1.row<T>(lines[i]);
+        }
+        //yuv420の色差では、対応する輝度位置の判定結果を使う
+        const uint8_t *ptr_sip = sip->ptr(clamp((chroma420) ? (y * 2 - (y & 1)) : y, 0, sip_height - 1));
+        for (int x = 0; x < width; x++) {
+            const uint8_t flag = ptr_sip[(chroma420) ? x * 2 : x];
+            int ret = 0;
+            if (mode == 1) {
+                if (shift0) {
+                    ret = (!latter) ? afs_pix_mie_inter(p0[2][x], p1[1][x], p1[2][x], p1[3][x])
+                                    : afs_pix_mie_spot(p0[1][x], p0[3][x], p1[1][x], p1[3][x], p1[2][x]);
+                } else {
+                    ret = (latter) ? afs_pix_mie_inter(p0[1][x], p0[2][x], p0[3][x], p1[2][x])
+                                   : afs_pix_mie_spot(p0[1][x], p0[3][x], p1[1][x], p1[3][x], p0[2][x]);
+                }
+            } else if (mode == 2 || mode == 3) {
+                const uint8_t mask = (shift0) ? ((mode == 2) ? 0x02 : 0x06) : ((mode == 2) ? 0x01 : 0x05);
+                if (shift0) {
+                    ret = (!latter) ? afs_pix_blend(p1[1][x], p0[2][x], p1[3][x], flag, mask)
+                                    : afs_pix_blend(p0[1][x], p1[2][x], p0[3][x], flag, mask);
+                } else {
+                    ret = afs_pix_blend(p0[1][x], p0[2][x], p0[3][x], flag, mask);
+                }
+            } else if (mode == 4) {
+                if (shift0) {
+                    ret = (!latter) ? afs_pix_deint(p1[1][x], p1[3][x], p0[4][x], p1[5][x], p1[7][x], flag, 0x06, max_val)
+                                    : p1[4][x];
+                } else {
+                    ret = (latter) ? afs_pix_deint(p0[1][x], p0[3][x], p0[4][x], p0[5][x], p0[7][x], flag, 0x05, max_val)
+                                   : p0[4][x];
+                }
+            }
+            ptr_dst[x] = (T)ret;
+        }
+    }
+}
+
+//tune: 判定結果を色分けして表示する
+template<typename T>
+static void afs_synthesize_tune(const afsCpuPlane dst[3], const afsCpuMap *sip, bool yuv420, uint8_t status, int bit_depth, int y0, int y1) {
+    static const uint8_t YUY2_COLOR[4][3] = {
+        {  16, 128, 128 }, //black
+        {  98, 128, 128 }, //gray
+        {  41, 240, 110 }, //blue
+        { 169, 166,  16 }, //light blue
+    };
+    const bool shift0 = (status & AFS_FLAG_SHIFT0) != 0;
+    const uint8_t mask_lb = (shift0) ? 0x06 : 0x05;
+    const uint8_t mask_gr = (shift0) ? 0x02 : 0x01;
+    auto color_idx = [&](uint8_t flag) {
+        if (!(flag & mask_lb)) return 3;
+        if (~flag & mask_gr) return 1;
+        if (~flag & 0x04) return 2;
+        return 0;
+    };
+    const int width = dst[0].width;
+    const int shift = bit_depth - 8;
+    for (int y = y0; y < y1; y++) {
+        const uint8_t *ptr_sip = sip->ptr(y);
+        T *ptr_y = dst[0].row<T>(y);
+        for (int x = 0; x < width; x++) {
+            ptr_y[x] = (T)(YUY2_COLOR[color_idx(ptr_sip[x])][0] << shift);
+        }
+        if (!yuv420) {
+            for (int j = 1; j < 3; j++) {
+                T *ptr_c = dst[j].row<T>(y);
+                for (int x = 0; x < width; x++) {
+                    ptr_c[x] = (T)(YUY2_COLOR[color_idx(ptr_sip[x])][j] << shift);
+                }
+            }
+        } else if ((y & 1) == 0) {
+            const uint8_t *ptr_sip1 = sip->ptr(std::min(y + 1, dst[0].height - 1));
+            for (int j = 1; j < 3; j++) {
+                T *ptr_c = dst[j].row<T>(y >> 1);
+                for (int x = 0; x < dst[j].width; x++) {
+                    const int x0 = x * 2, x1 = std::min(x * 2 + 1, width - 1);
+                    const int sum = YUY2_COLOR[color_idx(ptr_sip[x0])][j] + YUY2_COLOR[color_idx(ptr_sip[x1])][j]
+                                  + YUY2_COLOR[color_idx(ptr_sip1[x0])][j] + YUY2_COLOR[color_idx(ptr_sip1[x1])][j];
+                    ptr_c[x] = (T)(((sum + 2) >> 2) << shift);
+                }
+            }
+        }
+    }
+}
+
+template<typename T, int mode>
+static void afs_synthesize_band(const FrameInfo *pOut, const FrameInfo *p0, const FrameInfo *p1, const afsCpuMap *sip,
+    int tb_order, uint8_t status, int y0, int y1) {
+    const bool yuv420 = afs_cpu_yuv420(pOut->csp);
+    const int bit_depth = RGY_CSP_BIT_DEPTH[pOut->csp];
+    afsCpuPlane dst[3], src0[3], src1[3];
+    for (int j = 0; j < 3; j++) {
+        dst[j]  = afs_cpu_plane(pOut, j);
+        src0[j] = afs_cpu_plane(p0, j);
+        src1[j] = afs_cpu_plane(p1, j);
+    }
+    if (mode < 0) {
+        afs_synthesize_tune<T>(dst, sip, yuv420, status, bit_depth, y0, y1);
+        return;
+    }
+    const int max_val = (1 << bit_depth) - 1;
+    for (int j = 0; j < 3; j++) {
+        const bool chroma420 = j > 0 && yuv420;
+        afs_synthesize_plane<T, (mode < 0) ? 0 : mode>(dst[j], src0[j], src1[j], sip, chroma420, tb_order, status,
+            (chroma420) ? y0 >> 1 : y0, (chroma420) ? y1 >> 1 : y1, max_val);
+    }
+}
+
+template<typename T>
+static void afs_synthesize_band(int mode, const FrameInfo *pOut, const FrameInfo *p0, const FrameInfo *p1, const afsCpuMap *sip,
+    int tb_order, uint8_t status, int y0, int y1) {
+    switch (mode) {
+    case -1: afs_synthesize_band<T, -1>(pOut, p0, p1, sip, tb_order, status, y0, y1); break;
+    case 0:  afs_synthesize_band<T,  0>(pOut, p0, p1, sip, tb_order, status, y0, y1); break;
+    case 1:  afs_synthesize_band<T,  1>(pOut, p0, p1, sip, tb_order, status, y0, y1); break;
+    case 2:  afs_synthesize_band<T,  2>(pOut, p0, p1, sip, tb_order, status, y0, y1); break;
+    case 3:  afs_synthesize_band<T,  3>(pOut, p0, p1, sip, tb_order, status, y0, y1); break;
+    default: afs_synthesize_band<T,  4>(pOut, p0, p1, sip, tb_order, status, y0, y1); break;
+    }
+}
+
+void NVEncFilterAfsCpu::synthesize(int iframe, FrameInfo *pOut, const FrameInfo *p0, const FrameInfo *p1, const afsCpuStripeData *sip) {
+    const int mode = (m_afs.tune) ? -1 : std::min(m_afs.analyze, 4);
+    const uint8_t status = m_status[iframe];
+    const int height = m_frameInfo.height;
+    const bool highbit = RGY_CSP_BIT_DEPTH[m_frameInfo.csp] > 8;
+    m_pool.run(m_bands, [&](int band) {
+        int y0 = 0, y1 = 0;
+        band_range(band, m_bands, height, &y0, &y1);
+        if (highbit) {
+            afs_synthesize_band<uint16_t>(mode, pOut, p0, p1, &sip->map, m_afs.tb_order, status, y0, y1);
+        } else {
+            afs_synthesize_band<uint8_t>(mode, pOut, p0, p1, &sip->map, m_afs.tb_order, status, y0, y1);
+        }
+    });
+}
+
+NVENCSTATUS NVEncFilterAfsCpu::run(const FrameInfo *pInputFrame, FrameInfo *pOutputFrame, int *pOutputFrameNum) {
+    *pOutputFrameNum = 0;
+    if (m_func == nullptr) {
+        AddMessage(RGY_LOG_ERROR, _T("not initialized.\n"));
+        return NV_ENC_ERR_INVALID_CALL;
+    }
+    const int iframe = m_nFramesInput;
+    if ((pInputFrame == nullptr || pInputFrame->ptr == nullptr) && m_nFrame >= iframe) {
+        //終了
+        return NV_ENC_SUCCESS;
+    } else if (pInputFrame != nullptr && pInputFrame->ptr != nullptr) {
+        if (pInputFrame->csp != m_frameInfo.csp
+            || pInputFrame->width != m_frameInfo.width
+            || pInputFrame->height != m_frameInfo.height) {
+            AddMessage(RGY_LOG_ERROR, _T("frame format does not match.\n"));
+            return NV_ENC_ERR_UNSUPPORTED_PARAM;
+        }
+        add_source(pInputFrame);
+        if (iframe == 0) {
+            // scan_frame(p1 = -2, p0 = -1)のscan_frameも必要
+            scan_frame(iframe-1, false);
+        }
+        scan_frame(iframe, false);
+    }
+
+    if (iframe >= 5) {
+        int reverse[4] = { 0 }, assume_shift[4] = { 0 }, result_stat[4] = { 0 };
+        analyze_frame(iframe - 5, reverse, assume_shift, result_stat);
+    }
+    static const int preread_len = 3;
+    //十分な数のフレームがたまった、あるいはdrainモードならフレームを出力
+    if (iframe >= (5+preread_len) || pInputFrame == nullptr || pInputFrame->ptr == nullptr) {
+        int reverse[4] = { 0 }, assume_shift[4] = { 0 }, result_stat[4] = { 0 };
+        for (int i = preread_len; i >= 0; i--) {
+            analyze_frame(m_nFrame + i, reverse, assume_shift, result_stat);
+        }
+
+        if (m_nFrame == 0) {
+            for (int i = 0; i < preread_len; i++) {
+                if (m_streamsts.set_status(i, m_status[i], i, source(i)->frame.timestamp) != 0) {
+                    AddMessage(RGY_LOG_ERROR, _T("failed to set afs_status(%d).\n"), i);
+                    return NV_ENC_ERR_INVALID_CALL;
+                }
+            }
+        }
+        {
+            auto timestamp = source(m_nFrame+preread_len)->frame.timestamp;
+            //読み込まれた範囲を超える部分のtimestampは外挿する
+            if (m_nFrame+preread_len >= m_nFramesInput) {
+                auto inframe_avg_duration = (source(m_nFramesInput-1)->frame.timestamp + m_nFramesInput / 2) / m_nFramesInput;
+                timestamp += (m_nFrame+preread_len - (m_nFramesInput-1)) * inframe_avg_duration;
+            }
+            if (m_streamsts.set_status(m_nFrame+preread_len, m_status[m_nFrame+preread_len], 0, timestamp) != 0) {
+                AddMessage(RGY_LOG_ERROR, _T("failed to set afs_status(%d).\n"), m_nFrame+preread_len);
+                return NV_ENC_ERR_INVALID_CALL;
+            }
+        }
+        const auto afs_duration = m_streamsts.get_duration(m_nFrame);
+        if (afs_duration == afsStreamStatus::AFS_SSTS_DROP) {
+            //出力フレームなし
+        } else if (afs_duration < 0) {
+            AddMessage(RGY_LOG_ERROR, _T("invalid call for m_streamsts.get_duration(%d).\n"), m_nFrame);
+            return NV_ENC_ERR_INVALID_CALL;
+        } else {
+            *pOutputFrameNum = 1;
+            const auto src = source(m_nFrame);
+            pOutputFrame->flags = src->frame.flags & (~(RGY_FRAME_FLAG_RFF | RGY_FRAME_FLAG_RFF_COPY | RGY_FRAME_FLAG_RFF_BFF | RGY_FRAME_FLAG_RFF_TFF));
+            pOutputFrame->picstruct = RGY_PICSTRUCT_FRAME;
+            pOutputFrame->duration = rational_rescale(afs_duration, m_inFps.inv() * rgy_rational<int>(1,4), m_outTimebase);
+            pOutputFrame->timestamp = m_nPts;
+            m_nPts += pOutputFrame->duration;
+
+            get_stripe_info(m_nFrame, 1);
+            auto sip_filtered = filter_stripe(m_nFrame);
+            if (interlaced(src->frame) || m_afs.tune) {
+                synthesize(m_nFrame, pOutputFrame, &src->frame, &source(m_nFrame-1)->frame, sip_filtered);
+            } else {
+                afs_cpu_copy_frame(pOutputFrame, &src->frame);
+            }
+        }
+        m_nFrame++;
+    }
+    return NV_ENC_SUCCESS;
+}
+
+void NVEncFilterAfsCpu::close() {
+    m_pool.close();
+    for (int i = 0; i < _countof(m_source); i++) {
+        m_source[i].buf.reset();
+    }
+    for (int i = 0; i < _countof(m_scan); i++) {
+        m_scan[i].map.buf.reset();
+        m_scan[i].status = 0;
+    }
+    for (int i = 0; i < _countof(m_stripe); i++) {
+        m_stripe[i].map.buf.reset();
+        m_stripe[i].status = 0;
+    }
+    m_stripeFiltered.map.buf.reset();
+    m_filterTmp[0].buf.reset();
+    m_filterTmp[1].buf.reset();
+    m_status.clear();
+    m_func = nullptr;
+    m_nFramesInput = 0;
+    m_nFrame = 0;
+    m_nPts = 0;
+}
@@ -0,0 +1,183 @@
+﻿// -----------------------------------------------------------------------------------------
+// NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+//
+// The MIT License
+//
+// Copyright (c) 2014-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// ------------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "NVEncFilterAfs.h"
+#include "rgy_thread_pool.h"
+
+//GPU版の解析結果をCPU版で検証する (デバッグ用)
+#define AFS_CPU_CHECK 0
+
+//--- 各処理のCPU版 (行単位) ------------------------------------------------------------
+//  7       6         5        4        3        2        1       0
+// | motion  |         non-shift        | motion  |          shift          |
+// |  shift  |  sign  |  shift |  deint |  flag   | sign  |  shift |  deint |
+//analyze_stripeの1行分の差分情報を作成する (8bit)
+typedef void(*funcAfsAnalyzeRow8)(uint8_t *flags, const uint8_t *p0c, const uint8_t *p0m, const uint8_t *p1c, const uint8_t *p1m,
+    int width, int has_prev, int shift_first_p0m, int thre_motion, int thre_deint, int thre_shift);
+//Y/U/Vの差分情報4行分から判定マスクを作成し、マージする
+typedef void(*funcAfsGenMergeRow)(uint8_t *mask0, uint8_t *mask_or, const uint8_t *const flags[3][4], int width);
+//判定マスク5行分から、scanの最終結果を作成する
+typedef void(*funcAfsCombineRow)(uint8_t *dst, const uint8_t *mask_or4, const uint8_t *mask3, const uint8_t *mask2, const uint8_t *mask1, const uint8_t *mask0, int width);
+//2フレーム分のscan結果をマージする
+typedef void(*funcAfsMergeScanRow)(uint8_t *dst, const uint8_t *p0m, const uint8_t *p0c, const uint8_t *p0p, const uint8_t *p1m, const uint8_t *p1c, const uint8_t *p1p, int width);
+//stripeのフィルタ (水平/垂直)
+typedef void(*funcAfsFilterHRow)(uint8_t *dst, const uint8_t *src, int width);
+typedef void(*funcAfsFilterVRow)(uint8_t *dst, const uint8_t *srcm, const uint8_t *srcc, const uint8_t *srcp, int width);
+//指定範囲の該当画素数をカウントする
+//motion: count[0]=前方フィールド, count[1]=後方フィールド / stripe: count[0]=後方フィールド, count[1]=前方フィールド
+typedef void(*funcAfsCount)(int count[2], const uint8_t *ptr, int pitch, int x_start, int x_end, int y_start, int y_end, int tb_order);
+
+struct afsCpuFuncs {
+    funcAfsAnalyzeRow8  analyze_row8;
+    funcAfsGenMergeRow  gen_merge_row;
+    funcAfsCombineRow   combine_row;
+    funcAfsMergeScanRow merge_scan_row;
+    funcAfsFilterHRow   filter_h1_row;
+    funcAfsFilterVRow   filter_v1_row;
+    funcAfsFilterHRow   filter_h2_row;
+    funcAfsFilterVRow   filter_v2_row;
+    funcAfsCount        count_motion;
+    funcAfsCount        count_stripe;
+};
+
+//使用可能な命令セットに応じた関数を返す
+const afsCpuFuncs *get_afs_cpu_funcs();
+
+//clipを考慮して、scan結果/stripe結果の画素数をカウントする
+void afs_get_motion_count(int motion_count[2], const uint8_t *ptr, const AFS_SCAN_CLIP *clip, int pitch, int scan_w, int scan_h, int tb_order);
+void afs_get_stripe_count(int stripe_count[2], const uint8_t *ptr, const AFS_SCAN_CLIP *clip, int pitch, int scan_w, int scan_h, int tb_order);
+
+//--- CPU版afs ---------------------------------------------------------------------------
+
+struct afsCpuFrame {
+    FrameInfo frame;
+    std::unique_ptr<uint8_t, aligned_malloc_deleter> buf;
+
+    afsCpuFrame() : frame(), buf() {};
+    int alloc(const FrameInfo& frameInfo);
+};
+
+struct afsCpuMap {
+    std::unique_ptr<uint8_t, aligned_malloc_deleter> buf;
+    int pitch;
+
+    afsCpuMap() : buf(), pitch(0) {};
+    int alloc(int width, int height);
+    uint8_t *ptr(int y) { return buf.get() + pitch * y; }
+    const uint8_t *ptr(int y) const { return buf.get() + pitch * y; }
+};
+
+struct afsCpuScanData {
+    afsCpuMap map;
+    int status, frame, mode, tb_order, thre_shift, thre_deint, thre_Ymotion, thre_Cmotion;
+    AFS_SCAN_CLIP clip;
+    int ff_motion, lf_motion;
+};
+
+struct afsCpuStripeData {
+    afsCpuMap map;
+    int status, frame, count0, count1;
+};
+
+//NVEncFilterAfsと同じ処理をCPUで行う
+//入出力はホストメモリ上のYV12/YUV444 (8bit/16bit)
+//yuv420の色差はY面と同じpitchで、Y, U(height/2行), V(height/2行)の順に配置されていること
+class NVEncFilterAfsCpu {
+public:
+    NVEncFilterAfsCpu();
+    ~NVEncFilterAfsCpu();
+    //threads = 0で論理プロセッサ数
+    NVENCSTATUS init(const VppAfs& afs, const FrameInfo& frameInfo, rgy_rational<int> inFps, rgy_rational<int> outTimebase, int threads, shared_ptr<RGYLog> pPrintMes);
+    //pInputFrame = nullptrでバッファに残ったフレームを出力する
+    //pOutputFrameはinitで指定したframeInfoと同じ形式で確保済みのホストメモリであること
+    NVENCSTATUS run(const FrameInfo *pInputFrame, FrameInfo *pOutputFrame, int *pOutputFrameNum);
+    void close();
+    //フレームごとの判定状況をcsvファイルに出力する
+    int open_log(const tstring& log_filename) { return m_streamsts.open_log(log_filename); }
+
+    //各フレームの判定結果 (AFS_FLAG_xxx)
+    uint8_t status(int iframe) { return m_status[iframe]; }
+    //scan結果の動き画素数 (ff, lf)
+    void motion_count(int iframe, int *ff_motion, int *lf_motion);
+protected:
+    void AddMessage(int log_level, const TCHAR *format, ...);
+
+    afsCpuFrame *source(int iframe) {
+        iframe = clamp(iframe, 0, m_nFramesInput-1);
+        return &m_source[iframe & (AFS_SOURCE_CACHE_NUM-1)];
+    }
+    afsCpuScanData *scan(int iframe) {
+        return &m_scan[iframe & (AFS_SCAN_CACHE_NUM-1)];
+    }
+    afsCpuStripeData *stripe(int iframe) {
+        return &m_stripe[iframe & (AFS_STRIPE_CACHE_NUM-1)];
+    }
+    void add_source(const FrameInfo *pInputFrame);
+    void expire_stripe(int iframe);
+
+    bool scan_frame_result_cached(int iframe);
+    void scan_frame(int iframe, int force);
+    void analyze_stripe(afsCpuScanData *sp, const FrameInfo *p0, const FrameInfo *p1);
+    void merge_scan(afsCpuStripeData *sp, const afsCpuScanData *sp0, const afsCpuScanData *sp1);
+    void get_stripe_info(int iframe, int mode);
+    afsCpuStripeData *filter_stripe(int iframe);
+    int detect_telecine_cross(int iframe);
+    void analyze_frame(int iframe, int reverse[4], int assume_shift[4], int result_stat[4]);
+    void synthesize(int iframe, FrameInfo *pOut, const FrameInfo *p0, const FrameInfo *p1, const afsCpuStripeData *sip);
+
+    //行をband数に分割した時のbandの範囲
+    void band_range(int band, int bands, int height, int *y_start, int *y_end) const;
+
+    VppAfs m_afs;
+    FrameInfo m_frameInfo;
+    rgy_rational<int> m_inFps;
+    rgy_rational<int> m_outTimebase;
+    const afsCpuFuncs *m_func;
+    RGYThreadPool m_pool;
+    int m_bands;
+    int m_nFramesInput;
+    int m_nFrame;
+    int64_t m_nPts;
+
+    afsCpuFrame      m_source[AFS_SOURCE_CACHE_NUM];
+    afsCpuScanData   m_scan[AFS_SCAN_CACHE_NUM];
+    afsCpuStripeData m_stripe[AFS_STRIPE_CACHE_NUM];
+    afsCpuStripeData m_stripeFiltered;
+    afsCpuMap        m_filterTmp[2];
+    afsStatus        m_status;
+    afsStreamStatus  m_streamsts;
+    shared_ptr<RGYLog> m_pPrintMes;
+};
@@ -0,0 +1,304 @@
+﻿// -----------------------------------------------------------------------------------------
+// NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+//
+// The MIT License
+//
+// Copyright (c) 2014-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// ------------------------------------------------------------------------------------------
+
+#define USE_SSE2  1
+#define USE_SSSE3 1
+#define USE_SSE41 1
+#define USE_AVX   1
+#define USE_AVX2  1
+
+#include "rgy_simd.h"
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <immintrin.h>
+#include "rgy_util.h"
+
+#if _MSC_VER >= 1800 && !defined(__AVX__) && !defined(_DEBUG)
+static_assert(false, "do not forget to set /arch:AVX or /arch:AVX2 for this file.");
+#endif
+
+#if defined(_MSC_VER) || defined(__AVX2__)
+
+//幅が足りない場合に使用するC版 (NVEncFilterAfsCpu.cpp)
+void afs_analyze_row8_c(uint8_t *flags, const uint8_t *p0c, const uint8_t *p0m, const uint8_t *p1c, const uint8_t *p1m,
+    int width, int has_prev, int shift_first_p0m, int thre_motion, int thre_deint, int thre_shift);
+void afs_gen_merge_row_c(uint8_t *mask0, uint8_t *mask_or, const uint8_t *const flags[3][4], int width);
+void afs_combine_row_c(uint8_t *dst, const uint8_t *mask_or4, const uint8_t *mask3, const uint8_t *mask2, const uint8_t *mask1, const uint8_t *mask0, int width);
+void afs_merge_scan_row_c(uint8_t *dst, const uint8_t *p0m, const uint8_t *p0c, const uint8_t *p0p, const uint8_t *p1m, const uint8_t *p1c, const uint8_t *p1p, int width);
+void afs_filter_h1_row_c(uint8_t *dst, const uint8_t *src, int width);
+void afs_filter_h2_row_c(uint8_t *dst, const uint8_t *src, int width);
+
+//a > b (unsigned) となる画素にflagを立てる
+static RGY_FORCEINLINE __m256i cmpgt_epu8_flag(__m256i a, __m256i b, __m256i flag) {
+    return _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_subs_epu8(a, b), _mm256_setzero_si256()), flag);
+}
+
+//a >= b (unsigned) となる画素にflagを立てる
+static RGY_FORCEINLINE __m256i cmpge_epu8_flag(__m256i a, __m256i b, __m256i flag) {
+    return _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_subs_epu8(b, a), _mm256_setzero_si256()), flag);
+}
+
+static RGY_FORCEINLINE __m256i absdiff_epu8(__m256i a, __m256i b) {
+    return _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+}
+
+void afs_analyze_row8_avx2(uint8_t *flags, const uint8_t *p0c, const uint8_t *p0m, const uint8_t *p1c, const uint8_t *p1m,
+    int width, int has_prev, int shift_first_p0m, int thre_motion, int thre_deint, int thre_shift) {
+    const __m256i yThreMotion = _mm256_set1_epi8((char)thre_motion);
+    const __m256i yThreDeint  = _mm256_set1_epi8((char)thre_deint);
+    const __m256i yThreShift  = _mm256_set1_epi8((char)thre_shift);
+    //幅が32未満の場合はC版で処理し、そうでなければ最後のブロックは重複させて処理する
+    if (width < 32) {
+        afs_analyze_row8_c(flags, p0c, p0m, p1c, p1m, width, has_prev, shift_first_p0m, thre_motion, thre_deint, thre_shift);
+        return;
+    }
+    for (int x = 0; x < width; x += 32) {
+        if (x + 32 > width) x = width - 32;
+        const __m256i y0 = _mm256_loadu_si256((const __m256i *)(p0c + x));
+        const __m256i y1 = _mm256_loadu_si256((const __m256i *)(p1c + x));
+        //motion
+        __m256i yAbs = absdiff_epu8(y0, y1);
+        __m256i yFlag = _mm256_or_si256(
+            cmpgt_epu8_flag(yThreMotion, yAbs, _mm256_set1_epi8(0x08)),
+            cmpgt_epu8_flag(yThreShift,  yAbs, _mm256_set1_epi8((char)0x80)));
+        if (has_prev) {
+            //non-shift
+            const __m256i y0m = _mm256_loadu_si256((const __m256i *)(p0m + x));
+            yAbs = absdiff_epu8(y0, y0m);
+            yFlag = _mm256_or_si256(yFlag, cmpge_epu8_flag(y0, y0m, _mm256_set1_epi8(0x40)));
+            yFlag = _mm256_or_si256(yFlag, cmpgt_epu8_flag(yAbs, yThreDeint, _mm256_set1_epi8(0x10)));
+            yFlag = _mm256_or_si256(yFlag, cmpgt_epu8_flag(yAbs, yThreShift, _mm256_set1_epi8(0x20)));
+            //shift
+            const __m256i yS0 = (shift_first_p0m) ? y0m : _mm256_loadu_si256((const __m256i *)(p1m + x));
+            const __m256i yS1 = (shift_first_p0m) ? y1 : y0;
+            yAbs = absdiff_epu8(yS0, yS1);
+            yFlag = _mm256_or_si256(yFlag, cmpge_epu8_flag(yS0, yS1, _mm256_set1_epi8(0x04)));
+            yFlag = _mm256_or_si256(yFlag, cmpgt_epu8_flag(yAbs, yThreDeint, _mm256_set1_epi8(0x01)));
+            yFlag = _mm256_or_si256(yFlag, cmpgt_epu8_flag(yAbs, yThreShift, _mm256_set1_epi8(0x02)));
+        }
+        _mm256_storeu_si256((__m256i *)(flags + x), yFlag);
+    }
+}
+
+//各ビットはバイト境界をまたがないので、16bit単位のシフトで代用できる
+static RGY_FORCEINLINE void gen_flag_step(__m256i& cd, __m256i& cs, __m256i a, __m256i b) {
+    __m256i m = _mm256_and_si256(_mm256_xor_si256(a, b), _mm256_set1_epi8(0x44));
+    m = _mm256_or_si256(m, _mm256_slli_epi16(m, 1));
+    m = _mm256_or_si256(m, _mm256_srli_epi16(m, 2));
+    cd = _mm256_and_si256(cd, m);
+    cs = _mm256_and_si256(cs, m);
+    cd = _mm256_add_epi8(cd, _mm256_and_si256(a, _mm256_set1_epi8(0x11)));
+    cs = _mm256_add_epi8(cs, _mm256_and_si256(a, _mm256_set1_epi8(0x22)));
+}
+
+static RGY_FORCEINLINE __m256i gen_flag(__m256i f3, __m256i f2, __m256i f1, __m256i f0) {
+    __m256i cs = _mm256_and_si256(f3, _mm256_set1_epi8(0x22));
+    __m256i m = _mm256_srli_epi16(_mm256_and_si256(_mm256_xor_si256(f2, f3), _mm256_set1_epi8(0x44)), 1);
+    cs = _mm256_and_si256(cs, m);
+    __m256i cd = _mm256_and_si256(f2, _mm256_set1_epi8(0x11));
+    cs = _mm256_add_epi8(cs, _mm256_and_si256(f2, _mm256_set1_epi8(0x22)));
+    gen_flag_step(cd, cs, f1, f2);
+    gen_flag_step(cd, cs, f0, f1);
+
+    __m256i ret = _mm256_srli_epi16(_mm256_and_si256(f0, _mm256_set1_epi8((char)0x88)), 1);
+    ret = _mm256_or_si256(ret, cmpgt_epu8_flag(_mm256_and_si256(cd, _mm256_set1_epi8(0x70)),       _mm256_set1_epi8(0x20), _mm256_set1_epi8(0x01)));
+    ret = _mm256_or_si256(ret, cmpgt_epu8_flag(_mm256_and_si256(cs, _mm256_set1_epi8((char)0xE0)), _mm256_set1_epi8(0x60), _mm256_set1_epi8(0x10)));
+    ret = _mm256_or_si256(ret, cmpgt_epu8_flag(_mm256_and_si256(cd, _mm256_set1_epi8(0x07)),       _mm256_set1_epi8(0x02), _mm256_set1_epi8(0x02)));
+    ret = _mm256_or_si256(ret, cmpgt_epu8_flag(_mm256_and_si256(cs, _mm256_set1_epi8(0x0E)),       _mm256_set1_epi8(0x06), _mm256_set1_epi8(0x20)));
+    return ret;
+}
+
+void afs_gen_merge_row_avx2(uint8_t *mask0, uint8_t *mask_or, const uint8_t *const flags[3][4], int width) {
+    if (width < 32) {
+        afs_gen_merge_row_c(mask0, mask_or, flags, width);
+        return;
+    }
+    for (int x = 0; x < width; x += 32) {
+        if (x + 32 > width) x = width - 32;
+        __m256i yPlane[3];
+        for (int j = 0; j < 3; j++) {
+            yPlane[j] = gen_flag(
+                _mm256_loadu_si256((const __m256i *)(flags[j][0] + x)),
+                _mm256_loadu_si256((const __m256i *)(flags[j][1] + x)),
+                _mm256_loadu_si256((const __m256i *)(flags[j][2] + x)),
+                _mm256_loadu_si256((const __m256i *)(flags[j][3] + x)));
+        }
+        const __m256i yAnd = _mm256_and_si256(_mm256_and_si256(yPlane[0], yPlane[1]), yPlane[2]);
+        const __m256i yOr  = _mm256_and_si256(_mm256_or_si256(_mm256_or_si256(yPlane[0], yPlane[1]), yPlane[2]), _mm256_set1_epi8(0x33));
+        _mm256_storeu_si256((__m256i *)(mask0 + x), _mm256_or_si256(_mm256_and_si256(yAnd, _mm256_set1_epi8((char)0xcc)), yOr));
+        _mm256_storeu_si256((__m256i *)(mask_or + x), yOr);
+    }
+}
+
+void afs_combine_row_avx2(uint8_t *dst, const uint8_t *mask_or4, const uint8_t *mask3, const uint8_t *mask2, const uint8_t *mask1, const uint8_t *mask0, int width) {
+    if (width < 32) {
+        afs_combine_row_c(dst, mask_or4, mask3, mask2, mask1, mask0, width);
+        return;
+    }
+    for (int x = 0; x < width; x += 32) {
+        if (x + 32 > width) x = width - 32;
+        __m256i y321 = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(mask3 + x)), _mm256_loadu_si256((const __m256i *)(mask2 + x)));
+        y321 = _mm256_or_si256(y321, _mm256_loadu_si256((const __m256i *)(mask1 + x)));
+        __m256i yRet = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(mask_or4 + x)), _mm256_set1_epi8(0x30));
+        yRet = _mm256_or_si256(yRet, _mm256_and_si256(y321, _mm256_set1_epi8(0x33)));
+        yRet = _mm256_or_si256(yRet, _mm256_loadu_si256((const __m256i *)(mask0 + x)));
+        _mm256_storeu_si256((__m256i *)(dst + x), yRet);
+    }
+}
+
+void afs_merge_scan_row_avx2(uint8_t *dst, const uint8_t *p0m, const uint8_t *p0c, const uint8_t *p0p, const uint8_t *p1m, const uint8_t *p1c, const uint8_t *p1p, int width) {
+    const __m256i yF3 = _mm256_set1_epi8((char)0xf3);
+    if (width < 32) {
+        afs_merge_scan_row_c(dst, p0m, p0c, p0p, p1m, p1c, p1p, width);
+        return;
+    }
+    for (int x = 0; x < width; x += 32) {
+        if (x + 32 > width) x = width - 32;
+        const __m256i y0c = _mm256_loadu_si256((const __m256i *)(p0c + x));
+        const __m256i y1c = _mm256_loadu_si256((const __m256i *)(p1c + x));
+        __m256i y4 = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(p0m + x)), _mm256_loadu_si256((const __m256i *)(p0p + x)));
+        __m256i y5 = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(p1m + x)), _mm256_loadu_si256((const __m256i *)(p1p + x)));
+        y4 = _mm256_and_si256(_mm256_or_si256(y4, yF3), y0c);
+        y5 = _mm256_and_si256(_mm256_or_si256(y5, yF3), y1c);
+        __m256i yRet = _mm256_and_si256(_mm256_and_si256(y4, y5), _mm256_set1_epi8(0x44));
+        yRet = _mm256_or_si256(yRet, _mm256_andnot_si256(y0c, _mm256_set1_epi8(0x33)));
+        _mm256_storeu_si256((__m256i *)(dst + x), yRet);
+    }
+}
+
+//水平方向のフィルタは両端のみC版で処理する
+template<bool filter2>
+static RGY_FORCEINLINE void afs_filter_h_row_avx2(uint8_t *dst, const uint8_t *src, int width) {
+    if (width < 34) {
+        if (filter2) {
+            afs_filter_h2_row_c(dst, src, width);
+        } else {
+            afs_filter_h1_row_c(dst, src, width);
+        }
+        return;
+    }
+    //左端
+    {
+        const uint8_t c = src[0], r = src[1];
+        dst[0] = (filter2) ? (uint8_t)(c & ((c & r) | 0xf8)) : (uint8_t)(c | ((c | r) & 0x03) | ((c & r) & 0x04));
+    }
+    const int x_fin = width - 1;
+    for (int x = 1; x < x_fin; x += 32) {
+        if (x + 32 > x_fin) x = x_fin - 32;
+        const __m256i yL = _mm256_loadu_si256((const __m256i *)(src + x - 1));
+        const __m256i yC = _mm256_loadu_si256((const __m256i *)(src + x));
+        const __m256i yR = _mm256_loadu_si256((const __m256i *)(src + x + 1));
+        __m256i yRet;
+        if (filter2) {
+            yRet = _mm256_and_si256(yC, _mm256_or_si256(_mm256_and_si256(yL, yR), _mm256_set1_epi8((char)0xf8)));
+        } else {
+            yRet = _mm256_or_si256(yC, _mm256_and_si256(_mm256_or_si256(yL, yR), _mm256_set1_epi8(0x03)));
+            yRet = _mm256_or_si256(yRet, _mm256_and_si256(_mm256_and_si256(yL, yR), _mm256_set1_epi8(0x04)));
+        }
+        _mm256_storeu_si256((__m256i *)(dst + x), yRet);
+    }
+    //右端
+    const uint8_t l = src[width - 2], c = src[width - 1];
+    dst[width - 1] = (filter2) ? (uint8_t)(c & ((l & c) | 0xf8)) : (uint8_t)(c | ((l | c) & 0x03) | ((l & c) & 0x04));
+}
+
+void afs_filter_h1_row_avx2(uint8_t *dst, const uint8_t *src, int width) {
+    afs_filter_h_row_avx2<false>(dst, src, width);
+}
+
+void afs_filter_h2_row_avx2(uint8_t *dst, const uint8_t *src, int width) {
+    afs_filter_h_row_avx2<true>(dst, src, width);
+}
+
+void afs_filter_v1_row_avx2(uint8_t *dst, const uint8_t *srcm, const uint8_t *srcc, const uint8_t *srcp, int width) {
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        const __m256i yM = _mm256_loadu_si256((const __m256i *)(srcm + x));
+        const __m256i yP = _mm256_loadu_si256((const __m256i *)(srcp + x));
+        const __m256i yC = _mm256_loadu_si256((const __m256i *)(srcc + x));
+        _mm256_storeu_si256((__m256i *)(dst + x), _mm256_or_si256(yC, _mm256_and_si256(_mm256_and_si256(yM, yP), _mm256_set1_epi8(0x07))));
+    }
+    for (; x < width; x++) {
+        dst[x] = srcc[x] | (srcm[x] & srcp[x] & 0x07);
+    }
+}
+
+void afs_filter_v2_row_avx2(uint8_t *dst, const uint8_t *srcm, const uint8_t *srcc, const uint8_t *srcp, int width) {
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        const __m256i yM = _mm256_loadu_si256((const __m256i *)(srcm + x));
+        const __m256i yP = _mm256_loadu_si256((const __m256i *)(srcp + x));
+        const __m256i yC = _mm256_loadu_si256((const __m256i *)(srcc + x));
+        _mm256_storeu_si256((__m256i *)(dst + x), _mm256_and_si256(yC, _mm256_or_si256(_mm256_and_si256(yM, yP), _mm256_set1_epi8((char)0xf8))));
+    }
+    for (; x < width; x++) {
+        dst[x] = srcc[x] & ((srcm[x] & srcp[x]) | 0xf8);
+    }
+}
+
+void afs_count_motion_avx2(int count[2], const uint8_t *ptr, int pitch, int x_start, int x_end, int y_start, int y_end, int tb_order) {
+    const __m256i yMotion = _mm256_set1_epi8(0x40);
+    const int x_count = x_end - x_start;
+    for (int pos_y = y_start; pos_y < y_end; pos_y++) {
+        const uint8_t *sip = ptr + pos_y * pitch + x_start;
+        const int is_latter_feild = ((pos_y & 1) == tb_order);
+        const uint8_t *sip_fin = sip + (x_count & ~31);
+        for (; sip < sip_fin; sip += 32) {
+            __m256i y0 = _mm256_loadu_si256((const __m256i*)sip);
+            y0 = _mm256_andnot_si256(y0, yMotion);
+            y0 = _mm256_cmpeq_epi8(y0, yMotion);
+            count[is_latter_feild] += popcnt32((uint32_t)_mm256_movemask_epi8(y0));
+        }
+        sip_fin = sip + (x_count & 31);
+        for (; sip < sip_fin; sip++)
+            count[is_latter_feild] += ((~*sip & 0x40) >> 6);
+    }
+}
+
+void afs_count_stripe_avx2(int count[2], const uint8_t *ptr, int pitch, int x_start, int x_end, int y_start, int y_end, int tb_order) {
+    const uint32_t check_mask[2] = { 0x50, 0x60 };
+    const int x_count = x_end - x_start;
+    for (int pos_y = y_start; pos_y < y_end; pos_y++) {
+        const uint8_t *sip = ptr + pos_y * pitch + x_start;
+        const int first_field_flag = ((pos_y & 1) != tb_order);
+        const __m256i yMask = _mm256_set1_epi8((char)check_mask[first_field_flag]);
+        const uint8_t *sip_fin = sip + (x_count & ~31);
+        for (; sip < sip_fin; sip += 32) {
+            __m256i y0 = _mm256_loadu_si256((const __m256i*)sip);
+            y0 = _mm256_and_si256(y0, yMask);
+            y0 = _mm256_cmpeq_epi8(y0, _mm256_setzero_si256());
+            count[first_field_flag] += popcnt32((uint32_t)_mm256_movemask_epi8(y0));
+        }
+        sip_fin = sip + (x_count & 31);
+        for (; sip < sip_fin; sip++)
+            count[first_field_flag] += (!(*sip & check_mask[first_field_flag]));
+    }
+}
+
+#endif //#if defined(_MSC_VER) || defined(__AVX2__)
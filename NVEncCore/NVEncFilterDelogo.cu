@@ -38,6 +38,11 @@ typedef struct {
     int16_t x, y;
 } int16x2_t;
 
+//自動選択で、ロゴありとみなす1フレームあたりの平均スコア
+static const float DELOGO_AUTO_SELECT_MIN_SCORE = 0.2f;
+//ロゴが見つからない場合、指定フレーム数のこの倍数まで評価を続ける
+static const int DELOGO_AUTO_SELECT_MAX_FRAMES_MUL = 10;
+
 template<typename Type, int bit_depth, bool target_y>
 __global__ void kernel_delogo(
     uint8_t *__restrict__ pFrame, const int framePitch, const int width, const int height,
@@ -236,12 +241,59 @@ NVEncFilterDelogo::NVEncFilterDelogo() {
     m_sFilterName = _T("delogo");
     m_LogoFilePath = _T("");
     m_nLogoIdx = -1;
+    m_nFrameIdx = 0;
 }
 
 NVEncFilterDelogo::~NVEncFilterDelogo() {
     close();
 }
 
+LogoFileReader::LogoFileReader() :
+    m_fp(),
+    m_mtx(),
+    m_nSize(0) {
+}
+
+LogoFileReader::~LogoFileReader() {
+    close();
+}
+
+int LogoFileReader::open(const TCHAR *filename) {
+    close();
+    FILE *fp = NULL;
+    if (_tfopen_s(&fp, filename, _T("rb")) || fp == NULL) {
+        return 1;
+    }
+    m_fp.reset(fp);
+    if (_fseeki64(fp, 0, SEEK_END)) {
+        close();
+        return 1;
+    }
+    const int64_t fileSize = _ftelli64(fp);
+    if (fileSize <= 0) {
+        close();
+        return 1;
+    }
+    m_nSize = (size_t)fileSize;
+    return 0;
+}
+
+void LogoFileReader::close() {
+    m_fp.reset();
+    m_nSize = 0;
+}
+
+int LogoFileReader::read(void *buf, size_t offset, size_t size) {
+    if (!m_fp || offset + size > m_nSize) {
+        return 1;
+    }
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (_fseeki64(m_fp.get(), (int64_t)offset, SEEK_SET)) {
+        return 1;
+    }
+    return (fread(buf, 1, size, m_fp.get()) == size) ? 0 : 1;
+}
+
 int NVEncFilterDelogo::readLogoFile(const std::shared_ptr<NVEncFilterParamDelogo> pDelogoParam) {
     int sts = 0;
     if (pDelogoParam->logoFilePath == nullptr) {
@@ -250,18 +302,17 @@ int NVEncFilterDelogo::readLogoFile(const std::shared_ptr<NVEncFilterParamDelogo
     if (m_LogoFilePath == pDelogoParam->logoFilePath) {
         return -1;
     }
-    auto file_deleter = [](FILE *fp) {
-        fclose(fp);
-    };
-    unique_ptr<FILE, decltype(file_deleter)> fp(_tfopen(pDelogoParam->logoFilePath, _T("rb")), file_deleter);
-    if (fp.get() == NULL) {
+    m_sLogoDataList.clear();
+    m_LogoNameIdx.clear();
+    if (m_LogoFile.open(pDelogoParam->logoFilePath)) {
         AddMessage(RGY_LOG_ERROR, _T("could not open logo file \"%s\".\n"), pDelogoParam->logoFilePath);
         return 1;
     }
+    const size_t fileSize = m_LogoFile.size();
     // ファイルヘッダ取得
     int logo_header_ver = 0;
     LOGO_FILE_HEADER logo_file_header = { 0 };
-    if (sizeof(logo_file_header) != fread(&logo_file_header, 1, sizeof(logo_file_header), fp.get())) {
+    if (m_LogoFile.read(&logo_file_header, 0, sizeof(logo_file_header))) {
         AddMessage(RGY_LOG_ERROR, _T("invalid logo file.\n"));
         sts = 1;
     } else if (0 == (logo_header_ver = get_logo_file_header_ver(&logo_file_header))) {
@@ -270,35 +321,65 @@ int NVEncFilterDelogo::readLogoFile(const std::shared_ptr<NVEncFilterParamDelogo
     } else {
         const size_t logo_header_size = (logo_header_ver == 2) ? sizeof(LOGO_HEADER) : sizeof(LOGO_HEADER_OLD);
         const int logonum = SWAP_ENDIAN(logo_file_header.logonum.l);
-        m_sLogoDataList.resize(logonum);
+        m_sLogoDataList.resize((std::max)(logonum, 0));
 
+        //ヘッダのみ読み込み、ピクセルデータはファイル内の位置を記録しておく
+        size_t offset = sizeof(logo_file_header);
         for (int i = 0; i < logonum; i++) {
-            memset(&m_sLogoDataList[i], 0, sizeof(m_sLogoDataList[i]));
-            if (logo_header_size != fread(&m_sLogoDataList[i].header, 1, logo_header_size, fp.get())) {
+            auto& logoData = m_sLogoDataList[i];
+            memset(&logoData.header, 0, sizeof(logoData.header));
+            if (m_LogoFile.read(&logoData.header, offset, logo_header_size)) {
                 AddMessage(RGY_LOG_ERROR, _T("invalid logo file.\n"));
                 sts = 1;
                 break;
             }
+            offset += logo_header_size;
             if (logo_header_ver == 1) {
-                convert_logo_header_v1_to_v2(&m_sLogoDataList[i].header);
+                convert_logo_header_v1_to_v2(&logoData.header);
             }
 
-            const auto logoPixelBytes = logo_pixel_size(&m_sLogoDataList[i].header);
-
-            // メモリ確保
-            m_sLogoDataList[i].logoPixel.resize(logoPixelBytes / sizeof(m_sLogoDataList[i].logoPixel[0]), { 0 });
-
-            if (logoPixelBytes != (int)fread(m_sLogoDataList[i].logoPixel.data(), 1, logoPixelBytes, fp.get())) {
+            const size_t logoPixelBytes = (size_t)logo_pixel_size(&logoData.header);
+            if (offset + logoPixelBytes > fileSize) {
                 AddMessage(RGY_LOG_ERROR, _T("invalid logo file.\n"));
                 sts = 1;
                 break;
             }
+            logoData.pixelOffset = offset;
+            offset += logoPixelBytes;
+
+            //同名のロゴがある場合は先頭のものを使用する
+            logoData.header.name[_countof(logoData.header.name) - 1] = '\0';
+            m_LogoNameIdx.emplace(std::string(logoData.header.name), i);
         }
     }
     m_LogoFilePath = pDelogoParam->logoFilePath;
     return sts;
 }
 
+int NVEncFilterDelogo::loadLogoData(int logoIdx, LogoData *pLogoData) {
+    pLogoData->header = m_sLogoDataList[logoIdx].header;
+    pLogoData->pixelOffset = m_sLogoDataList[logoIdx].pixelOffset;
+    pLogoData->logoPixel.resize(logo_pixel_size(&pLogoData->header) / sizeof(pLogoData->logoPixel[0]));
+    return m_LogoFile.read(pLogoData->logoPixel.data(), pLogoData->pixelOffset, pLogoData->logoPixel.size() * sizeof(pLogoData->logoPixel[0]));
+}
+
+//位置オフセット(posX, posY)を反映したロゴデータを読み込む
+int NVEncFilterDelogo::loadLogoData(int logoIdx, short posX, short posY, LogoData *pLogoData) {
+    if (loadLogoData(logoIdx, pLogoData)) {
+        return 1;
+    }
+    if (posX || posY) {
+        LogoData origData;
+        origData.header = pLogoData->header;
+        origData.logoPixel = pLogoData->logoPixel;
+
+        pLogoData->logoPixel = std::vector<LOGO_PIXEL>((pLogoData->header.w + 1) * (pLogoData->header.h + 1), { 0 });
+
+        create_adj_exdata(pLogoData->logoPixel.data(), &pLogoData->header, origData.logoPixel.data(), &origData.header, posX, posY);
+    }
+    return 0;
+}
+
 std::string NVEncFilterDelogo::logoNameList() {
     std::string strlist;
     for (int i = 0; i < (int)m_sLogoDataList.size(); i++) {
@@ -308,14 +389,8 @@ std::string NVEncFilterDelogo::logoNameList() {
 }
 
 int NVEncFilterDelogo::getLogoIdx(const std::string& logoName) {
-    int idx = LOGO_AUTO_SELECT_INVALID;
-    for (int i = 0; i < (int)m_sLogoDataList.size(); i++) {
-        if (0 == strcmp(m_sLogoDataList[i].header.name, logoName.c_str())) {
-            idx = i;
-            break;
-        }
-    }
-    return idx;
+    auto it = m_LogoNameIdx.find(logoName);
+    return (it != m_LogoNameIdx.end()) ? it->second : LOGO_AUTO_SELECT_INVALID;
 }
 
 int NVEncFilterDelogo::selectLogo(const TCHAR *selectStr, const TCHAR *inputFilename) {
@@ -355,12 +430,25 @@ int NVEncFilterDelogo::selectLogo(const TCHAR *selectStr, const TCHAR *inputFile
         return LOGO_AUTO_SELECT_INVALID;
     }
     //自動選択キー
+    //キーごとにファイルを読みなおさないよう、セクションをまとめて読み込む
+    std::vector<char> section(64 * 1024);
+    while (GetPrivateProfileSectionA("LOGO_AUTO_SELECT", section.data(), (DWORD)section.size(), logoName.c_str()) >= section.size() - 2) {
+        section.resize(section.size() * 2);
+    }
+    std::map<int, std::string> sectionKeys;
+    for (const char *line = section.data(); *line; line += strlen(line) + 1) {
+        const char *eq = strchr(line, '=');
+        if (eq == nullptr || _strnicmp(line, "logo", 4) != 0) {
+            continue;
+        }
+        std::string value = trim(std::string(eq + 1));
+        if (value.length() >= 2 && value.front() == '\"' && value.back() == '\"') {
+            value = value.substr(1, value.length() - 2);
+        }
+        sectionKeys[atoi(line + 4)] = value;
+    }
     int count = 0;
-    for (;; count++) {
-        char buf[512] = { 0 };
-        GetPrivateProfileStringA("LOGO_AUTO_SELECT", strsprintf("logo%d", count+1).c_str(), "", buf, sizeof(buf), logoName.c_str());
-        if (strlen(buf) == 0)
-            break;
+    for (; sectionKeys.count(count+1) && sectionKeys[count+1].length() > 0; count++) {
     }
     if (count == 0) {
         AddMessage(RGY_LOG_ERROR, _T("could not find any key to auto select from \"%s\".\n"), selectStr);
@@ -370,7 +458,7 @@ int NVEncFilterDelogo::selectLogo(const TCHAR *selectStr, const TCHAR *inputFile
     logoAutoSelectKeys.reserve(count);
     for (int i = 0; i < count; i++) {
         char buf[512] = { 0 };
-        GetPrivateProfileStringA("LOGO_AUTO_SELECT", strsprintf("logo%d", i+1).c_str(), "", buf, sizeof(buf), logoName.c_str());
+        strncpy_s(buf, sectionKeys[i+1].c_str(), _TRUNCATE);
         char *ptr = strchr(buf, ',');
         if (ptr != NULL) {
             LOGO_SELECT_KEY selectKey;
@@ -409,8 +497,16 @@ NVENCSTATUS NVEncFilterDelogo::init(shared_ptr<NVEncFilterParam> pParam, shared_
     if (ret_logofile > 0) {
         return NV_ENC_ERR_INVALID_PARAM;
     }
-    const int logoidx = selectLogo(pDelogoParam->logoSelect, pDelogoParam->inputFileName);
-    if (logoidx < 0) {
+    //ロゴパックでロゴの指定がなく、フレームの内容による自動選択が有効なら、そちらで選択する
+    const int logoidx = (pDelogoParam->logoSelect == nullptr && m_sLogoDataList.size() > 1 && pDelogoParam->autoSelectFrames > 0)
+        ? LOGO_AUTO_SELECT_NOHIT : selectLogo(pDelogoParam->logoSelect, pDelogoParam->inputFileName);
+    m_pAutoSelect.reset();
+    if (logoidx == LOGO_AUTO_SELECT_NOHIT && pDelogoParam->autoSelectFrames > 0) {
+        //ファイル名で選択できなかった場合も、フレームの内容から自動選択する
+        if (NV_ENC_SUCCESS != (sts = initAutoSelect(pDelogoParam))) {
+            return sts;
+        }
+    } else if (logoidx < 0) {
         if (logoidx == LOGO_AUTO_SELECT_NOHIT) {
             AddMessage(RGY_LOG_ERROR, _T("no logo was selected by auto select \"%s\".\n"), pDelogoParam->logoSelect);
             return NV_ENC_ERR_INVALID_PARAM;
@@ -419,200 +515,315 @@ NVENCSTATUS NVEncFilterDelogo::init(shared_ptr<NVEncFilterParam> pParam, shared_
             AddMessage(RGY_LOG_ERROR, char_to_tstring(logoNameList()));
             return NV_ENC_ERR_INVALID_PARAM;
         }
+    } else if (ret_logofile == 0 || m_nLogoIdx != logoidx) {
+        if (NV_ENC_SUCCESS != (sts = initLogo(pDelogoParam, logoidx))) {
+            return sts;
+        }
     }
-    if (ret_logofile == 0 || m_nLogoIdx != logoidx) {
-        m_nLogoIdx = logoidx;
-
-        auto& logoData = m_sLogoDataList[m_nLogoIdx];
-        if (pDelogoParam->posX || pDelogoParam->posY) {
-            LogoData origData;
-            origData.header = logoData.header;
-            origData.logoPixel = logoData.logoPixel;
 
-            logoData.logoPixel = std::vector<LOGO_PIXEL>((logoData.header.w + 1) * (logoData.header.h + 1), { 0 });
-
-            create_adj_exdata(logoData.logoPixel.data(), &logoData.header, origData.logoPixel.data(), &origData.header, pDelogoParam->posX, pDelogoParam->posY);
-        }
-        const int frameWidth  = pDelogoParam->frameIn.width;
-        const int frameHeight = pDelogoParam->frameIn.height;
-
-        m_sProcessData[LOGO__Y].offset[0] = pDelogoParam->Y  << 4;
-        m_sProcessData[LOGO__Y].offset[1] = pDelogoParam->Y  << 4;
-        m_sProcessData[LOGO_UV].offset[0] = pDelogoParam->Cb << 4;
-        m_sProcessData[LOGO_UV].offset[1] = pDelogoParam->Cr << 4;
-        m_sProcessData[LOGO__U].offset[0] = pDelogoParam->Cb << 4;
-        m_sProcessData[LOGO__U].offset[1] = pDelogoParam->Cb << 4;
-        m_sProcessData[LOGO__V].offset[0] = pDelogoParam->Cr << 4;
-        m_sProcessData[LOGO__V].offset[1] = pDelogoParam->Cr << 4;
-
-        m_sProcessData[LOGO__Y].fade = 256;
-        m_sProcessData[LOGO_UV].fade = 256;
-        m_sProcessData[LOGO__U].fade = 256;
-        m_sProcessData[LOGO__V].fade = 256;
-
-        m_sProcessData[LOGO__Y].depth = pDelogoParam->depth;
-        m_sProcessData[LOGO_UV].depth = pDelogoParam->depth;
-        m_sProcessData[LOGO__U].depth = pDelogoParam->depth;
-        m_sProcessData[LOGO__V].depth = pDelogoParam->depth;
-
-        m_sProcessData[LOGO__Y].i_start = (std::min)(logoData.header.x & ~63, frameWidth);
-        m_sProcessData[LOGO__Y].width   = (((std::min)(logoData.header.x + logoData.header.w, frameWidth) + 63) & ~63) - m_sProcessData[LOGO__Y].i_start;
-        m_sProcessData[LOGO_UV].i_start = m_sProcessData[LOGO__Y].i_start;
-        m_sProcessData[LOGO_UV].width   = m_sProcessData[LOGO__Y].width;
-        m_sProcessData[LOGO__U].i_start = m_sProcessData[LOGO__Y].i_start >> 1;
-        m_sProcessData[LOGO__U].width   = m_sProcessData[LOGO__Y].width >> 1;
-        m_sProcessData[LOGO__V].i_start = m_sProcessData[LOGO__U].i_start;
-        m_sProcessData[LOGO__V].width   = m_sProcessData[LOGO__U].width;
-        const int yWidthOffset = logoData.header.x - m_sProcessData[LOGO__Y].i_start;
-
-        m_sProcessData[LOGO__Y].j_start = (std::min)((int)logoData.header.y, frameHeight);
-        m_sProcessData[LOGO__Y].height  = (std::min)(logoData.header.y + logoData.header.h, frameHeight) - m_sProcessData[LOGO__Y].j_start;
-        m_sProcessData[LOGO_UV].j_start = logoData.header.y >> 1;
-        m_sProcessData[LOGO_UV].height  = (((logoData.header.y + logoData.header.h + 1) & ~1) - (m_sProcessData[LOGO_UV].j_start << 1)) >> 1;
-        m_sProcessData[LOGO__U].j_start = m_sProcessData[LOGO_UV].j_start;
-        m_sProcessData[LOGO__U].height  = m_sProcessData[LOGO_UV].height;
-        m_sProcessData[LOGO__V].j_start = m_sProcessData[LOGO__U].j_start;
-        m_sProcessData[LOGO__V].height  = m_sProcessData[LOGO__U].height;
-
-        if (logoData.header.x >= frameWidth || logoData.header.y >= frameHeight) {
-            AddMessage(RGY_LOG_ERROR, _T("\"%s\" was not included in frame size %dx%d.\ndelogo disabled.\n"), pDelogoParam->logoSelect, frameWidth, frameHeight);
-            AddMessage(RGY_LOG_ERROR, _T("logo pos x=%d, y=%d, including pos offset value %d:%d.\n"), logoData.header.x, logoData.header.y, pDelogoParam->posX, pDelogoParam->posY);
+    m_fpLog.reset();
+    if (pDelogoParam->logPath) {
+        FILE *fp = NULL;
+        if (_tfopen_s(&fp, pDelogoParam->logPath, _T("w")) || fp == NULL) {
+            AddMessage(RGY_LOG_ERROR, _T("failed to open delogo log file \"%s\".\n"), pDelogoParam->logPath);
             return NV_ENC_ERR_INVALID_PARAM;
         }
+        m_fpLog.reset(fp);
+        fprintf(m_fpLog.get(), "frame,fade,estimated,reliable,edge_none,edge_full,edge_best,process\n");
+    }
+    m_nFrameIdx = 0;
 
-        m_sProcessData[LOGO__Y].pLogoPtr.reset((int16_t *)_aligned_malloc(sizeof(int16_t) * 2 * m_sProcessData[LOGO__Y].width * m_sProcessData[LOGO__Y].height, 32));
-        m_sProcessData[LOGO_UV].pLogoPtr.reset((int16_t *)_aligned_malloc(sizeof(int16_t) * 2 * m_sProcessData[LOGO_UV].width * m_sProcessData[LOGO_UV].height, 32));
-        m_sProcessData[LOGO__U].pLogoPtr.reset((int16_t *)_aligned_malloc(sizeof(int16_t) * 2 * m_sProcessData[LOGO__U].width * m_sProcessData[LOGO__U].height, 32));
-        m_sProcessData[LOGO__V].pLogoPtr.reset((int16_t *)_aligned_malloc(sizeof(int16_t) * 2 * m_sProcessData[LOGO__V].width * m_sProcessData[LOGO__V].height, 32));
-
-        memset(m_sProcessData[LOGO__Y].pLogoPtr.get(), 0, sizeof(int16_t) * 2 * m_sProcessData[LOGO__Y].width * m_sProcessData[LOGO__Y].height);
-        memset(m_sProcessData[LOGO_UV].pLogoPtr.get(), 0, sizeof(int16_t) * 2 * m_sProcessData[LOGO_UV].width * m_sProcessData[LOGO_UV].height);
-        memset(m_sProcessData[LOGO__U].pLogoPtr.get(), 0, sizeof(int16_t) * 2 * m_sProcessData[LOGO__U].width * m_sProcessData[LOGO__U].height);
-        memset(m_sProcessData[LOGO__V].pLogoPtr.get(), 0, sizeof(int16_t) * 2 * m_sProcessData[LOGO__V].width * m_sProcessData[LOGO__V].height);
-
-        //まず輝度成分をコピーしてしまう
-        for (int j = 0; j < m_sProcessData[LOGO__Y].height; j++) {
-            //輝度成分はそのままコピーするだけ
-            for (int i = 0; i < logoData.header.w; i++) {
-                int16x2_t logoY = *(int16x2_t *)&logoData.logoPixel[j * logoData.header.w + i].dp_y;
-                ((int16x2_t *)m_sProcessData[LOGO__Y].pLogoPtr.get())[j * m_sProcessData[LOGO__Y].width + i + yWidthOffset] = logoY;
-            }
+    m_pParam = pDelogoParam;
+    return sts;
+}
+
+NVENCSTATUS NVEncFilterDelogo::initLogo(const std::shared_ptr<NVEncFilterParamDelogo> pDelogoParam, int logoIdx) {
+    m_nLogoIdx = logoIdx;
+
+    LogoData logoData;
+    if (loadLogoData(logoIdx, pDelogoParam->posX, pDelogoParam->posY, &logoData)) {
+        AddMessage(RGY_LOG_ERROR, _T("failed to read logo data of \"%s\".\n"), char_to_tstring(m_sLogoDataList[logoIdx].header.name).c_str());
+        return NV_ENC_ERR_INVALID_PARAM;
+    }
+    const int frameWidth  = pDelogoParam->frameIn.width;
+    const int frameHeight = pDelogoParam->frameIn.height;
+
+    m_sProcessData[LOGO__Y].offset[0] = pDelogoParam->Y  << 4;
+    m_sProcessData[LOGO__Y].offset[1] = pDelogoParam->Y  << 4;
+    m_sProcessData[LOGO_UV].offset[0] = pDelogoParam->Cb << 4;
+    m_sProcessData[LOGO_UV].offset[1] = pDelogoParam->Cr << 4;
+    m_sProcessData[LOGO__U].offset[0] = pDelogoParam->Cb << 4;
+    m_sProcessData[LOGO__U].offset[1] = pDelogoParam->Cb << 4;
+    m_sProcessData[LOGO__V].offset[0] = pDelogoParam->Cr << 4;
+    m_sProcessData[LOGO__V].offset[1] = pDelogoParam->Cr << 4;
+
+    m_sProcessData[LOGO__Y].fade = 256;
+    m_sProcessData[LOGO_UV].fade = 256;
+    m_sProcessData[LOGO__U].fade = 256;
+    m_sProcessData[LOGO__V].fade = 256;
+
+    m_sProcessData[LOGO__Y].depth = pDelogoParam->depth;
+    m_sProcessData[LOGO_UV].depth = pDelogoParam->depth;
+    m_sProcessData[LOGO__U].depth = pDelogoParam->depth;
+    m_sProcessData[LOGO__V].depth = pDelogoParam->depth;
+
+    m_sProcessData[LOGO__Y].i_start = (std::min)(logoData.header.x & ~63, frameWidth);
+    m_sProcessData[LOGO__Y].width   = (((std::min)(logoData.header.x + logoData.header.w, frameWidth) + 63) & ~63) - m_sProcessData[LOGO__Y].i_start;
+    m_sProcessData[LOGO_UV].i_start = m_sProcessData[LOGO__Y].i_start;
+    m_sProcessData[LOGO_UV].width   = m_sProcessData[LOGO__Y].width;
+    m_sProcessData[LOGO__U].i_start = m_sProcessData[LOGO__Y].i_start >> 1;
+    m_sProcessData[LOGO__U].width   = m_sProcessData[LOGO__Y].width >> 1;
+    m_sProcessData[LOGO__V].i_start = m_sProcessData[LOGO__U].i_start;
+    m_sProcessData[LOGO__V].width   = m_sProcessData[LOGO__U].width;
+    const int yWidthOffset = logoData.header.x - m_sProcessData[LOGO__Y].i_start;
+
+    m_sProcessData[LOGO__Y].j_start = (std::min)((int)logoData.header.y, frameHeight);
+    m_sProcessData[LOGO__Y].height  = (std::min)(logoData.header.y + logoData.header.h, frameHeight) - m_sProcessData[LOGO__Y].j_start;
+    m_sProcessData[LOGO_UV].j_start = logoData.header.y >> 1;
+    m_sProcessData[LOGO_UV].height  = (((logoData.header.y + logoData.header.h + 1) & ~1) - (m_sProcessData[LOGO_UV].j_start << 1)) >> 1;
+    m_sProcessData[LOGO__U].j_start = m_sProcessData[LOGO_UV].j_start;
+    m_sProcessData[LOGO__U].height  = m_sProcessData[LOGO_UV].height;
+    m_sProcessData[LOGO__V].j_start = m_sProcessData[LOGO__U].j_start;
+    m_sProcessData[LOGO__V].height  = m_sProcessData[LOGO__U].height;
+
+    if (logoData.header.x >= frameWidth || logoData.header.y >= frameHeight) {
+        AddMessage(RGY_LOG_ERROR, _T("\"%s\" was not included in frame size %dx%d.\ndelogo disabled.\n"), char_to_tstring(logoData.header.name).c_str(), frameWidth, frameHeight);
+        AddMessage(RGY_LOG_ERROR, _T("logo pos x=%d, y=%d, including pos offset value %d:%d.\n"), logoData.header.x, logoData.header.y, pDelogoParam->posX, pDelogoParam->posY);
+        return NV_ENC_ERR_INVALID_PARAM;
+    }
+
+    m_sProcessData[LOGO__Y].pLogoPtr.reset((int16_t *)_aligned_malloc(sizeof(int16_t) * 2 * m_sProcessData[LOGO__Y].width * m_sProcessData[LOGO__Y].height, 32));
+    m_sProcessData[LOGO_UV].pLogoPtr.reset((int16_t *)_aligned_malloc(sizeof(int16_t) * 2 * m_sProcessData[LOGO_UV].width * m_sProcessData[LOGO_UV].height, 32));
+    m_sProcessData[LOGO__U].pLogoPtr.reset((int16_t *)_aligned_malloc(sizeof(int16_t) * 2 * m_sProcessData[LOGO__U].width * m_sProcessData[LOGO__U].height, 32));
+    m_sProcessData[LOGO__V].pLogoPtr.reset((int16_t *)_aligned_malloc(sizeof(int16_t) * 2 * m_sProcessData[LOGO__V].width * m_sProcessData[LOGO__V].height, 32));
+
+    memset(m_sProcessData[LOGO__Y].pLogoPtr.get(), 0, sizeof(int16_t) * 2 * m_sProcessData[LOGO__Y].width * m_sProcessData[LOGO__Y].height);
+    memset(m_sProcessData[LOGO_UV].pLogoPtr.get(), 0, sizeof(int16_t) * 2 * m_sProcessData[LOGO_UV].width * m_sProcessData[LOGO_UV].height);
+    memset(m_sProcessData[LOGO__U].pLogoPtr.get(), 0, sizeof(int16_t) * 2 * m_sProcessData[LOGO__U].width * m_sProcessData[LOGO__U].height);
+    memset(m_sProcessData[LOGO__V].pLogoPtr.get(), 0, sizeof(int16_t) * 2 * m_sProcessData[LOGO__V].width * m_sProcessData[LOGO__V].height);
+
+    //まず輝度成分をコピーしてしまう
+    for (int j = 0; j < m_sProcessData[LOGO__Y].height; j++) {
+        //輝度成分はそのままコピーするだけ
+        for (int i = 0; i < logoData.header.w; i++) {
+            int16x2_t logoY = *(int16x2_t *)&logoData.logoPixel[j * logoData.header.w + i].dp_y;
+            ((int16x2_t *)m_sProcessData[LOGO__Y].pLogoPtr.get())[j * m_sProcessData[LOGO__Y].width + i + yWidthOffset] = logoY;
         }
-        //まずは4:4:4->4:2:0処理時に端を気にしなくていいよう、縦横ともに2の倍数となるよう拡張する
-        //CbCrの順番に並べていく
-        //0で初期化しておく
-        std::vector<int16x2_t> bufferCbCr444ForShrink(2 * m_sProcessData[LOGO_UV].height * 2 * m_sProcessData[LOGO__Y].width, { 0, 0 });
-        int j_src = 0; //読み込み側の行
-        int j_dst = 0; //書き込み側の行
-        auto copyUVLineForShrink = [&]() {
-            for (int i = 0; i < logoData.header.w; i++) {
-                int16x2_t logoCb = *(int16x2_t *)&logoData.logoPixel[j_src * logoData.header.w + i].dp_cb;
-                int16x2_t logoCr = *(int16x2_t *)&logoData.logoPixel[j_src * logoData.header.w + i].dp_cr;
-                bufferCbCr444ForShrink[(j_dst * m_sProcessData[LOGO_UV].width + i + yWidthOffset) * 2 + 0] = logoCb;
-                bufferCbCr444ForShrink[(j_dst * m_sProcessData[LOGO_UV].width + i + yWidthOffset) * 2 + 1] = logoCr;
-            }
-            if (yWidthOffset & 1) {
-                //奇数列はじまりなら、それをその前の偶数列に拡張する
-                int16x2_t logoCb = *(int16x2_t *)&bufferCbCr444ForShrink[(j_dst * m_sProcessData[LOGO_UV].width + 0 + yWidthOffset) * 2 + 0];
-                int16x2_t logoCr = *(int16x2_t *)&bufferCbCr444ForShrink[(j_dst * m_sProcessData[LOGO_UV].width + 0 + yWidthOffset) * 2 + 1];
-                bufferCbCr444ForShrink[(j_dst * m_sProcessData[LOGO_UV].width + 0 + yWidthOffset - 1) * 2 + 0] = logoCb;
-                bufferCbCr444ForShrink[(j_dst * m_sProcessData[LOGO_UV].width + 0 + yWidthOffset - 1) * 2 + 1] = logoCr;
-            }
-            if ((yWidthOffset + logoData.header.w) & 1) {
-                //偶数列おわりなら、それをその次の奇数列に拡張する
-                int16x2_t logoCb = *(int16x2_t *)&bufferCbCr444ForShrink[(j_dst * m_sProcessData[LOGO_UV].width + logoData.header.w + yWidthOffset) * 2 + 0];
-                int16x2_t logoCr = *(int16x2_t *)&bufferCbCr444ForShrink[(j_dst * m_sProcessData[LOGO_UV].width + logoData.header.w + yWidthOffset) * 2 + 1];
-                bufferCbCr444ForShrink[(j_dst * m_sProcessData[LOGO_UV].width + logoData.header.w + yWidthOffset + 1) * 2 + 0] = logoCb;
-                bufferCbCr444ForShrink[(j_dst * m_sProcessData[LOGO_UV].width + logoData.header.w + yWidthOffset + 1) * 2 + 1] = logoCr;
-            }
-        };
-        if (logoData.header.y & 1) {
-            copyUVLineForShrink();
-            j_dst++; //書き込み側は1行進める
+    }
+    //まずは4:4:4->4:2:0処理時に端を気にしなくていいよう、縦横ともに2の倍数となるよう拡張する
+    //CbCrの順番に並べていく
+    //0で初期化しておく
+    std::vector<int16x2_t> bufferCbCr444ForShrink(2 * m_sProcessData[LOGO_UV].height * 2 * m_sProcessData[LOGO__Y].width, { 0, 0 });
+    int j_src = 0; //読み込み側の行
+    int j_dst = 0; //書き込み側の行
+    auto copyUVLineForShrink = [&]() {
+        for (int i = 0; i < logoData.header.w; i++) {
+            int16x2_t logoCb = *(int16x2_t *)&logoData.logoPixel[j_src * logoData.header.w + i].dp_cb;
+            int16x2_t logoCr = *(int16x2_t *)&logoData.logoPixel[j_src * logoData.header.w + i].dp_cr;
+            bufferCbCr444ForShrink[(j_dst * m_sProcessData[LOGO_UV].width + i + yWidthOffset) * 2 + 0] = logoCb;
+            bufferCbCr444ForShrink[(j_dst * m_sProcessData[LOGO_UV].width + i + yWidthOffset) * 2 + 1] = logoCr;
         }
-        for (; j_src < logoData.header.h; j_src++, j_dst++) {
-            copyUVLineForShrink();
+        if (yWidthOffset & 1) {
+            //奇数列はじまりなら、それをその前の偶数列に拡張する
+            int16x2_t logoCb = *(int16x2_t *)&bufferCbCr444ForShrink[(j_dst * m_sProcessData[LOGO_UV].width + 0 + yWidthOffset) * 2 + 0];
+            int16x2_t logoCr = *(int16x2_t *)&bufferCbCr444ForShrink[(j_dst * m_sProcessData[LOGO_UV].width + 0 + yWidthOffset) * 2 + 1];
+            bufferCbCr444ForShrink[(j_dst * m_sProcessData[LOGO_UV].width + 0 + yWidthOffset - 1) * 2 + 0] = logoCb;
+            bufferCbCr444ForShrink[(j_dst * m_sProcessData[LOGO_UV].width + 0 + yWidthOffset - 1) * 2 + 1] = logoCr;
         }
-        if ((logoData.header.y + logoData.header.h) & 1) {
-            j_src--; //読み込み側は1行戻る
-            copyUVLineForShrink();
+        if ((yWidthOffset + logoData.header.w) & 1) {
+            //偶数列おわりなら、それをその次の奇数列に拡張する
+            int16x2_t logoCb = *(int16x2_t *)&bufferCbCr444ForShrink[(j_dst * m_sProcessData[LOGO_UV].width + logoData.header.w + yWidthOffset) * 2 + 0];
+            int16x2_t logoCr = *(int16x2_t *)&bufferCbCr444ForShrink[(j_dst * m_sProcessData[LOGO_UV].width + logoData.header.w + yWidthOffset) * 2 + 1];
+            bufferCbCr444ForShrink[(j_dst * m_sProcessData[LOGO_UV].width + logoData.header.w + yWidthOffset + 1) * 2 + 0] = logoCb;
+            bufferCbCr444ForShrink[(j_dst * m_sProcessData[LOGO_UV].width + logoData.header.w + yWidthOffset + 1) * 2 + 1] = logoCr;
         }
-
-        //実際に縮小処理を行う
-        //2x2->1x1の処理なのでインクリメントはそれぞれ2ずつ
-        for (int j = 0; j < m_sProcessData[LOGO__Y].height; j += 2) {
-            for (int i = 0; i < m_sProcessData[LOGO_UV].width; i += 2) {
-                int16x2_t logoCb0 = bufferCbCr444ForShrink[((j + 0) * m_sProcessData[LOGO_UV].width + i + 0) * 2 + 0];
-                int16x2_t logoCr0 = bufferCbCr444ForShrink[((j + 0) * m_sProcessData[LOGO_UV].width + i + 0) * 2 + 1];
-                int16x2_t logoCb1 = bufferCbCr444ForShrink[((j + 0) * m_sProcessData[LOGO_UV].width + i + 1) * 2 + 0];
-                int16x2_t logoCr1 = bufferCbCr444ForShrink[((j + 0) * m_sProcessData[LOGO_UV].width + i + 1) * 2 + 1];
-                int16x2_t logoCb2 = bufferCbCr444ForShrink[((j + 1) * m_sProcessData[LOGO_UV].width + i + 0) * 2 + 0];
-                int16x2_t logoCr2 = bufferCbCr444ForShrink[((j + 1) * m_sProcessData[LOGO_UV].width + i + 0) * 2 + 1];
-                int16x2_t logoCb3 = bufferCbCr444ForShrink[((j + 1) * m_sProcessData[LOGO_UV].width + i + 1) * 2 + 0];
-                int16x2_t logoCr3 = bufferCbCr444ForShrink[((j + 1) * m_sProcessData[LOGO_UV].width + i + 1) * 2 + 1];
-
-                int16x2_t logoCb, logoCr;
-                logoCb.x = (logoCb0.x + logoCb1.x + logoCb2.x + logoCb3.x + 2) >> 2;
-                logoCb.y = (logoCb0.y + logoCb1.y + logoCb2.y + logoCb3.y + 2) >> 2;
-                logoCr.x = (logoCr0.x + logoCr1.x + logoCr2.x + logoCr3.x + 2) >> 2;
-                logoCr.y = (logoCr0.y + logoCr1.y + logoCr2.y + logoCr3.y + 2) >> 2;
-
-                //単純平均により4:4:4->4:2:0に
-                ((int16x2_t *)m_sProcessData[LOGO_UV].pLogoPtr.get())[(j >> 1) * m_sProcessData[LOGO_UV].width * 1 + (i >> 1) * 2 + 0] = logoCb;
-                ((int16x2_t *)m_sProcessData[LOGO_UV].pLogoPtr.get())[(j >> 1) * m_sProcessData[LOGO_UV].width * 1 + (i >> 1) * 2 + 1] = logoCr;
-                ((int16x2_t *)m_sProcessData[LOGO__U].pLogoPtr.get())[(j >> 1) * m_sProcessData[LOGO__U].width * 1 + (i >> 1) * 1] = logoCb;
-                ((int16x2_t *)m_sProcessData[LOGO__V].pLogoPtr.get())[(j >> 1) * m_sProcessData[LOGO__V].width * 1 + (i >> 1) * 1] = logoCr;
-            }
+    };
+    if (logoData.header.y & 1) {
+        copyUVLineForShrink();
+        j_dst++; //書き込み側は1行進める
+    }
+    for (; j_src < logoData.header.h; j_src++, j_dst++) {
+        copyUVLineForShrink();
+    }
+    if ((logoData.header.y + logoData.header.h) & 1) {
+        j_src--; //読み込み側は1行戻る
+        copyUVLineForShrink();
+    }
+
+    //実際に縮小処理を行う
+    //2x2->1x1の処理なのでインクリメントはそれぞれ2ずつ
+    for (int j = 0; j < m_sProcessData[LOGO__Y].height; j += 2) {
+        for (int i = 0; i < m_sProcessData[LOGO_UV].width; i += 2) {
+            int16x2_t logoCb0 = bufferCbCr444ForShrink[((j + 0) * m_sProcessData[LOGO_UV].width + i + 0) * 2 + 0];
+            int16x2_t logoCr0 = bufferCbCr444ForShrink[((j + 0) * m_sProcessData[LOGO_UV].width + i + 0) * 2 + 1];
+            int16x2_t logoCb1 = bufferCbCr444ForShrink[((j + 0) * m_sProcessData[LOGO_UV].width + i + 1) * 2 + 0];
+            int16x2_t logoCr1 = bufferCbCr444ForShrink[((j + 0) * m_sProcessData[LOGO_UV].width + i + 1) * 2 + 1];
+            int16x2_t logoCb2 = bufferCbCr444ForShrink[((j + 1) * m_sProcessData[LOGO_UV].width + i + 0) * 2 + 0];
+            int16x2_t logoCr2 = bufferCbCr444ForShrink[((j + 1) * m_sProcessData[LOGO_UV].width + i + 0) * 2 + 1];
+            int16x2_t logoCb3 = bufferCbCr444ForShrink[((j + 1) * m_sProcessData[LOGO_UV].width + i + 1) * 2 + 0];
+            int16x2_t logoCr3 = bufferCbCr444ForShrink[((j + 1) * m_sProcessData[LOGO_UV].width + i + 1) * 2 + 1];
+
+            int16x2_t logoCb, logoCr;
+            logoCb.x = (logoCb0.x + logoCb1.x + logoCb2.x + logoCb3.x + 2) >> 2;
+            logoCb.y = (logoCb0.y + logoCb1.y + logoCb2.y + logoCb3.y + 2) >> 2;
+            logoCr.x = (logoCr0.x + logoCr1.x + logoCr2.x + logoCr3.x + 2) >> 2;
+            logoCr.y = (logoCr0.y + logoCr1.y + logoCr2.y + logoCr3.y + 2) >> 2;
+
+            //単純平均により4:4:4->4:2:0に
+            ((int16x2_t *)m_sProcessData[LOGO_UV].pLogoPtr.get())[(j >> 1) * m_sProcessData[LOGO_UV].width * 1 + (i >> 1) * 2 + 0] = logoCb;
+            ((int16x2_t *)m_sProcessData[LOGO_UV].pLogoPtr.get())[(j >> 1) * m_sProcessData[LOGO_UV].width * 1 + (i >> 1) * 2 + 1] = logoCr;
+            ((int16x2_t *)m_sProcessData[LOGO__U].pLogoPtr.get())[(j >> 1) * m_sProcessData[LOGO__U].width * 1 + (i >> 1) * 1] = logoCb;
+            ((int16x2_t *)m_sProcessData[LOGO__V].pLogoPtr.get())[(j >> 1) * m_sProcessData[LOGO__V].width * 1 + (i >> 1) * 1] = logoCr;
         }
+    }
 
-        for (uint32_t i = 0; i < _countof(m_sProcessData); i++) {
-            unique_ptr<CUFrameBuf> uptr(new CUFrameBuf(m_sProcessData[i].width * sizeof(int16x2_t), m_sProcessData[i].height));
-            auto cudaerr = uptr->alloc();
-            if (cudaerr != cudaSuccess) {
-                m_pFrameBuf.clear();
-                AddMessage(RGY_LOG_ERROR, _T("failed to allocate memory for logo data %d: %s.\n"),
-                    i, char_to_tstring(cudaGetErrorString(cudaerr)).c_str());
-                return NV_ENC_ERR_OUT_OF_MEMORY;
-            }
-            m_sProcessData[i].pDevLogo = std::move(uptr);
-            //ロゴデータをGPUに転送
-            cudaerr = cudaMemcpy2DAsync(m_sProcessData[i].pDevLogo->frame.ptr, m_sProcessData[i].pDevLogo->frame.pitch,
-                (void *)m_sProcessData[i].pLogoPtr.get(), m_sProcessData[i].width * sizeof(int16x2_t),
-                m_sProcessData[i].width * sizeof(int16x2_t), m_sProcessData[i].height, cudaMemcpyHostToDevice);
-            if (cudaerr != cudaSuccess) {
-                AddMessage(RGY_LOG_ERROR, _T("error at sending logo data %d cudaMemcpy2DAsync(%s): %s.\n"),
-                    i,
-                    getCudaMemcpyKindStr(cudaMemcpyHostToDevice),
-                    char_to_tstring(cudaGetErrorString(cudaerr)).c_str());
-            }
+    for (uint32_t i = 0; i < _countof(m_sProcessData); i++) {
+        unique_ptr<CUFrameBuf> uptr(new CUFrameBuf(m_sProcessData[i].width * sizeof(int16x2_t), m_sProcessData[i].height));
+        auto cudaerr = uptr->alloc();
+        if (cudaerr != cudaSuccess) {
+            m_pFrameBuf.clear();
+            AddMessage(RGY_LOG_ERROR, _T("failed to allocate memory for logo data %d: %s.\n"),
+                i, char_to_tstring(cudaGetErrorString(cudaerr)).c_str());
+            return NV_ENC_ERR_OUT_OF_MEMORY;
         }
-
-        //フィルタ情報の調整
-        std::string str = "";
-        switch (pDelogoParam->mode) {
-        case DELOGO_MODE_ADD:
-            str += ", add";
-            break;
-        case DELOGO_MODE_REMOVE:
-        default:
-            break;
+        m_sProcessData[i].pDevLogo = std::move(uptr);
+        //ロゴデータをGPUに転送
+        cudaerr = cudaMemcpy2DAsync(m_sProcessData[i].pDevLogo->frame.ptr, m_sProcessData[i].pDevLogo->frame.pitch,
+            (void *)m_sProcessData[i].pLogoPtr.get(), m_sProcessData[i].width * sizeof(int16x2_t),
+            m_sProcessData[i].width * sizeof(int16x2_t), m_sProcessData[i].height, cudaMemcpyHostToDevice);
+        if (cudaerr != cudaSuccess) {
+            AddMessage(RGY_LOG_ERROR, _T("error at sending logo data %d cudaMemcpy2DAsync(%s): %s.\n"),
+                i,
+                getCudaMemcpyKindStr(cudaMemcpyHostToDevice),
+                char_to_tstring(cudaGetErrorString(cudaerr)).c_str());
         }
-        if (pDelogoParam->posX || pDelogoParam->posY) {
-            str += strsprintf(", pos=%d:%d", pDelogoParam->posX, pDelogoParam->posY);
+    }
+
+    //フィルタ情報の調整
+    std::string str = "";
+    switch (pDelogoParam->mode) {
+    case DELOGO_MODE_ADD:
+        str += ", add";
+        break;
+    case DELOGO_MODE_REMOVE:
+    default:
+        break;
+    }
+    if (pDelogoParam->posX || pDelogoParam->posY) {
+        str += strsprintf(", pos=%d:%d", pDelogoParam->posX, pDelogoParam->posY);
+    }
+    if (pDelogoParam->depth != FILTER_DEFAULT_DELOGO_DEPTH) {
+        str += strsprintf(", dpth=%d", pDelogoParam->depth);
+    }
+    if (pDelogoParam->Y || pDelogoParam->Cb || pDelogoParam->Cr) {
+        str += strsprintf(", YCbCr=%d:%d:%d", pDelogoParam->Y, pDelogoParam->Cb, pDelogoParam->Cr);
+    }
+    if (pDelogoParam->autoFade) {
+        str += ", auto_fade";
+    }
+    m_sFilterInfo = char_to_tstring("delogo: " + std::string(logoData.header.name) + str);
+
+    //ロゴの有無・フェードの推定
+    m_pFadeEstimator.reset();
+    if (pDelogoParam->autoFade || pDelogoParam->logPath) {
+        const int estimateWidth  = (std::min)(m_sProcessData[LOGO__Y].i_start + m_sProcessData[LOGO__Y].width, frameWidth) - m_sProcessData[LOGO__Y].i_start;
+        const int estimateHeight = m_sProcessData[LOGO__Y].height;
+        m_pFadeEstimator.reset(new DelogoFadeEstimator());
+        if (m_pFadeEstimator->init(m_sProcessData[LOGO__Y].pLogoPtr.get(), m_sProcessData[LOGO__Y].width, estimateWidth, estimateHeight,
+            pDelogoParam->depth, RGY_CSP_BIT_DEPTH[pDelogoParam->frameIn.csp])) {
+            AddMessage(RGY_LOG_ERROR, _T("failed to init logo fade estimation, logo has no edge.\n"));
+            return NV_ENC_ERR_INVALID_PARAM;
         }
-        if (pDelogoParam->depth != FILTER_DEFAULT_DELOGO_DEPTH) {
-            str += strsprintf(", dpth=%d", pDelogoParam->depth);
+        m_fadeEstimateBuf.resize(estimateWidth * estimateHeight * ((RGY_CSP_BIT_DEPTH[pDelogoParam->frameIn.csp] > 8) ? 2 : 1));
+        AddMessage(RGY_LOG_DEBUG, _T("logo fade estimation: %dx%d, %d samples.\n"), estimateWidth, estimateHeight, m_pFadeEstimator->sampleCount());
+    }
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NVEncFilterDelogo::initAutoSelect(const std::shared_ptr<NVEncFilterParamDelogo> pDelogoParam) {
+    const int frameWidth  = pDelogoParam->frameIn.width;
+    const int frameHeight = pDelogoParam->frameIn.height;
+    const int bitDepth = RGY_CSP_BIT_DEPTH[pDelogoParam->frameIn.csp];
+    const short posX = pDelogoParam->posX;
+    const short posY = pDelogoParam->posY;
+    m_pAutoSelect.reset(new DelogoAutoSelector());
+    //候補のピクセルデータは最初の評価時に読み込み、initLogoと同じく位置オフセットを反映する
+    m_pAutoSelect->init([this, posX, posY](int logoIdx, LogoData *pLogoData) {
+        return loadLogoData(logoIdx, posX, posY, pLogoData);
+    }, pDelogoParam->depth, frameWidth, frameHeight, bitDepth);
+    for (int i = 0; i < (int)m_sLogoDataList.size(); i++) {
+        //フレームに収まらないロゴは候補にしない
+        m_pAutoSelect->add(i, m_sLogoDataList[i].header);
+    }
+    if (m_pAutoSelect->candidates() == 0) {
+        AddMessage(RGY_LOG_ERROR, _T("no logo in \"%s\" fits in frame size %dx%d.\n"), pDelogoParam->logoFilePath, frameWidth, frameHeight);
+        return NV_ENC_ERR_INVALID_PARAM;
+    }
+    m_autoSelectBuf.resize(frameWidth * frameHeight * ((bitDepth > 8) ? 2 : 1));
+    m_nLogoIdx = -1;
+    m_sFilterInfo = strsprintf(_T("delogo: auto select from %d logos, %d frames"), m_pAutoSelect->candidates(), pDelogoParam->autoSelectFrames);
+    AddMessage(RGY_LOG_DEBUG, _T("auto select: %d candidates from %d logos.\n"), m_pAutoSelect->candidates(), (int)m_sLogoDataList.size());
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NVEncFilterDelogo::runAutoSelect(const FrameInfo *pFrame) {
+    NVENCSTATUS sts = NV_ENC_SUCCESS;
+    auto pDelogoParam = std::dynamic_pointer_cast<NVEncFilterParamDelogo>(m_pParam);
+    //輝度をCPUに転送して、全候補を評価する
+    const int pixelSize = (RGY_CSP_BIT_DEPTH[pFrame->csp] > 8) ? 2 : 1;
+    auto cudaerr = cudaMemcpy2D(m_autoSelectBuf.data(), pFrame->width * pixelSize, pFrame->ptr, pFrame->pitch,
+        pFrame->width * pixelSize, pFrame->height, cudaMemcpyDeviceToHost);
+    if (cudaerr != cudaSuccess) {
+        AddMessage(RGY_LOG_ERROR, _T("error at cudaMemcpy2D(%s) for logo auto select: %s.\n"),
+            getCudaMemcpyKindStr(cudaMemcpyDeviceToHost),
+            char_to_tstring(cudaGetErrorString(cudaerr)).c_str());
+        return NV_ENC_ERR_INVALID_CALL;
+    }
+    m_pAutoSelect->score(m_autoSelectBuf.data(), pFrame->width * pixelSize);
+
+    float score = 0.0f;
+    const int leader = m_pAutoSelect->leader(&score);
+    //選択が確定するまでは、暫定の最有力候補でロゴ除去を行う
+    if (leader >= 0 && score >= DELOGO_AUTO_SELECT_MIN_SCORE && leader != m_nLogoIdx) {
+        AddMessage(RGY_LOG_DEBUG, _T("auto select: frame %d, leader \"%s\" (score %.3f).\n"),
+            m_pAutoSelect->frames(), char_to_tstring(m_sLogoDataList[leader].header.name).c_str(), score);
+        if (NV_ENC_SUCCESS != (sts = initLogo(pDelogoParam, leader))) {
+            return sts;
         }
-        if (pDelogoParam->Y || pDelogoParam->Cb || pDelogoParam->Cr) {
-            str += strsprintf(", YCbCr=%d:%d:%d", pDelogoParam->Y, pDelogoParam->Cb, pDelogoParam->Cr);
+    }
+    if (m_pAutoSelect->frames() >= pDelogoParam->autoSelectFrames) {
+        if (m_nLogoIdx >= 0) {
+            AddMessage(RGY_LOG_INFO, _T("auto selected logo \"%s\" (score %.3f) from %d logos.\n"),
+                char_to_tstring(m_sLogoDataList[m_nLogoIdx].header.name).c_str(), score, m_pAutoSelect->candidates());
+            m_pAutoSelect.reset();
+            m_autoSelectBuf.clear();
+        } else if (m_pAutoSelect->frames() >= pDelogoParam->autoSelectFrames * DELOGO_AUTO_SELECT_MAX_FRAMES_MUL) {
+            AddMessage(RGY_LOG_WARN, _T("could not find logo in %d frames by auto select, delogo disabled.\n"), m_pAutoSelect->frames());
+            m_pAutoSelect.reset();
+            m_autoSelectBuf.clear();
         }
-        m_sFilterInfo = char_to_tstring("delogo: " + std::string(logoData.header.name) + str);
     }
-
-    m_pParam = pDelogoParam;
     return sts;
 }
 
+NVENCSTATUS NVEncFilterDelogo::estimateFade(const FrameInfo *pFrame, DelogoFadeEstimate *pEstimate) {
+    //ロゴの領域の輝度をCPUに転送して推定する
+    const int pixelSize = (RGY_CSP_BIT_DEPTH[pFrame->csp] > 8) ? 2 : 1;
+    const int estimateWidth  = (std::min)(m_sProcessData[LOGO__Y].i_start + m_sProcessData[LOGO__Y].width, pFrame->width) - m_sProcessData[LOGO__Y].i_start;
+    const int estimateHeight = m_sProcessData[LOGO__Y].height;
+    const uint8_t *src = pFrame->ptr + m_sProcessData[LOGO__Y].j_start * pFrame->pitch + m_sProcessData[LOGO__Y].i_start * pixelSize;
+    auto cudaerr = cudaMemcpy2D(m_fadeEstimateBuf.data(), estimateWidth * pixelSize, src, pFrame->pitch,
+        estimateWidth * pixelSize, estimateHeight, cudaMemcpyDeviceToHost);
+    if (cudaerr != cudaSuccess) {
+        AddMessage(RGY_LOG_ERROR, _T("error at cudaMemcpy2D(%s) for logo fade estimation: %s.\n"),
+            getCudaMemcpyKindStr(cudaMemcpyDeviceToHost),
+            char_to_tstring(cudaGetErrorString(cudaerr)).c_str());
+        return NV_ENC_ERR_INVALID_CALL;
+    }
+    *pEstimate = m_pFadeEstimator->estimate(m_fadeEstimateBuf.data(), estimateWidth * pixelSize);
+    return NV_ENC_SUCCESS;
+}
+
 NVENCSTATUS NVEncFilterDelogo::run_filter(const FrameInfo *pInputFrame, FrameInfo **ppOutputFrames, int *pOutputFrameNum) {
     NVENCSTATUS sts = NV_ENC_SUCCESS;
 
@@ -639,6 +850,39 @@ NVENCSTATUS NVEncFilterDelogo::run_filter(const FrameInfo *pInputFrame, FrameInf
         return NV_ENC_ERR_UNSUPPORTED_PARAM;
     }
 
+    const int frameIdx = m_nFrameIdx++;
+    if (m_pAutoSelect) {
+        if (NV_ENC_SUCCESS != (sts = runAutoSelect(ppOutputFrames[0]))) {
+            return sts;
+        }
+    }
+    //ロゴが選択されていなければ何もしない
+    if (m_nLogoIdx < 0) {
+        return sts;
+    }
+
+    if (m_pFadeEstimator) {
+        auto pDelogoParam = std::dynamic_pointer_cast<NVEncFilterParamDelogo>(m_pParam);
+        DelogoFadeEstimate estimate = { 0 };
+        if (NV_ENC_SUCCESS != (sts = estimateFade(ppOutputFrames[0], &estimate))) {
+            return sts;
+        }
+        const bool process = !pDelogoParam->autoFade || estimate.fade > 0;
+        if (m_fpLog) {
+            fprintf(m_fpLog.get(), "%d,%d,%d,%d,%.2f,%.2f,%.2f,%d\n", frameIdx, estimate.fade, estimate.estimated, estimate.reliable ? 1 : 0,
+                estimate.edgeNone, estimate.edgeFull, estimate.edgeBest, process ? 1 : 0);
+        }
+        //ロゴがないと判定されたフレームは処理しない
+        if (!process) {
+            return sts;
+        }
+        if (pDelogoParam->autoFade) {
+            for (uint32_t i = 0; i < _countof(m_sProcessData); i++) {
+                m_sProcessData[i].fade = estimate.fade;
+            }
+        }
+    }
+
     if (NV_ENC_SUCCESS != (sts = delogoY(ppOutputFrames[0]))) {
         return sts;
     }
@@ -651,7 +895,14 @@ NVENCSTATUS NVEncFilterDelogo::run_filter(const FrameInfo *pInputFrame, FrameInf
 }
 
 void NVEncFilterDelogo::close() {
+    m_pFadeEstimator.reset();
+    m_fadeEstimateBuf.clear();
+    m_fpLog.reset();
+    m_pAutoSelect.reset();
+    m_autoSelectBuf.clear();
     m_LogoFilePath.clear();
+    m_LogoNameIdx.clear();
+    m_LogoFile.close();
     m_pFrameBuf.clear();
     m_sLogoDataList.clear();
 }
@@ -28,7 +28,11 @@
 
 #pragma once
 
+#include <unordered_map>
+#include <mutex>
+#include <functional>
 #include "NVEncFilter.h"
+#include "rgy_thread_pool.h"
 #include "logo.h"
 #include "NVEncParam.h"
 
@@ -64,6 +68,7 @@ enum {
 typedef struct LogoData {
     LOGO_HEADER header;
     vector<LOGO_PIXEL> logoPixel;
+    size_t pixelOffset; //ロゴファイル内のピクセルデータの位置
 } LogoData;
 
 typedef struct LOGO_SELECT_KEY {
@@ -71,6 +76,110 @@ typedef struct LOGO_SELECT_KEY {
     char logoname[LOGO_MAX_NAME];
 } LOGO_SELECT_KEY;
 
+//ロゴファイルから必要な部分のみ読み込む
+//ロゴパックの全ロゴのピクセルデータを読み込まず、使用するロゴのみ取り出す
+class LogoFileReader {
+public:
+    LogoFileReader();
+    ~LogoFileReader();
+    int open(const TCHAR *filename);
+    void close();
+    //offsetからsizeバイトを読み込む (複数スレッドから呼び出し可)
+    int read(void *buf, size_t offset, size_t size);
+    size_t size() const {
+        return m_nSize;
+    }
+protected:
+    unique_ptr<FILE, fp_deleter> m_fp;
+    std::mutex m_mtx;
+    size_t m_nSize;
+};
+
+//ロゴの有無・フェード値の推定 (CPU)
+//ロゴのαマップのエッジ部分について、候補となるフェード値でロゴ除去した結果のエッジ量を求め、
+//ロゴの輪郭が最も残らないフェード値を推定値とする
+struct DelogoFadeEstimate {
+    int   fade;      //適用するフェード値 (0 - LOGO_FADE_MAX, 0ならロゴなし)
+    int   estimated; //今回のフレームで推定したフェード値
+    float edgeNone;  //ロゴなし(fade=0)とした場合の1サンプルあたりのエッジ量
+    float edgeFull;  //ロゴあり(fade=LOGO_FADE_MAX)とした場合の1サンプルあたりのエッジ量
+    float edgeBest;  //推定したフェード値でのエッジ量
+    bool  reliable;  //推定が有効か (無効な場合は前回の値を使用)
+};
+
+class DelogoFadeEstimator {
+public:
+    DelogoFadeEstimator();
+    ~DelogoFadeEstimator();
+    //pLogo : int16_t x2 (dp, y) の輝度のロゴデータ (1行あたりlogoPitch画素)
+    //width x height: フレーム内に収まるロゴの領域
+    int init(const int16_t *pLogo, int logoPitch, int width, int height, int depth, int bitDepth);
+    //pFrame: ロゴの領域を切り出した輝度データ (width x height, bitDepth > 8なら16bit)
+    DelogoFadeEstimate estimate(const void *pFrame, int pitch);
+    int sampleCount() const {
+        return (int)m_sample.size();
+    }
+protected:
+    struct Sample {
+        int   idx0, idx1; //エッジをはさむ2画素の位置
+        float alpha0, logo0;
+        float alpha1, logo1;
+    };
+    float edge(int fade) const;
+
+    int m_nBitDepth;
+    int m_nWidth;
+    int m_nHeight;
+    int m_nPrevFade;
+    std::vector<Sample> m_sample;
+    std::vector<float> m_yc48; //フレームの輝度 (yc48)
+};
+
+//フレームの内容から、ロゴパック内のロゴを自動選択する (CPU)
+//各候補のロゴについてDelogoFadeEstimatorでロゴの存在度合いを求め、複数フレームで累積した値が最大のものを選択する
+class DelogoAutoSelector {
+public:
+    //候補のロゴデータ (位置調整済み) を読み込む関数、失敗したら0以外を返す
+    typedef std::function<int(int logoIdx, LogoData *pLogoData)> LogoLoader;
+
+    DelogoAutoSelector();
+    ~DelogoAutoSelector();
+    void init(LogoLoader loader, int depth, int frameWidth, int frameHeight, int bitDepth);
+    //候補を追加する (フレームに収まらないロゴは追加しない)
+    //ピクセルデータはここでは読まず、最初のscoreで候補ごとに並列に読み込む
+    int add(int logoIdx, const LOGO_HEADER& header);
+    //輝度のフレームデータで全候補を並列に評価する
+    void score(const void *pFrame, int pitch);
+    //最もスコアの高い候補のロゴのインデックスを返す
+    int leader(float *pMeanScore) const;
+    int candidates() const {
+        return (int)m_candidate.size();
+    }
+    int frames() const {
+        return m_nFrames;
+    }
+protected:
+    struct Candidate {
+        int logoIdx;
+        int x, y; //フレーム内のロゴの位置 (位置調整後)
+        bool loaded;
+        unique_ptr<DelogoFadeEstimator> estimator; //読み込みに失敗した候補はnullptr
+        double score;
+    };
+    bool fits(const LOGO_HEADER& header) const;
+    void load(Candidate& candidate);
+
+    vector<Candidate> m_candidate;
+    LogoLoader m_loader;
+    RGYThreadPool m_pool;
+    int m_nDepth;
+    int m_nFrameWidth;
+    int m_nFrameHeight;
+    int m_nBitDepth;
+    int m_nPixelSize;
+    int m_nFrames;
+};
+
 class NVEncFilterParamDelogo : public NVEncFilterParam {
 public:
     const TCHAR *inputFileName; //入力ファイル名
@@ -80,9 +189,12 @@ public:
     short depth;      //透明度深度
     short Y, Cb, Cr;  //(輝度・色差)オフセット
     int mode;
+    bool autoFade;        //ロゴの有無・フェードを自動推定する
+    const TCHAR *logPath; //ロゴ検出結果のログ
+    int autoSelectFrames; //フレームの内容からロゴを自動選択する際に評価するフレーム数 (0で無効)
 
     NVEncFilterParamDelogo() : inputFileName(nullptr), logoFilePath(nullptr), logoSelect(nullptr),
-        posX(0), posY(0), depth(128), Y(0), Cb(0), Cr(0), mode(DELOGO_MODE_REMOVE) {
+        posX(0), posY(0), depth(128), Y(0), Cb(0), Cr(0), mode(DELOGO_MODE_REMOVE), autoFade(false), logPath(nullptr), autoSelectFrames(0) {
 
     };
     virtual ~NVEncFilterParamDelogo() {};
@@ -101,12 +213,26 @@ protected:
     int getLogoIdx(const std::string& logoName);
     int selectLogo(const TCHAR *selectStr, const TCHAR *inputFilename);
     std::string logoNameList();
+    int loadLogoData(int logoIdx, LogoData *pLogoData);
+    int loadLogoData(int logoIdx, short posX, short posY, LogoData *pLogoData);
+    NVENCSTATUS initLogo(const std::shared_ptr<NVEncFilterParamDelogo> pDelogoParam, int logoIdx);
+    NVENCSTATUS initAutoSelect(const std::shared_ptr<NVEncFilterParamDelogo> pDelogoParam);
+    NVENCSTATUS runAutoSelect(const FrameInfo *pFrame);
 
     NVENCSTATUS delogoY(FrameInfo *pFrame);
     NVENCSTATUS delogoUV(FrameInfo *pFrame);
+    NVENCSTATUS estimateFade(const FrameInfo *pFrame, DelogoFadeEstimate *pEstimate);
 
     tstring m_LogoFilePath;
     int m_nLogoIdx;
-    vector<LogoData> m_sLogoDataList;
+    LogoFileReader m_LogoFile;
+    vector<LogoData> m_sLogoDataList; //ヘッダのみ (ピクセルデータはloadLogoDataで取り出す)
+    std::unordered_map<std::string, int> m_LogoNameIdx;
+    unique_ptr<DelogoAutoSelector> m_pAutoSelect;
+    vector<uint8_t> m_autoSelectBuf; //自動選択用に輝度をCPUに転送するバッファ
     ProcessDataDelogo m_sProcessData[4];
+    unique_ptr<DelogoFadeEstimator> m_pFadeEstimator;
+    vector<uint8_t> m_fadeEstimateBuf; //推定用にロゴの領域をCPUに転送するバッファ
+    unique_ptr<FILE, fp_deleter> m_fpLog;
+    int m_nFrameIdx;
 };
@@ -0,0 +1,295 @@
+﻿// -----------------------------------------------------------------------------------------
+// NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+//
+// The MIT License
+//
+// Copyright (c) 2014-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// ------------------------------------------------------------------------------------------
+
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include "NVEncFilterDelogo.h"
+
+//推定に使用するサンプル数の上限
+static const int DELOGO_FADE_MAX_SAMPLE = 16384;
+//エッジとみなすαの差
+static const float DELOGO_FADE_EDGE_ALPHA_DIFF = 0.04f;
+//推定値でのエッジ量の減少がこの割合に満たない場合は推定不能とする
+static const float DELOGO_FADE_MIN_CONTRAST = 0.15f;
+//エッジ量がこの値(yc48)に満たない場合は推定不能とする
+static const float DELOGO_FADE_MIN_EDGE = 8.0f;
+//フェード値の探索間隔
+static const int DELOGO_FADE_COARSE_STEP = 16;
+static const int DELOGO_FADE_FINE_STEP = 2;
+//自動選択で1スレッドあたりに割り当てる最小の候補数
+static const int DELOGO_AUTO_SELECT_MIN_CANDIDATES_PER_THREAD = 4;
+
+DelogoFadeEstimator::DelogoFadeEstimator() :
+    m_nBitDepth(8),
+    m_nWidth(0),
+    m_nHeight(0),
+    m_nPrevFade(LOGO_FADE_MAX),
+    m_sample(),
+    m_yc48() {
+}
+
+DelogoFadeEstimator::~DelogoFadeEstimator() {
+    m_sample.clear();
+    m_yc48.clear();
+}
+
+int DelogoFadeEstimator::init(const int16_t *pLogo, int logoPitch, int width, int height, int depth, int bitDepth) {
+    m_nBitDepth = bitDepth;
+    m_nWidth = width;
+    m_nHeight = height;
+    m_nPrevFade = LOGO_FADE_MAX;
+    m_sample.clear();
+    m_yc48.resize((size_t)width * height);
+
+    //fade=LOGO_FADE_MAXの時のα (0 - 1)
+    auto alpha = [&](int x, int y) {
+        const float dp = (float)pLogo[(y * logoPitch + x) * 2 + 0] * (float)depth * (1.0f / 128.0f);
+        return (std::min)(dp, (float)(LOGO_MAX_DP - 1)) * (1.0f / (float)LOGO_MAX_DP);
+    };
+    auto logo = [&](int x, int y) {
+        return (float)pLogo[(y * logoPitch + x) * 2 + 1];
+    };
+    //ロゴの輪郭 (αが大きく変化する隣接画素の組) をサンプルとする
+    std::vector<Sample> sample;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const float a0 = alpha(x, y);
+            if (x + 1 < width && std::abs(a0 - alpha(x + 1, y)) >= DELOGO_FADE_EDGE_ALPHA_DIFF) {
+                sample.push_back({ y * width + x, y * width + x + 1, a0, logo(x, y), alpha(x + 1, y), logo(x + 1, y) });
+            }
+            if (y + 1 < height && std::abs(a0 - alpha(x, y + 1)) >= DELOGO_FADE_EDGE_ALPHA_DIFF) {
+                sample.push_back({ y * width + x, (y + 1) * width + x, a0, logo(x, y), alpha(x, y + 1), logo(x, y + 1) });
+            }
+        }
+    }
+    if (sample.size() == 0) {
+        return 1;
+    }
+    //サンプル数が多すぎる場合は間引く
+    const size_t step = (sample.size() + DELOGO_FADE_MAX_SAMPLE - 1) / DELOGO_FADE_MAX_SAMPLE;
+    for (size_t i = 0; i < sample.size(); i += step) {
+        m_sample.push_back(sample[i]);
+    }
+    return 0;
+}
+
+float DelogoFadeEstimator::edge(int fade) const {
+    const float f = (float)fade * (1.0f / (float)LOGO_FADE_MAX);
+    const float *yc48 = m_yc48.data();
+    float sum = 0.0f;
+    for (const auto& s : m_sample) {
+        const float a0 = s.alpha0 * f;
+        const float a1 = s.alpha1 * f;
+        //ロゴ除去後の値
+        const float r0 = (yc48[s.idx0] - s.logo0 * a0) / (1.0f - a0);
+        const float r1 = (yc48[s.idx1] - s.logo1 * a1) / (1.0f - a1);
+        //ロゴ除去で背景のノイズも増幅されるので、その分を割り引いて評価する
+        sum += std::abs(r0 - r1) * (1.0f - 0.5f * (a0 + a1));
+    }
+    return sum / (float)m_sample.size();
+}
+
+DelogoFadeEstimate DelogoFadeEstimator::estimate(const void *pFrame, int pitch) {
+    //nv12->yc48
+    const float nv12_2_yc48_mul = 1197.0f / (float)(1 << (m_nBitDepth - 2));
+    const float nv12_2_yc48_sub = 299.0f;
+    for (int y = 0; y < m_nHeight; y++) {
+        float *dst = m_yc48.data() + y * m_nWidth;
+        if (m_nBitDepth > 8) {
+            const uint16_t *src = (const uint16_t *)((const uint8_t *)pFrame + y * pitch);
+            for (int x = 0; x < m_nWidth; x++) {
+                dst[x] = (float)src[x] * nv12_2_yc48_mul - nv12_2_yc48_sub;
+            }
+        } else {
+            const uint8_t *src = (const uint8_t *)pFrame + y * pitch;
+            for (int x = 0; x < m_nWidth; x++) {
+                dst[x] = (float)src[x] * nv12_2_yc48_mul - nv12_2_yc48_sub;
+            }
+        }
+    }
+
+    DelogoFadeEstimate result = { 0 };
+    result.edgeNone = edge(0);
+    result.edgeFull = edge(LOGO_FADE_MAX);
+
+    //粗く探索したのち、その周辺を細かく探索する
+    int bestFade = 0;
+    float bestEdge = result.edgeNone;
+    for (int fade = DELOGO_FADE_COARSE_STEP; fade <= LOGO_FADE_MAX; fade += DELOGO_FADE_COARSE_STEP) {
+        const float e = (fade == LOGO_FADE_MAX) ? result.edgeFull : edge(fade);
+        if (e < bestEdge) {
+            bestEdge = e;
+            bestFade = fade;
+        }
+    }
+    const int fineMin = (std::max)(bestFade - DELOGO_FADE_COARSE_STEP + DELOGO_FADE_FINE_STEP, 0);
+    const int fineMax = (std::min)(bestFade + DELOGO_FADE_COARSE_STEP - DELOGO_FADE_FINE_STEP, LOGO_FADE_MAX);
+    for (int fade = fineMin; fade <= fineMax; fade += DELOGO_FADE_FINE_STEP) {
+        if (fade % DELOGO_FADE_COARSE_STEP == 0) continue;
+        const float e = edge(fade);
+        if (e < bestEdge) {
+            bestEdge = e;
+            bestFade = fade;
+        }
+    }
+    //ほぼ0/ほぼ最大なら丸める
+    if (bestFade < LOGO_FADE_MAX / 16) {
+        bestFade = 0;
+    } else if (bestFade > LOGO_FADE_MAX - LOGO_FADE_MAX / 16) {
+        bestFade = LOGO_FADE_MAX;
+    }
+    result.estimated = bestFade;
+    result.edgeBest = bestEdge;
+
+    //どのフェード値でもエッジ量に差がない場合 (背景が複雑・ロゴが背景に埋もれている等) は推定できない
+    const float edgeMax = (std::max)(result.edgeNone, result.edgeFull);
+    result.reliable = edgeMax >= DELOGO_FADE_MIN_EDGE
+        && edgeMax - bestEdge >= edgeMax * DELOGO_FADE_MIN_CONTRAST;
+    if (result.reliable) {
+        m_nPrevFade = bestFade;
+    }
+    result.fade = m_nPrevFade;
+    return result;
+}
+
+DelogoAutoSelector::DelogoAutoSelector() :
+    m_candidate(),
+    m_loader(),
+    m_pool(),
+    m_nDepth(128),
+    m_nFrameWidth(0),
+    m_nFrameHeight(0),
+    m_nBitDepth(8),
+    m_nPixelSize(1),
+    m_nFrames(0) {
+}
+
+DelogoAutoSelector::~DelogoAutoSelector() {
+    m_pool.close();
+    m_candidate.clear();
+}
+
+void DelogoAutoSelector::init(LogoLoader loader, int depth, int frameWidth, int frameHeight, int bitDepth) {
+    m_loader = loader;
+    m_nDepth = depth;
+    m_nFrameWidth = frameWidth;
+    m_nFrameHeight = frameHeight;
+    m_nBitDepth = bitDepth;
+    m_nPixelSize = (bitDepth > 8) ? 2 : 1;
+    m_nFrames = 0;
+    m_candidate.clear();
+    m_pool.close();
+}
+
+bool DelogoAutoSelector::fits(const LOGO_HEADER& header) const {
+    return header.x >= 0 && header.y >= 0 && header.x < m_nFrameWidth && header.y < m_nFrameHeight && header.w > 0 && header.h > 0;
+}
+
+int DelogoAutoSelector::add(int logoIdx, const LOGO_HEADER& header) {
+    //位置オフセットの反映前のヘッダで判定し、反映後の位置はloadで再度確認する
+    if (!fits(header)) {
+        return 1;
+    }
+    Candidate candidate;
+    candidate.logoIdx = logoIdx;
+    candidate.x = header.x;
+    candidate.y = header.y;
+    candidate.loaded = false;
+    candidate.score = 0.0;
+    m_candidate.push_back(std::move(candidate));
+    return 0;
+}
+
+void DelogoAutoSelector::load(Candidate& candidate) {
+    candidate.loaded = true;
+    LogoData logoData;
+    if (m_loader(candidate.logoIdx, &logoData)) {
+        return;
+    }
+    const auto& header = logoData.header;
+    if (!fits(header)) {
+        return;
+    }
+    //輝度の(dp, y)のみ取り出す
+    std::vector<int16_t> logoY(header.w * header.h * 2);
+    for (int i = 0; i < header.w * header.h; i++) {
+        logoY[i * 2 + 0] = logoData.logoPixel[i].dp_y;
+        logoY[i * 2 + 1] = logoData.logoPixel[i].y;
+    }
+    const int width  = (std::min)(header.x + header.w, m_nFrameWidth) - header.x;
+    const int height = (std::min)(header.y + header.h, m_nFrameHeight) - header.y;
+    std::unique_ptr<DelogoFadeEstimator> estimator(new DelogoFadeEstimator());
+    if (estimator->init(logoY.data(), header.w, width, height, m_nDepth, m_nBitDepth)) {
+        return;
+    }
+    candidate.x = header.x;
+    candidate.y = header.y;
+    candidate.estimator = std::move(estimator);
+}
+
+void DelogoAutoSelector::score(const void *pFrame, int pitch) {
+    const int nCandidates = (int)m_candidate.size();
+    if (m_nFrames == 0) {
+        const int nThreads = (std::min)((int)(std::max)(std::thread::hardware_concurrency(), 1u),
+            (nCandidates + DELOGO_AUTO_SELECT_MIN_CANDIDATES_PER_THREAD - 1) / DELOGO_AUTO_SELECT_MIN_CANDIDATES_PER_THREAD);
+        m_pool.init(nThreads);
+    }
+    //候補ごとに処理量が異なるので、候補単位で空いたスレッドに割り当てる
+    m_pool.run(nCandidates, [&](int i) {
+        auto& candidate = m_candidate[i];
+        if (!candidate.loaded) {
+            load(candidate);
+        }
+        if (!candidate.estimator) {
+            return;
+        }
+        const auto estimate = candidate.estimator->estimate((const uint8_t *)pFrame + candidate.y * pitch + candidate.x * m_nPixelSize, pitch);
+        //ロゴ除去により、ロゴの輪郭のエッジがどれだけ減ったかをスコアとする
+        //誤ったロゴの場合は、ロゴ除去でエッジが増えるため推定値は0となり、スコアも0となる
+        if (estimate.reliable && estimate.estimated > 0 && estimate.edgeNone > 0.0f) {
+            candidate.score += (std::max)(estimate.edgeNone - estimate.edgeBest, 0.0f) / estimate.edgeNone;
+        }
+    });
+    m_nFrames++;
+}
+
+int DelogoAutoSelector::leader(float *pMeanScore) const {
+    int logoIdx = LOGO_AUTO_SELECT_NOHIT;
+    double maxScore = 0.0;
+    for (const auto& candidate : m_candidate) {
+        if (candidate.score > maxScore) {
+            maxScore = candidate.score;
+            logoIdx = candidate.logoIdx;
+        }
+    }
+    if (pMeanScore) {
+        *pMeanScore = (m_nFrames > 0) ? (float)(maxScore / m_nFrames) : 0.0f;
+    }
+    return logoIdx;
+}
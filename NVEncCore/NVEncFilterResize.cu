@@ -593,7 +593,7 @@ NVENCSTATUS NVEncFilterResize::resizeYUV444(FrameInfo *pOutputFrame, const Frame
 #endif
 }
 
-NVEncFilterResize::NVEncFilterResize() : m_bInterlacedWarn(false) {
+NVEncFilterResize::NVEncFilterResize() : m_bInterlacedWarn(false), m_weightSpline36(), m_resizeCpu(), m_cpuFrame(), m_cpuBuf() {
     m_sFilterName = _T("resize");
 }
 
@@ -689,7 +689,9 @@ NVENCSTATUS NVEncFilterResize::run_filter(const FrameInfo *pInputFrame, FrameInf
         AddMessage(RGY_LOG_ERROR, _T("Invalid parameter type.\n"));
         return NV_ENC_ERR_INVALID_PARAM;
     }
-    if (pResizeParam->interp <= NPPI_INTER_MAX) {
+    if (pResizeParam->interp >= RESIZE_CPU_BILINEAR) {
+        sts = resizeCpu(ppOutputFrames[0], pInputFrame);
+    } else if (pResizeParam->interp <= NPPI_INTER_MAX) {
         if (std::find(supportedCspYV12.begin(), supportedCspYV12.end(), m_pParam->frameIn.csp) != supportedCspYV12.end()) {
             sts = resizeYV12(ppOutputFrames[0], pInputFrame);
         } else if (std::find(supportedCspYUV444.begin(), supportedCspYUV444.end(), m_pParam->frameIn.csp) != supportedCspYUV444.end()) {
@@ -734,5 +736,8 @@ NVENCSTATUS NVEncFilterResize::run_filter(const FrameInfo *pInputFrame, FrameInf
 
 void NVEncFilterResize::close() {
     m_pFrameBuf.clear();
+    m_resizeCpu.reset();
+    m_cpuBuf[0].reset();
+    m_cpuBuf[1].reset();
     m_bInterlacedWarn = false;
 }
@@ -0,0 +1,609 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include <cmath>
+#include <map>
+#include <tuple>
+#include <algorithm>
+#include "rgy_simd.h"
+#include "NVEncFilterResizeCpu.h"
+#include "NVEncFilter.h"
+#include "NVEncParam.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+//avx2版 (NVEncFilterResizeCpu_avx2.cpp)
+void resize_cpu_filter_h_avx2(float *dst, const float *src, const RGYResizeCoef *coef);
+void resize_cpu_filter_v_avx2(float *dst, const float *const *src, const float *weight, int taps, int width);
+void resize_cpu_load8_avx2(float *dst, const uint8_t *src, int width);
+void resize_cpu_load16_avx2(float *dst, const uint16_t *src, int width);
+void resize_cpu_store8_avx2(uint8_t *dst, const float *src, int width);
+void resize_cpu_store16_avx2(uint16_t *dst, const float *src, int width, int max_val);
+
+//--- 係数の計算 -------------------------------------------------------------------------
+//フィルタの半径
+static double resize_cpu_radius(RGY_RESIZE_CPU algo) {
+    switch (algo) {
+    case RGY_RESIZE_CPU_BILINEAR: return 1.0;
+    case RGY_RESIZE_CPU_BICUBIC:  return 2.0;
+    case RGY_RESIZE_CPU_SPLINE16: return 2.0;
+    case RGY_RESIZE_CPU_SPLINE36: return 3.0;
+    case RGY_RESIZE_CPU_SPLINE64: return 4.0;
+    case RGY_RESIZE_CPU_LANCZOS2: return 2.0;
+    case RGY_RESIZE_CPU_LANCZOS3: return 3.0;
+    default: return 1.0;
+    }
+}
+
+//中心からの距離xでの重み
+static double resize_cpu_kernel(RGY_RESIZE_CPU algo, double x) {
+    x = std::abs(x);
+    switch (algo) {
+    case RGY_RESIZE_CPU_BILINEAR:
+        return (x < 1.0) ? 1.0 - x : 0.0;
+    case RGY_RESIZE_CPU_BICUBIC: {
+        //B = 0.0, C = 0.6
+        const double B = 0.0, C = 0.6;
+        if (x < 1.0) {
+            return ((12.0 - 9.0 * B - 6.0 * C) * x * x * x + (-18.0 + 12.0 * B + 6.0 * C) * x * x + (6.0 - 2.0 * B)) / 6.0;
+        } else if (x < 2.0) {
+            return ((-B - 6.0 * C) * x * x * x + (6.0 * B + 30.0 * C) * x * x + (-12.0 * B - 48.0 * C) * x + (8.0 * B + 24.0 * C)) / 6.0;
+        }
+        return 0.0;
+    }
+    case RGY_RESIZE_CPU_SPLINE16:
+        if (x < 1.0) {
+            return ((x - 9.0 / 5.0) * x - 1.0 / 5.0) * x + 1.0;
+        } else if (x < 2.0) {
+            x -= 1.0;
+            return ((-1.0 / 3.0 * x + 4.0 / 5.0) * x - 7.0 / 15.0) * x;
+        }
+        return 0.0;
+    case RGY_RESIZE_CPU_SPLINE36:
+        if (x < 1.0) {
+            return ((13.0 / 11.0 * x - 453.0 / 209.0) * x - 3.0 / 209.0) * x + 1.0;
+        } else if (x < 2.0) {
+            x -= 1.0;
+            return ((-6.0 / 11.0 * x + 270.0 / 209.0) * x - 156.0 / 209.0) * x;
+        } else if (x < 3.0) {
+            x -= 2.0;
+            return ((1.0 / 11.0 * x - 45.0 / 209.0) * x + 26.0 / 209.0) * x;
+        }
+        return 0.0;
+    case RGY_RESIZE_CPU_SPLINE64:
+        if (x < 1.0) {
+            return ((49.0 / 41.0 * x - 6387.0 / 2911.0) * x - 3.0 / 2911.0) * x + 1.0;
+        } else if (x < 2.0) {
+            x -= 1.0;
+            return ((-24.0 / 41.0 * x + 4032.0 / 2911.0) * x - 2328.0 / 2911.0) * x;
+        } else if (x < 3.0) {
+            x -= 2.0;
+            return ((6.0 / 41.0 * x - 1008.0 / 2911.0) * x + 582.0 / 2911.0) * x;
+        } else if (x < 4.0) {
+            x -= 3.0;
+            return ((-1.0 / 41.0 * x + 168.0 / 2911.0) * x - 97.0 / 2911.0) * x;
+        }
+        return 0.0;
+    case RGY_RESIZE_CPU_LANCZOS2:
+    case RGY_RESIZE_CPU_LANCZOS3: {
+        const double a = resize_cpu_radius(algo);
+        if (x < 1e-6) {
+            return 1.0;
+        } else if (x < a) {
+            const double px = M_PI * x;
+            return a * std::sin(px) * std::sin(px / a) / (px * px);
+        }
+        return 0.0;
+    }
+    default:
+        return 0.0;
+    }
+}
+
+static std::shared_ptr<RGYResizeCoef> resize_cpu_calc_coef(int srcSize, int dstSize, RGY_RESIZE_CPU algo) {
+    auto coef = std::make_shared<RGYResizeCoef>();
+    coef->srcSize = srcSize;
+    coef->dstSize = dstSize;
+    coef->algo = algo;
+    const double scale = srcSize / (double)dstSize;
+    //縮小時は、フィルタを縮小率に合わせて広げる
+    const double filterScale = (std::max)(1.0, scale);
+    const double support = resize_cpu_radius(algo) * filterScale;
+    const int taps = (std::min)((int)std::ceil(support * 2.0), srcSize);
+    coef->taps = taps;
+    coef->start.resize(dstSize);
+    coef->weight.resize((size_t)taps * dstSize, 0.0f);
+    std::vector<double> w(taps);
+    for (int x = 0; x < dstSize; x++) {
+        const double center = (x + 0.5) * scale - 0.5;
+        const int first = (int)std::floor(center - support) + 1;
+        //参照範囲が入力の範囲に収まるようにし、はみ出した分の重みは端の画素に畳み込む
+        const int start = (std::min)((std::max)(first, 0), srcSize - taps);
+        std::fill(w.begin(), w.end(), 0.0);
+        double sum = 0.0;
+        for (int i = first; i < first + (int)std::ceil(support * 2.0); i++) {
+            const double weight = resize_cpu_kernel(algo, (i - center) / filterScale);
+            const int pos = clamp(i, 0, srcSize - 1) - start;
+            if (0 <= pos && pos < taps) {
+                w[pos] += weight;
+                sum += weight;
+            }
+        }
+        coef->start[x] = start;
+        for (int t = 0; t < taps; t++) {
+            coef->weight[(size_t)t * dstSize + x] = (float)((sum != 0.0) ? w[t] / sum : ((t == 0) ? 1.0 : 0.0));
+        }
+    }
+    return coef;
+}
+
+std::shared_ptr<const RGYResizeCoef> resize_cpu_get_coef(int srcSize, int dstSize, RGY_RESIZE_CPU algo) {
+    static std::mutex mtx;
+    static std::map<std::tuple<int, int, int>, std::shared_ptr<const RGYResizeCoef>> cache;
+    const auto key = std::make_tuple(srcSize, dstSize, (int)algo);
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = cache.find(key);
+    if (it != cache.end()) {
+        return it->second;
+    }
+    auto coef = std::shared_ptr<const RGYResizeCoef>(resize_cpu_calc_coef(srcSize, dstSize, algo));
+    cache[key] = coef;
+    return coef;
+}
+
+//--- 各処理のC版 -----------------------------------------------------------------------
+void resize_cpu_filter_h_c(float *dst, const float *src, const RGYResizeCoef *coef) {
+    const int dstSize = coef->dstSize;
+    const int taps = coef->taps;
+    const int *start = coef->start.data();
+    const float *weight = coef->weight.data();
+    for (int x = 0; x < dstSize; x++) {
+        const float *ptrSrc = src + start[x];
+        float sum = 0.0f;
+        for (int t = 0; t < taps; t++) {
+            sum += weight[t * dstSize + x] * ptrSrc[t];
+        }
+        dst[x] = sum;
+    }
+}
+
+void resize_cpu_filter_v_c(float *dst, const float *const *src, const float *weight, int taps, int width) {
+    for (int x = 0; x < width; x++) {
+        float sum = 0.0f;
+        for (int t = 0; t < taps; t++) {
+            sum += weight[t] * src[t][x];
+        }
+        dst[x] = sum;
+    }
+}
+
+void resize_cpu_load8_c(float *dst, const uint8_t *src, int width) {
+    for (int x = 0; x < width; x++) {
+        dst[x] = (float)src[x];
+    }
+}
+
+void resize_cpu_load16_c(float *dst, const uint16_t *src, int width) {
+    for (int x = 0; x < width; x++) {
+        dst[x] = (float)src[x];
+    }
+}
+
+void resize_cpu_store8_c(uint8_t *dst, const float *src, int width) {
+    for (int x = 0; x < width; x++) {
+        dst[x] = (uint8_t)(clamp(src[x], 0.0f, 255.0f) + 0.5f);
+    }
+}
+
+void resize_cpu_store16_c(uint16_t *dst, const float *src, int width, int max_val) {
+    for (int x = 0; x < width; x++) {
+        dst[x] = (uint16_t)(clamp(src[x], 0.0f, (float)max_val) + 0.5f);
+    }
+}
+
+const resizeCpuFuncs *get_resize_cpu_funcs() {
+    static const resizeCpuFuncs FUNC_C = {
+        resize_cpu_filter_h_c,
+        resize_cpu_filter_v_c,
+        resize_cpu_load8_c,
+        resize_cpu_load16_c,
+        resize_cpu_store8_c,
+        resize_cpu_store16_c
+    };
+    static const resizeCpuFuncs FUNC_AVX2 = {
+        resize_cpu_filter_h_avx2,
+        resize_cpu_filter_v_avx2,
+        resize_cpu_load8_avx2,
+        resize_cpu_load16_avx2,
+        resize_cpu_store8_avx2,
+        resize_cpu_store16_avx2
+    };
+    return (get_availableSIMD() & AVX2) ? &FUNC_AVX2 : &FUNC_C;
+}
+
+//--- CPU版リサイズ ---------------------------------------------------------------------
+NVEncFilterResizeCpu::NVEncFilterResizeCpu() :
+    m_frameIn(),
+    m_frameOut(),
+    m_algo(RGY_RESIZE_CPU_SPLINE36),
+    m_planeIn(),
+    m_planeOut(),
+    m_coefH(),
+    m_coefV(),
+    m_pixelSize(1),
+    m_signed(false),
+    m_maxVal(255),
+    m_func(nullptr),
+    m_pool(),
+    m_bands(1),
+    m_bandBuf(),
+    m_pPrintMes() {
+}
+
+NVEncFilterResizeCpu::~NVEncFilterResizeCpu() {
+    close();
+}
+
+void NVEncFilterResizeCpu::AddMessage(int log_level, const TCHAR *format, ...) {
+    if (m_pPrintMes == nullptr || log_level < m_pPrintMes->getLogLevel()) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int len = _vsctprintf(format, args) + 1; // _vscprintf doesn't count terminating '\0'
+    tstring buffer;
+    buffer.resize(len, _T('\0'));
+    _vstprintf_s(&buffer[0], len, format, args);
+    va_end(args);
+
+    auto lines = split(buffer, _T("\n"));
+    for (const auto& line : lines) {
+        if (line[0] != _T('\0')) {
+            m_pPrintMes->write(log_level, (tstring(_T("resize(cpu): ")) + line + _T("\n")).c_str());
+        }
+    }
+}
+
+std::vector<NVEncFilterResizeCpu::ResizePlane> NVEncFilterResizeCpu::getPlanes(const FrameInfo& frame) {
+    const int w = frame.width, h = frame.height, pitch = frame.pitch;
+    const int px = (RGY_CSP_BIT_DEPTH[frame.csp] > 8) ? 2 : 1;
+    std::vector<ResizePlane> planes;
+    switch (frame.csp) {
+    case RGY_CSP_NV12:
+    case RGY_CSP_P010:
+        planes.push_back({ 0,                    1, w,      h      });
+        planes.push_back({ pitch * h,            2, w >> 1, h >> 1 });
+        planes.push_back({ pitch * h + px,       2, w >> 1, h >> 1 });
+        break;
+    case RGY_CSP_NV16:
+    case RGY_CSP_P210:
+        planes.push_back({ 0,                    1, w,      h });
+        planes.push_back({ pitch * h,            2, w >> 1, h });
+        planes.push_back({ pitch * h + px,       2, w >> 1, h });
+        break;
+    case RGY_CSP_YV12:
+    case RGY_CSP_YV12_09:
+    case RGY_CSP_YV12_10:
+    case RGY_CSP_YV12_12:
+    case RGY_CSP_YV12_14:
+    case RGY_CSP_YV12_16:
+        planes.push_back({ 0,                    1, w,      h      });
+        planes.push_back({ pitch * h,            1, w >> 1, h >> 1 });
+        planes.push_back({ pitch * h * 3 / 2,    1, w >> 1, h >> 1 });
+        break;
+    case RGY_CSP_YUV422:
+    case RGY_CSP_YUV422_09:
+    case RGY_CSP_YUV422_10:
+    case RGY_CSP_YUV422_12:
+    case RGY_CSP_YUV422_14:
+    case RGY_CSP_YUV422_16:
+        planes.push_back({ 0,                    1, w,      h });
+        planes.push_back({ pitch * h,            1, w >> 1, h });
+        planes.push_back({ pitch * h * 2,        1, w >> 1, h });
+        break;
+    case RGY_CSP_YUV444:
+    case RGY_CSP_YUV444_09:
+    case RGY_CSP_YUV444_10:
+    case RGY_CSP_YUV444_12:
+    case RGY_CSP_YUV444_14:
+    case RGY_CSP_YUV444_16:
+        planes.push_back({ 0,                    1, w, h });
+        planes.push_back({ pitch * h,            1, w, h });
+        planes.push_back({ pitch * h * 2,        1, w, h });
+        break;
+    case RGY_CSP_YUY2:
+        planes.push_back({ 0, 2, w,      h });
+        planes.push_back({ 1, 4, w >> 1, h });
+        planes.push_back({ 3, 4, w >> 1, h });
+        break;
+    case RGY_CSP_RGB24:
+    case RGY_CSP_RGB24R:
+        for (int i = 0; i < 3; i++) {
+            planes.push_back({ i, 3, w, h });
+        }
+        break;
+    case RGY_CSP_RGB32:
+    case RGY_CSP_RGB32R:
+        for (int i = 0; i < 4; i++) {
+            planes.push_back({ i, 4, w, h });
+        }
+        break;
+    case RGY_CSP_YC48:
+        for (int i = 0; i < 3; i++) {
+            planes.push_back({ i * 2, 3, w, h });
+        }
+        break;
+    default:
+        break;
+    }
+    return planes;
+}
+
+NVENCSTATUS NVEncFilterResizeCpu::init(const FrameInfo& frameIn, const FrameInfo& frameOut, RGY_RESIZE_CPU algo, int threads, shared_ptr<RGYLog> pPrintMes) {
+    close();
+    m_pPrintMes = pPrintMes;
+    if (frameIn.csp != frameOut.csp) {
+        AddMessage(RGY_LOG_ERROR, _T("csp does not match.\n"));
+        return NV_ENC_ERR_INVALID_PARAM;
+    }
+    if (frameIn.deivce_mem || frameOut.deivce_mem) {
+        AddMessage(RGY_LOG_ERROR, _T("only host memory is supported.\n"));
+        return NV_ENC_ERR_INVALID_PARAM;
+    }
+    m_frameIn = frameIn;
+    m_frameOut = frameOut;
+    m_algo = algo;
+    m_planeIn = getPlanes(frameIn);
+    m_planeOut = getPlanes(frameOut);
+    if (m_planeIn.size() == 0) {
+        AddMessage(RGY_LOG_ERROR, _T("unsupported csp: %s.\n"), RGY_CSP_NAMES[frameIn.csp]);
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+    }
+    m_signed = frameIn.csp == RGY_CSP_YC48;
+    m_pixelSize = (RGY_CSP_BIT_DEPTH[frameIn.csp] > 8) ? 2 : 1;
+    m_maxVal = (1 << RGY_CSP_BIT_DEPTH[frameIn.csp]) - 1;
+    m_func = get_resize_cpu_funcs();
+
+    //係数テーブルは、同じサイズの色成分同士やインスタンス間で共有される
+    int maxWidthIn = 0, maxWidthOut = 0;
+    for (size_t i = 0; i < m_planeIn.size(); i++) {
+        const auto& pin = m_planeIn[i];
+        const auto& pout = m_planeOut[i];
+        if (pin.width <= 0 || pin.height <= 0 || pout.width <= 0 || pout.height <= 0) {
+            AddMessage(RGY_LOG_ERROR, _T("Invalid resolution: %dx%d -> %dx%d.\n"), frameIn.width, frameIn.height, frameOut.width, frameOut.height);
+            return NV_ENC_ERR_INVALID_PARAM;
+        }
+        m_coefH.push_back(resize_cpu_get_coef(pin.width, pout.width, algo));
+        m_coefV.push_back(resize_cpu_get_coef(pin.height, pout.height, algo));
+        maxWidthIn = (std::max)(maxWidthIn, pin.width);
+        maxWidthOut = (std::max)(maxWidthOut, pout.width);
+    }
+
+    if (threads <= 0) {
+        threads = (int)std::thread::hardware_concurrency();
+    }
+    //1バンドあたり最低でも32行程度は確保する
+    threads = clamp(threads, 1, (std::max)(1, frameOut.height / 32));
+    m_pool.init(threads);
+    m_bands = m_pool.threads();
+    m_bandBuf.resize(m_bands);
+    for (auto& buf : m_bandBuf) {
+        //SIMD版では末尾を超えて読み書きすることがあるので、余裕をもって確保する
+        buf.srcRow.resize(maxWidthIn + 32, 0.0f);
+        buf.dstRow.resize(maxWidthOut + 32, 0.0f);
+    }
+    AddMessage(RGY_LOG_DEBUG, _T("initialized: %dx%d -> %dx%d, %s, %s, %d threads, %s.\n"),
+        frameIn.width, frameIn.height, frameOut.width, frameOut.height, RGY_CSP_NAMES[frameIn.csp],
+        get_chr_from_value(list_resize_cpu, algo), m_bands, (m_func->filter_h == resize_cpu_filter_h_c) ? _T("c") : _T("avx2"));
+    return NV_ENC_SUCCESS;
+}
+
+void NVEncFilterResizeCpu::loadRow(float *dst, const uint8_t *src, const ResizePlane& plane) const {
+    if (m_pixelSize == 1) {
+        if (plane.step == 1) {
+            m_func->load8(dst, src, plane.width);
+        } else {
+            for (int x = 0; x < plane.width; x++) {
+                dst[x] = (float)src[x * plane.step];
+            }
+        }
+    } else if (m_signed) {
+        const int16_t *ptr = (const int16_t *)src;
+        for (int x = 0; x < plane.width; x++) {
+            dst[x] = (float)ptr[x * plane.step];
+        }
+    } else {
+        const uint16_t *ptr = (const uint16_t *)src;
+        if (plane.step == 1) {
+            m_func->load16(dst, ptr, plane.width);
+        } else {
+            for (int x = 0; x < plane.width; x++) {
+                dst[x] = (float)ptr[x * plane.step];
+            }
+        }
+    }
+}
+
+void NVEncFilterResizeCpu::storeRow(uint8_t *dst, const float *src, const ResizePlane& plane) const {
+    if (m_pixelSize == 1) {
+        if (plane.step == 1) {
+            m_func->store8(dst, src, plane.width);
+        } else {
+            for (int x = 0; x < plane.width; x++) {
+                dst[x * plane.step] = (uint8_t)(clamp(src[x], 0.0f, 255.0f) + 0.5f);
+            }
+        }
+    } else if (m_signed) {
+        int16_t *ptr = (int16_t *)dst;
+        for (int x = 0; x < plane.width; x++) {
+            ptr[x * plane.step] = (int16_t)std::floor(clamp(src[x], -32768.0f, 32767.0f) + 0.5f);
+        }
+    } else {
+        uint16_t *ptr = (uint16_t *)dst;
+        if (plane.step == 1) {
+            m_func->store16(ptr, src, plane.width, m_maxVal);
+        } else {
+            for (int x = 0; x < plane.width; x++) {
+                ptr[x * plane.step] = (uint16_t)(clamp(src[x], 0.0f, (float)m_maxVal) + 0.5f);
+            }
+        }
+    }
+}
+
+void NVEncFilterResizeCpu::resizePlane(int band, const FrameInfo *pOutputFrame, const FrameInfo *pInputFrame, int iplane) {
+    const auto& pin = m_planeIn[iplane];
+    const auto& pout = m_planeOut[iplane];
+    const RGYResizeCoef *coefH = m_coefH[iplane].get();
+    const RGYResizeCoef *coefV = m_coefV[iplane].get();
+    const int y_start = pout.height * band / m_bands;
+    const int y_end = pout.height * (band + 1) / m_bands;
+    if (y_start >= y_end) {
+        return;
+    }
+    auto& buf = m_bandBuf[band];
+    //このbandで必要な入力の行 (startは単調増加)
+    const int taps = coefV->taps;
+    const int src_first = coefV->start[y_start];
+    const int src_end = coefV->start[y_end - 1] + taps;
+    const size_t rowSizeH = ALIGN(pout.width, 8) + 8;
+    if (buf.rowsH.size() < rowSizeH * (src_end - src_first)) {
+        buf.rowsH.resize(rowSizeH * (src_end - src_first));
+    }
+    //水平方向のフィルタ
+    const uint8_t *ptrSrc = pInputFrame->ptr + pin.offset;
+    for (int sy = src_first; sy < src_end; sy++) {
+        loadRow(buf.srcRow.data(), ptrSrc + (size_t)pInputFrame->pitch * sy, pin);
+        m_func->filter_h(buf.rowsH.data() + rowSizeH * (sy - src_first), buf.srcRow.data(), coefH);
+    }
+    //垂直方向のフィルタ
+    uint8_t *ptrDst = pOutputFrame->ptr + pout.offset;
+    std::vector<const float *> rows(taps);
+    std::vector<float> weight(taps);
+    for (int y = y_start; y < y_end; y++) {
+        for (int t = 0; t < taps; t++) {
+            rows[t] = buf.rowsH.data() + rowSizeH * (coefV->start[y] + t - src_first);
+            weight[t] = coefV->weight[(size_t)t * coefV->dstSize + y];
+        }
+        m_func->filter_v(buf.dstRow.data(), rows.data(), weight.data(), taps, pout.width);
+        storeRow(ptrDst + (size_t)pOutputFrame->pitch * y, buf.dstRow.data(), pout);
+    }
+}
+
+NVENCSTATUS NVEncFilterResizeCpu::resize(FrameInfo *pOutputFrame, const FrameInfo *pInputFrame) {
+    if (m_func == nullptr) {
+        AddMessage(RGY_LOG_ERROR, _T("not initialized.\n"));
+        return NV_ENC_ERR_INVALID_CALL;
+    }
+    if (pInputFrame->csp != m_frameIn.csp || pInputFrame->width != m_frameIn.width || pInputFrame->height != m_frameIn.height
+        || pOutputFrame->csp != m_frameOut.csp || pOutputFrame->width != m_frameOut.width || pOutputFrame->height != m_frameOut.height) {
+        AddMessage(RGY_LOG_ERROR, _T("frame info does not match.\n"));
+        return NV_ENC_ERR_INVALID_PARAM;
+    }
+    //pitchはフレームごとに異なってもよいので、色成分の位置はフレームから求める
+    const auto planeIn = getPlanes(*pInputFrame);
+    const auto planeOut = getPlanes(*pOutputFrame);
+    for (size_t i = 0; i < planeIn.size(); i++) {
+        m_planeIn[i].offset = planeIn[i].offset;
+        m_planeOut[i].offset = planeOut[i].offset;
+    }
+    for (int iplane = 0; iplane < (int)m_planeIn.size(); iplane++) {
+        m_pool.run(m_bands, [&](int band) {
+            resizePlane(band, pOutputFrame, pInputFrame, iplane);
+        });
+    }
+    pOutputFrame->picstruct = pInputFrame->picstruct;
+    pOutputFrame->timestamp = pInputFrame->timestamp;
+    pOutputFrame->duration  = pInputFrame->duration;
+    pOutputFrame->flags     = pInputFrame->flags;
+    return NV_ENC_SUCCESS;
+}
+
+void NVEncFilterResizeCpu::close() {
+    m_pool.close();
+    m_bandBuf.clear();
+    m_coefH.clear();
+    m_coefV.clear();
+    m_planeIn.clear();
+    m_planeOut.clear();
+    m_func = nullptr;
+}
+
+//--- NVEncFilterResize (--vpp-resize cpu_xxx) ---------------------------------------------
+NVENCSTATUS NVEncFilterResize::resizeCpu(FrameInfo *pOutputFrame, const FrameInfo *pInputFrame) {
+    auto pResizeParam = std::dynamic_pointer_cast<NVEncFilterParamResize>(m_pParam);
+    if (!pResizeParam) {
+        AddMessage(RGY_LOG_ERROR, _T("Invalid parameter type.\n"));
+        return NV_ENC_ERR_INVALID_PARAM;
+    }
+    //インタレ保持の場合はフィールド単位で呼ばれるので、サイズが変わったら作り直す
+    if (!m_resizeCpu
+        || m_cpuFrame[0].width != pInputFrame->width || m_cpuFrame[0].height != pInputFrame->height
+        || m_cpuFrame[1].width != pOutputFrame->width || m_cpuFrame[1].height != pOutputFrame->height) {
+        const FrameInfo *pFrames[2] = { pInputFrame, pOutputFrame };
+        for (int i = 0; i < 2; i++) {
+            m_cpuFrame[i] = *pFrames[i];
+            m_cpuFrame[i].deivce_mem = false;
+            const auto frameInfoEx = getFrameInfoExtra(&m_cpuFrame[i]);
+            m_cpuFrame[i].pitch = ALIGN(frameInfoEx.width_byte, 64);
+            m_cpuBuf[i].reset((uint8_t *)_aligned_malloc((size_t)m_cpuFrame[i].pitch * frameInfoEx.height_total, 64));
+            if (!m_cpuBuf[i]) {
+                AddMessage(RGY_LOG_ERROR, _T("failed to allocate host memory.\n"));
+                return NV_ENC_ERR_OUT_OF_MEMORY;
+            }
+            m_cpuFrame[i].ptr = m_cpuBuf[i].get();
+        }
+        m_resizeCpu = std::make_shared<NVEncFilterResizeCpu>();
+        auto sts = m_resizeCpu->init(m_cpuFrame[0], m_cpuFrame[1], (RGY_RESIZE_CPU)(pResizeParam->interp - RESIZE_CPU_BILINEAR), 0, m_pPrintMes);
+        if (sts != NV_ENC_SUCCESS) {
+            m_resizeCpu.reset();
+            return sts;
+        }
+    }
+    const auto inputFrameInfoEx = getFrameInfoExtra(pInputFrame);
+    auto cudaerr = cudaMemcpy2D(m_cpuFrame[0].ptr, m_cpuFrame[0].pitch, pInputFrame->ptr, pInputFrame->pitch,
+        inputFrameInfoEx.width_byte, inputFrameInfoEx.height_total, cudaMemcpyDeviceToHost);
+    if (cudaerr != cudaSuccess) {
+        AddMessage(RGY_LOG_ERROR, _T("failed to copy frame to host: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
+        return NV_ENC_ERR_INVALID_CALL;
+    }
+    auto sts = m_resizeCpu->resize(&m_cpuFrame[1], &m_cpuFrame[0]);
+    if (sts != NV_ENC_SUCCESS) {
+        return sts;
+    }
+    const auto outputFrameInfoEx = getFrameInfoExtra(pOutputFrame);
+    cudaerr = cudaMemcpy2D(pOutputFrame->ptr, pOutputFrame->pitch, m_cpuFrame[1].ptr, m_cpuFrame[1].pitch,
+        outputFrameInfoEx.width_byte, outputFrameInfoEx.height_total, cudaMemcpyHostToDevice);
+    if (cudaerr != cudaSuccess) {
+        AddMessage(RGY_LOG_ERROR, _T("failed to copy frame to device: %s.\n"), char_to_tstring(cudaGetErrorName(cudaerr)).c_str());
+        return NV_ENC_ERR_INVALID_CALL;
+    }
+    return NV_ENC_SUCCESS;
+}
@@ -0,0 +1,154 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#pragma once
+#ifndef __NVENC_FILTER_RESIZE_CPU_H__
+#define __NVENC_FILTER_RESIZE_CPU_H__
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include "nvEncodeAPI.h"
+#include "rgy_util.h"
+#include "rgy_log.h"
+#include "rgy_thread_pool.h"
+#include "convert_csp.h"
+
+enum RGY_RESIZE_CPU {
+    RGY_RESIZE_CPU_BILINEAR = 0,
+    RGY_RESIZE_CPU_BICUBIC,
+    RGY_RESIZE_CPU_SPLINE16,
+    RGY_RESIZE_CPU_SPLINE36,
+    RGY_RESIZE_CPU_SPLINE64,
+    RGY_RESIZE_CPU_LANCZOS2,
+    RGY_RESIZE_CPU_LANCZOS3,
+};
+
+const CX_DESC list_resize_cpu[] = {
+    { _T("bilinear"), RGY_RESIZE_CPU_BILINEAR },
+    { _T("bicubic"),  RGY_RESIZE_CPU_BICUBIC },
+    { _T("spline16"), RGY_RESIZE_CPU_SPLINE16 },
+    { _T("spline36"), RGY_RESIZE_CPU_SPLINE36 },
+    { _T("spline64"), RGY_RESIZE_CPU_SPLINE64 },
+    { _T("lanczos2"), RGY_RESIZE_CPU_LANCZOS2 },
+    { _T("lanczos3"), RGY_RESIZE_CPU_LANCZOS3 },
+    { NULL, 0 }
+};
+
+//1次元のリサイズの係数テーブル
+//  出力位置xの値は、sum(weight[t * dstSize + x] * src[start[x] + t]), t = 0 ... taps-1
+//  start[x] + tは常に[0, srcSize)の範囲に収まるよう、端の係数は畳み込み済み
+struct RGYResizeCoef {
+    int srcSize;
+    int dstSize;
+    int algo;
+    int taps;
+    std::vector<int> start;     //[dstSize]
+    std::vector<float> weight;  //[taps][dstSize] (SIMDで出力位置方向にロードできるよう転置して保持)
+};
+
+//(srcSize, dstSize, algo)ごとに係数テーブルを作成し、キャッシュしたものを返す
+std::shared_ptr<const RGYResizeCoef> resize_cpu_get_coef(int srcSize, int dstSize, RGY_RESIZE_CPU algo);
+
+//--- 各処理のCPU版 (行単位) ------------------------------------------------------------
+//水平方向のフィルタ (src: 入力の1行、float)
+typedef void(*funcResizeCpuH)(float *dst, const float *src, const RGYResizeCoef *coef);
+//垂直方向のフィルタ (src: 水平方向のフィルタ済みの行、weight: 各行の係数)
+typedef void(*funcResizeCpuV)(float *dst, const float *const *src, const float *weight, int taps, int width);
+//1行をfloatに変換する (連続した画素のみ)
+typedef void(*funcResizeCpuLoad8)(float *dst, const uint8_t *src, int width);
+typedef void(*funcResizeCpuLoad16)(float *dst, const uint16_t *src, int width);
+//1行を丸め・飽和して書き出す (連続した画素のみ)
+typedef void(*funcResizeCpuStore8)(uint8_t *dst, const float *src, int width);
+typedef void(*funcResizeCpuStore16)(uint16_t *dst, const float *src, int width, int max_val);
+
+struct resizeCpuFuncs {
+    funcResizeCpuH       filter_h;
+    funcResizeCpuV       filter_v;
+    funcResizeCpuLoad8   load8;
+    funcResizeCpuLoad16  load16;
+    funcResizeCpuStore8  store8;
+    funcResizeCpuStore16 store16;
+};
+
+//使用可能な命令セットに応じた関数を返す
+const resizeCpuFuncs *get_resize_cpu_funcs();
+
+//--- CPU版リサイズ ---------------------------------------------------------------------
+
+//NVEncFilterResizeと同様のリサイズをCPUで行う (分離型フィルタ、行方向に分割して並列処理)
+//入出力はホストメモリ上の同じcspのフレーム (RGY_CSP_xxxのすべての形式に対応)
+//  planarのyuv420/yuv422/yuv444の色差はY面と同じpitchで、Y, U, Vの順に配置されていること
+//  (yuv420のU, Vは height/2行ずつ、yuv422/yuv444はheight行ずつ)
+//  NV12/P010/NV16/P210は、Y面の直後にUVの面が同じpitchで配置されていること
+class NVEncFilterResizeCpu {
+public:
+    NVEncFilterResizeCpu();
+    ~NVEncFilterResizeCpu();
+    //threads = 0で論理プロセッサ数
+    NVENCSTATUS init(const FrameInfo& frameIn, const FrameInfo& frameOut, RGY_RESIZE_CPU algo, int threads, shared_ptr<RGYLog> pPrintMes);
+    NVENCSTATUS resize(FrameInfo *pOutputFrame, const FrameInfo *pInputFrame);
+    void close();
+protected:
+    //1つの色成分 (packed形式では各チャンネルを別々に扱う)
+    struct ResizePlane {
+        int offset;  //フレームの先頭からのbyte数
+        int step;    //隣の画素までの要素数
+        int width;
+        int height;
+    };
+    //band内の処理用のバッファ
+    struct ResizeBandBuf {
+        std::vector<float> srcRow;  //入力の1行
+        std::vector<float> rowsH;   //水平方向のフィルタ済みの行
+        std::vector<float> dstRow;  //出力の1行
+    };
+    void AddMessage(int log_level, const TCHAR *format, ...);
+    static std::vector<ResizePlane> getPlanes(const FrameInfo& frame);
+    void resizePlane(int band, const FrameInfo *pOutputFrame, const FrameInfo *pInputFrame, int iplane);
+    void loadRow(float *dst, const uint8_t *src, const ResizePlane& plane) const;
+    void storeRow(uint8_t *dst, const float *src, const ResizePlane& plane) const;
+
+    FrameInfo m_frameIn;
+    FrameInfo m_frameOut;
+    RGY_RESIZE_CPU m_algo;
+    std::vector<ResizePlane> m_planeIn;
+    std::vector<ResizePlane> m_planeOut;
+    std::vector<std::shared_ptr<const RGYResizeCoef>> m_coefH; //色成分ごとの水平方向の係数
+    std::vector<std::shared_ptr<const RGYResizeCoef>> m_coefV; //色成分ごとの垂直方向の係数
+    int m_pixelSize;   //1要素のbyte数
+    bool m_signed;     //YC48 (int16_t)
+    int m_maxVal;
+    const resizeCpuFuncs *m_func;
+    RGYThreadPool m_pool;
+    int m_bands;
+    std::vector<ResizeBandBuf> m_bandBuf;
+    shared_ptr<RGYLog> m_pPrintMes;
+};
+
+#endif //__NVENC_FILTER_RESIZE_CPU_H__
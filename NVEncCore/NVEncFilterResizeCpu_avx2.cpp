@@ -0,0 +1,151 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#define USE_SSE2  1
+#define USE_SSSE3 1
+#define USE_SSE41 1
+#define USE_AVX   1
+#define USE_AVX2  1
+
+#include "rgy_simd.h"
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <immintrin.h>
+#include "NVEncFilterResizeCpu.h"
+
+#if _MSC_VER >= 1800 && !defined(__AVX__) && !defined(_DEBUG)
+static_assert(false, "do not forget to set /arch:AVX or /arch:AVX2 for this file.");
+#endif
+
+#if defined(_MSC_VER) || defined(__AVX2__)
+
+//幅が足りない場合に使用するC版 (NVEncFilterResizeCpu.cpp)
+void resize_cpu_filter_h_c(float *dst, const float *src, const RGYResizeCoef *coef);
+void resize_cpu_filter_v_c(float *dst, const float *const *src, const float *weight, int taps, int width);
+void resize_cpu_load8_c(float *dst, const uint8_t *src, int width);
+void resize_cpu_load16_c(float *dst, const uint16_t *src, int width);
+void resize_cpu_store8_c(uint8_t *dst, const float *src, int width);
+void resize_cpu_store16_c(uint16_t *dst, const float *src, int width, int max_val);
+
+//8画素ずつ処理し、最後のブロックは重複させて処理する (幅が8未満の場合はC版)
+void resize_cpu_filter_h_avx2(float *dst, const float *src, const RGYResizeCoef *coef) {
+    const int dstSize = coef->dstSize;
+    if (dstSize < 8) {
+        resize_cpu_filter_h_c(dst, src, coef);
+        return;
+    }
+    const int taps = coef->taps;
+    const int *start = coef->start.data();
+    const float *weight = coef->weight.data();
+    for (int x = 0; x < dstSize; x += 8) {
+        x = (std::min)(x, dstSize - 8);
+        const __m256i yStart = _mm256_loadu_si256((const __m256i *)(start + x));
+        __m256 ySum = _mm256_setzero_ps();
+        for (int t = 0; t < taps; t++) {
+            const __m256 ySrc = _mm256_i32gather_ps(src, _mm256_add_epi32(yStart, _mm256_set1_epi32(t)), 4);
+            const __m256 yWeight = _mm256_loadu_ps(weight + t * dstSize + x);
+            ySum = _mm256_add_ps(ySum, _mm256_mul_ps(ySrc, yWeight));
+        }
+        _mm256_storeu_ps(dst + x, ySum);
+    }
+}
+
+void resize_cpu_filter_v_avx2(float *dst, const float *const *src, const float *weight, int taps, int width) {
+    if (width < 8) {
+        resize_cpu_filter_v_c(dst, src, weight, taps, width);
+        return;
+    }
+    for (int x = 0; x < width; x += 8) {
+        x = (std::min)(x, width - 8);
+        __m256 ySum = _mm256_setzero_ps();
+        for (int t = 0; t < taps; t++) {
+            ySum = _mm256_add_ps(ySum, _mm256_mul_ps(_mm256_loadu_ps(src[t] + x), _mm256_broadcast_ss(weight + t)));
+        }
+        _mm256_storeu_ps(dst + x, ySum);
+    }
+}
+
+void resize_cpu_load8_avx2(float *dst, const uint8_t *src, int width) {
+    if (width < 8) {
+        resize_cpu_load8_c(dst, src, width);
+        return;
+    }
+    for (int x = 0; x < width; x += 8) {
+        x = (std::min)(x, width - 8);
+        const __m256i y0 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + x)));
+        _mm256_storeu_ps(dst + x, _mm256_cvtepi32_ps(y0));
+    }
+}
+
+void resize_cpu_load16_avx2(float *dst, const uint16_t *src, int width) {
+    if (width < 8) {
+        resize_cpu_load16_c(dst, src, width);
+        return;
+    }
+    for (int x = 0; x < width; x += 8) {
+        x = (std::min)(x, width - 8);
+        const __m256i y0 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(src + x)));
+        _mm256_storeu_ps(dst + x, _mm256_cvtepi32_ps(y0));
+    }
+}
+
+//[0, max_val]に飽和させ、四捨五入して整数に変換する (C版と同じ丸め)
+static RGY_FORCEINLINE __m128i resize_cpu_round_epu16(const float *src, __m256 yMax) {
+    __m256 y0 = _mm256_loadu_ps(src);
+    y0 = _mm256_min_ps(_mm256_max_ps(y0, _mm256_setzero_ps()), yMax);
+    const __m256i y1 = _mm256_cvttps_epi32(_mm256_add_ps(y0, _mm256_set1_ps(0.5f)));
+    return _mm_packus_epi32(_mm256_castsi256_si128(y1), _mm256_extracti128_si256(y1, 1));
+}
+
+void resize_cpu_store8_avx2(uint8_t *dst, const float *src, int width) {
+    if (width < 8) {
+        resize_cpu_store8_c(dst, src, width);
+        return;
+    }
+    const __m256 yMax = _mm256_set1_ps(255.0f);
+    for (int x = 0; x < width; x += 8) {
+        x = (std::min)(x, width - 8);
+        const __m128i x0 = resize_cpu_round_epu16(src + x, yMax);
+        _mm_storel_epi64((__m128i *)(dst + x), _mm_packus_epi16(x0, x0));
+    }
+}
+
+void resize_cpu_store16_avx2(uint16_t *dst, const float *src, int width, int max_val) {
+    if (width < 8) {
+        resize_cpu_store16_c(dst, src, width, max_val);
+        return;
+    }
+    const __m256 yMax = _mm256_set1_ps((float)max_val);
+    for (int x = 0; x < width; x += 8) {
+        x = (std::min)(x, width - 8);
+        _mm_storeu_si128((__m128i *)(dst + x), resize_cpu_round_epu16(src + x, yMax));
+    }
+}
+
+#endif //#if defined(_MSC_VER) || defined(__AVX2__)
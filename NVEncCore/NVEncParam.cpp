@@ -199,6 +199,9 @@ VppParam::VppParam() :
     delogo.nCbOffset = 0;
     delogo.nCrOffset = 0;
     delogo.nMode = DELOGO_MODE_REMOVE;
+    delogo.bAutoFade = false;
+    delogo.pLogPath = nullptr;
+    delogo.nAutoSelectFrames = 0;
 }
 
 VppAfs::VppAfs() :
@@ -219,7 +222,8 @@ VppAfs::VppAfs() :
     tune(FILTER_DEFAULT_AFS_TUNE),
     rff(FILTER_DEFAULT_AFS_RFF),
     timecode(FILTER_DEFAULT_AFS_TIMECODE),
-    log(FILTER_DEFAULT_AFS_LOG) {
+    log(FILTER_DEFAULT_AFS_LOG),
+    cpu(FILTER_DEFAULT_AFS_CPU) {
     check();
 }
 
@@ -244,7 +248,8 @@ bool VppAfs::operator==(const VppAfs& x) const {
         && tune == x.tune
         && rff == x.rff
         && timecode == x.timecode
-        && log == x.log;
+        && log == x.log
+        && cpu == x.cpu;
 }
 bool VppAfs::operator!=(const VppAfs& x) const {
     return !(*this == x);
@@ -341,6 +346,44 @@ NV_ENC_CONFIG DefaultParam() {
     return config;
 }
 
+NVEncRenditionParam::NVEncRenditionParam() :
+    outputFilename(),
+    width(0),
+    height(0),
+    bitrate(0),
+    maxBitrate(0) {
+}
+
+DedupParam::DedupParam() :
+    enable(false),
+    threshold(DEDUP_DEFAULT_THRESHOLD),
+    maxDrop(DEDUP_DEFAULT_MAX_DROP) {
+}
+
+bool DedupParam::operator==(const DedupParam& x) const {
+    return enable == x.enable
+        && threshold == x.threshold
+        && maxDrop == x.maxDrop;
+}
+bool DedupParam::operator!=(const DedupParam& x) const {
+    return !(*this == x);
+}
+
+Fmp4Param::Fmp4Param() :
+    enable(false),
+    fragMs(0),
+    segmentSec(0.0f) {
+}
+
+bool Fmp4Param::operator==(const Fmp4Param& x) const {
+    return enable == x.enable
+        && fragMs == x.fragMs
+        && segmentSec == x.segmentSec;
+}
+bool Fmp4Param::operator!=(const Fmp4Param& x) const {
+    return !(*this == x);
+}
+
 InEncodeVideoParam::InEncodeVideoParam() :
     input(),
     inputFilename(),
@@ -357,6 +400,7 @@ InEncodeVideoParam::InEncodeVideoParam() :
     lossless(0),                 //ロスレス出力
     sMaxCll(),
     sMasterDisplay(),
+    sDynamicHdr10plus(),
     logfile(),              //ログ出力先
     loglevel(RGY_LOG_INFO),                 //ログ出力レベル
     nOutputBufSizeMB(DEFAULT_OUTPUT_BUF),         //出力バッファサイズ
@@ -376,9 +420,22 @@ InEncodeVideoParam::InEncodeVideoParam() :
     nTrimCount(0),
     pTrimList(nullptr),
     bCopyChapter(false),
+    bRemux(false),
+    bBitstreamStats(false),
     nOutputThread(RGY_OUTPUT_THREAD_AUTO),
     nAudioThread(RGY_INPUT_THREAD_AUTO),
     nInputThread(RGY_AUDIO_THREAD_AUTO),
+    nInputStagingDepth(0),
+    nAvsPrefetch(RGY_AVS_PREFETCH_DEFAULT),
+    nAutoCrop(0),
+    dedup(),
+    fmp4(),
+    bMetricPsnr(false),
+    bMetricSsim(false),
+    sMetricLog(),
+    sMetricRef(),
+    nBitstreamThread(RGY_OUTPUT_THREAD_AUTO),
+    renditions(),
     nAudioIgnoreDecodeError(DEFAULT_IGNORE_DECODE_ERROR),
     pMuxOpt(nullptr),
     sChapterFile(),
@@ -392,6 +449,7 @@ InEncodeVideoParam::InEncodeVideoParam() :
     nPerfMonitorSelectMatplot(0),
     nPerfMonitorInterval(RGY_DEFAULT_PERF_MONITOR_INTERVAL),
     nCudaSchedule(DEFAULT_CUDA_SCHEDULE),
+    threadAffinity(),
     pPrivatePrm(nullptr) {
     encConfig = DefaultParam();
     memset(&par, 0, sizeof(par));
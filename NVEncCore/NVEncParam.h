@@ -40,10 +40,12 @@
 #include "NVEncoderPerf.h"
 #include "rgy_util.h"
 #include "convert_csp.h"
+#include "rgy_thread_affinity.h"
 
 using std::vector;
 
 static const int   FILTER_DEFAULT_DELOGO_DEPTH = 128;
+static const int   FILTER_DEFAULT_DELOGO_AUTO_SELECT_FRAMES = 30;
 static const int   FILTER_DEFAULT_UNSHARP_RADIUS = 3;
 static const float FILTER_DEFAULT_UNSHARP_WEIGHT = 0.5f;
 static const float FILTER_DEFAULT_UNSHARP_THRESHOLD = 10.0f;
@@ -89,6 +91,7 @@ static const bool  FILTER_DEFAULT_AFS_TUNE = false;
 static const bool  FILTER_DEFAULT_AFS_RFF = false;
 static const bool  FILTER_DEFAULT_AFS_TIMECODE = false;
 static const bool  FILTER_DEFAULT_AFS_LOG = false;
+static const bool  FILTER_DEFAULT_AFS_CPU = false;
 
 static const float FILTER_DEFAULT_TWEAK_BRIGHTNESS = 0.0f;
 static const float FILTER_DEFAULT_TWEAK_CONTRAST = 1.0f;
@@ -435,6 +438,14 @@ enum {
     NPPI_INTER_MAX = NPPI_INTER_LANCZOS3_ADVANCED,
     RESIZE_CUDA_TEXTURE_BILINEAR,
     RESIZE_CUDA_SPLINE36,
+    //CPUで処理 (RGY_RESIZE_CPUと同じ順)
+    RESIZE_CPU_BILINEAR,
+    RESIZE_CPU_BICUBIC,
+    RESIZE_CPU_SPLINE16,
+    RESIZE_CPU_SPLINE36,
+    RESIZE_CPU_SPLINE64,
+    RESIZE_CPU_LANCZOS2,
+    RESIZE_CPU_LANCZOS3,
 };
 
 const CX_DESC list_nppi_resize[] = {
@@ -452,6 +463,13 @@ const CX_DESC list_nppi_resize[] = {
     //{ _T("lanczons3"),     NPPI_INTER_LANCZOS3_ADVANCED },
     { _T("bilinear"),      RESIZE_CUDA_TEXTURE_BILINEAR },
     { _T("spline36"),      RESIZE_CUDA_SPLINE36 },
+    { _T("cpu_bilinear"),  RESIZE_CPU_BILINEAR },
+    { _T("cpu_bicubic"),   RESIZE_CPU_BICUBIC },
+    { _T("cpu_spline16"),  RESIZE_CPU_SPLINE16 },
+    { _T("cpu_spline36"),  RESIZE_CPU_SPLINE36 },
+    { _T("cpu_spline64"),  RESIZE_CPU_SPLINE64 },
+    { _T("cpu_lanczos2"),  RESIZE_CPU_LANCZOS2 },
+    { _T("cpu_lanczos3"),  RESIZE_CPU_LANCZOS3 },
     { NULL, NULL }
 };
 
@@ -700,6 +718,7 @@ struct VppAfs {
     bool rff;              //rffフラグを認識して調整
     bool timecode;         //timecode出力
     bool log;              //log出力
+    bool cpu;              //CPUで処理
 
     VppAfs();
     bool operator==(const VppAfs& x) const;
@@ -750,6 +769,9 @@ struct VppParam {
         int    nCbOffset;
         int    nCrOffset;
         int    nMode;
+        bool   bAutoFade; //ロゴの有無・フェードを自動推定
+        TCHAR *pLogPath;  //ロゴ検出結果のログ
+        int    nAutoSelectFrames; //フレームの内容からロゴを自動選択する際に評価するフレーム数 (0で無効)
     } delogo;
 
     VppUnsharp unsharp;
@@ -764,6 +786,43 @@ struct VppParam {
     VppParam();
 };
 
+//ABRラダー用の追加の出力
+//メインの出力と同じデコード・フィルタ結果を、解像度・ビットレートを変えて同時にエンコードする
+struct NVEncRenditionParam {
+    tstring outputFilename; //出力ファイル名
+    int width;              //出力解像度
+    int height;
+    int bitrate;            //ビットレート (kbps, 0でメインの出力の設定を画素数比で使用)
+    int maxBitrate;         //最大ビットレート (kbps, 0でメインの出力の設定を画素数比で使用)
+
+    NVEncRenditionParam();
+};
+
+static const float DEDUP_DEFAULT_THRESHOLD = 2.0f;
+static const int   DEDUP_DEFAULT_MAX_DROP  = 30;
+
+//入力の重複フレームを間引き、直前のフレームの表示時間を延長する (VFR出力)
+struct DedupParam {
+    bool  enable;
+    float threshold; //重複とみなすブロックの平均絶対差の上限 (8bit換算)
+    int   maxDrop;   //連続して間引く最大フレーム数 (0で無制限)
+
+    DedupParam();
+    bool operator==(const DedupParam& x) const;
+    bool operator!=(const DedupParam& x) const;
+};
+
+//fragmented mp4 (CMAF) で出力し、エンコード中でも出力を順次利用できるようにする
+struct Fmp4Param {
+    bool  enable;
+    int   fragMs;     //fragmentの長さ (ms, 0でIDRごとにfragmentを区切る)
+    float segmentSec; //セグメントファイルの長さ (秒, 0で分割しない)
+
+    Fmp4Param();
+    bool operator==(const Fmp4Param& x) const;
+    bool operator!=(const Fmp4Param& x) const;
+};
+
 struct InEncodeVideoParam {
     VideoInfo input;              //入力する動画の情報
     tstring inputFilename;        //入力ファイル名
@@ -780,6 +839,7 @@ struct InEncodeVideoParam {
     int lossless;                 //ロスレス出力
     std::string sMaxCll;
     std::string sMasterDisplay;
+    tstring sDynamicHdr10plus;    //HDR10+の動的メタデータのファイル
     tstring logfile;              //ログ出力先
     int loglevel;                 //ログ出力レベル
     int nOutputBufSizeMB;         //出力バッファサイズ
@@ -799,9 +859,22 @@ struct InEncodeVideoParam {
     int nTrimCount;
     sTrim *pTrimList;
     bool bCopyChapter;
+    bool bRemux;                      //映像をエンコードせず、そのままコピーする
+    bool bBitstreamStats;             //映像をデコードせずに解析し、フレームごとの情報を出力する
     int nOutputThread;
     int nAudioThread;
     int nInputThread;
+    int nInputStagingDepth;           //入力フレームのステージングバッファの段数 (0で自動)
+    int nAvsPrefetch;                 //avs読み込みで先読みするフレーム数 (0で先読みしない)
+    int nAutoCrop;                    //黒帯の自動検出で解析するフレーム数 (0で自動検出しない)
+    DedupParam dedup;                 //重複フレームの間引き
+    Fmp4Param fmp4;                   //fragmented mp4出力
+    bool bMetricPsnr;                 //出力のPSNRを計測する
+    bool bMetricSsim;                 //出力のSSIMを計測する
+    tstring sMetricLog;               //PSNR/SSIMのフレームごとの結果の出力先
+    tstring sMetricRef;               //エンコード済みのファイルと比較する元の動画 (エンコードを行わない)
+    int nBitstreamThread;             //ビットストリームの取り出しスレッド (-1: 自動, 0: 使用しない, 1: 使用する)
+    std::vector<NVEncRenditionParam> renditions; //ABRラダーの追加の出力
     int nAudioIgnoreDecodeError;
     muxOptList *pMuxOpt;
     tstring sChapterFile;
@@ -815,6 +888,7 @@ struct InEncodeVideoParam {
     int64_t nPerfMonitorSelectMatplot;
     int     nPerfMonitorInterval;
     int     nCudaSchedule;
+    RGYThreadAffinity threadAffinity; //各スレッドのaffinity
     void *pPrivatePrm;
 
     InEncodeVideoParam();
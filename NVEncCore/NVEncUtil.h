@@ -62,6 +62,13 @@ VideoInfo videooutputinfo(
     std::pair<int, int> outFps);
 
 
+//RGYBitstreamのdataflag: 出力側がバッファの所有権を受け取ってよい (受け取った場合、代わりのバッファを渡す)
+static const uint32_t RGY_BITSTREAM_FLAG_TRANSFERABLE = 0x80000000;
+//出力側でバッファの所有権を受け取る場合に必要な、データ末尾の余白 (AV_INPUT_BUFFER_PADDING_SIZE以上)
+static const uint32_t RGY_BITSTREAM_PADDING = 64;
+//出力側でSEI等をコピーせずに挿入できるよう、データの前に確保しておく余白
+static const uint32_t RGY_BITSTREAM_HEADROOM = 256;
+
 struct RGYBitstream {
 private:
     uint8_t *dataptr;
@@ -35,6 +35,7 @@
 #include "rgy_version.h"
 #include "convert_csp.h"
 #include "rgy_osdep.h"
+#include "rgy_thread_pool.h"
 
 void copy_nv12_to_nv12_sse2(void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop);
 void copy_p010_to_p010_sse2(void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop);
@@ -146,6 +147,7 @@ void convert_yuv444_10_to_yuv444_sse2(void **dst, const void **src, int width, i
 void convert_yuv444_09_to_yuv444_avx2(void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop);
 void convert_yuv444_09_to_yuv444_sse2(void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop);
 
+void convert_yc48_to_yuv444_avx2(void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop);
 void convert_yc48_to_yuv444_avx(void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop);
 void convert_yc48_to_yuv444_sse41(void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop);
 void convert_yc48_to_yuv444_sse2(void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop);
@@ -166,6 +168,10 @@ void convert_yc48_to_yuv444_16bit_avx(void **dst, const void **src, int width, i
 void convert_yc48_to_yuv444_16bit_sse41(void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop);
 void convert_yc48_to_yuv444_16bit_ssse3(void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop);
 void convert_yc48_to_yuv444_16bit_sse2(void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop);
+void convert_yc48_to_p210_avx(void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop);
+void convert_yc48_to_p210_sse41(void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop);
+void convert_yc48_to_p210_ssse3(void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop);
+void convert_yc48_to_p210_sse2(void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop);
 
 void convert_yuv444_16bit_to_yc48_avx2(void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop);
 void convert_yuv444_16bit_to_yc48_avx(void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop);
@@ -917,15 +923,20 @@ static const ConvertCSP funcList[] = {
     FUNC_SSE(  RGY_CSP_YUY2,      RGY_CSP_NV12,      false,  convert_yuy2_to_nv12_sse2,           convert_yuy2_to_nv12_i_sse2,         SSE2 )
     FUNC_SSE(  RGY_CSP_YUY2,      RGY_CSP_NV12,      false,  convert_yuy2_to_nv12,                convert_yuy2_to_nv12,                NONE )
     FUNC_SSE(  RGY_CSP_YUY2,      RGY_CSP_YUV444,    false,  convert_yuy2_to_yuv444,              convert_yuy2_to_yuv444,              NONE )
-#if FOR_AUO
+    //YC48はAviutlプラグイン(auo/cufilters)で使用するが、NVEncC側でもベンチマークできるよう常に有効にする
+    FUNC_AVX2( RGY_CSP_YC48,      RGY_CSP_YUV444,    false,  convert_yc48_to_yuv444_avx2,         convert_yc48_to_yuv444_avx2,         AVX2|AVX )
     FUNC_SSE(  RGY_CSP_YC48,      RGY_CSP_YUV444,    false,  convert_yc48_to_yuv444_avx,          convert_yc48_to_yuv444_avx,          AVX )
     FUNC_SSE(  RGY_CSP_YC48,      RGY_CSP_YUV444,    false,  convert_yc48_to_yuv444_sse41,        convert_yc48_to_yuv444_sse41,        SSE41|SSSE3|SSE2 )
     FUNC_SSE(  RGY_CSP_YC48,      RGY_CSP_YUV444,    false,  convert_yc48_to_yuv444_sse2,         convert_yc48_to_yuv444_sse2,         SSE2 )
-    FUNC_AVX2( RGY_CSP_YC48,      RGY_CSP_P010,      false,  convert_yc48_to_p010_sse2,           convert_yc48_to_p010_i_avx2,         AVX2|AVX )
+    FUNC_AVX2( RGY_CSP_YC48,      RGY_CSP_P010,      false,  convert_yc48_to_p010_avx2,           convert_yc48_to_p010_i_avx2,         AVX2|AVX )
     FUNC_SSE(  RGY_CSP_YC48,      RGY_CSP_P010,      false,  convert_yc48_to_p010_avx,            convert_yc48_to_p010_i_avx,          AVX )
     FUNC_SSE(  RGY_CSP_YC48,      RGY_CSP_P010,      false,  convert_yc48_to_p010_sse41,          convert_yc48_to_p010_i_sse41,        SSE41|SSSE3|SSE2 )
     FUNC_SSE(  RGY_CSP_YC48,      RGY_CSP_P010,      false,  convert_yc48_to_p010_ssse3,          convert_yc48_to_p010_i_ssse3,        SSSE3|SSE2 )
     FUNC_SSE(  RGY_CSP_YC48,      RGY_CSP_P010,      false,  convert_yc48_to_p010_sse2,           convert_yc48_to_p010_i_sse2,         SSE2 )
+    FUNC_SSE(  RGY_CSP_YC48,      RGY_CSP_P210,      false,  convert_yc48_to_p210_avx,            convert_yc48_to_p210_avx,            AVX )
+    FUNC_SSE(  RGY_CSP_YC48,      RGY_CSP_P210,      false,  convert_yc48_to_p210_sse41,          convert_yc48_to_p210_sse41,          SSE41|SSSE3|SSE2 )
+    FUNC_SSE(  RGY_CSP_YC48,      RGY_CSP_P210,      false,  convert_yc48_to_p210_ssse3,          convert_yc48_to_p210_ssse3,          SSSE3|SSE2 )
+    FUNC_SSE(  RGY_CSP_YC48,      RGY_CSP_P210,      false,  convert_yc48_to_p210_sse2,           convert_yc48_to_p210_sse2,           SSE2 )
     FUNC_AVX2( RGY_CSP_YC48,      RGY_CSP_YUV444_16, false,  convert_yc48_to_yuv444_16bit_avx2,   convert_yc48_to_yuv444_16bit_avx2,   AVX2 )
     FUNC_SSE(  RGY_CSP_YC48,      RGY_CSP_YUV444_16, false,  convert_yc48_to_yuv444_16bit_avx,    convert_yc48_to_yuv444_16bit_avx,    AVX )
     FUNC_SSE(  RGY_CSP_YC48,      RGY_CSP_YUV444_16, false,  convert_yc48_to_yuv444_16bit_sse41,  convert_yc48_to_yuv444_16bit_sse41,  SSE41|SSSE3|SSE2 )
@@ -935,7 +946,6 @@ static const ConvertCSP funcList[] = {
     FUNC_SSE( RGY_CSP_YUV444_16,  RGY_CSP_YC48,      false,  convert_yuv444_16bit_to_yc48_avx,    convert_yuv444_16bit_to_yc48_avx,    AVX )
     FUNC_SSE( RGY_CSP_YUV444_16,  RGY_CSP_YC48,      false,  convert_yuv444_16bit_to_yc48_sse41,  convert_yuv444_16bit_to_yc48_sse41,  SSE41|SSSE3|SSE2 )
     FUNC_SSE( RGY_CSP_YUV444_16,  RGY_CSP_YC48,      false,  convert_yuv444_16bit_to_yc48_sse2,   convert_yuv444_16bit_to_yc48_sse2,   SSE2 )
-#endif
 #if ENABLE_AVSW_READER || ENABLE_AVI_READER || ENABLE_AVISYNTH_READER || ENABLE_VAPOURSYNTH_READER || ENABLE_AVI_READER || ENABLE_RAW_READER
     FUNC_AVX2( RGY_CSP_YV12, RGY_CSP_NV12, false, convert_yv12_to_nv12_avx2,     convert_yv12_to_nv12_avx2,     AVX2|AVX)
     FUNC_AVX(  RGY_CSP_YV12, RGY_CSP_NV12, false, convert_yv12_to_nv12_avx,      convert_yv12_to_nv12_avx,      AVX )
@@ -1080,3 +1090,109 @@ const TCHAR *get_simd_str(unsigned int simd) {
     }
     return _T("-");
 }
+
+//行分割時にポインタをずらす必要のあるplane数を返す
+//cropを無視し、各planeを先頭から順に処理する変換(YC48関連)のみ行分割に対応する
+static int convert_csp_band_planes(RGY_CSP csp) {
+    switch (csp) {
+    case RGY_CSP_YC48:
+        return 1;
+    case RGY_CSP_NV12:
+    case RGY_CSP_P010:
+    case RGY_CSP_P210:
+        return 2;
+    case RGY_CSP_YUV444:
+    case RGY_CSP_YUV444_16:
+        return 3;
+    default:
+        return 0;
+    }
+}
+
+static void *convert_csp_band_ptr(void *ptr, RGY_CSP csp, int iplane, int pitch, int y) {
+    const int plane_y = (iplane > 0 && RGY_CSP_CHROMA_FORMAT[csp] == RGY_CHROMAFMT_YUV420) ? (y >> 1) : y;
+    return (char *)ptr + (size_t)pitch * plane_y;
+}
+
+RGYConvertCSP::RGYConvertCSP() :
+    m_csp(nullptr),
+    m_srcPlanes(0),
+    m_dstPlanes(0),
+    m_pool() {
+}
+
+RGYConvertCSP::~RGYConvertCSP() {
+    m_pool.reset();
+}
+
+const ConvertCSP *RGYConvertCSP::getFunc(RGY_CSP csp_from, RGY_CSP csp_to, bool uv_only, int threads) {
+    m_csp = get_convert_csp_func(csp_from, csp_to, uv_only);
+    m_srcPlanes = 0;
+    m_dstPlanes = 0;
+    if (m_csp == nullptr) {
+        return nullptr;
+    }
+    if (!uv_only && (csp_from == RGY_CSP_YC48 || csp_to == RGY_CSP_YC48)) {
+        m_srcPlanes = convert_csp_band_planes(csp_from);
+        m_dstPlanes = convert_csp_band_planes(csp_to);
+        if (m_srcPlanes == 0 || m_dstPlanes == 0) {
+            m_srcPlanes = 0;
+            m_dstPlanes = 0;
+        }
+    }
+    if (threads <= 0) {
+        threads = (int)std::thread::hardware_concurrency();
+    }
+    if (m_srcPlanes > 0 && threads > 1) {
+        if (!m_pool || m_pool->threads() != threads) {
+            m_pool.reset(new RGYThreadPool());
+            m_pool->init(threads);
+        }
+    } else {
+        m_pool.reset();
+    }
+    return m_csp;
+}
+
+int RGYConvertCSP::threads() const {
+    return (m_pool) ? m_pool->threads() : 1;
+}
+
+void RGYConvertCSP::close() {
+    m_pool.reset();
+    m_csp = nullptr;
+    m_srcPlanes = 0;
+    m_dstPlanes = 0;
+}
+
+void RGYConvertCSP::run(int interlaced, void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop) {
+    const auto func = m_csp->func[interlaced ? 1 : 0];
+    //SIMD関数は行末を最大32画素分超えて書き込むので、pitchに余裕がない場合は
+    //隣のバンドの先頭行を壊さないよう、分割せずに実行する
+    const int dst_pixel_byte = (m_csp->csp_to == RGY_CSP_YC48) ? 6 : ((RGY_CSP_BIT_DEPTH[m_csp->csp_to] > 8) ? 2 : 1);
+    const bool band_split = m_pool && dst_y_pitch_byte >= ((width + 31) & ~31) * dst_pixel_byte;
+    //1バンドあたり最低でも32行程度は確保する
+    //4:2:0のインタレ変換は4行単位で処理するので、バンドの境界を4行単位にそろえる
+    const int bands = (band_split) ? (std::min)(m_pool->threads(), height / 32) : 1;
+    if (bands <= 1) {
+        func(dst, src, width, src_y_pitch_byte, src_uv_pitch_byte, dst_y_pitch_byte, height, dst_height, crop);
+        return;
+    }
+    const int band_height = ((height + bands - 1) / bands + 3) & ~3;
+    m_pool->run(bands, [&](int iband) {
+        const int y_start = band_height * iband;
+        const int y_end = (std::min)(y_start + band_height, height);
+        if (y_start >= y_end) {
+            return;
+        }
+        void *band_dst[3] = { 0 };
+        const void *band_src[3] = { 0 };
+        for (int i = 0; i < m_dstPlanes; i++) {
+            band_dst[i] = convert_csp_band_ptr(dst[i], m_csp->csp_to, i, dst_y_pitch_byte, y_start);
+        }
+        for (int i = 0; i < m_srcPlanes; i++) {
+            band_src[i] = convert_csp_band_ptr((void *)src[i], m_csp->csp_from, i, src_y_pitch_byte, y_start);
+        }
+        func(band_dst, band_src, width, src_y_pitch_byte, src_uv_pitch_byte, dst_y_pitch_byte, y_end - y_start, dst_height, crop);
+    });
+}
@@ -29,6 +29,7 @@
 #define _CONVERT_CSP_H_
 
 #include <cstdint>
+#include <memory>
 #include "rgy_tchar.h"
 
 typedef void (*funcConvertCSP) (void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop);
@@ -211,6 +212,27 @@ typedef struct ConvertCSP {
 const ConvertCSP *get_convert_csp_func(RGY_CSP csp_from, RGY_CSP csp_to, bool uv_only);
 const TCHAR *get_simd_str(unsigned int simd);
 
+class RGYThreadPool;
+
+//色空間変換を行方向に分割し、スレッドプールで並列に実行する
+//行分割に対応しない変換の場合は、呼び出し元のスレッドでそのまま実行する
+class RGYConvertCSP {
+public:
+    RGYConvertCSP();
+    ~RGYConvertCSP();
+    //threads <= 0 の場合は自動
+    const ConvertCSP *getFunc(RGY_CSP csp_from, RGY_CSP csp_to, bool uv_only, int threads = 0);
+    const ConvertCSP *getFunc() const { return m_csp; }
+    int threads() const;
+    void close();
+    void run(int interlaced, void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop);
+protected:
+    const ConvertCSP *m_csp;
+    int m_srcPlanes; //行分割時にずらすplane数 (0なら行分割しない)
+    int m_dstPlanes;
+    std::unique_ptr<RGYThreadPool> m_pool;
+};
+
 enum RGY_FRAME_FLAGS : uint64_t {
     RGY_FRAME_FLAG_NONE     = 0x00u,
     RGY_FRAME_FLAG_RFF      = 0x01u,
@@ -1034,8 +1034,8 @@ void convert_yc48_to_p010_avx2(void **dst, const void **src, int width, int src_
     const int dst_y_pitch = dst_y_pitch_byte >> 1;
     __m256i y0, y1, y2, y3;
     for (y = 0; y < height; y += 2) {
-        ycp = (short*)pixel + width * y * 3;
-        ycpw= ycp + width*3;
+        ycp = (const short *)((const char *)pixel + src_y_pitch_byte * y);
+        ycpw= (const short *)((const char *)ycp + src_y_pitch_byte);
         Y   = (short*)dst_Y + dst_y_pitch * y;
         C   = (short*)dst_C + dst_y_pitch * y / 2;
         for (x = 0; x < width; x += 16, ycp += 48, ycpw += 48) {
@@ -1075,8 +1075,8 @@ void convert_yc48_to_p010_i_avx2(void **dst, const void **src, int width, int sr
     __m256i y0, y1, y2, y3;
     for (y = 0; y < height; y += 4) {
         for (i = 0; i < 2; i++) {
-            ycp = (short*)pixel + width * (y + i) * 3;
-            ycpw= ycp + width*2*3;
+            ycp = (const short *)((const char *)pixel + src_y_pitch_byte * (y + i));
+            ycpw= (const short *)((const char *)ycp + src_y_pitch_byte * 2);
             Y   = (short*)dst_Y + dst_y_pitch * (y + i);
             C   = (short*)dst_C + dst_y_pitch * (y + i*2) / 2;
             for (x = 0; x < width; x += 16, ycp += 48, ycpw += 48) {
@@ -1104,6 +1104,51 @@ void convert_yc48_to_p010_i_avx2(void **dst, const void **src, int width, int sr
     _mm256_zeroupper();
 }
 
+void convert_yc48_to_yuv444_avx2(void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop) {
+    uint8_t *YLine   = (uint8_t *)dst[0];
+    uint8_t *ULine   = (uint8_t *)dst[1];
+    uint8_t *VLine   = (uint8_t *)dst[2];
+    uint8_t *ycpLine = (uint8_t *)src[0];
+    const __m256i yC_pw_one = _mm256_set1_epi16(1);
+    const __m256i yC_YCC = _mm256_set1_epi32(1<<LSFT_YCC_16);
+    __m256i y1, y2, y3, yY, yU, yV;
+    for (int y = 0; y < height; y++, ycpLine += src_y_pitch_byte, YLine += dst_y_pitch_byte, ULine += dst_y_pitch_byte, VLine += dst_y_pitch_byte) {
+        uint8_t *Y = YLine;
+        uint8_t *U = ULine;
+        uint8_t *V = VLine;
+        short *const ycp_fin = (short *)ycpLine + width * 3;
+        for (short *ycp = (short *)ycpLine; ycp < ycp_fin; ycp += 96, Y += 32, U += 32, V += 32) {
+            y1 = _mm256_loadu_si256((__m256i *)(ycp +  0));
+            y2 = _mm256_loadu_si256((__m256i *)(ycp + 16));
+            y3 = _mm256_loadu_si256((__m256i *)(ycp + 32));
+            gather_y_u_v_from_yc48(y1, y2, y3);
+
+            yY = _mm256_srli_epi16(convert_y_range_from_yc48(y1, yC_Y_L_MA_16, Y_L_RSH_16, yC_YCC, yC_pw_one), 8);
+            yU = _mm256_srli_epi16(convert_uv_range_from_yc48(y2, _mm256_set1_epi16(UV_OFFSET_x1), yC_UV_L_MA_16_444, UV_L_RSH_16_444, yC_YCC, yC_pw_one), 8);
+            yV = _mm256_srli_epi16(convert_uv_range_from_yc48(y3, _mm256_set1_epi16(UV_OFFSET_x1), yC_UV_L_MA_16_444, UV_L_RSH_16_444, yC_YCC, yC_pw_one), 8);
+
+            y1 = _mm256_loadu_si256((__m256i *)(ycp + 48));
+            y2 = _mm256_loadu_si256((__m256i *)(ycp + 64));
+            y3 = _mm256_loadu_si256((__m256i *)(ycp + 80));
+            gather_y_u_v_from_yc48(y1, y2, y3);
+
+            y1 = _mm256_srli_epi16(convert_y_range_from_yc48(y1, yC_Y_L_MA_16, Y_L_RSH_16, yC_YCC, yC_pw_one), 8);
+            y2 = _mm256_srli_epi16(convert_uv_range_from_yc48(y2, _mm256_set1_epi16(UV_OFFSET_x1), yC_UV_L_MA_16_444, UV_L_RSH_16_444, yC_YCC, yC_pw_one), 8);
+            y3 = _mm256_srli_epi16(convert_uv_range_from_yc48(y3, _mm256_set1_epi16(UV_OFFSET_x1), yC_UV_L_MA_16_444, UV_L_RSH_16_444, yC_YCC, yC_pw_one), 8);
+
+            //packusはlane単位なので、並びを戻す
+            yY = _mm256_permute4x64_epi64(_mm256_packus_epi16(yY, y1), _MM_SHUFFLE(3,1,2,0));
+            yU = _mm256_permute4x64_epi64(_mm256_packus_epi16(yU, y2), _MM_SHUFFLE(3,1,2,0));
+            yV = _mm256_permute4x64_epi64(_mm256_packus_epi16(yV, y3), _MM_SHUFFLE(3,1,2,0));
+
+            _mm256_storeu_si256((__m256i *)Y, yY);
+            _mm256_storeu_si256((__m256i *)U, yU);
+            _mm256_storeu_si256((__m256i *)V, yV);
+        }
+    }
+    _mm256_zeroupper();
+}
+
 void convert_yc48_to_yuv444_16bit_avx2(void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop) {
     char *Y_line = (char *)dst[0];
     char *U_line = (char *)dst[1];
@@ -1156,6 +1201,7 @@ void convert_yuv444_16bit_to_yc48_avx2(void **dst, const void **src, int width,
             _mm256_storeu_si256((__m256i *)(ycp + 32), y3);
         }
     }
+    _mm256_zeroupper();
 }
 
 #pragma warning(pop)
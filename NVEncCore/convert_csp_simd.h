@@ -1153,8 +1153,8 @@ static __forceinline void convert_yc48_to_p010_simd(void **dst, const void **src
     const int dst_y_pitch = dst_y_pitch_byte >> 1;
     __m128i x0, x1, x2, x3;
     for (y = 0; y < height; y += 2) {
-        ycp = (short*)pixel + width * y * 3;
-        ycpw= ycp + width*3;
+        ycp = (const short *)((const char *)pixel + src_y_pitch_byte * y);
+        ycpw= (const short *)((const char *)ycp + src_y_pitch_byte);
         Y   = dst_Y + dst_y_pitch * y;
         C   = dst_C + dst_y_pitch * y / 2;
         for (x = 0; x < width; x += 8, ycp += 24, ycpw += 24) {
@@ -1195,8 +1195,8 @@ static __forceinline void convert_yc48_to_p010_i_simd(void **dst, const void **s
     __m128i x0, x1, x2, x3;
     for (y = 0; y < height; y += 4) {
         for (i = 0; i < 2; i++) {
-            ycp = (short*)pixel + width * (y + i) * 3;
-            ycpw= ycp + width*2*3;
+            ycp = (const short *)((const char *)pixel + src_y_pitch_byte * (y + i));
+            ycpw= (const short *)((const char *)ycp + src_y_pitch_byte * 2);
             Y   = dst_Y + dst_y_pitch * (y + i);
             C   = dst_C + dst_y_pitch * (y + i*2) / 2;
             for (x = 0; x < width; x += 8, ycp += 24, ycpw += 24) {
@@ -1296,6 +1296,29 @@ static __forceinline void convert_yc48_to_yuv444_16bit_simd(void **dst, const vo
     }
 }
 
+template <bool aligned_store>
+static __forceinline void convert_yc48_to_p210_simd(void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop) {
+    char *Y_line = (char *)dst[0];
+    char *C_line = (char *)dst[1];
+    char *pixel = (char *)src[0];
+    const __m128i xC_pw_one = _mm_set1_epi16(1);
+    const __m128i xC_YCC = _mm_set1_epi32(1<<LSFT_YCC_16);
+    __m128i x1, x2, x3;
+    for (int y = 0; y < height; y++, pixel += src_y_pitch_byte, Y_line += dst_y_pitch_byte, C_line += dst_y_pitch_byte) {
+        short *Y = (short *)Y_line;
+        short *C = (short *)C_line;
+        short *const ycp_fin = (short *)pixel + width * 3;
+        for (short *ycp = (short *)pixel; ycp < ycp_fin; ycp += 24, Y += 8, C += 8) {
+            x1 = _mm_loadu_si128((__m128i *)(ycp +  0));
+            x2 = _mm_loadu_si128((__m128i *)(ycp +  8));
+            x3 = _mm_loadu_si128((__m128i *)(ycp + 16));
+            gather_y_uv_from_yc48(x1, x2, x3);
+            _mm_store_switch_si128((__m128i *)Y, convert_y_range_from_yc48(x1, xC_Y_L_MA_16, Y_L_RSH_16, xC_YCC, xC_pw_one));
+            _mm_store_switch_si128((__m128i *)C, convert_uv_range_from_yc48(x2, _mm_set1_epi16(UV_OFFSET_x1), xC_UV_L_MA_16_444, UV_L_RSH_16_444, xC_YCC, xC_pw_one));
+        }
+    }
+}
+
 template <bool aligned_store>
 static __forceinline void convert_yuv444_16bit_to_yc48_simd(void **dst, const void **src, int width, int src_y_pitch_byte, int src_uv_pitch_byte, int dst_y_pitch_byte, int height, int dst_height, int *crop) {
     char *Y_line = (char *)src[0];
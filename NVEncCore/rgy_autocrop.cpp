@@ -0,0 +1,472 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include <cmath>
+#include <algorithm>
+#include <emmintrin.h>
+#include "rgy_autocrop.h"
+#include "rgy_thread_pool.h"
+#include "rgy_status.h"
+#include "rgy_input_raw.h"
+#include "rgy_input_avcodec.h"
+
+//順に読み込む場合の、解析するフレームの間隔
+static const int AUTOCROP_SEQ_STEP = 30;
+static const int AUTOCROP_SEQ_STEP_MAX = 120;
+
+//8bit換算の輝度値(16bit整数x8)の和と二乗和を積算する
+static inline void autocrop_acc_row(__m128i& vsum, __m128i& vsq, __m128i x) {
+    vsum = _mm_add_epi32(vsum, _mm_madd_epi16(x, _mm_set1_epi16(1)));
+    vsq  = _mm_add_epi32(vsq,  _mm_madd_epi16(x, x));
+}
+
+//8bit換算の輝度値(16bit整数x8)を、列ごとの和と二乗和に積算する
+static inline void autocrop_acc_col(uint32_t *sum, uint32_t *sqsum, __m128i x) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i sq = _mm_mullo_epi16(x, x); //255^2は16bitに収まる
+    _mm_storeu_si128((__m128i *)(sum + 0),   _mm_add_epi32(_mm_loadu_si128((const __m128i *)(sum + 0)),   _mm_unpacklo_epi16(x, zero)));
+    _mm_storeu_si128((__m128i *)(sum + 4),   _mm_add_epi32(_mm_loadu_si128((const __m128i *)(sum + 4)),   _mm_unpackhi_epi16(x, zero)));
+    _mm_storeu_si128((__m128i *)(sqsum + 0), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(sqsum + 0)), _mm_unpacklo_epi16(sq, zero)));
+    _mm_storeu_si128((__m128i *)(sqsum + 4), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(sqsum + 4)), _mm_unpackhi_epi16(sq, zero)));
+}
+
+static inline uint32_t autocrop_hsum(__m128i x) {
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (uint32_t)_mm_cvtsi128_si32(x);
+}
+
+//フレームに格納されている輝度値のbit深度
+//P010/P210は上位bitに詰めて格納されている
+static int autocrop_bitdepth(RGY_CSP csp) {
+    return (csp == RGY_CSP_P010 || csp == RGY_CSP_P210) ? 16 : RGY_CSP_BIT_DEPTH[csp];
+}
+
+//平均と分散が閾値以下なら黒とみなす
+static bool autocrop_is_black(uint64_t sum, uint64_t sqsum, int count) {
+    if (count <= 0) {
+        return true;
+    }
+    const double mean = sum / (double)count;
+    const double var = sqsum / (double)count - mean * mean;
+    return mean <= RGY_AUTOCROP_BLACK_MEAN && var <= RGY_AUTOCROP_BLACK_VAR;
+}
+
+RGYAutoCrop::RGYAutoCrop() :
+    m_pool(),
+    m_alignW(2),
+    m_alignH(2),
+    m_totalFrames(0),
+    m_votes(),
+    m_rowSum(),
+    m_rowSqSum(),
+    m_colSum(),
+    m_colSqSum() {
+}
+
+RGYAutoCrop::~RGYAutoCrop() {
+    close();
+}
+
+void RGYAutoCrop::init(int threads, int alignW, int alignH) {
+    close();
+    if (threads <= 0) {
+        threads = (std::min)((int)std::thread::hardware_concurrency(), 8);
+    }
+    if (threads > 1) {
+        m_pool.reset(new RGYThreadPool());
+        m_pool->init(threads);
+    }
+    m_alignW = (std::max)(alignW, 1);
+    m_alignH = (std::max)(alignH, 1);
+}
+
+void RGYAutoCrop::close() {
+    m_pool.reset();
+    m_votes.clear();
+    m_totalFrames = 0;
+}
+
+int RGYAutoCrop::bands(int rows) const {
+    return (m_pool) ? clamp(rows / 64, 1, m_pool->threads()) : 1;
+}
+
+void RGYAutoCrop::statRows(const FrameInfo& frame, int y0, int y1, uint32_t *sum, uint32_t *sqsum) {
+    const int bitdepth = autocrop_bitdepth(frame.csp);
+    const int shift = bitdepth - 8;
+    const __m128i xshift = _mm_cvtsi32_si128(shift);
+    const __m128i zero = _mm_setzero_si128();
+    for (int y = y0; y < y1; y++) {
+        const uint8_t *ptr = frame.ptr + (size_t)frame.pitch * y;
+        __m128i vsum = _mm_setzero_si128();
+        __m128i vsq = _mm_setzero_si128();
+        uint32_t rsum = 0, rsq = 0;
+        int x = 0;
+        if (bitdepth > 8) {
+            const uint16_t *ptr16 = (const uint16_t *)ptr;
+            for (; x <= frame.width - 8; x += 8) {
+                autocrop_acc_row(vsum, vsq, _mm_srl_epi16(_mm_loadu_si128((const __m128i *)(ptr16 + x)), xshift));
+            }
+            for (; x < frame.width; x++) {
+                const uint32_t v = ptr16[x] >> shift;
+                rsum += v;
+                rsq += v * v;
+            }
+        } else {
+            for (; x <= frame.width - 16; x += 16) {
+                const __m128i x0 = _mm_loadu_si128((const __m128i *)(ptr + x));
+                autocrop_acc_row(vsum, vsq, _mm_unpacklo_epi8(x0, zero));
+                autocrop_acc_row(vsum, vsq, _mm_unpackhi_epi8(x0, zero));
+            }
+            for (; x < frame.width; x++) {
+                const uint32_t v = ptr[x];
+                rsum += v;
+                rsq += v * v;
+            }
+        }
+        sum[y] = rsum + autocrop_hsum(vsum);
+        sqsum[y] = rsq + autocrop_hsum(vsq);
+    }
+}
+
+void RGYAutoCrop::statCols(const FrameInfo& frame, int y0, int y1, uint32_t *sum, uint32_t *sqsum) {
+    const int bitdepth = autocrop_bitdepth(frame.csp);
+    const int shift = bitdepth - 8;
+    const __m128i xshift = _mm_cvtsi32_si128(shift);
+    const __m128i zero = _mm_setzero_si128();
+    for (int y = y0; y < y1; y++) {
+        const uint8_t *ptr = frame.ptr + (size_t)frame.pitch * y;
+        int x = 0;
+        if (bitdepth > 8) {
+            const uint16_t *ptr16 = (const uint16_t *)ptr;
+            for (; x <= frame.width - 8; x += 8) {
+                autocrop_acc_col(sum + x, sqsum + x, _mm_srl_epi16(_mm_loadu_si128((const __m128i *)(ptr16 + x)), xshift));
+            }
+            for (; x < frame.width; x++) {
+                const uint32_t v = ptr16[x] >> shift;
+                sum[x] += v;
+                sqsum[x] += v * v;
+            }
+        } else {
+            for (; x <= frame.width - 16; x += 16) {
+                const __m128i x0 = _mm_loadu_si128((const __m128i *)(ptr + x));
+                autocrop_acc_col(sum + x + 0, sqsum + x + 0, _mm_unpacklo_epi8(x0, zero));
+                autocrop_acc_col(sum + x + 8, sqsum + x + 8, _mm_unpackhi_epi8(x0, zero));
+            }
+            for (; x < frame.width; x++) {
+                const uint32_t v = ptr[x];
+                sum[x] += v;
+                sqsum[x] += v * v;
+            }
+        }
+    }
+}
+
+bool RGYAutoCrop::analyze(const FrameInfo& frame, sInputCrop *crop) {
+    memset(crop, 0, sizeof(*crop));
+    if (frame.ptr == nullptr || frame.width <= 0 || frame.height <= 0
+        || RGY_CSP_CHROMA_FORMAT[frame.csp] == RGY_CHROMAFMT_RGB) {
+        return false;
+    }
+    const int width = frame.width;
+    const int height = frame.height;
+
+    //行ごとの統計から、上下の黒帯を検出する
+    m_rowSum.resize(height);
+    m_rowSqSum.resize(height);
+    const int rowBands = bands(height);
+    std::function<void(int)> funcRows = [&](int iband) {
+        statRows(frame, height * iband / rowBands, height * (iband + 1) / rowBands, m_rowSum.data(), m_rowSqSum.data());
+    };
+    if (rowBands > 1) {
+        m_pool->run(rowBands, funcRows);
+    } else {
+        funcRows(0);
+    }
+    int top = 0;
+    while (top < height && autocrop_is_black(m_rowSum[top], m_rowSqSum[top], width)) {
+        top++;
+    }
+    int bottom = 0;
+    while (bottom < height - top && autocrop_is_black(m_rowSum[height - 1 - bottom], m_rowSqSum[height - 1 - bottom], width)) {
+        bottom++;
+    }
+    const int contentH = height - top - bottom;
+    if (contentH < height / 4) {
+        return false; //ほぼ全体が黒
+    }
+
+    //黒帯を除いた範囲の列ごとの統計から、左右の黒帯を検出する
+    const int colBands = bands(contentH);
+    m_colSum.resize(colBands);
+    m_colSqSum.resize(colBands);
+    for (int i = 0; i < colBands; i++) {
+        m_colSum[i].assign(width, 0);
+        m_colSqSum[i].assign(width, 0);
+    }
+    std::function<void(int)> funcCols = [&](int iband) {
+        statCols(frame, top + contentH * iband / colBands, top + contentH * (iband + 1) / colBands, m_colSum[iband].data(), m_colSqSum[iband].data());
+    };
+    if (colBands > 1) {
+        m_pool->run(colBands, funcCols);
+    } else {
+        funcCols(0);
+    }
+    for (int i = 1; i < colBands; i++) {
+        for (int x = 0; x < width; x++) {
+            m_colSum[0][x] += m_colSum[i][x];
+            m_colSqSum[0][x] += m_colSqSum[i][x];
+        }
+    }
+    const auto& colSum = m_colSum[0];
+    const auto& colSqSum = m_colSqSum[0];
+    int left = 0;
+    while (left < width && autocrop_is_black(colSum[left], colSqSum[left], contentH)) {
+        left++;
+    }
+    int right = 0;
+    while (right < width - left && autocrop_is_black(colSum[width - 1 - right], colSqSum[width - 1 - right], contentH)) {
+        right++;
+    }
+    if (width - left - right < width / 4) {
+        return false;
+    }
+    crop->e.left   = left;
+    crop->e.up     = top;
+    crop->e.right  = right;
+    crop->e.bottom = bottom;
+    return true;
+}
+
+bool RGYAutoCrop::addFrame(const FrameInfo& frame) {
+    m_totalFrames++;
+    sInputCrop crop;
+    if (!analyze(frame, &crop)) {
+        return false;
+    }
+    //黒帯の内側を削らないよう、切り捨てで単位を合わせる
+    crop.e.left   = crop.e.left   / m_alignW * m_alignW;
+    crop.e.right  = crop.e.right  / m_alignW * m_alignW;
+    crop.e.up     = crop.e.up     / m_alignH * m_alignH;
+    crop.e.bottom = crop.e.bottom / m_alignH * m_alignH;
+    m_votes.push_back(crop);
+    return true;
+}
+
+sInputCrop RGYAutoCrop::result() const {
+    sInputCrop crop = { 0 };
+    const int count = (int)m_votes.size();
+    if (count == 0) {
+        return crop;
+    }
+    //暗いシーンでは黒帯が大きく検出されるので、一定数以上のフレームで一致する値のうち、最小のものを採用する
+    //全面に絵のあるフレームが少数混じっても、それだけでcropが無効にならないようにする
+    const int required = (std::min)(count, (std::max)(2, (count + 2) / 3));
+    for (int i = 0; i < 4; i++) {
+        const int tolerance = 2 * ((i & 1) ? m_alignH : m_alignW);
+        std::vector<int> values;
+        for (const auto& vote : m_votes) {
+            values.push_back(vote.c[i]);
+        }
+        std::sort(values.begin(), values.end());
+        crop.c[i] = values[0];
+        for (int j = 0; j < count; j++) {
+            const auto end = std::upper_bound(values.begin() + j, values.end(), values[j] + tolerance);
+            if (end - (values.begin() + j) >= required) {
+                crop.c[i] = values[j];
+                break;
+            }
+        }
+    }
+    return crop;
+}
+
+#if ENABLE_RAW_READER || ENABLE_AVSW_READER
+//readerの出力を受け取るフレームを確保する
+static RGYFrame autocrop_alloc_frame(unique_ptr<uint8_t, aligned_malloc_deleter>& buffer, const VideoInfo& info) {
+    const int pitch = ALIGN(info.srcWidth * ((RGY_CSP_BIT_DEPTH[info.csp] > 8) ? 2 : 1), 64);
+    buffer.reset((uint8_t *)_aligned_malloc((size_t)pitch * info.srcHeight * 3, 64));
+    RGYFrame frame = RGYFrameInit();
+    frame.set(buffer.get(), info.srcWidth, info.srcHeight, pitch, info.csp);
+    return frame;
+}
+
+//先頭からstepフレームおきに、最大samplesフレームを解析する
+static RGY_ERR autocrop_sample_sequential(RGYAutoCrop& autocrop, RGYInput *reader, int step, int samples) {
+    const auto info = reader->GetInputFrameInfo();
+    if (RGY_CSP_CHROMA_FORMAT[info.csp] == RGY_CHROMAFMT_RGB) {
+        return RGY_ERR_UNSUPPORTED;
+    }
+    unique_ptr<uint8_t, aligned_malloc_deleter> buffer;
+    RGYFrame frame = autocrop_alloc_frame(buffer, info);
+    for (int i = 0; autocrop.totalFrames() < samples; i++) {
+        auto err = reader->LoadNextFrame(&frame);
+        if (err == RGY_ERR_MORE_DATA) {
+            break;
+        } else if (err != RGY_ERR_NONE) {
+            return err;
+        }
+        if (i % step == 0) {
+            autocrop.addFrame(frame.getInfo());
+        }
+    }
+    return RGY_ERR_NONE;
+}
+
+static shared_ptr<EncodeStatus> autocrop_status(const VideoInfo *inputInfo, shared_ptr<RGYLog> log) {
+    auto status = std::make_shared<EncodeStatus>();
+    status->Init(inputInfo->fpsN, inputInfo->fpsD, 0, log, nullptr);
+    status->SetDisplay(false);
+    return status;
+}
+#endif //#if ENABLE_RAW_READER || ENABLE_AVSW_READER
+
+#if ENABLE_AVSW_READER
+//シーク位置を指定して、CPUデコードのreaderを開く
+static RGY_ERR autocrop_open_avcodec(shared_ptr<RGYInputAvcodec>& reader, const TCHAR *filename, const VideoInfo *inputInfo, float seekSec, shared_ptr<RGYLog> log) {
+    AvcodecReaderPrm prm = { 0 };
+    prm.bReadVideo = true;
+    prm.nVideoAvgFramerate = std::make_pair(inputInfo->fpsN, inputInfo->fpsD);
+    prm.nAVSyncMode = RGY_AVSYNC_ASSUME_CFR;
+    prm.fSeekSec = seekSec;
+    prm.nInputThread = 0;
+
+    VideoInfo info = *inputInfo;
+    memset(&info.crop, 0, sizeof(info.crop));
+    info.type = RGY_INPUT_FMT_AVSW;
+    reader = std::make_shared<RGYInputAvcodec>();
+    auto err = std::static_pointer_cast<RGYInput>(reader)->Init(filename, &info, &prm, log, autocrop_status(inputInfo, log));
+    if (err != RGY_ERR_NONE) {
+        log->write(RGY_LOG_DEBUG, _T("autocrop: failed to open input at %s: %s\n"), print_time(seekSec).c_str(), reader->GetInputMessage());
+    }
+    return err;
+}
+
+static RGY_ERR autocrop_sample_avcodec(RGYAutoCrop& autocrop, const TCHAR *filename, const VideoInfo *inputInfo, float seekSec, int samples, shared_ptr<RGYLog> log) {
+    shared_ptr<RGYInputAvcodec> reader;
+    auto err = autocrop_open_avcodec(reader, filename, inputInfo, seekSec, log);
+    if (err != RGY_ERR_NONE) {
+        reader->Close();
+        return err;
+    }
+    const double duration = reader->GetInputVideoDuration() - seekSec;
+    if (RGY_CSP_CHROMA_FORMAT[reader->GetInputFrameInfo().csp] == RGY_CHROMAFMT_RGB) {
+        err = RGY_ERR_UNSUPPORTED;
+    } else if (duration <= 0.0) {
+        //長さが不明なら、先頭から順に読み込む
+        log->write(RGY_LOG_DEBUG, _T("autocrop: duration unknown, reading frames sequentially.\n"));
+        err = autocrop_sample_sequential(autocrop, reader.get(), AUTOCROP_SEQ_STEP, samples);
+    }
+    reader->Close();
+    reader.reset();
+    if (err != RGY_ERR_NONE || duration <= 0.0) {
+        return err;
+    }
+
+    //動画全体に分散した位置へシークし、それぞれ1フレームずつ解析する
+    //色空間は先頭で確認済みなので、ここではシークに失敗した位置を飛ばすだけとする
+    for (int i = 0; i < samples; i++) {
+        const float pos = seekSec + (float)(duration * (i + 0.5) / samples);
+        if (autocrop_open_avcodec(reader, filename, inputInfo, pos, log) == RGY_ERR_NONE) {
+            unique_ptr<uint8_t, aligned_malloc_deleter> buffer;
+            RGYFrame frame = autocrop_alloc_frame(buffer, reader->GetInputFrameInfo());
+            if (reader->LoadNextFrame(&frame) == RGY_ERR_NONE) {
+                const bool valid = autocrop.addFrame(frame.getInfo());
+                log->write(RGY_LOG_DEBUG, _T("autocrop: sample %d at %s: %s\n"), i, print_time(pos).c_str(), (valid) ? _T("ok") : _T("skipped"));
+            }
+        }
+        reader->Close();
+        reader.reset();
+    }
+    return RGY_ERR_NONE;
+}
+#endif //#if ENABLE_AVSW_READER
+
+#if ENABLE_RAW_READER
+static RGY_ERR autocrop_sample_raw(RGYAutoCrop& autocrop, const TCHAR *filename, const VideoInfo *inputInfo, int samples, shared_ptr<RGYLog> log) {
+    VideoInfo info = *inputInfo;
+    memset(&info.crop, 0, sizeof(info.crop));
+    shared_ptr<RGYInput> reader = std::make_shared<RGYInputRaw>();
+    auto err = reader->Init(filename, &info, nullptr, log, autocrop_status(inputInfo, log));
+    if (err != RGY_ERR_NONE) {
+        reader->Close();
+        return err;
+    }
+    const int frames = reader->GetInputFrameInfo().frames;
+    const int step = (frames > 0) ? clamp(frames / samples, 1, AUTOCROP_SEQ_STEP_MAX) : AUTOCROP_SEQ_STEP;
+    err = autocrop_sample_sequential(autocrop, reader.get(), step, samples);
+    reader->Close();
+    return err;
+}
+#endif //#if ENABLE_RAW_READER
+
+RGY_ERR RGYAutoCropDetect(sInputCrop *crop, const TCHAR *filename, const VideoInfo *inputInfo, float seekSec, int samples, shared_ptr<RGYLog> log) {
+    memset(crop, 0, sizeof(*crop));
+    if (_tcscmp(filename, _T("-")) == 0) {
+        log->write(RGY_LOG_WARN, _T("autocrop: not supported for pipe input.\n"));
+        return RGY_ERR_UNSUPPORTED;
+    }
+    //色差のサブサンプリングに合わせ、インタレの場合はフィールドごとに揃える
+    const bool interlaced = (inputInfo->picstruct & RGY_PICSTRUCT_INTERLACED) != 0;
+    RGYAutoCrop autocrop;
+    autocrop.init(0, 2, (interlaced) ? 4 : 2);
+
+    RGY_ERR err = RGY_ERR_UNSUPPORTED;
+    switch (inputInfo->type) {
+#if ENABLE_AVSW_READER
+    case RGY_INPUT_FMT_AVHW:
+    case RGY_INPUT_FMT_AVSW:
+    case RGY_INPUT_FMT_AVANY:
+        err = autocrop_sample_avcodec(autocrop, filename, inputInfo, seekSec, samples, log);
+        break;
+#endif //#if ENABLE_AVSW_READER
+#if ENABLE_RAW_READER
+    case RGY_INPUT_FMT_RAW:
+    case RGY_INPUT_FMT_Y4M:
+        err = autocrop_sample_raw(autocrop, filename, inputInfo, samples, log);
+        break;
+#endif //#if ENABLE_RAW_READER
+    default:
+        break;
+    }
+    if (err == RGY_ERR_UNSUPPORTED) {
+        log->write(RGY_LOG_WARN, _T("autocrop: not supported for this input.\n"));
+        return err;
+    } else if (err != RGY_ERR_NONE) {
+        log->write(RGY_LOG_WARN, _T("autocrop: failed to read input: %s.\n"), get_err_mes(err));
+        return err;
+    }
+    if (autocrop.validFrames() == 0) {
+        log->write(RGY_LOG_WARN, _T("autocrop: no frame could be analyzed (%d frames read).\n"), autocrop.totalFrames());
+        return RGY_ERR_MORE_DATA;
+    }
+    *crop = autocrop.result();
+    log->write(RGY_LOG_DEBUG, _T("autocrop: %d/%d frames analyzed, crop %d,%d,%d,%d.\n"),
+        autocrop.validFrames(), autocrop.totalFrames(), crop->e.left, crop->e.up, crop->e.right, crop->e.bottom);
+    return RGY_ERR_NONE;
+}
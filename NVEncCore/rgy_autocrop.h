@@ -0,0 +1,93 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#pragma once
+#ifndef __RGY_AUTOCROP_H__
+#define __RGY_AUTOCROP_H__
+
+#include <vector>
+#include <memory>
+#include "rgy_util.h"
+#include "rgy_log.h"
+#include "rgy_err.h"
+#include "NVEncUtil.h"
+
+class RGYThreadPool;
+
+//黒帯とみなす輝度の平均値・分散の上限 (8bit換算)
+static const int RGY_AUTOCROP_BLACK_MEAN = 32;
+static const int RGY_AUTOCROP_BLACK_VAR  = 48;
+
+//フレームを解析し、上下左右の黒帯を検出する
+//  addFrame()で解析したフレームごとの検出結果を投票し、result()で安定したcrop値を決定する
+class RGYAutoCrop {
+public:
+    RGYAutoCrop();
+    ~RGYAutoCrop();
+
+    //threads   ... 解析に使用するスレッド数 (0で自動)
+    //alignW/H  ... cropの幅・高さの単位 (色差のサブサンプリング・インタレに合わせる)
+    void init(int threads, int alignW, int alignH);
+    void close();
+
+    //1フレームの輝度面を解析し、検出結果を返す (投票には加えない)
+    //ほぼ全体が黒で判定できない場合はfalseを返す
+    bool analyze(const FrameInfo& frame, sInputCrop *crop);
+
+    //1フレームの輝度面を解析し、結果を投票に加える
+    bool addFrame(const FrameInfo& frame);
+
+    //投票結果から、全サンプルで安定したcrop値を決定する
+    sInputCrop result() const;
+
+    int validFrames() const { return (int)m_votes.size(); }
+    int totalFrames() const { return m_totalFrames; }
+protected:
+    //[y0, y1)の各行の輝度の和・二乗和を計算する
+    void statRows(const FrameInfo& frame, int y0, int y1, uint32_t *sum, uint32_t *sqsum);
+    //[y0, y1)の範囲で、各列の輝度の和・二乗和を積算する
+    void statCols(const FrameInfo& frame, int y0, int y1, uint32_t *sum, uint32_t *sqsum);
+    int bands(int rows) const;
+
+    std::unique_ptr<RGYThreadPool> m_pool;
+    int m_alignW;
+    int m_alignH;
+    int m_totalFrames;
+    std::vector<sInputCrop> m_votes;
+    std::vector<uint32_t> m_rowSum;
+    std::vector<uint32_t> m_rowSqSum;
+    std::vector<std::vector<uint32_t>> m_colSum;
+    std::vector<std::vector<uint32_t>> m_colSqSum;
+};
+
+//入力ファイルからフレームを抜き出して黒帯を検出し、cropに設定する
+//  avhw/avsw ... ファイル全体に分散した位置へシークしてフレームを取得する
+//  raw/y4m   ... 先頭から間引きながら順に読み込む
+RGY_ERR RGYAutoCropDetect(sInputCrop *crop, const TCHAR *filename, const VideoInfo *inputInfo, float seekSec, int samples, std::shared_ptr<RGYLog> log);
+
+#endif //__RGY_AUTOCROP_H__
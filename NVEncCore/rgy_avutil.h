@@ -108,6 +108,7 @@ static const AVPixelFormat HW_DECODE_PIXFMT_LIST[] = {
 
 static const TCHAR *RGY_AVCODEC_AUTO = _T("auto");
 static const TCHAR *RGY_AVCODEC_COPY = _T("copy");
+static const TCHAR *RGY_AVCODEC_FAW  = _T("faw"); //FAWからAACを取り出してコピー
 
 static const int AVQSV_DEFAULT_AUDIO_BITRATE = 192;
 
@@ -128,6 +129,9 @@ static inline bool avcodecIsCopy(const TCHAR *codec) {
 static inline bool avcodecIsAuto(const TCHAR *codec) {
     return codec != nullptr && 0 == _tcsicmp(codec, RGY_AVCODEC_AUTO);
 }
+static inline bool avcodecIsFAW(const TCHAR *codec) {
+    return codec != nullptr && 0 == _tcsicmp(codec, RGY_AVCODEC_FAW);
+}
 
 //AV_LOG_TRACE    56 - RGY_LOG_TRACE -3
 //AV_LOG_DEBUG    48 - RGY_LOG_DEBUG -2
@@ -32,6 +32,7 @@
 #include <vector>
 #include <cstdint>
 #include <string>
+#include <emmintrin.h>
 
 struct nal_info {
     uint8_t *ptr;
@@ -74,6 +75,11 @@ static std::vector<nal_info> parse_nal_unit_h264(uint8_t *data, uint32_t size) {
     nal_info nal_start = { nullptr, 0, 0 };
     const int i_fin = size - 3;
     for (int i = 0; i < i_fin; i++) {
+        //16byte中に0がなければ、その範囲からstart codeは始まらない
+        if (i + 16 <= i_fin && _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i)), _mm_setzero_si128())) == 0) {
+            i += 15;
+            continue;
+        }
         if (data[i+0] == 0 && data[i+1] == 0 && data[i+2] == 1) {
             if (nal_start.ptr) {
                 nal_list.push_back(nal_start);
@@ -100,6 +106,11 @@ static std::vector<nal_info> parse_nal_unit_hevc(uint8_t *data, uint32_t size) {
     const int i_fin = size - 3;
 
     for (int i = 0; i < i_fin; i++) {
+        //16byte中に0がなければ、その範囲からstart codeは始まらない
+        if (i + 16 <= i_fin && _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i)), _mm_setzero_si128())) == 0) {
+            i += 15;
+            continue;
+        }
         if (data[i+0] == 0 && data[i+1] == 0 && data[i+2] == 1) {
             if (nal_start.ptr) {
                 nal_list.push_back(nal_start);
@@ -0,0 +1,1153 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include <cstring>
+#include <algorithm>
+#include <emmintrin.h>
+#include "rgy_bitstream_analyzer.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static inline int rgy_clz32(uint32_t v) {
+#if defined(_MSC_VER)
+    unsigned long idx = 0;
+    _BitScanReverse(&idx, v);
+    return 31 - (int)idx;
+#else
+    return __builtin_clz(v);
+#endif
+}
+
+static inline int rgy_ceil_log2(uint32_t v) {
+    return (v <= 1) ? 0 : 32 - rgy_clz32(v - 1);
+}
+
+uint32_t rgy_nal_to_rbsp(uint8_t *dst, const uint8_t *src, uint32_t size) {
+    uint8_t *const dst_fin = dst;
+    uint8_t *ptr_dst = dst;
+    int zeros = 0; //直前まで連続している0の数
+    uint32_t i = 0;
+    const __m128i xZero = _mm_setzero_si128();
+    for (; i + 16 <= size; i += 16) {
+        //16byteのうちに0がなければ、emulation prevention byteは先頭にしか存在しえない
+        const __m128i x0 = _mm_loadu_si128((const __m128i *)(src + i));
+        const uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(x0, xZero));
+        if (mask == 0 && (zeros < 2 || src[i] != 0x03)) {
+            _mm_storeu_si128((__m128i *)ptr_dst, x0);
+            ptr_dst += 16;
+            zeros = 0;
+            continue;
+        }
+        for (uint32_t j = i; j < i + 16; j++) {
+            if (zeros >= 2 && src[j] == 0x03) {
+                zeros = 0;
+                continue;
+            }
+            zeros = (src[j] == 0) ? zeros + 1 : 0;
+            *ptr_dst++ = src[j];
+        }
+    }
+    for (; i < size; i++) {
+        if (zeros >= 2 && src[i] == 0x03) {
+            zeros = 0;
+            continue;
+        }
+        zeros = (src[i] == 0) ? zeros + 1 : 0;
+        *ptr_dst++ = src[i];
+    }
+    //末尾を超えて読み出してもよいように、0で埋めておく
+    memset(ptr_dst, 0, 8);
+    return (uint32_t)(ptr_dst - dst_fin);
+}
+
+uint32_t RGYBitReader::show32() const {
+    const uint8_t *ptr = m_data + (m_nPos >> 3);
+    const uint64_t v = ((uint64_t)ptr[0] << 32) | ((uint64_t)ptr[1] << 24) | ((uint64_t)ptr[2] << 16) | ((uint64_t)ptr[3] << 8) | (uint64_t)ptr[4];
+    return (uint32_t)(v >> (8 - (m_nPos & 7)));
+}
+
+uint32_t RGYBitReader::u(int n) {
+    if (n <= 0) {
+        return 0;
+    }
+    if (m_nPos + n > m_nSizeBits) {
+        m_nPos = m_nSizeBits;
+        m_bOverrun = true;
+        return 0;
+    }
+    const uint32_t v = show32() >> (32 - n);
+    m_nPos += n;
+    return v;
+}
+
+uint32_t RGYBitReader::u1() {
+    if (m_nPos >= m_nSizeBits) {
+        m_bOverrun = true;
+        return 0;
+    }
+    const uint32_t v = (m_data[m_nPos >> 3] >> (7 - (m_nPos & 7))) & 1;
+    m_nPos++;
+    return v;
+}
+
+uint32_t RGYBitReader::ue() {
+    const uint32_t v = show32();
+    if (v == 0) {
+        //32bit以上の符号は扱わない
+        m_nPos = m_nSizeBits;
+        m_bOverrun = true;
+        return 0;
+    }
+    const int lz = rgy_clz32(v);
+    if (lz < 16) {
+        //符号長が32bit以内なら、まとめて読み出す
+        const int len = 2 * lz + 1;
+        if (m_nPos + len > m_nSizeBits) {
+            m_nPos = m_nSizeBits;
+            m_bOverrun = true;
+            return 0;
+        }
+        m_nPos += len;
+        return (v >> (32 - len)) - 1;
+    }
+    skip(lz + 1);
+    return ((1u << lz) | u(lz)) - 1;
+}
+
+int32_t RGYBitReader::se() {
+    const uint32_t v = ue();
+    return (v & 1) ? (int32_t)((v + 1) >> 1) : -(int32_t)(v >> 1);
+}
+
+void RGYBitReader::skip(int n) {
+    m_nPos += n;
+    if (m_nPos > m_nSizeBits) {
+        m_nPos = m_nSizeBits;
+        m_bOverrun = true;
+    }
+}
+
+RGYBitstreamAUInfo::RGYBitstreamAUInfo() :
+    frametype(RGY_FRAMETYPE_UNKNOWN),
+    poc(0),
+    qp(0),
+    refCount(),
+    bytes(0),
+    sliceSize() {
+}
+
+void RGYBitstreamAUInfo::clear() {
+    frametype = RGY_FRAMETYPE_UNKNOWN;
+    poc = 0;
+    qp = 0;
+    refCount[0] = 0;
+    refCount[1] = 0;
+    bytes = 0;
+    sliceSize.clear();
+}
+
+RGYBitstreamAnalyzer::RGYBitstreamAnalyzer() :
+    m_codec(RGY_CODEC_UNKNOWN),
+    m_rbsp(),
+    m_h264sps(),
+    m_h264pps(),
+    m_h264PrevPocMsb(0),
+    m_h264PrevPocLsb(0),
+    m_h264PrevFrameNum(0),
+    m_h264PrevFrameNumOffset(0),
+    m_hevcsps(),
+    m_hevcpps(),
+    m_hevcPrevTid0Poc(0),
+    m_hevcFirstPic(true),
+    m_hevcPrevSlice() {
+}
+
+RGYBitstreamAnalyzer::~RGYBitstreamAnalyzer() {
+}
+
+RGY_ERR RGYBitstreamAnalyzer::init(RGY_CODEC codec) {
+    if (codec != RGY_CODEC_H264 && codec != RGY_CODEC_HEVC) {
+        return RGY_ERR_INVALID_CODEC;
+    }
+    m_codec = codec;
+    for (auto& sps : m_h264sps) sps.valid = false;
+    for (auto& pps : m_h264pps) pps.valid = false;
+    for (auto& sps : m_hevcsps) sps.valid = false;
+    for (auto& pps : m_hevcpps) pps.valid = false;
+    m_h264PrevPocMsb = 0;
+    m_h264PrevPocLsb = 0;
+    m_h264PrevFrameNum = 0;
+    m_h264PrevFrameNumOffset = 0;
+    m_hevcPrevTid0Poc = 0;
+    m_hevcFirstPic = true;
+    memset(&m_hevcPrevSlice, 0, sizeof(m_hevcPrevSlice));
+    return RGY_ERR_NONE;
+}
+
+//NALのヘッダ (start code + NALヘッダ) のサイズ
+uint32_t RGYBitstreamAnalyzer::headerBytes(const nal_info& nal) {
+    return ((nal.ptr[2] == 0x01) ? 3 : 4);
+}
+
+//NALのペイロード (NALヘッダの後) の先頭header_bytesをRBSPに変換する (0なら全体)
+const uint8_t *RGYBitstreamAnalyzer::toRBSP(const nal_info& nal, uint32_t header_bytes, uint32_t& rbsp_size, bool *truncated) {
+    const uint32_t offset = headerBytes(nal) + ((m_codec == RGY_CODEC_HEVC) ? 2 : 1);
+    if (truncated) {
+        *truncated = false;
+    }
+    if (nal.size <= offset) {
+        rbsp_size = 0;
+        memset(m_rbsp.data(), 0, 8);
+        return m_rbsp.data();
+    }
+    uint32_t size = nal.size - offset;
+    if (header_bytes > 0 && size > header_bytes) {
+        size = header_bytes;
+        if (truncated) {
+            *truncated = true;
+        }
+    }
+    if (m_rbsp.size() < size + 16) {
+        m_rbsp.resize(size + 16);
+    }
+    rbsp_size = rgy_nal_to_rbsp(m_rbsp.data(), nal.ptr + offset, size);
+    return m_rbsp.data();
+}
+
+RGY_ERR RGYBitstreamAnalyzer::analyze(const uint8_t *data, uint32_t size, RGYBitstreamAUInfo& info) {
+    info.clear();
+    info.bytes = size;
+    if (m_codec == RGY_CODEC_UNKNOWN) {
+        return RGY_ERR_NOT_INITIALIZED;
+    }
+    if (m_rbsp.size() == 0) {
+        m_rbsp.resize(RGY_BITSTREAM_ANALYZE_HEADER_BYTES + 16);
+    }
+    //parse_nal_unit_xxxはデータを書き換えない
+    uint8_t *ptr = const_cast<uint8_t *>(data);
+    return (m_codec == RGY_CODEC_HEVC)
+        ? analyzeHEVC(parse_nal_unit_hevc(ptr, size), info)
+        : analyzeH264(parse_nal_unit_h264(ptr, size), info);
+}
+
+//スライスの情報をAUの情報に反映する
+static void add_slice_info(RGYBitstreamAUInfo& info, RGY_FRAMETYPE type, int poc, int qp, const int refCount[2], uint32_t size, int& qpSum) {
+    //AU内の最も予測の多いスライスのタイプとする
+    const auto typeMask = RGY_FRAMETYPE_I | RGY_FRAMETYPE_P | RGY_FRAMETYPE_B;
+    if (info.sliceSize.size() == 0) {
+        info.frametype = type;
+        info.poc = poc;
+    } else {
+        const auto prevType = info.frametype & typeMask;
+        const auto curType = type & typeMask;
+        if (curType > prevType) {
+            info.frametype = (info.frametype & (RGY_FRAMETYPE)(~(uint32_t)typeMask)) | curType;
+        }
+        info.frametype |= type & (RGY_FRAMETYPE_IDR | RGY_FRAMETYPE_REF);
+        info.poc = (std::min)(info.poc, poc);
+    }
+    info.refCount[0] = (std::max)(info.refCount[0], refCount[0]);
+    info.refCount[1] = (std::max)(info.refCount[1], refCount[1]);
+    info.sliceSize.push_back(size);
+    qpSum += qp;
+    info.qp = (qpSum + (int)info.sliceSize.size() / 2) / (int)info.sliceSize.size();
+}
+
+RGY_ERR RGYBitstreamAnalyzer::parseH264SPS(RGYBitReader& br) {
+    const int profile_idc = br.u(8);
+    br.skip(16); //constraint_set_flags, level_idc
+    const uint32_t sps_id = br.ue();
+    if (sps_id >= m_h264sps.size()) {
+        return RGY_ERR_INVALID_FORMAT;
+    }
+    H264SPS sps;
+    sps.valid = false;
+    sps.chromaFormatIdc = 1;
+    sps.separateColourPlane = false;
+    if (profile_idc == 100 || profile_idc == 110 || profile_idc == 122 || profile_idc == 244 || profile_idc == 44
+        || profile_idc == 83 || profile_idc == 86 || profile_idc == 118 || profile_idc == 128 || profile_idc == 138
+        || profile_idc == 139 || profile_idc == 134 || profile_idc == 135) {
+        sps.chromaFormatIdc = br.ue();
+        if (sps.chromaFormatIdc == 3) {
+            sps.separateColourPlane = br.u1() != 0;
+        }
+        br.ue(); //bit_depth_luma_minus8
+        br.ue(); //bit_depth_chroma_minus8
+        br.u1(); //qpprime_y_zero_transform_bypass_flag
+        if (br.u1()) { //seq_scaling_matrix_present_flag
+            const int lists = (sps.chromaFormatIdc != 3) ? 8 : 12;
+            for (int i = 0; i < lists; i++) {
+                if (br.u1()) { //seq_scaling_list_present_flag
+                    const int listSize = (i < 6) ? 16 : 64;
+                    int lastScale = 8, nextScale = 8;
+                    for (int j = 0; j < listSize && nextScale != 0; j++) {
+                        nextScale = (lastScale + br.se() + 256) % 256;
+                        lastScale = (nextScale == 0) ? lastScale : nextScale;
+                    }
+                }
+            }
+        }
+    }
+    sps.log2MaxFrameNum = br.ue() + 4;
+    sps.pocType = br.ue();
+    sps.log2MaxPocLsb = 0;
+    sps.deltaPicOrderAlwaysZero = false;
+    sps.offsetForNonRefPic = 0;
+    sps.offsetForTopToBottomField = 0;
+    if (sps.pocType == 0) {
+        sps.log2MaxPocLsb = br.ue() + 4;
+    } else if (sps.pocType == 1) {
+        sps.deltaPicOrderAlwaysZero = br.u1() != 0;
+        sps.offsetForNonRefPic = br.se();
+        sps.offsetForTopToBottomField = br.se();
+        const uint32_t cycle = br.ue();
+        if (cycle > 255) {
+            return RGY_ERR_INVALID_FORMAT;
+        }
+        for (uint32_t i = 0; i < cycle; i++) {
+            sps.offsetForRefFrame.push_back(br.se());
+        }
+    } else if (sps.pocType != 2) {
+        return RGY_ERR_INVALID_FORMAT;
+    }
+    br.ue(); //max_num_ref_frames
+    br.u1(); //gaps_in_frame_num_value_allowed_flag
+    br.ue(); //pic_width_in_mbs_minus1
+    br.ue(); //pic_height_in_map_units_minus1
+    sps.frameMbsOnly = br.u1() != 0;
+    if (br.overrun() || sps.log2MaxFrameNum > 16 || sps.log2MaxPocLsb > 16) {
+        return RGY_ERR_INVALID_FORMAT;
+    }
+    sps.valid = true;
+    m_h264sps[sps_id] = sps;
+    return RGY_ERR_NONE;
+}
+
+RGY_ERR RGYBitstreamAnalyzer::parseH264PPS(RGYBitReader& br) {
+    const uint32_t pps_id = br.ue();
+    H264PPS pps;
+    pps.valid = false;
+    pps.spsId = br.ue();
+    if (pps_id >= m_h264pps.size() || (uint32_t)pps.spsId >= m_h264sps.size()) {
+        return RGY_ERR_INVALID_FORMAT;
+    }
+    pps.entropyCodingMode = br.u1() != 0;
+    pps.bottomFieldPicOrderInFramePresent = br.u1() != 0;
+    const uint32_t num_slice_groups_minus1 = br.ue();
+    if (num_slice_groups_minus1 > 0) {
+        //FMO
+        const uint32_t slice_group_map_type = br.ue();
+        if (slice_group_map_type == 0) {
+            for (uint32_t i = 0; i <= num_slice_groups_minus1; i++) {
+                br.ue(); //run_length_minus1
+            }
+        } else if (slice_group_map_type == 2) {
+            for (uint32_t i = 0; i < num_slice_groups_minus1; i++) {
+                br.ue(); //top_left
+                br.ue(); //bottom_right
+            }
+        } else if (slice_group_map_type >= 3 && slice_group_map_type <= 5) {
+            br.u1(); //slice_group_change_direction_flag
+            br.ue(); //slice_group_change_rate_minus1
+        } else if (slice_group_map_type == 6) {
+            const uint32_t pic_size_in_map_units = br.ue() + 1;
+            const int bits = rgy_ceil_log2(num_slice_groups_minus1 + 1);
+            for (uint32_t i = 0; i < pic_size_in_map_units && !br.overrun(); i++) {
+                br.skip(bits);
+            }
+        }
+    }
+    pps.numRefIdxDefaultActive[0] = br.ue() + 1;
+    pps.numRefIdxDefaultActive[1] = br.ue() + 1;
+    pps.weightedPred = br.u1() != 0;
+    pps.weightedBipredIdc = br.u(2);
+    pps.initQP = 26 + br.se();
+    br.se(); //pic_init_qs_minus26
+    br.se(); //chroma_qp_index_offset
+    br.u1(); //deblocking_filter_control_present_flag
+    br.u1(); //constrained_intra_pred_flag
+    pps.redundantPicCntPresent = br.u1() != 0;
+    if (br.overrun()) {
+        return RGY_ERR_INVALID_FORMAT;
+    }
+    pps.valid = true;
+    m_h264pps[pps_id] = pps;
+    return RGY_ERR_NONE;
+}
+
+RGY_ERR RGYBitstreamAnalyzer::parseH264Slice(RGYBitReader& br, const nal_info& nal, SliceInfo& slice) {
+    const bool idr = nal.type == NALU_H264_IDR;
+    const int nal_ref_idc = (nal.ptr[headerBytes(nal)] >> 5) & 0x03;
+    slice.firstSliceInPic = br.ue() == 0; //first_mb_in_slice
+    const uint32_t slice_type = br.ue() % 5;
+    const uint32_t pps_id = br.ue();
+    if (pps_id >= m_h264pps.size() || !m_h264pps[pps_id].valid || !m_h264sps[m_h264pps[pps_id].spsId].valid) {
+        return RGY_ERR_NOT_FOUND;
+    }
+    const auto& pps = m_h264pps[pps_id];
+    const auto& sps = m_h264sps[pps.spsId];
+    const bool sliceP = slice_type == 0 || slice_type == 3;
+    const bool sliceB = slice_type == 1;
+    const bool sliceI = !sliceP && !sliceB;
+    if (sps.separateColourPlane) {
+        br.skip(2); //colour_plane_id
+    }
+    const int frame_num = br.u(sps.log2MaxFrameNum);
+    bool field_pic = false, bottom_field = false;
+    if (!sps.frameMbsOnly) {
+        field_pic = br.u1() != 0;
+        if (field_pic) {
+            bottom_field = br.u1() != 0;
+        }
+    }
+    if (idr) {
+        br.ue(); //idr_pic_id
+    }
+    int poc_lsb = 0, delta_poc_bottom = 0, delta_poc[2] = { 0, 0 };
+    if (sps.pocType == 0) {
+        poc_lsb = br.u(sps.log2MaxPocLsb);
+        if (pps.bottomFieldPicOrderInFramePresent && !field_pic) {
+            delta_poc_bottom = br.se();
+        }
+    } else if (sps.pocType == 1 && !sps.deltaPicOrderAlwaysZero) {
+        delta_poc[0] = br.se();
+        if (pps.bottomFieldPicOrderInFramePresent && !field_pic) {
+            delta_poc[1] = br.se();
+        }
+    }
+    if (pps.redundantPicCntPresent) {
+        br.ue(); //redundant_pic_cnt
+    }
+    if (sliceB) {
+        br.u1(); //direct_spatial_mv_pred_flag
+    }
+    slice.refCount[0] = 0;
+    slice.refCount[1] = 0;
+    if (sliceP || sliceB) {
+        slice.refCount[0] = pps.numRefIdxDefaultActive[0];
+        slice.refCount[1] = (sliceB) ? pps.numRefIdxDefaultActive[1] : 0;
+        if (br.u1()) { //num_ref_idx_active_override_flag
+            slice.refCount[0] = br.ue() + 1;
+            if (sliceB) {
+                slice.refCount[1] = br.ue() + 1;
+            }
+        }
+        if (slice.refCount[0] > 32 || slice.refCount[1] > 32) {
+            return RGY_ERR_INVALID_FORMAT;
+        }
+    }
+    //ref_pic_list_modification
+    for (int list = 0; list < ((sliceB) ? 2 : ((sliceP) ? 1 : 0)); list++) {
+        if (br.u1()) { //ref_pic_list_modification_flag_lX
+            for (uint32_t idc = 0; idc != 3 && !br.overrun(); ) {
+                idc = br.ue(); //modification_of_pic_nums_idc
+                if (idc < 3) {
+                    br.ue(); //abs_diff_pic_num_minus1 / long_term_pic_num
+                } else if (idc > 3) {
+                    return RGY_ERR_INVALID_FORMAT;
+                }
+            }
+        }
+    }
+    const int chromaArrayType = (sps.separateColourPlane) ? 0 : sps.chromaFormatIdc;
+    if ((pps.weightedPred && sliceP) || (pps.weightedBipredIdc == 1 && sliceB)) {
+        //pred_weight_table
+        br.ue(); //luma_log2_weight_denom
+        if (chromaArrayType != 0) {
+            br.ue(); //chroma_log2_weight_denom
+        }
+        for (int list = 0; list < ((sliceB) ? 2 : 1); list++) {
+            for (int i = 0; i < slice.refCount[list]; i++) {
+                if (br.u1()) { //luma_weight_lX_flag
+                    br.se();
+                    br.se();
+                }
+                if (chromaArrayType != 0 && br.u1()) { //chroma_weight_lX_flag
+                    br.se(); br.se();
+                    br.se(); br.se();
+                }
+            }
+        }
+    }
+    bool mmco5 = false;
+    if (nal_ref_idc != 0) {
+        //dec_ref_pic_marking
+        if (idr) {
+            br.u1(); //no_output_of_prior_pics_flag
+            br.u1(); //long_term_reference_flag
+        } else if (br.u1()) { //adaptive_ref_pic_marking_mode_flag
+            for (uint32_t mmco = 1; mmco != 0 && !br.overrun(); ) {
+                mmco = br.ue();
+                if (mmco == 1 || mmco == 3) {
+                    br.ue(); //difference_of_pic_nums_minus1
+                }
+                if (mmco == 2) {
+                    br.ue(); //long_term_pic_num
+                }
+                if (mmco == 3 || mmco == 6) {
+                    br.ue(); //long_term_frame_idx
+                }
+                if (mmco == 4) {
+                    br.ue(); //max_long_term_frame_idx_plus1
+                }
+                if (mmco == 5) {
+                    mmco5 = true;
+                }
+                if (mmco > 6) {
+                    return RGY_ERR_INVALID_FORMAT;
+                }
+            }
+        }
+    }
+    if (pps.entropyCodingMode && !sliceI) {
+        br.ue(); //cabac_init_idc
+    }
+    slice.qp = pps.initQP + br.se(); //slice_qp_delta
+    if (br.overrun()) {
+        return RGY_ERR_MORE_DATA;
+    }
+
+    //POCの計算 (8.2.1)
+    //  同じピクチャの2つ目以降のスライスでは、状態を更新しない
+    const int maxFrameNum = 1 << sps.log2MaxFrameNum;
+    int topPoc = 0, bottomPoc = 0;
+    int frameNumOffset = 0;
+    if (sps.pocType == 0) {
+        int prevPocMsb = m_h264PrevPocMsb, prevPocLsb = m_h264PrevPocLsb;
+        if (idr) {
+            prevPocMsb = 0;
+            prevPocLsb = 0;
+        }
+        const int maxPocLsb = 1 << sps.log2MaxPocLsb;
+        int pocMsb = prevPocMsb;
+        if (poc_lsb < prevPocLsb && (prevPocLsb - poc_lsb) >= maxPocLsb / 2) {
+            pocMsb = prevPocMsb + maxPocLsb;
+        } else if (poc_lsb > prevPocLsb && (poc_lsb - prevPocLsb) > maxPocLsb / 2) {
+            pocMsb = prevPocMsb - maxPocLsb;
+        }
+        topPoc = pocMsb + poc_lsb;
+        bottomPoc = (field_pic) ? topPoc : topPoc + delta_poc_bottom;
+        if (slice.firstSliceInPic && nal_ref_idc != 0) {
+            m_h264PrevPocMsb = (mmco5) ? 0 : pocMsb;
+            m_h264PrevPocLsb = (mmco5) ? ((field_pic && bottom_field) ? 0 : topPoc - (std::min)(topPoc, bottomPoc)) : poc_lsb;
+        }
+    } else {
+        if (idr) {
+            frameNumOffset = 0;
+        } else if (m_h264PrevFrameNum > frame_num) {
+            frameNumOffset = m_h264PrevFrameNumOffset + maxFrameNum;
+        } else {
+            frameNumOffset = m_h264PrevFrameNumOffset;
+        }
+        if (sps.pocType == 1) {
+            const int cycle = (int)sps.offsetForRefFrame.size();
+            int absFrameNum = (cycle != 0) ? frameNumOffset + frame_num : 0;
+            if (nal_ref_idc == 0 && absFrameNum > 0) {
+                absFrameNum--;
+            }
+            int expectedPoc = 0;
+            if (absFrameNum > 0) {
+                int expectedDeltaPerCycle = 0;
+                for (int i = 0; i < cycle; i++) {
+                    expectedDeltaPerCycle += sps.offsetForRefFrame[i];
+                }
+                const int pocCycleCnt = (absFrameNum - 1) / cycle;
+                const int frameNumInCycle = (absFrameNum - 1) % cycle;
+                expectedPoc = pocCycleCnt * expectedDeltaPerCycle;
+                for (int i = 0; i <= frameNumInCycle; i++) {
+                    expectedPoc += sps.offsetForRefFrame[i];
+                }
+            }
+            if (nal_ref_idc == 0) {
+                expectedPoc += sps.offsetForNonRefPic;
+            }
+            if (!field_pic) {
+                topPoc = expectedPoc + delta_poc[0];
+                bottomPoc = topPoc + sps.offsetForTopToBottomField + delta_poc[1];
+            } else if (!bottom_field) {
+                topPoc = bottomPoc = expectedPoc + delta_poc[0];
+            } else {
+                topPoc = bottomPoc = expectedPoc + sps.offsetForTopToBottomField + delta_poc[0];
+            }
+        } else {
+            int tempPoc = 0;
+            if (!idr) {
+                tempPoc = (nal_ref_idc == 0) ? 2 * (frameNumOffset + frame_num) - 1 : 2 * (frameNumOffset + frame_num);
+            }
+            topPoc = bottomPoc = tempPoc;
+        }
+        if (slice.firstSliceInPic) {
+            m_h264PrevFrameNumOffset = (mmco5) ? 0 : frameNumOffset;
+            m_h264PrevFrameNum = (mmco5) ? 0 : frame_num;
+        }
+    }
+    slice.poc = (!field_pic) ? (std::min)(topPoc, bottomPoc) : ((bottom_field) ? bottomPoc : topPoc);
+    slice.type = (idr) ? RGY_FRAMETYPE_IDR : ((sliceB) ? RGY_FRAMETYPE_B : ((sliceP) ? RGY_FRAMETYPE_P : RGY_FRAMETYPE_I));
+    if (nal_ref_idc != 0) {
+        slice.type |= RGY_FRAMETYPE_REF;
+    }
+    return RGY_ERR_NONE;
+}
+
+RGY_ERR RGYBitstreamAnalyzer::analyzeH264(const std::vector<nal_info>& nal_list, RGYBitstreamAUInfo& info) {
+    int qpSum = 0;
+    for (const auto& nal : nal_list) {
+        RGY_ERR err = RGY_ERR_NONE;
+        uint32_t rbsp_size = 0;
+        if (nal.type == NALU_H264_SPS || nal.type == NALU_H264_PPS) {
+            const uint8_t *rbsp = toRBSP(nal, 0, rbsp_size);
+            RGYBitReader br(rbsp, rbsp_size);
+            err = (nal.type == NALU_H264_SPS) ? parseH264SPS(br) : parseH264PPS(br);
+        } else if (nal.type == NALU_H264_NONIDR || nal.type == NALU_H264_IDR) {
+            SliceInfo slice;
+            //まずは先頭のみ変換して解析し、足りなければ全体を変換する
+            //emulation prevention byteの除去でrbspは短くなるので、入力を打ち切ったかどうかで判定する
+            bool truncated = false;
+            const uint8_t *rbsp = toRBSP(nal, RGY_BITSTREAM_ANALYZE_HEADER_BYTES, rbsp_size, &truncated);
+            RGYBitReader br(rbsp, rbsp_size);
+            err = parseH264Slice(br, nal, slice);
+            if (err == RGY_ERR_MORE_DATA && truncated) {
+                rbsp = toRBSP(nal, 0, rbsp_size);
+                RGYBitReader brAll(rbsp, rbsp_size);
+                err = parseH264Slice(brAll, nal, slice);
+            }
+            if (err == RGY_ERR_NONE) {
+                add_slice_info(info, slice.type, slice.poc, slice.qp, slice.refCount, nal.size, qpSum);
+            }
+        }
+        if (err != RGY_ERR_NONE) {
+            return (err == RGY_ERR_MORE_DATA) ? RGY_ERR_INVALID_FORMAT : err;
+        }
+    }
+    return RGY_ERR_NONE;
+}
+
+RGY_ERR RGYBitstreamAnalyzer::parseHEVCShortTermRPS(RGYBitReader& br, const std::vector<HEVCShortTermRPS>& stRps, int idx, int numStRps, HEVCShortTermRPS& rps) {
+    rps.numNegative = 0;
+    rps.numPositive = 0;
+    if (idx != 0 && br.u1()) { //inter_ref_pic_set_prediction_flag
+        const int delta_idx = (idx == numStRps) ? br.ue() + 1 : 1;
+        if (delta_idx > idx) {
+            return RGY_ERR_INVALID_FORMAT;
+        }
+        const int sign = br.u1();
+        const int deltaRps = (1 - 2 * sign) * (int)(br.ue() + 1);
+        const auto& ref = stRps[idx - delta_idx];
+        const int numDeltaPocs = ref.numNegative + ref.numPositive;
+        std::array<bool, 33> used, useDelta;
+        for (int j = 0; j <= numDeltaPocs; j++) {
+            used[j] = br.u1() != 0;
+            useDelta[j] = (used[j]) ? true : br.u1() != 0;
+        }
+        //(7-61), (7-62)
+        int i = 0;
+        for (int j = ref.numPositive - 1; j >= 0; j--) {
+            const int dPoc = ref.deltaPocS1[j] + deltaRps;
+            if (dPoc < 0 && useDelta[ref.numNegative + j]) {
+                if (i >= 16) return RGY_ERR_INVALID_FORMAT;
+                rps.deltaPocS0[i] = dPoc;
+                rps.usedS0[i++] = used[ref.numNegative + j];
+            }
+        }
+        if (deltaRps < 0 && useDelta[numDeltaPocs]) {
+            if (i >= 16) return RGY_ERR_INVALID_FORMAT;
+            rps.deltaPocS0[i] = deltaRps;
+            rps.usedS0[i++] = used[numDeltaPocs];
+        }
+        for (int j = 0; j < ref.numNegative; j++) {
+            const int dPoc = ref.deltaPocS0[j] + deltaRps;
+            if (dPoc < 0 && useDelta[j]) {
+                if (i >= 16) return RGY_ERR_INVALID_FORMAT;
+                rps.deltaPocS0[i] = dPoc;
+                rps.usedS0[i++] = used[j];
+            }
+        }
+        rps.numNegative = i;
+        i = 0;
+        for (int j = ref.numNegative - 1; j >= 0; j--) {
+            const int dPoc = ref.deltaPocS0[j] + deltaRps;
+            if (dPoc > 0 && useDelta[j]) {
+                if (i >= 16) return RGY_ERR_INVALID_FORMAT;
+                rps.deltaPocS1[i] = dPoc;
+                rps.usedS1[i++] = used[j];
+            }
+        }
+        if (deltaRps > 0 && useDelta[numDeltaPocs]) {
+            if (i >= 16) return RGY_ERR_INVALID_FORMAT;
+            rps.deltaPocS1[i] = deltaRps;
+            rps.usedS1[i++] = used[numDeltaPocs];
+        }
+        for (int j = 0; j < ref.numPositive; j++) {
+            const int dPoc = ref.deltaPocS1[j] + deltaRps;
+            if (dPoc > 0 && useDelta[ref.numNegative + j]) {
+                if (i >= 16) return RGY_ERR_INVALID_FORMAT;
+                rps.deltaPocS1[i] = dPoc;
+                rps.usedS1[i++] = used[ref.numNegative + j];
+            }
+        }
+        rps.numPositive = i;
+    } else {
+        const uint32_t numNegative = br.ue();
+        const uint32_t numPositive = br.ue();
+        if (numNegative > 16 || numPositive > 16 || numNegative + numPositive > 16) {
+            return RGY_ERR_INVALID_FORMAT;
+        }
+        rps.numNegative = numNegative;
+        rps.numPositive = numPositive;
+        int poc = 0;
+        for (int i = 0; i < rps.numNegative; i++) {
+            poc -= br.ue() + 1;
+            rps.deltaPocS0[i] = poc;
+            rps.usedS0[i] = br.u1() != 0;
+        }
+        poc = 0;
+        for (int i = 0; i < rps.numPositive; i++) {
+            poc += br.ue() + 1;
+            rps.deltaPocS1[i] = poc;
+            rps.usedS1[i] = br.u1() != 0;
+        }
+    }
+    return (br.overrun()) ? RGY_ERR_MORE_DATA : RGY_ERR_NONE;
+}
+
+static void hevc_skip_profile_tier_level(RGYBitReader& br, int maxSubLayersMinus1) {
+    br.skip(96); //general_profile_space ... general_level_idc
+    std::array<bool, 8> profilePresent, levelPresent;
+    for (int i = 0; i < maxSubLayersMinus1; i++) {
+        profilePresent[i] = br.u1() != 0;
+        levelPresent[i] = br.u1() != 0;
+    }
+    if (maxSubLayersMinus1 > 0) {
+        br.skip(2 * (8 - maxSubLayersMinus1));
+    }
+    for (int i = 0; i < maxSubLayersMinus1; i++) {
+        if (profilePresent[i]) br.skip(88);
+        if (levelPresent[i]) br.skip(8);
+    }
+}
+
+static void hevc_skip_scaling_list_data(RGYBitReader& br) {
+    for (int sizeId = 0; sizeId < 4; sizeId++) {
+        for (int matrixId = 0; matrixId < 6; matrixId += (sizeId == 3) ? 3 : 1) {
+            if (!br.u1()) { //scaling_list_pred_mode_flag
+                br.ue(); //scaling_list_pred_matrix_id_delta
+            } else {
+                const int coefNum = (std::min)(64, 1 << (4 + (sizeId << 1)));
+                if (sizeId > 1) {
+                    br.se(); //scaling_list_dc_coef_minus8
+                }
+                for (int i = 0; i < coefNum && !br.overrun(); i++) {
+                    br.se(); //scaling_list_delta_coef
+                }
+            }
+        }
+    }
+}
+
+RGY_ERR RGYBitstreamAnalyzer::parseHEVCSPS(RGYBitReader& br) {
+    br.skip(4); //sps_video_parameter_set_id
+    const int maxSubLayersMinus1 = br.u(3);
+    br.u1(); //sps_temporal_id_nesting_flag
+    if (maxSubLayersMinus1 > 6) {
+        return RGY_ERR_INVALID_FORMAT;
+    }
+    hevc_skip_profile_tier_level(br, maxSubLayersMinus1);
+    const uint32_t sps_id = br.ue();
+    if (sps_id >= m_hevcsps.size()) {
+        return RGY_ERR_INVALID_FORMAT;
+    }
+    HEVCSPS sps;
+    sps.valid = false;
+    const uint32_t chroma_format_idc = br.ue();
+    sps.separateColourPlane = (chroma_format_idc == 3) ? br.u1() != 0 : false;
+    sps.chromaArrayType = (sps.separateColourPlane) ? 0 : chroma_format_idc;
+    const uint32_t width = br.ue();
+    const uint32_t height = br.ue();
+    if (br.u1()) { //conformance_window_flag
+        br.ue(); br.ue(); br.ue(); br.ue();
+    }
+    br.ue(); //bit_depth_luma_minus8
+    br.ue(); //bit_depth_chroma_minus8
+    sps.log2MaxPocLsb = br.ue() + 4;
+    const bool subLayerOrderingInfoPresent = br.u1() != 0;
+    for (int i = (subLayerOrderingInfoPresent) ? 0 : maxSubLayersMinus1; i <= maxSubLayersMinus1; i++) {
+        br.ue(); br.ue(); br.ue();
+    }
+    const uint32_t log2MinCb = br.ue() + 3;
+    const uint32_t log2Ctb = log2MinCb + br.ue();
+    br.ue(); //log2_min_luma_transform_block_size_minus2
+    br.ue(); //log2_diff_max_min_luma_transform_block_size
+    br.ue(); //max_transform_hierarchy_depth_inter
+    br.ue(); //max_transform_hierarchy_depth_intra
+    if (log2Ctb > 6 || sps.log2MaxPocLsb > 16) {
+        return RGY_ERR_INVALID_FORMAT;
+    }
+    const uint32_t ctbSize = 1 << log2Ctb;
+    sps.picSizeInCtbs = ((width + ctbSize - 1) >> log2Ctb) * ((height + ctbSize - 1) >> log2Ctb);
+    if (br.u1() && br.u1()) { //scaling_list_enabled_flag, sps_scaling_list_data_present_flag
+        hevc_skip_scaling_list_data(br);
+    }
+    br.u1(); //amp_enabled_flag
+    sps.saoEnabled = br.u1() != 0;
+    if (br.u1()) { //pcm_enabled_flag
+        br.skip(8);
+        br.ue();
+        br.ue();
+        br.u1();
+    }
+    const uint32_t numStRps = br.ue();
+    if (numStRps > 64) {
+        return RGY_ERR_INVALID_FORMAT;
+    }
+    for (uint32_t i = 0; i < numStRps; i++) {
+        HEVCShortTermRPS rps;
+        auto err = parseHEVCShortTermRPS(br, sps.stRps, i, numStRps, rps);
+        if (err != RGY_ERR_NONE) {
+            return RGY_ERR_INVALID_FORMAT;
+        }
+        sps.stRps.push_back(rps);
+    }
+    sps.longTermRefPicsPresent = br.u1() != 0;
+    sps.numLongTermRefPicsSps = 0;
+    if (sps.longTermRefPicsPresent) {
+        sps.numLongTermRefPicsSps = br.ue();
+        if (sps.numLongTermRefPicsSps > 32) {
+            return RGY_ERR_INVALID_FORMAT;
+        }
+        for (int i = 0; i < sps.numLongTermRefPicsSps; i++) {
+            br.skip(sps.log2MaxPocLsb); //lt_ref_pic_poc_lsb_sps
+            sps.usedByCurrPicLtSps.push_back(br.u1() != 0);
+        }
+    }
+    sps.temporalMvpEnabled = br.u1() != 0;
+    if (br.overrun()) {
+        return RGY_ERR_INVALID_FORMAT;
+    }
+    sps.valid = true;
+    m_hevcsps[sps_id] = sps;
+    return RGY_ERR_NONE;
+}
+
+RGY_ERR RGYBitstreamAnalyzer::parseHEVCPPS(RGYBitReader& br) {
+    const uint32_t pps_id = br.ue();
+    HEVCPPS pps;
+    pps.valid = false;
+    pps.spsId = br.ue();
+    if (pps_id >= m_hevcpps.size() || (uint32_t)pps.spsId >= m_hevcsps.size()) {
+        return RGY_ERR_INVALID_FORMAT;
+    }
+    pps.dependentSliceSegmentsEnabled = br.u1() != 0;
+    pps.outputFlagPresent = br.u1() != 0;
+    pps.numExtraSliceHeaderBits = br.u(3);
+    br.u1(); //sign_data_hiding_enabled_flag
+    pps.cabacInitPresent = br.u1() != 0;
+    pps.numRefIdxDefaultActive[0] = br.ue() + 1;
+    pps.numRefIdxDefaultActive[1] = br.ue() + 1;
+    pps.initQP = 26 + br.se();
+    br.u1(); //constrained_intra_pred_flag
+    br.u1(); //transform_skip_enabled_flag
+    if (br.u1()) { //cu_qp_delta_enabled_flag
+        br.ue(); //diff_cu_qp_delta_depth
+    }
+    br.se(); //pps_cb_qp_offset
+    br.se(); //pps_cr_qp_offset
+    br.u1(); //pps_slice_chroma_qp_offsets_present_flag
+    pps.weightedPred = br.u1() != 0;
+    pps.weightedBipred = br.u1() != 0;
+    br.u1(); //transquant_bypass_enabled_flag
+    const bool tilesEnabled = br.u1() != 0;
+    br.u1(); //entropy_coding_sync_enabled_flag
+    if (tilesEnabled) {
+        const uint32_t cols = br.ue() + 1;
+        const uint32_t rows = br.ue() + 1;
+        if (cols > 64 || rows > 64) {
+            return RGY_ERR_INVALID_FORMAT;
+        }
+        if (!br.u1()) { //uniform_spacing_flag
+            for (uint32_t i = 0; i < cols - 1; i++) br.ue();
+            for (uint32_t i = 0; i < rows - 1; i++) br.ue();
+        }
+        br.u1(); //loop_filter_across_tiles_enabled_flag
+    }
+    br.u1(); //pps_loop_filter_across_slices_enabled_flag
+    if (br.u1()) { //deblocking_filter_control_present_flag
+        br.u1(); //deblocking_filter_override_enabled_flag
+        if (!br.u1()) { //pps_deblocking_filter_disabled_flag
+            br.se();
+            br.se();
+        }
+    }
+    if (br.u1()) { //pps_scaling_list_data_present_flag
+        hevc_skip_scaling_list_data(br);
+    }
+    pps.listsModificationPresent = br.u1() != 0;
+    if (br.overrun()) {
+        return RGY_ERR_INVALID_FORMAT;
+    }
+    pps.valid = true;
+    m_hevcpps[pps_id] = pps;
+    return RGY_ERR_NONE;
+}
+
+RGY_ERR RGYBitstreamAnalyzer::parseHEVCSlice(RGYBitReader& br, const nal_info& nal, SliceInfo& slice) {
+    const bool irap = nal.type >= 16 && nal.type <= 23;
+    const bool idr = nal.type == 19 || nal.type == 20;
+    const int temporalId = (nal.ptr[headerBytes(nal) + 1] & 0x07) - 1;
+    slice.firstSliceInPic = br.u1() != 0;
+    if (irap) {
+        br.u1(); //no_output_of_prior_pics_flag
+    }
+    const uint32_t pps_id = br.ue();
+    if (pps_id >= m_hevcpps.size() || !m_hevcpps[pps_id].valid || !m_hevcsps[m_hevcpps[pps_id].spsId].valid) {
+        return RGY_ERR_NOT_FOUND;
+    }
+    const auto& pps = m_hevcpps[pps_id];
+    const auto& sps = m_hevcsps[pps.spsId];
+    slice.dependent = false;
+    if (!slice.firstSliceInPic) {
+        if (pps.dependentSliceSegmentsEnabled) {
+            slice.dependent = br.u1() != 0;
+        }
+        br.skip(rgy_ceil_log2(sps.picSizeInCtbs)); //slice_segment_address
+    }
+    if (slice.dependent) {
+        //スライスヘッダの値は、直前のスライスのものを引き継ぐ
+        slice.type = m_hevcPrevSlice.type;
+        slice.poc = m_hevcPrevSlice.poc;
+        slice.qp = m_hevcPrevSlice.qp;
+        slice.refCount[0] = m_hevcPrevSlice.refCount[0];
+        slice.refCount[1] = m_hevcPrevSlice.refCount[1];
+        return (br.overrun()) ? RGY_ERR_MORE_DATA : RGY_ERR_NONE;
+    }
+    br.skip(pps.numExtraSliceHeaderBits);
+    const uint32_t slice_type = br.ue();
+    if (slice_type > 2) {
+        return RGY_ERR_INVALID_FORMAT;
+    }
+    const bool sliceB = slice_type == 0;
+    const bool sliceP = slice_type == 1;
+    if (pps.outputFlagPresent) {
+        br.u1(); //pic_output_flag
+    }
+    if (sps.separateColourPlane) {
+        br.skip(2); //colour_plane_id
+    }
+    int poc_lsb = 0;
+    bool sliceTemporalMvp = false;
+    int numPicTotalCurr = 0;
+    if (!idr) {
+        poc_lsb = br.u(sps.log2MaxPocLsb);
+        HEVCShortTermRPS rpsSlice;
+        const HEVCShortTermRPS *rps = nullptr;
+        const int numStRps = (int)sps.stRps.size();
+        if (!br.u1()) { //short_term_ref_pic_set_sps_flag
+            auto err = parseHEVCShortTermRPS(br, sps.stRps, numStRps, numStRps, rpsSlice);
+            if (err != RGY_ERR_NONE) {
+                return err;
+            }
+            rps = &rpsSlice;
+        } else {
+            if (numStRps == 0) {
+                return RGY_ERR_INVALID_FORMAT;
+            }
+            const uint32_t idx = br.u(rgy_ceil_log2(numStRps));
+            if (idx >= (uint32_t)numStRps) {
+                return RGY_ERR_INVALID_FORMAT;
+            }
+            rps = &sps.stRps[idx];
+        }
+        for (int i = 0; i < rps->numNegative; i++) numPicTotalCurr += rps->usedS0[i];
+        for (int i = 0; i < rps->numPositive; i++) numPicTotalCurr += rps->usedS1[i];
+        if (sps.longTermRefPicsPresent) {
+            const uint32_t numLtSps = (sps.numLongTermRefPicsSps > 0) ? br.ue() : 0;
+            const uint32_t numLtPics = br.ue();
+            if (numLtSps + numLtPics > 32) {
+                return RGY_ERR_INVALID_FORMAT;
+            }
+            for (uint32_t i = 0; i < numLtSps + numLtPics; i++) {
+                bool used = false;
+                if (i < numLtSps) {
+                    const uint32_t idx = (sps.numLongTermRefPicsSps > 1) ? br.u(rgy_ceil_log2(sps.numLongTermRefPicsSps)) : 0;
+                    used = idx < sps.usedByCurrPicLtSps.size() && sps.usedByCurrPicLtSps[idx];
+                } else {
+                    br.skip(sps.log2MaxPocLsb); //poc_lsb_lt
+                    used = br.u1() != 0;
+                }
+                numPicTotalCurr += used;
+                if (br.u1()) { //delta_poc_msb_present_flag
+                    br.ue(); //delta_poc_msb_cycle_lt
+                }
+            }
+        }
+        if (sps.temporalMvpEnabled) {
+            sliceTemporalMvp = br.u1() != 0;
+        }
+    }
+    if (sps.saoEnabled) {
+        br.u1(); //slice_sao_luma_flag
+        if (sps.chromaArrayType != 0) {
+            br.u1(); //slice_sao_chroma_flag
+        }
+    }
+    slice.refCount[0] = 0;
+    slice.refCount[1] = 0;
+    if (sliceP || sliceB) {
+        slice.refCount[0] = pps.numRefIdxDefaultActive[0];
+        slice.refCount[1] = (sliceB) ? pps.numRefIdxDefaultActive[1] : 0;
+        if (br.u1()) { //num_ref_idx_active_override_flag
+            slice.refCount[0] = br.ue() + 1;
+            if (sliceB) {
+                slice.refCount[1] = br.ue() + 1;
+            }
+        }
+        if (slice.refCount[0] > 16 || slice.refCount[1] > 16) {
+            return RGY_ERR_INVALID_FORMAT;
+        }
+        if (pps.listsModificationPresent && numPicTotalCurr > 1) {
+            //ref_pic_lists_modification
+            const int bits = rgy_ceil_log2(numPicTotalCurr);
+            for (int list = 0; list < ((sliceB) ? 2 : 1); list++) {
+                if (br.u1()) { //ref_pic_list_modification_flag_lX
+                    br.skip(bits * slice.refCount[list]);
+                }
+            }
+        }
+        if (sliceB) {
+            br.u1(); //mvd_l1_zero_flag
+        }
+        if (pps.cabacInitPresent) {
+            br.u1(); //cabac_init_flag
+        }
+        if (sliceTemporalMvp) {
+            const bool collocatedFromL0 = (sliceB) ? br.u1() != 0 : true;
+            if ((collocatedFromL0 && slice.refCount[0] > 1) || (!collocatedFromL0 && slice.refCount[1] > 1)) {
+                br.ue(); //collocated_ref_idx
+            }
+        }
+        if ((pps.weightedPred && sliceP) || (pps.weightedBipred && sliceB)) {
+            //pred_weight_table
+            br.ue(); //luma_log2_weight_denom
+            if (sps.chromaArrayType != 0) {
+                br.se(); //delta_chroma_log2_weight_denom
+            }
+            for (int list = 0; list < ((sliceB) ? 2 : 1); list++) {
+                std::array<bool, 16> lumaFlag, chromaFlag;
+                for (int i = 0; i < slice.refCount[list]; i++) {
+                    lumaFlag[i] = br.u1() != 0;
+                }
+                for (int i = 0; i < slice.refCount[list]; i++) {
+                    chromaFlag[i] = (sps.chromaArrayType != 0) ? br.u1() != 0 : false;
+                }
+                for (int i = 0; i < slice.refCount[list]; i++) {
+                    if (lumaFlag[i]) {
+                        br.se();
+                        br.se();
+                    }
+                    if (chromaFlag[i]) {
+                        br.se(); br.se();
+                        br.se(); br.se();
+                    }
+                }
+            }
+        }
+        br.ue(); //five_minus_max_num_merge_cand
+    }
+    slice.qp = pps.initQP + br.se(); //slice_qp_delta
+    if (br.overrun()) {
+        return RGY_ERR_MORE_DATA;
+    }
+
+    //POCの計算 (8.3.1)
+    //  IDR/BLA、およびストリーム先頭のCRAでは、POCのMSBは0となる
+    const bool noRaslOutput = idr || (nal.type >= 16 && nal.type <= 18) || (nal.type == 21 && m_hevcFirstPic);
+    int pocMsb = 0;
+    if (!(irap && noRaslOutput)) {
+        const int maxPocLsb = 1 << sps.log2MaxPocLsb;
+        const int prevPocLsb = m_hevcPrevTid0Poc & (maxPocLsb - 1);
+        const int prevPocMsb = m_hevcPrevTid0Poc - prevPocLsb;
+        pocMsb = prevPocMsb;
+        if (poc_lsb < prevPocLsb && (prevPocLsb - poc_lsb) >= maxPocLsb / 2) {
+            pocMsb = prevPocMsb + maxPocLsb;
+        } else if (poc_lsb > prevPocLsb && (poc_lsb - prevPocLsb) > maxPocLsb / 2) {
+            pocMsb = prevPocMsb - maxPocLsb;
+        }
+    }
+    slice.poc = pocMsb + poc_lsb;
+    //RASL/RADL/sub-layer non-referenceのピクチャ以外は、次のPOCの計算に使用する
+    const bool subLayerNonRef = nal.type <= 14 && (nal.type & 1) == 0;
+    const bool raslRadl = nal.type >= 6 && nal.type <= 9;
+    if (slice.firstSliceInPic) {
+        if (temporalId == 0 && !subLayerNonRef && !raslRadl) {
+            m_hevcPrevTid0Poc = slice.poc;
+        }
+        m_hevcFirstPic = false;
+    }
+    slice.type = (idr) ? RGY_FRAMETYPE_IDR : ((sliceB) ? RGY_FRAMETYPE_B : ((sliceP) ? RGY_FRAMETYPE_P : RGY_FRAMETYPE_I));
+    if (!subLayerNonRef) {
+        slice.type |= RGY_FRAMETYPE_REF;
+    }
+    m_hevcPrevSlice = slice;
+    return RGY_ERR_NONE;
+}
+
+RGY_ERR RGYBitstreamAnalyzer::analyzeHEVC(const std::vector<nal_info>& nal_list, RGYBitstreamAUInfo& info) {
+    int qpSum = 0;
+    for (const auto& nal : nal_list) {
+        RGY_ERR err = RGY_ERR_NONE;
+        uint32_t rbsp_size = 0;
+        if (nal.type == NALU_HEVC_SPS || nal.type == NALU_HEVC_PPS) {
+            const uint8_t *rbsp = toRBSP(nal, 0, rbsp_size);
+            RGYBitReader br(rbsp, rbsp_size);
+            err = (nal.type == NALU_HEVC_SPS) ? parseHEVCSPS(br) : parseHEVCPPS(br);
+        } else if (nal.type == NALU_HEVC_EOS || nal.type == NALU_HEVC_EOB) {
+            m_hevcFirstPic = true;
+        } else if (nal.type <= 21 && (nal.type <= 9 || nal.type >= 16)) {
+            SliceInfo slice;
+            //まずは先頭のみ変換して解析し、足りなければ全体を変換する
+            //emulation prevention byteの除去でrbspは短くなるので、入力を打ち切ったかどうかで判定する
+            bool truncated = false;
+            const uint8_t *rbsp = toRBSP(nal, RGY_BITSTREAM_ANALYZE_HEADER_BYTES, rbsp_size, &truncated);
+            RGYBitReader br(rbsp, rbsp_size);
+            err = parseHEVCSlice(br, nal, slice);
+            if (err == RGY_ERR_MORE_DATA && truncated) {
+                rbsp = toRBSP(nal, 0, rbsp_size);
+                RGYBitReader brAll(rbsp, rbsp_size);
+                err = parseHEVCSlice(brAll, nal, slice);
+            }
+            if (err == RGY_ERR_NONE) {
+                add_slice_info(info, slice.type, slice.poc, slice.qp, slice.refCount, nal.size, qpSum);
+            }
+        }
+        if (err != RGY_ERR_NONE) {
+            return (err == RGY_ERR_MORE_DATA) ? RGY_ERR_INVALID_FORMAT : err;
+        }
+    }
+    return RGY_ERR_NONE;
+}
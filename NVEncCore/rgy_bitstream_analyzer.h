@@ -0,0 +1,207 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#pragma once
+#ifndef __RGY_BITSTREAM_ANALYZER_H__
+#define __RGY_BITSTREAM_ANALYZER_H__
+
+#include <cstdint>
+#include <vector>
+#include <array>
+#include "rgy_util.h"
+#include "rgy_err.h"
+#include "rgy_bitstream.h"
+
+//ヘッダの解析のため、スライスの先頭からRBSPに変換する最大のバイト数
+//  足りない場合は、スライス全体を変換して再度解析する
+static const uint32_t RGY_BITSTREAM_ANALYZE_HEADER_BYTES = 1024;
+
+//emulation prevention byte (0x000003 の 0x03) を除去し、RBSPに変換する
+//  dstには、size + 8 byte以上の領域が必要
+//  戻り値は、変換後のサイズ
+uint32_t rgy_nal_to_rbsp(uint8_t *dst, const uint8_t *src, uint32_t size);
+
+//RBSPから、固定長/指数ゴロム符号の値を読み出す
+//  末尾を超えて読み出した場合は、overrun()がtrueとなり0を返す
+//  バッファの末尾には、4byte以上の読み出し可能な余白が必要
+class RGYBitReader {
+public:
+    RGYBitReader(const uint8_t *data, uint32_t size) : m_data(data), m_nSizeBits((uint64_t)size << 3), m_nPos(0), m_bOverrun(false) {};
+
+    uint32_t u(int n);
+    uint32_t u1();
+    uint32_t ue();
+    int32_t se();
+    void skip(int n);
+    bool overrun() const { return m_bOverrun; }
+    bool byteAligned() const { return (m_nPos & 7) == 0; }
+protected:
+    uint32_t show32() const;
+
+    const uint8_t *m_data;
+    uint64_t m_nSizeBits;
+    uint64_t m_nPos;
+    bool m_bOverrun;
+};
+
+static inline const TCHAR *rgy_frametype_str(RGY_FRAMETYPE frametype) {
+    if (frametype & RGY_FRAMETYPE_IDR) return _T("IDR");
+    if (frametype & RGY_FRAMETYPE_I)   return _T("I");
+    if (frametype & RGY_FRAMETYPE_P)   return _T("P");
+    if (frametype & RGY_FRAMETYPE_B)   return _T("B");
+    return _T("?");
+}
+
+//AUごとの解析結果
+struct RGYBitstreamAUInfo {
+    RGY_FRAMETYPE frametype;  //IDR/I/P/B (+REF)
+    int poc;                  //picture order count
+    int qp;                   //スライスのQPの平均 (init_qp + slice_qp_delta)
+    int refCount[2];          //L0/L1の参照数 (スライスの最大値)
+    uint32_t bytes;           //AU全体のサイズ
+    std::vector<uint32_t> sliceSize; //スライスのNALのサイズ
+
+    RGYBitstreamAUInfo();
+    void clear();
+};
+
+//H.264/HEVCのbitstreamをデコードせずに解析し、SPS/PPS/スライスヘッダからAUごとの情報を取得する
+//  SPS/PPSはbitstream中のものを保持し、スライスヘッダの解析に使用する
+class RGYBitstreamAnalyzer {
+public:
+    RGYBitstreamAnalyzer();
+    ~RGYBitstreamAnalyzer();
+
+    RGY_ERR init(RGY_CODEC codec);
+    //AU (1フレーム分のbitstream, AnnexB形式) を解析する
+    RGY_ERR analyze(const uint8_t *data, uint32_t size, RGYBitstreamAUInfo& info);
+    RGY_CODEC codec() const { return m_codec; }
+protected:
+    struct H264SPS {
+        bool valid;
+        int chromaFormatIdc;
+        bool separateColourPlane;
+        int log2MaxFrameNum;
+        int pocType;
+        int log2MaxPocLsb;
+        bool deltaPicOrderAlwaysZero;
+        int offsetForNonRefPic;
+        int offsetForTopToBottomField;
+        std::vector<int> offsetForRefFrame;
+        bool frameMbsOnly;
+    };
+    struct H264PPS {
+        bool valid;
+        int spsId;
+        bool entropyCodingMode;
+        bool bottomFieldPicOrderInFramePresent;
+        int numRefIdxDefaultActive[2];
+        bool weightedPred;
+        int weightedBipredIdc;
+        int initQP;
+        bool redundantPicCntPresent;
+    };
+    struct HEVCShortTermRPS {
+        int numNegative;
+        int numPositive;
+        std::array<int, 16> deltaPocS0;
+        std::array<bool, 16> usedS0;
+        std::array<int, 16> deltaPocS1;
+        std::array<bool, 16> usedS1;
+    };
+    struct HEVCSPS {
+        bool valid;
+        int chromaArrayType;
+        bool separateColourPlane;
+        int log2MaxPocLsb;
+        uint32_t picSizeInCtbs;
+        bool saoEnabled;
+        std::vector<HEVCShortTermRPS> stRps;
+        bool longTermRefPicsPresent;
+        int numLongTermRefPicsSps;
+        std::vector<bool> usedByCurrPicLtSps;
+        bool temporalMvpEnabled;
+    };
+    struct HEVCPPS {
+        bool valid;
+        int spsId;
+        bool dependentSliceSegmentsEnabled;
+        bool outputFlagPresent;
+        int numExtraSliceHeaderBits;
+        bool cabacInitPresent;
+        int numRefIdxDefaultActive[2];
+        int initQP;
+        bool weightedPred;
+        bool weightedBipred;
+        bool listsModificationPresent;
+    };
+    //スライスヘッダの解析結果
+    struct SliceInfo {
+        RGY_FRAMETYPE type;
+        int poc;
+        int qp;
+        int refCount[2];
+        bool firstSliceInPic;
+        bool dependent;
+    };
+
+    //header_bytes > 0 の場合は、NALの先頭header_bytesのみ変換する (truncatedに入力を途中で打ち切ったかを返す)
+    const uint8_t *toRBSP(const nal_info& nal, uint32_t header_bytes, uint32_t& rbsp_size, bool *truncated = nullptr);
+    static uint32_t headerBytes(const nal_info& nal);
+
+    RGY_ERR parseH264SPS(RGYBitReader& br);
+    RGY_ERR parseH264PPS(RGYBitReader& br);
+    RGY_ERR parseH264Slice(RGYBitReader& br, const nal_info& nal, SliceInfo& slice);
+    RGY_ERR analyzeH264(const std::vector<nal_info>& nal_list, RGYBitstreamAUInfo& info);
+
+    RGY_ERR parseHEVCSPS(RGYBitReader& br);
+    RGY_ERR parseHEVCPPS(RGYBitReader& br);
+    RGY_ERR parseHEVCShortTermRPS(RGYBitReader& br, const std::vector<HEVCShortTermRPS>& stRps, int idx, int numStRps, HEVCShortTermRPS& rps);
+    RGY_ERR parseHEVCSlice(RGYBitReader& br, const nal_info& nal, SliceInfo& slice);
+    RGY_ERR analyzeHEVC(const std::vector<nal_info>& nal_list, RGYBitstreamAUInfo& info);
+
+    RGY_CODEC m_codec;
+    std::vector<uint8_t> m_rbsp;    //RBSPへの変換用バッファ
+
+    std::array<H264SPS, 32> m_h264sps;
+    std::array<H264PPS, 256> m_h264pps;
+    //H.264のPOCの計算用
+    int m_h264PrevPocMsb;
+    int m_h264PrevPocLsb;
+    int m_h264PrevFrameNum;
+    int m_h264PrevFrameNumOffset;
+
+    std::array<HEVCSPS, 16> m_hevcsps;
+    std::array<HEVCPPS, 64> m_hevcpps;
+    //HEVCのPOCの計算用 (TemporalId=0の直前のピクチャ)
+    int m_hevcPrevTid0Poc;
+    bool m_hevcFirstPic;
+    SliceInfo m_hevcPrevSlice; //dependent slice segment用
+};
+
+#endif //__RGY_BITSTREAM_ANALYZER_H__
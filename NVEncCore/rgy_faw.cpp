@@ -0,0 +1,399 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include <cmath>
+#include <cstring>
+#include <climits>
+#include <emmintrin.h>
+#include "rgy_faw.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static inline int rgy_ctz32(uint32_t v) {
+#if defined(_MSC_VER)
+    unsigned long idx = 0;
+    _BitScanForward(&idx, v);
+    return (int)idx;
+#else
+    return __builtin_ctz(v);
+#endif
+}
+
+static const double FAW_ZERO_BLOCK_THRESHOLD_RATIO = 0.005;
+static const double FAW_ERROR_TOO_SHORT_RATIO      = 0.2; //音声サンプリングレートに対する割合
+static const int    FAW_ZERO_BLOCK_COUNT_THRESHOLD = 16;  //ゼロブロックが最低秒間いくつあるか
+static const double FAW_ZERO_SUM_RATIO_MIN[3]      = { 768.0 / 1536.0, 256.0 / 1536.0, 256.0 / 1536.0 }; //全体に対するゼロの数下限(フルサイズ, ハーフサイズ)
+static const double FAW_ZERO_SUM_RATIO_MAX         = 0.99479; //全体に対するゼロの数上限
+static const double FAW_ZERO_SD_RATIO              = 0.25;    //ゼロブロック内のゼロの平均数に対する標準偏差
+static const size_t FAW_BUF_COMPACT_BYTES          = 64 * 1024; //処理済みのバイト列を捨てる単位
+
+RGY_ERR rgy_faw_check(RGYFAWMode *mode, const int16_t *pcm, int count, int stride, int rate) {
+    *mode = RGY_FAW_NONE;
+    //十分な音声があるかチェック
+    if (count < rate * FAW_ERROR_TOO_SHORT_RATIO) {
+        return RGY_ERR_MORE_DATA;
+    }
+    std::vector<int> zero_blocks[3];
+    int current_zero_blocks[3] = { 0, 0, 0 };
+    const int zero_block_threshold = (int)(rate * FAW_ZERO_BLOCK_THRESHOLD_RATIO);
+
+    //ゼロブロックを数える
+    //  [0]: フルサイズの0, [1]: ハーフサイズ(上位8bit)の0, [2]: ハーフサイズ(下位8bit)の0
+    const int16_t *const fin = pcm + (size_t)count * stride;
+    for (const int16_t *data = pcm; data < fin; data += stride) {
+        const int check[3] = { *data, (uint8_t)((*data >> 8) + 128), (uint8_t)((*data & 0xff) + 128) };
+        for (int i = 0; i < 3; i++) {
+            if (check[i] == 0) {
+                current_zero_blocks[i]++;
+            } else {
+                if (current_zero_blocks[i] >= zero_block_threshold)
+                    zero_blocks[i].push_back(current_zero_blocks[i]);
+                current_zero_blocks[i] = 0;
+            }
+        }
+    }
+
+    //ゼロブロックをチェック
+    bool check_result[3] = { false, false, false };
+    for (int i = 0; i < 3; i++) {
+        if (zero_blocks[i].size() < 2
+            || zero_blocks[i].size() < (size_t)((int64_t)count * FAW_ZERO_BLOCK_COUNT_THRESHOLD / rate))
+            continue;
+        int64_t zero_sum = 0;
+        for (auto zero_len : zero_blocks[i])
+            zero_sum += zero_len;
+        if (zero_sum < count * FAW_ZERO_SUM_RATIO_MIN[i] || zero_sum > count * FAW_ZERO_SUM_RATIO_MAX)
+            continue;
+        const double zero_avg = zero_sum / (double)(zero_blocks[i].size());
+        double zero_sd = 0;
+        for (auto zero_len : zero_blocks[i])
+            zero_sd += (zero_len - zero_avg) * (zero_len - zero_avg);
+        zero_sd = std::sqrt(zero_sd / (zero_blocks[i].size() - 1));
+        if (zero_sd > zero_avg * FAW_ZERO_SD_RATIO)
+            continue;
+        //ここまで来たらFAW
+        check_result[i] = true;
+    }
+    check_result[2] &= check_result[1];
+    if (check_result[2]) {
+        *mode = RGY_FAW_MIX;
+    } else if (check_result[1]) {
+        *mode = RGY_FAW_HALF;
+    } else if (check_result[0]) {
+        *mode = RGY_FAW_FULL;
+    }
+    return RGY_ERR_NONE;
+}
+
+size_t rgy_faw_zero_run(const uint8_t *ptr, size_t size) {
+    size_t i = 0;
+    const __m128i xZero = _mm_setzero_si128();
+    for (; i + 32 <= size; i += 32) {
+        const __m128i x0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(ptr + i +  0)), xZero);
+        const __m128i x1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(ptr + i + 16)), xZero);
+        const uint32_t mask = (uint32_t)_mm_movemask_epi8(x0) | ((uint32_t)_mm_movemask_epi8(x1) << 16);
+        if (mask != 0xffffffffu) {
+            return i + rgy_ctz32(~mask);
+        }
+    }
+    for (; i < size && ptr[i] == 0; i++)
+        ;
+    return i;
+}
+
+static const int AAC_SAMPLE_RATE_LIST[] = {
+    96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350
+};
+
+RGYAACHeader::RGYAACHeader() :
+    profile(0), sampleRateIdx(0), sampleRate(0), channelConfig(0), frameLength(0), headerLength(0), rawBlocks(0) {
+}
+
+void RGYAACHeader::set(int profile_, int sampleRate_, int channels_) {
+    profile = profile_;
+    sampleRateIdx = 3; //48kHz
+    for (int i = 0; i < _countof(AAC_SAMPLE_RATE_LIST); i++) {
+        if (AAC_SAMPLE_RATE_LIST[i] == sampleRate_) {
+            sampleRateIdx = i;
+            break;
+        }
+    }
+    sampleRate    = AAC_SAMPLE_RATE_LIST[sampleRateIdx];
+    channelConfig = (channels_ == 8) ? 7 : ((1 <= channels_ && channels_ <= 6) ? channels_ : 2);
+    frameLength   = 0;
+    headerLength  = 0;
+    rawBlocks     = 1;
+}
+
+bool RGYAACHeader::parse(const uint8_t *ptr, size_t size) {
+    if (size < 7
+        || ptr[0] != 0xFF
+        || (ptr[1] & 0xF6) != 0xF0) { //syncword + layer(=0)
+        return false;
+    }
+    const int profile_ = ptr[2] >> 6;
+    const int sampleRateIdx_ = (ptr[2] >> 2) & 0x0F;
+    if (profile_ == 3 || sampleRateIdx_ >= _countof(AAC_SAMPLE_RATE_LIST)) {
+        return false;
+    }
+    const int headerLength_ = (ptr[1] & 0x01) ? 7 : 9;
+    const int frameLength_ = ((ptr[3] & 0x03) << 11) | (ptr[4] << 3) | (ptr[5] >> 5);
+    if (frameLength_ <= headerLength_) {
+        return false;
+    }
+    profile       = profile_;
+    sampleRateIdx = sampleRateIdx_;
+    sampleRate    = AAC_SAMPLE_RATE_LIST[sampleRateIdx_];
+    channelConfig = ((ptr[2] & 0x01) << 2) | (ptr[3] >> 6);
+    frameLength   = frameLength_;
+    headerLength  = headerLength_;
+    rawBlocks     = (ptr[6] & 0x03) + 1;
+    return true;
+}
+
+bool RGYAACHeader::sameFormat(const RGYAACHeader& h) const {
+    return profile == h.profile
+        && sampleRateIdx == h.sampleRateIdx
+        && channelConfig == h.channelConfig;
+}
+
+int RGYAACHeader::channels() const {
+    switch (channelConfig) {
+    case 0:  return 2; //PCEで指定される場合は不明なので、ステレオとしておく
+    case 7:  return 8;
+    default: return channelConfig;
+    }
+}
+
+int RGYAACHeader::samples() const {
+    return RGY_AAC_FRAME_SAMPLES * rawBlocks;
+}
+
+std::vector<uint8_t> RGYAACHeader::audioSpecificConfig() const {
+    //audioObjectType(5) samplingFrequencyIndex(4) channelConfiguration(4) GASpecificConfig(3)
+    const int objectType = profile + 1;
+    std::vector<uint8_t> asc(2);
+    asc[0] = (uint8_t)((objectType << 3) | (sampleRateIdx >> 1));
+    asc[1] = (uint8_t)(((sampleRateIdx & 0x01) << 7) | (channelConfig << 3));
+    return asc;
+}
+
+RGYFAWDecoder::RGYFAWDecoder() :
+    m_mode(RGY_FAW_NONE),
+    m_mixIdx(0),
+    m_detectBuf(),
+    m_buf(),
+    m_bufPos(0),
+    m_bufOffset(0),
+    m_pcmRemain(),
+    m_pcmRemainSize(0),
+    m_header(),
+    m_skipped(0) {
+}
+
+RGYFAWDecoder::~RGYFAWDecoder() {
+}
+
+void RGYFAWDecoder::init(RGYFAWMode mode, int mixIdx) {
+    m_mode = mode;
+    m_mixIdx = (mode == RGY_FAW_MIX) ? mixIdx : 0;
+    m_detectBuf.clear();
+    m_buf.clear();
+    m_bufPos = 0;
+    m_bufOffset = 0;
+    m_pcmRemainSize = 0;
+    m_header = RGYAACHeader();
+    m_skipped = 0;
+}
+
+//ハーフサイズ: 16bitの上位(shift=8)または下位(shift=0)の8bitを取り出し、0x80を0に戻す
+static void faw_half_to_bytes(uint8_t *dst, const uint8_t *pcm, size_t samples, int shift) {
+    size_t i = 0;
+    const __m128i xMask = _mm_set1_epi16(0x00ff);
+    const __m128i x80 = _mm_set1_epi8((char)0x80);
+    for (; i + 16 <= samples; i += 16) {
+        __m128i x0 = _mm_loadu_si128((const __m128i *)(pcm + i * 2 +  0));
+        __m128i x1 = _mm_loadu_si128((const __m128i *)(pcm + i * 2 + 16));
+        if (shift) {
+            x0 = _mm_srli_epi16(x0, 8);
+            x1 = _mm_srli_epi16(x1, 8);
+        } else {
+            x0 = _mm_and_si128(x0, xMask);
+            x1 = _mm_and_si128(x1, xMask);
+        }
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(_mm_packus_epi16(x0, x1), x80));
+    }
+    for (; i < samples; i++) {
+        dst[i] = (uint8_t)(pcm[i * 2 + (shift >> 3)] ^ 0x80);
+    }
+}
+
+void RGYFAWDecoder::appendBytes(const uint8_t *pcm, size_t size) {
+    //処理済みの部分を捨てる
+    //パケットごとに詰めるとその都度コピーが発生するので、処理済みの部分がある程度たまり、
+    //かつ未処理の部分より大きくなった場合のみ詰める
+    if (m_bufPos >= FAW_BUF_COMPACT_BYTES && m_bufPos >= m_buf.size() - m_bufPos) {
+        m_buf.erase(m_buf.begin(), m_buf.begin() + m_bufPos);
+        m_bufOffset += m_bufPos;
+        m_bufPos = 0;
+    }
+    if (m_mode == RGY_FAW_FULL) {
+        m_buf.insert(m_buf.end(), pcm, pcm + size);
+        return;
+    }
+    //ハーフサイズは16bit単位で処理する
+    const int shift = (m_mixIdx == 0) ? 8 : 0;
+    if (m_pcmRemainSize > 0 && size > 0) {
+        m_pcmRemain[1] = *pcm;
+        m_buf.push_back(0);
+        faw_half_to_bytes(&m_buf.back(), m_pcmRemain, 1, shift);
+        pcm++;
+        size--;
+        m_pcmRemainSize = 0;
+    }
+    const size_t samples = size / 2;
+    const size_t bufSize = m_buf.size();
+    m_buf.resize(bufSize + samples);
+    faw_half_to_bytes(m_buf.data() + bufSize, pcm, samples, shift);
+    if (size & 1) {
+        m_pcmRemain[0] = pcm[size - 1];
+        m_pcmRemainSize = 1;
+    }
+}
+
+RGY_ERR RGYFAWDecoder::parseBuffer(std::vector<std::vector<uint8_t>>& frames) {
+    const uint8_t *const buf = m_buf.data();
+    const size_t size = m_buf.size();
+    size_t pos = m_bufPos;
+    for (;;) {
+        //フレーム間の無音を読み飛ばす
+        pos += rgy_faw_zero_run(buf + pos, size - pos);
+        if (pos + 8 > size) {
+            break; //判定に必要なデータが揃っていない
+        }
+        const uint8_t *ptr = buf + pos;
+        //プリアンブル(Pa Pb Pc Pd)は読み飛ばす
+        if (ptr[0] == 0x72 && ptr[1] == 0xF8 && ptr[2] == 0x1F && ptr[3] == 0x4E) {
+            pos += 8;
+            continue;
+        }
+        RGYAACHeader header;
+        bool swapped = false;
+        if (!header.parse(ptr, size - pos)) {
+            //フルサイズで16bit単位でバイトが入れ替わって格納されている場合
+            if (m_mode == RGY_FAW_FULL && ((m_bufOffset + pos) & 1) == 0) {
+                const uint8_t tmp[8] = { ptr[1], ptr[0], ptr[3], ptr[2], ptr[5], ptr[4], ptr[7], ptr[6] };
+                swapped = header.parse(tmp, sizeof(tmp));
+            }
+            if (!swapped) {
+                pos++;
+                m_skipped++;
+                continue;
+            }
+        }
+        if (m_header.frameLength > 0 && !header.sameFormat(m_header)) {
+            //途中で形式が変わることはないので、誤検出として扱う
+            pos++;
+            m_skipped++;
+            continue;
+        }
+        const size_t frameBytes = (swapped) ? ((header.frameLength + 1) & ~1) : header.frameLength;
+        if (pos + frameBytes > size) {
+            break; //フレームの途中までしかない
+        }
+        std::vector<uint8_t> frame(ptr, ptr + frameBytes);
+        if (swapped) {
+            for (size_t i = 0; i < frameBytes; i += 2) {
+                std::swap(frame[i], frame[i + 1]);
+            }
+            frame.resize(header.frameLength);
+        }
+        if (m_header.frameLength == 0) {
+            m_header = header;
+        }
+        frames.push_back(std::move(frame));
+        pos += frameBytes;
+    }
+    m_bufPos = pos;
+    return RGY_ERR_NONE;
+}
+
+RGY_ERR RGYFAWDecoder::decode(std::vector<std::vector<uint8_t>>& frames, const uint8_t *pcm, size_t size) {
+    if (m_mode == RGY_FAW_NONE) {
+        //形式が判定できるまで入力を溜めておく
+        m_detectBuf.insert(m_detectBuf.end(), pcm, pcm + size);
+        const auto mode = detect(m_detectBuf.data(), m_detectBuf.size(), nullptr);
+        if (mode == RGY_FAW_NONE) {
+            return (m_detectBuf.size() > RGY_FAW_DETECT_MAX_BYTES) ? RGY_ERR_INVALID_FORMAT : RGY_ERR_NONE;
+        }
+        std::vector<uint8_t> detectBuf;
+        std::swap(detectBuf, m_detectBuf);
+        init(mode, 0);
+        return decode(frames, detectBuf.data(), detectBuf.size());
+    }
+    if (m_mode == RGY_FAW_FULL && m_pcmRemainSize == 0 && m_bufPos == m_buf.size()) {
+        //バッファに何も残っておらず、入力がすべて無音なら、バッファに移さずに読み飛ばす
+        if (rgy_faw_zero_run(pcm, size) == size) {
+            m_bufOffset += m_buf.size() + size;
+            m_buf.clear();
+            m_bufPos = 0;
+            return RGY_ERR_NONE;
+        }
+    }
+    appendBytes(pcm, size);
+    return parseBuffer(frames);
+}
+
+RGYFAWMode RGYFAWDecoder::detect(const uint8_t *pcm, size_t size, RGYAACHeader *header) {
+    std::vector<std::vector<uint8_t>> frames;
+    RGYFAWDecoder dec;
+    for (const auto mode : { RGY_FAW_FULL, RGY_FAW_HALF }) {
+        frames.clear();
+        dec.init(mode, 0);
+        dec.decode(frames, pcm, size);
+        if (frames.size() == 0) {
+            continue;
+        }
+        if (header) {
+            *header = dec.header();
+        }
+        if (mode == RGY_FAW_HALF) {
+            //下位8bitにも別のデータが含まれていればmix
+            frames.clear();
+            dec.init(RGY_FAW_MIX, 1);
+            dec.decode(frames, pcm, size);
+            if (frames.size() > 0) {
+                return RGY_FAW_MIX;
+            }
+        }
+        return mode;
+    }
+    return RGY_FAW_NONE;
+}
@@ -0,0 +1,132 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#pragma once
+#ifndef __RGY_FAW_H__
+#define __RGY_FAW_H__
+
+#include <cstdint>
+#include <vector>
+#include "rgy_osdep.h"
+#include "rgy_err.h"
+
+//FAW (FakeAacWav)
+//  AACのADTSフレームを16bit PCMのwavに見せかけて格納したもの
+//  各フレームはIEC 61937風のプリアンブル(Pa=0xF872, Pb=0x4E1F, Pc, Pd)に続けて格納され、
+//  1フレーム分(1024サンプル)の残りは0(無音)で埋められている
+//  フルサイズ: 16bit PCMのバイト列がそのままデータ
+//  ハーフサイズ: 8bit PCM (16bitでは上位8bit) に1byteずつ格納 (0は0x80として格納される)
+//  ハーフサイズ(mix): 上位8bitと下位8bitにそれぞれ別のハーフサイズのデータが格納される
+enum RGYFAWMode {
+    RGY_FAW_NONE = 0, //FAWではない
+    RGY_FAW_FULL = 1, //フルサイズ
+    RGY_FAW_HALF = 2, //ハーフサイズ
+    RGY_FAW_MIX  = 3, //ハーフサイズ(mix)
+};
+
+static const int RGY_AAC_FRAME_SAMPLES = 1024; //AACの1フレームのサンプル数
+static const size_t RGY_FAW_DETECT_MAX_BYTES = 1024 * 1024; //形式の自動判定に使用する最大のバイト数
+
+//PCMの統計からFAWかどうかを判定する
+//  pcm    ... 16bit PCM
+//  count  ... 1チャンネルあたりのサンプル数
+//  stride ... 1サンプルあたりのshortの数 (チャンネル数)、判定には先頭のチャンネルのみ使用する
+//  rate   ... サンプリング周波数
+//  判定に十分な長さがなければRGY_ERR_MORE_DATA
+RGY_ERR rgy_faw_check(RGYFAWMode *mode, const int16_t *pcm, int count, int stride, int rate);
+
+//先頭から連続する0のバイト数を返す
+size_t rgy_faw_zero_run(const uint8_t *ptr, size_t size);
+
+//ADTSヘッダ
+struct RGYAACHeader {
+    int profile;       //audio object type - 1
+    int sampleRateIdx;
+    int sampleRate;
+    int channelConfig;
+    int frameLength;   //ヘッダを含むフレームのバイト数
+    int headerLength;  //7 (CRCなし) or 9 (CRCあり)
+    int rawBlocks;     //ADTSフレーム内のraw_data_blockの数
+
+    RGYAACHeader();
+    //ADTSヘッダを使わずに形式を設定する
+    void set(int profile, int sampleRate, int channels);
+    //ADTSヘッダとして妥当ならtrue
+    bool parse(const uint8_t *ptr, size_t size);
+    bool sameFormat(const RGYAACHeader& h) const;
+    int channels() const;
+    int samples() const;
+    //mp4/mkv用のAudioSpecificConfig
+    std::vector<uint8_t> audioSpecificConfig() const;
+};
+
+//FAWのPCMからADTSフレームを取り出す
+class RGYFAWDecoder {
+public:
+    RGYFAWDecoder();
+    ~RGYFAWDecoder();
+
+    //mode   ... RGY_FAW_FULL / RGY_FAW_HALF / RGY_FAW_MIX, RGY_FAW_NONEなら入力から自動判定する
+    //mixIdx ... RGY_FAW_MIXの場合、0: 上位8bit, 1: 下位8bit
+    void init(RGYFAWMode mode, int mixIdx);
+    //16bit PCM(バイト列)を入力し、取り出せたADTSフレームをframesに追加する
+    //  PCMはパケットの境界で分割されていてもよい (不完全なフレームは次の入力まで保持する)
+    //  自動判定でRGY_FAW_DETECT_MAX_BYTESを超えてもFAWと判定できなければRGY_ERR_INVALID_FORMAT
+    RGY_ERR decode(std::vector<std::vector<uint8_t>>& frames, const uint8_t *pcm, size_t size);
+    //最初に見つかったADTSヘッダ (見つかっていなければframeLength=0)
+    const RGYAACHeader& header() const {
+        return m_header;
+    }
+    RGYFAWMode mode() const {
+        return m_mode;
+    }
+    //FAWとして解釈できずに読み飛ばしたバイト数
+    uint64_t skippedBytes() const {
+        return m_skipped;
+    }
+
+    //PCMから形式を判定し、最初のADTSヘッダを取得する
+    //  判定できなければRGY_FAW_NONE
+    static RGYFAWMode detect(const uint8_t *pcm, size_t size, RGYAACHeader *header);
+protected:
+    void appendBytes(const uint8_t *pcm, size_t size);
+    RGY_ERR parseBuffer(std::vector<std::vector<uint8_t>>& frames);
+
+    RGYFAWMode m_mode;
+    int m_mixIdx;
+    std::vector<uint8_t> m_detectBuf; //自動判定中の入力
+    std::vector<uint8_t> m_buf; //PCMから取り出したバイト列
+    size_t m_bufPos;            //m_bufの未処理の先頭
+    uint64_t m_bufOffset;       //m_buf[0]の入力先頭からの位置
+    uint8_t m_pcmRemain[2];     //16bitに満たず残ったPCM
+    int m_pcmRemainSize;
+    RGYAACHeader m_header;
+    uint64_t m_skipped;
+};
+
+#endif //__RGY_FAW_H__
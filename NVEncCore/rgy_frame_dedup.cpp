@@ -0,0 +1,196 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <emmintrin.h>
+#include "rgy_frame_dedup.h"
+#include "rgy_simd.h"
+
+static inline uint32_t dedup_hsum64(__m128i x) {
+    x = _mm_add_epi64(x, _mm_srli_si128(x, 8));
+    return (uint32_t)_mm_cvtsi128_si32(x);
+}
+
+static inline uint32_t dedup_hsum32(__m128i x) {
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (uint32_t)_mm_cvtsi128_si32(x);
+}
+
+//ステージングバッファ上のフレームの各平面を取得する
+//セミプレーナ(NV12/P010/NV16/P210)とYUV444以外は輝度のみを比較する
+static int dedup_planes(RGYDedupPlane planes[3], const FrameInfo& frame) {
+    const size_t planeSize = (size_t)frame.pitch * frame.height;
+    planes[0] = { frame.ptr, frame.pitch, frame.width, frame.height };
+    switch (frame.csp) {
+    case RGY_CSP_NV12:
+    case RGY_CSP_P010:
+        planes[1] = { frame.ptr + planeSize, frame.pitch, frame.width, frame.height >> 1 };
+        return 2;
+    case RGY_CSP_NV16:
+    case RGY_CSP_P210:
+        planes[1] = { frame.ptr + planeSize, frame.pitch, frame.width, frame.height };
+        return 2;
+    case RGY_CSP_YUV444:
+    case RGY_CSP_YUV444_09:
+    case RGY_CSP_YUV444_10:
+    case RGY_CSP_YUV444_12:
+    case RGY_CSP_YUV444_14:
+    case RGY_CSP_YUV444_16:
+        planes[1] = { frame.ptr + planeSize,     frame.pitch, frame.width, frame.height };
+        planes[2] = { frame.ptr + planeSize * 2, frame.pitch, frame.width, frame.height };
+        return 3;
+    default:
+        return 1;
+    }
+}
+
+uint32_t dedup_block_sad_c(const RGYDedupPlane& a, const RGYDedupPlane& b, int x0, int bw, int y0, int y1, int shift) {
+    uint32_t sad = 0;
+    for (int y = y0; y < y1; y += 2) {
+        if (shift == 0) {
+            const uint8_t *pa = a.ptr + (size_t)a.pitch * y + x0;
+            const uint8_t *pb = b.ptr + (size_t)b.pitch * y + x0;
+            for (int x = 0; x < bw; x++) {
+                sad += std::abs((int)pa[x] - (int)pb[x]);
+            }
+        } else {
+            const uint16_t *pa = (const uint16_t *)(a.ptr + (size_t)a.pitch * y) + x0;
+            const uint16_t *pb = (const uint16_t *)(b.ptr + (size_t)b.pitch * y) + x0;
+            for (int x = 0; x < bw; x++) {
+                sad += std::abs((int)pa[x] - (int)pb[x]) >> shift;
+            }
+        }
+    }
+    return sad;
+}
+
+uint32_t dedup_block_sad_sse2(const RGYDedupPlane& a, const RGYDedupPlane& b, int x0, int bw, int y0, int y1, int shift) {
+    //右端の幅の足りないブロックはC版で処理する
+    if (bw != RGY_DEDUP_BLOCK_SIZE) {
+        return dedup_block_sad_c(a, b, x0, bw, y0, y1, shift);
+    }
+    if (shift == 0) {
+        __m128i vsad = _mm_setzero_si128();
+        for (int y = y0; y < y1; y += 2) {
+            const uint8_t *pa = a.ptr + (size_t)a.pitch * y + x0;
+            const uint8_t *pb = b.ptr + (size_t)b.pitch * y + x0;
+            vsad = _mm_add_epi64(vsad, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)pa), _mm_loadu_si128((const __m128i *)pb)));
+        }
+        return dedup_hsum64(vsad);
+    } else {
+        const __m128i xshift = _mm_cvtsi32_si128(shift);
+        const __m128i ones = _mm_set1_epi16(1);
+        __m128i vsad = _mm_setzero_si128();
+        for (int y = y0; y < y1; y += 2) {
+            const uint16_t *pa = (const uint16_t *)(a.ptr + (size_t)a.pitch * y) + x0;
+            const uint16_t *pb = (const uint16_t *)(b.ptr + (size_t)b.pitch * y) + x0;
+            for (int x = 0; x < RGY_DEDUP_BLOCK_SIZE; x += 8) {
+                const __m128i va = _mm_loadu_si128((const __m128i *)(pa + x));
+                const __m128i vb = _mm_loadu_si128((const __m128i *)(pb + x));
+                const __m128i diff = _mm_or_si128(_mm_subs_epu16(va, vb), _mm_subs_epu16(vb, va));
+                vsad = _mm_add_epi32(vsad, _mm_madd_epi16(_mm_srl_epi16(diff, xshift), ones));
+            }
+        }
+        return dedup_hsum32(vsad);
+    }
+}
+
+RGYFrameDedup::RGYFrameDedup() :
+    m_blockSad((get_availableSIMD() & AVX2) ? dedup_block_sad_avx2 : dedup_block_sad_sse2),
+    m_threshold(0.0f),
+    m_maxDrop(0),
+    m_run(0),
+    m_stats() {
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+RGYFrameDedup::~RGYFrameDedup() {
+}
+
+void RGYFrameDedup::init(float threshold, int maxDrop) {
+    m_threshold = threshold;
+    m_maxDrop = maxDrop;
+    m_run = 0;
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+bool RGYFrameDedup::isDuplicate(const FrameInfo& a, const FrameInfo& b) const {
+    if (a.width != b.width || a.height != b.height || a.csp != b.csp
+        || a.picstruct != b.picstruct
+        || RGY_CSP_CHROMA_FORMAT[a.csp] == RGY_CHROMAFMT_RGB) {
+        return false;
+    }
+    //P010/P210は上位bitに詰めて格納されている
+    const int bitdepth = (a.csp == RGY_CSP_P010 || a.csp == RGY_CSP_P210) ? 16 : RGY_CSP_BIT_DEPTH[a.csp];
+    const int shift = bitdepth - 8;
+    RGYDedupPlane planeA[3], planeB[3];
+    const int planes = dedup_planes(planeA, a);
+    dedup_planes(planeB, b);
+    //輝度から順に判定し、色差のみが変化した場合も重複とみなさない
+    for (int i = 0; i < planes; i++) {
+        const auto& pa = planeA[i];
+        const auto& pb = planeB[i];
+        for (int y0 = 0; y0 < pa.height; y0 += RGY_DEDUP_BLOCK_SIZE) {
+            const int y1 = (std::min)(y0 + RGY_DEDUP_BLOCK_SIZE, pa.height);
+            const int rows = (y1 - y0 + 1) >> 1;
+            for (int x0 = 0; x0 < pa.width; x0 += RGY_DEDUP_BLOCK_SIZE) {
+                const int bw = (std::min)(RGY_DEDUP_BLOCK_SIZE, pa.width - x0);
+                const uint32_t sad = m_blockSad(pa, pb, x0, bw, y0, y1, shift);
+                //閾値を超えるブロックがあった時点で打ち切る
+                if (sad > m_threshold * (bw * rows)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool RGYFrameDedup::drop(const FrameInfo& ref, const FrameInfo& cur) {
+    const auto start = std::chrono::high_resolution_clock::now();
+    m_stats.frames++;
+    bool dup = isDuplicate(ref, cur);
+    if (dup && m_maxDrop > 0 && m_run >= m_maxDrop) {
+        //長時間同じフレームが続かないよう、上限に達したら残す
+        m_stats.forced++;
+        dup = false;
+    }
+    if (dup) {
+        m_run++;
+        m_stats.dropped++;
+        m_stats.maxRun = (std::max)(m_stats.maxRun, m_run);
+    } else {
+        m_run = 0;
+    }
+    m_stats.analyzeUs += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+    return dup;
+}
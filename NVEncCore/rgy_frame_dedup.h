@@ -0,0 +1,89 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#pragma once
+#ifndef __RGY_FRAME_DEDUP_H__
+#define __RGY_FRAME_DEDUP_H__
+
+#include <cstdint>
+#include "convert_csp.h"
+
+//重複の判定を行うブロックのサイズ (縦方向は1行おきに間引いて比較する)
+static const int RGY_DEDUP_BLOCK_SIZE = 16;
+
+//判定に使用する平面 (幅は画素数、NV12などの色差はUVを並べた状態で1平面として扱う)
+struct RGYDedupPlane {
+    const uint8_t *ptr;
+    int pitch;
+    int width;
+    int height;
+};
+
+//ブロック[x0, x0+bw) x [y0, y1)のSADを1行おきに計算する (8bit換算)
+//shift>0なら16bitの画素として、画素ごとの差をshiftだけ右シフトしてから加算する
+typedef uint32_t (*funcDedupBlockSad)(const RGYDedupPlane& a, const RGYDedupPlane& b, int x0, int bw, int y0, int y1, int shift);
+uint32_t dedup_block_sad_c(const RGYDedupPlane& a, const RGYDedupPlane& b, int x0, int bw, int y0, int y1, int shift);
+uint32_t dedup_block_sad_sse2(const RGYDedupPlane& a, const RGYDedupPlane& b, int x0, int bw, int y0, int y1, int shift);
+uint32_t dedup_block_sad_avx2(const RGYDedupPlane& a, const RGYDedupPlane& b, int x0, int bw, int y0, int y1, int shift);
+
+struct RGYFrameDedupStats {
+    int64_t frames;    //判定したフレーム数
+    int64_t dropped;   //間引いたフレーム数
+    int64_t forced;    //重複だが、連続して間引く上限に達したため残したフレーム数
+    int     maxRun;    //連続して間引いた最大フレーム数
+    double  analyzeUs; //判定にかかった時間の合計
+};
+
+//入力フレームのうち、直前に残したフレームと同一とみなせるものを間引く
+//輝度・色差を1行おきに間引いてブロックごとのSADを計算し、
+//ブロックの平均絶対差の最大値が閾値以下なら重複とみなす
+class RGYFrameDedup {
+public:
+    RGYFrameDedup();
+    ~RGYFrameDedup();
+
+    //threshold ... 重複とみなすブロックの平均絶対差の上限 (8bit換算)
+    //maxDrop   ... 連続して間引く最大フレーム数 (0で無制限)
+    void init(float threshold, int maxDrop);
+
+    //refは直前に残したフレーム、curを間引くかどうかを返す
+    bool drop(const FrameInfo& ref, const FrameInfo& cur);
+
+    //2フレームが同一とみなせるかを判定する
+    bool isDuplicate(const FrameInfo& a, const FrameInfo& b) const;
+
+    const RGYFrameDedupStats& stats() const { return m_stats; }
+protected:
+    funcDedupBlockSad m_blockSad;
+    float m_threshold;
+    int m_maxDrop;
+    int m_run;
+    RGYFrameDedupStats m_stats;
+};
+
+#endif //__RGY_FRAME_DEDUP_H__
@@ -0,0 +1,96 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#define USE_SSE2  1
+#define USE_SSSE3 1
+#define USE_SSE41 1
+#define USE_AVX   1
+#define USE_AVX2  1
+
+#include "rgy_simd.h"
+#include <stdint.h>
+#include <immintrin.h>
+#include "rgy_osdep.h"
+#include "rgy_frame_dedup.h"
+
+#if _MSC_VER >= 1800 && !defined(__AVX__) && !defined(_DEBUG)
+static_assert(false, "do not forget to set /arch:AVX or /arch:AVX2 for this file.");
+#endif
+
+#if defined(_MSC_VER) || defined(__AVX2__)
+
+static RGY_FORCEINLINE __m128i dedup_add_hi_lo(__m256i y) {
+    return _mm_add_epi32(_mm256_castsi256_si128(y), _mm256_extracti128_si256(y, 1));
+}
+
+//8bitは1行が16byteなので、比較する2行(y, y+2)を256bitにまとめて処理し、
+//16bitは1行が32byteなので、1行ずつ256bitで処理する
+uint32_t dedup_block_sad_avx2(const RGYDedupPlane& a, const RGYDedupPlane& b, int x0, int bw, int y0, int y1, int shift) {
+    //右端の幅の足りないブロックはC版で処理する
+    if (bw != RGY_DEDUP_BLOCK_SIZE) {
+        return dedup_block_sad_c(a, b, x0, bw, y0, y1, shift);
+    }
+    if (shift == 0) {
+        __m256i ysad = _mm256_setzero_si256();
+        int y = y0;
+        for (; y + 2 < y1; y += 4) {
+            const uint8_t *pa = a.ptr + (size_t)a.pitch * y + x0;
+            const uint8_t *pb = b.ptr + (size_t)b.pitch * y + x0;
+            const __m256i ya = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)pa)), _mm_loadu_si128((const __m128i *)(pa + a.pitch * 2)), 1);
+            const __m256i yb = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)pb)), _mm_loadu_si128((const __m128i *)(pb + b.pitch * 2)), 1);
+            ysad = _mm256_add_epi64(ysad, _mm256_sad_epu8(ya, yb));
+        }
+        //SADの結果は16bit以内なので、32bitとして加算してよい
+        __m128i xsad = dedup_add_hi_lo(ysad);
+        if (y < y1) {
+            const uint8_t *pa = a.ptr + (size_t)a.pitch * y + x0;
+            const uint8_t *pb = b.ptr + (size_t)b.pitch * y + x0;
+            xsad = _mm_add_epi32(xsad, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)pa), _mm_loadu_si128((const __m128i *)pb)));
+        }
+        xsad = _mm_add_epi32(xsad, _mm_srli_si128(xsad, 8));
+        return (uint32_t)_mm_cvtsi128_si32(xsad);
+    } else {
+        const __m128i xshift = _mm_cvtsi32_si128(shift);
+        const __m256i ones = _mm256_set1_epi16(1);
+        __m256i ysad = _mm256_setzero_si256();
+        for (int y = y0; y < y1; y += 2) {
+            const uint16_t *pa = (const uint16_t *)(a.ptr + (size_t)a.pitch * y) + x0;
+            const uint16_t *pb = (const uint16_t *)(b.ptr + (size_t)b.pitch * y) + x0;
+            const __m256i ya = _mm256_loadu_si256((const __m256i *)pa);
+            const __m256i yb = _mm256_loadu_si256((const __m256i *)pb);
+            const __m256i diff = _mm256_or_si256(_mm256_subs_epu16(ya, yb), _mm256_subs_epu16(yb, ya));
+            ysad = _mm256_add_epi32(ysad, _mm256_madd_epi16(_mm256_srl_epi16(diff, xshift), ones));
+        }
+        __m128i xsad = dedup_add_hi_lo(ysad);
+        xsad = _mm_add_epi32(xsad, _mm_shuffle_epi32(xsad, _MM_SHUFFLE(1, 0, 3, 2)));
+        xsad = _mm_add_epi32(xsad, _mm_shuffle_epi32(xsad, _MM_SHUFFLE(2, 3, 0, 1)));
+        return (uint32_t)_mm_cvtsi128_si32(xsad);
+    }
+}
+
+#endif //#if defined(_MSC_VER) || defined(__AVX2__)
@@ -0,0 +1,199 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include "rgy_frame_fanout.h"
+
+static inline int64_t fanout_time_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+RGYFrameFanout::RGYFrameFanout() :
+    m_mtx(),
+    m_cvFree(),
+    m_cvQueue(),
+    m_refCount(),
+    m_acquired(),
+    m_queue(),
+    m_bFinished(false),
+    m_bAbort(false),
+    m_stats(),
+    m_outputStats() {
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+RGYFrameFanout::~RGYFrameFanout() {
+    abort();
+}
+
+int RGYFrameFanout::init(int slots, int outputs) {
+    if (slots < RGY_FRAME_FANOUT_SLOTS_MIN || outputs <= 0) {
+        return 1;
+    }
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_refCount.assign(slots, 0);
+    m_acquired.assign(slots, false);
+    m_queue.clear();
+    m_queue.resize(outputs);
+    m_bFinished = false;
+    m_bAbort = false;
+    memset(&m_stats, 0, sizeof(m_stats));
+    OutputStats outputStats;
+    memset(&outputStats, 0, sizeof(outputStats));
+    m_outputStats.assign(outputs, outputStats);
+    return 0;
+}
+
+int RGYFrameFanout::acquire() {
+    std::unique_lock<std::mutex> lock(m_mtx);
+    auto find_free = [&]() {
+        for (int i = 0; i < (int)m_refCount.size(); i++) {
+            if (m_refCount[i] == 0 && !m_acquired[i]) {
+                return i;
+            }
+        }
+        return -1;
+    };
+    int slot = find_free();
+    if (slot < 0 && !m_bAbort) {
+        //一番遅い出力がスロットを解放するまで待機する
+        const auto waitStart = fanout_time_us();
+        m_cvFree.wait(lock, [&]() { return m_bAbort || (slot = find_free()) >= 0; });
+        m_stats.stalls++;
+        m_stats.stallUs += fanout_time_us() - waitStart;
+    }
+    if (m_bAbort) {
+        return -1;
+    }
+    m_acquired[slot] = true;
+    m_stats.inuse++;
+    return slot;
+}
+
+void RGYFrameFanout::publish(int slot) {
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        if (slot < 0 || slot >= (int)m_refCount.size() || !m_acquired[slot]) {
+            return;
+        }
+        m_acquired[slot] = false;
+        m_refCount[slot] = (int)m_queue.size();
+        for (size_t i = 0; i < m_queue.size(); i++) {
+            m_queue[i].push_back(slot);
+            m_outputStats[i].maxQueue = (std::max)(m_outputStats[i].maxQueue, (int)m_queue[i].size());
+        }
+        m_stats.frames++;
+    }
+    m_cvQueue.notify_all();
+}
+
+int RGYFrameFanout::pop(int output) {
+    std::unique_lock<std::mutex> lock(m_mtx);
+    if (output < 0 || output >= (int)m_queue.size()) {
+        return -1;
+    }
+    auto& queue = m_queue[output];
+    if (queue.empty() && !m_bFinished && !m_bAbort) {
+        const auto waitStart = fanout_time_us();
+        m_cvQueue.wait(lock, [&]() { return m_bAbort || m_bFinished || !queue.empty(); });
+        m_outputStats[output].waitUs += fanout_time_us() - waitStart;
+    }
+    if (m_bAbort || queue.empty()) {
+        return -1;
+    }
+    const int slot = queue.front();
+    queue.pop_front();
+    m_outputStats[output].frames++;
+    return slot;
+}
+
+void RGYFrameFanout::release(int slot) {
+    bool freed = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        if (slot < 0 || slot >= (int)m_refCount.size() || m_refCount[slot] <= 0) {
+            return;
+        }
+        if (--m_refCount[slot] == 0) {
+            m_stats.inuse--;
+            freed = true;
+        }
+    }
+    if (freed) {
+        m_cvFree.notify_all();
+    }
+}
+
+void RGYFrameFanout::finish() {
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_bFinished = true;
+    }
+    m_cvQueue.notify_all();
+}
+
+void RGYFrameFanout::abort() {
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_bAbort = true;
+    }
+    m_cvFree.notify_all();
+    m_cvQueue.notify_all();
+}
+
+bool RGYFrameFanout::aborted() const {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_bAbort;
+}
+
+int RGYFrameFanout::slots() const {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return (int)m_refCount.size();
+}
+
+int RGYFrameFanout::outputs() const {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return (int)m_queue.size();
+}
+
+RGYFrameFanout::Stats RGYFrameFanout::stats() const {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_stats;
+}
+
+RGYFrameFanout::OutputStats RGYFrameFanout::stats(int output) const {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (output < 0 || output >= (int)m_outputStats.size()) {
+        OutputStats outputStats;
+        memset(&outputStats, 0, sizeof(outputStats));
+        return outputStats;
+    }
+    return m_outputStats[output];
+}
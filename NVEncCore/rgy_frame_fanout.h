@@ -0,0 +1,96 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#pragma once
+#ifndef __RGY_FRAME_FANOUT_H__
+#define __RGY_FRAME_FANOUT_H__
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+static const int RGY_FRAME_FANOUT_SLOTS_MIN = 2;
+
+//1つの入力フレームを複数の出力(レンディション)へ分配するための管理
+//  プールのスロットを参照カウントで管理し、すべての出力が解放した時点で再利用可能とする
+//  一番遅い出力がプールを使い切ると、acquire()で待機することで入力側を律速する
+//  スロットの実体(GPUメモリ等)は呼び出し側で管理し、ここではスロットの状態のみを扱う
+class RGYFrameFanout {
+public:
+    struct OutputStats {
+        int64_t frames;       //出力に渡したフレーム数
+        int64_t waitUs;       //出力側がフレームを待機した合計時間
+        int     maxQueue;     //出力側のキューの最大長
+    };
+    struct Stats {
+        int64_t frames;       //分配したフレーム数
+        int64_t stalls;       //空きスロットを待機した回数
+        int64_t stallUs;      //空きスロットを待機した合計時間
+        int     inuse;        //使用中のスロット数
+    };
+
+    RGYFrameFanout();
+    ~RGYFrameFanout();
+
+    //slots: プールのスロット数, outputs: 分配先の数
+    int init(int slots, int outputs);
+
+    //空きスロットを取得する (空きがなければ待機、中断された場合は-1)
+    int acquire();
+    //スロットへのフレームの格納が完了したので、すべての出力へ分配する
+    void publish(int slot);
+    //指定した出力の次のフレームのスロットを取得する (待機あり、終了または中断された場合は-1)
+    int pop(int output);
+    //出力側でのスロットの使用が終了した
+    void release(int slot);
+    //入力の終了を通知する
+    void finish();
+    //待機中のスレッドをすべて解除し、以降の待機を行わない
+    void abort();
+
+    bool aborted() const;
+    int slots() const;
+    int outputs() const;
+    Stats stats() const;
+    OutputStats stats(int output) const;
+protected:
+    mutable std::mutex             m_mtx;
+    std::condition_variable        m_cvFree;      //スロットの解放を通知
+    std::condition_variable        m_cvQueue;     //出力キューの更新を通知
+    std::vector<int>               m_refCount;    //スロットごとの参照カウント (0で空き)
+    std::vector<bool>              m_acquired;    //スロットが入力側に確保されているか
+    std::vector<std::deque<int>>   m_queue;       //出力ごとのキュー
+    bool                           m_bFinished;
+    bool                           m_bAbort;
+    Stats                          m_stats;
+    std::vector<OutputStats>       m_outputStats;
+};
+
+#endif //__RGY_FRAME_FANOUT_H__
@@ -0,0 +1,361 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+#include <chrono>
+#include <algorithm>
+#include "rgy_frame_shm.h"
+#include "rgy_event.h"
+#include "rgy_util.h"
+
+static inline uint32_t frame_shm_align(uint32_t size) {
+    return (size + RGY_FRAME_SHM_ALIGN - 1) & ~(RGY_FRAME_SHM_ALIGN - 1);
+}
+
+RGYFrameShm::RGYFrameShm() :
+    m_name(),
+    m_owner(false),
+    m_ptr(nullptr),
+    m_size(0),
+    m_header(nullptr),
+    m_index(0),
+    m_acquired(false),
+    m_fin(false),
+    m_peerPid(0),
+    m_attachTimeout(RGY_FRAME_SHM_ATTACH_TIMEOUT),
+    m_createTime(),
+#if defined(_WIN32) || defined(_WIN64)
+    m_hMap(NULL),
+    m_hSemFree(NULL),
+    m_hSemFilled(NULL) {
+#else
+    m_fd(-1),
+    m_hSemFree(nullptr),
+    m_hSemFilled(nullptr) {
+#endif
+}
+
+RGYFrameShm::~RGYFrameShm() {
+    close();
+}
+
+RGY_ERR RGYFrameShm::create(const tstring& name, const RGYFrameShmInfo& info, int slotCount, uint32_t attachTimeout) {
+    close();
+    if (name.length() == 0 || slotCount <= 0 || info.frameSize == 0) {
+        return RGY_ERR_INVALID_PARAM;
+    }
+    m_name = name;
+    m_owner = true;
+    m_attachTimeout = attachTimeout;
+    m_createTime = std::chrono::steady_clock::now();
+
+    const uint32_t headerSize = frame_shm_align(sizeof(RGYFrameShmHeader));
+    const uint32_t slotDataOffset = frame_shm_align(sizeof(RGYFrameShmSlot));
+    const uint32_t slotSize = slotDataOffset + frame_shm_align(info.frameSize);
+    auto err = osCreate(headerSize + (size_t)slotSize * slotCount, slotCount);
+    if (err != RGY_ERR_NONE) {
+        close();
+        return err;
+    }
+    memset(m_ptr, 0, headerSize);
+    m_header = (RGYFrameShmHeader *)m_ptr;
+    m_header->version = RGY_FRAME_SHM_VERSION;
+    m_header->headerSize = headerSize;
+    m_header->slotCount = slotCount;
+    m_header->slotSize = slotSize;
+    m_header->slotDataOffset = slotDataOffset;
+    m_header->pidProducer = rgy_frame_shm_pid();
+    m_header->info = info;
+    m_header->magic = RGY_FRAME_SHM_MAGIC;
+    return RGY_ERR_NONE;
+}
+
+RGY_ERR RGYFrameShm::open(const tstring& name) {
+    close();
+    if (name.length() == 0) {
+        return RGY_ERR_INVALID_PARAM;
+    }
+    m_name = name;
+    m_owner = false;
+    auto err = osOpen();
+    if (err != RGY_ERR_NONE) {
+        close();
+        return err;
+    }
+    m_header = (RGYFrameShmHeader *)m_ptr;
+    if (m_size < sizeof(RGYFrameShmHeader)
+        || m_header->magic != RGY_FRAME_SHM_MAGIC
+        || m_header->version != RGY_FRAME_SHM_VERSION) {
+        close();
+        return RGY_ERR_INVALID_VERSION;
+    }
+    if (m_header->slotCount == 0
+        || m_header->slotDataOffset < sizeof(RGYFrameShmSlot)
+        || m_header->slotSize < m_header->slotDataOffset + m_header->info.frameSize
+        || m_size < m_header->headerSize + (size_t)m_header->slotSize * m_header->slotCount) {
+        close();
+        return RGY_ERR_INVALID_FORMAT;
+    }
+    m_header->pidConsumer = rgy_frame_shm_pid();
+    return RGY_ERR_NONE;
+}
+
+void RGYFrameShm::close() {
+    osClose();
+    m_header = nullptr;
+    m_ptr = nullptr;
+    m_size = 0;
+    m_index = 0;
+    m_acquired = false;
+    m_fin = false;
+    m_owner = false;
+    m_peerPid = 0;
+    m_name.clear();
+}
+
+uint8_t *RGYFrameShm::slotPtr(uint32_t index) const {
+    return m_ptr + m_header->headerSize + (size_t)m_header->slotSize * (index % m_header->slotCount);
+}
+
+void RGYFrameShm::setAbort() {
+    if (m_header) {
+        m_header->abort = 1;
+    }
+}
+
+bool RGYFrameShm::aborted() const {
+    return m_header && m_header->abort != 0;
+}
+
+bool RGYFrameShm::peerAlive() const {
+    if (m_header == nullptr) {
+        return false;
+    }
+    uint32_t pid = (m_owner) ? m_header->pidConsumer : m_header->pidProducer;
+    if (pid == 0) {
+        //参照側がまだ開いていない
+        if (m_peerPid != 0) {
+            //起動したプロセスがわかっていれば、その終了を確認する
+            pid = m_peerPid;
+        } else {
+            //わからなければ、一定時間内に開かれなければ終了したとみなす
+            const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_createTime).count();
+            return m_attachTimeout == INFINITE || elapsed < (int64_t)m_attachTimeout;
+        }
+    }
+    return osProcessAlive(pid);
+}
+
+RGY_ERR RGYFrameShm::wait(bool filled, uint32_t timeout) {
+    //相手側の中断やプロセスの終了を検出できるよう、一定間隔で待機を区切る
+    uint32_t waited = 0;
+    for (;;) {
+        if (aborted()) {
+            return RGY_ERR_ABORTED;
+        }
+        const uint32_t slice = (timeout == INFINITE) ? RGY_FRAME_SHM_CHECK_INTERVAL : (std::min)(timeout - waited, RGY_FRAME_SHM_CHECK_INTERVAL);
+        auto err = waitOnce(filled, slice);
+        if (err != RGY_WRN_DEVICE_BUSY) {
+            return err;
+        }
+        if (!peerAlive()) {
+            return RGY_ERR_ABORTED;
+        }
+        waited += slice;
+        if (timeout != INFINITE && waited >= timeout) {
+            return RGY_WRN_DEVICE_BUSY;
+        }
+    }
+}
+
+RGY_ERR RGYFrameShm::acquireWrite(RGYFrameShmSlot **slot, uint8_t **data, uint32_t timeout) {
+    if (m_header == nullptr || !m_owner || m_acquired || m_fin) {
+        return RGY_ERR_INVALID_CALL;
+    }
+    auto err = wait(false, timeout);
+    if (err != RGY_ERR_NONE) {
+        return err;
+    }
+    auto ptr = slotPtr(m_index);
+    *slot = (RGYFrameShmSlot *)ptr;
+    memset(*slot, 0, sizeof(RGYFrameShmSlot));
+    *data = ptr + m_header->slotDataOffset;
+    m_acquired = true;
+    return RGY_ERR_NONE;
+}
+
+RGY_ERR RGYFrameShm::submitWrite() {
+    if (m_header == nullptr || !m_owner || !m_acquired) {
+        return RGY_ERR_INVALID_CALL;
+    }
+    m_index++;
+    m_acquired = false;
+    post(true);
+    return RGY_ERR_NONE;
+}
+
+RGY_ERR RGYFrameShm::finish(uint32_t timeout) {
+    if (m_fin) {
+        return RGY_ERR_NONE;
+    }
+    RGYFrameShmSlot *slot = nullptr;
+    uint8_t *data = nullptr;
+    auto err = acquireWrite(&slot, &data, timeout);
+    if (err != RGY_ERR_NONE) {
+        return err;
+    }
+    slot->flags = RGY_FRAME_SHM_SLOT_EOS;
+    err = submitWrite();
+    m_fin = true;
+    return err;
+}
+
+RGY_ERR RGYFrameShm::acquireRead(const RGYFrameShmSlot **slot, const uint8_t **data, uint32_t timeout) {
+    if (m_header == nullptr || m_owner || m_acquired) {
+        return RGY_ERR_INVALID_CALL;
+    }
+    if (m_fin) {
+        return RGY_ERR_MORE_DATA;
+    }
+    auto err = wait(true, timeout);
+    if (err != RGY_ERR_NONE) {
+        return err;
+    }
+    auto ptr = slotPtr(m_index);
+    auto pSlot = (const RGYFrameShmSlot *)ptr;
+    if (pSlot->flags & RGY_FRAME_SHM_SLOT_EOS) {
+        m_index++;
+        m_fin = true;
+        post(false);
+        return RGY_ERR_MORE_DATA;
+    }
+    *slot = pSlot;
+    *data = ptr + m_header->slotDataOffset;
+    m_acquired = true;
+    return RGY_ERR_NONE;
+}
+
+RGY_ERR RGYFrameShm::releaseRead() {
+    if (m_header == nullptr || m_owner || !m_acquired) {
+        return RGY_ERR_INVALID_CALL;
+    }
+    m_index++;
+    m_acquired = false;
+    post(false);
+    return RGY_ERR_NONE;
+}
+
+tstring RGYFrameShm::genName(const TCHAR *prefix) {
+    const auto tick = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    return strsprintf(_T("%s_%u_%llx"), prefix, rgy_frame_shm_pid(), (unsigned long long)tick);
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+uint32_t rgy_frame_shm_pid() {
+    return (uint32_t)GetCurrentProcessId();
+}
+
+RGY_ERR RGYFrameShm::osCreate(size_t size, uint32_t slotCount) {
+    m_hMap = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)(size & 0xffffffff), m_name.c_str());
+    if (m_hMap == NULL) {
+        return RGY_ERR_MEMORY_ALLOC;
+    }
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        return RGY_ERR_ALREADY_INITIALIZED;
+    }
+    if (nullptr == (m_ptr = (uint8_t *)MapViewOfFile(m_hMap, FILE_MAP_ALL_ACCESS, 0, 0, size))) {
+        return RGY_ERR_MAP_FAILED;
+    }
+    m_size = size;
+    m_hSemFree   = CreateSemaphore(NULL, slotCount, slotCount, (m_name + _T("_free")).c_str());
+    m_hSemFilled = CreateSemaphore(NULL, 0,         slotCount, (m_name + _T("_filled")).c_str());
+    if (m_hSemFree == NULL || m_hSemFilled == NULL) {
+        return RGY_ERR_INVALID_HANDLE;
+    }
+    return RGY_ERR_NONE;
+}
+
+RGY_ERR RGYFrameShm::osOpen() {
+    if (NULL == (m_hMap = OpenFileMapping(FILE_MAP_ALL_ACCESS, FALSE, m_name.c_str()))) {
+        return RGY_ERR_NOT_FOUND;
+    }
+    if (nullptr == (m_ptr = (uint8_t *)MapViewOfFile(m_hMap, FILE_MAP_ALL_ACCESS, 0, 0, 0))) {
+        return RGY_ERR_MAP_FAILED;
+    }
+    MEMORY_BASIC_INFORMATION mbi = { 0 };
+    if (VirtualQuery(m_ptr, &mbi, sizeof(mbi)) == 0) {
+        return RGY_ERR_MAP_FAILED;
+    }
+    m_size = mbi.RegionSize;
+    m_hSemFree   = OpenSemaphore(SEMAPHORE_ALL_ACCESS, FALSE, (m_name + _T("_free")).c_str());
+    m_hSemFilled = OpenSemaphore(SEMAPHORE_ALL_ACCESS, FALSE, (m_name + _T("_filled")).c_str());
+    if (m_hSemFree == NULL || m_hSemFilled == NULL) {
+        return RGY_ERR_INVALID_HANDLE;
+    }
+    return RGY_ERR_NONE;
+}
+
+void RGYFrameShm::osClose() {
+    if (m_ptr) {
+        UnmapViewOfFile(m_ptr);
+    }
+    if (m_hMap) {
+        CloseHandle(m_hMap);
+        m_hMap = NULL;
+    }
+    if (m_hSemFree) {
+        CloseHandle(m_hSemFree);
+        m_hSemFree = NULL;
+    }
+    if (m_hSemFilled) {
+        CloseHandle(m_hSemFilled);
+        m_hSemFilled = NULL;
+    }
+}
+
+RGY_ERR RGYFrameShm::waitOnce(bool filled, uint32_t timeout) {
+    switch (WaitForSingleObject((filled) ? m_hSemFilled : m_hSemFree, timeout)) {
+    case WAIT_OBJECT_0: return RGY_ERR_NONE;
+    case WAIT_TIMEOUT:  return RGY_WRN_DEVICE_BUSY;
+    default:            return RGY_ERR_INVALID_HANDLE;
+    }
+}
+
+void RGYFrameShm::post(bool filled) {
+    ReleaseSemaphore((filled) ? m_hSemFilled : m_hSemFree, 1, NULL);
+}
+
+bool RGYFrameShm::osProcessAlive(uint32_t pid) {
+    HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (hProcess == NULL) {
+        return false;
+    }
+    DWORD exitCode = 0;
+    const bool alive = GetExitCodeProcess(hProcess, &exitCode) && exitCode == STILL_ACTIVE;
+    CloseHandle(hProcess);
+    return alive;
+}
+#endif //#if defined(_WIN32) || defined(_WIN64)
@@ -0,0 +1,182 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+#pragma once
+#ifndef __RGY_FRAME_SHM_H__
+#define __RGY_FRAME_SHM_H__
+
+#include <cstdint>
+#include <chrono>
+#include "rgy_osdep.h"
+#include "rgy_util.h"
+#include "rgy_event.h"
+#include "rgy_err.h"
+
+#if !(defined(_WIN32) || defined(_WIN64))
+#include <semaphore.h>
+#endif
+
+//共有メモリによるフレームの受け渡し
+//  作成側(producer)が共有メモリとセマフォを作成し、エンコーダの入力形式に変換済みのフレームをスロットに書き込む
+//  参照側(consumer)はスロットから読み込み (入力バッファへの1回のコピー)、読み終わったらスロットを返却する
+//  空きスロットがなければ作成側は待機する (back-pressure)
+static const uint32_t RGY_FRAME_SHM_MAGIC   = 0x53594752; //'RGYS'
+static const uint32_t RGY_FRAME_SHM_VERSION = 1;
+static const int RGY_FRAME_SHM_SLOTS_DEFAULT = 4;
+static const uint32_t RGY_FRAME_SHM_ALIGN = 64;
+static const uint32_t RGY_FRAME_SHM_CHECK_INTERVAL = 100; //相手側の状態を確認する間隔 (ms)
+static const uint32_t RGY_FRAME_SHM_ATTACH_TIMEOUT = 60000; //作成側: 参照側が開くまで待つ時間 (ms)
+
+enum RGYFrameShmSlotFlags : uint32_t {
+    RGY_FRAME_SHM_SLOT_NONE = 0x00,
+    RGY_FRAME_SHM_SLOT_EOS  = 0x01, //入力の終了 (データなし)
+};
+
+#pragma pack(push, 8)
+//フレームの形式
+struct RGYFrameShmInfo {
+    int32_t width, height;
+    int32_t csp;             //RGY_CSP
+    int32_t picstruct;       //RGY_PICSTRUCT
+    int32_t fpsN, fpsD;
+    int32_t sar[2];
+    int32_t frames;          //総フレーム数 (不明なら0)
+    int32_t pitch;           //輝度の1行のバイト数 (色差は形式に従う)
+    uint32_t planeOffset[3]; //フレームデータの先頭からの各プレーンの位置
+    uint32_t frameSize;      //1フレームのデータサイズ
+};
+
+//共有メモリの先頭
+struct RGYFrameShmHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t slotCount;
+    uint32_t slotSize;       //スロットヘッダを含む1スロットのサイズ
+    uint32_t slotDataOffset; //スロットの先頭からフレームデータまでの位置
+    uint32_t pidProducer;
+    uint32_t pidConsumer;
+    volatile int32_t abort;  //いずれかが中断した
+    int32_t reserved;
+    RGYFrameShmInfo info;
+};
+
+//各スロットの先頭
+struct RGYFrameShmSlot {
+    int64_t pts;             //timebase = fpsD/fpsN
+    int64_t duration;
+    int32_t picstruct;       //RGY_PICSTRUCT
+    uint32_t flags;          //RGYFrameShmSlotFlags
+    int32_t frameIdx;
+    int32_t reserved;
+};
+#pragma pack(pop)
+
+//現在のプロセスのid
+uint32_t rgy_frame_shm_pid();
+
+class RGYFrameShm {
+public:
+    RGYFrameShm();
+    ~RGYFrameShm();
+
+    //作成側: 共有メモリとセマフォを作成する
+    //  attachTimeout: 参照側がこの時間(ms)内に開かなければ、参照側は終了したとみなす (setPeerProcessで起動したプロセスを指定した場合を除く)
+    RGY_ERR create(const tstring& name, const RGYFrameShmInfo& info, int slotCount, uint32_t attachTimeout = RGY_FRAME_SHM_ATTACH_TIMEOUT);
+    //参照側: 作成済みの共有メモリを開く
+    RGY_ERR open(const tstring& name);
+    void close();
+
+    const RGYFrameShmInfo *info() const {
+        return (m_header) ? &m_header->info : nullptr;
+    }
+    const tstring& name() const {
+        return m_name;
+    }
+
+    //作成側: 空いているスロットを取得する
+    //  空きがないままtimeoutを過ぎたらRGY_WRN_DEVICE_BUSY、相手側が中断/終了していたらRGY_ERR_ABORTED
+    RGY_ERR acquireWrite(RGYFrameShmSlot **slot, uint8_t **data, uint32_t timeout);
+    //作成側: 書き込んだスロットを参照側に渡す
+    RGY_ERR submitWrite();
+    //作成側: 入力の終了を通知する
+    RGY_ERR finish(uint32_t timeout);
+
+    //参照側: 書き込み済みのスロットを取得する
+    //  終了が通知されたらRGY_ERR_MORE_DATA、timeout/中断はacquireWriteと同じ
+    RGY_ERR acquireRead(const RGYFrameShmSlot **slot, const uint8_t **data, uint32_t timeout);
+    //参照側: 読み終わったスロットを返却する
+    RGY_ERR releaseRead();
+
+    //相手側に中断を通知する
+    void setAbort();
+    bool aborted() const;
+    //作成側: 参照側として起動したプロセスを指定する
+    //  参照側が開く前でも、そのプロセスの終了を検出できるようになる
+    void setPeerProcess(uint32_t pid) {
+        m_peerPid = pid;
+    }
+    //相手側のプロセスが存在するか
+    bool peerAlive() const;
+
+    //共有メモリの名前として使用できる文字列を作成する
+    static tstring genName(const TCHAR *prefix);
+protected:
+    RGY_ERR wait(bool filled, uint32_t timeout);
+    RGY_ERR waitOnce(bool filled, uint32_t timeout);
+    void post(bool filled);
+    uint8_t *slotPtr(uint32_t index) const;
+
+    //OS依存部
+    RGY_ERR osCreate(size_t size, uint32_t slotCount);
+    RGY_ERR osOpen();
+    void osClose();
+    static bool osProcessAlive(uint32_t pid);
+
+    tstring m_name;
+    bool m_owner;
+    uint8_t *m_ptr;
+    size_t m_size;
+    RGYFrameShmHeader *m_header;
+    uint32_t m_index;    //次に取得するスロット
+    bool m_acquired;     //スロットを取得中
+    bool m_fin;          //終了を通知した/受け取った
+    uint32_t m_peerPid;  //作成側: 参照側として起動したプロセス (0なら不明)
+    uint32_t m_attachTimeout; //作成側: 参照側が開くまで待つ時間 (ms)
+    std::chrono::steady_clock::time_point m_createTime; //作成側: 共有メモリを作成した時刻
+#if defined(_WIN32) || defined(_WIN64)
+    HANDLE m_hMap;
+    HANDLE m_hSemFree;   //空きスロット数
+    HANDLE m_hSemFilled; //書き込み済みスロット数
+#else
+    int m_fd;
+    sem_t *m_hSemFree;
+    sem_t *m_hSemFilled;
+#endif
+};
+
+#endif //__RGY_FRAME_SHM_H__
@@ -0,0 +1,162 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+#if !(defined(_WIN32) || defined(_WIN64))
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "rgy_frame_shm.h"
+#include "rgy_event.h"
+#include "rgy_util.h"
+
+static std::string frame_shm_posix_name(const tstring& name, const char *suffix) {
+    return "/" + tchar_to_string(name) + suffix;
+}
+
+uint32_t rgy_frame_shm_pid() {
+    return (uint32_t)getpid();
+}
+
+RGY_ERR RGYFrameShm::osCreate(size_t size, uint32_t slotCount) {
+    const auto nameMap = frame_shm_posix_name(m_name, "");
+    if ((m_fd = shm_open(nameMap.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600)) < 0) {
+        m_owner = false; //他で作成されたものは削除しない
+        return (errno == EEXIST) ? RGY_ERR_ALREADY_INITIALIZED : RGY_ERR_MEMORY_ALLOC;
+    }
+    if (ftruncate(m_fd, size) != 0) {
+        return RGY_ERR_MEMORY_ALLOC;
+    }
+    void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (ptr == MAP_FAILED) {
+        return RGY_ERR_MAP_FAILED;
+    }
+    m_ptr = (uint8_t *)ptr;
+    m_size = size;
+    m_hSemFree   = sem_open(frame_shm_posix_name(m_name, "_free").c_str(),   O_CREAT | O_EXCL, 0600, slotCount);
+    m_hSemFilled = sem_open(frame_shm_posix_name(m_name, "_filled").c_str(), O_CREAT | O_EXCL, 0600, 0);
+    if (m_hSemFree == SEM_FAILED || m_hSemFilled == SEM_FAILED) {
+        return RGY_ERR_INVALID_HANDLE;
+    }
+    return RGY_ERR_NONE;
+}
+
+RGY_ERR RGYFrameShm::osOpen() {
+    if ((m_fd = shm_open(frame_shm_posix_name(m_name, "").c_str(), O_RDWR, 0600)) < 0) {
+        return RGY_ERR_NOT_FOUND;
+    }
+    struct stat st;
+    if (fstat(m_fd, &st) != 0 || st.st_size <= 0) {
+        return RGY_ERR_MAP_FAILED;
+    }
+    void *ptr = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (ptr == MAP_FAILED) {
+        return RGY_ERR_MAP_FAILED;
+    }
+    m_ptr = (uint8_t *)ptr;
+    m_size = (size_t)st.st_size;
+    m_hSemFree   = sem_open(frame_shm_posix_name(m_name, "_free").c_str(),   0);
+    m_hSemFilled = sem_open(frame_shm_posix_name(m_name, "_filled").c_str(), 0);
+    if (m_hSemFree == SEM_FAILED || m_hSemFilled == SEM_FAILED) {
+        return RGY_ERR_INVALID_HANDLE;
+    }
+    return RGY_ERR_NONE;
+}
+
+void RGYFrameShm::osClose() {
+    if (m_ptr) {
+        munmap(m_ptr, m_size);
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    if (m_hSemFree && m_hSemFree != SEM_FAILED) {
+        sem_close(m_hSemFree);
+    }
+    if (m_hSemFilled && m_hSemFilled != SEM_FAILED) {
+        sem_close(m_hSemFilled);
+    }
+    m_hSemFree = nullptr;
+    m_hSemFilled = nullptr;
+    //Windowsと異なり、名前は明示的に削除する必要がある
+    if (m_owner && m_name.length() > 0) {
+        shm_unlink(frame_shm_posix_name(m_name, "").c_str());
+        sem_unlink(frame_shm_posix_name(m_name, "_free").c_str());
+        sem_unlink(frame_shm_posix_name(m_name, "_filled").c_str());
+    }
+}
+
+RGY_ERR RGYFrameShm::waitOnce(bool filled, uint32_t timeout) {
+    sem_t *sem = (filled) ? m_hSemFilled : m_hSemFree;
+    int ret = 0;
+    if (timeout == INFINITE) {
+        while ((ret = sem_wait(sem)) != 0 && errno == EINTR);
+    } else {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += timeout / 1000;
+        ts.tv_nsec += (long)(timeout % 1000) * 1000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+        while ((ret = sem_timedwait(sem, &ts)) != 0 && errno == EINTR);
+    }
+    if (ret == 0) {
+        return RGY_ERR_NONE;
+    }
+    return (errno == ETIMEDOUT) ? RGY_WRN_DEVICE_BUSY : RGY_ERR_INVALID_HANDLE;
+}
+
+void RGYFrameShm::post(bool filled) {
+    sem_post((filled) ? m_hSemFilled : m_hSemFree);
+}
+
+bool RGYFrameShm::osProcessAlive(uint32_t pid) {
+    if (kill((pid_t)pid, 0) != 0 && errno != EPERM) {
+        return false;
+    }
+    //終了済みで回収されていない(zombie)プロセスも終了とみなす
+    char buf[256] = { 0 };
+    FILE *fp = fopen(strsprintf("/proc/%u/stat", pid).c_str(), "r");
+    if (fp) {
+        const size_t len = fread(buf, 1, sizeof(buf) - 1, fp);
+        fclose(fp);
+        const char *p = strrchr(buf, ')');
+        if (len > 0 && p && p[1] == ' ' && p[2] == 'Z') {
+            return false;
+        }
+    }
+    return true;
+}
+#endif //#if !(defined(_WIN32) || defined(_WIN64))
@@ -0,0 +1,283 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include <cstring>
+#include <algorithm>
+#if !(defined(_WIN32) || defined(_WIN64))
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#include "rgy_hdr10plus.h"
+#include "rgy_bitstream.h"
+
+RGYHDR10Plus::RGYHDR10Plus() :
+#if defined(_WIN32) || defined(_WIN64)
+    m_hFile(INVALID_HANDLE_VALUE),
+    m_hMap(NULL),
+#else
+    m_fd(-1),
+#endif
+    m_pData(nullptr),
+    m_nDataSize(0),
+    m_index(),
+    m_thread(),
+    m_mtx(),
+    m_cvGen(),
+    m_cvReady(),
+    m_ring(),
+    m_nGenerated(0),
+    m_nRequested(0),
+    m_bAbort(false) {
+}
+
+RGYHDR10Plus::~RGYHDR10Plus() {
+    close();
+}
+
+RGY_ERR RGYHDR10Plus::mapFile(const tstring& filename) {
+#if defined(_WIN32) || defined(_WIN64)
+    m_hFile = CreateFile(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_hFile == INVALID_HANDLE_VALUE) {
+        return RGY_ERR_FILE_OPEN;
+    }
+    LARGE_INTEGER fileSize = { 0 };
+    if (!GetFileSizeEx(m_hFile, &fileSize)) {
+        return RGY_ERR_FILE_OPEN;
+    }
+    m_nDataSize = (uint64_t)fileSize.QuadPart;
+    if (m_nDataSize == 0) {
+        return RGY_ERR_NONE;
+    }
+    if (NULL == (m_hMap = CreateFileMapping(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr))) {
+        return RGY_ERR_NULL_PTR;
+    }
+    if (nullptr == (m_pData = (const uint8_t *)MapViewOfFile(m_hMap, FILE_MAP_READ, 0, 0, 0))) {
+        return RGY_ERR_NULL_PTR;
+    }
+#else
+    if (0 > (m_fd = open(filename.c_str(), O_RDONLY))) {
+        return RGY_ERR_FILE_OPEN;
+    }
+    struct stat st;
+    if (0 != fstat(m_fd, &st)) {
+        return RGY_ERR_FILE_OPEN;
+    }
+    m_nDataSize = (uint64_t)st.st_size;
+    if (m_nDataSize == 0) {
+        return RGY_ERR_NONE;
+    }
+    void *ptr = mmap(nullptr, (size_t)m_nDataSize, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if (ptr == MAP_FAILED) {
+        return RGY_ERR_NULL_PTR;
+    }
+    madvise(ptr, (size_t)m_nDataSize, MADV_SEQUENTIAL);
+    m_pData = (const uint8_t *)ptr;
+#endif
+    return RGY_ERR_NONE;
+}
+
+void RGYHDR10Plus::unmapFile() {
+#if defined(_WIN32) || defined(_WIN64)
+    if (m_pData) {
+        UnmapViewOfFile(m_pData);
+    }
+    if (m_hMap) {
+        CloseHandle(m_hMap);
+        m_hMap = NULL;
+    }
+    if (m_hFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_hFile);
+        m_hFile = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (m_pData) {
+        munmap((void *)m_pData, (size_t)m_nDataSize);
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+#endif
+    m_pData = nullptr;
+    m_nDataSize = 0;
+}
+
+RGY_ERR RGYHDR10Plus::init(const tstring& filename) {
+    close();
+    auto sts = mapFile(filename);
+    if (sts != RGY_ERR_NONE) {
+        unmapFile();
+        return sts;
+    }
+    //ペイロードサイズのみをたどって索引を作成する (ペイロードの中身はここでは読まない)
+    for (uint64_t pos = 0; pos < m_nDataSize; ) {
+        if (pos + 4 > m_nDataSize) {
+            unmapFile();
+            return RGY_ERR_INVALID_DATA_TYPE;
+        }
+        const uint8_t *ptr = m_pData + pos;
+        FrameIndex index;
+        index.size = ((uint32_t)ptr[0] << 24) | ((uint32_t)ptr[1] << 16) | ((uint32_t)ptr[2] << 8) | (uint32_t)ptr[3];
+        index.offset = pos + 4;
+        if (index.offset + index.size > m_nDataSize) {
+            unmapFile();
+            return RGY_ERR_INVALID_DATA_TYPE;
+        }
+        m_index.push_back(index);
+        pos = index.offset + index.size;
+    }
+    m_ring.resize(RGY_HDR10PLUS_PREGEN_FRAMES);
+    m_nGenerated = 0;
+    m_nRequested = 0;
+    m_bAbort = false;
+    m_thread = std::thread(&RGYHDR10Plus::run, this);
+    return RGY_ERR_NONE;
+}
+
+void RGYHDR10Plus::close() {
+    if (m_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_bAbort = true;
+        }
+        m_cvGen.notify_all();
+        m_cvReady.notify_all();
+        m_thread.join();
+    }
+    unmapFile();
+    m_index.clear();
+    m_ring.clear();
+}
+
+int RGYHDR10Plus::frames() const {
+    return (int)m_index.size();
+}
+
+void RGYHDR10Plus::genNal(int frame, std::vector<uint8_t>& nal) const {
+    nal.clear();
+    const auto& index = m_index[frame];
+    if (index.size == 0) {
+        return;
+    }
+    std::vector<uint8_t> rbsp;
+    rbsp.reserve(index.size + 16);
+    rbsp.push_back(NALU_HEVC_PREFIX_SEI << 1); //nal_unit_type, nuh_layer_id = 0
+    rbsp.push_back(0x01);                      //nuh_temporal_id_plus1 = 1
+    rbsp.push_back(4);                         //payload_type: user_data_registered_itu_t_t35
+    uint32_t payload_size = index.size;
+    for (; payload_size >= 255; payload_size -= 255) {
+        rbsp.push_back(0xff);
+    }
+    rbsp.push_back((uint8_t)payload_size);
+    rbsp.insert(rbsp.end(), m_pData + index.offset, m_pData + index.offset + index.size);
+    rbsp.push_back(0x80); //rbsp_trailing_bits
+
+    //start codeを付加し、emulation prevention byteを挿入する
+    nal.reserve(rbsp.size() + rbsp.size() / 64 + 8);
+    nal.push_back(0x00);
+    nal.push_back(0x00);
+    nal.push_back(0x00);
+    nal.push_back(0x01);
+    int zero_count = 0;
+    for (const auto byte : rbsp) {
+        if (zero_count >= 2 && byte <= 0x03) {
+            nal.push_back(0x03);
+            zero_count = 0;
+        }
+        nal.push_back(byte);
+        zero_count = (byte == 0x00) ? zero_count + 1 : 0;
+    }
+}
+
+void RGYHDR10Plus::run() {
+    const int depth = (int)m_ring.size();
+    const int frameCount = (int)m_index.size();
+    std::vector<uint8_t> nal;
+    for (;;) {
+        int frame = 0;
+        {
+            //要求された位置より先行しすぎないよう、リングの半分まで生成する
+            std::unique_lock<std::mutex> lock(m_mtx);
+            m_cvGen.wait(lock, [&]() { return m_bAbort || (m_nGenerated < frameCount && m_nGenerated < m_nRequested + depth / 2); });
+            if (m_bAbort) {
+                break;
+            }
+            frame = m_nGenerated;
+        }
+        genNal(frame, nal);
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_ring[frame % depth].swap(nal);
+            m_nGenerated = frame + 1;
+        }
+        m_cvReady.notify_all();
+    }
+}
+
+void RGYHDR10Plus::getNal(int frame, std::vector<uint8_t>& nal) {
+    nal.clear();
+    if (frame < 0 || frame >= (int)m_index.size()) {
+        return;
+    }
+    const int depth = (int)m_ring.size();
+    {
+        std::unique_lock<std::mutex> lock(m_mtx);
+        if (frame > m_nRequested) {
+            m_nRequested = frame;
+            m_cvGen.notify_one();
+        }
+        if (m_thread.joinable()) {
+            m_cvReady.wait(lock, [&]() { return m_bAbort || m_nGenerated > frame; });
+            if (!m_bAbort && frame >= m_nGenerated - depth) {
+                nal = m_ring[frame % depth];
+                return;
+            }
+        }
+    }
+    //先行生成の範囲から外れたフレームは、ここで生成する
+    genNal(frame, nal);
+}
+
+uint32_t RGYHDR10Plus::seiInsertOffset(const uint8_t *data, uint32_t size) {
+    //AU全体は解析せず、最初のVCL NAL等が見つかった時点で終了する
+    for (uint32_t i = 0; i + 3 < size; i++) {
+        if (data[i+0] == 0 && data[i+1] == 0 && data[i+2] == 1) {
+            const uint8_t type = (data[i+3] & 0x7f) >> 1;
+            if (type != NALU_HEVC_AUD
+                && type != NALU_HEVC_VPS
+                && type != NALU_HEVC_SPS
+                && type != NALU_HEVC_PPS
+                && type != NALU_HEVC_PREFIX_SEI) {
+                return i - (i > 0 && data[i-1] == 0);
+            }
+            i += 3;
+        }
+    }
+    return size;
+}
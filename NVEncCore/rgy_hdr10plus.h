@@ -0,0 +1,97 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#pragma once
+#ifndef __RGY_HDR10PLUS_H__
+#define __RGY_HDR10PLUS_H__
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "rgy_osdep.h"
+#include "rgy_util.h"
+#include "rgy_err.h"
+
+//SEIを先行して生成しておくフレーム数
+static const int RGY_HDR10PLUS_PREGEN_FRAMES = 32;
+
+//HDR10+ (SMPTE ST 2094-40) の動的メタデータから、フレームごとのprefix SEI NALを生成する
+//  入力ファイルは、フレーム順に [ペイロードサイズ(4byte, big endian)][ITU-T T.35 ペイロード] を並べたもの
+//  ペイロードサイズが0のフレームにはSEIを付加しない
+//  ファイルはメモリマップし、開く際にはペイロードサイズのみを読んでフレームごとの索引を作成する
+//  SEI NALの生成はワーカースレッドで、出力側が要求するフレームより先行して行う
+class RGYHDR10Plus {
+public:
+    RGYHDR10Plus();
+    ~RGYHDR10Plus();
+
+    RGY_ERR init(const tstring& filename);
+    void close();
+
+    //指定したフレーム(入力順)のSEI NALを取得する (メタデータがない場合は空)
+    //  B-frameによる並べ替えのため、多少前後した順序で呼ばれてもよい
+    void getNal(int frame, std::vector<uint8_t>& nal);
+
+    //メタデータのフレーム数
+    int frames() const;
+
+    //SEI NALを挿入すべきAU内の位置 (AUD/VPS/SPS/PPS/prefix SEIの直後) を返す
+    static uint32_t seiInsertOffset(const uint8_t *data, uint32_t size);
+protected:
+    struct FrameIndex {
+        uint64_t offset; //ペイロードの位置
+        uint32_t size;   //ペイロードのサイズ
+    };
+    RGY_ERR mapFile(const tstring& filename);
+    void unmapFile();
+    void genNal(int frame, std::vector<uint8_t>& nal) const;
+    void run();
+
+#if defined(_WIN32) || defined(_WIN64)
+    HANDLE                    m_hFile;
+    HANDLE                    m_hMap;
+#else
+    int                       m_fd;
+#endif
+    const uint8_t            *m_pData;       //メモリマップしたファイルの先頭
+    uint64_t                  m_nDataSize;   //ファイルサイズ
+    std::vector<FrameIndex>   m_index;       //フレームごとのペイロードの位置
+
+    std::thread               m_thread;
+    std::mutex                m_mtx;
+    std::condition_variable   m_cvGen;       //生成の要求を通知
+    std::condition_variable   m_cvReady;     //生成の完了を通知
+    std::vector<std::vector<uint8_t>> m_ring; //生成済みのSEI NAL (frame % RGY_HDR10PLUS_PREGEN_FRAMES)
+    int                       m_nGenerated;  //生成済みのフレーム数
+    int                       m_nRequested;  //これまでに要求された最大のフレーム
+    bool                      m_bAbort;
+};
+
+#endif //__RGY_HDR10PLUS_H__
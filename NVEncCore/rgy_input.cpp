@@ -75,3 +75,49 @@ void RGYInput::CreateInputInfo(const TCHAR *inputTypeName, const TCHAR *inputCSp
 
     m_strInputInfo = ss.str();
 }
+
+uint8_t *RGYInput::allocConvertedFrame(RGYFrame *pFrame) {
+    const int dst_width  = m_inputVideoInfo.srcWidth  - m_inputVideoInfo.crop.e.left - m_inputVideoInfo.crop.e.right;
+    const int dst_height = m_inputVideoInfo.srcHeight - m_inputVideoInfo.crop.e.up   - m_inputVideoInfo.crop.e.bottom;
+    int pixel_size = (RGY_CSP_BIT_DEPTH[m_sConvert->csp_to] > 8) ? 2 : 1;
+    switch (m_sConvert->csp_to) {
+    case RGY_CSP_RGB24:
+    case RGY_CSP_RGB24R: pixel_size = 3; break;
+    case RGY_CSP_RGB32:
+    case RGY_CSP_RGB32R: pixel_size = 4; break;
+    default: break;
+    }
+    const int pitch = ALIGN(dst_width * pixel_size + 64, 64);
+    uint8_t *buffer = (uint8_t *)_aligned_malloc((size_t)pitch * dst_height * 3 + pitch, 64);
+    if (buffer) {
+        pFrame->set(buffer, dst_width, dst_height, pitch, m_sConvert->csp_to);
+    }
+    return buffer;
+}
+
+void RGYInput::copyConvertedFrame(RGYFrame *pSurface, RGYFrame *pConverted) {
+    const auto src_info = pConverted->getInfo();
+    const auto chromafmt = RGY_CSP_CHROMA_FORMAT[src_info.csp];
+    const bool rgb = chromafmt == RGY_CHROMAFMT_RGB;
+    const bool semi_planar = src_info.csp == RGY_CSP_NV12 || src_info.csp == RGY_CSP_P010
+                          || src_info.csp == RGY_CSP_NV16 || src_info.csp == RGY_CSP_P210;
+    int pixel_size = (RGY_CSP_BIT_DEPTH[src_info.csp] > 8) ? 2 : 1;
+    if (rgb) {
+        pixel_size = (src_info.csp == RGY_CSP_RGB24 || src_info.csp == RGY_CSP_RGB24R) ? 3 : 4;
+    }
+    void *dst_array[3], *src_array[3];
+    pSurface->ptrArray(dst_array, rgb);
+    pConverted->ptrArray(src_array, rgb);
+    const int planes = (rgb) ? 1 : ((semi_planar) ? 2 : 3);
+    for (int iplane = 0; iplane < planes; iplane++) {
+        int row_byte = src_info.width * pixel_size;
+        int rows = src_info.height;
+        if (iplane > 0) {
+            if (chromafmt == RGY_CHROMAFMT_YUV420) rows >>= 1;
+            if (!semi_planar && chromafmt != RGY_CHROMAFMT_YUV444) row_byte >>= 1;
+        }
+        for (int y = 0; y < rows; y++) {
+            memcpy((uint8_t *)dst_array[iplane] + (size_t)pSurface->pitch() * y, (const uint8_t *)src_array[iplane] + (size_t)src_info.pitch * y, row_byte);
+        }
+    }
+}
@@ -140,6 +140,12 @@ protected:
     virtual RGY_ERR Init(const TCHAR *strFileName, VideoInfo *pInputInfo, const void *prm) = 0;
     virtual void CreateInputInfo(const TCHAR *inputTypeName, const TCHAR *inputCSpName, const TCHAR *outputCSpName, const TCHAR *convSIMD, const VideoInfo *inputPrm);
 
+    //m_sConvertの出力形式で、crop後のフレームを格納するホストメモリを確保する
+    //SIMD関数は行末を超えて書き込むことがあるので、pitchと末尾に余裕を持たせる
+    uint8_t *allocConvertedFrame(RGYFrame *pFrame);
+    //allocConvertedFrameで確保したフレームに変換済みのフレームを、pSurfaceへplaneごとにコピーする
+    void copyConvertedFrame(RGYFrame *pSurface, RGYFrame *pConverted);
+
     //trim listを参照し、動画の最大フレームインデックスを取得する
     int getVideoTrimMaxFramIdx() {
         if (m_sTrimParam.list.size() == 0) {
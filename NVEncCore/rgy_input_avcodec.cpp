@@ -131,7 +131,10 @@ void RGYInputAvcodec::Close() {
         av_packet_unref(&m_Demux.qStreamPktL1[i]);
     }
     m_Demux.qStreamPktL1.clear();
-    m_Demux.qStreamPktL2.close([](AVPacket *pkt) { av_packet_unref(pkt); });
+    for (auto& qStreamPkt : m_Demux.qStreamPktL2) {
+        qStreamPkt->close([](AVPacket *pkt) { av_packet_unref(pkt); });
+    }
+    m_Demux.qStreamPktL2.clear();
     AddMessage(RGY_LOG_DEBUG, _T("Cleared Stream Packet Buffer.\n"));
 
     CloseFormat(&m_Demux.format);
@@ -513,8 +516,12 @@ RGY_ERR RGYInputAvcodec::getFirstFramePosAndFrameRate(const sTrim *pTrimList, in
 
     auto trimList = make_vector(pTrimList, nTrimCount);
     //出力時の音声・字幕解析用に1パケットコピーしておく
-    if (m_Demux.qStreamPktL1.size() > 0 || m_Demux.qStreamPktL2.size() > 0) {
-        if (!m_Demux.frames.isEof() && m_Demux.qStreamPktL2.size() > 0) {
+    size_t nStreamPktL2 = 0;
+    for (const auto& qStreamPkt : m_Demux.qStreamPktL2) {
+        nStreamPktL2 += qStreamPkt->size();
+    }
+    if (m_Demux.qStreamPktL1.size() > 0 || nStreamPktL2 > 0) {
+        if (!m_Demux.frames.isEof() && nStreamPktL2 > 0) {
             //最後まで読み込んでいなかったら、すべてのパケットはqStreamPktL1にあるはず
             AddMessage(RGY_LOG_ERROR, _T("qStreamPktL2 > 0, this is internal error.\n"));
             return RGY_ERR_UNDEFINED_BEHAVIOR;
@@ -525,13 +532,14 @@ RGY_ERR RGYInputAvcodec::getFirstFramePosAndFrameRate(const sTrim *pTrimList, in
                 const AVPacket *pkt1 = nullptr; //最初のパケット
                 const AVPacket *pkt2 = nullptr; //2番目のパケット
                 //まず、L2キューを探す
-                for (int j = 0; j < (int)m_Demux.qStreamPktL2.size(); j++) {
-                    if (m_Demux.qStreamPktL2.get(j)->data.stream_index == streamInfo->nIndex) {
+                auto qStreamPkt = m_Demux.qStreamPktL2[streamInfo->nPktQueueIdx].get();
+                for (int j = 0; j < (int)qStreamPkt->size(); j++) {
+                    if (qStreamPkt->get(j)->data.stream_index == streamInfo->nIndex) {
                         if (pkt1) {
-                            pkt2 = &(m_Demux.qStreamPktL2.get(j)->data);
+                            pkt2 = &(qStreamPkt->get(j)->data);
                             break;
                         }
-                        pkt1 = &(m_Demux.qStreamPktL2.get(j)->data);
+                        pkt1 = &(qStreamPkt->get(j)->data);
                     }
                 }
                 if (pkt2 == nullptr) {
@@ -593,7 +601,9 @@ RGY_ERR RGYInputAvcodec::Init(const TCHAR *strFileName, VideoInfo *pInputInfo, c
     const AvcodecReaderPrm *input_prm = (const AvcodecReaderPrm *)prm;
 
     if (input_prm->bReadVideo) {
-        if (pInputInfo->type != RGY_INPUT_FMT_AVANY) {
+        if (input_prm->bVideoCopy) {
+            m_strReaderName = _T("avcopy");
+        } else if (pInputInfo->type != RGY_INPUT_FMT_AVANY) {
             m_strReaderName = (pInputInfo->type != RGY_INPUT_FMT_AVSW) ? _T("av" DECODER_NAME) : _T("avsw");
         }
     } else {
@@ -696,7 +706,6 @@ RGY_ERR RGYInputAvcodec::Init(const TCHAR *strFileName, VideoInfo *pInputInfo, c
     //getFirstFramePosAndFrameRateで大量にパケットを突っ込む可能性があるので、この段階ではcapacityは無限大にしておく
     m_Demux.qVideoPkt.init(4096, SIZE_MAX, 4);
     m_Demux.qVideoPkt.set_keep_length(AV_FRAME_MAX_REORDER);
-    m_Demux.qStreamPktL2.init(4096);
 
     //動画ストリームを探す
     //動画ストリームは動画を処理しなかったとしても同期のため必要
@@ -818,6 +827,7 @@ RGY_ERR RGYInputAvcodec::Init(const TCHAR *strFileName, VideoInfo *pInputInfo, c
                         : iTrack + input_prm->nAudioTrackStart; //音声は1, 2, 3
                     stream.nIndex = mediaStreams[iTrack];
                     stream.nSubStreamId = iSubStream;
+                    stream.nFramePosCursor = -1;
                     stream.pStream = m_Demux.format.pFormatCtx->streams[stream.nIndex];
                     if (pAudioSelect) {
                         memcpy(stream.pnStreamChannelSelect, pAudioSelect->pnStreamChannelSelect, sizeof(stream.pnStreamChannelSelect));
@@ -848,6 +858,21 @@ RGY_ERR RGYInputAvcodec::Init(const TCHAR *strFileName, VideoInfo *pInputInfo, c
             }
         }
     }
+    //音声・字幕のトラックごとに出力用のキューを用意する
+    //サブストリームは同じトラックのパケットを受け取るので、キューを共有する
+    for (auto stream = m_Demux.stream.begin(); stream != m_Demux.stream.end(); stream++) {
+        auto sameTrack = std::find_if(m_Demux.stream.begin(), stream, [stream](const AVDemuxStream& s) {
+            return s.nTrackId == stream->nTrackId;
+        });
+        if (sameTrack != stream) {
+            stream->nPktQueueIdx = sameTrack->nPktQueueIdx;
+            continue;
+        }
+        stream->nPktQueueIdx = (int)m_Demux.qStreamPktL2.size();
+        m_Demux.qStreamPktL2.push_back(std::unique_ptr<RGYQueueSPSP<AVPacket>>(new RGYQueueSPSP<AVPacket>()));
+        m_Demux.qStreamPktL2.back()->init(1024);
+        AddMessage(RGY_LOG_DEBUG, _T("created packet queue #%d for track %d.\n"), stream->nPktQueueIdx, stream->nTrackId);
+    }
 
     if (input_prm->bReadChapter) {
         m_Demux.chapter = make_vector((const AVChapter **)m_Demux.format.pFormatCtx->chapters, m_Demux.format.pFormatCtx->nb_chapters);
@@ -871,7 +896,17 @@ RGY_ERR RGYInputAvcodec::Init(const TCHAR *strFileName, VideoInfo *pInputInfo, c
         }
 
         m_Demux.video.nHWDecodeDeviceId = -1;
-        if (m_inputVideoInfo.type != RGY_INPUT_FMT_AVSW) {
+        if (input_prm->bVideoCopy) {
+            //デコードしないので、HWデコーダのチェックは不要
+            m_inputVideoInfo.codec = RGY_CODEC_UNKNOWN;
+            for (int i = 0; i < _countof(HW_DECODE_LIST); i++) {
+                if (HW_DECODE_LIST[i].avcodec_id == m_Demux.video.pStream->codecpar->codec_id) {
+                    m_inputVideoInfo.codec = HW_DECODE_LIST[i].rgy_codec;
+                    break;
+                }
+            }
+            AddMessage(RGY_LOG_DEBUG, _T("video stream will be copied without decoding.\n"));
+        } else if (m_inputVideoInfo.type != RGY_INPUT_FMT_AVSW) {
             for (const auto& devCodecCsp : *input_prm->pHWDecCodecCsp) {
                 m_inputVideoInfo.codec = checkHWDecoderAvailable(
                     m_Demux.video.pStream->codecpar->codec_id, (AVPixelFormat)m_Demux.video.pStream->codecpar->format, &devCodecCsp.second);
@@ -897,7 +932,7 @@ RGY_ERR RGYInputAvcodec::Init(const TCHAR *strFileName, VideoInfo *pInputInfo, c
                 AddMessage(RGY_LOG_DEBUG, _T("can be decoded by %s.\n"), _T(DECODER_NAME));
             }
         }
-        m_strReaderName = (m_Demux.video.nHWDecodeDeviceId >= 0) ? _T("av" DECODER_NAME) : _T("avsw");
+        m_strReaderName = (input_prm->bVideoCopy) ? _T("avcopy") : ((m_Demux.video.nHWDecodeDeviceId >= 0) ? _T("av" DECODER_NAME) : _T("avsw"));
         m_inputVideoInfo.type = (m_Demux.video.nHWDecodeDeviceId >= 0) ? RGY_INPUT_FMT_AVHW : RGY_INPUT_FMT_AVSW;
 
         //HEVC入力の際に大量にメッセージが出て劇的に遅くなることがあるのを回避
@@ -1113,7 +1148,7 @@ RGY_ERR RGYInputAvcodec::Init(const TCHAR *strFileName, VideoInfo *pInputInfo, c
         const auto aspectRatio = m_Demux.video.pStream->codecpar->sample_aspect_ratio;
         const bool bAspectRatioUnknown = aspectRatio.num * aspectRatio.den <= 0;
 
-        if (!(m_Demux.video.nHWDecodeDeviceId >= 0)) {
+        if (!(m_Demux.video.nHWDecodeDeviceId >= 0) && !input_prm->bVideoCopy) {
             if (nullptr == (m_Demux.video.pCodecDecode = avcodec_find_decoder(m_Demux.video.pStream->codecpar->codec_id))) {
                 AddMessage(RGY_LOG_ERROR, errorMesForCodec(_T("Failed to find decoder"), m_Demux.video.pStream->codecpar->codec_id).c_str());
                 return RGY_ERR_NOT_FOUND;
@@ -1185,7 +1220,7 @@ RGY_ERR RGYInputAvcodec::Init(const TCHAR *strFileName, VideoInfo *pInputInfo, c
                 return RGY_ERR_NULL_PTR;
             }
         } else {
-            //HWデコードの場合は、色変換がかからないので、入力フォーマットがそのまま出力フォーマットとなる
+            //HWデコード・映像のコピーの場合は、色変換がかからないので、入力フォーマットがそのまま出力フォーマットとなる
             m_inputVideoInfo.csp = pixfmtData->output_csp;
             m_inputVideoInfo.shift = (m_inputVideoInfo.csp == RGY_CSP_P010 || m_inputVideoInfo.csp == RGY_CSP_P210) ? 16 - pixfmtData->bit_depth : 0;
         }
@@ -1206,8 +1241,9 @@ RGY_ERR RGYInputAvcodec::Init(const TCHAR *strFileName, VideoInfo *pInputInfo, c
         m_inputVideoInfo.fpsN        = m_Demux.video.nAvgFramerate.num;
         m_inputVideoInfo.fpsD        = m_Demux.video.nAvgFramerate.den;
 
-        if (m_Demux.video.nHWDecodeDeviceId >= 0) {
-            tstring mes = strsprintf(_T("av" DECODER_NAME ": %s, %dx%d, %d/%d fps"),
+        if (m_Demux.video.nHWDecodeDeviceId >= 0 || input_prm->bVideoCopy) {
+            tstring mes = strsprintf(_T("%s: %s, %dx%d, %d/%d fps"),
+                m_strReaderName.c_str(),
                 CodecToStr(m_inputVideoInfo.codec).c_str(),
                 m_inputVideoInfo.srcWidth, m_inputVideoInfo.srcHeight, m_inputVideoInfo.fpsN, m_inputVideoInfo.fpsD);
             if (input_prm->fSeekSec > 0.0f) {
@@ -1228,6 +1264,13 @@ RGY_ERR RGYInputAvcodec::Init(const TCHAR *strFileName, VideoInfo *pInputInfo, c
 
         *pInputInfo = m_inputVideoInfo;
 
+        //長時間の入力でもメモリ使用量が増え続けないよう、参照されなくなったフレーム情報は破棄する
+        //FramePosListの内容を出力する場合は、すべて保持する
+        if (m_sFramePosListLog.length() == 0) {
+            m_Demux.frames.setRetire(FRAMEPOS_KEEP_FRAMES, input_prm->bFramePosLookup);
+            addStreamFramePosCursor();
+        }
+
         //スレッド関連初期化
         m_Demux.thread.bAbortInput = false;
 #if ENCODER_QSV
@@ -1262,6 +1305,8 @@ RGY_ERR RGYInputAvcodec::Init(const TCHAR *strFileName, VideoInfo *pInputInfo, c
             av_packet_unref(&pkt);
 
             m_Demux.frames.checkPtsStatus();
+            m_Demux.frames.setRetire(FRAMEPOS_KEEP_FRAMES, false);
+            addStreamFramePosCursor();
         }
 
         tstring mes;
@@ -1301,6 +1346,28 @@ FramePosList *RGYInputAvcodec::GetFramePosList() {
 int RGYInputAvcodec::getVideoFrameIdx(int64_t pts, AVRational timebase, int iStart) {
     const int framePosCount = m_Demux.frames.frameNum();
     const AVRational vid_pkt_timebase = (m_Demux.video.pStream) ? m_Demux.video.pStream->time_base : av_inv_q(m_Demux.video.nAvgFramerate);
+    //破棄済みのフレームは探索できないので、保持している最初のフレームから探索する
+    iStart = (std::max)(iStart, m_Demux.frames.firstIndex());
+    //ptsが確定した範囲はソート済みなので、二分探索する (wrap arroundを含む場合を除く)
+    const int fixedNum = (std::min)(m_Demux.frames.fixedNum(), framePosCount);
+    if (iStart < fixedNum - 1
+        && m_Demux.frames.list(iStart).pts <= m_Demux.frames.list(fixedNum - 1).pts) {
+        if (av_cmp_q(timebase, vid_pkt_timebase) == 0) {
+            //pts <= pos.ptsとなる最初のフレーム
+            const int idx = m_Demux.frames.lowerBound(iStart, fixedNum, [pts](const FramePos& pos) { return pos.pts < pts; });
+            if (idx < fixedNum) {
+                return (pts == m_Demux.frames.list(idx).pts) ? idx : idx - 1;
+            }
+        } else {
+            //pts < pos.ptsとなる最初のフレーム
+            const int idx = m_Demux.frames.lowerBound(iStart, fixedNum, [pts, timebase, vid_pkt_timebase](const FramePos& pos) {
+                return av_compare_ts(pts, timebase, pos.pts, vid_pkt_timebase) >= 0; });
+            if (idx < fixedNum) {
+                return idx - 1;
+            }
+        }
+        iStart = fixedNum;
+    }
     if (av_cmp_q(timebase, vid_pkt_timebase) == 0) {
         for (int i = (std::max)(0, iStart); i < framePosCount; i++) {
             if (pts == m_Demux.frames.list(i).pts) {
@@ -1327,6 +1394,15 @@ int64_t RGYInputAvcodec::convertTimebaseVidToStream(int64_t pts, const AVDemuxSt
     return av_rescale_q(pts, vid_pkt_timebase, pStream->pStream->time_base);
 }
 
+void RGYInputAvcodec::addStreamFramePosCursor() {
+    //音声・字幕は、直前のパケットに相当する動画の位置から探索するので、それより前のフレーム情報のみ破棄できる
+    //(音声・字幕のパケットはこのあとmuxerに渡されるので、muxer側からFramePosListを参照することはない)
+    //まだパケットのないストリーム (空の字幕など) が破棄を妨げないよう、最初のパケットまでは位置を持たない
+    for (auto& stream : m_Demux.stream) {
+        stream.nFramePosCursor = m_Demux.frames.addCursor(INT_MAX);
+    }
+}
+
 bool RGYInputAvcodec::checkStreamPacketToAdd(const AVPacket *pkt, AVDemuxStream *pStream) {
     pStream->nLastVidIndex = getVideoFrameIdx(pkt->pts, pStream->pStream->time_base, pStream->nLastVidIndex);
 
@@ -1335,7 +1411,16 @@ bool RGYInputAvcodec::checkStreamPacketToAdd(const AVPacket *pkt, AVDemuxStream
         return false;
     }
 
-    const auto vidFramePos = &m_Demux.frames.list((std::max)(pStream->nLastVidIndex, 0));
+    //2パケット目以降は、このストリームのカーソルより前を破棄していないので、nLastVidIndexの位置は保持されている
+    //最初のパケットが、すでに破棄したフレーム(FRAMEPOS_KEEP_FRAMES以上前)に相当する場合は同期がとれないので出力しない
+    const int vidIndex = (std::max)(pStream->nLastVidIndex, 0);
+    if (vidIndex < m_Demux.frames.firstIndex()) {
+        AddMessage(RGY_LOG_WARN, _T("stream #%d: packet pts %lld is before the retained video frames, dropped.\n"), pStream->nIndex, (lls)pkt->pts);
+        pStream->nLastVidIndex = m_Demux.frames.firstIndex();
+        return false;
+    }
+    m_Demux.frames.moveCursor(pStream->nFramePosCursor, vidIndex);
+    const auto vidFramePos = &m_Demux.frames.list(vidIndex);
     const int64_t vid_fin = convertTimebaseVidToStream(vidFramePos->pts + ((pStream->nLastVidIndex >= 0) ? vidFramePos->duration : 0), pStream);
 
     const int64_t aud_start = pkt->pts;
@@ -1497,15 +1582,17 @@ int RGYInputAvcodec::getSample(AVPacket *pkt, bool bTreatFirstPacketAsKeyframe)
     int64_t videoFinPts = 0;
     const int nFrameNum = m_Demux.frames.frameNum();
     if (m_Demux.video.nStreamPtsInvalid & RGY_PTS_ALL_INVALID) {
-        videoFinPts = nFrameNum * m_Demux.frames.list(0).duration;
+        videoFinPts = nFrameNum * m_Demux.frames.first().duration;
     } else if (nFrameNum) {
         const FramePos *lastFrame = &m_Demux.frames.list(nFrameNum - 1);
         videoFinPts = lastFrame->pts + lastFrame->duration;
     }
     //もし選択範囲が手動で決定されていないのなら、音声を最大限取得する
     if (m_sTrimParam.list.size() == 0 || m_sTrimParam.list.back().fin == TRIM_MAX) {
-        for (uint32_t i = 0; i < m_Demux.qStreamPktL2.size(); i++) {
-            videoFinPts = (std::max)(videoFinPts, m_Demux.qStreamPktL2[i].data.pts);
+        for (const auto& qStreamPkt : m_Demux.qStreamPktL2) {
+            for (uint32_t i = 0; i < qStreamPkt->size(); i++) {
+                videoFinPts = (std::max)(videoFinPts, (*qStreamPkt)[i].data.pts);
+            }
         }
         for (uint32_t i = 0; i < m_Demux.qStreamPktL1.size(); i++) {
             videoFinPts = (std::max)(videoFinPts, m_Demux.qStreamPktL1[i].pts);
@@ -1546,6 +1633,8 @@ RGY_ERR RGYInputAvcodec::GetNextBitstream(RGYBitstream *pBitstream) {
         if (pkt.data) {
             auto pts = (0 == (m_Demux.frames.getStreamPtsStatus() & (~RGY_PTS_NORMAL))) ? pkt.pts : AV_NOPTS_VALUE;
             sts = pBitstream->copy(pkt.data, pkt.size, pkt.dts, pts);
+            pBitstream->setDuration(pkt.duration);
+            pBitstream->setFrametype((pkt.flags & AV_PKT_FLAG_KEY) ? RGY_FRAMETYPE_IDR : RGY_FRAMETYPE_P);
         }
         av_packet_unref(&pkt);
         m_Demux.video.nSampleGetCount++;
@@ -1640,6 +1729,16 @@ const AVStream *RGYInputAvcodec::GetInputVideoStream() {
     return m_Demux.video.pStream;
 }
 
+double RGYInputAvcodec::GetInputVideoDuration() {
+    if (m_Demux.video.pStream && m_Demux.video.pStream->duration > 0) {
+        return m_Demux.video.pStream->duration * av_q2d(m_Demux.video.pStream->time_base);
+    }
+    if (m_Demux.format.pFormatCtx && m_Demux.format.pFormatCtx->duration > 0) {
+        return m_Demux.format.pFormatCtx->duration / (double)AV_TIME_BASE;
+    }
+    return 0.0;
+}
+
 //qStreamPktL1をチェックし、framePosListから必要な音声パケットかどうかを判定し、
 //必要ならqStreamPktL2に移し、不要ならパケットを開放する
 void RGYInputAvcodec::CheckAndMoveStreamPacketList() {
@@ -1657,7 +1756,7 @@ void RGYInputAvcodec::CheckAndMoveStreamPacketList() {
         }
         if (checkStreamPacketToAdd(&pkt, pStream)) {
             pkt.flags = (pkt.flags & 0xffff) | (pStream->nTrackId << 16); //flagsの上位16bitには、trackIdへのポインタを格納しておく
-            m_Demux.qStreamPktL2.push(pkt); //Writer側に渡したパケットはWriter側で開放する
+            m_Demux.qStreamPktL2[pStream->nPktQueueIdx]->push(pkt); //Writer側に渡したパケットはWriter側で開放する
         } else {
             av_packet_unref(&pkt); //Writer側に渡さないパケットはここで開放する
         }
@@ -1665,18 +1764,26 @@ void RGYInputAvcodec::CheckAndMoveStreamPacketList() {
     }
 }
 
-vector<AVPacket> RGYInputAvcodec::GetStreamDataPackets() {
+void RGYInputAvcodec::LoadStreamDataPackets() {
     if (!m_Demux.video.bReadVideo) {
         GetAudioDataPacketsWhenNoVideoRead();
     }
+    if (m_Demux.thread.pQueueInfo) {
+        size_t nStreamPktL2 = 0;
+        for (const auto& qStreamPkt : m_Demux.qStreamPktL2) {
+            nStreamPktL2 += qStreamPkt->size();
+        }
+        m_Demux.thread.pQueueInfo->usage_aud_in = nStreamPktL2;
+    }
+}
 
-    //出力するパケットを選択する
-    vector<AVPacket> packets;
-    AVPacket pkt;
-    while (m_Demux.qStreamPktL2.front_copy_and_pop_no_lock(&pkt, (m_Demux.thread.pQueueInfo) ? &m_Demux.thread.pQueueInfo->usage_aud_in : nullptr)) {
-        packets.push_back(pkt);
+RGYQueueSPSP<AVPacket> *RGYInputAvcodec::GetStreamPacketQueue(int nTrackId) {
+    for (const auto& stream : m_Demux.stream) {
+        if (stream.nTrackId == nTrackId) {
+            return m_Demux.qStreamPktL2[stream.nPktQueueIdx].get();
+        }
     }
-    return std::move(packets);
+    return nullptr;
 }
 
 vector<AVDemuxStream> RGYInputAvcodec::GetInputStreamInfo() {
@@ -40,6 +40,7 @@
 #include <deque>
 #include <atomic>
 #include <thread>
+#include <mutex>
 #include <cassert>
 
 using std::vector;
@@ -49,6 +50,8 @@ using std::deque;
 static const uint32_t AVCODEC_READER_INPUT_BUF_SIZE = 16 * 1024 * 1024;
 static const uint32_t AV_FRAME_MAX_REORDER = 16;
 static const int FRAMEPOS_POC_INVALID = -1;
+static const int FRAMEPOS_KEEP_FRAMES = 8192;     //FramePosListで、参照済みの位置より前に残しておくフレーム数
+static const int FRAMEPOS_RETIRE_INTERVAL = 1024; //FramePosListで、まとめて破棄するフレーム数
 
 enum RGYPtsStatus : uint32_t {
     RGY_PTS_UNKNOWN           = 0x00,
@@ -139,7 +142,13 @@ public:
         m_nFirstKeyframePts(AV_NOPTS_VALUE),
         m_nPAFFRewind(0),
         m_nPtsWrapArroundThreshold(0xFFFFFFFF),
-        m_fpDebugCopyFrameData() {
+        m_fpDebugCopyFrameData(),
+        m_nRetired(0),
+        m_nKeepFrames(0),
+        m_cursor(),
+        m_nLookupCursor(-1),
+        m_firstPos(),
+        m_mtxRetire() {
         m_list.init();
         static_assert(sizeof(m_list.get()[0]) == sizeof(m_list.get()->data), "FramePos must not have padding.");
     };
@@ -164,7 +173,7 @@ public:
 #pragma warning(pop)
     //filenameに情報をcsv形式で出力する
     int printList(const TCHAR *filename) {
-        const int nList = (int)m_list.size();
+        const int nList = frameNum();
         if (nList == 0) {
             return 0;
         }
@@ -176,20 +185,83 @@ public:
             return 1;
         }
         fprintf(fp, "pts,dts,duration,duration2,poc,flags,pic_struct,repeat_pict,pict_type\r\n");
-        for (int i = 0; i < nList; i++) {
+        for (int i = m_nRetired; i < nList; i++) {
             fprintf(fp, "%lld,%lld,%d,%d,%d,%d,%d,%d,%d\r\n",
-                (lls)m_list[i].data.pts, (lls)m_list[i].data.dts,
-                m_list[i].data.duration, m_list[i].data.duration2,
-                m_list[i].data.poc,
-                (int)m_list[i].data.flags, (int)m_list[i].data.pic_struct, (int)m_list[i].data.repeat_pict, (int)m_list[i].data.pict_type);
+                (lls)at(i).pts, (lls)at(i).dts,
+                at(i).duration, at(i).duration2,
+                at(i).poc,
+                (int)at(i).flags, (int)at(i).pic_struct, (int)at(i).repeat_pict, (int)at(i).pict_type);
         }
         fclose(fp);
         return 0;
     }
     //indexの位置への参照を返す
+    //indexはfirstIndex()以上である必要がある
     // !! push側のスレッドからのみ有効 !!
     FramePos& list(uint32_t index) {
-        return m_list[index].data;
+        return at(index);
+    }
+    //保持している最初のフレームのindexを返す (これより前のフレームの情報は破棄済み)
+    int firstIndex() const {
+        return m_nRetired;
+    }
+    //最初のフレームへの参照を返す (破棄済みなら、破棄前に保存したもの)
+    // !! push側のスレッドからのみ有効 !!
+    FramePos& first() {
+        return (m_nRetired > 0) ? m_firstPos : m_list[0].data;
+    }
+    //参照されなくなったフレームの情報を破棄するよう設定する
+    //keepFrames: 登録された参照位置のうち最も前の位置より、さらに前に残しておくフレーム数 (0なら破棄しない)
+    //lookup: findpts/copyによる参照が行われる (findpts/copyの参照位置を登録する)
+    void setRetire(int keepFrames, bool lookup) {
+        m_nKeepFrames = keepFrames;
+        if (lookup && m_nLookupCursor < 0) {
+            m_nLookupCursor = addCursor(m_nRetired);
+        }
+    }
+    //フレーム情報を参照する側の位置(カーソル)を登録し、そのidを返す
+    //登録されたすべてのカーソルの位置より前のフレームのみ破棄する
+    //index: カーソルの初期位置 (INT_MAXなら、moveCursorされるまで破棄を妨げない)
+    //参照が始まる前 (初期化時) にのみ呼ぶこと
+    int addCursor(int index) {
+        std::lock_guard<std::mutex> lock(m_mtxRetire);
+        m_cursor.push_back(std::unique_ptr<std::atomic<int>>(new std::atomic<int>(index)));
+        return (int)m_cursor.size() - 1;
+    }
+    //カーソルの位置を更新する (以降、indexより前のフレームは参照しないことを示す)
+    //idが負なら何もしない
+    void moveCursor(int id, int index) {
+        if (id >= 0) {
+            m_cursor[id]->store(index);
+        }
+    }
+    //[start, fin)の範囲で、before(pos)がfalseとなる最初のindexを返す
+    //範囲内はptsでソートされており、before(pos)は「posが探索対象より前」であることを示す必要がある
+    //startから指数探索を行うので、探索対象がstartの近くにあれば高速
+    // !! push側のスレッドからのみ有効 !!
+    template<typename Func>
+    int lowerBound(int start, int fin, Func before) {
+        FramePos pos;
+        int lo = start, hi = start;
+        for (int step = 1; hi < fin; step *= 2) {
+            m_list.copy(&pos, hi - m_nRetired);
+            if (!before(pos)) {
+                break;
+            }
+            lo = hi + 1;
+            hi = lo + step;
+        }
+        hi = (std::min)(hi, fin);
+        while (lo < hi) {
+            const int mid = lo + ((hi - lo) >> 1);
+            m_list.copy(&pos, mid - m_nRetired);
+            if (before(pos)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
     }
     //初期化
     void clear() {
@@ -205,6 +277,11 @@ public:
         m_nPAFFRewind = 0;
         m_nPtsWrapArroundThreshold = 0xFFFFFFFF;
         m_fpDebugCopyFrameData.reset();
+        m_nRetired = 0;
+        m_nKeepFrames = 0;
+        m_cursor.clear();
+        m_nLookupCursor = -1;
+        m_firstPos = FramePos();
         m_list.init();
     }
     //ここまで計算したdurationを返す
@@ -213,7 +290,7 @@ public:
     }
     //登録された(ptsの確定していないものを含む)フレーム数を返す
     int frameNum() const {
-        return (int)m_list.size();
+        return m_nRetired + (int)m_list.size();
     }
     //ptsが確定したフレーム数を返す
     int fixedNum() const {
@@ -221,14 +298,14 @@ public:
     }
     void clearPtsStatus() {
         if (m_nStreamPtsStatus & RGY_PTS_DUPLICATE) {
-            const int nListSize = (int)m_list.size();
-            for (int i = 0; i < nListSize; i++) {
-                if (m_list[i].data.duration == 0
-                    && m_list[i].data.pts != AV_NOPTS_VALUE
-                    && m_list[i].data.dts != AV_NOPTS_VALUE
-                    && m_list[i+1].data.pts - m_list[i].data.pts <= (std::min)(m_list[i+1].data.duration / 10, 1)
-                    && m_list[i+1].data.dts - m_list[i].data.dts <= (std::min)(m_list[i+1].data.duration / 10, 1)) {
-                    m_list[i].data.duration = m_list[i+1].data.duration;
+            const int nListSize = frameNum();
+            for (int i = m_nRetired; i < nListSize; i++) {
+                if (at(i).duration == 0
+                    && at(i).pts != AV_NOPTS_VALUE
+                    && at(i).dts != AV_NOPTS_VALUE
+                    && at(i+1).pts - at(i).pts <= (std::min)(at(i+1).duration / 10, 1)
+                    && at(i+1).dts - at(i).dts <= (std::min)(at(i+1).duration / 10, 1)) {
+                    at(i).duration = at(i+1).duration;
                 }
             }
         }
@@ -241,35 +318,50 @@ public:
     RGYPtsStatus getStreamPtsStatus() const {
         return m_nStreamPtsStatus;
     }
+    //ptsの一致するフレームの情報のコピーを返す
+    //一致するものがなければ、ptsの直前のフレームの情報を返す
+    //lastIndexには前回の位置を渡し、その次から探索する (見つかった位置で更新される)
     FramePos findpts(int64_t pts, uint32_t *lastIndex) {
-        FramePos pos_last = { 0 };
-        for (uint32_t index = *lastIndex + 1; ; index++) {
-            FramePos pos;
-            if (!m_list.copy(&pos, index)) {
+        std::lock_guard<std::mutex> lock(m_mtxRetire);
+        const int listFin = frameNum();
+        const int fixedFin = (std::min)(m_nNextFixNumIndex, listFin);
+        int start = (std::max)((int)(*lastIndex + 1), m_nRetired);
+        FramePos pos = { 0 };
+        if (start < fixedFin && m_list.copy(&pos, start - m_nRetired) && pts < pos.pts) {
+            //前回の位置より前なら、保持している最初から探索する
+            start = m_nRetired;
+            m_list.copy(&pos, start - m_nRetired);
+        }
+        //ptsが確定した範囲はソート済みなので、二分探索する
+        //wrap arroundを含む場合はソート順とptsの大小が一致しないので、最初から順に探索する
+        FramePos posFixedLast = { 0 };
+        if (start < fixedFin
+            && m_list.copy(&posFixedLast, fixedFin - 1 - m_nRetired)
+            && pos.pts <= posFixedLast.pts) {
+            const int index = lowerBound(start, fixedFin, [pts](const FramePos& p) { return p.pts < pts; });
+            if (index < fixedFin) {
+                m_list.copy(&pos, index - m_nRetired);
+                //pts < pos.ptsであるなら、その前のフレームを返す
+                return setLookupResult((pts == pos.pts) ? index : index - 1, lastIndex);
+            }
+            start = fixedFin;
+        }
+        //残り(ptsが確定していない範囲)は順に探索する
+        for (int index = start; index < listFin; index++) {
+            if (!m_list.copy(&pos, index - m_nRetired)) {
                 break;
             }
             if (pts == pos.pts) {
-                *lastIndex = index;
-                return pos;
+                return setLookupResult(index, lastIndex);
             }
-            pos_last = pos;
         }
-        //最初から探索
-        for (uint32_t index = 0; ; index++) {
-            FramePos pos;
-            if (!m_list.copy(&pos, index)) {
+        for (int index = (start == fixedFin) ? start : m_nRetired; index < listFin; index++) {
+            if (!m_list.copy(&pos, index - m_nRetired)) {
                 break;
             }
-            if (pts == pos.pts) {
-                *lastIndex = index;
-                return pos;
-            }
-            //pts < demux.videoFramePts[i]であるなら、その前のフレームを返す
             if (pts < pos.pts) {
-                *lastIndex = index-1;
-                return pos_last;
+                return setLookupResult(index - 1, lastIndex);
             }
-            pos_last = pos;
         }
         //エラー
         FramePos poserr = { 0 };
@@ -279,14 +371,14 @@ public:
     //FramePosを追加し、内部状態を変更する
     void add(const FramePos& pos) {
         m_list.push(pos);
-        const int nListSize = (int)m_list.size();
+        const int nListSize = frameNum();
         //自分のフレームのインデックス
         const int nIndex = nListSize-1;
         //ptsの補正
         adjustFrameInfo(nIndex);
         //最初のキーフレームの位置を記憶しておく
         if (m_nFirstKeyframePts == AV_NOPTS_VALUE && (pos.flags & AV_PKT_FLAG_KEY) && nIndex == 0) {
-            m_nFirstKeyframePts = m_list[nIndex].data.pts;
+            m_nFirstKeyframePts = at(nIndex).pts;
         }
         //m_nStreamPtsStatusがRGY_PTS_UNKNOWNの場合には、ソートなどは行わない
         if (m_bInputFin || (m_nStreamPtsStatus && nListSize - m_nNextFixNumIndex > (int)AV_FRAME_MAX_REORDER)) {
@@ -295,17 +387,20 @@ public:
             setPocAndFix(nListSize);
         }
         calcDuration();
+        retire();
     };
     //pocの一致するフレームの情報のコピーを返す
     FramePos copy(int poc, uint32_t *lastIndex) {
         assert(lastIndex != nullptr);
-        for (uint32_t index = *lastIndex + 1; ; index++) {
+        std::lock_guard<std::mutex> lock(m_mtxRetire);
+        for (int index = (std::max)((int)(*lastIndex + 1), m_nRetired); ; index++) {
             FramePos pos;
-            if (!m_list.copy(&pos, index)) {
+            if (!m_list.copy(&pos, index - m_nRetired)) {
                 break;
             }
             if (pos.poc == poc) {
                 *lastIndex = index;
+                moveCursor(m_nLookupCursor, index);
                 DEBUG_FRAME_COPY(_ftprintf(m_fpDebugCopyFrameData.get(), _T("request poc: %8d, hit index: %8d, pts: %lld\n"), poc, index, (lls)pos.pts));
                 return pos;
             }
@@ -315,15 +410,18 @@ public:
                 //なにかおかしなことが起こっており、異常なのだが、最後の最後でエラーとしてしまうのもあほらしい
                 //とりあえず、ptsを推定して返してしまう
                 pos.poc = poc;
+                const int relIndex = index - m_nRetired;
                 FramePos pos_tmp = { 0 };
-                m_list.copy(&pos_tmp, index-1);
+                m_list.copy(&pos_tmp, relIndex-1);
                 int nLastPoc = pos_tmp.poc;
                 int64_t nLastPts = pos_tmp.pts;
-                m_list.copy(&pos_tmp, 0);
+                //フレーム長は先頭のフレームから推定する (破棄済みなら、保持しているうちの直近のフレームから推定する)
+                const int relIndex0 = (m_nRetired > 0) ? (std::max)(relIndex - 4, 0) : 0;
+                m_list.copy(&pos_tmp, relIndex0);
                 int64_t pts0 = pos_tmp.pts;
-                m_list.copy(&pos_tmp, 1);
+                m_list.copy(&pos_tmp, relIndex0 + 1);
                 if (pos_tmp.poc == -1) {
-                    m_list.copy(&pos_tmp, 2);
+                    m_list.copy(&pos_tmp, relIndex0 + 2);
                 }
                 int64_t pts1 = pos_tmp.pts;
                 int nFrameDuration = (int)(pts1 - pts0);
@@ -335,7 +433,7 @@ public:
         //エラー
         FramePos pos = { 0 };
         pos.poc = FRAMEPOS_POC_INVALID;
-        DEBUG_FRAME_COPY(_ftprintf(m_fpDebugCopyFrameData.get(), _T("request: %8d, invalid, list size: %d\n"), poc, (int)m_list.size()));
+        DEBUG_FRAME_COPY(_ftprintf(m_fpDebugCopyFrameData.get(), _T("request: %8d, invalid, list size: %d\n"), poc, frameNum()));
         return pos;
     }
     //入力が終了した際に使用し、内部状態を変更する
@@ -344,7 +442,7 @@ public:
         if (m_nStreamPtsStatus == RGY_PTS_UNKNOWN) {
             checkPtsStatus();
         }
-        const int nFrame = (int)m_list.size();
+        const int nFrame = frameNum();
         sortPts(m_nNextFixNumIndex, nFrame - m_nNextFixNumIndex);
         m_nNextFixNumIndex += m_nPAFFRewind;
         for (int i = m_nNextFixNumIndex; i < nFrame; i++) {
@@ -364,7 +462,7 @@ public:
     //現在の情報から、ptsの状態を確認する
     //さらにptsの補正、ptsのソート、pocの確定を行う
     void checkPtsStatus(double durationHintifPtsAllInvalid = 0.0) {
-        const int nInputPacketCount = (int)m_list.size();
+        const int nInputPacketCount = frameNum();
         int nInputFrames = 0;
         int nInputFields = 0;
         int nInputKeys = 0;
@@ -377,33 +475,33 @@ public:
         int nInvalidDuration = 0;
         bool bFractionExists = std::abs(durationHintifPtsAllInvalid - (int)(durationHintifPtsAllInvalid + 0.5)) > 1e-6;
         vector<std::pair<int, int>> durationHistgram;
-        for (int i = 0; i < nInputPacketCount; i++) {
-            nInputFrames += (m_list[i].data.pic_struct & RGY_PICSTRUCT_FRAME) != 0;
-            nInputFields += (m_list[i].data.pic_struct & RGY_PICSTRUCT_FIELD) != 0;
-            nInputKeys   += (m_list[i].data.flags & AV_PKT_FLAG_KEY) != 0;
-            nInvalidDuration += m_list[i].data.duration <= 0;
-            if (m_list[i].data.pts == AV_NOPTS_VALUE) {
+        for (int i = m_nRetired; i < nInputPacketCount; i++) {
+            nInputFrames += (at(i).pic_struct & RGY_PICSTRUCT_FRAME) != 0;
+            nInputFields += (at(i).pic_struct & RGY_PICSTRUCT_FIELD) != 0;
+            nInputKeys   += (at(i).flags & AV_PKT_FLAG_KEY) != 0;
+            nInvalidDuration += at(i).duration <= 0;
+            if (at(i).pts == AV_NOPTS_VALUE) {
                 nInvalidPtsCount++;
-                nInvalidPtsCountField += (m_list[i].data.pic_struct & RGY_PICSTRUCT_FIELD) != 0;
-                nInvalidPtsCountKeyFrame += (m_list[i].data.flags & AV_PKT_FLAG_KEY) != 0;
-                nInvalidPtsCountNonKeyFrame += (m_list[i].data.flags & AV_PKT_FLAG_KEY) == 0;
+                nInvalidPtsCountField += (at(i).pic_struct & RGY_PICSTRUCT_FIELD) != 0;
+                nInvalidPtsCountKeyFrame += (at(i).flags & AV_PKT_FLAG_KEY) != 0;
+                nInvalidPtsCountNonKeyFrame += (at(i).flags & AV_PKT_FLAG_KEY) == 0;
             }
-            if (m_list[i].data.dts == AV_NOPTS_VALUE) {
+            if (at(i).dts == AV_NOPTS_VALUE) {
                 nInvalidDtsCount++;
             }
-            if (i > 0) {
+            if (i > m_nRetired) {
                 //VP8/VP9では重複するpts/dts/durationを持つフレームが存在することがあるが、これを無視する
                 if (bFractionExists
-                    && m_list[i].data.duration > 0
-                    && m_list[i].data.pts != AV_NOPTS_VALUE
-                    && m_list[i].data.dts != AV_NOPTS_VALUE
-                    && m_list[i].data.pts - m_list[i-1].data.pts <= (std::min)(m_list[i].data.duration / 10, 1)
-                    && m_list[i].data.dts - m_list[i-1].data.dts <= (std::min)(m_list[i].data.duration / 10, 1)
-                    && m_list[i].data.duration == m_list[i-1].data.duration) {
+                    && at(i).duration > 0
+                    && at(i).pts != AV_NOPTS_VALUE
+                    && at(i).dts != AV_NOPTS_VALUE
+                    && at(i).pts - at(i-1).pts <= (std::min)(at(i).duration / 10, 1)
+                    && at(i).dts - at(i-1).dts <= (std::min)(at(i).duration / 10, 1)
+                    && at(i).duration == at(i-1).duration) {
                     nDuplicateFrameInfo++;
                 }
             }
-            int nDuration = m_list[i].data.duration;
+            int nDuration = at(i).duration;
             auto target = std::find_if(durationHistgram.begin(), durationHistgram.end(), [nDuration](const std::pair<int, int>& pair) { return pair.first == nDuration; });
             if (target != durationHistgram.end()) {
                 target->second++;
@@ -423,7 +521,7 @@ public:
         } else {
             m_dFrameDuration = durationHintifPtsAllInvalid;
             if (nInvalidPtsCount >= nInputPacketCount - 1) {
-                if (m_list[0].data.duration || durationHintifPtsAllInvalid > 0.0) {
+                if (first().duration || durationHintifPtsAllInvalid > 0.0) {
                     //durationが得られていれば、durationに基づいて、cfrでptsを発行する
                     //主にH.264/HEVCのESなど
                     m_nStreamPtsStatus |= RGY_PTS_ALL_INVALID;
@@ -453,9 +551,9 @@ public:
         }
         if ((m_nStreamPtsStatus & RGY_PTS_ALL_INVALID)) {
             auto& mostPopularDuration = durationHistgram[durationHistgram.size() > 1 && durationHistgram[0].first == 0];
-            if ((m_dFrameDuration > 0.0 && m_list[0].data.duration == 0) || mostPopularDuration.first == 0) {
+            if ((m_dFrameDuration > 0.0 && first().duration == 0) || mostPopularDuration.first == 0) {
                 //主にH.264/HEVCのESなど向けの対策
-                m_list[0].data.duration = (int)(m_dFrameDuration * ((m_list[0].data.pic_struct & RGY_PICSTRUCT_FIELD) ? 0.5 : 1.0) + 0.5);
+                first().duration = (int)(m_dFrameDuration * ((first().pic_struct & RGY_PICSTRUCT_FIELD) ? 0.5 : 1.0) + 0.5);
             } else {
                 //durationのヒストグラムを作成
                 m_dFrameDuration = durationHistgram[durationHistgram.size() > 1 && durationHistgram[0].first == 0].first;
@@ -467,15 +565,15 @@ public:
         sortPts(m_nNextFixNumIndex, nInputPacketCount - m_nNextFixNumIndex);
         setPocAndFix(nInputPacketCount);
         if (m_nNextFixNumIndex > 1) {
-            int64_t pts0 = m_list[0].data.pts;
-            int64_t pts1 = m_list[1 + (m_list[0].data.poc == -1)].data.pts;
+            int64_t pts0 = first().pts;
+            int64_t pts1 = at(1 + (first().poc == -1)).pts;
             m_nPtsWrapArroundThreshold = (uint32_t)clamp((int64_t)(std::max)((uint32_t)(pts1 - pts0), (uint32_t)(m_dFrameDuration + 0.5)) * 360, 360, (int64_t)0xFFFFFFFF);
         }
     }
     RGY_PICSTRUCT getVideoPicStruct() {
-        const int nListSize = (int)m_list.size();
-        for (int i = 0; i < nListSize; i++) {
-            auto pic_struct = m_list[i].data.pic_struct;
+        const int nListSize = frameNum();
+        for (int i = m_nRetired; i < nListSize; i++) {
+            auto pic_struct = at(i).pic_struct;
             if (pic_struct & RGY_PICSTRUCT_INTERLACED) {
                 return (RGY_PICSTRUCT)(pic_struct & RGY_PICSTRUCT_INTERLACED);
             }
@@ -486,59 +584,97 @@ protected:
     //ptsでソート
     void sortPts(uint32_t index, uint32_t len) {
 #if !defined(_MSC_VER) && __cplusplus <= 201103
-        FramePos *pStart = (FramePos *)m_list.get(index);
-        FramePos *pEnd = (FramePos *)m_list.get(index + len);
+        FramePos *pStart = (FramePos *)m_list.get(index - m_nRetired);
+        FramePos *pEnd = (FramePos *)m_list.get(index + len - m_nRetired);
         std::sort(pStart, pEnd, CompareFramePos());
 #else
         const auto nPtsWrapArroundThreshold = m_nPtsWrapArroundThreshold;
-        std::sort(m_list.get(index), m_list.get(index + len), [nPtsWrapArroundThreshold](const auto& posA, const auto& posB) {
+        std::sort(m_list.get(index - m_nRetired), m_list.get(index + len - m_nRetired), [nPtsWrapArroundThreshold](const auto& posA, const auto& posB) {
             return ((uint32_t)(std::abs(posA.data.pts - posB.data.pts)) < nPtsWrapArroundThreshold) ? posA.data.pts < posB.data.pts : posB.data.pts < posA.data.pts; });
 #endif
     }
+    //indexの位置への参照を返す (indexは破棄したフレームを含めた通し番号)
+    FramePos& at(int index) {
+        return m_list[index - m_nRetired].data;
+    }
+    //findptsの結果を設定し、indexの位置のフレーム情報を返す
+    FramePos setLookupResult(int index, uint32_t *lastIndex) {
+        FramePos pos = { 0 };
+        if (index >= m_nRetired) {
+            m_list.copy(&pos, index - m_nRetired);
+        }
+        *lastIndex = (uint32_t)index;
+        moveCursor(m_nLookupCursor, index);
+        return pos;
+    }
+    //参照されなくなったフレームの情報を破棄する
+    //ptsの確定・durationの計算・登録されたすべてのカーソルが通過した位置から、m_nKeepFrames以上前のものが対象
+    //破棄はpush側のスレッドでのみ行う
+    void retire() {
+        if (m_nKeepFrames <= 0) {
+            return;
+        }
+        int retireFin = (std::min)(m_nNextFixNumIndex, m_nDurationNum);
+        for (const auto& cursor : m_cursor) {
+            retireFin = (std::min)(retireFin, cursor->load());
+        }
+        retireFin -= m_nKeepFrames;
+        //ある程度まとめて破棄する
+        if (retireFin - m_nRetired < FRAMEPOS_RETIRE_INTERVAL) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_mtxRetire);
+        if (m_nRetired == 0) {
+            m_firstPos = m_list[0].data;
+        }
+        for (; m_nRetired < retireFin; m_nRetired++) {
+            m_list.pop();
+        }
+    }
     //ptsの補正
     void adjustFrameInfo(uint32_t nIndex) {
         if (m_nStreamPtsStatus & RGY_PTS_SOMETIMES_INVALID) {
             if (m_nStreamPtsStatus & RGY_DTS_SOMETIMES_INVALID) {
                 //ptsもdtsはあてにならないので、durationから再構築する (ワンセグなど)
                 if (nIndex == 0) {
-                    if (m_list[nIndex].data.pts == AV_NOPTS_VALUE) {
-                        m_list[nIndex].data.pts = 0;
+                    if (at(nIndex).pts == AV_NOPTS_VALUE) {
+                        at(nIndex).pts = 0;
                     }
-                } else if (m_list[nIndex].data.pts == AV_NOPTS_VALUE) {
-                    m_list[nIndex].data.pts = m_list[nIndex-1].data.pts + m_list[nIndex-1].data.duration;
+                } else if (at(nIndex).pts == AV_NOPTS_VALUE) {
+                    at(nIndex).pts = at(nIndex-1).pts + at(nIndex-1).duration;
                 }
             } else {
                 //ptsはあてにならないので、dtsから再構築する (VC-1など)
-                int64_t firstFramePtsDtsDiff = m_list[0].data.pts - m_list[0].data.dts;
-                if (nIndex > 0 && m_list[nIndex].data.dts == AV_NOPTS_VALUE) {
-                    m_list[nIndex].data.dts = m_list[nIndex-1].data.dts + m_list[0].data.duration;
+                int64_t firstFramePtsDtsDiff = first().pts - first().dts;
+                if (nIndex > 0 && at(nIndex).dts == AV_NOPTS_VALUE) {
+                    at(nIndex).dts = at(nIndex-1).dts + first().duration;
                 }
-                m_list[nIndex].data.pts = m_list[nIndex].data.dts + firstFramePtsDtsDiff;
+                at(nIndex).pts = at(nIndex).dts + firstFramePtsDtsDiff;
             }
-        } else if (m_list[nIndex].data.pts == AV_NOPTS_VALUE) {
+        } else if (at(nIndex).pts == AV_NOPTS_VALUE) {
             if (nIndex == 0) {
-                m_list[nIndex].data.pts = 0;
-                m_list[nIndex].data.dts = 0;
+                at(nIndex).pts = 0;
+                at(nIndex).dts = 0;
             } else if (m_nStreamPtsStatus & (RGY_PTS_ALL_INVALID | RGY_PTS_NONKEY_INVALID)) {
                 //AVPacketのもたらすptsが無効であれば、CFRを仮定して適当にptsとdurationを突っ込んでいく
-                double frameDuration = m_dFrameDuration * ((m_list[0].data.pic_struct & RGY_PICSTRUCT_FIELD) ? 2.0 : 1.0);
-                m_list[nIndex].data.pts = (int64_t)(nIndex * frameDuration * ((m_list[nIndex].data.pic_struct & RGY_PICSTRUCT_FIELD) ? 0.5 : 1.0) + 0.5);
-                m_list[nIndex].data.dts = m_list[nIndex].data.pts;
+                double frameDuration = m_dFrameDuration * ((first().pic_struct & RGY_PICSTRUCT_FIELD) ? 2.0 : 1.0);
+                at(nIndex).pts = (int64_t)(nIndex * frameDuration * ((at(nIndex).pic_struct & RGY_PICSTRUCT_FIELD) ? 0.5 : 1.0) + 0.5);
+                at(nIndex).dts = at(nIndex).pts;
             } else if (m_nStreamPtsStatus & RGY_PTS_NONKEY_INVALID) {
                 //キーフレーム以外のptsとdtsが無効な場合は、適当に推定する
-                double frameDuration = m_dFrameDuration * ((m_list[0].data.pic_struct & RGY_PICSTRUCT_FIELD) ? 2.0 : 1.0);
-                m_list[nIndex].data.pts = m_list[nIndex-1].data.pts + (int)(frameDuration * ((m_list[nIndex].data.pic_struct & RGY_PICSTRUCT_FIELD) ? 0.5 : 1.0) + 0.5);
-                m_list[nIndex].data.dts = m_list[nIndex-1].data.dts + (int)(frameDuration * ((m_list[nIndex].data.pic_struct & RGY_PICSTRUCT_FIELD) ? 0.5 : 1.0) + 0.5);
+                double frameDuration = m_dFrameDuration * ((first().pic_struct & RGY_PICSTRUCT_FIELD) ? 2.0 : 1.0);
+                at(nIndex).pts = at(nIndex-1).pts + (int)(frameDuration * ((at(nIndex).pic_struct & RGY_PICSTRUCT_FIELD) ? 0.5 : 1.0) + 0.5);
+                at(nIndex).dts = at(nIndex-1).dts + (int)(frameDuration * ((at(nIndex).pic_struct & RGY_PICSTRUCT_FIELD) ? 0.5 : 1.0) + 0.5);
             } else if (m_nStreamPtsStatus & RGY_PTS_HALF_INVALID) {
                 //ptsがないのは音声抽出で、正常に抽出されない問題が生じる
                 //半分PTSがないPAFFのような動画については、前のフレームからの補完を行う
-                if (m_list[nIndex].data.dts == AV_NOPTS_VALUE) {
-                    m_list[nIndex].data.dts = m_list[nIndex-1].data.dts + m_list[nIndex-1].data.duration;
+                if (at(nIndex).dts == AV_NOPTS_VALUE) {
+                    at(nIndex).dts = at(nIndex-1).dts + at(nIndex-1).duration;
                 }
-                m_list[nIndex].data.pts = m_list[nIndex-1].data.pts + m_list[nIndex-1].data.duration;
+                at(nIndex).pts = at(nIndex-1).pts + at(nIndex-1).duration;
             } else if (m_nStreamPtsStatus & RGY_PTS_NORMAL) {
-                if (m_list[nIndex].data.pts == AV_NOPTS_VALUE) {
-                    m_list[nIndex].data.pts = m_list[nIndex-1].data.pts + m_list[nIndex-1].data.duration;
+                if (at(nIndex).pts == AV_NOPTS_VALUE) {
+                    at(nIndex).pts = at(nIndex-1).pts + at(nIndex-1).duration;
                 }
             }
         }
@@ -546,39 +682,39 @@ protected:
     //ソートにより確定したptsに対して、pocを設定する
     void setPoc(int index) {
         if ((m_nStreamPtsStatus & RGY_PTS_DUPLICATE)
-            && m_list[index].data.duration == 0
-            && m_list[index+1].data.pts - m_list[index].data.pts <= (std::min)(m_list[index+1].data.duration / 10, 1)
-            && m_list[index+1].data.dts - m_list[index].data.dts <= (std::min)(m_list[index+1].data.duration / 10, 1)) {
+            && at(index).duration == 0
+            && at(index+1).pts - at(index).pts <= (std::min)(at(index+1).duration / 10, 1)
+            && at(index+1).dts - at(index).dts <= (std::min)(at(index+1).duration / 10, 1)) {
             //VP8/VP9では重複するpts/dts/durationを持つフレームが存在することがあるが、これを無視する
-            m_list[index].data.poc = FRAMEPOS_POC_INVALID;
-        } else if (m_list[index].data.pic_struct & RGY_PICSTRUCT_FIELD) {
-            if (index > 0 && (m_list[index-1].data.poc != FRAMEPOS_POC_INVALID && (m_list[index-1].data.pic_struct & RGY_PICSTRUCT_FIELD))) {
-                m_list[index].data.poc = FRAMEPOS_POC_INVALID;
-                m_list[index-1].data.duration2 = m_list[index].data.duration;
+            at(index).poc = FRAMEPOS_POC_INVALID;
+        } else if (at(index).pic_struct & RGY_PICSTRUCT_FIELD) {
+            if (index > 0 && (at(index-1).poc != FRAMEPOS_POC_INVALID && (at(index-1).pic_struct & RGY_PICSTRUCT_FIELD))) {
+                at(index).poc = FRAMEPOS_POC_INVALID;
+                at(index-1).duration2 = at(index).duration;
             } else {
-                m_list[index].data.poc = m_nLastPoc++;
+                at(index).poc = m_nLastPoc++;
             }
         } else {
-            m_list[index].data.poc = m_nLastPoc++;
+            at(index).poc = m_nLastPoc++;
         }
     }
     //ソート後にindexのdurationを再計算する
     //ソートはindex+1まで確定している必要がある
     //ソート後のこの段階では、AV_NOPTS_VALUEはないものとする
     void adjustDurationAfterSort(int index) {
-        int diff = (int)(m_list[index+1].data.pts - m_list[index].data.pts);
+        int diff = (int)(at(index+1).pts - at(index).pts);
         if ((m_nStreamPtsStatus & RGY_PTS_DUPLICATE)
             && diff <= 1
-            && m_list[index].data.duration > 0
-            && m_list[index].data.pts != AV_NOPTS_VALUE
-            && m_list[index].data.dts != AV_NOPTS_VALUE
-            && m_list[index+1].data.duration == m_list[index].data.duration
-            && m_list[index+1].data.pts - m_list[index].data.pts <= (std::min)(m_list[index].data.duration / 10, 1)
-            && m_list[index+1].data.dts - m_list[index].data.dts <= (std::min)(m_list[index].data.duration / 10, 1)) {
+            && at(index).duration > 0
+            && at(index).pts != AV_NOPTS_VALUE
+            && at(index).dts != AV_NOPTS_VALUE
+            && at(index+1).duration == at(index).duration
+            && at(index+1).pts - at(index).pts <= (std::min)(at(index).duration / 10, 1)
+            && at(index+1).dts - at(index).dts <= (std::min)(at(index).duration / 10, 1)) {
             //VP8/VP9では重複するpts/dts/durationを持つフレームが存在することがあるが、これを無視する
-            m_list[index].data.duration = 0;
+            at(index).duration = 0;
         } else if (diff > 0) {
-            m_list[index].data.duration = diff;
+            at(index).duration = diff;
         }
     }
     //進捗表示用のdurationの計算を行う
@@ -586,7 +722,7 @@ protected:
     void calcDuration() {
         int nNonDurationCalculatedFrames = m_nNextFixNumIndex - m_nDurationNum;
         if (nNonDurationCalculatedFrames >= 16) {
-            const auto *pos_fixed = m_list.get(m_nDurationNum);
+            const auto *pos_fixed = m_list.get(m_nDurationNum - m_nRetired);
             int64_t duration = pos_fixed[nNonDurationCalculatedFrames-1].data.pts - pos_fixed[0].data.pts;
             if (duration < 0 || duration > m_nPtsWrapArroundThreshold) {
                 duration = 0;
@@ -607,7 +743,7 @@ protected:
         int nSortFixedSize = nSortedSize - (int)AV_FRAME_MAX_REORDER - 1;
         m_nNextFixNumIndex += m_nPAFFRewind;
         for (; m_nNextFixNumIndex < nSortFixedSize; m_nNextFixNumIndex++) {
-            if (m_list[m_nNextFixNumIndex].data.pts < m_nFirstKeyframePts //ソートの先頭のptsが塚下キーフレームの先頭のptsよりも小さいことがある(opengop)
+            if (at(m_nNextFixNumIndex).pts < m_nFirstKeyframePts //ソートの先頭のptsが塚下キーフレームの先頭のptsよりも小さいことがある(opengop)
                 && m_nNextFixNumIndex <= 16) { //wrap arroundの場合は除く
                 //これはフレームリストから取り除く
                 m_list.pop();
@@ -623,8 +759,8 @@ protected:
         //もし、現在のインデックスがフィールドデータの片割れなら、次のフィールドがくるまでdurationは確定しない
         //setPocでduration2が埋まるのを待つ必要がある
         if (m_nNextFixNumIndex > 0
-            && (m_list[m_nNextFixNumIndex-1].data.pic_struct & RGY_PICSTRUCT_FIELD)
-            && m_list[m_nNextFixNumIndex-1].data.poc != FRAMEPOS_POC_INVALID) {
+            && (at(m_nNextFixNumIndex-1).pic_struct & RGY_PICSTRUCT_FIELD)
+            && at(m_nNextFixNumIndex-1).poc != FRAMEPOS_POC_INVALID) {
             m_nNextFixNumIndex--;
             m_nPAFFRewind = 1;
         }
@@ -642,6 +778,12 @@ protected:
     int m_nPAFFRewind; //PAFFのdurationを確定させるため、戻した枚数
     uint32_t m_nPtsWrapArroundThreshold; //wrap arroundを判定する閾値
     unique_ptr<FILE, fp_deleter> m_fpDebugCopyFrameData; //copyのデバッグ用
+    int m_nRetired; //破棄したフレーム数 (= m_listの先頭のフレームのindex)
+    int m_nKeepFrames; //カーソルの位置より前に残しておくフレーム数 (0なら破棄しない)
+    vector<unique_ptr<std::atomic<int>>> m_cursor; //フレーム情報を参照する側の位置 (これより前のフレームのみ破棄する)
+    int m_nLookupCursor; //findpts/copyの参照位置のカーソルのid (-1なら未登録)
+    FramePos m_firstPos; //破棄した最初のフレームの情報 (ptsの補正に使用する)
+    std::mutex m_mtxRetire; //破棄とfindpts/copyの排他制御
 };
 
 
@@ -696,8 +838,10 @@ typedef struct AVDemuxStream {
     int                       nIndex;                 //音声・字幕のストリームID (libavのストリームID)
     int                       nTrackId;               //音声のトラックID (QSVEncC独自, 1,2,3,...)、字幕は0
     int                       nSubStreamId;           //通常は0、音声のチャンネルを分離する際に複製として作成
+    int                       nPktQueueIdx;           //このトラックのパケットを格納するqStreamPktL2のindex
     AVStream                 *pStream;                //音声・字幕のストリーム
     int                       nLastVidIndex;          //音声の直前の相当する動画の位置
+    int                       nFramePosCursor;        //FramePosListに登録した参照位置のid (-1なら未登録)
     int64_t                   nExtractErrExcess;      //音声抽出のあまり (音声が多くなっていれば正、足りなくなっていれば負)
     AVPacket                  pktSample;              //サンプル用の音声・字幕データ
     int                       nDelayOfStream;         //音声側の遅延 (pkt_timebase基準)
@@ -721,7 +865,7 @@ typedef struct AVDemuxer {
     AVDemuxThread            thread;
     RGYQueueSPSP<AVPacket>     qVideoPkt;
     deque<AVPacket>          qStreamPktL1;
-    RGYQueueSPSP<AVPacket>     qStreamPktL2;
+    vector<unique_ptr<RGYQueueSPSP<AVPacket>>> qStreamPktL2; //トラックごとの出力用音声・字幕パケットのキュー
 } AVDemuxer;
 
 typedef struct AvcodecReaderPrm {
@@ -752,6 +896,8 @@ typedef struct AvcodecReaderPrm {
     PerfQueueInfo *pQueueInfo;               //キューの情報を格納する構造体
     DeviceCodecCsp *pHWDecCodecCsp;          //HWデコーダのサポートするコーデックと色空間
     bool           bVideoDetectPulldown;     //pulldownの検出を試みるかどうか
+    bool           bVideoCopy;               //映像をデコードせず、ビットストリームのまま取り出す (remux用)
+    bool           bFramePosLookup;          //GetFramePosList()->findpts/copyでフレーム情報を参照する
 } AvcodecReaderPrm;
 
 
@@ -781,9 +927,18 @@ public:
 
     //動画の入力情報を取得する
     const AVStream *GetInputVideoStream();
+
+    //動画の長さ(秒)を取得する (不明な場合は0)
+    double GetInputVideoDuration();
     
-    //音声・字幕パケットの配列を取得する
-    vector<AVPacket> GetStreamDataPackets();
+    //出力する音声・字幕パケットをトラックごとのキューに準備する
+    void LoadStreamDataPackets();
+
+    //指定したトラックの出力用音声・字幕パケットのキューを取得する
+    //キューはLoadStreamDataPackets()を呼んだスレッド (エンコードのメインスレッド) からのみ取り出すこと
+    //Writer側はWriteNextPacketで受け取ったパケットのflagsの上位16bitのtrackIdで音声処理スレッドへ振り分けるので、
+    //trackIdはキューに分けた後もflagsに格納しておく
+    RGYQueueSPSP<AVPacket> *GetStreamPacketQueue(int nTrackId);
 
     //音声・字幕のコーデックコンテキストを取得する
     vector<AVDemuxStream> GetInputStreamInfo();
@@ -827,6 +982,9 @@ protected:
     //対象ストリームのパケットを取得
     int getSample(AVPacket *pkt, bool bTreatFirstPacketAsKeyframe = false);
 
+    //音声・字幕のストリームごとに、FramePosListの参照位置を登録する
+    void addStreamFramePosCursor();
+
     //対象・字幕の音声パケットを追加するかどうか
     bool checkStreamPacketToAdd(const AVPacket *pkt, AVDemuxStream *pStream);
 
@@ -27,6 +27,7 @@
 
 #include "rgy_input_avs.h"
 #if ENABLE_AVISYNTH_READER
+#include <chrono>
 
 #if defined(_WIN32) || defined(_WIN64)
 static const TCHAR *avisynth_dll_name = _T("avisynth.dll");
@@ -57,7 +58,20 @@ RGYInputAvs::RGYInputAvs() :
     m_sAVSenv(nullptr),
     m_sAVSclip(nullptr),
     m_sAVSinfo(nullptr),
-    m_sAvisynth() {
+    m_sAvisynth(),
+    m_nPrefetch(0),
+    m_prefetchSlot(),
+    m_thPrefetch(),
+    m_mtxPrefetch(),
+    m_cvPrefetchReady(),
+    m_cvPrefetchFree(),
+    m_nPrefetchRead(0),
+    m_nPrefetchFin(0),
+    m_bPrefetchAbort(false),
+    m_nPrefetchHit(0),
+    m_nPrefetchMiss(0),
+    m_nPrefetchStallUs(0),
+    m_pQueueInfo(nullptr) {
     memset(&m_sAvisynth, 0, sizeof(m_sAvisynth));
     m_strReaderName = _T("avs");
 }
@@ -114,8 +128,10 @@ RGY_ERR RGYInputAvs::load_avisynth() {
 }
 
 RGY_ERR RGYInputAvs::Init(const TCHAR *strFileName, VideoInfo *pInputInfo, const void *prm) {
-    UNREFERENCED_PARAMETER(prm);
     memcpy(&m_inputVideoInfo, pInputInfo, sizeof(m_inputVideoInfo));
+    const RGYInputAvsPrm *avsPrm = (const RGYInputAvsPrm *)prm;
+    m_nPrefetch = (avsPrm) ? clamp(avsPrm->prefetch, 0, RGY_AVS_PREFETCH_MAX) : 0;
+    m_pQueueInfo = (avsPrm) ? avsPrm->pQueueInfo : nullptr;
 
     if (load_avisynth() != RGY_ERR_NONE) {
         AddMessage(RGY_LOG_ERROR, _T("failed to load %s.\n"), avisynth_dll_name);
@@ -217,6 +233,9 @@ RGY_ERR RGYInputAvs::Init(const TCHAR *strFileName, VideoInfo *pInputInfo, const
     }
     m_sAvisynth.release_value(val_version);
 
+    m_nPrefetch = (std::min)(m_nPrefetch, m_inputVideoInfo.frames);
+    AddMessage(RGY_LOG_DEBUG, _T("prefetch: %d frames.\n"), m_nPrefetch);
+
     CreateInputInfo(avisynth_version.c_str(), RGY_CSP_NAMES[m_sConvert->csp_from], RGY_CSP_NAMES[m_sConvert->csp_to], get_simd_str(m_sConvert->simd), &m_inputVideoInfo);
     AddMessage(RGY_LOG_DEBUG, m_strInputInfo);
     *pInputInfo = m_inputVideoInfo;
@@ -225,6 +244,12 @@ RGY_ERR RGYInputAvs::Init(const TCHAR *strFileName, VideoInfo *pInputInfo, const
 
 void RGYInputAvs::Close() {
     AddMessage(RGY_LOG_DEBUG, _T("Closing...\n"));
+    //AviSynthを解放する前に先読みスレッドを終了する
+    stopPrefetch();
+    if (m_nPrefetchHit + m_nPrefetchMiss > 0) {
+        AddMessage(RGY_LOG_DEBUG, _T("prefetch: hit %lld, miss %lld, stall %.1f ms.\n"),
+            (long long)m_nPrefetchHit, (long long)m_nPrefetchMiss, m_nPrefetchStallUs * 1e-3);
+    }
     if (m_sAVSclip)
         m_sAvisynth.release_clip(m_sAVSclip);
     if (m_sAVSenv)
@@ -235,6 +260,11 @@ void RGYInputAvs::Close() {
     m_sAVSenv = nullptr;
     m_sAVSclip = nullptr;
     m_sAVSinfo = nullptr;
+    m_nPrefetch = 0;
+    m_nPrefetchHit = 0;
+    m_nPrefetchMiss = 0;
+    m_nPrefetchStallUs = 0;
+    m_pQueueInfo = nullptr;
     m_pEncSatusInfo.reset();
     AddMessage(RGY_LOG_DEBUG, _T("Closed.\n"));
 }
@@ -247,11 +277,56 @@ RGY_ERR RGYInputAvs::LoadNextFrame(RGYFrame *pSurface) {
         return RGY_ERR_MORE_DATA;
     }
 
-    AVS_VideoFrame *frame = m_sAvisynth.get_frame(m_sAVSclip, m_pEncSatusInfo->m_sData.frameIn);
-    if (frame == nullptr) {
-        return RGY_ERR_MORE_DATA;
+    const int frameIdx = (int)m_pEncSatusInfo->m_sData.frameIn;
+    if (m_nPrefetch > 0) {
+        if (!m_thPrefetch.joinable()) {
+            auto err = startPrefetch(frameIdx);
+            if (err != RGY_ERR_NONE) {
+                return err;
+            }
+        }
+        auto& slot = m_prefetchSlot[frameIdx % m_prefetchSlot.size()];
+        {
+            std::unique_lock<std::mutex> lock(m_mtxPrefetch);
+            if (slot.frameIdx == frameIdx) {
+                m_nPrefetchHit++;
+            } else {
+                m_nPrefetchMiss++;
+                const auto waitStart = std::chrono::steady_clock::now();
+                m_cvPrefetchReady.wait(lock, [&]() { return slot.frameIdx == frameIdx || frameIdx >= m_nPrefetchFin; });
+                m_nPrefetchStallUs += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - waitStart).count();
+            }
+        }
+        if (m_pQueueInfo) {
+            m_pQueueInfo->prefetch_hit = (size_t)m_nPrefetchHit;
+            m_pQueueInfo->prefetch_miss = (size_t)m_nPrefetchMiss;
+            m_pQueueInfo->prefetch_stall_ms = (size_t)(m_nPrefetchStallUs / 1000);
+        }
+        if (slot.frameIdx != frameIdx || !slot.valid) {
+            return RGY_ERR_MORE_DATA;
+        }
+        //スロットは、m_nPrefetchReadを進めるまで先読みスレッドから書き換えられない
+        copyConvertedFrame(pSurface, &slot.frame);
+        {
+            std::lock_guard<std::mutex> lock(m_mtxPrefetch);
+            slot.frameIdx = -1;
+            m_nPrefetchRead = frameIdx + 1;
+        }
+        m_cvPrefetchFree.notify_one();
+    } else {
+        AVS_VideoFrame *frame = m_sAvisynth.get_frame(m_sAVSclip, frameIdx);
+        if (frame == nullptr) {
+            return RGY_ERR_MORE_DATA;
+        }
+        convertFrame(frame, pSurface);
+        m_sAvisynth.release_video_frame(frame);
     }
 
+    m_pEncSatusInfo->m_sData.frameIn++;
+    return m_pEncSatusInfo->UpdateDisplay();
+}
+
+void RGYInputAvs::convertFrame(AVS_VideoFrame *frame, RGYFrame *pSurface) {
     void *dst_array[3];
     pSurface->ptrArray(dst_array, m_sConvert->csp_to == RGY_CSP_RGB24 || m_sConvert->csp_to == RGY_CSP_RGB32);
     const void *src_array[3] = { m_sAvisynth.get_read_ptr_p(frame, AVS_PLANAR_Y), m_sAvisynth.get_read_ptr_p(frame, AVS_PLANAR_U), m_sAvisynth.get_read_ptr_p(frame, AVS_PLANAR_V) };
@@ -260,11 +335,85 @@ RGY_ERR RGYInputAvs::LoadNextFrame(RGYFrame *pSurface) {
         dst_array, src_array,
         m_inputVideoInfo.srcWidth, m_sAvisynth.get_pitch_p(frame, AVS_PLANAR_Y), m_sAvisynth.get_pitch_p(frame, AVS_PLANAR_U),
         pSurface->pitch(), m_inputVideoInfo.srcHeight, m_inputVideoInfo.srcHeight, m_inputVideoInfo.crop.c);
-    
-    m_sAvisynth.release_video_frame(frame);
+}
 
-    m_pEncSatusInfo->m_sData.frameIn++;
-    return m_pEncSatusInfo->UpdateDisplay();
+//trimの設定はInit後に行われるので、最初のLoadNextFrameで先読みを開始する
+RGY_ERR RGYInputAvs::startPrefetch(int frameIdx) {
+    m_prefetchSlot.resize(m_nPrefetch);
+    for (auto& slot : m_prefetchSlot) {
+        slot.frame = RGYFrameInit();
+        slot.frameIdx = -1;
+        slot.valid = false;
+        if (nullptr == (slot.buffer = allocConvertedFrame(&slot.frame))) {
+            AddMessage(RGY_LOG_ERROR, _T("Failed to allocate memory for prefetch buffer.\n"));
+            return RGY_ERR_NULL_PTR;
+        }
+    }
+    //LoadNextFrameで打ち切るフレーム (getVideoTrimMaxFramIdx() + TRIM_OVERREAD_FRAMES) より先は読まない
+    const int64_t trimFin = (int64_t)getVideoTrimMaxFramIdx() + TRIM_OVERREAD_FRAMES + 1;
+    m_nPrefetchRead = frameIdx;
+    m_nPrefetchFin = (int)(std::min)((int64_t)m_inputVideoInfo.frames, trimFin);
+    m_bPrefetchAbort = false;
+    AddMessage(RGY_LOG_DEBUG, _T("start prefetch thread: frame %d - %d.\n"), frameIdx, m_nPrefetchFin - 1);
+    m_thPrefetch = std::thread(&RGYInputAvs::prefetchThreadFunc, this, frameIdx, m_nPrefetchFin);
+    return RGY_ERR_NONE;
+}
+
+void RGYInputAvs::stopPrefetch() {
+    if (m_thPrefetch.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mtxPrefetch);
+            m_bPrefetchAbort = true;
+        }
+        m_cvPrefetchFree.notify_all();
+        m_thPrefetch.join();
+    }
+    for (auto& slot : m_prefetchSlot) {
+        if (slot.buffer) {
+            _aligned_free(slot.buffer);
+        }
+    }
+    m_prefetchSlot.clear();
+    m_bPrefetchAbort = false;
+}
+
+void RGYInputAvs::prefetchThreadFunc(int frameStart, int frameFin) {
+    const int slots = (int)m_prefetchSlot.size();
+    int frameIdx = frameStart;
+    for (; frameIdx < frameFin; frameIdx++) {
+        {
+            //LoadNextFrameで受け取られていないフレームがslots分たまったら待機する
+            std::unique_lock<std::mutex> lock(m_mtxPrefetch);
+            m_cvPrefetchFree.wait(lock, [&]() { return m_bPrefetchAbort || frameIdx - m_nPrefetchRead < slots; });
+            if (m_bPrefetchAbort) {
+                break;
+            }
+        }
+        auto& slot = m_prefetchSlot[frameIdx % slots];
+        bool valid = false;
+        AVS_VideoFrame *frame = m_sAvisynth.get_frame(m_sAVSclip, frameIdx);
+        if (frame) {
+            convertFrame(frame, &slot.frame);
+            m_sAvisynth.release_video_frame(frame);
+            valid = true;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mtxPrefetch);
+            slot.valid = valid;
+            slot.frameIdx = frameIdx;
+        }
+        m_cvPrefetchReady.notify_one();
+        if (!valid) {
+            frameIdx++;
+            break;
+        }
+    }
+    //これ以上フレームを先読みしないので、LoadNextFrameの待機を終了させる
+    {
+        std::lock_guard<std::mutex> lock(m_mtxPrefetch);
+        m_nPrefetchFin = (std::min)(m_nPrefetchFin, frameIdx);
+    }
+    m_cvPrefetchReady.notify_one();
 }
 
 #endif //ENABLE_AVISYNTH_READER
@@ -42,6 +42,9 @@
 #include "rgy_osdep.h"
 #include "rgy_input.h"
 #pragma warning(pop)
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #define AVS_FUNCTYPE(x) typedef decltype(avs_ ## x)* func_avs_ ## x;
 
@@ -86,6 +89,19 @@ struct avs_dll_t {
 
 #undef AVS_FUNCDECL
 
+struct RGYInputAvsPrm {
+    int prefetch;              //先読みするフレーム数 (0で先読みしない)
+    PerfQueueInfo *pQueueInfo; //先読みの統計の出力先
+};
+
+//先読みしたフレームの受け取り先
+struct RGYAvsPrefetchSlot {
+    uint8_t *buffer;  //変換先として事前に確保したホストメモリ
+    RGYFrame frame;   //変換先のフレーム情報
+    int frameIdx;     //格納されているフレーム番号 (-1: 未格納)
+    bool valid;       //フレームの取得・変換に成功したか
+};
+
 class RGYInputAvs : public RGYInput {
 public:
     RGYInputAvs();
@@ -98,12 +114,30 @@ protected:
     virtual RGY_ERR Init(const TCHAR *strFileName, VideoInfo *pInputInfo, const void *prm) override;
     RGY_ERR load_avisynth();
     void release_avisynth();
+    void convertFrame(AVS_VideoFrame *frame, RGYFrame *pSurface);
+    RGY_ERR startPrefetch(int frameIdx);
+    void stopPrefetch();
+    void prefetchThreadFunc(int frameStart, int frameFin);
 
     AVS_ScriptEnvironment *m_sAVSenv;
     AVS_Clip *m_sAVSclip;
     const AVS_VideoInfo *m_sAVSinfo;
 
     avs_dll_t m_sAvisynth;
+
+    int m_nPrefetch;                        //先読みするフレーム数
+    std::vector<RGYAvsPrefetchSlot> m_prefetchSlot;
+    std::thread m_thPrefetch;
+    std::mutex m_mtxPrefetch;
+    std::condition_variable m_cvPrefetchReady; //先読みスレッド → LoadNextFrame
+    std::condition_variable m_cvPrefetchFree;  //LoadNextFrame → 先読みスレッド
+    int m_nPrefetchRead;                    //LoadNextFrameで次に受け取るフレーム番号
+    int m_nPrefetchFin;                     //先読みする最後のフレーム番号+1
+    bool m_bPrefetchAbort;
+    int64_t m_nPrefetchHit;                 //先読みが間に合ったフレーム数
+    int64_t m_nPrefetchMiss;                //先読みを待機したフレーム数
+    int64_t m_nPrefetchStallUs;             //先読みを待機した合計時間
+    PerfQueueInfo *m_pQueueInfo;
 };
 
 #endif //ENABLE_AVISYNTH_READER
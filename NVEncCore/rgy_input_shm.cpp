@@ -0,0 +1,158 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+#include "rgy_input_shm.h"
+
+#if ENABLE_SHM_READER
+
+RGYInputShm::RGYInputShm() :
+    m_shm() {
+    m_strReaderName = _T("shm");
+}
+
+RGYInputShm::~RGYInputShm() {
+    Close();
+}
+
+void RGYInputShm::Close() {
+    m_shm.close();
+    RGYInput::Close();
+}
+
+RGY_ERR RGYInputShm::Init(const TCHAR *strFileName, VideoInfo *pInputInfo, const void *prm) {
+    UNREFERENCED_PARAMETER(prm);
+    memcpy(&m_inputVideoInfo, pInputInfo, sizeof(m_inputVideoInfo));
+
+    auto ret = m_shm.open(strFileName);
+    if (ret != RGY_ERR_NONE) {
+        AddMessage(RGY_LOG_ERROR, _T("Failed to open shared memory \"%s\": %s.\n"), strFileName, get_err_mes(ret));
+        return ret;
+    }
+    AddMessage(RGY_LOG_DEBUG, _T("Opened shared memory: \"%s\".\n"), strFileName);
+
+    const auto shmInfo = m_shm.info();
+    m_InputCsp = (RGY_CSP)shmInfo->csp;
+    m_inputVideoInfo.srcWidth = shmInfo->width;
+    m_inputVideoInfo.srcHeight = shmInfo->height;
+    m_inputVideoInfo.srcPitch = shmInfo->pitch;
+    m_inputVideoInfo.frames = shmInfo->frames;
+    if (m_inputVideoInfo.fpsN == 0 || m_inputVideoInfo.fpsD == 0) {
+        m_inputVideoInfo.fpsN = shmInfo->fpsN;
+        m_inputVideoInfo.fpsD = shmInfo->fpsD;
+    }
+    if (m_inputVideoInfo.sar[0] == 0 || m_inputVideoInfo.sar[1] == 0) {
+        m_inputVideoInfo.sar[0] = shmInfo->sar[0];
+        m_inputVideoInfo.sar[1] = shmInfo->sar[1];
+    }
+    if (shmInfo->picstruct != RGY_PICSTRUCT_UNKNOWN) {
+        m_inputVideoInfo.picstruct = (RGY_PICSTRUCT)shmInfo->picstruct;
+    }
+    if (m_inputVideoInfo.fpsN > 0 && m_inputVideoInfo.fpsD > 0) {
+        rgy_reduce(m_inputVideoInfo.fpsN, m_inputVideoInfo.fpsD);
+    }
+    AddMessage(RGY_LOG_DEBUG, _T("%dx%d, pitch:%d, frameSize:%d, %s.\n"), m_inputVideoInfo.srcWidth, m_inputVideoInfo.srcHeight,
+        m_inputVideoInfo.srcPitch, shmInfo->frameSize, RGY_CSP_NAMES[m_InputCsp]);
+
+    //作成側でエンコーダの入力形式に変換済みなので、通常はコピーのみとなる
+    m_sConvert = get_convert_csp_func(m_InputCsp, m_inputVideoInfo.csp, false);
+    m_inputVideoInfo.shift = 0;
+    if (nullptr == m_sConvert) {
+        AddMessage(RGY_LOG_ERROR, _T("color conversion not supported: %s -> %s.\n"),
+            RGY_CSP_NAMES[m_InputCsp], RGY_CSP_NAMES[m_inputVideoInfo.csp]);
+        return RGY_ERR_INVALID_COLOR_FORMAT;
+    }
+
+    CreateInputInfo(m_strReaderName.c_str(), RGY_CSP_NAMES[m_sConvert->csp_from], RGY_CSP_NAMES[m_sConvert->csp_to], get_simd_str(m_sConvert->simd), &m_inputVideoInfo);
+    AddMessage(RGY_LOG_DEBUG, m_strInputInfo);
+    *pInputInfo = m_inputVideoInfo;
+    return RGY_ERR_NONE;
+}
+
+RGY_ERR RGYInputShm::LoadNextFrame(RGYFrame *pSurface) {
+    //m_pEncSatusInfo->m_nInputFramesがtrimの結果必要なフレーム数を大きく超えたら、エンコードを打ち切る
+    //ちょうどのところで打ち切ると他のストリームに影響があるかもしれないので、余分に取得しておく
+    if (getVideoTrimMaxFramIdx() < (int)m_pEncSatusInfo->m_sData.frameIn - TRIM_OVERREAD_FRAMES) {
+        //作成側が待機し続けないよう、中断を通知する
+        m_shm.setAbort();
+        return RGY_ERR_MORE_DATA;
+    }
+
+    //スロットの内容は、ここでpSurface(入力バッファ)に1回コピーする (スロットをそのままエンコーダに渡すzero-copyではない)
+    //パイプ経由と比べ、パイプへの書き込み・読み込みの2回のコピーがなくなる
+    //コピー後すぐにスロットを返却するので、作成側はその間に次のフレームを書き込める
+    const RGYFrameShmSlot *slot = nullptr;
+    const uint8_t *data = nullptr;
+    auto ret = m_shm.acquireRead(&slot, &data, INFINITE);
+    if (ret == RGY_ERR_MORE_DATA) {
+        AddMessage(RGY_LOG_DEBUG, _T("finish.\n"));
+        return RGY_ERR_MORE_DATA;
+    } else if (ret != RGY_ERR_NONE) {
+        AddMessage(RGY_LOG_ERROR, _T("Failed to get frame from shared memory: %s.\n"), get_err_mes(ret));
+        return ret;
+    }
+
+    const auto shmInfo = m_shm.info();
+    void *dst_array[3];
+    pSurface->ptrArray(dst_array, m_sConvert->csp_to == RGY_CSP_RGB24 || m_sConvert->csp_to == RGY_CSP_RGB32);
+
+    const void *src_array[3];
+    for (int i = 0; i < 3; i++) {
+        src_array[i] = data + shmInfo->planeOffset[i];
+    }
+
+    int src_uv_pitch = m_inputVideoInfo.srcPitch;
+    switch (m_sConvert->csp_from) {
+    case RGY_CSP_NV12:
+    case RGY_CSP_P010:
+        break;
+    default:
+        if (RGY_CSP_CHROMA_FORMAT[m_sConvert->csp_from] == RGY_CHROMAFMT_YUV420
+            || RGY_CSP_CHROMA_FORMAT[m_sConvert->csp_from] == RGY_CHROMAFMT_YUV422) {
+            src_uv_pitch >>= 1;
+        }
+        break;
+    }
+    const auto picstruct = (slot->picstruct != RGY_PICSTRUCT_UNKNOWN) ? (RGY_PICSTRUCT)slot->picstruct : m_inputVideoInfo.picstruct;
+    m_sConvert->func[(picstruct & RGY_PICSTRUCT_INTERLACED) ? 1 : 0](
+        dst_array, src_array, m_inputVideoInfo.srcWidth, m_inputVideoInfo.srcPitch,
+        src_uv_pitch, pSurface->pitch(), m_inputVideoInfo.srcHeight, m_inputVideoInfo.srcHeight, m_inputVideoInfo.crop.c);
+
+    //スロットのヘッダのフレーム情報を反映する
+    auto frameInfo = pSurface->getInfo();
+    frameInfo.timestamp = slot->pts;
+    frameInfo.duration = slot->duration;
+    frameInfo.picstruct = picstruct;
+    pSurface->set(frameInfo);
+
+    //変換が終わったら、すぐにスロットを作成側に返却する
+    m_shm.releaseRead();
+
+    m_pEncSatusInfo->m_sData.frameIn++;
+    return m_pEncSatusInfo->UpdateDisplay();
+}
+
+#endif //#if ENABLE_SHM_READER
@@ -31,6 +31,12 @@
 #include <sstream>
 #include <map>
 #include <fstream>
+#include <chrono>
+#include <cmath>
+
+static int64_t vpy_time_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
 RGYInputVpy::RGYInputVpy() :
     m_pAsyncBuffer(),
@@ -42,8 +48,24 @@ RGYInputVpy::RGYInputVpy() :
     m_sVSscript(nullptr),
     m_sVSnode(nullptr),
     m_nAsyncFrames(0),
+    m_nAsyncSlots(1),
+    m_nAsyncDepth(1),
+    m_nAsyncDepthMin(1),
+    m_nAsyncDepthMax(1),
+    m_nAsyncDepthPeak(0),
+    m_fAsyncLatencyAvg(0.0),
+    m_fLoadIntervalAvg(0.0),
+    m_nLastLoadTime(0),
+    m_nAsyncWaitCount(0),
+    m_nCopyTimeSum(0),
     m_sVS() {
-    memset(m_pAsyncBuffer, 0, sizeof(m_pAsyncBuffer));
+    for (auto& slot : m_pAsyncBuffer) {
+        slot.buffer = nullptr;
+        slot.frame = RGYFrameInit();
+        slot.requestTime = 0;
+        slot.latency = 0;
+        slot.valid = false;
+    }
     memset(m_hAsyncEventFrameSetFin,   0, sizeof(m_hAsyncEventFrameSetFin));
     memset(m_hAsyncEventFrameSetStart, 0, sizeof(m_hAsyncEventFrameSetStart));
     memset(&m_sVS, 0, sizeof(m_sVS));
@@ -111,9 +133,10 @@ int RGYInputVpy::initAsyncEvents() {
 }
 void RGYInputVpy::closeAsyncEvents() {
     m_bAbortAsync = true;
+    //要求済みのフレームのコールバックがすべて終了するのを待つ
     for (int i_frame = m_nCopyOfInputFrames; i_frame < m_nAsyncFrames; i_frame++) {
-        const VSFrameRef *src_frame = getFrameFromAsyncBuffer(i_frame);
-        m_sVSapi->freeFrame(src_frame);
+        getFrameFromAsyncBuffer(i_frame);
+        releaseAsyncBuffer(i_frame);
     }
     for (int i = 0; i < _countof(m_hAsyncEventFrameSetFin); i++) {
         if (m_hAsyncEventFrameSetFin[i])
@@ -121,6 +144,15 @@ void RGYInputVpy::closeAsyncEvents() {
         if (m_hAsyncEventFrameSetStart[i])
             CloseEvent(m_hAsyncEventFrameSetStart[i]);
     }
+    for (auto& slot : m_pAsyncBuffer) {
+        if (slot.buffer) {
+            _aligned_free(slot.buffer);
+            slot.buffer = nullptr;
+        }
+        slot.frame = RGYFrameInit();
+        slot.valid = false;
+        slot.error.clear();
+    }
     memset(m_hAsyncEventFrameSetFin,   0, sizeof(m_hAsyncEventFrameSetFin));
     memset(m_hAsyncEventFrameSetStart, 0, sizeof(m_hAsyncEventFrameSetStart));
     m_bAbortAsync = false;
@@ -129,19 +161,78 @@ void RGYInputVpy::closeAsyncEvents() {
 #pragma warning(push)
 #pragma warning(disable:4100)
 void __stdcall frameDoneCallback(void *userData, const VSFrameRef *f, int n, VSNodeRef *, const char *errorMsg) {
-    reinterpret_cast<RGYInputVpy*>(userData)->setFrameToAsyncBuffer(n, f);
+    reinterpret_cast<RGYInputVpy*>(userData)->setFrameToAsyncBuffer(n, f, errorMsg);
 }
 #pragma warning(pop)
 
-void RGYInputVpy::setFrameToAsyncBuffer(int n, const VSFrameRef* f) {
-    WaitForSingleObject(m_hAsyncEventFrameSetStart[n & (ASYNC_BUFFER_SIZE-1)], INFINITE);
-    m_pAsyncBuffer[n & (ASYNC_BUFFER_SIZE-1)] = f;
-    SetEvent(m_hAsyncEventFrameSetFin[n & (ASYNC_BUFFER_SIZE-1)]);
+//VapourSynthのスレッドから呼ばれる
+//色空間変換もここで行い、LoadNextFrameでは変換済みのフレームのコピーのみを行う
+void RGYInputVpy::setFrameToAsyncBuffer(int n, const VSFrameRef* f, const char *errorMsg) {
+    const int idx = asyncSlotIdx(n);
+    WaitForSingleObject(m_hAsyncEventFrameSetStart[idx], INFINITE);
+    auto& slot = m_pAsyncBuffer[idx];
+    slot.valid = false;
+    slot.error.clear();
+    if (f == nullptr) {
+        slot.error = (errorMsg) ? errorMsg : "";
+    } else {
+        if (!m_bAbortAsync) {
+            void *dst_array[3];
+            slot.frame.ptrArray(dst_array, m_sConvert->csp_to == RGY_CSP_RGB24 || m_sConvert->csp_to == RGY_CSP_RGB32);
+            const void *src_array[3] = { m_sVSapi->getReadPtr(f, 0), m_sVSapi->getReadPtr(f, 1), m_sVSapi->getReadPtr(f, 2) };
+            m_sConvert->func[(m_inputVideoInfo.picstruct & RGY_PICSTRUCT_INTERLACED) ? 1 : 0](
+                dst_array, src_array,
+                m_inputVideoInfo.srcWidth, m_sVSapi->getStride(f, 0), m_sVSapi->getStride(f, 1),
+                slot.frame.pitch(), m_inputVideoInfo.srcHeight, m_inputVideoInfo.srcHeight, m_inputVideoInfo.crop.c);
+            slot.valid = true;
+        }
+        m_sVSapi->freeFrame(f);
+    }
+    slot.latency = vpy_time_us() - slot.requestTime;
+    SetEvent(m_hAsyncEventFrameSetFin[idx]);
+}
 
-    if (m_nAsyncFrames < m_inputVideoInfo.frames && !m_bAbortAsync) {
+//同時要求数に達するまでgetFrameAsyncでフレームを要求する
+RGY_ERR RGYInputVpy::requestAsyncFrames() {
+    while (m_nAsyncFrames < m_inputVideoInfo.frames
+        && m_nAsyncFrames - (int)m_nCopyOfInputFrames < m_nAsyncDepth
+        && !m_bAbortAsync) {
+        auto& slot = m_pAsyncBuffer[asyncSlotIdx(m_nAsyncFrames)];
+        if (slot.buffer == nullptr
+            && nullptr == (slot.buffer = allocConvertedFrame(&slot.frame))) {
+            AddMessage(RGY_LOG_ERROR, _T("Failed to allocate memory for async frame buffer.\n"));
+            return RGY_ERR_NULL_PTR;
+        }
+        slot.requestTime = vpy_time_us();
         m_sVSapi->getFrameAsync(m_nAsyncFrames, m_sVSnode, frameDoneCallback, this);
         m_nAsyncFrames++;
     }
+    m_nAsyncDepthPeak = (std::max)(m_nAsyncDepthPeak, m_nAsyncFrames - (int)m_nCopyOfInputFrames);
+    return RGY_ERR_NONE;
+}
+
+//スクリプトの処理時間とエンコーダの消費間隔から、同時要求数を調整する
+//消費間隔の間にスクリプトが返せるフレームが足りなければ要求数を増やし、余っていれば減らす
+void RGYInputVpy::updateAsyncDepth(int64_t latency) {
+    const int64_t now = vpy_time_us();
+    const double alpha = 1.0 / 8.0;
+    if (m_nLastLoadTime > 0) {
+        const double interval = (double)(now - m_nLastLoadTime);
+        m_fLoadIntervalAvg = (m_fLoadIntervalAvg > 0.0) ? m_fLoadIntervalAvg + (interval - m_fLoadIntervalAvg) * alpha : interval;
+    }
+    m_nLastLoadTime = now;
+    m_fAsyncLatencyAvg = (m_fAsyncLatencyAvg > 0.0) ? m_fAsyncLatencyAvg + ((double)latency - m_fAsyncLatencyAvg) * alpha : (double)latency;
+
+    if (m_nAsyncDepthMin >= m_nAsyncDepthMax || m_fLoadIntervalAvg <= 0.0) {
+        return;
+    }
+    const int target = (int)std::ceil(m_fAsyncLatencyAvg / m_fLoadIntervalAvg) + 1;
+    if (target > m_nAsyncDepth) {
+        m_nAsyncDepth++;
+    } else if (target < m_nAsyncDepth - 1) {
+        m_nAsyncDepth--;
+    }
+    m_nAsyncDepth = clamp(m_nAsyncDepth, m_nAsyncDepthMin, m_nAsyncDepthMax);
 }
 
 int RGYInputVpy::getRevInfo(const char *vsVersionString) {
@@ -273,15 +364,21 @@ RGY_ERR RGYInputVpy::Init(const TCHAR *strFileName, VideoInfo *pInputInfo, const
     m_inputVideoInfo.shift = ((m_inputVideoInfo.csp == RGY_CSP_P010 || m_inputVideoInfo.csp == RGY_CSP_P210) && m_inputVideoInfo.shift) ? m_inputVideoInfo.shift : 0;
     m_inputVideoInfo.frames = vsvideoinfo->numFrames;
 
-    m_nAsyncFrames = vsvideoinfo->numFrames;
-    m_nAsyncFrames = (std::min)(m_nAsyncFrames, vscoreinfo->numThreads);
-    m_nAsyncFrames = (std::min)(m_nAsyncFrames, ASYNC_BUFFER_SIZE-1);
+    //同時要求数は、VapourSynthのスレッド数から開始し、
+    //スクリプトの処理時間とエンコーダの消費速度に応じてスレッド数の2倍まで増減させる
+    m_nAsyncDepthMax = (std::min)(vsvideoinfo->numFrames, ASYNC_BUFFER_SIZE-1);
+    m_nAsyncDepthMax = (std::min)(m_nAsyncDepthMax, (std::max)(vscoreinfo->numThreads * 2, 2));
+    m_nAsyncDepthMin = (std::min)(m_nAsyncDepthMax, 2);
+    m_nAsyncDepth = clamp(vscoreinfo->numThreads, m_nAsyncDepthMin, m_nAsyncDepthMax);
     if (m_inputVideoInfo.type != RGY_INPUT_FMT_VPY_MT) {
-        m_nAsyncFrames = 1;
+        m_nAsyncDepthMax = m_nAsyncDepthMin = m_nAsyncDepth = 1;
     }
+    m_nAsyncSlots = m_nAsyncDepthMax + 1;
+    AddMessage(RGY_LOG_DEBUG, _T("async depth: %d (min %d, max %d).\n"), m_nAsyncDepth, m_nAsyncDepthMin, m_nAsyncDepthMax);
 
-    for (int i = 0; i < m_nAsyncFrames; i++) {
-        m_sVSapi->getFrameAsync(i, m_sVSnode, frameDoneCallback, this);
+    auto err = requestAsyncFrames();
+    if (err != RGY_ERR_NONE) {
+        return err;
     }
 
     tstring vs_ver = _T("VapourSynth");
@@ -301,6 +398,11 @@ RGY_ERR RGYInputVpy::Init(const TCHAR *strFileName, VideoInfo *pInputInfo, const
 
 void RGYInputVpy::Close() {
     AddMessage(RGY_LOG_DEBUG, _T("Closing...\n"));
+    if (m_nCopyOfInputFrames > 0) {
+        AddMessage(RGY_LOG_DEBUG, _T("async depth: last %d, peak %d, script latency %.1f ms, load interval %.1f ms, waited %d/%d frames.\n"),
+            m_nAsyncDepth, m_nAsyncDepthPeak, m_fAsyncLatencyAvg * 1e-3, m_fLoadIntervalAvg * 1e-3, m_nAsyncWaitCount, (int)m_nCopyOfInputFrames);
+        AddMessage(RGY_LOG_DEBUG, _T("copy of converted frames: %.3f ms/frame.\n"), m_nCopyTimeSum * 1e-3 / (int)m_nCopyOfInputFrames);
+    }
     closeAsyncEvents();
     if (m_sVSapi && m_sVSnode)
         m_sVSapi->freeNode(m_sVSnode);
@@ -318,6 +420,16 @@ void RGYInputVpy::Close() {
     m_sVSscript = nullptr;
     m_sVSnode = nullptr;
     m_nAsyncFrames = 0;
+    m_nAsyncSlots = 1;
+    m_nAsyncDepth = 1;
+    m_nAsyncDepthMin = 1;
+    m_nAsyncDepthMax = 1;
+    m_nAsyncDepthPeak = 0;
+    m_fAsyncLatencyAvg = 0.0;
+    m_fLoadIntervalAvg = 0.0;
+    m_nLastLoadTime = 0;
+    m_nAsyncWaitCount = 0;
+    m_nCopyTimeSum = 0;
     m_pEncSatusInfo.reset();
     AddMessage(RGY_LOG_DEBUG, _T("Closed.\n"));
 }
@@ -330,24 +442,37 @@ RGY_ERR RGYInputVpy::LoadNextFrame(RGYFrame *pSurface) {
         return RGY_ERR_MORE_DATA;
     }
 
-    const VSFrameRef *src_frame = getFrameFromAsyncBuffer(m_pEncSatusInfo->m_sData.frameIn);
-    if (src_frame == nullptr) {
+    const int n = m_pEncSatusInfo->m_sData.frameIn;
+    auto slot = getFrameFromAsyncBuffer(n);
+    if (!slot->valid) {
+        if (slot->error.length() > 0) {
+            AddMessage(RGY_LOG_ERROR, _T("Failed to get frame %d: %s\n"), n, char_to_tstring(slot->error).c_str());
+        }
+        releaseAsyncBuffer(n);
+        //受け取り済みとして扱い、Close時に再度待機しないようにする
+        m_nCopyOfInputFrames = n + 1;
         return RGY_ERR_MORE_DATA;
     }
 
-    void *dst_array[3];
-    pSurface->ptrArray(dst_array, m_sConvert->csp_to == RGY_CSP_RGB24 || m_sConvert->csp_to == RGY_CSP_RGB32);
-    const void *src_array[3] = { m_sVSapi->getReadPtr(src_frame, 0), m_sVSapi->getReadPtr(src_frame, 1), m_sVSapi->getReadPtr(src_frame, 2) };
-    m_sConvert->func[(m_inputVideoInfo.picstruct & RGY_PICSTRUCT_INTERLACED) ? 1 : 0](
-        dst_array, src_array,
-        m_inputVideoInfo.srcWidth, m_sVSapi->getStride(src_frame, 0), m_sVSapi->getStride(src_frame, 1),
-        pSurface->pitch(), m_inputVideoInfo.srcHeight, m_inputVideoInfo.srcHeight, m_inputVideoInfo.crop.c);
-
-    m_sVSapi->freeFrame(src_frame);
+    //変換はVapourSynthのスレッドで行い、変換先はpSurfaceではなくスロットのバッファなので、ここで1回コピーが必要になる
+    //  pSurfaceはエンコーダのpinnedメモリで、フレームの要求時(getFrameAsync)にはまだ決まっていない
+    //  コピーは変換とほぼ同じ時間がかかるが(どちらもメモリ帯域律速)、変換自体はこのスレッドの外で並列に行われる
+    //  コピーの時間はClose時にログに出力する
+    const int64_t copyStart = vpy_time_us();
+    copyConvertedFrame(pSurface, &slot->frame);
+    m_nCopyTimeSum += vpy_time_us() - copyStart;
+    const int64_t latency = slot->latency;
+    releaseAsyncBuffer(n);
 
     m_pEncSatusInfo->m_sData.frameIn++;
     m_nCopyOfInputFrames = m_pEncSatusInfo->m_sData.frameIn;
 
+    updateAsyncDepth(latency);
+    auto err = requestAsyncFrames();
+    if (err != RGY_ERR_NONE) {
+        return err;
+    }
+
     return m_pEncSatusInfo->UpdateDisplay();
 }
 
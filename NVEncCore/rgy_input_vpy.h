@@ -57,6 +57,17 @@ typedef void (__stdcall *func_vs_clearOutput)(VSScript *handle, int index);
 typedef VSCore * (__stdcall *func_vs_getCore)(VSScript *handle);
 typedef const VSAPI * (__stdcall *func_vs_getVSApi)(void);
 
+//getFrameAsyncで要求したフレームの受け取り先
+//フレームはframeDoneCallback内で変換し、変換済みのフレームのみをLoadNextFrameに渡す
+struct RGYVpyAsyncSlot {
+    uint8_t *buffer;      //変換先として事前に確保したホストメモリ
+    RGYFrame frame;       //変換先のフレーム情報
+    int64_t requestTime;  //getFrameAsyncを呼んだ時刻 (us)
+    int64_t latency;      //要求から変換完了までの時間 (us)
+    bool valid;           //フレームの取得・変換に成功したか
+    std::string error;    //フレームの取得に失敗した場合のエラーメッセージ
+};
+
 typedef struct {
     HMODULE                hVSScriptDLL;
     func_vs_init           init;
@@ -79,7 +90,7 @@ public:
     virtual RGY_ERR LoadNextFrame(RGYFrame *pSurface) override;
     virtual void Close() override;
 
-    void setFrameToAsyncBuffer(int n, const VSFrameRef* f);
+    void setFrameToAsyncBuffer(int n, const VSFrameRef* f, const char *errorMsg);
 protected:
     virtual RGY_ERR Init(const TCHAR *strFileName, VideoInfo *pInputInfo, const void *prm) override;
 
@@ -87,13 +98,22 @@ protected:
     int load_vapoursynth();
     int initAsyncEvents();
     void closeAsyncEvents();
-    const VSFrameRef* getFrameFromAsyncBuffer(int n) {
-        WaitForSingleObject(m_hAsyncEventFrameSetFin[n & (ASYNC_BUFFER_SIZE-1)], INFINITE);
-        const VSFrameRef *frame = m_pAsyncBuffer[n & (ASYNC_BUFFER_SIZE-1)];
-        SetEvent(m_hAsyncEventFrameSetStart[n & (ASYNC_BUFFER_SIZE-1)]);
-        return frame;
+    RGY_ERR requestAsyncFrames();
+    void updateAsyncDepth(int64_t latency);
+    int asyncSlotIdx(int n) const {
+        return n % m_nAsyncSlots;
+    }
+    RGYVpyAsyncSlot *getFrameFromAsyncBuffer(int n) {
+        if (WaitForSingleObject(m_hAsyncEventFrameSetFin[asyncSlotIdx(n)], 0) == WAIT_TIMEOUT) {
+            m_nAsyncWaitCount++;
+            WaitForSingleObject(m_hAsyncEventFrameSetFin[asyncSlotIdx(n)], INFINITE);
+        }
+        return &m_pAsyncBuffer[asyncSlotIdx(n)];
+    }
+    void releaseAsyncBuffer(int n) {
+        SetEvent(m_hAsyncEventFrameSetStart[asyncSlotIdx(n)]);
     }
-    const VSFrameRef* m_pAsyncBuffer[ASYNC_BUFFER_SIZE];
+    RGYVpyAsyncSlot m_pAsyncBuffer[ASYNC_BUFFER_SIZE];
     HANDLE m_hAsyncEventFrameSetFin[ASYNC_BUFFER_SIZE];
     HANDLE m_hAsyncEventFrameSetStart[ASYNC_BUFFER_SIZE];
 
@@ -105,7 +125,17 @@ protected:
     const VSAPI *m_sVSapi;
     VSScript *m_sVSscript;
     VSNodeRef *m_sVSnode;
-    int m_nAsyncFrames;
+    int m_nAsyncFrames;      //getFrameAsyncで要求済みのフレーム数
+    int m_nAsyncSlots;       //使用する受け取り先の数 (最大同時要求数+1)
+    int m_nAsyncDepth;       //現在の同時要求数
+    int m_nAsyncDepthMin;
+    int m_nAsyncDepthMax;
+    int m_nAsyncDepthPeak;
+    double m_fAsyncLatencyAvg;  //要求から変換完了までの時間の平均 (us)
+    double m_fLoadIntervalAvg;  //LoadNextFrameの呼び出し間隔の平均 (us)
+    int64_t m_nLastLoadTime;
+    int m_nAsyncWaitCount;      //LoadNextFrameでフレームの到着を待った回数
+    int64_t m_nCopyTimeSum;     //変換済みのフレームを入力バッファへコピーした時間の合計 (us)
 
     vsscript_t m_sVS;
 };
@@ -0,0 +1,1017 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include <chrono>
+#include <algorithm>
+#include "rgy_io_bench.h"
+#include "rgy_osdep.h"
+#include "rgy_status.h"
+#include "rgy_input_raw.h"
+#include "rgy_input_avi.h"
+#include "rgy_input_avcodec.h"
+#include "rgy_output.h"
+#include "rgy_output_avcodec.h"
+#include "cpu_info.h"
+#include "NVEncParam.h"
+#if !(defined(_WIN32) || defined(_WIN64))
+#include <time.h>
+#include <sys/resource.h>
+#endif
+
+RGYIOBenchPrm::RGYIOBenchPrm() :
+    width(1920),
+    height(1080),
+    bitdepth(8),
+    frames(120),
+    gop(30),
+    fpsN(30000),
+    fpsD(1001),
+    dir(),
+    output(),
+    readers({ _T("raw"), _T("y4m"), _T("avi"), _T("avcodec") }),
+    writers({ _T("null"), _T("raw"), _T("mp4"), _T("mkv"), _T("ts") }),
+    keep(false),
+    frameposFrames(0) {
+}
+
+int RGYIOBenchPrm::parse(const TCHAR *str, tstring& err) {
+    const auto param_list = split(tstring((str) ? str : _T("")), _T(","));
+    for (const auto& param : param_list) {
+        if (param.length() == 0) {
+            continue;
+        }
+        auto pos = param.find_first_of(_T("="));
+        if (pos == std::string::npos) {
+            err = _T("Unknown parameter: ") + param;
+            return 1;
+        }
+        auto param_arg = param.substr(0, pos);
+        auto param_val = param.substr(pos+1);
+        std::transform(param_arg.begin(), param_arg.end(), param_arg.begin(), tolower);
+        try {
+            if (param_arg == _T("w") || param_arg == _T("width")) {
+                width = std::stoi(param_val);
+            } else if (param_arg == _T("h") || param_arg == _T("height")) {
+                height = std::stoi(param_val);
+            } else if (param_arg == _T("depth")) {
+                bitdepth = std::stoi(param_val);
+            } else if (param_arg == _T("frames")) {
+                frames = std::stoi(param_val);
+            } else if (param_arg == _T("gop")) {
+                gop = std::stoi(param_val);
+            } else if (param_arg == _T("fps")) {
+                int a = 0, b = 0;
+                if (2 == _stscanf_s(param_val.c_str(), _T("%d/%d"), &a, &b)
+                    || 2 == _stscanf_s(param_val.c_str(), _T("%d:%d"), &a, &b)) {
+                    fpsN = a;
+                    fpsD = b;
+                } else {
+                    fpsN = std::stoi(param_val);
+                    fpsD = 1;
+                }
+            } else if (param_arg == _T("dir")) {
+                dir = param_val;
+            } else if (param_arg == _T("output")) {
+                output = param_val;
+            } else if (param_arg == _T("reader")) {
+                readers = (param_val == _T("none")) ? std::vector<tstring>() : split(param_val, _T(":"));
+            } else if (param_arg == _T("writer")) {
+                writers = (param_val == _T("none")) ? std::vector<tstring>() : split(param_val, _T(":"));
+            } else if (param_arg == _T("framepos")) {
+                frameposFrames = std::stoi(param_val);
+            } else if (param_arg == _T("keep")) {
+                keep = param_val == _T("true") || param_val == _T("1");
+            } else {
+                err = _T("Unknown parameter: ") + param_arg;
+                return 1;
+            }
+        } catch (...) {
+            err = _T("Invalid value: ") + param;
+            return 1;
+        }
+    }
+    if (width <= 0 || height <= 0 || (width & 1) || (height & 1)) {
+        err = _T("Invalid resolution.");
+        return 1;
+    }
+    if (bitdepth != 8 && bitdepth != 9 && bitdepth != 10 && bitdepth != 12 && bitdepth != 14) {
+        err = _T("depth should be 8, 9, 10, 12 or 14.");
+        return 1;
+    }
+    if (frames <= 0 || gop <= 0 || fpsN <= 0 || fpsD <= 0 || frameposFrames < 0) {
+        err = _T("frames, gop and fps should be positive.");
+        return 1;
+    }
+    for (const auto& reader : readers) {
+        if (reader != _T("raw") && reader != _T("y4m") && reader != _T("avi") && reader != _T("avcodec")) {
+            err = _T("Unknown reader: ") + reader;
+            return 1;
+        }
+    }
+    for (const auto& writer : writers) {
+        if (writer != _T("null") && writer != _T("raw") && writer != _T("mp4") && writer != _T("mkv") && writer != _T("ts")) {
+            err = _T("Unknown writer: ") + writer;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+RGYIOBenchResult::RGYIOBenchResult() :
+    kind(),
+    target(),
+    frames(0),
+    bytes(0),
+    sec(0.0),
+    cpuTotalUs(0),
+    cpuMainUs(0),
+    cpuWorkerUs(-1),
+    bufAlloc(-1),
+    bufCopy(-1),
+    bufMove(-1),
+    memBytes(-1) {
+}
+
+double RGYIOBenchResult::fps() const {
+    return (sec > 0.0) ? frames / sec : 0.0;
+}
+
+double RGYIOBenchResult::mbps() const {
+    return (sec > 0.0) ? bytes / (1024.0 * 1024.0) / sec : 0.0;
+}
+
+//--- CPU時間の取得 ---------------------------------------------------------------------
+static int64_t io_bench_process_cpu_us() {
+#if defined(_WIN32) || defined(_WIN64)
+    PROCESS_TIME pt = { 0 };
+    GetProcessTime(&pt);
+    return (int64_t)(pt.kernel + pt.user) / 10;
+#else
+    struct rusage usage = { 0 };
+    getrusage(RUSAGE_SELF, &usage);
+    return (int64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+}
+
+//hThread = NULLなら呼び出し側のスレッド
+static int64_t io_bench_thread_cpu_us(HANDLE hThread) {
+#if defined(_WIN32) || defined(_WIN64)
+    PROCESS_TIME pt = { 0 };
+    if (!GetThreadTimes((hThread) ? hThread : GetCurrentThread(), (FILETIME *)&pt.creation, (FILETIME *)&pt.exit, (FILETIME *)&pt.kernel, (FILETIME *)&pt.user)) {
+        return -1;
+    }
+    return (int64_t)(pt.kernel + pt.user) / 10;
+#else
+    if (hThread) {
+        return -1;
+    }
+    struct timespec ts = { 0 };
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+//リーダー/ライター内部のスレッドは終了時にjoinされるので、終了後もCPU時間を取得できるようハンドルを複製しておく
+class IOBenchThreadTime {
+public:
+    IOBenchThreadTime() : m_handles() {};
+    ~IOBenchThreadTime() {
+#if defined(_WIN32) || defined(_WIN64)
+        for (auto h : m_handles) {
+            CloseHandle(h);
+        }
+#endif
+    }
+    void add(HANDLE hThread) {
+#if defined(_WIN32) || defined(_WIN64)
+        HANDLE hDup = NULL;
+        if (hThread && DuplicateHandle(GetCurrentProcess(), hThread, GetCurrentProcess(), &hDup, 0, FALSE, DUPLICATE_SAME_ACCESS)) {
+            m_handles.push_back(hDup);
+        }
+#else
+        UNREFERENCED_PARAMETER(hThread);
+#endif
+    }
+    int64_t total_us() const {
+        if (m_handles.size() == 0) {
+            return -1;
+        }
+        int64_t total = 0;
+        for (auto h : m_handles) {
+            total += (std::max)(io_bench_thread_cpu_us(h), (int64_t)0);
+        }
+        return total;
+    }
+private:
+    std::vector<HANDLE> m_handles;
+};
+
+//計測区間
+class IOBenchTimer {
+public:
+    void start() {
+        m_cpuTotal = io_bench_process_cpu_us();
+        m_cpuMain = io_bench_thread_cpu_us(NULL);
+        m_start = std::chrono::high_resolution_clock::now();
+    }
+    void stop(RGYIOBenchResult& result) {
+        result.sec = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - m_start).count();
+        result.cpuMainUs = io_bench_thread_cpu_us(NULL) - m_cpuMain;
+        result.cpuTotalUs = io_bench_process_cpu_us() - m_cpuTotal;
+    }
+private:
+    std::chrono::high_resolution_clock::time_point m_start;
+    int64_t m_cpuTotal;
+    int64_t m_cpuMain;
+};
+
+//--- 合成した入力の作成 -----------------------------------------------------------------
+//YV12 (8bit) / YV12_xx (16bit/画素) のフレームを作成する
+//フレームごとに模様を動かし、すべてのフレームの内容が異なるようにする
+static void io_bench_fill_frame(std::vector<uint8_t>& buf, int width, int height, int bitdepth, int iframe) {
+    const int pixsize = (bitdepth > 8) ? 2 : 1;
+    const int mask = (1 << bitdepth) - 1;
+    buf.resize((size_t)width * height * 3 / 2 * pixsize);
+    auto fill_plane = [&](size_t offset, int w, int h, int scale, int shift) {
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                const int value = ((x * scale + y * 2 + iframe * 3 + shift) << (bitdepth - 8)) & mask;
+                const size_t idx = offset + ((size_t)y * w + x) * pixsize;
+                if (pixsize == 1) {
+                    buf[idx] = (uint8_t)value;
+                } else {
+                    *(uint16_t *)&buf[idx] = (uint16_t)value;
+                }
+            }
+        }
+    };
+    const size_t lumaSize = (size_t)width * height * pixsize;
+    fill_plane(0, width, height, 1, 16);
+    fill_plane(lumaSize, width >> 1, height >> 1, 2, 64);
+    fill_plane(lumaSize + lumaSize / 4, width >> 1, height >> 1, 3, 128);
+}
+
+static RGY_ERR io_bench_write_le32(FILE *fp, uint32_t value) {
+    uint8_t buf[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+    return (fwrite(buf, 1, 4, fp) == 4) ? RGY_ERR_NONE : RGY_ERR_UNDEFINED_BEHAVIOR;
+}
+
+static RGY_ERR io_bench_write_le16(FILE *fp, uint16_t value) {
+    uint8_t buf[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+    return (fwrite(buf, 1, 2, fp) == 2) ? RGY_ERR_NONE : RGY_ERR_UNDEFINED_BEHAVIOR;
+}
+
+static RGY_ERR io_bench_write_fourcc(FILE *fp, const char *fourcc) {
+    return (fwrite(fourcc, 1, 4, fp) == 4) ? RGY_ERR_NONE : RGY_ERR_UNDEFINED_BEHAVIOR;
+}
+
+//type: raw, y4m, avi
+static RGY_ERR io_bench_create_source(const tstring& filename, const tstring& type, const RGYIOBenchPrm& prm) {
+    FILE *fp = nullptr;
+    if (0 != _tfopen_s(&fp, filename.c_str(), _T("wb")) || fp == nullptr) {
+        return RGY_ERR_FILE_OPEN;
+    }
+    unique_ptr<FILE, fp_deleter> fpSrc(fp, fp_deleter());
+    const uint32_t frameSize = (uint32_t)((size_t)prm.width * prm.height * 3 / 2 * ((prm.bitdepth > 8) ? 2 : 1));
+    std::vector<uint8_t> frame;
+    if (type == _T("y4m")) {
+        const char *csp = "420mpeg2";
+        char csp_buf[32];
+        if (prm.bitdepth > 8) {
+            sprintf_s(csp_buf, "420p%d", prm.bitdepth);
+            csp = csp_buf;
+        }
+        fprintf(fp, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C%s\n", prm.width, prm.height, prm.fpsN, prm.fpsD, csp);
+    } else if (type == _T("avi")) {
+        //非圧縮のYV12のAVI (AVI 1.0、インデックス付き)
+        const uint32_t chunkSize = 8 + frameSize + (frameSize & 1);
+        const uint32_t moviSize = 4 + chunkSize * prm.frames;
+        const uint32_t hdrlSize = 4 + (8 + 56) + (8 + 4 + (8 + 56) + (8 + 40));
+        const uint32_t idx1Size = 16 * prm.frames;
+        const uint32_t riffSize = 4 + (8 + hdrlSize) + (8 + moviSize) + (8 + idx1Size);
+        RGY_ERR err = RGY_ERR_NONE;
+        auto w32 = [&](uint32_t v) { if (err == RGY_ERR_NONE) err = io_bench_write_le32(fp, v); };
+        auto w16 = [&](uint16_t v) { if (err == RGY_ERR_NONE) err = io_bench_write_le16(fp, v); };
+        auto fcc = [&](const char *v) { if (err == RGY_ERR_NONE) err = io_bench_write_fourcc(fp, v); };
+        fcc("RIFF"); w32(riffSize); fcc("AVI ");
+        fcc("LIST"); w32(hdrlSize); fcc("hdrl");
+        //avih
+        fcc("avih"); w32(56);
+        w32((uint32_t)((int64_t)1000000 * prm.fpsD / prm.fpsN)); //dwMicroSecPerFrame
+        w32((uint32_t)std::min<int64_t>((int64_t)frameSize * prm.fpsN / prm.fpsD, UINT32_MAX)); //dwMaxBytesPerSec
+        w32(0);                   //dwPaddingGranularity
+        w32(0x10);                //dwFlags = AVIF_HASINDEX
+        w32(prm.frames);          //dwTotalFrames
+        w32(0);                   //dwInitialFrames
+        w32(1);                   //dwStreams
+        w32(frameSize);           //dwSuggestedBufferSize
+        w32(prm.width);
+        w32(prm.height);
+        w32(0); w32(0); w32(0); w32(0);
+        fcc("LIST"); w32(4 + (8 + 56) + (8 + 40)); fcc("strl");
+        //strh
+        fcc("strh"); w32(56);
+        fcc("vids"); fcc("YV12");
+        w32(0);                   //dwFlags
+        w16(0); w16(0);           //wPriority, wLanguage
+        w32(0);                   //dwInitialFrames
+        w32(prm.fpsD);            //dwScale
+        w32(prm.fpsN);            //dwRate
+        w32(0);                   //dwStart
+        w32(prm.frames);          //dwLength
+        w32(frameSize);           //dwSuggestedBufferSize
+        w32(UINT32_MAX);          //dwQuality
+        w32(frameSize);           //dwSampleSize
+        w16(0); w16(0); w16((uint16_t)prm.width); w16((uint16_t)prm.height); //rcFrame
+        //strf (BITMAPINFOHEADER)
+        fcc("strf"); w32(40);
+        w32(40); w32(prm.width); w32(prm.height);
+        w16(1); w16(12);          //biPlanes, biBitCount
+        fcc("YV12");
+        w32(frameSize);
+        w32(0); w32(0); w32(0); w32(0);
+        fcc("LIST"); w32(moviSize); fcc("movi");
+        for (int i = 0; i < prm.frames && err == RGY_ERR_NONE; i++) {
+            //AVIのYV12はV, Uの順
+            io_bench_fill_frame(frame, prm.width, prm.height, prm.bitdepth, i);
+            const size_t lumaSize = (size_t)prm.width * prm.height;
+            std::swap_ranges(frame.begin() + lumaSize, frame.begin() + lumaSize + lumaSize / 4, frame.begin() + lumaSize + lumaSize / 4);
+            fcc("00db"); w32(frameSize);
+            if (err == RGY_ERR_NONE && fwrite(frame.data(), 1, frameSize, fp) != frameSize) {
+                err = RGY_ERR_UNDEFINED_BEHAVIOR;
+            }
+            if (frameSize & 1) {
+                fputc(0, fp);
+            }
+        }
+        fcc("idx1"); w32(idx1Size);
+        for (int i = 0; i < prm.frames; i++) {
+            fcc("00db"); w32(0x10); w32(4 + chunkSize * i); w32(frameSize);
+        }
+        return err;
+    }
+    for (int i = 0; i < prm.frames; i++) {
+        if (type == _T("y4m")) {
+            fprintf(fp, "FRAME\n");
+        }
+        io_bench_fill_frame(frame, prm.width, prm.height, prm.bitdepth, i);
+        if (fwrite(frame.data(), 1, frameSize, fp) != frameSize) {
+            return RGY_ERR_UNDEFINED_BEHAVIOR;
+        }
+    }
+    return RGY_ERR_NONE;
+}
+
+//--- 合成したH.264ストリームの作成 -------------------------------------------------------
+class IOBenchBitWriter {
+public:
+    IOBenchBitWriter() : m_buf(), m_cache(0), m_bits(0) {};
+    void put(uint32_t value, int bits) {
+        for (int i = bits - 1; i >= 0; i--) {
+            m_cache = (m_cache << 1) | ((value >> i) & 1);
+            if (++m_bits == 8) {
+                m_buf.push_back(m_cache);
+                m_cache = 0;
+                m_bits = 0;
+            }
+        }
+    }
+    void ue(uint32_t value) {
+        const uint32_t v = value + 1;
+        int len = 0;
+        while ((v >> len) > 1) len++;
+        put(0, len);
+        put(v, len + 1);
+    }
+    void se(int32_t value) {
+        ue((value <= 0) ? (uint32_t)(-value) * 2 : (uint32_t)value * 2 - 1);
+    }
+    bool aligned() const {
+        return m_bits == 0;
+    }
+    void align_zero() {
+        while (m_bits) put(0, 1);
+    }
+    void append_aligned(const uint8_t *ptr, size_t size) {
+        m_buf.insert(m_buf.end(), ptr, ptr + size);
+    }
+    void trailing_bits() {
+        put(1, 1);
+        align_zero();
+    }
+    //開始コードとNALヘッダを付加し、エミュレーション防止バイトを挿入してdstに追加する
+    void flush_nal(std::vector<uint8_t>& dst, uint8_t nal_header) {
+        static const uint8_t start_code[] = { 0x00, 0x00, 0x00, 0x01 };
+        dst.insert(dst.end(), start_code, start_code + sizeof(start_code));
+        dst.push_back(nal_header);
+        int zeros = 0;
+        for (auto byte : m_buf) {
+            if (zeros >= 2 && byte <= 0x03) {
+                dst.push_back(0x03);
+                zeros = 0;
+            }
+            dst.push_back(byte);
+            zeros = (byte == 0x00) ? zeros + 1 : 0;
+        }
+        m_buf.clear();
+        m_cache = 0;
+        m_bits = 0;
+    }
+private:
+    std::vector<uint8_t> m_buf;
+    uint8_t m_cache;
+    int m_bits;
+};
+
+//I_PCMのIDRとP_Skipのみからなるストリーム
+//  エンコーダなしで正しくデコード可能なストリームを作成でき、IDRは非圧縮とほぼ同じサイズとなる
+class IOBenchH264Source {
+public:
+    IOBenchH264Source() : m_prm(), m_mbW(0), m_mbH(0), m_idr(), m_frameBuf() {};
+    void init(const RGYIOBenchPrm& prm) {
+        m_prm = prm;
+        m_mbW = (prm.width + 15) / 16;
+        m_mbH = (prm.height + 15) / 16;
+        //IDRはidr_pic_idが交互に変わるよう2種類用意する
+        for (int i = 0; i < 2; i++) {
+            io_bench_fill_frame(m_frameBuf, prm.width, prm.height, prm.bitdepth, i);
+            m_idr[i].clear();
+            writeHeader(m_idr[i]);
+            writeIDR(m_idr[i], i);
+        }
+    }
+    //iframe番目のフレームのビットストリーム
+    void frame(std::vector<uint8_t>& dst, int iframe, RGY_FRAMETYPE& frametype) {
+        const int pos = iframe % m_prm.gop;
+        if (pos == 0) {
+            dst = m_idr[(iframe / m_prm.gop) & 1];
+            frametype = RGY_FRAMETYPE_IDR;
+        } else {
+            dst.clear();
+            writeP(dst, pos);
+            frametype = RGY_FRAMETYPE_P;
+        }
+    }
+    int profile() const {
+        return (m_prm.bitdepth > 8) ? 110 : 100;
+    }
+    int level() const {
+        return 52;
+    }
+protected:
+    void writeHeader(std::vector<uint8_t>& dst) {
+        IOBenchBitWriter bw;
+        //SPS
+        bw.put(profile(), 8);
+        bw.put(0, 8);                        //constraint_set_flags
+        bw.put(level(), 8);
+        bw.ue(0);                            //seq_parameter_set_id
+        bw.ue(1);                            //chroma_format_idc = 4:2:0
+        bw.ue(m_prm.bitdepth - 8);           //bit_depth_luma_minus8
+        bw.ue(m_prm.bitdepth - 8);           //bit_depth_chroma_minus8
+        bw.put(0, 1);                        //qpprime_y_zero_transform_bypass_flag
+        bw.put(0, 1);                        //seq_scaling_matrix_present_flag
+        bw.ue(4);                            //log2_max_frame_num_minus4
+        bw.ue(2);                            //pic_order_cnt_type
+        bw.ue(1);                            //max_num_ref_frames
+        bw.put(0, 1);                        //gaps_in_frame_num_value_allowed_flag
+        bw.ue(m_mbW - 1);
+        bw.ue(m_mbH - 1);
+        bw.put(1, 1);                        //frame_mbs_only_flag
+        bw.put(1, 1);                        //direct_8x8_inference_flag
+        const int cropR = (m_mbW * 16 - m_prm.width) / 2;
+        const int cropB = (m_mbH * 16 - m_prm.height) / 2;
+        bw.put((cropR || cropB) ? 1 : 0, 1); //frame_cropping_flag
+        if (cropR || cropB) {
+            bw.ue(0); bw.ue(cropR); bw.ue(0); bw.ue(cropB);
+        }
+        bw.put(0, 1);                        //vui_parameters_present_flag
+        bw.trailing_bits();
+        bw.flush_nal(dst, 0x67);
+        //PPS
+        bw.ue(0);                            //pic_parameter_set_id
+        bw.ue(0);                            //seq_parameter_set_id
+        bw.put(0, 1);                        //entropy_coding_mode_flag (CAVLC)
+        bw.put(0, 1);                        //bottom_field_pic_order_in_frame_present_flag
+        bw.ue(0);                            //num_slice_groups_minus1
+        bw.ue(0);                            //num_ref_idx_l0_default_active_minus1
+        bw.ue(0);                            //num_ref_idx_l1_default_active_minus1
+        bw.put(0, 1);                        //weighted_pred_flag
+        bw.put(0, 2);                        //weighted_bipred_idc
+        bw.se(0);                            //pic_init_qp_minus26
+        bw.se(0);                            //pic_init_qs_minus26
+        bw.se(0);                            //chroma_qp_index_offset
+        bw.put(1, 1);                        //deblocking_filter_control_present_flag
+        bw.put(0, 1);                        //constrained_intra_pred_flag
+        bw.put(0, 1);                        //redundant_pic_cnt_present_flag
+        bw.trailing_bits();
+        bw.flush_nal(dst, 0x68);
+    }
+    void writeSliceHeader(IOBenchBitWriter& bw, bool idr, int frame_num, int idr_pic_id) {
+        bw.ue(0);                            //first_mb_in_slice
+        bw.ue((idr) ? 7 : 5);                //slice_type (I / P)
+        bw.ue(0);                            //pic_parameter_set_id
+        bw.put(frame_num & 0xff, 8);         //frame_num
+        if (idr) {
+            bw.ue(idr_pic_id);
+        } else {
+            bw.put(0, 1);                    //num_ref_idx_active_override_flag
+            bw.put(0, 1);                    //ref_pic_list_modification_flag_l0
+        }
+        if (idr) {
+            bw.put(0, 1);                    //no_output_of_prior_pics_flag
+            bw.put(0, 1);                    //long_term_reference_flag
+        } else {
+            bw.put(0, 1);                    //adaptive_ref_pic_marking_mode_flag
+        }
+        bw.se(0);                            //slice_qp_delta
+        bw.ue(1);                            //disable_deblocking_filter_idc
+    }
+    void writeIDR(std::vector<uint8_t>& dst, int idr_pic_id) {
+        const int pixsize = (m_prm.bitdepth > 8) ? 2 : 1;
+        const int width = m_prm.width, height = m_prm.height;
+        const uint8_t *ptrY = m_frameBuf.data();
+        const uint8_t *ptrU = ptrY + (size_t)width * height * pixsize;
+        const uint8_t *ptrV = ptrU + (size_t)width * height / 4 * pixsize;
+        std::vector<uint8_t> samples;
+        IOBenchBitWriter bw;
+        writeSliceHeader(bw, true, 0, idr_pic_id);
+        auto put_block = [&](const uint8_t *ptr, int planeW, int planeH, int x0, int y0, int size) {
+            samples.clear();
+            for (int y = 0; y < size; y++) {
+                const int sy = (std::min)(y0 + y, planeH - 1);
+                for (int x = 0; x < size; x++) {
+                    const int sx = (std::min)(x0 + x, planeW - 1);
+                    if (pixsize == 1) {
+                        samples.push_back(ptr[(size_t)sy * planeW + sx]);
+                    } else {
+                        bw.put(((const uint16_t *)ptr)[(size_t)sy * planeW + sx], m_prm.bitdepth);
+                    }
+                }
+            }
+            if (pixsize == 1) {
+                bw.append_aligned(samples.data(), samples.size());
+            }
+        };
+        for (int mby = 0; mby < m_mbH; mby++) {
+            for (int mbx = 0; mbx < m_mbW; mbx++) {
+                bw.ue(25);                   //mb_type = I_PCM
+                bw.align_zero();             //pcm_alignment_zero_bit
+                put_block(ptrY, width,      height,      mbx * 16, mby * 16, 16);
+                put_block(ptrU, width >> 1, height >> 1, mbx * 8,  mby * 8,  8);
+                put_block(ptrV, width >> 1, height >> 1, mbx * 8,  mby * 8,  8);
+            }
+        }
+        bw.trailing_bits();
+        bw.flush_nal(dst, 0x65);
+    }
+    void writeP(std::vector<uint8_t>& dst, int frame_num) {
+        IOBenchBitWriter bw;
+        writeSliceHeader(bw, false, frame_num, 0);
+        bw.ue(m_mbW * m_mbH);                //mb_skip_run
+        bw.trailing_bits();
+        bw.flush_nal(dst, 0x41);
+    }
+
+    RGYIOBenchPrm m_prm;
+    int m_mbW;
+    int m_mbH;
+    std::vector<uint8_t> m_idr[2];
+    std::vector<uint8_t> m_frameBuf;
+};
+
+//--- 各計測 -----------------------------------------------------------------------------
+static shared_ptr<EncodeStatus> io_bench_status(const RGYIOBenchPrm& prm, shared_ptr<RGYLog> pLog) {
+    auto status = std::make_shared<EncodeStatus>();
+    status->Init(prm.fpsN, prm.fpsD, prm.frames, pLog, nullptr);
+    status->SetDisplay(false);
+    return status;
+}
+
+static int io_bench_writer(RGYIOBenchResult& result, const tstring& type, const tstring& filename,
+    const RGYIOBenchPrm& prm, IOBenchH264Source& source, shared_ptr<RGYLog> pLog) {
+    result.kind = _T("writer");
+    result.target = type;
+
+    VideoInfo outputVideoInfo;
+    memset(&outputVideoInfo, 0, sizeof(outputVideoInfo));
+    outputVideoInfo.codec = RGY_CODEC_H264;
+    outputVideoInfo.codecProfile = source.profile();
+    outputVideoInfo.codecLevel = source.level();
+    outputVideoInfo.dstWidth = prm.width;
+    outputVideoInfo.dstHeight = prm.height;
+    outputVideoInfo.fpsN = prm.fpsN;
+    outputVideoInfo.fpsD = prm.fpsD;
+    outputVideoInfo.picstruct = RGY_PICSTRUCT_FRAME;
+    outputVideoInfo.csp = (prm.bitdepth > 8) ? RGY_CSP_P010 : RGY_CSP_NV12;
+
+    auto status = io_bench_status(prm, pLog);
+    shared_ptr<RGYOutput> pWriter;
+    RGY_ERR err = RGY_ERR_NONE;
+    if (type == _T("null") || type == _T("raw")) {
+        pWriter = std::make_shared<RGYOutputRaw>();
+        RGYOutputRawPrm rawPrm;
+        rawPrm.bBenchmark = type == _T("null");
+        rawPrm.nBufSizeMB = DEFAULT_OUTPUT_BUF;
+        rawPrm.codecId = RGY_CODEC_H264;
+        err = pWriter->Init(filename.c_str(), &outputVideoInfo, &rawPrm, pLog, status);
+    } else {
+#if ENABLE_AVSW_READER
+        pWriter = std::make_shared<RGYOutputAvcodec>();
+        AvcodecWriterPrm writerPrm;
+        writerPrm.pOutputFormat = (type == _T("mkv")) ? _T("matroska") : ((type == _T("ts")) ? _T("mpegts") : _T("mp4"));
+        writerPrm.nBufSizeMB = DEFAULT_OUTPUT_BUF;
+        writerPrm.nOutputThread = RGY_OUTPUT_THREAD_AUTO;
+        writerPrm.nAudioThread = RGY_AUDIO_THREAD_AUTO;
+        writerPrm.rBitstreamTimebase = av_make_q(prm.fpsD, prm.fpsN);
+        err = pWriter->Init(filename.c_str(), &outputVideoInfo, &writerPrm, pLog, status);
+#else
+        pLog->write(RGY_LOG_WARN, _T("io-bench: writer %s is not supported in this build.\n"), type.c_str());
+        return 1;
+#endif //#if ENABLE_AVSW_READER
+    }
+    if (err != RGY_ERR_NONE) {
+        pLog->write(RGY_LOG_ERROR, _T("io-bench: failed to initialize writer %s: %s\n"), type.c_str(), pWriter->GetOutputMessage());
+        return 1;
+    }
+
+    IOBenchThreadTime threadTime;
+#if ENABLE_AVSW_READER
+    auto pAVCodecWriter = std::dynamic_pointer_cast<RGYOutputAvcodec>(pWriter);
+    if (pAVCodecWriter) {
+        threadTime.add(pAVCodecWriter->getThreadHandleOutput());
+    }
+#endif //#if ENABLE_AVSW_READER
+
+    std::vector<uint8_t> data;
+    RGYBitstream bitstream = RGYBitstreamInit();
+    IOBenchTimer timer;
+    timer.start();
+    for (int i = 0; i < prm.frames && err == RGY_ERR_NONE; i++) {
+        RGY_FRAMETYPE frametype = RGY_FRAMETYPE_UNKNOWN;
+        source.frame(data, i, frametype);
+        //エンコーダからの取り出しと同様に、呼び出し側のバッファにコピーしてから渡す
+        if (RGY_ERR_NONE != (err = bitstream.copy(data.data(), (uint32_t)data.size(), i, i))) {
+            break;
+        }
+        bitstream.setFrametype(frametype);
+        bitstream.setDuration(1);
+        result.bytes += data.size();
+        err = pWriter->WriteNextFrame(&bitstream);
+        result.frames++;
+    }
+    pWriter->Close();
+    timer.stop(result);
+    bitstream.clear();
+    result.cpuWorkerUs = threadTime.total_us();
+#if ENABLE_AVSW_READER
+    if (pAVCodecWriter) {
+        pAVCodecWriter->GetVideoBufferStats(&result.bufAlloc, &result.bufCopy, &result.bufMove);
+    }
+#endif //#if ENABLE_AVSW_READER
+    if (err != RGY_ERR_NONE) {
+        pLog->write(RGY_LOG_ERROR, _T("io-bench: writer %s failed: %s\n"), type.c_str(), get_err_mes(err));
+        return 1;
+    }
+    return 0;
+}
+
+static int io_bench_reader(RGYIOBenchResult& result, const tstring& type, const tstring& filename,
+    const RGYIOBenchPrm& prm, shared_ptr<RGYLog> pLog) {
+    result.kind = _T("reader");
+    result.target = type;
+
+    VideoInfo inputInfo;
+    memset(&inputInfo, 0, sizeof(inputInfo));
+    inputInfo.srcWidth = prm.width;
+    inputInfo.srcHeight = prm.height;
+    inputInfo.fpsN = prm.fpsN;
+    inputInfo.fpsD = prm.fpsD;
+    inputInfo.frames = prm.frames;
+    inputInfo.picstruct = RGY_PICSTRUCT_FRAME;
+    inputInfo.csp = (prm.bitdepth > 8) ? RGY_CSP_P010 : RGY_CSP_NV12;
+
+    auto status = io_bench_status(prm, pLog);
+    shared_ptr<RGYInput> pReader;
+    const void *pInputPrm = nullptr;
+    const bool avcodec = type.substr(0, 7) == _T("avcodec");
+#if ENABLE_AVSW_READER
+    AvcodecReaderPrm avcodecPrm = { 0 };
+#endif
+    if (avcodec) {
+#if ENABLE_AVSW_READER
+        avcodecPrm.bReadVideo = true;
+        avcodecPrm.nVideoAvgFramerate = std::make_pair(prm.fpsN, prm.fpsD);
+        avcodecPrm.nAVSyncMode = RGY_AVSYNC_ASSUME_CFR;
+        avcodecPrm.nInputThread = RGY_INPUT_THREAD_AUTO;
+        avcodecPrm.bVideoCopy = true;
+        inputInfo.type = RGY_INPUT_FMT_AVSW;
+        pInputPrm = &avcodecPrm;
+        pReader = std::make_shared<RGYInputAvcodec>();
+#endif //#if ENABLE_AVSW_READER
+    } else if (type == _T("avi")) {
+#if ENABLE_AVI_READER
+        inputInfo.type = RGY_INPUT_FMT_AVI;
+        pReader = std::make_shared<RGYInputAvi>();
+#endif //#if ENABLE_AVI_READER
+    } else {
+#if ENABLE_RAW_READER
+        inputInfo.type = (type == _T("y4m")) ? RGY_INPUT_FMT_Y4M : RGY_INPUT_FMT_RAW;
+        pReader = std::make_shared<RGYInputRaw>();
+#endif //#if ENABLE_RAW_READER
+    }
+    if (!pReader) {
+        pLog->write(RGY_LOG_WARN, _T("io-bench: reader %s is not supported in this build.\n"), type.c_str());
+        return 1;
+    }
+    RGY_ERR err = pReader->Init(filename.c_str(), &inputInfo, pInputPrm, pLog, status);
+    if (err != RGY_ERR_NONE) {
+        pLog->write(RGY_LOG_ERROR, _T("io-bench: failed to initialize reader %s: %s\n"), type.c_str(), pReader->GetInputMessage());
+        return 1;
+    }
+
+    IOBenchThreadTime threadTime;
+#if ENABLE_AVSW_READER
+    auto pAVCodecReader = std::dynamic_pointer_cast<RGYInputAvcodec>(pReader);
+    if (pAVCodecReader) {
+        threadTime.add(pAVCodecReader->getThreadHandleInput());
+    }
+#endif //#if ENABLE_AVSW_READER
+
+    //読み込み先のフレーム (ホストメモリ)
+    const auto frameInfo = pReader->GetInputFrameInfo();
+    const int pitch = ALIGN(prm.width * ((RGY_CSP_BIT_DEPTH[frameInfo.csp] > 8) ? 2 : 1) * ((RGY_CSP_CHROMA_FORMAT[frameInfo.csp] == RGY_CHROMAFMT_RGB) ? 4 : 1), 64);
+    unique_ptr<uint8_t, aligned_malloc_deleter> buffer((uint8_t *)_aligned_malloc((size_t)pitch * prm.height * 3, 64), aligned_malloc_deleter());
+    RGYFrame frame = RGYFrameInit();
+    frame.set(buffer.get(), prm.width, prm.height, pitch, frameInfo.csp);
+
+    RGYBitstream bitstream = RGYBitstreamInit();
+    IOBenchTimer timer;
+    timer.start();
+    for (;;) {
+        err = pReader->LoadNextFrame((avcodec) ? nullptr : &frame);
+        if (err == RGY_ERR_MORE_DATA) {
+            err = RGY_ERR_NONE;
+            break;
+        } else if (err != RGY_ERR_NONE) {
+            break;
+        }
+        if (avcodec) {
+            err = pReader->GetNextBitstream(&bitstream);
+            if (err == RGY_ERR_MORE_BITSTREAM || bitstream.size() == 0) {
+                err = RGY_ERR_NONE;
+                continue;
+            } else if (err != RGY_ERR_NONE) {
+                break;
+            }
+            result.bytes += bitstream.size();
+            bitstream.setSize(0);
+            bitstream.setOffset(0);
+        }
+        result.frames++;
+    }
+    pReader->Close();
+    timer.stop(result);
+    bitstream.clear();
+    result.cpuWorkerUs = threadTime.total_us();
+    if (!avcodec) {
+        uint64_t filesize = 0;
+        if (rgy_get_filesize(filename.c_str(), &filesize)) {
+            result.bytes = (int64_t)filesize;
+        }
+    }
+    if (err != RGY_ERR_NONE) {
+        pLog->write(RGY_LOG_ERROR, _T("io-bench: reader %s failed: %s\n"), type.c_str(), get_err_mes(err));
+        return 1;
+    }
+    return 0;
+}
+
+#if ENABLE_AVSW_READER
+//FramePosListの追加/検索の速度と保持するデータ量
+//  入力スレッドと同様にフレーム情報を追加しつつ、エンコーダ(findpts)と音声(lowerBound)からの参照を行う
+static int io_bench_framepos(RGYIOBenchResult& result, bool retire, int frames, shared_ptr<RGYLog> pLog) {
+    result.kind = _T("framepos");
+    result.target = (retire) ? _T("retire") : _T("keep");
+
+    const int duration = 3003;  //90kHzで29.97fps
+    const int lagEncoder = 64;  //エンコーダからの参照の遅れ (フレーム数)
+    const int lagAudio = 96;    //音声からの参照の遅れ (フレーム数)
+    const int checkFrames = 64; //この数のフレームを追加したらptsの状態を確認する (入力の初期化時と同様)
+    auto frameList = std::unique_ptr<FramePosList>(new FramePosList());
+    uint32_t lookupIndex = UINT32_MAX;
+    int audioIndex = 0;
+    int audioCursor = -1;
+    int retainedMax = 0;
+    int errors = 0;
+
+    IOBenchTimer timer;
+    timer.start();
+    for (int i = 0; i < frames; i++) {
+        //IPBBの順で、デコード順とptsの順が異なるようにする
+        const int64_t ptsIdx = (i == 0) ? 0 : (((i - 1) % 3 == 0) ? i + 2 : i - 1);
+        frameList->add(framePos(ptsIdx * duration, (int64_t)(i - 1) * duration, duration, 0, FRAMEPOS_POC_INVALID, (i % 300 == 0) ? AV_PKT_FLAG_KEY : 0));
+        if (i + 1 == checkFrames) {
+            frameList->checkPtsStatus();
+            if (retire) {
+                frameList->setRetire(FRAMEPOS_KEEP_FRAMES, true);
+                audioCursor = frameList->addCursor(audioIndex);
+            }
+        }
+        if (i >= checkFrames + lagEncoder) {
+            const int64_t pts = (int64_t)(i - lagEncoder) * duration;
+            const auto pos = frameList->findpts(pts, &lookupIndex);
+            errors += (pos.poc == FRAMEPOS_POC_INVALID || pos.pts != pts);
+        }
+        if (i >= checkFrames + lagAudio) {
+            //音声のptsはフレームの途中
+            const int64_t pts = (int64_t)(i - lagAudio) * duration + duration / 2;
+            const int fixedNum = (std::min)(frameList->fixedNum(), frameList->frameNum());
+            const int idx = frameList->lowerBound(audioIndex, fixedNum, [pts](const FramePos& pos) { return pos.pts < pts; });
+            errors += (idx <= audioIndex || idx >= fixedNum || frameList->list(idx - 1).pts > pts);
+            audioIndex = idx - 1;
+            frameList->moveCursor(audioCursor, audioIndex);
+        }
+        retainedMax = (std::max)(retainedMax, frameList->frameNum() - frameList->firstIndex());
+    }
+    timer.stop(result);
+    result.frames = frames;
+    result.memBytes = (int64_t)retainedMax * sizeof(FramePos);
+    if (errors) {
+        pLog->write(RGY_LOG_ERROR, _T("io-bench: framepos %s: %d lookups failed.\n"), result.target.c_str(), errors);
+        return 1;
+    }
+    return 0;
+}
+#endif //#if ENABLE_AVSW_READER
+
+//--- 実行 -------------------------------------------------------------------------------
+static tstring io_bench_temp_dir() {
+#if defined(_WIN32) || defined(_WIN64)
+    TCHAR buf[1024] = { 0 };
+    if (GetTempPath(_countof(buf), buf)) {
+        return buf;
+    }
+    return _T(".");
+#else
+    const char *tmpdir = getenv("TMPDIR");
+    return (tmpdir) ? tmpdir : "/tmp";
+#endif
+}
+
+int run_io_bench(const RGYIOBenchPrm& prm, shared_ptr<RGYLog> pLog) {
+    const tstring dir = (prm.dir.length() > 0) ? prm.dir : io_bench_temp_dir();
+    if (!CreateDirectoryRecursive(dir.c_str())) {
+        pLog->write(RGY_LOG_ERROR, _T("io-bench: failed to create directory \"%s\".\n"), dir.c_str());
+        return 1;
+    }
+    const tstring basename = strsprintf(_T("rgy_io_bench_%dx%d_%dbit"), prm.width, prm.height, prm.bitdepth);
+    pLog->write(RGY_LOG_INFO, _T("io-bench: %dx%d, %dbit, %d frames, gop %d, %d/%d fps, dir \"%s\"\n"),
+        prm.width, prm.height, prm.bitdepth, prm.frames, prm.gop, prm.fpsN, prm.fpsD, dir.c_str());
+
+    std::vector<RGYIOBenchResult> results;
+    std::vector<tstring> tempFiles;
+    int ret = 0;
+
+    //ライター (合成したH.264ストリームを出力する)
+    //mp4/mkv/tsの出力は、あとでavcodecリーダーの入力として使用する
+    std::vector<std::pair<tstring, tstring>> containerFiles;
+    const bool needContainer = std::find(prm.readers.begin(), prm.readers.end(), _T("avcodec")) != prm.readers.end();
+    std::vector<tstring> writers = prm.writers;
+    if (needContainer && std::none_of(writers.begin(), writers.end(), [](const tstring& w) { return w == _T("mp4") || w == _T("mkv") || w == _T("ts"); })) {
+        writers.push_back(_T("mkv")); //avcodecリーダーの入力を作成する (結果には含めない)
+    }
+    if (writers.size() > 0) {
+        IOBenchH264Source source;
+        source.init(prm);
+        for (size_t i = 0; i < writers.size(); i++) {
+            const auto& writer = writers[i];
+            const bool measure = i < prm.writers.size();
+            const tstring ext = (writer == _T("raw") || writer == _T("null")) ? _T("264") : writer;
+            const tstring filename = (writer == _T("null")) ? _T("") : PathCombineS(dir, basename + _T(".") + ext);
+            RGYIOBenchResult result;
+            if (io_bench_writer(result, writer, filename, prm, source, pLog)) {
+                ret = 1;
+                continue;
+            }
+            if (filename.length() > 0) {
+                tempFiles.push_back(filename);
+            }
+            if (writer == _T("mp4") || writer == _T("mkv") || writer == _T("ts")) {
+                containerFiles.push_back(std::make_pair(writer, filename));
+            }
+            if (measure) {
+                results.push_back(result);
+            }
+        }
+    }
+
+    //リーダー
+    for (const auto& reader : prm.readers) {
+        if (reader == _T("avcodec")) {
+            for (const auto& container : containerFiles) {
+                RGYIOBenchResult result;
+                if (io_bench_reader(result, _T("avcodec:") + container.first, container.second, prm, pLog)) {
+                    ret = 1;
+                    continue;
+                }
+                results.push_back(result);
+            }
+            continue;
+        }
+        if (prm.bitdepth > 8 && reader != _T("y4m")) {
+            pLog->write(RGY_LOG_WARN, _T("io-bench: reader %s supports only 8bit input, skipped.\n"), reader.c_str());
+            continue;
+        }
+        const tstring ext = (reader == _T("raw")) ? _T("yuv") : reader;
+        const tstring filename = PathCombineS(dir, basename + _T(".") + ext);
+        RGY_ERR err = io_bench_create_source(filename, reader, prm);
+        tempFiles.push_back(filename);
+        if (err != RGY_ERR_NONE) {
+            pLog->write(RGY_LOG_ERROR, _T("io-bench: failed to create \"%s\": %s\n"), filename.c_str(), get_err_mes(err));
+            ret = 1;
+            continue;
+        }
+        RGYIOBenchResult result;
+        if (io_bench_reader(result, reader, filename, prm, pLog)) {
+            ret = 1;
+        } else {
+            results.push_back(result);
+        }
+        if (!prm.keep) {
+            //大きなファイルなので、すぐに削除する
+            _tremove(filename.c_str());
+        }
+    }
+    if (!prm.keep) {
+        for (const auto& file : tempFiles) {
+            _tremove(file.c_str());
+        }
+    }
+
+#if ENABLE_AVSW_READER
+    //FramePosList
+    if (prm.frameposFrames > 0) {
+        for (const bool retire : { false, true }) {
+            RGYIOBenchResult result;
+            if (io_bench_framepos(result, retire, prm.frameposFrames, pLog)) {
+                ret = 1;
+            }
+            results.push_back(result);
+        }
+    }
+#endif //#if ENABLE_AVSW_READER
+
+    //結果の出力 (csv)
+    FILE *fp = stdout;
+    unique_ptr<FILE, fp_deleter> fpOutput;
+    if (prm.output.length() > 0) {
+        if (0 != _tfopen_s(&fp, prm.output.c_str(), _T("w")) || fp == nullptr) {
+            pLog->write(RGY_LOG_ERROR, _T("io-bench: failed to open \"%s\".\n"), prm.output.c_str());
+            return 1;
+        }
+        fpOutput.reset(fp);
+    }
+    _ftprintf(fp, _T("kind,target,width,height,bitdepth,frames,seconds,fps,bytes,MB_per_sec,cpu_total_ms,cpu_main_ms,cpu_worker_ms,buf_alloc,buf_copy,buf_move,mem_bytes\n"));
+    for (const auto& r : results) {
+        _ftprintf(fp, _T("%s,%s,%d,%d,%d,%d,%.6f,%.3f,%lld,%.3f,%.3f,%.3f,%.3f,%lld,%lld,%lld,%lld\n"),
+            r.kind.c_str(), r.target.c_str(), prm.width, prm.height, prm.bitdepth, r.frames, r.sec, r.fps(),
+            (long long)r.bytes, r.mbps(), r.cpuTotalUs * 1e-3, r.cpuMainUs * 1e-3, (r.cpuWorkerUs >= 0) ? r.cpuWorkerUs * 1e-3 : -1.0,
+            (long long)r.bufAlloc, (long long)r.bufCopy, (long long)r.bufMove, (long long)r.memBytes);
+    }
+    fflush(fp);
+    for (const auto& r : results) {
+        pLog->write(RGY_LOG_INFO, _T("io-bench: %-6s %-12s %5d frames, %9.2f fps, %9.2f MB/s, cpu %7.1f%%\n"),
+            r.kind.c_str(), r.target.c_str(), r.frames, r.fps(), r.mbps(), (r.sec > 0.0) ? r.cpuTotalUs * 1e-4 / r.sec : 0.0);
+        if (r.memBytes >= 0) {
+            pLog->write(RGY_LOG_INFO, _T("io-bench: %-6s %-12s %9.2f ns/frame, retained %.2f KB\n"),
+                r.kind.c_str(), r.target.c_str(), (r.frames > 0) ? r.sec * 1e9 / r.frames : 0.0, r.memBytes / 1024.0);
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,86 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#pragma once
+#ifndef __RGY_IO_BENCH_H__
+#define __RGY_IO_BENCH_H__
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include "rgy_tchar.h"
+#include "rgy_log.h"
+#include "rgy_util.h"
+
+//--io-bench: 合成した入力/ビットストリームを使って、各リーダー/ライターのホスト側の処理速度を計測する
+//  GPUは使用しない (エンコードの代わりに、I_PCM/P_Skipのみからなる合成したH.264ストリームを出力する)
+struct RGYIOBenchPrm {
+    int width;
+    int height;
+    int bitdepth;        //8, 9, 10, 12, 14 (raw/aviは8bitのみ)
+    int frames;
+    int gop;             //IDRの間隔
+    int fpsN;
+    int fpsD;
+    tstring dir;         //作業ディレクトリ (tmpfsやRAMディスクを指定するとディスクの影響を除ける)
+    tstring output;      //結果(csv)の出力先 (空ならstdout)
+    std::vector<tstring> readers; //raw, y4m, avi, avcodec
+    std::vector<tstring> writers; //raw, null, mp4, mkv, ts
+    bool keep;           //生成したファイルを残す
+    int frameposFrames;  //FramePosListの追加/検索を計測するフレーム数 (0なら計測しない)
+
+    RGYIOBenchPrm();
+    //"<param1>=<value>[,<param2>=<value>][...]"の形式の文字列を解析する
+    //成功すれば0を返し、失敗した場合はerrに理由を格納する
+    int parse(const TCHAR *str, tstring& err);
+};
+
+struct RGYIOBenchResult {
+    tstring kind;         //reader / writer
+    tstring target;       //raw, y4m, avi, avcodec:mp4, ...
+    int     frames;
+    int64_t bytes;        //読み込んだ/書き出したデータ量
+    double  sec;          //経過時間
+    int64_t cpuTotalUs;   //プロセス全体のCPU時間
+    int64_t cpuMainUs;    //呼び出し側のスレッドのCPU時間
+    int64_t cpuWorkerUs;  //リーダー/ライター内部のスレッドのCPU時間 (-1: スレッドなし/取得不可)
+    int64_t bufAlloc;     //ビットストリームのバッファを確保した回数 (-1: 対象外)
+    int64_t bufCopy;      //ビットストリームをコピーした回数 (-1: 対象外)
+    int64_t bufMove;      //ビットストリームをコピーせずに受け渡した回数 (-1: 対象外)
+    int64_t memBytes;     //保持しているデータの最大量 (-1: 対象外)
+
+    RGYIOBenchResult();
+    double fps() const;
+    double mbps() const;
+};
+
+//計測を実行し、結果をprm.outputに書き出す
+//成功すれば0を返す
+int run_io_bench(const RGYIOBenchPrm& prm, std::shared_ptr<RGYLog> pLog);
+
+#endif //__RGY_IO_BENCH_H__
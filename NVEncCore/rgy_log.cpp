@@ -32,6 +32,7 @@
 const char *RGYLog::HTML_FOOTER = "</body>\n</html>\n";
 
 void RGYLog::init(const TCHAR *pLogFile, int log_level) {
+    closeWriter();
     m_pStrLog = pLogFile;
     m_nLogLevel = log_level;
     if (pLogFile != nullptr && _tcslen(pLogFile) > 0) {
@@ -39,7 +40,7 @@ void RGYLog::init(const TCHAR *pLogFile, int log_level) {
         FILE *fp = NULL;
         if (_tfopen_s(&fp, pLogFile, _T("a+")) || fp == NULL) {
             fprintf(stderr, "failed to open log file, log writing disabled.\n");
-            pLogFile = nullptr;
+            m_pStrLog = nullptr;
         } else {
             if (check_ext(pLogFile, { ".html", ".htm" })) {
                 _fseeki64(fp, 0, SEEK_SET);
@@ -56,10 +57,164 @@ void RGYLog::init(const TCHAR *pLogFile, int log_level) {
                 }
             }
             fclose(fp);
+            startWriter();
         }
     }
 };
 
+void RGYLog::startWriter() {
+    //logはANSI(まあようはShift-JIS)で保存する
+    if (_tfopen_s(&m_fpLog, m_pStrLog, (m_bHtml) ? _T("rb+") : _T("a")) || m_fpLog == NULL) {
+        fprintf(stderr, "failed to open log file, log writing disabled.\n");
+        m_fpLog = nullptr;
+        m_pStrLog = nullptr;
+        return;
+    }
+    if (m_bHtml) {
+        //フッターの直前から書き込みを開始し、フッターは終了時に1回だけ書き込む
+        _fseeki64(m_fpLog, 0, SEEK_END);
+        const int64_t pos = _ftelli64(m_fpLog);
+        _fseeki64(m_fpLog, (std::max)((int64_t)0, pos - (int64_t)strlen(HTML_FOOTER)), SEEK_SET);
+    }
+    m_queue.reset(new RGYLogLine[RGY_LOG_QUEUE_SIZE]);
+    for (size_t i = 0; i < RGY_LOG_QUEUE_SIZE; i++) {
+        m_queue[i].seq = i;
+    }
+    m_queueIn = 0;
+    m_queueOut = 0;
+    m_nLostLines = 0;
+    m_bWriterFin = false;
+    m_thWriter = std::thread(&RGYLog::writerThread, this);
+    m_bWriterRunning.store(true, std::memory_order_release);
+}
+
+void RGYLog::closeWriter() {
+    //以降の行は書き込みスレッドに渡さない
+    m_bWriterRunning.store(false, std::memory_order_release);
+    if (m_thWriter.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mtxWriter);
+            m_bWriterFin = true;
+        }
+        m_cvWriter.notify_one();
+        m_cvSpace.notify_all();
+        m_thWriter.join();
+    }
+    if (m_fpLog) {
+        if (m_bHtml) {
+            fwrite(HTML_FOOTER, 1, strlen(HTML_FOOTER), m_fpLog);
+        }
+        fclose(m_fpLog);
+        m_fpLog = nullptr;
+    }
+    m_queue.reset();
+}
+
+void RGYLog::wakeWriter() {
+    m_cvWriter.notify_one();
+}
+
+//リングバッファに空きができるまで待機して追加する
+//書き込みスレッドが終了していて追加できなかった場合はfalseを返す
+bool RGYLog::waitSpace(std::string& str, size_t& pos) {
+    std::unique_lock<std::mutex> lock(m_mtxWriter);
+    //ロックを保持したまま確認してから待機するので、書き込みスレッドからの通知は取りこぼさない
+    bool ret = true;
+    m_nSpaceWaiters++;
+    while (!pushLine(str, pos)) {
+        if (m_bWriterFin) {
+            ret = false;
+            break;
+        }
+        m_cvWriter.notify_one();
+        m_cvSpace.wait(lock);
+    }
+    m_nSpaceWaiters--;
+    return ret;
+}
+
+//複数のスレッドから呼ばれる
+//リングバッファが一杯ならfalseを返し、strはそのまま残す
+bool RGYLog::pushLine(std::string& str, size_t& pos) {
+    pos = m_queueIn.load(std::memory_order_relaxed);
+    RGYLogLine *line = nullptr;
+    for (;;) {
+        line = &m_queue[pos & (RGY_LOG_QUEUE_SIZE - 1)];
+        const size_t seq = line->seq.load(std::memory_order_acquire);
+        const auto diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            //この位置を確保できたら書き込む
+            if (m_queueIn.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            //書き込みスレッドがまだ取り出していない = 一杯
+            return false;
+        } else {
+            //ほかのスレッドが先に確保した
+            pos = m_queueIn.load(std::memory_order_relaxed);
+        }
+    }
+    line->str = std::move(str);
+    line->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+//書き込みスレッドからのみ呼ばれる
+bool RGYLog::popLine(std::string& str) {
+    RGYLogLine *line = &m_queue[m_queueOut & (RGY_LOG_QUEUE_SIZE - 1)];
+    if (line->seq.load(std::memory_order_acquire) != m_queueOut + 1) {
+        return false;
+    }
+    str = std::move(line->str);
+    line->str.clear();
+    line->seq.store(m_queueOut + RGY_LOG_QUEUE_SIZE, std::memory_order_release);
+    m_queueOut++;
+    return true;
+}
+
+void RGYLog::writerThread() {
+    std::string batch;
+    std::string str;
+    uint64_t lostLinesReported = 0;
+    for (;;) {
+        //終了指示を先に確認してから取り出すことで、終了指示の前に追加された行はすべて書き出す
+        const bool fin = m_bWriterFin;
+        bool popped = false;
+        while (popLine(str)) {
+            batch += str;
+            popped = true;
+        }
+        if (popped) {
+            //空きを待っている警告・エラーを起こす
+            { std::lock_guard<std::mutex> lock(m_mtxWriter); }
+            m_cvSpace.notify_all();
+        }
+        const uint64_t lostLines = m_nLostLines;
+        if (lostLines != lostLinesReported) {
+            auto mes = strsprintf("log writing could not keep up, %llu lines dropped.", (unsigned long long)(lostLines - lostLinesReported));
+            batch += (m_bHtml) ? "<div class=\"warn\">" + mes + "</div>\n" : mes + "\n";
+            lostLinesReported = lostLines;
+        }
+        if (batch.length() > 0) {
+            fwrite(batch.data(), 1, batch.length(), m_fpLog);
+            fflush(m_fpLog);
+            batch.clear();
+        }
+        if (fin) {
+            std::lock_guard<std::mutex> lock(m_mtxWriter);
+            m_cvSpace.notify_all();
+            break;
+        }
+        //一定間隔ごと、あるいはリングバッファが埋まってきたら起こされてまとめて書き込む
+        //空きを待っているスレッドがあれば、待機せずに続けて書き込む
+        std::unique_lock<std::mutex> lock(m_mtxWriter);
+        m_cvWriter.wait_for(lock, std::chrono::milliseconds(RGY_LOG_FLUSH_INTERVAL_MS), [this]() {
+            return m_bWriterFin || m_nSpaceWaiters > 0;
+        });
+    }
+}
+
 void RGYLog::writeHtmlHeader() {
     FILE *fp = NULL;
     if (_tfopen_s(&fp, m_pStrLog, _T("wb"))) {
@@ -186,25 +341,26 @@ void RGYLog::write_log(int log_level, const TCHAR *buffer, bool file_only) {
         buffer_ptr = &buffer_char[0];
     }
 #endif
-    std::lock_guard<std::mutex> lock(m_mtx);
-    if (m_pStrLog) {
-        FILE *fp_log = NULL;
-        //logはANSI(まあようはShift-JIS)で保存する
-        if (0 == _tfopen_s(&fp_log, m_pStrLog, (m_bHtml) ? _T("rb+") : _T("a")) && fp_log) {
-            if (m_bHtml) {
-                _fseeki64(fp_log, 0, SEEK_END);
-                int64_t pos = _ftelli64(fp_log);
-                _fseeki64(fp_log, 0, SEEK_SET);
-                _fseeki64(fp_log, pos -1 * strlen(HTML_FOOTER), SEEK_CUR);
+    if (m_pStrLog && m_bWriterRunning.load(std::memory_order_acquire)) {
+        //ファイルへの書き込みは書き込みスレッドに任せる
+        std::string str(buffer_ptr);
+        size_t pos = 0;
+        if (pushLine(str, pos)) {
+            //リングバッファが埋まってくる前に書き込みスレッドを起こす
+            if (log_level >= RGY_LOG_WARN || (pos & (RGY_LOG_QUEUE_SIZE / 4 - 1)) == 0) {
+                wakeWriter();
             }
-            fwrite(buffer_ptr, 1, strlen(buffer_ptr), fp_log);
-            if (m_bHtml) {
-                fwrite(HTML_FOOTER, 1, strlen(HTML_FOOTER), fp_log);
+        } else if (log_level >= RGY_LOG_WARN) {
+            //警告・エラーは破棄せず、空きができるまで待機する
+            if (!waitSpace(str, pos)) {
+                m_nLostLines++;
             }
-            fclose(fp_log);
+        } else {
+            m_nLostLines++;
         }
     }
     if (!file_only) {
+        std::lock_guard<std::mutex> lock(m_mtx);
 #ifdef UNICODE
         if (!stderr_write_to_console) //出力先がリダイレクトされるならANSIで
             fprintf(stderr, buffer_ptr);
@@ -262,14 +418,22 @@ void RGYLog::write(int log_level, const TCHAR *format, ...) {
         return;
     }
 
-    va_list args;
+    //書式指定がなければ (PrintMes等で整形済みの文字列が渡される場合がほとんど)、整形を省略する
+    if (_tcschr(format, _T('%')) == nullptr) {
+        write_log(log_level, format);
+        return;
+    }
+
+    va_list args, args_copy;
     va_start(args, format);
+    va_copy(args_copy, args);
 
     int len = _vsctprintf(format, args) + 1; // _vscprintf doesn't count terminating '\0'
     std::vector<TCHAR> buffer(len, 0);
     if (buffer.data() != nullptr) {
-        _vstprintf_s(buffer.data(), len, format, args); // C4996
+        _vstprintf_s(buffer.data(), len, format, args_copy); // C4996
         write_log(log_level, buffer.data());
     }
+    va_end(args_copy);
     va_end(args);
 }
@@ -33,21 +33,59 @@
 #include <thread>
 #include <string>
 #include <mutex>
+#include <atomic>
+#include <memory>
+#include <condition_variable>
 #include "rgy_tchar.h"
 #include "rgy_util.h"
 
+//ログファイルへの書き込み待ちの行数の上限 (2の累乗)
+static const int RGY_LOG_QUEUE_SIZE = 4096;
+//ログファイルへの書き込みスレッドが、起床を待たずに書き込みを行う間隔
+static const int RGY_LOG_FLUSH_INTERVAL_MS = 100;
+
 class RGYLog {
 protected:
+    //ログファイルへの書き込み待ちの行
+    struct RGYLogLine {
+        std::atomic<size_t> seq;
+        std::string str;
+    };
     int m_nLogLevel = RGY_LOG_INFO;
     const TCHAR *m_pStrLog = nullptr;
     bool m_bHtml = false;
     std::mutex m_mtx;
     static const char *HTML_FOOTER;
+
+    //ログファイルへの書き込みは、専用のスレッドでまとめて行う
+    //書き込み待ちの行は、複数のスレッドからロックなしで追加できるリングバッファで受け渡す
+    std::unique_ptr<RGYLogLine[]> m_queue;   //書き込み待ちの行のリングバッファ
+    std::atomic<size_t> m_queueIn;           //次に追加する位置 (複数の書き込み側で共有)
+    size_t m_queueOut = 0;                   //次に取り出す位置 (書き込みスレッドのみが使用)
+    std::atomic<uint64_t> m_nLostLines;      //リングバッファが一杯で破棄した行数
+    std::atomic<bool> m_bWriterFin;          //書き込みスレッドの終了指示
+    std::atomic<bool> m_bWriterRunning;      //書き込みスレッドが行を受け付けているか
+    std::mutex m_mtxWriter;
+    std::condition_variable m_cvWriter;      //書き込みスレッドの起床
+    std::condition_variable m_cvSpace;       //リングバッファの空きを待つ警告・エラーの起床
+    int m_nSpaceWaiters = 0;                 //リングバッファの空きを待っているスレッド数 (m_mtxWriterで保護)
+    std::thread m_thWriter;                  //ログファイルへの書き込みスレッド
+    FILE *m_fpLog = nullptr;                 //ログファイル (書き込みスレッドの実行中は開いたままにする)
+
+    void startWriter();
+    void closeWriter();
+    void writerThread();
+    bool pushLine(std::string& str, size_t& pos);
+    bool popLine(std::string& str);
+    void wakeWriter();
+    bool waitSpace(std::string& str, size_t& pos);
 public:
-    RGYLog(const TCHAR *pLogFile, int log_level = RGY_LOG_INFO) {
+    RGYLog(const TCHAR *pLogFile, int log_level = RGY_LOG_INFO) :
+        m_queueIn(0), m_nLostLines(0), m_bWriterFin(false), m_bWriterRunning(false) {
         init(pLogFile, log_level);
     };
     virtual ~RGYLog() {
+        closeWriter();
     };
     void init(const TCHAR *pLogFile, int log_level = RGY_LOG_INFO);
     void writeHtmlHeader();
@@ -64,6 +102,10 @@ public:
     bool logFileAvail() {
         return m_pStrLog != nullptr;
     }
+    //書き込みが追いつかずに破棄したログの行数
+    uint64_t getLostLines() {
+        return m_nLostLines;
+    }
     virtual void write_log(int log_level, const TCHAR *buffer, bool file_only = false);
     virtual void write(int log_level, const TCHAR *format, ...);
     virtual void write(int log_level, const WCHAR *format, va_list args);
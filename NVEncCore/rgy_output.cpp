@@ -79,7 +79,9 @@ void RGYOutput::Close() {
 }
 
 RGYOutputRaw::RGYOutputRaw() :
-    m_seiNal()
+    m_seiNal(),
+    m_hdr10plus(),
+    m_hdr10plusNal()
 #if ENABLE_AVSW_READER
     , m_pBsfc()
 #endif //#if ENABLE_AVSW_READER
@@ -207,6 +209,7 @@ RGY_ERR RGYOutputRaw::Init(const TCHAR *strFileName, const VideoInfo *pVideoOutp
 #endif //#if ENABLE_AVSW_READER
         if (rawPrm->codecId == RGY_CODEC_HEVC) {
             m_seiNal = rawPrm->seiNal;
+            m_hdr10plus = rawPrm->hdr10plus;
         }
     }
     m_bInited = true;
@@ -270,6 +273,9 @@ RGY_ERR RGYOutputRaw::WriteNextFrame(RGYBitstream *pBitstream) {
             }
         }
 #endif //#if ENABLE_AVSW_READER
+        if (m_hdr10plus) {
+            m_hdr10plus->getNal(pBitstream->frameIdx(), m_hdr10plusNal);
+        }
         if (m_seiNal.size()) {
             std::vector<nal_info> nal_list = parse_nal_unit_hevc(pBitstream->data(), pBitstream->size());
             const auto hevc_vps_nal = std::find_if(nal_list.begin(), nal_list.end(), [](nal_info info) { return info.type == NALU_HEVC_VPS; });
@@ -281,6 +287,9 @@ RGY_ERR RGYOutputRaw::WriteNextFrame(RGYBitstream *pBitstream) {
                 nBytesWritten += (uint32_t)fwrite(hevc_sps_nal->ptr, 1, hevc_sps_nal->size, m_fDest.get());
                 nBytesWritten += (uint32_t)fwrite(hevc_pps_nal->ptr, 1, hevc_pps_nal->size, m_fDest.get());
                 nBytesWritten += (uint32_t)fwrite(m_seiNal.data(),   1, m_seiNal.size(),    m_fDest.get());
+                if (m_hdr10plusNal.size()) {
+                    nBytesWritten += (uint32_t)fwrite(m_hdr10plusNal.data(), 1, m_hdr10plusNal.size(), m_fDest.get());
+                }
                 for (const auto& nal : nal_list) {
                     if (nal.type != NALU_HEVC_VPS && nal.type != NALU_HEVC_SPS && nal.type != NALU_HEVC_PPS) {
                         nBytesWritten += (uint32_t)fwrite(nal.ptr, 1, nal.size, m_fDest.get());
@@ -291,6 +300,13 @@ RGY_ERR RGYOutputRaw::WriteNextFrame(RGYBitstream *pBitstream) {
                 return RGY_ERR_UNDEFINED_BEHAVIOR;
             }
             m_seiNal.clear();
+        } else if (m_hdr10plusNal.size()) {
+            //AUをコピーせず、SEIの前後に分けて書き出す
+            const uint32_t seiOffset = RGYHDR10Plus::seiInsertOffset(pBitstream->data(), pBitstream->size());
+            nBytesWritten  = (uint32_t)fwrite(pBitstream->data(), 1, seiOffset, m_fDest.get());
+            nBytesWritten += (uint32_t)fwrite(m_hdr10plusNal.data(), 1, m_hdr10plusNal.size(), m_fDest.get());
+            nBytesWritten += (uint32_t)fwrite(pBitstream->data() + seiOffset, 1, pBitstream->size() - seiOffset, m_fDest.get());
+            WRITE_CHECK(nBytesWritten, pBitstream->size() + (uint32_t)m_hdr10plusNal.size());
         } else {
             nBytesWritten = (uint32_t)fwrite(pBitstream->data(), 1, pBitstream->size(), m_fDest.get());
             WRITE_CHECK(nBytesWritten, pBitstream->size());
@@ -38,6 +38,7 @@
 #include "rgy_log.h"
 #include "rgy_status.h"
 #include "rgy_avutil.h"
+#include "rgy_hdr10plus.h"
 #include "NVEncUtil.h"
 
 using std::unique_ptr;
@@ -170,6 +171,7 @@ struct RGYOutputRawPrm {
     int nBufSizeMB;
     RGY_CODEC codecId;
     vector<uint8_t> seiNal;
+    shared_ptr<RGYHDR10Plus> hdr10plus;
 };
 
 class RGYOutputRaw : public RGYOutput {
@@ -184,6 +186,8 @@ protected:
     virtual RGY_ERR Init(const TCHAR *strFileName, const VideoInfo *pOutputInfo, const void *prm) override;
 
     vector<uint8_t> m_seiNal;
+    shared_ptr<RGYHDR10Plus> m_hdr10plus; //HDR10+の動的メタデータ
+    vector<uint8_t> m_hdr10plusNal;       //フレームごとのHDR10+のSEI
 #if ENABLE_AVSW_READER
     unique_ptr<AVBSFContext, RGYAVDeleter<AVBSFContext>> m_pBsfc;
 #endif //#if ENABLE_AVSW_READER
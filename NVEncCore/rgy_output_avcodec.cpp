@@ -52,11 +52,22 @@ static int64_t funcSeek(void *opaque, int64_t offset, int whence) {
 }
 #endif //USE_CUSTOM_IO
 
+//nOutputSamples/nDelaySamplesOfAudioの基準となるサンプリング周波数
+//エンコードする場合はエンコーダの、しない場合(コピー, FAW)は入力のサンプリング周波数
+static AVRational muxAudioSamplerate(const AVMuxAudio *pMuxAudio) {
+    return av_make_q(1, (pMuxAudio->pOutCodecEncodeCtx) ? pMuxAudio->pOutCodecEncodeCtx->sample_rate : pMuxAudio->pStreamIn->codecpar->sample_rate);
+}
+
 const AVRational RGYOutputAvcodec::QUEUE_DTS_TIMEBASE = av_make_q(1, 90000);
 
-RGYOutputAvcodec::RGYOutputAvcodec() {
+RGYOutputAvcodec::RGYOutputAvcodec() :
+    m_nVideoBufAlloc(0), m_nVideoBufCopy(0), m_nVideoBufMove(0), m_hdr10plus(), m_hdr10plusNal(), m_bsAnalyzer() {
     memset(&m_Mux.format, 0, sizeof(m_Mux.format));
     memset(&m_Mux.video,  0, sizeof(m_Mux.video));
+    m_Mux.fragment = AVMuxFragment();
+#if ENABLE_AVCODEC_OUT_THREAD
+    m_Mux.thread.bVideoBufRecycle = false;
+#endif
     m_strWriterName = _T("avout");
 }
 
@@ -122,6 +133,9 @@ void RGYOutputAvcodec::CloseAudio(AVMuxAudio *pMuxAudio) {
     if (pMuxAudio->pAACBsfc) {
         av_bsf_free(&pMuxAudio->pAACBsfc);
     }
+    if (pMuxAudio->pFAWDecoder) {
+        delete pMuxAudio->pFAWDecoder;
+    }
     memset(pMuxAudio, 0, sizeof(pMuxAudio[0]));
     AddMessage(RGY_LOG_DEBUG, _T("Closed audio.\n"));
 }
@@ -130,6 +144,10 @@ void RGYOutputAvcodec::CloseVideo(AVMuxVideo *pMuxVideo) {
     if (m_Mux.video.fpTsLogFile) {
         fclose(m_Mux.video.fpTsLogFile);
     }
+    if (m_Mux.video.pStreamOut) {
+        AddMessage(RGY_LOG_DEBUG, _T("video bitstream buffer: allocated %lld times, copied %lld times, passed without copy %lld times.\n"),
+            (long long)m_nVideoBufAlloc.load(), (long long)m_nVideoBufCopy.load(), (long long)m_nVideoBufMove.load());
+    }
     m_Mux.video.timestampList.clear();
     if (m_Mux.video.pBsfc) {
         av_bsf_free(&m_Mux.video.pBsfc);
@@ -141,6 +159,9 @@ void RGYOutputAvcodec::CloseVideo(AVMuxVideo *pMuxVideo) {
 void RGYOutputAvcodec::CloseFormat(AVMuxFormat *pMuxFormat) {
     if (pMuxFormat->pFormatCtx) {
         if (!pMuxFormat->bStreamError) {
+            if (m_Mux.fragment.bEnable && pMuxFormat->bFileHeaderWritten) {
+                CloseFragment();
+            }
             av_write_trailer(pMuxFormat->pFormatCtx);
         }
 #if USE_CUSTOM_IO
@@ -170,6 +191,11 @@ void RGYOutputAvcodec::CloseFormat(AVMuxFormat *pMuxFormat) {
     }
 #endif //USE_CUSTOM_IO
     memset(pMuxFormat, 0, sizeof(pMuxFormat[0]));
+    //エラー等で書き出されずに残ったパケットを解放する
+    for (auto& pkt : m_Mux.fragment.pending) {
+        av_packet_unref(&pkt);
+    }
+    m_Mux.fragment = AVMuxFragment();
     AddMessage(RGY_LOG_DEBUG, _T("Closed format.\n"));
 }
 
@@ -230,6 +256,8 @@ void RGYOutputAvcodec::CloseThread() {
         CloseEvent(m_Mux.thread.heEventClosingOutput);
         AddMessage(RGY_LOG_DEBUG, _T("closed output thread...\n"));
     }
+    //これ以降(av_write_trailer等)でAVPacketから解放された映像のバッファは、キューに戻さずに解放する
+    m_Mux.thread.bVideoBufRecycle = false;
     CloseQueues();
     m_Mux.thread.bAbortOutput = false;
     m_Mux.thread.bThAudProcessAbort = false;
@@ -495,6 +523,16 @@ RGY_ERR RGYOutputAvcodec::InitVideo(const VideoInfo *pVideoOutputInfo, const Avc
     m_Mux.video.bDtsUnavailable   = prm->bVideoDtsUnavailable;
     m_Mux.video.nInputFirstKeyPts = prm->nVideoInputFirstKeyPts;
     m_Mux.video.pTimestamp        = prm->pVidTimestamp;
+    if (pVideoOutputInfo->codec == RGY_CODEC_HEVC) {
+        m_hdr10plus = prm->pHDR10plus;
+    }
+    if (RGY_LOG_DEBUG >= m_pPrintMes->getLogLevel()
+        && (pVideoOutputInfo->codec == RGY_CODEC_H264 || pVideoOutputInfo->codec == RGY_CODEC_HEVC)) {
+        //デバッグ時は、出力するビットストリームを解析して検証する
+        m_bsAnalyzer.reset(new RGYBitstreamAnalyzer());
+        m_bsAnalyzer->init(pVideoOutputInfo->codec);
+        AddMessage(RGY_LOG_DEBUG, _T("Enabled video bitstream check.\n"));
+    }
 
     if (prm->pVideoInputStream) {
         m_Mux.video.inputStreamTimebase = prm->pVideoInputStream->time_base;
@@ -914,6 +952,34 @@ RGY_ERR RGYOutputAvcodec::InitAudioResampler(AVMuxAudio *pMuxAudio, int channels
     return RGY_ERR_NONE;
 }
 
+RGY_ERR RGYOutputAvcodec::InitAudioFAW(AVMuxAudio *pMuxAudio, AVOutputStreamPrm *pInputAudio, RGYAACHeader *pAACHeader) {
+    const AVCodecParameters *codecpar = pMuxAudio->pStreamIn->codecpar;
+    if (codecpar->codec_id != AV_CODEC_ID_PCM_S16LE) {
+        AddMessage(RGY_LOG_ERROR, _T("faw is only available for 16bit pcm audio, but audio track %d is %s.\n"),
+            pInputAudio->src.nTrackId, char_to_tstring(avcodec_get_name(codecpar->codec_id)).c_str());
+        return RGY_ERR_INVALID_CODEC;
+    }
+    //出力ストリームのパラメータを決めるため、サンプルのパケットから形式とAACのヘッダを取得する
+    RGYFAWMode mode = RGY_FAW_NONE;
+    if (pInputAudio->src.pktSample.data) {
+        mode = RGYFAWDecoder::detect(pInputAudio->src.pktSample.data, pInputAudio->src.pktSample.size, pAACHeader);
+    }
+    if (mode == RGY_FAW_NONE) {
+        //AACの形式が分からないと出力ストリームのパラメータを正しく設定できないので、推測せずにエラーとする
+        AddMessage(RGY_LOG_ERROR, _T("failed to detect FAW from the beginning of audio track %d, the track might not be FAW.\n"),
+            pInputAudio->src.nTrackId);
+        return RGY_ERR_INVALID_FORMAT;
+    } else if (mode == RGY_FAW_MIX) {
+        AddMessage(RGY_LOG_WARN, _T("audio track %d is half size mix FAW, only the first stream (upper 8bit) will be used.\n"), pInputAudio->src.nTrackId);
+    }
+    pMuxAudio->pFAWDecoder = new RGYFAWDecoder();
+    pMuxAudio->pFAWDecoder->init(mode, 0);
+    AddMessage(RGY_LOG_DEBUG, _T("FAW: %s, AAC profile %d, %dHz, %dch.\n"),
+        (mode == RGY_FAW_FULL) ? _T("full size") : ((mode == RGY_FAW_HALF) ? _T("half size") : _T("half size mix")),
+        pAACHeader->profile, pAACHeader->sampleRate, pAACHeader->channels());
+    return RGY_ERR_NONE;
+}
+
 RGY_ERR RGYOutputAvcodec::InitAudio(AVMuxAudio *pMuxAudio, AVOutputStreamPrm *pInputAudio, uint32_t nAudioIgnoreDecodeError) {
     pMuxAudio->pStreamIn = pInputAudio->src.pStream;
     AddMessage(RGY_LOG_DEBUG, _T("start initializing audio ouput...\n"));
@@ -936,7 +1002,12 @@ RGY_ERR RGYOutputAvcodec::InitAudio(AVMuxAudio *pMuxAudio, AVOutputStreamPrm *pI
 
     //音声がwavの場合、フォーマット変換が必要な場合がある
     AVCodecID codecId = AV_CODEC_ID_NONE;
-    if (!avcodecIsCopy(pInputAudio->pEncodeCodec) || AV_CODEC_ID_NONE != (codecId = PCMRequiresConversion(pMuxAudio->pStreamIn->codecpar))) {
+    RGYAACHeader fawHeader;
+    if (avcodecIsFAW(pInputAudio->pEncodeCodec)) {
+        //FAWの場合は、デコード・エンコードせずにAACを取り出してコピーする
+        auto sts = InitAudioFAW(pMuxAudio, pInputAudio, &fawHeader);
+        if (sts != RGY_ERR_NONE) return sts;
+    } else if (!avcodecIsCopy(pInputAudio->pEncodeCodec) || AV_CODEC_ID_NONE != (codecId = PCMRequiresConversion(pMuxAudio->pStreamIn->codecpar))) {
         //デコーダの作成は親ストリームのみ
         if (pMuxAudio->nInSubStream == 0) {
             //setup decoder
@@ -1129,6 +1200,15 @@ RGY_ERR RGYOutputAvcodec::InitAudio(AVMuxAudio *pMuxAudio, AVOutputStreamPrm *pI
     AVCodecParameters *srcCodecParam = avcodec_parameters_alloc();
     if (pMuxAudio->pOutCodecEncodeCtx) {
         avcodec_parameters_from_context(srcCodecParam, pMuxAudio->pOutCodecEncodeCtx);
+    } else if (pMuxAudio->pFAWDecoder) {
+        srcCodecParam->codec_type     = AVMEDIA_TYPE_AUDIO;
+        srcCodecParam->codec_id       = AV_CODEC_ID_AAC;
+        srcCodecParam->frame_size     = RGY_AAC_FRAME_SAMPLES;
+        srcCodecParam->channels       = fawHeader.channels();
+        srcCodecParam->channel_layout = av_get_default_channel_layout(fawHeader.channels());
+        srcCodecParam->sample_rate    = fawHeader.sampleRate;
+        const auto asc = fawHeader.audioSpecificConfig();
+        SetExtraData(srcCodecParam, asc.data(), (uint32_t)asc.size());
     } else {
         avcodec_parameters_copy(srcCodecParam, pInputAudio->src.pStream->codecpar);
     }
@@ -1153,7 +1233,9 @@ RGY_ERR RGYOutputAvcodec::InitAudio(AVMuxAudio *pMuxAudio, AVOutputStreamPrm *pI
     pMuxAudio->pStreamOut->time_base = av_make_q(1, pMuxAudio->pStreamOut->codecpar->sample_rate);
     if (m_Mux.video.pStreamOut) {
         pMuxAudio->pStreamOut->start_time = (int)av_rescale_q(pInputAudio->src.nDelayOfStream, pMuxAudio->pStreamIn->time_base, pMuxAudio->pStreamOut->time_base);
-        pMuxAudio->nDelaySamplesOfAudio = (int)pMuxAudio->pStreamOut->start_time;
+        //nDelaySamplesOfAudioはnOutputSamplesに加算するので、同じサンプリング周波数基準とする
+        //FAWでは出力ストリームのtimebase(AACのサンプリング周波数)と入力のPCMのサンプリング周波数が異なる場合がある
+        pMuxAudio->nDelaySamplesOfAudio = (int)av_rescale_q(pInputAudio->src.nDelayOfStream, pMuxAudio->pStreamIn->time_base, muxAudioSamplerate(pMuxAudio));
         pMuxAudio->nLastPtsOut = pMuxAudio->pStreamOut->start_time;
 
         AddMessage(RGY_LOG_DEBUG, _T("delay      %6d (timabase %d/%d)\n"), pInputAudio->src.nDelayOfStream, pMuxAudio->pStreamIn->time_base.num, pMuxAudio->pStreamIn->time_base.den);
@@ -1470,6 +1552,13 @@ RGY_ERR RGYOutputAvcodec::Init(const TCHAR *strFileName, const VideoInfo *pVideo
 
     m_Mux.trim = prm->trimList;
 
+    if (pVideoOutputInfo && prm->nFmp4FragMs >= 0) {
+        RGY_ERR sts = InitFragment(prm);
+        if (sts != RGY_ERR_NONE) {
+            return sts;
+        }
+    }
+
     if (pVideoOutputInfo) {
         RGY_ERR sts = InitVideo(pVideoOutputInfo, prm);
         if (sts != RGY_ERR_NONE) {
@@ -1592,6 +1681,7 @@ RGY_ERR RGYOutputAvcodec::Init(const TCHAR *strFileName, const VideoInfo *pVideo
         m_Mux.thread.qVideobitstream.init(4096, (std::max)(64, (m_Mux.video.nFPS.den) ? m_Mux.video.nFPS.num * 4 / m_Mux.video.nFPS.den : 0));
         m_Mux.thread.qVideobitstreamFreeI.init(256);
         m_Mux.thread.qVideobitstreamFreePB.init(3840);
+        m_Mux.thread.bVideoBufRecycle = true;
         m_Mux.thread.heEventPktAddedOutput = CreateEvent(NULL, TRUE, FALSE, NULL);
         m_Mux.thread.heEventClosingOutput  = CreateEvent(NULL, TRUE, FALSE, NULL);
         m_Mux.thread.thOutput = std::thread(&RGYOutputAvcodec::WriteThreadFunc, this);
@@ -1699,8 +1789,17 @@ RGY_ERR RGYOutputAvcodec::WriteFileHeader(const RGYBitstream *pBitstream) {
     //これはmetadataではなく、avformat_write_headerのoptionsに渡す
     //この差ははっきり言って謎
     if (m_Mux.video.pStreamOut) {
-        if (   0 == strcmp(m_Mux.format.pFormatCtx->oformat->name, "mp4")
-            || 0 == strcmp(m_Mux.format.pFormatCtx->oformat->name, "mov")) {
+        if (m_Mux.fragment.bEnable) {
+            //default-base-is-moofを使用するので、iso5とする
+            av_dict_set(&m_Mux.format.pHeaderOptions, "brand", "iso5", 0);
+            AddMessage(RGY_LOG_DEBUG, _T("set format brand \"iso5\".\n"));
+
+            //空のmoovを先頭に書き出し、fragmentはWriteFragmentで指定したところで区切る
+            //moofを基準としたオフセットにして、各fragmentを単独で扱えるようにする
+            av_dict_set(&m_Mux.format.pHeaderOptions, "movflags", "frag_custom+empty_moov+default_base_moof", 0);
+            AddMessage(RGY_LOG_DEBUG, _T("set frag_custom+empty_moov+default_base_moof.\n"));
+        } else if (   0 == strcmp(m_Mux.format.pFormatCtx->oformat->name, "mp4")
+                   || 0 == strcmp(m_Mux.format.pFormatCtx->oformat->name, "mov")) {
             av_dict_set(&m_Mux.format.pHeaderOptions, "brand", "mp42", 0);
             AddMessage(RGY_LOG_DEBUG, _T("set format brand \"mp42\".\n"));
 
@@ -1727,6 +1826,22 @@ RGY_ERR RGYOutputAvcodec::WriteFileHeader(const RGYBitstream *pBitstream) {
     if (m_Mux.format.pHeaderOptions) {
         av_dict_free(&m_Mux.format.pHeaderOptions);
     }
+    if (m_Mux.fragment.bEnable) {
+        //ftyp+moovをすぐにファイルに反映する
+        avio_flush(m_Mux.format.pFormatCtx->pb);
+#if USE_CUSTOM_IO
+        if (m_Mux.format.fpOutput) {
+            fflush(m_Mux.format.fpOutput);
+        }
+#endif //USE_CUSTOM_IO
+        //セグメントファイルに分割する場合は、出力ファイルは初期化セグメントとなり、以降は最初のセグメントに書き出す
+        if (m_Mux.fragment.nSegmentMs > 0) {
+            RGY_ERR sts = OpenNextSegment();
+            if (sts != RGY_ERR_NONE) {
+                return sts;
+            }
+        }
+    }
 
     av_dump_format(m_Mux.format.pFormatCtx, 0, m_Mux.format.pFormatCtx->filename, 1);
 
@@ -1746,6 +1861,203 @@ RGY_ERR RGYOutputAvcodec::WriteFileHeader(const RGYBitstream *pBitstream) {
     return RGY_ERR_NONE;
 }
 
+RGY_ERR RGYOutputAvcodec::InitFragment(const AvcodecWriterPrm *prm) {
+    if (   0 != strcmp(m_Mux.format.pFormatCtx->oformat->name, "mp4")
+        && 0 != strcmp(m_Mux.format.pFormatCtx->oformat->name, "mov")) {
+        AddMessage(RGY_LOG_ERROR, _T("fragmented mp4 output is only supported with mp4/mov format, but output format is %s.\n"),
+            char_to_tstring(m_Mux.format.pFormatCtx->oformat->name).c_str());
+        return RGY_ERR_INVALID_FORMAT;
+    }
+    auto& frag = m_Mux.fragment;
+    frag.bEnable = true;
+    frag.nFragMs = prm->nFmp4FragMs;
+    frag.nSegmentMs = (int64_t)(prm->dFmp4SegmentSec * 1000.0 + 0.5);
+    frag.nFragStartDts = AV_NOPTS_VALUE;
+    frag.nSegStartDts = AV_NOPTS_VALUE;
+    frag.nLastDtsEnd = AV_NOPTS_VALUE;
+    if (frag.nSegmentMs > 0) {
+#if USE_CUSTOM_IO
+        if (m_Mux.format.fpOutput == nullptr) {
+#endif //USE_CUSTOM_IO
+            AddMessage(RGY_LOG_ERROR, _T("splitting fragmented mp4 into segment files is not supported for pipe/protocol output.\n"));
+            return RGY_ERR_UNSUPPORTED;
+#if USE_CUSTOM_IO
+        }
+#endif //USE_CUSTOM_IO
+        //出力ファイルを初期化セグメントとし、同じ場所に"<出力ファイル名>_<連番>.m4s"と"<出力ファイル名>.m3u8"を作成する
+        frag.sSegmentBase = PathRemoveExtensionS(m_Mux.format.pFilename);
+        frag.sPlaylist = frag.sSegmentBase + _T(".m3u8");
+        frag.sInitSegmentUri = tchar_to_string(PathFindFileName(m_Mux.format.pFilename), CP_UTF8);
+        frag.sSegmentUri = tchar_to_string(PathFindFileName(frag.sSegmentBase.c_str()), CP_UTF8);
+        AddMessage(RGY_LOG_DEBUG, _T("fragmented mp4: segment %.3f sec, playlist \"%s\".\n"), frag.nSegmentMs * 0.001, frag.sPlaylist.c_str());
+    }
+    if (frag.nFragMs > 0) {
+        AddMessage(RGY_LOG_DEBUG, _T("fragmented mp4: fragment %d ms.\n"), frag.nFragMs);
+    } else {
+        AddMessage(RGY_LOG_DEBUG, _T("fragmented mp4: fragment at every IDR.\n"));
+    }
+    return RGY_ERR_NONE;
+}
+
+RGY_ERR RGYOutputAvcodec::WriteFragment(int64_t dts, int64_t duration, bool idr) {
+    auto& frag = m_Mux.fragment;
+    const AVRational streamTimebase = m_Mux.video.pStreamOut->codec->pkt_timebase;
+    RGY_ERR sts = RGY_ERR_NONE;
+    if (frag.nFragStartDts == AV_NOPTS_VALUE) {
+        frag.nFragStartDts = dts;
+        frag.nSegStartDts = dts;
+        frag.nFragCount++;
+    } else {
+        const auto elapsedMs = [&](int64_t start) { return av_rescale_q(dts - start, streamTimebase, av_make_q(1, 1000)); };
+        //セグメントはIDRからはじめる
+        const bool cutSegment = idr && frag.nSegmentMs > 0 && elapsedMs(frag.nSegStartDts) >= frag.nSegmentMs;
+        //時間指定の場合は、IDRを待たずに区切る (CMAFのchunk)
+        const bool cutFragment = cutSegment || ((frag.nFragMs > 0) ? elapsedMs(frag.nFragStartDts) >= frag.nFragMs : idr);
+        if (cutFragment) {
+            FlushFragment();
+            frag.nFragStartDts = dts;
+            frag.nFragCount++;
+            if (cutSegment) {
+                frag.segmentDuration.push_back((dts - frag.nSegStartDts) * av_q2d(streamTimebase));
+                frag.nSegStartDts = dts;
+                if (RGY_ERR_NONE != (sts = OpenNextSegment())) {
+                    return sts;
+                }
+                sts = WritePlaylist(false);
+            }
+        }
+    }
+    frag.nLastDtsEnd = dts + duration;
+    return sts;
+}
+
+void RGYOutputAvcodec::FlushFragment() {
+    //interleave待ちの音声等を先に書き出してから、fragmentを閉じる
+    //区切りより後ろの音声/字幕はWriteInterleavedPacketで保持しているので、ここで書き出されるのは区切りより前のパケットのみ
+    m_Mux.format.bStreamError |= 0 > av_interleaved_write_frame(m_Mux.format.pFormatCtx, nullptr);
+    m_Mux.format.bStreamError |= 0 > av_write_frame(m_Mux.format.pFormatCtx, nullptr);
+    //後段ですぐに使用できるよう、バッファにためずにファイルに反映する
+    avio_flush(m_Mux.format.pFormatCtx->pb);
+#if USE_CUSTOM_IO
+    if (m_Mux.format.fpOutput) {
+        fflush(m_Mux.format.fpOutput);
+    }
+#endif //USE_CUSTOM_IO
+}
+
+RGY_ERR RGYOutputAvcodec::OpenNextSegment() {
+#if USE_CUSTOM_IO
+    auto& frag = m_Mux.fragment;
+    if (m_Mux.format.fpOutput) {
+        fflush(m_Mux.format.fpOutput);
+        fclose(m_Mux.format.fpOutput);
+        m_Mux.format.fpOutput = nullptr;
+    }
+    const tstring filename = strsprintf(_T("%s_%05d.m4s"), frag.sSegmentBase.c_str(), frag.nSegmentCount);
+    m_Mux.format.fpOutput = _tfsopen(filename.c_str(), _T("wb"), _SH_DENYWR);
+    if (m_Mux.format.fpOutput == NULL) {
+        errno_t error = errno;
+        AddMessage(RGY_LOG_ERROR, _T("failed to open segment file \"%s\": %s.\n"), filename.c_str(), _tcserror(error));
+        m_Mux.format.bStreamError = true;
+        return RGY_ERR_FILE_OPEN;
+    }
+    if (m_Mux.format.pOutputBuffer) {
+        setvbuf(m_Mux.format.fpOutput, m_Mux.format.pOutputBuffer, _IOFBF, m_Mux.format.nOutputBufferSize);
+    }
+    frag.nSegmentCount++;
+    AddMessage(RGY_LOG_DEBUG, _T("opened segment file \"%s\".\n"), filename.c_str());
+#endif //USE_CUSTOM_IO
+    return RGY_ERR_NONE;
+}
+
+RGY_ERR RGYOutputAvcodec::WritePlaylist(bool bEndList) {
+    const auto& frag = m_Mux.fragment;
+    double maxDuration = frag.nSegmentMs * 0.001;
+    for (const auto duration : frag.segmentDuration) {
+        maxDuration = (std::max)(maxDuration, duration);
+    }
+    std::string playlist;
+    playlist += "#EXTM3U\n";
+    playlist += "#EXT-X-VERSION:7\n";
+    playlist += strsprintf("#EXT-X-TARGETDURATION:%d\n", (int)std::ceil(maxDuration));
+    playlist += "#EXT-X-MEDIA-SEQUENCE:0\n";
+    playlist += "#EXT-X-PLAYLIST-TYPE:EVENT\n";
+    playlist += "#EXT-X-INDEPENDENT-SEGMENTS\n";
+    playlist += strsprintf("#EXT-X-MAP:URI=\"%s\"\n", frag.sInitSegmentUri.c_str());
+    for (int i = 0; i < (int)frag.segmentDuration.size(); i++) {
+        playlist += strsprintf("#EXTINF:%.3f,\n", frag.segmentDuration[i]);
+        playlist += strsprintf("%s_%05d.m4s\n", frag.sSegmentUri.c_str(), i);
+    }
+    if (bEndList) {
+        playlist += "#EXT-X-ENDLIST\n";
+    }
+
+    //読み込み側が書きかけのプレイリストを読まないよう、一時ファイルに書いてから置き換える
+    const tstring tmpFilename = frag.sPlaylist + _T(".tmp");
+    FILE *fp = NULL;
+    if (_tfopen_s(&fp, tmpFilename.c_str(), _T("wb")) || fp == NULL) {
+        AddMessage(RGY_LOG_ERROR, _T("failed to open playlist \"%s\".\n"), tmpFilename.c_str());
+        return RGY_ERR_FILE_OPEN;
+    }
+    fwrite(playlist.c_str(), 1, playlist.length(), fp);
+    fclose(fp);
+    _tremove(frag.sPlaylist.c_str());
+    if (_trename(tmpFilename.c_str(), frag.sPlaylist.c_str())) {
+        AddMessage(RGY_LOG_ERROR, _T("failed to update playlist \"%s\".\n"), frag.sPlaylist.c_str());
+        return RGY_ERR_FILE_OPEN;
+    }
+    return RGY_ERR_NONE;
+}
+
+void RGYOutputAvcodec::CloseFragment() {
+    auto& frag = m_Mux.fragment;
+    WritePendingPackets(true);
+    if (frag.nSegmentMs > 0) {
+        FlushFragment();
+        if (frag.nSegStartDts != AV_NOPTS_VALUE) {
+            frag.segmentDuration.push_back((frag.nLastDtsEnd - frag.nSegStartDts) * av_q2d(m_Mux.video.pStreamOut->codec->pkt_timebase));
+        }
+        WritePlaylist(true);
+        //mfraは各セグメントのオフセットと対応しないので、書き出さずに破棄する
+        frag.bDiscardOutput = true;
+    }
+    //単一ファイルの場合は、av_write_trailerで最後のfragmentとmfraを書き出す
+    AddMessage(RGY_LOG_DEBUG, _T("fragmented mp4: %d fragments, %d segments.\n"), frag.nFragCount, (int)frag.segmentDuration.size());
+}
+
+void RGYOutputAvcodec::WriteInterleavedPacket(AVPacket *pkt) {
+    auto& frag = m_Mux.fragment;
+    //fragmentを区切るとinterleave待ちのパケットはすべて書き出されるので、
+    //書き出し済みの映像(nLastDtsEnd)以降の音声/字幕はここで保持し、映像を書き出してから渡す
+    if (frag.bEnable && m_Mux.video.pStreamOut && pkt->dts != AV_NOPTS_VALUE
+        && (frag.nLastDtsEnd == AV_NOPTS_VALUE
+            || av_compare_ts(pkt->dts, m_Mux.format.pFormatCtx->streams[pkt->stream_index]->time_base, frag.nLastDtsEnd, m_Mux.video.pStreamOut->codec->pkt_timebase) >= 0)) {
+        //字幕の再エンコード時など、pktのデータが参照カウントされていない場合はコピーされる
+        AVPacket pktHold;
+        av_init_packet(&pktHold);
+        m_Mux.format.bStreamError |= 0 > av_packet_ref(&pktHold, pkt);
+        av_packet_unref(pkt);
+        if (!m_Mux.format.bStreamError) {
+            frag.pending.push_back(pktHold);
+        }
+        return;
+    }
+    m_Mux.format.bStreamError |= 0 != av_interleaved_write_frame(m_Mux.format.pFormatCtx, pkt);
+}
+
+void RGYOutputAvcodec::WritePendingPackets(bool bAll) {
+    auto& frag = m_Mux.fragment;
+    //トラックごとにはdts順に並んでいるので、書き出さないパケットがあっても同じトラックの後続はすべて保持される
+    for (auto it = frag.pending.begin(); it != frag.pending.end();) {
+        if (bAll || av_compare_ts(it->dts, m_Mux.format.pFormatCtx->streams[it->stream_index]->time_base, frag.nLastDtsEnd, m_Mux.video.pStreamOut->codec->pkt_timebase) < 0) {
+            m_Mux.format.bStreamError |= 0 != av_interleaved_write_frame(m_Mux.format.pFormatCtx, &(*it));
+            it = frag.pending.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
 int64_t RGYOutputAvcodec::AdjustTimestampTrimmed(int64_t nTimeIn, AVRational timescaleIn, AVRational timescaleOut, bool lastValidFrame) {
     AVRational timescaleFps = av_inv_q(m_Mux.video.nFPS);
     const int vidFrameIdx = (int)av_rescale_q(nTimeIn, timescaleIn, timescaleFps);
@@ -1879,26 +2191,46 @@ RGY_ERR RGYOutputAvcodec::WriteNextFrame(RGYBitstream *pBitstream) {
         bool bFrameP = (pBitstream->frametype() & RGY_FRAMETYPE_P) != 0;
         //IフレームかPBフレームかでサイズが大きく違うため、空きのmfxBistreamは異なるキューで管理する
         auto& qVideoQueueFree = (bFrameI) ? m_Mux.thread.qVideobitstreamFreeI : m_Mux.thread.qVideobitstreamFreePB;
-        //空いているmfxBistreamを取り出す
-        if (!qVideoQueueFree.front_copy_and_pop_no_lock(&copyStream) || copyStream.bufsize() < pBitstream->size()) {
-            //空いているmfxBistreamがない、あるいはそのバッファサイズが小さい場合は、領域を取り直す
-            const uint32_t allocate_bytes = pBitstream->size() * ((bFrameI | bFrameP) ? 2 : 8);
-            if (RGY_ERR_NONE != copyStream.init(allocate_bytes)) {
-                AddMessage(RGY_LOG_ERROR, _T("Failed to allocate memory for video bitstream output buffer, %sB.\n"), allocate_bytes);
-                m_Mux.format.bStreamError = true;
-                return RGY_ERR_MEMORY_ALLOC;
-            }
-        }
-        //必要な情報をコピー
-        copyStream.setDataflag(pBitstream->dataflag());
-        copyStream.setPts(pBitstream->pts());
-        copyStream.setDts(pBitstream->dts());
-        copyStream.setDuration(pBitstream->duration());
-        copyStream.setFrametype(pBitstream->frametype());
-        copyStream.setSize(pBitstream->size());
-        copyStream.setAvgQP(pBitstream->avgQP());
-        copyStream.setOffset(0);
-        memcpy(copyStream.bufptr(), pBitstream->data(), copyStream.size());
+        //出力スレッドではバッファをそのままAVPacketに渡すので、末尾にAV_INPUT_BUFFER_PADDING_SIZEの余白が必要
+        if ((pBitstream->dataflag() & RGY_BITSTREAM_FLAG_TRANSFERABLE)
+            && pBitstream->bufsize() >= pBitstream->offset() + pBitstream->size() + AV_INPUT_BUFFER_PADDING_SIZE) {
+            //呼び出し元のバッファをコピーせずにそのまま受け取り、代わりに空いているバッファを渡す
+            copyStream = *pBitstream;
+            copyStream.setDataflag(pBitstream->dataflag() & ~RGY_BITSTREAM_FLAG_TRANSFERABLE);
+            RGYBitstream freeStream = RGYBitstreamInit();
+            qVideoQueueFree.front_copy_and_pop_no_lock(&freeStream);
+            freeStream.setDataflag(0);
+            *pBitstream = freeStream;
+            m_nVideoBufMove++;
+        } else {
+            //HDR10+のSEIを挿入する場合は、先頭側にも余白を確保しておく
+            const uint32_t headroom = (m_hdr10plus) ? RGY_BITSTREAM_HEADROOM : 0;
+            //空いているmfxBistreamを取り出す
+            if (!qVideoQueueFree.front_copy_and_pop_no_lock(&copyStream) || copyStream.bufsize() < headroom + pBitstream->size() + AV_INPUT_BUFFER_PADDING_SIZE) {
+                //空いているmfxBistreamがない、あるいはそのバッファサイズが小さい場合は、領域を取り直す
+                const uint32_t allocate_bytes = headroom + pBitstream->size() * ((bFrameI | bFrameP) ? 2 : 8) + AV_INPUT_BUFFER_PADDING_SIZE;
+                if (RGY_ERR_NONE != copyStream.init(allocate_bytes)) {
+                    AddMessage(RGY_LOG_ERROR, _T("Failed to allocate memory for video bitstream output buffer, %sB.\n"), allocate_bytes);
+                    m_Mux.format.bStreamError = true;
+                    return RGY_ERR_MEMORY_ALLOC;
+                }
+                m_nVideoBufAlloc++;
+            }
+            //必要な情報をコピー
+            copyStream.setDataflag(pBitstream->dataflag());
+            copyStream.setPts(pBitstream->pts());
+            copyStream.setDts(pBitstream->dts());
+            copyStream.setDuration(pBitstream->duration());
+            copyStream.setFrametype(pBitstream->frametype());
+            copyStream.setFrameIdx(pBitstream->frameIdx());
+            copyStream.setSize(pBitstream->size());
+            copyStream.setAvgQP(pBitstream->avgQP());
+            copyStream.setOffset(headroom);
+            memcpy(copyStream.data(), pBitstream->data(), copyStream.size());
+            m_nVideoBufCopy++;
+        }
+        memset(copyStream.data() + copyStream.size(), 0, AV_INPUT_BUFFER_PADDING_SIZE);
+        UpdateVideoBufferInfo();
         //キューに押し込む
         if (!m_Mux.thread.qVideobitstream.push(copyStream)) {
             AddMessage(RGY_LOG_ERROR, _T("Failed to allocate memory for video bitstream queue.\n"));
@@ -2029,9 +2361,24 @@ RGY_ERR RGYOutputAvcodec::WriteNextFrameInternal(RGYBitstream *pBitstream, int64
 
     AVPacket pkt = { 0 };
     av_init_packet(&pkt);
-    av_new_packet(&pkt, pBitstream->size());
-    memcpy(pkt.data, pBitstream->data(), pBitstream->size());
-    pkt.size = pBitstream->size();
+#if ENABLE_AVCODEC_OUT_THREAD
+    //出力スレッドに渡されたバッファは出力スレッドが所有しているので、コピーせずにAVPacketに渡せる
+    const bool bTransfer = m_Mux.thread.thOutput.joinable();
+#else
+    const bool bTransfer = false;
+#endif
+    if (m_bsAnalyzer) {
+        CheckVideoBitstream(pBitstream);
+    }
+    //HDR10+のSEIは、AVPacketへの格納時に挿入する
+    if (m_hdr10plus) {
+        m_hdr10plus->getNal(pBitstream->frameIdx(), m_hdr10plusNal);
+    }
+    RGY_ERR err = SetVideoPacketData(&pkt, pBitstream, bTransfer, m_hdr10plusNal);
+    if (err != RGY_ERR_NONE) {
+        m_Mux.format.bStreamError = true;
+        return err;
+    }
 
     const AVRational fpsTimebase = av_inv_q(m_Mux.video.nFPS);
     const AVRational streamTimebase = m_Mux.video.pStreamOut->codec->pkt_timebase;
@@ -2056,7 +2403,19 @@ RGY_ERR RGYOutputAvcodec::WriteNextFrameInternal(RGYBitstream *pBitstream, int64
     }
     const auto pts = pkt.pts, dts = pkt.dts, duration = pkt.duration;
     *pWrittenDts = av_rescale_q(pkt.dts, streamTimebase, QUEUE_DTS_TIMEBASE);
+    if (m_Mux.fragment.bEnable) {
+        err = WriteFragment(dts, duration, (pBitstream->frametype() & RGY_FRAMETYPE_IDR) != 0);
+        if (err != RGY_ERR_NONE) {
+            av_packet_unref(&pkt);
+            m_Mux.format.bStreamError = true;
+            return err;
+        }
+    }
     m_Mux.format.bStreamError |= 0 != av_interleaved_write_frame(m_Mux.format.pFormatCtx, &pkt);
+    if (m_Mux.fragment.bEnable) {
+        //この映像までの音声/字幕を書き出す
+        WritePendingPackets(false);
+    }
     
     if (m_Mux.video.fpTsLogFile) {
         const uint32_t frameType = pBitstream->frametype();
@@ -2065,20 +2424,135 @@ RGY_ERR RGYOutputAvcodec::WriteNextFrameInternal(RGYBitstream *pBitstream, int64
         _ftprintf(m_Mux.video.fpTsLogFile, _T("%s, %20lld, %20lld, %20lld, %20lld, %d, %7d\n"), pFrameTypeStr, (lls)pBitstream->pts(), (lls)pBitstream->dts(), (lls)pts, (lls)dts, (int)duration, pBitstream->size());
     }
     m_pEncSatusInfo->SetOutputData(pBitstream->frametype(), pBitstream->size(), pBitstream->avgQP());
+    //バッファをAVPacketに渡した場合は、AVPacketの解放時にReleaseVideoBufferで回収される
+    if (!bTransfer) {
+        pBitstream->setSize(0);
+        pBitstream->setOffset(0);
+    }
+    m_Mux.format.bFileHeaderWritten = true;
+    return (m_Mux.format.bStreamError) ? RGY_ERR_UNKNOWN : RGY_ERR_NONE;
+}
+
+void RGYOutputAvcodec::CheckVideoBitstream(const RGYBitstream *pBitstream) {
+    RGYBitstreamAUInfo info;
+    const auto err = m_bsAnalyzer->analyze(pBitstream->data(), (uint32_t)pBitstream->size(), info);
+    if (err != RGY_ERR_NONE || info.sliceSize.size() == 0) {
+        AddMessage(RGY_LOG_WARN, _T("Failed to parse video bitstream (pts %lld): %s.\n"), (lls)pBitstream->pts(), get_err_mes(err));
+        return;
+    }
+    AddMessage(RGY_LOG_TRACE, _T("video frame: pts %lld, %s, poc %d, qp %d, ref %d/%d, %d slices, %u bytes.\n"),
+        (lls)pBitstream->pts(), rgy_frametype_str(info.frametype), info.poc, info.qp, info.refCount[0], info.refCount[1], (int)info.sliceSize.size(), info.bytes);
+    //キーフレームのフラグは、pBitstream->frametype()から設定される
+    const bool keyFlag = (pBitstream->frametype() & (RGY_FRAMETYPE_IDR | RGY_FRAMETYPE_I)) != 0;
+    const bool keyBitstream = (info.frametype & (RGY_FRAMETYPE_IDR | RGY_FRAMETYPE_I)) != 0;
+    if (keyFlag != keyBitstream) {
+        //キーフレームとしないIフレームはありうるが、その逆は問題となる
+        AddMessage((keyFlag) ? RGY_LOG_WARN : RGY_LOG_DEBUG, _T("frame type mismatch (pts %lld): %s (flag), %s (bitstream).\n"),
+            (lls)pBitstream->pts(), rgy_frametype_str(pBitstream->frametype()), rgy_frametype_str(info.frametype));
+    }
+}
+
+static_assert(RGY_BITSTREAM_PADDING >= AV_INPUT_BUFFER_PADDING_SIZE, "RGY_BITSTREAM_PADDING should be larger than AV_INPUT_BUFFER_PADDING_SIZE.");
+
+//AVPacketに渡した映像のバッファの情報
+struct AVMuxVideoBuffer {
+    RGYOutputAvcodec *pWriter;
+    RGYBitstream bitstream;
+};
+
+RGY_ERR RGYOutputAvcodec::SetVideoPacketData(AVPacket *pkt, RGYBitstream *pBitstream, bool bTransfer, const vector<uint8_t>& sei) {
+    const uint32_t seiSize = (uint32_t)sei.size();
+    const uint32_t seiOffset = (seiSize > 0) ? RGYHDR10Plus::seiInsertOffset(pBitstream->data(), pBitstream->size()) : 0;
+    if (bTransfer) {
+        if (seiSize > 0) {
+            if (pBitstream->offset() >= seiSize) {
+                //先頭側の余白を使い、SEIより前に来るNALのみを前にずらす (スライスのデータは移動しない)
+                pBitstream->setOffset(pBitstream->offset() - seiSize);
+                memmove(pBitstream->data(), pBitstream->data() + seiSize, seiOffset);
+            } else {
+                //先頭側に余白がない場合は、後ろのデータをずらす
+                if (pBitstream->bufsize() < pBitstream->offset() + pBitstream->size() + seiSize + AV_INPUT_BUFFER_PADDING_SIZE) {
+                    if (RGY_ERR_NONE != pBitstream->changeSize(pBitstream->size() + seiSize + AV_INPUT_BUFFER_PADDING_SIZE)) {
+                        AddMessage(RGY_LOG_ERROR, _T("Failed to allocate memory for video packet.\n"));
+                        return RGY_ERR_MEMORY_ALLOC;
+                    }
+                    m_nVideoBufAlloc++;
+                }
+                memmove(pBitstream->data() + seiOffset + seiSize, pBitstream->data() + seiOffset, pBitstream->size() - seiOffset);
+                m_nVideoBufCopy++;
+                UpdateVideoBufferInfo();
+            }
+            memcpy(pBitstream->data() + seiOffset, sei.data(), seiSize);
+            pBitstream->setSize(pBitstream->size() + seiSize);
+        }
+        if (pBitstream->bufsize() < pBitstream->offset() + pBitstream->size() + AV_INPUT_BUFFER_PADDING_SIZE) {
+            //bitstream filter等でサイズが変わり余白がなくなった場合
+            pBitstream->changeSize(pBitstream->size() + AV_INPUT_BUFFER_PADDING_SIZE);
+            m_nVideoBufAlloc++;
+            m_nVideoBufCopy++;
+            UpdateVideoBufferInfo();
+        }
+        memset(pBitstream->data() + pBitstream->size(), 0, AV_INPUT_BUFFER_PADDING_SIZE);
+        auto pBuffer = new AVMuxVideoBuffer();
+        pBuffer->pWriter = this;
+        pBuffer->bitstream = *pBitstream;
+        pkt->buf = av_buffer_create(pBitstream->bufptr(), (int)pBitstream->bufsize(), ReleaseVideoBuffer, pBuffer, 0);
+        if (pkt->buf == nullptr) {
+            delete pBuffer;
+            AddMessage(RGY_LOG_ERROR, _T("Failed to allocate memory for video packet.\n"));
+            return RGY_ERR_MEMORY_ALLOC;
+        }
+        pkt->data = pBitstream->data();
+        pkt->size = pBitstream->size();
+        return RGY_ERR_NONE;
+    }
+    if (av_new_packet(pkt, pBitstream->size() + seiSize) < 0) {
+        AddMessage(RGY_LOG_ERROR, _T("Failed to allocate memory for video packet.\n"));
+        return RGY_ERR_MEMORY_ALLOC;
+    }
+    if (seiSize > 0) {
+        //AVPacketへのコピーの際に、SEIを挟み込む
+        memcpy(pkt->data, pBitstream->data(), seiOffset);
+        memcpy(pkt->data + seiOffset, sei.data(), seiSize);
+        memcpy(pkt->data + seiOffset + seiSize, pBitstream->data() + seiOffset, pBitstream->size() - seiOffset);
+    } else {
+        memcpy(pkt->data, pBitstream->data(), pBitstream->size());
+    }
+    m_nVideoBufAlloc++;
+    m_nVideoBufCopy++;
+    UpdateVideoBufferInfo();
+    return RGY_ERR_NONE;
+}
+
+void RGYOutputAvcodec::ReleaseVideoBuffer(void *opaque, uint8_t *data) {
+    UNREFERENCED_PARAMETER(data);
+    auto pBuffer = (AVMuxVideoBuffer *)opaque;
+    pBuffer->pWriter->RecycleVideoBuffer(&pBuffer->bitstream);
+    delete pBuffer;
+}
+
+void RGYOutputAvcodec::RecycleVideoBuffer(RGYBitstream *pBitstream) {
 #if ENABLE_AVCODEC_OUT_THREAD
-    if (m_Mux.thread.thOutput.joinable()) {
+    //AVPacketの解放は出力スレッドで行われるので、空きキューへの追加は出力スレッドのみとなる
+    if (m_Mux.thread.bVideoBufRecycle) {
         //確保したメモリ領域を使いまわすためにスタックに格納
+        pBitstream->setSize(0);
+        pBitstream->setOffset(0);
         auto& qVideoQueueFree = (pBitstream->frametype() & (RGY_FRAMETYPE_IDR | RGY_FRAMETYPE_I)) ? m_Mux.thread.qVideobitstreamFreeI : m_Mux.thread.qVideobitstreamFreePB;
         qVideoQueueFree.push(*pBitstream);
-    } else {
+        return;
+    }
 #endif
-        pBitstream->setSize(0);
-        pBitstream->setOffset(0);
+    pBitstream->clear();
+}
+
+void RGYOutputAvcodec::UpdateVideoBufferInfo() {
 #if ENABLE_AVCODEC_OUT_THREAD
+    if (m_Mux.thread.pQueueInfo) {
+        m_Mux.thread.pQueueInfo->alloc_vid_out = (size_t)m_nVideoBufAlloc;
+        m_Mux.thread.pQueueInfo->copy_vid_out  = (size_t)m_nVideoBufCopy;
     }
 #endif
-    m_Mux.format.bFileHeaderWritten = true;
-    return (m_Mux.format.bStreamError) ? RGY_ERR_UNKNOWN : RGY_ERR_NONE;
 }
 
 RGY_ERR RGYOutputAvcodec::WriteNextFrame(RGYFrame *pSurface) {
@@ -2204,7 +2678,7 @@ void RGYOutputAvcodec::WriteNextPacketProcessed(AVMuxAudio *pMuxAudio, AVPacket
         AddMessage(RGY_LOG_DEBUG, _T("Flushed audio buffer.\n"));
         return;
     }
-    AVRational samplerate = { 1, (pMuxAudio->pOutCodecEncodeCtx) ? pMuxAudio->pOutCodecEncodeCtx->sample_rate : pMuxAudio->pStreamIn->codecpar->sample_rate };
+    const AVRational samplerate = muxAudioSamplerate(pMuxAudio);
     if (samples) {
         //durationについて、sample数から出力ストリームのtimebaseに変更する
         pkt->stream_index = pMuxAudio->pStreamOut->index;
@@ -2216,7 +2690,7 @@ void RGYOutputAvcodec::WriteNextPacketProcessed(AVMuxAudio *pMuxAudio, AVPacket
             pkt->duration = (int)(pkt->pts - pMuxAudio->nLastPtsOut);
         pMuxAudio->nLastPtsOut = pkt->pts;
         *pWrittenDts = av_rescale_q(pkt->dts, pMuxAudio->pStreamOut->time_base, QUEUE_DTS_TIMEBASE);
-        m_Mux.format.bStreamError |= 0 != av_interleaved_write_frame(m_Mux.format.pFormatCtx, pkt);
+        WriteInterleavedPacket(pkt);
         pMuxAudio->nOutputSamples += samples;
     } else {
         //av_interleaved_write_frameに渡ったパケットは開放する必要がないが、
@@ -2599,7 +3073,7 @@ RGY_ERR RGYOutputAvcodec::SubtitleTranscode(const AVMuxSub *pMuxSub, AVPacket *p
             pktOut.pts += 90 * ((i == 0) ? sub.start_display_time : sub.end_display_time);
         }
         pktOut.dts = pktOut.pts;
-        m_Mux.format.bStreamError |= 0 != av_interleaved_write_frame(m_Mux.format.pFormatCtx, &pktOut);
+        WriteInterleavedPacket(&pktOut);
     }
     return (m_Mux.format.bStreamError) ? RGY_ERR_UNKNOWN : RGY_ERR_NONE;
 }
@@ -2624,7 +3098,7 @@ RGY_ERR RGYOutputAvcodec::SubtitleWritePacket(AVPacket *pkt) {
         pkt->duration = (int)av_rescale_q(pkt->duration, pMuxSub->pStreamIn->time_base, pMuxSub->pStreamOut->time_base);
         pkt->stream_index = pMuxSub->pStreamOut->index;
         pkt->pos = -1;
-        m_Mux.format.bStreamError |= 0 != av_interleaved_write_frame(m_Mux.format.pFormatCtx, pkt);
+        WriteInterleavedPacket(pkt);
     }
     return (m_Mux.format.bStreamError) ? RGY_ERR_UNKNOWN : RGY_ERR_NONE;
 }
@@ -2779,7 +3253,7 @@ RGY_ERR RGYOutputAvcodec::WriteNextPacketAudio(AVPktMuxData *pktData) {
             }
             //先頭でエラーが出た場合は音声のDelayを増やすことで同期を保つ
             if (pMuxAudio->nPacketWritten == 0) {
-                pMuxAudio->nDelaySamplesOfAudio += nSamples;
+                pMuxAudio->nDelaySamplesOfAudio += (int)av_rescale_q(nSamples, samplerate, muxAudioSamplerate(pMuxAudio));
                 return (m_Mux.format.bStreamError) ? RGY_ERR_UNKNOWN : RGY_ERR_NONE;
             }
             //音声エンコードしない場合はどうしようもないので終了
@@ -2803,7 +3277,32 @@ RGY_ERR RGYOutputAvcodec::WriteNextPacketAudio(AVPktMuxData *pktData) {
         }
 #endif //#if ENABLE_AVCODEC_AUDPROCESS_THREAD
     };
-    if (!pMuxAudio->pOutCodecDecodeCtx) {
+    if (pMuxAudio->pFAWDecoder) {
+        //FAWのPCMからADTSフレームを取り出し、ヘッダを除いてそのまま書き出す
+        vector<vector<uint8_t>> frames;
+        auto sts = pMuxAudio->pFAWDecoder->decode(frames, pktData->pkt.data, pktData->pkt.size);
+        av_packet_unref(&pktData->pkt);
+        if (sts != RGY_ERR_NONE) {
+            AddMessage(RGY_LOG_ERROR, _T("failed to find FAW data in audio track %d.\n"), pMuxAudio->nInTrackId);
+            m_Mux.format.bStreamError = true;
+            return sts;
+        }
+        for (const auto& frame : frames) {
+            RGYAACHeader header;
+            header.parse(frame.data(), frame.size());
+            AVPktMuxData pktDataFrame = *pktData;
+            av_init_packet(&pktDataFrame.pkt);
+            if (0 > av_new_packet(&pktDataFrame.pkt, (int)frame.size() - header.headerLength)) {
+                AddMessage(RGY_LOG_ERROR, _T("failed to allocate memory for audio packet.\n"));
+                m_Mux.format.bStreamError = true;
+                return RGY_ERR_NULL_PTR;
+            }
+            memcpy(pktDataFrame.pkt.data, frame.data() + header.headerLength, frame.size() - header.headerLength);
+            //sample数は入力のサンプリング周波数基準で渡す
+            pktDataFrame.samples = (int)av_rescale(header.samples(), samplerate.den, header.sampleRate);
+            writeOrSetNextPacketAudioProcessed(&pktDataFrame);
+        }
+    } else if (!pMuxAudio->pOutCodecDecodeCtx) {
         pktData->samples = (int)av_rescale_q(pktData->pkt.duration, pMuxAudio->pStreamIn->time_base, samplerate);
         // 1/1000 timebaseは信じるに値しないので、frame_sizeがあればその値を使用する
         if (0 == av_cmp_q(pMuxAudio->pStreamIn->time_base, { 1, 1000 })
@@ -3206,6 +3705,20 @@ void RGYOutputAvcodec::WaitFin() {
     CloseThread();
 }
 
+void RGYOutputAvcodec::GetVideoBufferStats(int64_t *alloc, int64_t *copy, int64_t *move) const {
+    if (alloc) *alloc = m_nVideoBufAlloc.load();
+    if (copy)  *copy  = m_nVideoBufCopy.load();
+    if (move)  *move  = m_nVideoBufMove.load();
+}
+
+bool RGYOutputAvcodec::outputThreadRunning() const {
+#if ENABLE_AVCODEC_OUT_THREAD
+    return m_Mux.thread.thOutput.joinable();
+#else
+    return false;
+#endif
+}
+
 HANDLE RGYOutputAvcodec::getThreadHandleOutput() {
 #if ENABLE_AVCODEC_OUT_THREAD
     return (HANDLE)m_Mux.thread.thOutput.native_handle();
@@ -3232,12 +3745,25 @@ HANDLE RGYOutputAvcodec::getThreadHandleAudEncode() {
 
 #if USE_CUSTOM_IO
 int RGYOutputAvcodec::readPacket(uint8_t *buf, int buf_size) {
+    if (m_Mux.format.fpOutput == nullptr) {
+        return AVERROR(EIO);
+    }
     return (int)fread(buf, 1, buf_size, m_Mux.format.fpOutput);
 }
 int RGYOutputAvcodec::writePacket(uint8_t *buf, int buf_size) {
+    if (m_Mux.fragment.bDiscardOutput) {
+        return buf_size;
+    }
+    //セグメントファイルを開けなかった場合など
+    if (m_Mux.format.fpOutput == nullptr) {
+        return AVERROR(EIO);
+    }
     return (int)fwrite(buf, 1, buf_size, m_Mux.format.fpOutput);
 }
 int64_t RGYOutputAvcodec::seek(int64_t offset, int whence) {
+    if (m_Mux.format.fpOutput == nullptr) {
+        return AVERROR(EIO);
+    }
     return _fseeki64(m_Mux.format.fpOutput, offset, whence);
 }
 #endif //USE_CUSTOM_IO
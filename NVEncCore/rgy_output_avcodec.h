@@ -35,9 +35,12 @@
 #if ENABLE_AVSW_READER
 #include <thread>
 #include <atomic>
+#include <deque>
 #include <cstdint>
 #include "rgy_avutil.h"
 #include "rgy_bitstream.h"
+#include "rgy_bitstream_analyzer.h"
+#include "rgy_faw.h"
 #include "rgy_input_avcodec.h"
 #include "rgy_output.h"
 #include "rgy_perf_monitor.h"
@@ -125,7 +128,7 @@ typedef struct AVMuxAudio {
     int                   nInSubStream;         //ソースファイルの入力サブストリーム番号
     const AVStream       *pStreamIn;            //入力音声のストリーム
     int                   nStreamIndexIn;       //入力音声のStreamのindex
-    int                   nDelaySamplesOfAudio; //入力音声の遅延 (pkt_timebase基準)
+    int                   nDelaySamplesOfAudio; //入力音声の遅延 (nOutputSamplesと同じくmuxAudioSamplerate基準)
     AVStream             *pStreamOut;           //出力ファイルの音声ストリーム
     int                   nPacketWritten;       //出力したパケットの数
 
@@ -169,6 +172,7 @@ typedef struct AVMuxAudio {
     //AACの変換用
     AVBSFContext         *pAACBsfc;             //必要なら使用するbitstreamfilter
     int                   nAACBsfErrorFromStart; //開始直後からのbitstream filter errorの数
+    RGYFAWDecoder        *pFAWDecoder;          //FAWからAACを取り出す場合に使用
 
     int                   nOutputSamples;       //出力音声の出力済みsample数
     int64_t               nLastPtsIn;           //入力音声の前パケットのpts
@@ -212,9 +216,29 @@ enum {
     AUD_QUEUE_OUT     = 2,
 };
 
+//fragmented mp4の出力の状態
+typedef struct AVMuxFragment {
+    bool                  bEnable;              //fragmented mp4で出力する
+    int                   nFragMs;              //fragmentの長さ (ms, 0でIDRごと)
+    int64_t               nSegmentMs;           //セグメントファイルの長さ (ms, 0で分割しない)
+    int64_t               nFragStartDts;        //現在のfragmentの先頭のdts (映像のpkt_timebase基準)
+    int64_t               nSegStartDts;         //現在のセグメントの先頭のdts (映像のpkt_timebase基準)
+    int64_t               nLastDtsEnd;          //最後に書き出した映像のdts+duration (映像のpkt_timebase基準)
+    int                   nFragCount;           //書き出したfragmentの数
+    int                   nSegmentCount;        //開いたセグメントファイルの数
+    tstring               sSegmentBase;         //セグメントファイル名 (連番と拡張子を除く)
+    tstring               sPlaylist;            //プレイリストのファイル名
+    std::string           sInitSegmentUri;      //プレイリストに記載する初期化セグメント(ftyp+moov)のファイル名
+    std::string           sSegmentUri;          //プレイリストに記載するセグメントファイル名 (連番と拡張子を除く)
+    vector<double>        segmentDuration;      //書き出し済みのセグメントの長さ (秒)
+    bool                  bDiscardOutput;       //出力を破棄する (セグメント分割時のmfra)
+    std::deque<AVPacket>  pending;              //書き出し済みの映像より後ろのため、次の映像の書き出しまで保持している音声/字幕パケット
+} AVMuxFragment;
+
 #if ENABLE_AVCODEC_OUT_THREAD
 typedef struct AVMuxThread {
     bool                           bEnableOutputThread;       //出力スレッドを使用する
+    bool                           bVideoBufRecycle;          //AVPacketから解放された映像のバッファを空きキューに戻す (出力スレッドの実行中のみ)
     bool                           bEnableAudProcessThread;   //音声処理スレッドを使用する
     bool                           bEnableAudEncodeThread;    //音声エンコードスレッドを使用する
     std::atomic<bool>              bAbortOutput;              //出力スレッドに停止を通知する
@@ -245,6 +269,7 @@ typedef struct AVMux {
     vector<AVMuxAudio>  audio;
     vector<AVMuxSub>    sub;
     vector<sTrim>       trim;
+    AVMuxFragment       fragment;
 #if ENABLE_AVCODEC_OUT_THREAD
     AVMuxThread         thread;
 #endif
@@ -278,7 +303,10 @@ struct AvcodecWriterPrm {
     PerfQueueInfo               *pQueueInfo;              //キューの情報を格納する構造体
     const TCHAR                 *pMuxVidTsLogFile;        //mux timestampログファイル
     HEVCHDRSei                  *pHEVCHdrSei;             //HDR関連のmetadata
+    shared_ptr<RGYHDR10Plus>     pHDR10plus;              //HDR10+の動的メタデータ
     RGYTimestamp                *pVidTimestamp;           //動画のtimestampの情報
+    int                          nFmp4FragMs;             //fragmented mp4のfragmentの長さ (ms, 0でIDRごと, -1でfragmented mp4にしない)
+    double                       dFmp4SegmentSec;         //fragmented mp4のセグメントファイルの長さ (秒, 0で分割しない)
 
     AvcodecWriterPrm() :
         pInputFormatMetadata(nullptr),
@@ -300,7 +328,10 @@ struct AvcodecWriterPrm {
         pQueueInfo(nullptr),
         pMuxVidTsLogFile(nullptr),
         pHEVCHdrSei(nullptr),
-        pVidTimestamp(nullptr) {
+        pHDR10plus(),
+        pVidTimestamp(nullptr),
+        nFmp4FragMs(-1),
+        dFmp4SegmentSec(0.0) {
     }
 };
 
@@ -327,10 +358,14 @@ public:
     int writePacket(uint8_t *buf, int buf_size);
     int64_t seek(int64_t offset, int whence);
 #endif //USE_CUSTOM_IO
+    //出力スレッドを使用しているか
+    bool outputThreadRunning() const;
     //出力スレッドのハンドルを取得する
     HANDLE getThreadHandleOutput();
     HANDLE getThreadHandleAudProcess();
     HANDLE getThreadHandleAudEncode();
+    //映像のビットストリームのバッファの確保/コピー/受け渡しの回数を取得する
+    void GetVideoBufferStats(int64_t *alloc, int64_t *copy, int64_t *move) const;
 protected:
     virtual RGY_ERR Init(const TCHAR *strFileName, const VideoInfo *pVideoOutputInfo, const void *option) override;
 
@@ -355,6 +390,23 @@ protected:
     //WriteNextFrameの本体
     RGY_ERR WriteNextFrameInternal(RGYBitstream *pBitstream, int64_t *pWrittenDts);
 
+    //映像のビットストリームをAVPacketに設定する
+    //bTransferがtrueなら、バッファをコピーせずにAVPacketに渡す (バッファはAVPacketの解放時にReleaseVideoBufferで回収される)
+    //seiが空でなければ、AUD/VPS/SPS/PPS等の直後に挿入する
+    RGY_ERR SetVideoPacketData(AVPacket *pkt, RGYBitstream *pBitstream, bool bTransfer, const vector<uint8_t>& sei);
+
+    //映像のビットストリームを解析し、フレームタイプの整合性を確認する (デバッグ用)
+    void CheckVideoBitstream(const RGYBitstream *pBitstream);
+
+    //AVPacketから解放された映像のバッファを回収する (av_buffer_createのコールバック)
+    static void ReleaseVideoBuffer(void *opaque, uint8_t *data);
+
+    //映像のバッファを空きキューに戻して再利用する
+    void RecycleVideoBuffer(RGYBitstream *pBitstream);
+
+    //映像のバッファの確保・コピー回数をパフォーマンスモニタに反映する
+    void UpdateVideoBufferInfo();
+
     //WriteNextPacketの本体
     RGY_ERR WriteNextPacketInternal(AVPktMuxData *pktData, int64_t maxDtsToWrite);
 
@@ -398,6 +450,9 @@ protected:
     //音声リサンプラの初期化
     RGY_ERR InitAudioResampler(AVMuxAudio *pMuxAudio, int channels, uint64_t channel_layout, int sample_rate, AVSampleFormat sample_fmt);
 
+    //FAWからのAACの取り出しの初期化
+    RGY_ERR InitAudioFAW(AVMuxAudio *pMuxAudio, AVOutputStreamPrm *pInputAudio, RGYAACHeader *pAACHeader);
+
     //音声の初期化
     RGY_ERR InitAudio(AVMuxAudio *pMuxAudio, AVOutputStreamPrm *pInputAudio, uint32_t nAudioIgnoreDecodeError);
 
@@ -464,6 +519,31 @@ protected:
     //ファイルヘッダーを書き出す
     RGY_ERR WriteFileHeader(const RGYBitstream *pBitstream);
 
+    //fragmented mp4の出力の初期化
+    RGY_ERR InitFragment(const AvcodecWriterPrm *prm);
+
+    //必要ならこの映像パケットの前でfragment/セグメントファイルを区切る
+    RGY_ERR WriteFragment(int64_t dts, int64_t duration, bool idr);
+
+    //interleave待ちのパケットを書き出してfragmentを閉じ、ファイルに反映する
+    void FlushFragment();
+
+    //次のセグメントファイルを開く
+    RGY_ERR OpenNextSegment();
+
+    //セグメントファイルのプレイリストを書き出す
+    RGY_ERR WritePlaylist(bool bEndList);
+
+    //最後のセグメントを閉じる (av_write_trailerの前に呼ぶ)
+    void CloseFragment();
+
+    //音声/字幕パケットをav_interleaved_write_frameに渡す
+    //fragment出力時は、書き出し済みの映像より後ろのパケットを保持し、fragmentの区切りで前のfragmentに入らないようにする
+    void WriteInterleavedPacket(AVPacket *pkt);
+
+    //保持している音声/字幕パケットのうち、書き出し済みの映像より前のもの (bAllなら全て) を書き出す
+    void WritePendingPackets(bool bAll);
+
     //タイムスタンプをTrimなどを考慮しつつ計算しなおす
     //nTimeInがTrimで切り取られる領域の場合
     //lastValidFrame ... true 最後の有効なフレーム+1のtimestampを返す / false .. AV_NOPTS_VALUEを返す
@@ -477,6 +557,14 @@ protected:
     void CloseQueues();
 
     static const AVRational QUEUE_DTS_TIMEBASE;
+
+    //映像のビットストリームのバッファの統計 (エンコードスレッドと出力スレッドの両方から更新される)
+    std::atomic<int64_t> m_nVideoBufAlloc; //バッファを確保した回数
+    std::atomic<int64_t> m_nVideoBufCopy;  //ビットストリームをコピーした回数
+    std::atomic<int64_t> m_nVideoBufMove;  //ビットストリームをコピーせずにバッファごと受け取った回数
+    shared_ptr<RGYHDR10Plus> m_hdr10plus;  //HDR10+の動的メタデータ
+    vector<uint8_t> m_hdr10plusNal;        //フレームごとのHDR10+のSEI
+    unique_ptr<RGYBitstreamAnalyzer> m_bsAnalyzer; //映像のビットストリームの検証用 (デバッグ時のみ)
     AVMux m_Mux;
     vector<AVPktMuxData> m_AudPktBufFileHead; //ファイルヘッダを書く前にやってきた音声パケットのバッファ
 };
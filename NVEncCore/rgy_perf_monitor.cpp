@@ -581,6 +581,15 @@ void CPerfMonitor::write_header(FILE *fp, int nSelect) {
     if (nSelect & PERF_MONITOR_QUEUE_AUD_OUT) {
         str += ",queue aud out";
     }
+    if (nSelect & PERF_MONITOR_QUEUE_VID_STAGE) {
+        str += ",queue vid stage,vid stage depth";
+    }
+    if (nSelect & PERF_MONITOR_VID_OUT_BUF) {
+        str += ",vid out buf alloc,vid out buf copy";
+    }
+    if (nSelect & PERF_MONITOR_VID_PREFETCH) {
+        str += ",prefetch hit,prefetch miss,prefetch stall (ms)";
+    }
     if (nSelect & PERF_MONITOR_MEM_PRIVATE) {
         str += ",mem private (MB)";
     }
@@ -1139,6 +1148,15 @@ void CPerfMonitor::write(FILE *fp, int nSelect) {
     if (nSelect & PERF_MONITOR_QUEUE_AUD_OUT) {
         str += strsprintf(",%d", (int)m_QueueInfo.usage_aud_out);
     }
+    if (nSelect & PERF_MONITOR_QUEUE_VID_STAGE) {
+        str += strsprintf(",%d,%d", (int)m_QueueInfo.usage_vid_stage, (int)m_QueueInfo.depth_vid_stage);
+    }
+    if (nSelect & PERF_MONITOR_VID_OUT_BUF) {
+        str += strsprintf(",%lld,%lld", (long long)m_QueueInfo.alloc_vid_out, (long long)m_QueueInfo.copy_vid_out);
+    }
+    if (nSelect & PERF_MONITOR_VID_PREFETCH) {
+        str += strsprintf(",%lld,%lld,%lld", (long long)m_QueueInfo.prefetch_hit, (long long)m_QueueInfo.prefetch_miss, (long long)m_QueueInfo.prefetch_stall_ms);
+    }
     if (nSelect & PERF_MONITOR_MEM_PRIVATE) {
         str += strsprintf(",%.2lf", pInfo->mem_private / (double)(1024 * 1024));
     }
@@ -89,6 +89,9 @@ enum : int {
     PERF_MONITOR_VE_CLOCK      = 0x02000000,
     PERF_MONITOR_VEE_LOAD      = 0x04000000,
     PERF_MONITOR_VED_LOAD      = 0x08000000,
+    PERF_MONITOR_QUEUE_VID_STAGE = 0x10000000,
+    PERF_MONITOR_VID_OUT_BUF   = 0x20000000,
+    PERF_MONITOR_VID_PREFETCH  = 0x40000000,
     PERF_MONITOR_ALL         = (int)UINT_MAX,
 };
 
@@ -124,7 +127,10 @@ static const CX_DESC list_pref_monitor[] = {
     { _T("vee_load"),    PERF_MONITOR_VEE_LOAD },
     { _T("ved_load"),    PERF_MONITOR_VEE_LOAD },
     { _T("ve_clock"),    PERF_MONITOR_VE_CLOCK },
-    { _T("queue"),       PERF_MONITOR_QUEUE_VID_IN | PERF_MONITOR_QUEUE_VID_OUT | PERF_MONITOR_QUEUE_AUD_IN | PERF_MONITOR_QUEUE_AUD_OUT },
+    { _T("queue"),       PERF_MONITOR_QUEUE_VID_IN | PERF_MONITOR_QUEUE_VID_OUT | PERF_MONITOR_QUEUE_AUD_IN | PERF_MONITOR_QUEUE_AUD_OUT | PERF_MONITOR_QUEUE_VID_STAGE },
+    { _T("queue_stage"), PERF_MONITOR_QUEUE_VID_STAGE },
+    { _T("vid_out_buf"), PERF_MONITOR_VID_OUT_BUF },
+    { _T("prefetch"),    PERF_MONITOR_VID_PREFETCH },
     { nullptr, 0 }
 };
 
@@ -193,6 +199,13 @@ struct PerfQueueInfo {
     size_t usage_aud_out;
     size_t usage_aud_enc;
     size_t usage_aud_proc;
+    size_t usage_vid_stage; //入力フレームのステージングバッファの使用数
+    size_t depth_vid_stage; //入力フレームのステージングバッファの段数
+    size_t alloc_vid_out;   //出力映像のビットストリームのバッファを確保した回数
+    size_t copy_vid_out;    //出力映像のビットストリームをコピーした回数
+    size_t prefetch_hit;    //入力の先読みが間に合ったフレーム数
+    size_t prefetch_miss;   //入力の先読みを待機したフレーム数
+    size_t prefetch_stall_ms; //入力の先読みを待機した合計時間
 };
 
 #if ENABLE_METRIC_FRAMEWORK
@@ -0,0 +1,783 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include "rgy_quality_metric.h"
+#include "rgy_simd.h"
+
+#if ENABLE_AVSW_READER
+
+template<typename Type>
+static uint64_t metric_sse_c(const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int width, int height) {
+    uint64_t sum = 0;
+    for (int y = 0; y < height; y++, a += pitchA, b += pitchB) {
+        const Type *pA = (const Type *)a;
+        const Type *pB = (const Type *)b;
+        for (int x = 0; x < width; x++) {
+            const int diff = (int)pA[x] - (int)pB[x];
+            sum += (uint32_t)(diff * diff);
+        }
+    }
+    return sum;
+}
+
+uint64_t metric_sse8_c(const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int width, int height) {
+    return metric_sse_c<uint8_t>(a, pitchA, b, pitchB, width, height);
+}
+
+uint64_t metric_sse16_c(const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int width, int height) {
+    return metric_sse_c<uint16_t>(a, pitchA, b, pitchB, width, height);
+}
+
+//4x4ブロックごとに、{ Σa, Σb, Σ(a^2 + b^2), Σab }を計算する
+template<typename Type>
+static void metric_ssim4x4_c(int32_t (*sums)[4], const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int blocks) {
+    for (int i = 0; i < blocks; i++) {
+        int32_t s1 = 0, s2 = 0, ss = 0, s12 = 0;
+        for (int y = 0; y < 4; y++) {
+            const Type *pA = (const Type *)(a + y * pitchA) + i * 4;
+            const Type *pB = (const Type *)(b + y * pitchB) + i * 4;
+            for (int x = 0; x < 4; x++) {
+                const int32_t va = pA[x];
+                const int32_t vb = pB[x];
+                s1  += va;
+                s2  += vb;
+                ss  += va * va + vb * vb;
+                s12 += va * vb;
+            }
+        }
+        sums[i][0] = s1;
+        sums[i][1] = s2;
+        sums[i][2] = ss;
+        sums[i][3] = s12;
+    }
+}
+
+void metric_ssim4x4_8_c(int32_t (*sums)[4], const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int blocks) {
+    metric_ssim4x4_c<uint8_t>(sums, a, pitchA, b, pitchB, blocks);
+}
+
+void metric_ssim4x4_16_c(int32_t (*sums)[4], const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int blocks) {
+    metric_ssim4x4_c<uint16_t>(sums, a, pitchA, b, pitchB, blocks);
+}
+
+struct RGYMetricFuncs {
+    uint64_t (*sse[2])(const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int width, int height);
+    void (*ssim4x4[2])(int32_t (*sums)[4], const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int blocks);
+};
+
+static const RGYMetricFuncs *get_metric_funcs() {
+    static const RGYMetricFuncs FUNC_C = {
+        { metric_sse8_c, metric_sse16_c },
+        { metric_ssim4x4_8_c, metric_ssim4x4_16_c }
+    };
+    static const RGYMetricFuncs FUNC_AVX2 = {
+        { metric_sse8_avx2, metric_sse16_avx2 },
+        { metric_ssim4x4_8_avx2, metric_ssim4x4_16_avx2 }
+    };
+    return (get_availableSIMD() & AVX2) ? &FUNC_AVX2 : &FUNC_C;
+}
+
+//縦横に隣接する4つの4x4ブロックの和から、8x8の窓のSSIMを計算し、1行分の合計を返す
+static double metric_ssim_end_row(const int32_t (*sum0)[4], const int32_t (*sum1)[4], int windows, double c1, double c2) {
+    double ssim = 0.0;
+    for (int i = 0; i < windows; i++) {
+        const double s1  = (double)sum0[i][0] + sum0[i+1][0] + sum1[i][0] + sum1[i+1][0];
+        const double s2  = (double)sum0[i][1] + sum0[i+1][1] + sum1[i][1] + sum1[i+1][1];
+        const double ss  = (double)sum0[i][2] + sum0[i+1][2] + sum1[i][2] + sum1[i+1][2];
+        const double s12 = (double)sum0[i][3] + sum0[i+1][3] + sum1[i][3] + sum1[i+1][3];
+        const double vars  = ss * 64.0 - s1 * s1 - s2 * s2;
+        const double covar = s12 * 64.0 - s1 * s2;
+        ssim += (2.0 * s1 * s2 + c1) * (2.0 * covar + c2) / ((s1 * s1 + s2 * s2 + c1) * (vars + c2));
+    }
+    return ssim;
+}
+
+static double metric_psnr(double mse, int bitdepth) {
+    const double peak = (double)((1 << bitdepth) - 1);
+    return (mse <= 1e-10) ? 100.0 : (std::min)(100.0, 10.0 * std::log10(peak * peak / mse));
+}
+
+static double metric_ssim_db(double ssim) {
+    return (ssim >= 1.0) ? 100.0 : -10.0 * std::log10(1.0 - ssim);
+}
+
+static const TCHAR *METRIC_PLANE_NAME[] = { _T("Y"), _T("U"), _T("V") };
+
+//平面のコピー元
+struct RGYMetricPlaneSrc {
+    const uint8_t *ptr;
+    int pitch;
+    int bytes; //1画素のバイト数
+    int step;  //隣の画素までの要素数 (色差がインタリーブされている場合は2)
+    int depth; //値のビット深度 (MSB詰めの場合は16)
+};
+
+static bool metric_source_planes(RGYMetricPlaneSrc planes[RGY_METRIC_PLANES], const FrameInfo& frame) {
+    const int bytes = (RGY_CSP_BIT_DEPTH[frame.csp] > 8) ? 2 : 1;
+    const int depth = RGY_CSP_BIT_DEPTH[frame.csp];
+    const size_t planeSize = (size_t)frame.pitch * frame.height;
+    switch (frame.csp) {
+    case RGY_CSP_NV12:
+    case RGY_CSP_P010:
+    case RGY_CSP_NV16:
+    case RGY_CSP_P210:
+        planes[0] = { frame.ptr,                     frame.pitch, bytes, 1, depth };
+        planes[1] = { frame.ptr + planeSize,         frame.pitch, bytes, 2, depth };
+        planes[2] = { frame.ptr + planeSize + bytes, frame.pitch, bytes, 2, depth };
+        return true;
+    case RGY_CSP_YUV444:
+    case RGY_CSP_YUV444_09:
+    case RGY_CSP_YUV444_10:
+    case RGY_CSP_YUV444_12:
+    case RGY_CSP_YUV444_14:
+    case RGY_CSP_YUV444_16:
+        for (int i = 0; i < RGY_METRIC_PLANES; i++) {
+            planes[i] = { frame.ptr + planeSize * i, frame.pitch, bytes, 1, depth };
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
+//NV12/P010などのフレームのデータ全体の大きさ
+static size_t metric_source_size(const FrameInfo& frame) {
+    const size_t planeSize = (size_t)frame.pitch * frame.height;
+    switch (RGY_CSP_CHROMA_FORMAT[frame.csp]) {
+    case RGY_CHROMAFMT_YUV420: return planeSize * 3 / 2;
+    case RGY_CHROMAFMT_YUV422: return planeSize * 2;
+    default:                   return planeSize * 3;
+    }
+}
+
+static bool metric_avframe_planes(RGYMetricPlaneSrc planes[RGY_METRIC_PLANES], const AVFrame *frame) {
+    const auto desc = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+    if (desc == nullptr || desc->nb_components < RGY_METRIC_PLANES
+        || (desc->flags & (AV_PIX_FMT_FLAG_BE | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_RGB))) {
+        return false;
+    }
+    for (int i = 0; i < RGY_METRIC_PLANES; i++) {
+        const auto& comp = desc->comp[i];
+        const int bytes = (comp.depth + comp.shift > 8) ? 2 : 1;
+        planes[i] = { frame->data[comp.plane] + comp.offset, frame->linesize[comp.plane], bytes, comp.step / bytes, comp.depth + comp.shift };
+    }
+    return true;
+}
+
+//比較用のフレームにコピーし、ビット深度をそろえる (shiftが負なら左シフト)
+template<typename TypeSrc, typename TypeDst>
+static void metric_copy_plane(uint8_t *dst, int dstPitch, const RGYMetricPlaneSrc& src, int shift, int width, int y0, int y1) {
+    for (int y = y0; y < y1; y++) {
+        TypeDst *pDst = (TypeDst *)(dst + (size_t)y * dstPitch);
+        const TypeSrc *pSrc = (const TypeSrc *)(src.ptr + (size_t)y * src.pitch);
+        if (shift >= 0) {
+            for (int x = 0; x < width; x++) {
+                pDst[x] = (TypeDst)(pSrc[x * src.step] >> shift);
+            }
+        } else {
+            for (int x = 0; x < width; x++) {
+                pDst[x] = (TypeDst)(pSrc[x * src.step] << (-shift));
+            }
+        }
+    }
+}
+
+static void metric_copy_planes(RGYThreadPool& pool, RGYMetricFrame *dst, const RGYMetricPlaneSrc src[RGY_METRIC_PLANES]) {
+    const int bands = pool.threads();
+    pool.run(bands, [&](int band) {
+        for (int i = 0; i < dst->planes(); i++) {
+            const int y0 = dst->height(i) * band / bands;
+            const int y1 = dst->height(i) * (band + 1) / bands;
+            const int shift = src[i].depth - dst->bitdepth();
+            if (src[i].bytes == 1) {
+                if (dst->bitdepth() > 8) {
+                    metric_copy_plane<uint8_t, uint16_t>(dst->ptr(i), dst->pitch(i), src[i], shift, dst->width(i), y0, y1);
+                } else {
+                    metric_copy_plane<uint8_t, uint8_t>(dst->ptr(i), dst->pitch(i), src[i], shift, dst->width(i), y0, y1);
+                }
+            } else {
+                if (dst->bitdepth() > 8) {
+                    metric_copy_plane<uint16_t, uint16_t>(dst->ptr(i), dst->pitch(i), src[i], shift, dst->width(i), y0, y1);
+                } else {
+                    metric_copy_plane<uint16_t, uint8_t>(dst->ptr(i), dst->pitch(i), src[i], shift, dst->width(i), y0, y1);
+                }
+            }
+        }
+    });
+}
+
+static int chroma_shift_x(RGY_CHROMAFMT chromafmt) {
+    return (chromafmt == RGY_CHROMAFMT_YUV420 || chromafmt == RGY_CHROMAFMT_YUV422) ? 1 : 0;
+}
+
+static int chroma_shift_y(RGY_CHROMAFMT chromafmt) {
+    return (chromafmt == RGY_CHROMAFMT_YUV420) ? 1 : 0;
+}
+
+RGYQualityMetricParam::RGYQualityMetricParam() :
+    codec(RGY_CODEC_UNKNOWN),
+    width(0),
+    height(0),
+    chromafmt(RGY_CHROMAFMT_YUV420),
+    bitdepth(8),
+    sourceCsp(RGY_CSP_NA),
+    matchTolerance(0),
+    psnr(true),
+    ssim(true),
+    threads(0),
+    perFrameFile() {
+}
+
+RGYMetricFrame::RGYMetricFrame() :
+    timestamp(0),
+    m_buffer(),
+    m_bufferSize(0),
+    m_planes(0),
+    m_bitdepth(8),
+    m_width(),
+    m_height(),
+    m_pitch(),
+    m_offset() {
+}
+
+RGY_ERR RGYMetricFrame::alloc(int width, int height, RGY_CHROMAFMT chromafmt, int bitdepth) {
+    //RGY_CHROMAFMT_MONOCHROMEなら輝度のみ
+    m_planes = (chromafmt == RGY_CHROMAFMT_MONOCHROME) ? 1 : RGY_METRIC_PLANES;
+    m_bitdepth = bitdepth;
+    const int shiftX = chroma_shift_x(chromafmt);
+    const int shiftY = chroma_shift_y(chromafmt);
+    const int bytes = (bitdepth > 8) ? 2 : 1;
+    size_t size = 0;
+    for (int i = 0; i < m_planes; i++) {
+        m_width[i]  = (i == 0) ? width  : (width  + (1 << shiftX) - 1) >> shiftX;
+        m_height[i] = (i == 0) ? height : (height + (1 << shiftY) - 1) >> shiftY;
+        m_pitch[i]  = ALIGN(m_width[i] * bytes, 64);
+        m_offset[i] = size;
+        size += (size_t)m_pitch[i] * m_height[i];
+    }
+    if (size > m_bufferSize) {
+        m_buffer.reset((uint8_t *)_aligned_malloc(size, 64));
+        m_bufferSize = (m_buffer) ? size : 0;
+        if (!m_buffer) {
+            return RGY_ERR_NULL_PTR;
+        }
+    }
+    return RGY_ERR_NONE;
+}
+
+RGYQualityMetric::RGYQualityMetric() :
+    m_prm(),
+    m_pLog(),
+    m_func(nullptr),
+    m_planes(0),
+    m_pool(),
+    m_ssimBuf(),
+    m_bandSse(),
+    m_bandSsim(),
+    m_codecCtx(),
+    m_frame(),
+    m_frameSource(),
+    m_frameOutput(),
+    m_thread(),
+    m_mtx(),
+    m_cvPacket(),
+    m_cvSource(),
+    m_packets(),
+    m_sources(),
+    m_sourcesFree(),
+    m_abort(false),
+    m_err(RGY_ERR_NONE),
+    m_fpPerFrame(),
+    m_stats() {
+}
+
+RGYQualityMetric::~RGYQualityMetric() {
+    close();
+}
+
+void RGYQualityMetric::close() {
+    if (m_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_abort = true;
+        }
+        m_cvPacket.notify_all();
+        m_thread.join();
+    }
+    m_cvSource.notify_all();
+    m_packets.clear();
+    m_sources.clear();
+    m_sourcesFree.clear();
+    m_codecCtx.reset();
+    m_frame.reset();
+    m_pool.close();
+    m_fpPerFrame.reset();
+}
+
+RGY_ERR RGYQualityMetric::initCalc() {
+    m_func = get_metric_funcs();
+    if (m_prm.bitdepth > RGY_METRIC_MAX_BIT_DEPTH) {
+        m_pLog->write(RGY_LOG_ERROR, _T("metric: bit depth %d is not supported.\n"), m_prm.bitdepth);
+        return RGY_ERR_UNSUPPORTED;
+    }
+    RGYMetricPlaneSrc planes[RGY_METRIC_PLANES];
+    uint8_t dummy[4] = { 0 };
+    FrameInfo sourceInfo = { 0 };
+    sourceInfo.ptr = dummy;
+    sourceInfo.csp = m_prm.sourceCsp;
+    if (!metric_source_planes(planes, sourceInfo)) {
+        m_pLog->write(RGY_LOG_ERROR, _T("metric: unsupported input format %s.\n"), RGY_CSP_NAMES[m_prm.sourceCsp]);
+        return RGY_ERR_INVALID_COLOR_FORMAT;
+    }
+    //色差のサブサンプリングが異なる場合は、輝度のみ比較する
+    m_planes = RGY_METRIC_PLANES;
+    if (RGY_CSP_CHROMA_FORMAT[m_prm.sourceCsp] != m_prm.chromafmt) {
+        m_pLog->write(RGY_LOG_WARN, _T("metric: chroma format of input (%s) and output differ, only luma will be compared.\n"), RGY_CSP_NAMES[m_prm.sourceCsp]);
+        m_planes = 1;
+    }
+    const RGY_CHROMAFMT chromafmt = (m_planes == 1) ? RGY_CHROMAFMT_MONOCHROME : m_prm.chromafmt;
+    RGY_ERR err = RGY_ERR_NONE;
+    if (RGY_ERR_NONE != (err = m_frameSource.alloc(m_prm.width, m_prm.height, chromafmt, m_prm.bitdepth))
+        || RGY_ERR_NONE != (err = m_frameOutput.alloc(m_prm.width, m_prm.height, chromafmt, m_prm.bitdepth))) {
+        m_pLog->write(RGY_LOG_ERROR, _T("metric: failed to allocate frame buffer.\n"));
+        return err;
+    }
+
+    int threads = m_prm.threads;
+    if (threads <= 0) {
+        threads = (int)std::thread::hardware_concurrency();
+    }
+    threads = clamp(threads, 1, (std::max)(1, m_prm.height / 64));
+    m_pool.init(threads);
+    const int bands = m_pool.threads();
+    m_ssimBuf.resize(bands);
+    for (auto& buf : m_ssimBuf) {
+        buf.resize((m_prm.width / 4) * 4 * 2);
+    }
+    m_bandSse.resize(bands * RGY_METRIC_PLANES);
+    m_bandSsim.resize(bands * RGY_METRIC_PLANES);
+    return RGY_ERR_NONE;
+}
+
+RGY_ERR RGYQualityMetric::init(const RGYQualityMetricParam& prm, shared_ptr<RGYLog> log) {
+    m_prm = prm;
+    m_pLog = log;
+    memset(&m_stats, 0, sizeof(m_stats));
+    RGY_ERR err = initCalc();
+    if (err != RGY_ERR_NONE) {
+        return err;
+    }
+    const int bands = m_pool.threads();
+
+    //ビットストリームのデコーダ
+    const auto codecId = getAVCodecId(m_prm.codec);
+    const AVCodec *codec = (codecId != AV_CODEC_ID_NONE) ? avcodec_find_decoder(codecId) : nullptr;
+    if (codec == nullptr) {
+        m_pLog->write(RGY_LOG_ERROR, _T("metric: failed to find decoder for %s.\n"), CodecToStr(m_prm.codec).c_str());
+        return RGY_ERR_UNSUPPORTED;
+    }
+    m_codecCtx = unique_ptr<AVCodecContext, RGYAVDeleter<AVCodecContext>>(avcodec_alloc_context3(codec), RGYAVDeleter<AVCodecContext>(avcodec_free_context));
+    m_frame = unique_ptr<AVFrame, RGYAVDeleter<AVFrame>>(av_frame_alloc(), RGYAVDeleter<AVFrame>(av_frame_free));
+    if (!m_codecCtx || !m_frame) {
+        m_pLog->write(RGY_LOG_ERROR, _T("metric: failed to allocate decoder.\n"));
+        return RGY_ERR_NULL_PTR;
+    }
+    m_codecCtx->thread_count = 0;
+    int ret = 0;
+    if (0 > (ret = avcodec_open2(m_codecCtx.get(), codec, nullptr))) {
+        m_pLog->write(RGY_LOG_ERROR, _T("metric: failed to open decoder for %s: %s\n"), CodecToStr(m_prm.codec).c_str(), qsv_av_err2str(ret).c_str());
+        return RGY_ERR_UNSUPPORTED;
+    }
+
+    if (m_prm.perFrameFile.length() > 0) {
+        FILE *fp = nullptr;
+        if (_tfopen_s(&fp, m_prm.perFrameFile.c_str(), _T("w")) || fp == nullptr) {
+            m_pLog->write(RGY_LOG_ERROR, _T("metric: failed to open \"%s\".\n"), m_prm.perFrameFile.c_str());
+            return RGY_ERR_FILE_OPEN;
+        }
+        m_fpPerFrame = unique_ptr<FILE, fp_deleter>(fp, fp_deleter());
+        tstring header = _T("frame,timestamp");
+        if (m_prm.psnr) {
+            for (int i = 0; i < m_planes; i++) {
+                header += strsprintf(_T(",psnr_%s"), METRIC_PLANE_NAME[i]);
+            }
+            header += _T(",psnr_all");
+        }
+        if (m_prm.ssim) {
+            for (int i = 0; i < m_planes; i++) {
+                header += strsprintf(_T(",ssim_%s"), METRIC_PLANE_NAME[i]);
+            }
+            header += _T(",ssim_all");
+        }
+        _ftprintf(m_fpPerFrame.get(), _T("%s\n"), header.c_str());
+    }
+
+    m_abort = false;
+    m_err = RGY_ERR_NONE;
+    m_thread = std::thread(&RGYQualityMetric::workerThread, this);
+    m_pLog->write(RGY_LOG_DEBUG, _T("metric: %s%s%s, %dx%d, %d bit, %s, %d threads, %s.\n"),
+        (m_prm.psnr) ? _T("psnr") : _T(""), (m_prm.psnr && m_prm.ssim) ? _T("/") : _T(""), (m_prm.ssim) ? _T("ssim") : _T(""),
+        m_prm.width, m_prm.height, m_prm.bitdepth, (m_planes == 1) ? _T("luma only") : _T("yuv"), bands,
+        (m_func->sse[0] == metric_sse8_c) ? _T("c") : _T("avx2"));
+    return RGY_ERR_NONE;
+}
+
+RGY_ERR RGYQualityMetric::addSource(const FrameInfo& frame) {
+    if (frame.width != m_prm.width || frame.height != m_prm.height || frame.csp != m_prm.sourceCsp) {
+        m_pLog->write(RGY_LOG_ERROR, _T("metric: input frame %dx%d %s does not match %dx%d %s.\n"),
+            frame.width, frame.height, RGY_CSP_NAMES[frame.csp], m_prm.width, m_prm.height, RGY_CSP_NAMES[m_prm.sourceCsp]);
+        return RGY_ERR_INVALID_PARAM;
+    }
+    unique_ptr<MetricSource> source;
+    {
+        //デコードが追いつくまで待機する
+        //デコード待ちのパケットがない場合は、待っても比較が進まないので待機しない
+        std::unique_lock<std::mutex> lock(m_mtx);
+        m_cvSource.wait(lock, [&]() {
+            return m_abort || (int)m_sources.size() < RGY_METRIC_SOURCE_QUEUE_MAX || m_packets.size() == 0;
+        });
+        if (m_abort) {
+            return m_err;
+        }
+        if (m_sourcesFree.size() > 0) {
+            source = std::move(m_sourcesFree.back());
+            m_sourcesFree.pop_back();
+        }
+    }
+    //変換はデコードスレッドで行い、ここではコピーのみ行う
+    const size_t size = metric_source_size(frame);
+    if (!source) {
+        source.reset(new MetricSource());
+        source->bufferSize = 0;
+    }
+    if (source->bufferSize < size) {
+        source->buffer.reset((uint8_t *)_aligned_malloc(size, 64));
+        source->bufferSize = (source->buffer) ? size : 0;
+        if (!source->buffer) {
+            return RGY_ERR_NULL_PTR;
+        }
+    }
+    memcpy(source->buffer.get(), frame.ptr, size);
+    source->info = frame;
+    source->info.ptr = source->buffer.get();
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_sources[frame.timestamp] = std::move(source);
+    }
+    return RGY_ERR_NONE;
+}
+
+RGY_ERR RGYQualityMetric::addBitstream(const RGYBitstream *bitstream) {
+    MetricPacket pkt;
+    pkt.eof = bitstream == nullptr;
+    pkt.pts = (bitstream) ? bitstream->pts() : 0;
+    pkt.dts = (bitstream) ? bitstream->dts() : 0;
+    if (bitstream) {
+        if (bitstream->size() == 0) {
+            return RGY_ERR_NONE;
+        }
+        //デコーダに渡すため、末尾にAV_INPUT_BUFFER_PADDING_SIZEの0を付加する
+        pkt.data.resize(bitstream->size() + AV_INPUT_BUFFER_PADDING_SIZE, 0);
+        memcpy(pkt.data.data(), bitstream->data(), bitstream->size());
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        if (m_abort) {
+            return m_err;
+        }
+        m_packets.push_back(std::move(pkt));
+    }
+    m_cvPacket.notify_one();
+    return RGY_ERR_NONE;
+}
+
+RGY_ERR RGYQualityMetric::finish() {
+    if (!m_thread.joinable()) {
+        return m_err;
+    }
+    //デコーダに残っているフレームを取り出して終了する
+    addBitstream(nullptr);
+    m_thread.join();
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_stats.unmatchedSource += m_sources.size();
+    m_sources.clear();
+    m_fpPerFrame.reset();
+    return m_err;
+}
+
+void RGYQualityMetric::workerThread() {
+    for (;;) {
+        MetricPacket pkt;
+        {
+            std::unique_lock<std::mutex> lock(m_mtx);
+            m_cvPacket.wait(lock, [&]() { return m_abort || m_packets.size() > 0; });
+            if (m_abort) {
+                break;
+            }
+            pkt = std::move(m_packets.front());
+            m_packets.pop_front();
+        }
+        m_cvSource.notify_all();
+        auto err = decodePacket(&pkt);
+        if (err != RGY_ERR_NONE) {
+            //エラーの場合は以降の比較を行わない
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_err = err;
+            m_abort = true;
+            break;
+        }
+        if (pkt.eof) {
+            break;
+        }
+    }
+    m_cvSource.notify_all();
+}
+
+RGY_ERR RGYQualityMetric::decodePacket(MetricPacket *pkt) {
+    const auto start = std::chrono::high_resolution_clock::now();
+    const double analyzeUsStart = m_stats.analyzeUs;
+    AVPacket avpkt;
+    av_init_packet(&avpkt);
+    avpkt.data = (pkt->eof) ? nullptr : pkt->data.data();
+    avpkt.size = (pkt->eof) ? 0 : (int)(pkt->data.size() - AV_INPUT_BUFFER_PADDING_SIZE);
+    avpkt.pts = pkt->pts;
+    avpkt.dts = pkt->dts;
+    int ret = avcodec_send_packet(m_codecCtx.get(), &avpkt);
+    if (ret < 0 && ret != AVERROR_EOF) {
+        m_pLog->write(RGY_LOG_ERROR, _T("metric: failed to send packet to decoder: %s.\n"), qsv_av_err2str(ret).c_str());
+        return RGY_ERR_UNDEFINED_BEHAVIOR;
+    }
+    RGY_ERR err = RGY_ERR_NONE;
+    while (err == RGY_ERR_NONE) {
+        ret = avcodec_receive_frame(m_codecCtx.get(), m_frame.get());
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            break;
+        } else if (ret < 0) {
+            m_pLog->write(RGY_LOG_ERROR, _T("metric: failed to receive frame from decoder: %s.\n"), qsv_av_err2str(ret).c_str());
+            return RGY_ERR_UNDEFINED_BEHAVIOR;
+        }
+        err = compareFrame(m_frame.get());
+        av_frame_unref(m_frame.get());
+    }
+    //比較にかかった時間を除いて、デコードの時間とする
+    const double elapsedUs = (double)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+    m_stats.decodeUs += elapsedUs - (m_stats.analyzeUs - analyzeUsStart);
+    return err;
+}
+
+RGY_ERR RGYQualityMetric::compareFrame(AVFrame *frame) {
+    const int64_t pts = (frame->pts != AV_NOPTS_VALUE) ? frame->pts : frame->best_effort_timestamp;
+    if (frame->width != m_prm.width || frame->height != m_prm.height) {
+        m_pLog->write(RGY_LOG_ERROR, _T("metric: decoded frame size %dx%d does not match %dx%d.\n"), frame->width, frame->height, m_prm.width, m_prm.height);
+        return RGY_ERR_INVALID_PARAM;
+    }
+    const auto desc = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+    RGYMetricPlaneSrc outputPlanes[RGY_METRIC_PLANES];
+    if (!metric_avframe_planes(outputPlanes, frame)
+        || (m_planes > 1 && (desc->log2_chroma_w != chroma_shift_x(m_prm.chromafmt) || desc->log2_chroma_h != chroma_shift_y(m_prm.chromafmt)))) {
+        m_pLog->write(RGY_LOG_ERROR, _T("metric: unsupported decoded format %s.\n"), char_to_tstring(av_get_pix_fmt_name((AVPixelFormat)frame->format)).c_str());
+        return RGY_ERR_INVALID_COLOR_FORMAT;
+    }
+
+    //timestampの一致する入力フレームを探す
+    //デコード結果は表示順に出てくるので、これより前の入力フレームには対応するものがない
+    unique_ptr<MetricSource> source;
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        auto it = m_sources.begin();
+        while (it != m_sources.end() && it->first < pts - m_prm.matchTolerance) {
+            m_sourcesFree.push_back(std::move(it->second));
+            it = m_sources.erase(it);
+            m_stats.unmatchedSource++;
+        }
+        if (it != m_sources.end() && it->first <= pts + m_prm.matchTolerance) {
+            source = std::move(it->second);
+            m_sources.erase(it);
+        }
+    }
+    m_cvSource.notify_all();
+    if (!source) {
+        m_pLog->write(RGY_LOG_TRACE, _T("metric: no input frame for output pts %lld.\n"), (long long)pts);
+        m_stats.unmatchedOutput++;
+        return RGY_ERR_NONE;
+    }
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    RGYMetricPlaneSrc sourcePlanes[RGY_METRIC_PLANES];
+    metric_source_planes(sourcePlanes, source->info);
+    metric_copy_planes(m_pool, &m_frameSource, sourcePlanes);
+    metric_copy_planes(m_pool, &m_frameOutput, outputPlanes);
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_sourcesFree.push_back(std::move(source));
+    }
+
+    RGYQualityMetricFrame result;
+    result.frame = m_stats.frames;
+    result.timestamp = pts;
+    calcFrame(result, m_frameSource, m_frameOutput);
+    writeFrame(result);
+
+    for (int i = 0; i < m_planes; i++) {
+        m_stats.mseSum[i]  += result.mse[i];
+        m_stats.psnrSum[i] += metric_psnr(result.mse[i], m_prm.bitdepth);
+        m_stats.ssimSum[i] += result.ssim[i];
+    }
+    m_stats.mseSum[RGY_METRIC_PLANES]  += result.mseAll;
+    m_stats.psnrSum[RGY_METRIC_PLANES] += metric_psnr(result.mseAll, m_prm.bitdepth);
+    m_stats.ssimSum[RGY_METRIC_PLANES] += result.ssimAll;
+    m_stats.frames++;
+    m_stats.analyzeUs += (double)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+    return RGY_ERR_NONE;
+}
+
+void RGYQualityMetric::calcFrame(RGYQualityMetricFrame& result, const RGYMetricFrame& a, const RGYMetricFrame& b) {
+    const int bands = m_pool.threads();
+    const int high = (a.bitdepth() > 8) ? 1 : 0;
+    const double peak = (double)((1 << a.bitdepth()) - 1);
+    const double c1 = (0.01 * peak) * (0.01 * peak) * 64.0;
+    const double c2 = (0.03 * peak) * (0.03 * peak) * 64.0 * 63.0;
+    std::fill(m_bandSse.begin(), m_bandSse.end(), 0);
+    std::fill(m_bandSsim.begin(), m_bandSsim.end(), 0.0);
+    //各平面を行方向に分割して計算する
+    //SSIMは4x4ブロックの和を2行分ずつ保持し、8x8の窓を4画素ずつずらして計算する
+    m_pool.run(bands, [&](int band) {
+        for (int i = 0; i < m_planes; i++) {
+            const int width = a.width(i);
+            const int height = a.height(i);
+            if (m_prm.psnr) {
+                const int y0 = height * band / bands;
+                const int y1 = height * (band + 1) / bands;
+                m_bandSse[band * RGY_METRIC_PLANES + i] = m_func->sse[high](
+                    a.ptr(i) + (size_t)y0 * a.pitch(i), a.pitch(i), b.ptr(i) + (size_t)y0 * b.pitch(i), b.pitch(i), width, y1 - y0);
+            }
+            if (m_prm.ssim) {
+                const int blocksX = width / 4;
+                const int windowsY = (std::max)(height / 4 - 1, 0);
+                const int wy0 = windowsY * band / bands;
+                const int wy1 = windowsY * (band + 1) / bands;
+                int32_t (*sum0)[4] = (int32_t (*)[4])m_ssimBuf[band].data();
+                int32_t (*sum1)[4] = sum0 + blocksX;
+                double ssim = 0.0;
+                for (int wy = wy0; wy < wy1; wy++) {
+                    if (wy == wy0) {
+                        m_func->ssim4x4[high](sum0, a.ptr(i) + (size_t)wy * 4 * a.pitch(i), a.pitch(i), b.ptr(i) + (size_t)wy * 4 * b.pitch(i), b.pitch(i), blocksX);
+                    }
+                    m_func->ssim4x4[high](sum1, a.ptr(i) + (size_t)(wy + 1) * 4 * a.pitch(i), a.pitch(i), b.ptr(i) + (size_t)(wy + 1) * 4 * b.pitch(i), b.pitch(i), blocksX);
+                    ssim += metric_ssim_end_row(sum0, sum1, blocksX - 1, c1, c2);
+                    std::swap(sum0, sum1);
+                }
+                m_bandSsim[band * RGY_METRIC_PLANES + i] = ssim;
+            }
+        }
+    });
+
+    uint64_t sseAll = 0;
+    double ssimAll = 0.0;
+    int64_t pixelsAll = 0;
+    for (int i = 0; i < m_planes; i++) {
+        uint64_t sse = 0;
+        double ssim = 0.0;
+        for (int band = 0; band < bands; band++) {
+            sse  += m_bandSse[band * RGY_METRIC_PLANES + i];
+            ssim += m_bandSsim[band * RGY_METRIC_PLANES + i];
+        }
+        const int64_t pixels = (int64_t)a.width(i) * a.height(i);
+        const int64_t windows = (int64_t)(std::max)(a.width(i) / 4 - 1, 0) * (std::max)(a.height(i) / 4 - 1, 0);
+        result.mse[i] = (double)sse / pixels;
+        result.ssim[i] = (windows > 0) ? ssim / windows : 1.0;
+        sseAll += sse;
+        ssimAll += result.ssim[i] * pixels;
+        pixelsAll += pixels;
+    }
+    for (int i = m_planes; i < RGY_METRIC_PLANES; i++) {
+        result.mse[i] = 0.0;
+        result.ssim[i] = 1.0;
+    }
+    result.mseAll = (double)sseAll / pixelsAll;
+    result.ssimAll = ssimAll / pixelsAll;
+}
+
+void RGYQualityMetric::writeFrame(const RGYQualityMetricFrame& result) {
+    if (!m_fpPerFrame) {
+        return;
+    }
+    tstring line = strsprintf(_T("%lld,%lld"), (long long)result.frame, (long long)result.timestamp);
+    if (m_prm.psnr) {
+        for (int i = 0; i < m_planes; i++) {
+            line += strsprintf(_T(",%.4f"), metric_psnr(result.mse[i], m_prm.bitdepth));
+        }
+        line += strsprintf(_T(",%.4f"), metric_psnr(result.mseAll, m_prm.bitdepth));
+    }
+    if (m_prm.ssim) {
+        for (int i = 0; i < m_planes; i++) {
+            line += strsprintf(_T(",%.6f"), result.ssim[i]);
+        }
+        line += strsprintf(_T(",%.6f"), result.ssimAll);
+    }
+    _ftprintf(m_fpPerFrame.get(), _T("%s\n"), line.c_str());
+}
+
+void RGYQualityMetric::printResult() {
+    if (m_stats.frames == 0) {
+        m_pLog->write(RGY_LOG_WARN, _T("metric: no frame compared (unmatched: input %lld, output %lld).\n"),
+            (long long)m_stats.unmatchedSource, (long long)m_stats.unmatchedOutput);
+        return;
+    }
+    const double frames = (double)m_stats.frames;
+    if (m_stats.unmatchedSource > 0 || m_stats.unmatchedOutput > 0) {
+        m_pLog->write(RGY_LOG_WARN, _T("metric: %lld input frames and %lld output frames could not be matched by timestamp.\n"),
+            (long long)m_stats.unmatchedSource, (long long)m_stats.unmatchedOutput);
+    }
+    if (m_prm.psnr) {
+        tstring str = _T("PSNR  ");
+        for (int i = 0; i < m_planes; i++) {
+            str += strsprintf(_T("%s:%.3f "), METRIC_PLANE_NAME[i], m_stats.psnrSum[i] / frames);
+        }
+        str += strsprintf(_T("Avg:%.3f Global:%.3f"), m_stats.psnrSum[RGY_METRIC_PLANES] / frames,
+            metric_psnr(m_stats.mseSum[RGY_METRIC_PLANES] / frames, m_prm.bitdepth));
+        m_pLog->write(RGY_LOG_INFO, _T("%s\n"), str.c_str());
+    }
+    if (m_prm.ssim) {
+        tstring str = _T("SSIM  ");
+        for (int i = 0; i < m_planes; i++) {
+            const double ssim = m_stats.ssimSum[i] / frames;
+            str += strsprintf(_T("%s:%.6f(%.3fdB) "), METRIC_PLANE_NAME[i], ssim, metric_ssim_db(ssim));
+        }
+        const double ssim = m_stats.ssimSum[RGY_METRIC_PLANES] / frames;
+        str += strsprintf(_T("All:%.6f(%.3fdB)"), ssim, metric_ssim_db(ssim));
+        m_pLog->write(RGY_LOG_INFO, _T("%s\n"), str.c_str());
+    }
+    m_pLog->write(RGY_LOG_DEBUG, _T("metric: %lld frames, decode %.2f ms/frame, analyze %.2f ms/frame.\n"),
+        (long long)m_stats.frames, m_stats.decodeUs * 0.001 / frames, m_stats.analyzeUs * 0.001 / frames);
+}
+
+#endif //#if ENABLE_AVSW_READER
@@ -0,0 +1,199 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#pragma once
+#ifndef __RGY_QUALITY_METRIC_H__
+#define __RGY_QUALITY_METRIC_H__
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "rgy_version.h"
+#include "rgy_util.h"
+#include "rgy_log.h"
+#include "rgy_thread_pool.h"
+#include "convert_csp.h"
+#include "NVEncUtil.h"
+
+#if ENABLE_AVSW_READER
+#include "rgy_avutil.h"
+
+static const int RGY_METRIC_PLANES = 3;
+//比較を待つ入力フレームの上限 (デコードが追いつくまで、addSourceで待機する)
+static const int RGY_METRIC_SOURCE_QUEUE_MAX = 64;
+//計算に使用するビット深度の上限 (4x4ブロックの二乗和を32bitで扱えるように)
+static const int RGY_METRIC_MAX_BIT_DEPTH = 12;
+
+struct RGYQualityMetricParam {
+    RGY_CODEC codec;            //比較するビットストリームのコーデック
+    int width, height;          //比較する画像のサイズ
+    RGY_CHROMAFMT chromafmt;    //出力の色差のサブサンプリング
+    int bitdepth;               //出力のビット深度
+    RGY_CSP sourceCsp;          //addSourceで渡すフレームの色空間
+    int64_t matchTolerance;     //入力フレームとデコード結果のtimestampの許容誤差
+    bool psnr;
+    bool ssim;
+    int threads;                //計算に使用するスレッド数 (0で自動)
+    tstring perFrameFile;       //フレームごとの結果の出力先 (空なら出力しない)
+
+    RGYQualityMetricParam();
+};
+
+//1フレーム分の比較結果
+struct RGYQualityMetricFrame {
+    int64_t frame;
+    int64_t timestamp;
+    double mse[RGY_METRIC_PLANES];
+    double ssim[RGY_METRIC_PLANES];
+    double mseAll;
+    double ssimAll;
+};
+
+struct RGYQualityMetricStats {
+    int64_t frames;          //比較したフレーム数
+    int64_t unmatchedSource; //デコード結果が見つからなかった入力フレーム数
+    int64_t unmatchedOutput; //入力フレームが見つからなかったデコード結果のフレーム数
+    double psnrSum[RGY_METRIC_PLANES + 1]; //フレームごとのPSNRの合計 (最後は全平面)
+    double mseSum[RGY_METRIC_PLANES + 1];  //フレームごとのMSEの合計 (最後は全平面)
+    double ssimSum[RGY_METRIC_PLANES + 1]; //フレームごとのSSIMの合計 (最後は全平面)
+    double decodeUs;         //デコードにかかった時間の合計
+    double analyzeUs;        //比較にかかった時間の合計
+};
+
+//差の二乗和 (rgy_quality_metric.cpp / rgy_quality_metric_avx2.cpp)
+uint64_t metric_sse8_c(const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int width, int height);
+uint64_t metric_sse16_c(const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int width, int height);
+uint64_t metric_sse8_avx2(const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int width, int height);
+uint64_t metric_sse16_avx2(const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int width, int height);
+//横に並んだblocks個の4x4ブロックごとに、{ Σa, Σb, Σ(a^2 + b^2), Σab }を計算する
+void metric_ssim4x4_8_c(int32_t (*sums)[4], const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int blocks);
+void metric_ssim4x4_16_c(int32_t (*sums)[4], const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int blocks);
+void metric_ssim4x4_8_avx2(int32_t (*sums)[4], const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int blocks);
+void metric_ssim4x4_16_avx2(int32_t (*sums)[4], const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int blocks);
+
+struct RGYMetricFuncs;
+
+//比較用に平面ごとに並べなおしたフレーム (8bitならuint8_t, それ以外はuint16_t)
+class RGYMetricFrame {
+public:
+    RGYMetricFrame();
+    RGY_ERR alloc(int width, int height, RGY_CHROMAFMT chromafmt, int bitdepth);
+    int planes() const { return m_planes; }
+    int bitdepth() const { return m_bitdepth; }
+    int width(int plane) const { return m_width[plane]; }
+    int height(int plane) const { return m_height[plane]; }
+    int pitch(int plane) const { return m_pitch[plane]; }
+    uint8_t *ptr(int plane) { return m_buffer.get() + m_offset[plane]; }
+    const uint8_t *ptr(int plane) const { return m_buffer.get() + m_offset[plane]; }
+    int64_t timestamp;
+protected:
+    unique_ptr<uint8_t, aligned_malloc_deleter> m_buffer;
+    size_t m_bufferSize;
+    int m_planes;
+    int m_bitdepth;
+    int m_width[RGY_METRIC_PLANES];
+    int m_height[RGY_METRIC_PLANES];
+    int m_pitch[RGY_METRIC_PLANES];
+    size_t m_offset[RGY_METRIC_PLANES];
+};
+
+//エンコード結果をlibavcodecでデコードし、入力フレームとのPSNR/SSIMを計算する
+//入力フレームはaddSourceでコピーして保持し、ビットストリームはaddBitstreamで
+//キューに積んで、デコードと計算は専用のスレッドで行う
+//入力フレームとデコード結果は、timestampで対応づける
+class RGYQualityMetric {
+public:
+    RGYQualityMetric();
+    ~RGYQualityMetric();
+
+    RGY_ERR init(const RGYQualityMetricParam& prm, shared_ptr<RGYLog> log);
+    //エンコーダに渡したフレームを登録する (CPU上のフレームのみ)
+    RGY_ERR addSource(const FrameInfo& frame);
+    //エンコード結果のビットストリームを登録する
+    RGY_ERR addBitstream(const RGYBitstream *bitstream);
+    //デコーダに残ったフレームを処理し、スレッドを終了する
+    RGY_ERR finish();
+    //結果を表示する
+    void printResult();
+    const RGYQualityMetricStats& stats() const { return m_stats; }
+    void close();
+protected:
+    struct MetricPacket {
+        std::vector<uint8_t> data;
+        int64_t pts, dts;
+        bool eof;
+    };
+    struct MetricSource {
+        unique_ptr<uint8_t, aligned_malloc_deleter> buffer;
+        size_t bufferSize;
+        FrameInfo info;
+    };
+    //比較に使用する関数とバッファを準備する (デコーダは使用しない)
+    RGY_ERR initCalc();
+    void workerThread();
+    RGY_ERR decodePacket(MetricPacket *pkt);
+    RGY_ERR compareFrame(AVFrame *frame);
+    void calcFrame(RGYQualityMetricFrame& result, const RGYMetricFrame& a, const RGYMetricFrame& b);
+    void writeFrame(const RGYQualityMetricFrame& result);
+
+    RGYQualityMetricParam m_prm;
+    shared_ptr<RGYLog> m_pLog;
+    const RGYMetricFuncs *m_func;
+    int m_planes;
+    RGYThreadPool m_pool;
+    std::vector<std::vector<int32_t>> m_ssimBuf; //帯ごとのSSIMの4x4ブロックの和 (2行分)
+    std::vector<uint64_t> m_bandSse;             //帯・平面ごとの差の二乗和
+    std::vector<double> m_bandSsim;              //帯・平面ごとのSSIMの合計
+
+    unique_ptr<AVCodecContext, RGYAVDeleter<AVCodecContext>> m_codecCtx;
+    unique_ptr<AVFrame, RGYAVDeleter<AVFrame>> m_frame;
+    RGYMetricFrame m_frameSource;
+    RGYMetricFrame m_frameOutput;
+
+    std::thread m_thread;
+    std::mutex m_mtx;
+    std::condition_variable m_cvPacket;
+    std::condition_variable m_cvSource;
+    std::deque<MetricPacket> m_packets;
+    std::map<int64_t, unique_ptr<MetricSource>> m_sources;
+    std::vector<unique_ptr<MetricSource>> m_sourcesFree;
+    bool m_abort;
+    RGY_ERR m_err;
+
+    unique_ptr<FILE, fp_deleter> m_fpPerFrame;
+    RGYQualityMetricStats m_stats;
+};
+
+#endif //#if ENABLE_AVSW_READER
+
+#endif //__RGY_QUALITY_METRIC_H__
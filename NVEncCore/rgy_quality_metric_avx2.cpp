@@ -0,0 +1,171 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#define USE_SSE2  1
+#define USE_SSSE3 1
+#define USE_SSE41 1
+#define USE_AVX   1
+#define USE_AVX2  1
+
+#include "rgy_simd.h"
+#include <stdint.h>
+#include <immintrin.h>
+#include "rgy_osdep.h"
+
+#if _MSC_VER >= 1800 && !defined(__AVX__) && !defined(_DEBUG)
+static_assert(false, "do not forget to set /arch:AVX or /arch:AVX2 for this file.");
+#endif
+
+#if defined(_MSC_VER) || defined(__AVX2__)
+
+//端数の処理に使用するC版 (rgy_quality_metric.cpp)
+uint64_t metric_sse8_c(const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int width, int height);
+uint64_t metric_sse16_c(const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int width, int height);
+void metric_ssim4x4_8_c(int32_t (*sums)[4], const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int blocks);
+void metric_ssim4x4_16_c(int32_t (*sums)[4], const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int blocks);
+
+static RGY_FORCEINLINE uint64_t metric_hsum_epi64(__m256i y) {
+    //32bit環境では_mm_cvtsi128_si64が使えないので、一度メモリに書き出す
+    uint64_t sum[2];
+    _mm_storeu_si128((__m128i *)sum, _mm_add_epi64(_mm256_castsi256_si128(y), _mm256_extracti128_si256(y, 1)));
+    return sum[0] + sum[1];
+}
+
+//32bitの8要素を64bitに拡張して加算する
+static RGY_FORCEINLINE __m256i metric_add_epu32_to_epi64(__m256i acc64, __m256i acc32) {
+    acc64 = _mm256_add_epi64(acc64, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(acc32)));
+    acc64 = _mm256_add_epi64(acc64, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(acc32, 1)));
+    return acc64;
+}
+
+//32画素ずつ処理し、1行ごとに64bitに集計する
+//(1行の32bitの累積は最大で 幅/16 * 2 * 255^2 なので、幅16384まではあふれない)
+uint64_t metric_sse8_avx2(const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int width, int height) {
+    const int width32 = width & ~31;
+    const __m256i yZero = _mm256_setzero_si256();
+    __m256i ySum64 = _mm256_setzero_si256();
+    uint64_t sumTail = 0;
+    for (int y = 0; y < height; y++, a += pitchA, b += pitchB) {
+        __m256i ySum32 = _mm256_setzero_si256();
+        for (int x = 0; x < width32; x += 32) {
+            const __m256i yA = _mm256_loadu_si256((const __m256i *)(a + x));
+            const __m256i yB = _mm256_loadu_si256((const __m256i *)(b + x));
+            const __m256i yDiffLo = _mm256_sub_epi16(_mm256_unpacklo_epi8(yA, yZero), _mm256_unpacklo_epi8(yB, yZero));
+            const __m256i yDiffHi = _mm256_sub_epi16(_mm256_unpackhi_epi8(yA, yZero), _mm256_unpackhi_epi8(yB, yZero));
+            ySum32 = _mm256_add_epi32(ySum32, _mm256_madd_epi16(yDiffLo, yDiffLo));
+            ySum32 = _mm256_add_epi32(ySum32, _mm256_madd_epi16(yDiffHi, yDiffHi));
+        }
+        ySum64 = metric_add_epu32_to_epi64(ySum64, ySum32);
+        if (width32 < width) {
+            sumTail += metric_sse8_c(a + width32, pitchA, b + width32, pitchB, width - width32, 1);
+        }
+    }
+    return metric_hsum_epi64(ySum64) + sumTail;
+}
+
+//16画素ずつ処理する (値はRGY_METRIC_MAX_BIT_DEPTH(12bit)以下なので、差は16bitに収まる)
+//32bitの累積は1回あたり最大 2 * 4095^2 なので、32回ごとに64bitに集計する
+uint64_t metric_sse16_avx2(const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int width, int height) {
+    const int width16 = width & ~15;
+    __m256i ySum64 = _mm256_setzero_si256();
+    uint64_t sumTail = 0;
+    for (int y = 0; y < height; y++, a += pitchA, b += pitchB) {
+        const uint16_t *pA = (const uint16_t *)a;
+        const uint16_t *pB = (const uint16_t *)b;
+        for (int x0 = 0; x0 < width16; x0 += 16 * 32) {
+            const int x1 = (x0 + 16 * 32 < width16) ? x0 + 16 * 32 : width16;
+            __m256i ySum32 = _mm256_setzero_si256();
+            for (int x = x0; x < x1; x += 16) {
+                const __m256i yDiff = _mm256_sub_epi16(_mm256_loadu_si256((const __m256i *)(pA + x)), _mm256_loadu_si256((const __m256i *)(pB + x)));
+                ySum32 = _mm256_add_epi32(ySum32, _mm256_madd_epi16(yDiff, yDiff));
+            }
+            ySum64 = metric_add_epu32_to_epi64(ySum64, ySum32);
+        }
+        if (width16 < width) {
+            sumTail += metric_sse16_c((const uint8_t *)(pA + width16), pitchA, (const uint8_t *)(pB + width16), pitchB, width - width16, 1);
+        }
+    }
+    return metric_hsum_epi64(ySum64) + sumTail;
+}
+
+//16画素(4ブロック)x4行分の和を、ブロックごとの{ s1, s2, ss, s12 }に並べて格納する
+//各レーンは隣接する2画素の和になっているので、hadd で2レーンずつ足し合わせる
+//  X = hadd(S1, SS)  = [ s1_0 s1_1 ss_0 ss_1 | s1_2 s1_3 ss_2 ss_3 ]
+//  Y = hadd(S2, S12) = [ s2_0 s2_1 s12_0 s12_1 | ... ]
+static RGY_FORCEINLINE void metric_ssim4x4_store(int32_t (*sums)[4], __m256i yS1, __m256i yS2, __m256i ySS, __m256i yS12) {
+    const __m256i yX = _mm256_hadd_epi32(yS1, ySS);
+    const __m256i yY = _mm256_hadd_epi32(yS2, yS12);
+    const __m256i yLo = _mm256_unpacklo_epi32(yX, yY); //[ s1_0 s2_0 s1_1 s2_1 | s1_2 s2_2 s1_3 s2_3 ]
+    const __m256i yHi = _mm256_unpackhi_epi32(yX, yY); //[ ss_0 s12_0 ss_1 s12_1 | ss_2 s12_2 ss_3 s12_3 ]
+    const __m256i yP = _mm256_unpacklo_epi64(yLo, yHi); //[ blk0 | blk2 ]
+    const __m256i yQ = _mm256_unpackhi_epi64(yLo, yHi); //[ blk1 | blk3 ]
+    _mm256_storeu_si256((__m256i *)sums[0], _mm256_permute2x128_si256(yP, yQ, 0x20));
+    _mm256_storeu_si256((__m256i *)sums[2], _mm256_permute2x128_si256(yP, yQ, 0x31));
+}
+
+static RGY_FORCEINLINE void metric_ssim4x4_accumulate(__m256i& yS1, __m256i& yS2, __m256i& ySS, __m256i& yS12, __m256i yA, __m256i yB) {
+    const __m256i yOne = _mm256_set1_epi16(1);
+    yS1  = _mm256_add_epi32(yS1,  _mm256_madd_epi16(yA, yOne));
+    yS2  = _mm256_add_epi32(yS2,  _mm256_madd_epi16(yB, yOne));
+    ySS  = _mm256_add_epi32(ySS,  _mm256_add_epi32(_mm256_madd_epi16(yA, yA), _mm256_madd_epi16(yB, yB)));
+    yS12 = _mm256_add_epi32(yS12, _mm256_madd_epi16(yA, yB));
+}
+
+void metric_ssim4x4_8_avx2(int32_t (*sums)[4], const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int blocks) {
+    const int blocks4 = blocks & ~3;
+    for (int i = 0; i < blocks4; i += 4) {
+        __m256i yS1 = _mm256_setzero_si256(), yS2 = _mm256_setzero_si256(), ySS = _mm256_setzero_si256(), yS12 = _mm256_setzero_si256();
+        for (int y = 0; y < 4; y++) {
+            const __m256i yA = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(a + y * pitchA + i * 4)));
+            const __m256i yB = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(b + y * pitchB + i * 4)));
+            metric_ssim4x4_accumulate(yS1, yS2, ySS, yS12, yA, yB);
+        }
+        metric_ssim4x4_store(sums + i, yS1, yS2, ySS, yS12);
+    }
+    if (blocks4 < blocks) {
+        metric_ssim4x4_8_c(sums + blocks4, a + blocks4 * 4, pitchA, b + blocks4 * 4, pitchB, blocks - blocks4);
+    }
+}
+
+void metric_ssim4x4_16_avx2(int32_t (*sums)[4], const uint8_t *a, int pitchA, const uint8_t *b, int pitchB, int blocks) {
+    const int blocks4 = blocks & ~3;
+    for (int i = 0; i < blocks4; i += 4) {
+        __m256i yS1 = _mm256_setzero_si256(), yS2 = _mm256_setzero_si256(), ySS = _mm256_setzero_si256(), yS12 = _mm256_setzero_si256();
+        for (int y = 0; y < 4; y++) {
+            const __m256i yA = _mm256_loadu_si256((const __m256i *)((const uint16_t *)(a + y * pitchA) + i * 4));
+            const __m256i yB = _mm256_loadu_si256((const __m256i *)((const uint16_t *)(b + y * pitchB) + i * 4));
+            metric_ssim4x4_accumulate(yS1, yS2, ySS, yS12, yA, yB);
+        }
+        metric_ssim4x4_store(sums + i, yS1, yS2, ySS, yS12);
+    }
+    if (blocks4 < blocks) {
+        metric_ssim4x4_16_c(sums + blocks4, a + blocks4 * 8, pitchA, b + blocks4 * 8, pitchB, blocks - blocks4);
+    }
+}
+
+#endif //#if defined(_MSC_VER) || defined(__AVX2__)
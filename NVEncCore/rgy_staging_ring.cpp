@@ -0,0 +1,149 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "rgy_util.h"
+#include "rgy_staging_ring.h"
+
+//段数の自動調整を行う間隔 (フレーム数)
+static const int RGY_STAGING_RING_TUNE_INTERVAL = 16;
+//移動平均の係数
+static const double RGY_STAGING_RING_EMA_COEF = 1.0 / 16.0;
+
+RGYStagingRing::RGYStagingRing() :
+    m_mtx(),
+    m_slotState(),
+    m_slotSubmitUs(),
+    m_nDepth(0),
+    m_nCursor(0),
+    m_bAutoTune(false),
+    m_nLastSubmitUs(-1),
+    m_nStallsAtLastTune(0),
+    m_stats() {
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+RGYStagingRing::~RGYStagingRing() {
+    m_slotState.clear();
+    m_slotSubmitUs.clear();
+}
+
+void RGYStagingRing::init(int depth, int maxDepth, bool autoTune) {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    maxDepth = (std::max)(maxDepth, RGY_STAGING_RING_DEPTH_MIN);
+    m_slotState.assign(maxDepth, RGY_STAGING_SLOT_FREE);
+    m_slotSubmitUs.assign(maxDepth, 0);
+    m_nDepth = clamp(depth, RGY_STAGING_RING_DEPTH_MIN, maxDepth);
+    m_nCursor = 0;
+    m_bAutoTune = autoTune;
+    m_nLastSubmitUs = -1;
+    m_nStallsAtLastTune = 0;
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_stats.depth = m_nDepth;
+    m_stats.maxDepth = m_nDepth;
+}
+
+int RGYStagingRing::acquire() {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    //転送の終了順は読み込み順と同じなので、カーソルの位置から順に空きを探す
+    for (int i = 0; i < m_nDepth; i++) {
+        const int slot = (m_nCursor + i) % m_nDepth;
+        if (m_slotState[slot] == RGY_STAGING_SLOT_FREE) {
+            m_slotState[slot] = RGY_STAGING_SLOT_FILLING;
+            m_nCursor = (slot + 1) % m_nDepth;
+            m_stats.inflight++;
+            return slot;
+        }
+    }
+    return -1;
+}
+
+void RGYStagingRing::submit(int slot, int64_t nowUs) {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_slotState[slot] = RGY_STAGING_SLOT_INFLIGHT;
+    m_slotSubmitUs[slot] = nowUs;
+    if (m_nLastSubmitUs >= 0) {
+        const double period = (double)(nowUs - m_nLastSubmitUs);
+        m_stats.avgPeriodUs = (m_stats.frames <= 1) ? period : m_stats.avgPeriodUs + (period - m_stats.avgPeriodUs) * RGY_STAGING_RING_EMA_COEF;
+    }
+    m_nLastSubmitUs = nowUs;
+    m_stats.frames++;
+    if (m_bAutoTune && (m_stats.frames % RGY_STAGING_RING_TUNE_INTERVAL) == 0) {
+        tune();
+    }
+}
+
+void RGYStagingRing::release(int slot, int64_t nowUs) {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (m_slotState[slot] == RGY_STAGING_SLOT_INFLIGHT) {
+        const double inflight = (double)(nowUs - m_slotSubmitUs[slot]);
+        m_stats.avgInflightUs = (m_stats.avgInflightUs <= 0.0) ? inflight : m_stats.avgInflightUs + (inflight - m_stats.avgInflightUs) * RGY_STAGING_RING_EMA_COEF;
+    }
+    if (m_slotState[slot] != RGY_STAGING_SLOT_FREE) {
+        m_slotState[slot] = RGY_STAGING_SLOT_FREE;
+        m_stats.inflight--;
+    }
+}
+
+void RGYStagingRing::stall(int64_t waitUs) {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_stats.stalls++;
+    m_stats.stallUs += waitUs;
+}
+
+void RGYStagingRing::tune() {
+    if (m_stats.avgPeriodUs <= 0.0 || m_stats.avgInflightUs <= 0.0) {
+        return;
+    }
+    //スロットの使用時間の間に読み込まれるフレーム数 + 読み込み中の1スロット
+    const int required = clamp((int)std::ceil(m_stats.avgInflightUs / m_stats.avgPeriodUs) + 1, RGY_STAGING_RING_DEPTH_MIN, (int)m_slotState.size());
+    const bool stalled = m_stats.stalls > m_nStallsAtLastTune;
+    m_nStallsAtLastTune = m_stats.stalls;
+    if (stalled && required > m_nDepth) {
+        //待機が発生していれば、必要な段数まで一度に増やす
+        m_nDepth = required;
+    } else if (!stalled && required < m_nDepth - 1) {
+        //待機が発生していなければ、1段ずつ減らす
+        m_nDepth--;
+    }
+    m_nCursor %= m_nDepth;
+    m_stats.depth = m_nDepth;
+    m_stats.maxDepth = (std::max)(m_stats.maxDepth, m_nDepth);
+}
+
+int RGYStagingRing::depth() const {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_nDepth;
+}
+
+RGYStagingRing::Stats RGYStagingRing::stats() const {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_stats;
+}
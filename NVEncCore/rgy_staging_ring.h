@@ -0,0 +1,97 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#pragma once
+#ifndef __RGY_STAGING_RING_H__
+#define __RGY_STAGING_RING_H__
+
+#include <cstdint>
+#include <vector>
+#include <mutex>
+
+static const int RGY_STAGING_RING_DEPTH_MIN = 2;
+static const int RGY_STAGING_RING_DEPTH_MAX = 16;
+
+//入力フレームのアップロード用のステージングバッファ(リングバッファ)の管理
+//  読み込み側は空きスロットに読み込み(変換)を行い、先に読み込んだスロットの転送中も次の読み込みを進める
+//  スロットの実体(ピン留めしたホストメモリ等)は呼び出し側で管理し、ここではスロットの状態と段数のみを扱う
+//  時刻(us)は呼び出し側から与えるので、GPUなしで転送の遅延を模擬して動作を確認できる
+class RGYStagingRing {
+public:
+    struct Stats {
+        int64_t frames;        //読み込んだフレーム数
+        int64_t stalls;        //空きスロットを待機した回数
+        int64_t stallUs;       //空きスロットを待機した合計時間
+        double  avgPeriodUs;   //読み込みの間隔 (移動平均)
+        double  avgInflightUs; //スロットの使用開始から解放までの時間 (移動平均)
+        int     depth;         //現在の段数
+        int     maxDepth;      //これまでの最大の段数
+        int     inflight;      //使用中のスロット数
+    };
+
+    RGYStagingRing();
+    ~RGYStagingRing();
+
+    //depth: 初期の段数, maxDepth: 段数の上限 (スロット数), autoTune: 段数を自動調整する
+    void init(int depth, int maxDepth, bool autoTune);
+
+    //次に読み込みを行う空きスロットを取得する (空きがなければ-1)
+    int acquire();
+    //スロットへの読み込みが完了し、転送待ちとなった
+    void submit(int slot, int64_t nowUs);
+    //スロットの転送が完了し、再利用可能となった
+    void release(int slot, int64_t nowUs);
+    //空きスロットの待機にかかった時間を記録する
+    void stall(int64_t waitUs);
+
+    int depth() const;
+    int slots() const {
+        return (int)m_slotState.size();
+    }
+    Stats stats() const;
+protected:
+    //読み込みの間隔とスロットの使用時間から、必要な段数を見積もり、段数を調整する
+    void tune();
+
+    enum SlotState : uint8_t {
+        RGY_STAGING_SLOT_FREE,
+        RGY_STAGING_SLOT_FILLING,
+        RGY_STAGING_SLOT_INFLIGHT,
+    };
+    mutable std::mutex m_mtx;
+    std::vector<SlotState> m_slotState;
+    std::vector<int64_t> m_slotSubmitUs;
+    int m_nDepth;
+    int m_nCursor;
+    bool m_bAutoTune;
+    int64_t m_nLastSubmitUs;
+    int64_t m_nStallsAtLastTune;
+    Stats m_stats;
+};
+
+#endif //__RGY_STAGING_RING_H__
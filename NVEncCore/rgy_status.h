@@ -94,6 +94,7 @@ public:
         m_tmLastUpdate = std::chrono::system_clock::now();
         m_pause = false;
         m_bStdErrWriteToConsole = false;
+        m_bDisplay = true;
     }
     virtual ~EncodeStatus() {
         m_pRGYLog.reset();
@@ -113,6 +114,14 @@ public:
 #endif //#if defined(_WIN32) || defined(_WIN64)
     }
 
+    //複数の出力を行う場合に、結果の表示で区別するための名前
+    void SetName(const tstring& name) {
+        m_sName = name;
+    }
+    //進捗表示を行うかどうか (複数の出力を行う場合、進捗表示は主となる出力のみで行う)
+    void SetDisplay(bool display) {
+        m_bDisplay = display;
+    }
     void SetStart() {
         m_tmStart = std::chrono::system_clock::now();
         GetProcessTime(&m_sStartTime);
@@ -162,6 +171,9 @@ public:
         if (m_pRGYLog != nullptr && m_pRGYLog->getLogLevel() > RGY_LOG_INFO) {
             return RGY_ERR_NONE;
         }
+        if (!m_bDisplay) {
+            return RGY_ERR_NONE;
+        }
         if (m_sData.frameOut + m_sData.frameDrop <= 0) {
             return RGY_ERR_NONE;
         }
@@ -250,7 +262,7 @@ public:
                     (int)(m_sData.bitrateKbps + 0.5),
                     hh, mm, ss);
                 if (m_sData.frameDrop) {
-                    len += _stprintf_s(mes + len, _countof(mes) - len, _T(", afs drop %d/%d  "), m_sData.frameDrop, (m_sData.frameOut + m_sData.frameDrop));
+                    len += _stprintf_s(mes + len, _countof(mes) - len, _T(", drop %d/%d  "), m_sData.frameDrop, (m_sData.frameOut + m_sData.frameDrop));
                 }
                 if (bGPUUsage) {
                     len += _stprintf_s(mes + len, _countof(mes) - len, _T(", GPU %d%%"), gpuusage);
@@ -337,6 +349,10 @@ public:
         for (int i = 0; i < 79; i++)
             mes[i] = ' ';
         WriteLine(mes);
+        if (m_sName.length() > 0) {
+            _stprintf_s(mes, _countof(mes), _T("[%s]"), m_sName.c_str());
+            WriteLine(mes);
+        }
 
         m_sData.encodeFps = (m_sData.frameOut + m_sData.frameDrop) * 1000.0 / (double)time_elapsed64;
         m_sData.bitrateKbps = (m_sData.frameOut + m_sData.frameDrop == 0) ? 0 : (double)m_sData.outFileSize * (m_sData.outputFPSRate / (double)m_sData.outputFPSScale) / ((1000 / 8) * (m_sData.frameOut + m_sData.frameDrop));
@@ -424,6 +440,8 @@ protected:
     std::chrono::system_clock::time_point m_tmLastUpdate;     //最終更新時刻
     bool m_bStdErrWriteToConsole;
     bool m_bEncStarted;
+    bool m_bDisplay;                                          //進捗表示を行うかどうか
+    tstring m_sName;                                          //結果の表示に使用する名前
 };
 
 class CProcSpeedControl {
@@ -0,0 +1,418 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include "rgy_thread_affinity.h"
+#if defined(_WIN32) || defined(_WIN64)
+#include <initguid.h>
+#include <devguid.h>
+#include <devpkey.h>
+#include <setupapi.h>
+#pragma comment(lib, "setupapi.lib")
+#else
+#include <thread>
+#endif
+
+RGYCpuMask::RGYCpuMask(uint64_t mask) : m_bits() {
+    setWord(0, mask);
+}
+
+RGYCpuMask RGYCpuMask::fromList(const char *list) {
+    RGYCpuMask mask;
+    if (list == nullptr) {
+        return mask;
+    }
+    for (const auto& range : split(std::string(list), ",")) {
+        if (range.length() == 0) {
+            continue;
+        }
+        int first = 0, last = 0;
+        const int ret = sscanf_s(range.c_str(), "%d-%d", &first, &last);
+        if (ret == 1) {
+            last = first;
+        } else if (ret != 2) {
+            return RGYCpuMask();
+        }
+        if (first < 0 || last < first) {
+            return RGYCpuMask();
+        }
+        for (int i = first; i <= last; i++) {
+            mask.set(i);
+        }
+    }
+    return mask;
+}
+
+void RGYCpuMask::set(int index) {
+    if (index < 0) {
+        return;
+    }
+    if (index / 64 >= words()) {
+        m_bits.resize(index / 64 + 1, 0);
+    }
+    m_bits[index / 64] |= (uint64_t)1 << (index % 64);
+}
+
+bool RGYCpuMask::test(int index) const {
+    return index >= 0 && (word(index / 64) & ((uint64_t)1 << (index % 64))) != 0;
+}
+
+bool RGYCpuMask::empty() const {
+    return count() == 0;
+}
+
+int RGYCpuMask::count() const {
+    int count = 0;
+    for (const auto bits : m_bits) {
+        count += popcnt64(bits);
+    }
+    return count;
+}
+
+void RGYCpuMask::setWord(int group, uint64_t mask) {
+    if (group < 0) {
+        return;
+    }
+    if (group >= words()) {
+        m_bits.resize(group + 1, 0);
+    }
+    m_bits[group] = mask;
+}
+
+int RGYCpuMask::last() const {
+    for (int i = words() * 64 - 1; i >= 0; i--) {
+        if (test(i)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+tstring RGYCpuMask::to_string() const {
+    tstring str;
+    const int end = last();
+    for (int i = 0; i <= end; i++) {
+        if (!test(i)) {
+            continue;
+        }
+        int j = i;
+        while (j + 1 <= end && test(j + 1)) {
+            j++;
+        }
+        str += (i == j) ? strsprintf(_T(",%d"), i) : strsprintf(_T(",%d-%d"), i, j);
+        i = j;
+    }
+    return (str.length() > 0) ? str.substr(1) : str;
+}
+
+bool RGYCpuMask::operator==(const RGYCpuMask& x) const {
+    for (int i = 0; i < (std::max)(words(), x.words()); i++) {
+        if (word(i) != x.word(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+bool RGYCpuMask::operator!=(const RGYCpuMask& x) const {
+    return !(*this == x);
+}
+
+bool RGYAffinity::operator==(const RGYAffinity& x) const {
+    return mode == x.mode
+        && (mode != RGY_THREAD_AFFINITY_MODE_NODE   || node == x.node)
+        && (mode != RGY_THREAD_AFFINITY_MODE_CUSTOM || custom == x.custom);
+}
+bool RGYAffinity::operator!=(const RGYAffinity& x) const {
+    return !(*this == x);
+}
+
+tstring RGYAffinity::to_string() const {
+    switch (mode) {
+    case RGY_THREAD_AFFINITY_MODE_NUMA:   return _T("numa");
+    case RGY_THREAD_AFFINITY_MODE_NODE:   return strsprintf(_T("node%d"), node);
+    case RGY_THREAD_AFFINITY_MODE_CUSTOM: return strsprintf(_T("0x%llx"), (unsigned long long)custom);
+    case RGY_THREAD_AFFINITY_MODE_ALL:
+    default:                              return _T("all");
+    }
+}
+
+RGYThreadAffinity::RGYThreadAffinity() : m_affinity() {
+}
+
+void RGYThreadAffinity::set(RGYThreadType type, const RGYAffinity& affinity) {
+    if (type == RGY_THREAD_TYPE_ALL) {
+        for (int i = 0; i < RGY_THREAD_TYPE_MAX; i++) {
+            m_affinity[i] = affinity;
+        }
+    } else {
+        m_affinity[type] = affinity;
+    }
+}
+
+int RGYThreadAffinity::parse(const TCHAR *str) {
+    for (const auto& item : split(tstring(str), _T(","))) {
+        if (item.length() == 0) {
+            continue;
+        }
+        RGYThreadType type = RGY_THREAD_TYPE_ALL;
+        tstring value = item;
+        const auto pos = item.find_first_of(_T("="));
+        if (pos != std::string::npos) {
+            const auto typeName = item.substr(0, pos);
+            if (get_cx_index(list_thread_type, typeName.c_str()) < 0) {
+                return 1;
+            }
+            type = (RGYThreadType)get_cx_value(list_thread_type, typeName.c_str());
+            value = item.substr(pos + 1);
+        }
+        RGYAffinity affinity;
+        int node = 0;
+        unsigned long long mask = 0;
+        if (value == _T("all")) {
+            affinity.mode = RGY_THREAD_AFFINITY_MODE_ALL;
+        } else if (value == _T("numa")) {
+            affinity.mode = RGY_THREAD_AFFINITY_MODE_NUMA;
+        } else if (1 == _stscanf_s(value.c_str(), _T("node%d"), &node) && node >= 0) {
+            affinity.mode = RGY_THREAD_AFFINITY_MODE_NODE;
+            affinity.node = node;
+        } else if ((1 == _stscanf_s(value.c_str(), _T("0x%llx"), &mask)
+                 || 1 == _stscanf_s(value.c_str(), _T("0X%llx"), &mask)) && mask != 0) {
+            affinity.mode = RGY_THREAD_AFFINITY_MODE_CUSTOM;
+            affinity.custom = mask;
+        } else {
+            return 1;
+        }
+        set(type, affinity);
+    }
+    return 0;
+}
+
+tstring RGYThreadAffinity::to_string() const {
+    tstring str;
+    bool allSame = true;
+    for (int i = 1; i < RGY_THREAD_TYPE_MAX; i++) {
+        allSame &= (m_affinity[i] == m_affinity[0]);
+    }
+    if (allSame) {
+        return (enabled()) ? m_affinity[0].to_string() : _T("");
+    }
+    for (int i = 0; i < RGY_THREAD_TYPE_MAX; i++) {
+        if (m_affinity[i].mode != RGY_THREAD_AFFINITY_MODE_ALL) {
+            str += strsprintf(_T(",%s=%s"), get_chr_from_value(list_thread_type, i), m_affinity[i].to_string().c_str());
+        }
+    }
+    return (str.length() > 0) ? str.substr(1) : str;
+}
+
+bool RGYThreadAffinity::enabled() const {
+    for (int i = 0; i < RGY_THREAD_TYPE_MAX; i++) {
+        if (m_affinity[i].mode != RGY_THREAD_AFFINITY_MODE_ALL) {
+            return true;
+        }
+    }
+    return false;
+}
+
+RGYCpuMask RGYThreadAffinity::getMask(RGYThreadType type, int gpuNumaNode) const {
+    const auto& affinity = m_affinity[type];
+    switch (affinity.mode) {
+    case RGY_THREAD_AFFINITY_MODE_NUMA:   return (gpuNumaNode >= 0) ? rgy_numa_node_mask(gpuNumaNode) : RGYCpuMask();
+    case RGY_THREAD_AFFINITY_MODE_NODE:   return rgy_numa_node_mask(affinity.node);
+    case RGY_THREAD_AFFINITY_MODE_CUSTOM: return RGYCpuMask(affinity.custom);
+    case RGY_THREAD_AFFINITY_MODE_ALL:
+    default:                              return RGYCpuMask();
+    }
+}
+
+bool RGYThreadAffinity::operator==(const RGYThreadAffinity& x) const {
+    for (int i = 0; i < RGY_THREAD_TYPE_MAX; i++) {
+        if (m_affinity[i] != x.m_affinity[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+bool RGYThreadAffinity::operator!=(const RGYThreadAffinity& x) const {
+    return !(*this == x);
+}
+
+//"0000:01:00.0" (domain:bus:device.function) を分解する
+static bool parse_pci_bus_id(const char *pciBusId, int *domain, int *bus, int *device, int *function) {
+    return pciBusId != nullptr
+        && 4 == sscanf_s(pciBusId, "%x:%x:%x.%x", domain, bus, device, function);
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+
+int rgy_numa_node_count() {
+    ULONG highestNode = 0;
+    if (!GetNumaHighestNodeNumber(&highestNode)) {
+        return 1;
+    }
+    return (int)highestNode + 1;
+}
+
+RGYCpuMask rgy_numa_node_mask(int node) {
+    //GetNumaNodeProcessorMaskはプロセッサグループ0以外のノードを扱えないので、グループを含めて取得する
+    GROUP_AFFINITY affinity = { 0 };
+    RGYCpuMask mask;
+    if (node < 0 || node > USHRT_MAX || !GetNumaNodeProcessorMaskEx((USHORT)node, &affinity)) {
+        return mask;
+    }
+    mask.setWord(affinity.Group, (uint64_t)affinity.Mask);
+    return mask;
+}
+
+int rgy_pci_device_numa_node(const char *pciBusId) {
+    int domain = 0, bus = 0, device = 0, function = 0;
+    if (!parse_pci_bus_id(pciBusId, &domain, &bus, &device, &function)) {
+        return -1;
+    }
+    HDEVINFO hDevInfo = SetupDiGetClassDevs(&GUID_DEVCLASS_DISPLAY, nullptr, nullptr, DIGCF_PRESENT);
+    if (hDevInfo == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+    int numaNode = -1;
+    SP_DEVINFO_DATA devInfoData = { 0 };
+    devInfoData.cbSize = sizeof(devInfoData);
+    for (DWORD i = 0; numaNode < 0 && SetupDiEnumDeviceInfo(hDevInfo, i, &devInfoData); i++) {
+        DWORD devBus = 0, devAddress = 0;
+        if (!SetupDiGetDeviceRegistryProperty(hDevInfo, &devInfoData, SPDRP_BUSNUMBER, nullptr, (PBYTE)&devBus, sizeof(devBus), nullptr)
+            || !SetupDiGetDeviceRegistryProperty(hDevInfo, &devInfoData, SPDRP_ADDRESS, nullptr, (PBYTE)&devAddress, sizeof(devAddress), nullptr)) {
+            continue;
+        }
+        //SPDRP_ADDRESSは (device << 16) | function
+        if ((int)devBus != bus || (int)(devAddress >> 16) != device || (int)(devAddress & 0xffff) != function) {
+            continue;
+        }
+        DEVPROPTYPE propType = 0;
+        INT32 node = -1;
+        if (SetupDiGetDevicePropertyW(hDevInfo, &devInfoData, &DEVPKEY_Device_Numa_Node, &propType, (PBYTE)&node, sizeof(node), nullptr, 0)
+            && propType == DEVPROP_TYPE_UINT32) {
+            numaNode = node;
+        } else {
+            //NUMA非対応のシステムではプロパティが存在しない
+            numaNode = (rgy_numa_node_count() <= 1) ? 0 : -1;
+            break;
+        }
+    }
+    SetupDiDestroyDeviceInfoList(hDevInfo);
+    return numaNode;
+}
+
+bool rgy_set_thread_affinity(HANDLE thread, const RGYCpuMask& mask) {
+    if (thread == NULL || mask.empty()) {
+        return false;
+    }
+    int group = 0;
+    for (int i = 1; i < mask.words(); i++) {
+        if (popcnt64(mask.word(i)) > popcnt64(mask.word(group))) {
+            group = i;
+        }
+    }
+    //32bit版ではKAFFINITYは32bitなので、グループ内の先頭32プロセッサまでとなる
+    GROUP_AFFINITY affinity = { 0 };
+    affinity.Mask = (KAFFINITY)mask.word(group);
+    affinity.Group = (WORD)group;
+    return affinity.Mask != 0 && 0 != SetThreadGroupAffinity(thread, &affinity, nullptr);
+}
+
+#else //#if defined(_WIN32) || defined(_WIN64)
+
+static std::string read_sysfs_line(const std::string& path) {
+    std::ifstream ifs(path);
+    std::string line;
+    if (ifs) {
+        std::getline(ifs, line);
+    }
+    return line;
+}
+
+int rgy_numa_node_count() {
+    //"0-1", "0,2" のような形式 (オフラインのノードがあると番号は連続しない)
+    const auto nodes = RGYCpuMask::fromList(read_sysfs_line("/sys/devices/system/node/online").c_str());
+    return (std::max)(nodes.count(), 1);
+}
+
+RGYCpuMask rgy_numa_node_mask(int node) {
+    //"0-7,16-23" のような形式
+    const auto cpulist = read_sysfs_line(strsprintf("/sys/devices/system/node/node%d/cpulist", node));
+    if (cpulist.length() == 0) {
+        RGYCpuMask mask;
+        if (node != 0 || rgy_numa_node_count() > 1) {
+            return mask;
+        }
+        //NUMAの情報がなければ、すべての論理プロセッサとする (数が不明なら制限しない)
+        const int threads = (int)std::thread::hardware_concurrency();
+        for (int i = 0; i < threads; i++) {
+            mask.set(i);
+        }
+        return mask;
+    }
+    return RGYCpuMask::fromList(cpulist.c_str());
+}
+
+int rgy_pci_device_numa_node(const char *pciBusId) {
+    int domain = 0, bus = 0, device = 0, function = 0;
+    if (!parse_pci_bus_id(pciBusId, &domain, &bus, &device, &function)) {
+        return -1;
+    }
+    int node = -1;
+    const auto value = read_sysfs_line(strsprintf("/sys/bus/pci/devices/%04x:%02x:%02x.%x/numa_node", domain, bus, device, function));
+    if (1 != sscanf(value.c_str(), "%d", &node)) {
+        return -1;
+    }
+    //NUMA非対応のシステムでは-1が返る
+    return (node < 0 && rgy_numa_node_count() <= 1) ? 0 : node;
+}
+
+bool rgy_set_thread_affinity(HANDLE thread, const RGYCpuMask& mask) {
+    if (thread == NULL || mask.empty()) {
+        return false;
+    }
+    //cpu_set_tは1024個までなので、それを超えるプロセッサも扱えるよう動的に確保する
+    const int cpus = mask.last() + 1;
+    cpu_set_t *cpuset = CPU_ALLOC(cpus);
+    if (cpuset == nullptr) {
+        return false;
+    }
+    const size_t size = CPU_ALLOC_SIZE(cpus);
+    CPU_ZERO_S(size, cpuset);
+    for (int i = 0; i < cpus; i++) {
+        if (mask.test(i)) {
+            CPU_SET_S(i, size, cpuset);
+        }
+    }
+    const bool ret = 0 == pthread_setaffinity_np((pthread_t)thread, size, cpuset);
+    CPU_FREE(cpuset);
+    return ret;
+}
+
+#endif //#if defined(_WIN32) || defined(_WIN64)
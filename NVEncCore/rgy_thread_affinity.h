@@ -0,0 +1,144 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#pragma once
+#ifndef __RGY_THREAD_AFFINITY_H__
+#define __RGY_THREAD_AFFINITY_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "rgy_osdep.h"
+#include "rgy_tchar.h"
+#include "rgy_util.h"
+
+//スレッドの種類 (--thread-affinityで個別に指定可能)
+enum RGYThreadType {
+    RGY_THREAD_MAIN = 0,   //エンコードのメインループ
+    RGY_THREAD_DECODER,    //cuvidへのパケット投入スレッド
+    RGY_THREAD_INPUT,      //avcodecリーダーの読み込みスレッド
+    RGY_THREAD_OUTPUT,     //avcodecライターの出力スレッド
+    RGY_THREAD_AUDIO,      //avcodecライターの音声処理/エンコードスレッド
+    RGY_THREAD_BITSTREAM,  //エンコーダからのビットストリームの取り出しスレッド
+
+    RGY_THREAD_TYPE_MAX,
+    RGY_THREAD_TYPE_ALL = RGY_THREAD_TYPE_MAX,
+};
+
+const CX_DESC list_thread_type[] = {
+    { _T("all"),     RGY_THREAD_TYPE_ALL },
+    { _T("main"),    RGY_THREAD_MAIN },
+    { _T("decoder"), RGY_THREAD_DECODER },
+    { _T("input"),   RGY_THREAD_INPUT },
+    { _T("output"),  RGY_THREAD_OUTPUT },
+    { _T("audio"),   RGY_THREAD_AUDIO },
+    { _T("bitstream"), RGY_THREAD_BITSTREAM },
+    { NULL, 0 }
+};
+
+//論理プロセッサの集合 (64個を超えるプロセッサも扱う)
+//  64個ごとにuint64_tのビットで表し、Windowsではプロセッサグループごと、
+//  Linuxでは論理プロセッサの番号順 (word(cpu / 64)のbit(cpu % 64)) に格納する
+class RGYCpuMask {
+public:
+    RGYCpuMask() : m_bits() {};
+    //グループ0のマスクから作成する
+    explicit RGYCpuMask(uint64_t mask);
+    //"0-7,16-23" (sysfsのcpulist/nodeの形式) を解析する、不正な形式なら空を返す
+    static RGYCpuMask fromList(const char *list);
+
+    void set(int index);
+    bool test(int index) const;
+    bool empty() const;
+    int count() const;
+    int words() const { return (int)m_bits.size(); }
+    uint64_t word(int group) const { return (group >= 0 && group < words()) ? m_bits[group] : 0; }
+    void setWord(int group, uint64_t mask);
+    //最大の番号 (空なら-1)
+    int last() const;
+    //"0-7,64-71" の形式で返す (番号は group * 64 + グループ内の番号)
+    tstring to_string() const;
+
+    bool operator==(const RGYCpuMask& x) const;
+    bool operator!=(const RGYCpuMask& x) const;
+protected:
+    std::vector<uint64_t> m_bits;
+};
+
+enum RGYThreadAffinityMode {
+    RGY_THREAD_AFFINITY_MODE_ALL = 0, //制限しない
+    RGY_THREAD_AFFINITY_MODE_NUMA,    //GPUの接続されたNUMAノードのCPUに制限
+    RGY_THREAD_AFFINITY_MODE_NODE,    //指定したNUMAノードのCPUに制限
+    RGY_THREAD_AFFINITY_MODE_CUSTOM,  //指定したマスクのCPUに制限
+};
+
+struct RGYAffinity {
+    RGYThreadAffinityMode mode;
+    int node;        //RGY_THREAD_AFFINITY_MODE_NODEで使用
+    uint64_t custom; //RGY_THREAD_AFFINITY_MODE_CUSTOMで使用
+
+    RGYAffinity() : mode(RGY_THREAD_AFFINITY_MODE_ALL), node(0), custom(0) {};
+    bool operator==(const RGYAffinity& x) const;
+    bool operator!=(const RGYAffinity& x) const;
+    tstring to_string() const;
+};
+
+class RGYThreadAffinity {
+public:
+    RGYThreadAffinity();
+    //"[<thread>=]<affinity>[,...]"の形式の文字列を解析する
+    //成功すれば0を返す
+    int parse(const TCHAR *str);
+    //--thread-affinityの引数の形式で設定を返す (既定値なら空文字列)
+    tstring to_string() const;
+    //いずれかのスレッドに制限が設定されているか
+    bool enabled() const;
+    const RGYAffinity& get(RGYThreadType type) const { return m_affinity[type]; }
+    void set(RGYThreadType type, const RGYAffinity& affinity);
+    //gpuNumaNodeにはGPUの接続されたNUMAノードを渡す (不明なら-1)
+    //制限しない場合は空を返す
+    RGYCpuMask getMask(RGYThreadType type, int gpuNumaNode) const;
+
+    bool operator==(const RGYThreadAffinity& x) const;
+    bool operator!=(const RGYThreadAffinity& x) const;
+protected:
+    RGYAffinity m_affinity[RGY_THREAD_TYPE_MAX];
+};
+
+//NUMAノードの数を返す
+int rgy_numa_node_count();
+//指定したNUMAノードに属する論理プロセッサを返す (取得できなければ空)
+RGYCpuMask rgy_numa_node_mask(int node);
+//PCI Bus ID ("0000:01:00.0"の形式) からデバイスの接続されたNUMAノードを返す (不明なら-1)
+int rgy_pci_device_numa_node(const char *pciBusId);
+
+//スレッドのaffinityを設定する (maskが空なら何もしない)
+//Windowsではスレッドは1つのプロセッサグループにしか属せないので、maskのうち最も多くのプロセッサを含むグループに制限する
+bool rgy_set_thread_affinity(HANDLE thread, const RGYCpuMask& mask);
+
+#endif //__RGY_THREAD_AFFINITY_H__
@@ -0,0 +1,120 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include "rgy_thread_pool.h"
+
+RGYThreadPool::RGYThreadPool() :
+    m_threads(),
+    m_mtx(),
+    m_cvStart(),
+    m_cvFin(),
+    m_func(nullptr),
+    m_bands(0),
+    m_next(0),
+    m_running(0),
+    m_generation(0),
+    m_abort(false) {
+}
+
+RGYThreadPool::~RGYThreadPool() {
+    close();
+}
+
+void RGYThreadPool::init(int threads) {
+    close();
+    m_abort = false;
+    //呼び出し元のスレッドも処理に参加するので、threads-1個のスレッドを起動する
+    for (int i = 1; i < threads; i++) {
+        m_threads.push_back(std::thread(&RGYThreadPool::worker, this));
+    }
+}
+
+void RGYThreadPool::close() {
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_abort = true;
+    }
+    m_cvStart.notify_all();
+    for (auto& th : m_threads) {
+        if (th.joinable()) {
+            th.join();
+        }
+    }
+    m_threads.clear();
+}
+
+void RGYThreadPool::run(int bands, const std::function<void(int)>& func) {
+    if (m_threads.size() == 0 || bands <= 1) {
+        for (int i = 0; i < bands; i++) {
+            func(i);
+        }
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_func = &func;
+        m_bands = bands;
+        m_next = 0;
+        m_running = (int)m_threads.size();
+        m_generation++;
+    }
+    m_cvStart.notify_all();
+    for (;;) {
+        int band = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            if (m_next >= m_bands) break;
+            band = m_next++;
+        }
+        func(band);
+    }
+    std::unique_lock<std::mutex> lock(m_mtx);
+    m_cvFin.wait(lock, [this]() { return m_running == 0; });
+    m_func = nullptr;
+}
+
+void RGYThreadPool::worker() {
+    uint64_t generation = 0;
+    std::unique_lock<std::mutex> lock(m_mtx);
+    for (;;) {
+        m_cvStart.wait(lock, [this, &generation]() { return m_abort || m_generation != generation; });
+        if (m_abort) {
+            break;
+        }
+        generation = m_generation;
+        while (m_next < m_bands) {
+            const int band = m_next++;
+            lock.unlock();
+            (*m_func)(band);
+            lock.lock();
+        }
+        if (--m_running == 0) {
+            m_cvFin.notify_one();
+        }
+    }
+}
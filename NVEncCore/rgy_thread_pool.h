@@ -0,0 +1,65 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#pragma once
+#ifndef __RGY_THREAD_POOL_H__
+#define __RGY_THREAD_POOL_H__
+
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+//行方向に分割して並列処理するためのスレッドプール
+class RGYThreadPool {
+public:
+    RGYThreadPool();
+    ~RGYThreadPool();
+    void init(int threads);
+    void close();
+    int threads() const { return (int)m_threads.size() + 1; }
+    //func(band)をband = 0 ... bands-1について並列に実行し、終了を待つ
+    void run(int bands, const std::function<void(int)>& func);
+protected:
+    void worker();
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mtx;
+    std::condition_variable m_cvStart;
+    std::condition_variable m_cvFin;
+    const std::function<void(int)> *m_func;
+    int m_bands;
+    int m_next;
+    int m_running;
+    uint64_t m_generation;
+    bool m_abort;
+};
+
+#endif //__RGY_THREAD_POOL_H__
@@ -690,6 +690,7 @@ enum RGY_INPUT_FMT {
     RGY_INPUT_FMT_AVHW,
     RGY_INPUT_FMT_AVSW,
     RGY_INPUT_FMT_AVANY,
+    RGY_INPUT_FMT_SHM,
 };
 
 #pragma warning(push)
@@ -863,6 +864,10 @@ enum {
 static const int RGY_OUTPUT_THREAD_AUTO = -1;
 static const int RGY_AUDIO_THREAD_AUTO = -1;
 static const int RGY_INPUT_THREAD_AUTO = -1;
+static const int RGY_AVS_PREFETCH_DEFAULT = 4;  //avs読み込みで先読みするフレーム数
+static const int RGY_AVS_PREFETCH_MAX = 64;
+static const int RGY_AUTOCROP_SAMPLES_DEFAULT = 12; //自動cropで解析するフレーム数
+static const int RGY_AUTOCROP_SAMPLES_MAX = 120;
 
 typedef struct {
     int start, fin;
@@ -79,6 +79,7 @@ const char *get_encoder_version();
 #define ENABLE_AVISYNTH_READER    0
 #define ENABLE_VAPOURSYNTH_READER 0
 #define ENABLE_AVSW_READER 0
+#define ENABLE_SHM_READER         0
 #else
 #define ENCODER_NAME "NVEncC"
 #define DECODER_NAME "cuvid"
@@ -88,6 +89,7 @@ const char *get_encoder_version();
 #define ENABLE_AVISYNTH_READER    1
 #define ENABLE_VAPOURSYNTH_READER 1
 #define ENABLE_AVSW_READER        1
+#define ENABLE_SHM_READER         1
 #endif
 
 #endif //__RGY_CONFIG_H__
@@ -0,0 +1,76 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include "rgy_test.h"
+
+static std::mutex g_testMtx;
+static int g_testFailed = 0;
+static int g_testSkipped = 0;
+
+std::vector<RGYTestCase>& rgy_test_list() {
+    static std::vector<RGYTestCase> list;
+    return list;
+}
+
+void rgy_test_fail(const char *file, int line, const char *expr) {
+    std::lock_guard<std::mutex> lock(g_testMtx);
+    fprintf(stderr, "  %s(%d): check failed: %s\n", file, line, expr);
+    g_testFailed++;
+}
+
+void rgy_test_skip(const char *reason) {
+    std::lock_guard<std::mutex> lock(g_testMtx);
+    fprintf(stderr, "  skipped: %s\n", reason);
+    g_testSkipped++;
+}
+
+//引数を指定した場合は、名前にその文字列を含むテストのみ実行する
+int main(int argc, char **argv) {
+    const char *filter = (argc > 1) ? argv[1] : nullptr;
+    int run = 0, failed = 0, skipped = 0;
+    for (const auto& test : rgy_test_list()) {
+        if (filter && strstr(test.name, filter) == nullptr) {
+            continue;
+        }
+        fprintf(stderr, "[ RUN  ] %s\n", test.name);
+        const int failedBefore = g_testFailed;
+        const int skippedBefore = g_testSkipped;
+        test.func();
+        const bool ok = g_testFailed == failedBefore;
+        const bool skip = ok && g_testSkipped != skippedBefore;
+        fprintf(stderr, "[ %s ] %s\n", (skip) ? "SKIP" : ((ok) ? " OK " : "FAIL"), test.name);
+        run++;
+        failed += (ok) ? 0 : 1;
+        skipped += (skip) ? 1 : 0;
+    }
+    fprintf(stderr, "%d tests, %d failed, %d skipped.\n", run, failed, skipped);
+    return (failed) ? 1 : 0;
+}
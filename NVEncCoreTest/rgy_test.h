@@ -0,0 +1,70 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#pragma once
+#ifndef __RGY_TEST_H__
+#define __RGY_TEST_H__
+
+#include <vector>
+
+//単体テスト
+//  RGY_TEST(name)でテストを登録し、RGY_CHECKで検証する
+//  GPUを必要とするテストは、使用可能なデバイスがなければRGY_SKIPで抜ける
+typedef void (*RGYTestFunc)();
+
+struct RGYTestCase {
+    const char *name;
+    RGYTestFunc func;
+};
+
+std::vector<RGYTestCase>& rgy_test_list();
+
+//検証の失敗を記録する (複数のスレッドから呼んでもよい)
+void rgy_test_fail(const char *file, int line, const char *expr);
+//テストを実行できない環境であることを記録する
+void rgy_test_skip(const char *reason);
+
+struct RGYTestRegister {
+    RGYTestRegister(const char *name, RGYTestFunc func) {
+        rgy_test_list().push_back({ name, func });
+    }
+};
+
+#define RGY_TEST(name) \
+    static void rgy_test_##name(); \
+    static RGYTestRegister rgy_test_register_##name(#name, rgy_test_##name); \
+    static void rgy_test_##name()
+
+//失敗した場合は、その関数から抜ける
+#define RGY_CHECK(expr) \
+    do { if (!(expr)) { rgy_test_fail(__FILE__, __LINE__, #expr); return; } } while (0)
+
+#define RGY_SKIP(reason) \
+    do { rgy_test_skip(reason); return; } while (0)
+
+#endif //__RGY_TEST_H__
@@ -0,0 +1,159 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include "rgy_test.h"
+#include "NVEncBitstreamCollector.h"
+
+//エンコーダAPIの代わりに、出力バッファにフレーム番号を記録して取り出しを模擬する
+//  dwBitstreamBufferSize ... pushしたフレーム番号
+struct CollectorTestEncoder {
+    int busyCount;             //各フレームでwaitFinがNV_ENC_ERR_ENCODER_BUSYを返す回数
+    int failFrame;             //copyでエラーを返すフレーム番号 (-1で失敗しない)
+    std::vector<int> waitCall; //フレームごとのwaitFinの呼び出し回数
+    std::vector<int> written;  //書き出されたフレーム番号
+
+    CollectorTestEncoder(int frames) : busyCount(0), failFrame(-1), waitCall(frames, 0), written() {}
+
+    NVEncBitstreamCollector::Funcs funcs() {
+        NVEncBitstreamCollector::Funcs funcs;
+        funcs.waitFin = [this](const EncodeBuffer *pEncodeBuffer, uint32_t timeoutMs) {
+            UNREFERENCED_PARAMETER(timeoutMs);
+            const int frame = (int)pEncodeBuffer->stOutputBfr.dwBitstreamBufferSize;
+            if (busyCount < 0 || waitCall[frame]++ < busyCount) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                return NV_ENC_ERR_ENCODER_BUSY;
+            }
+            return NV_ENC_SUCCESS;
+        };
+        funcs.copy = [this](const EncodeBuffer *pEncodeBuffer, RGYBitstream *pBitstream) {
+            const int frame = (int)pEncodeBuffer->stOutputBfr.dwBitstreamBufferSize;
+            if (frame == failFrame) {
+                return NV_ENC_ERR_GENERIC;
+            }
+            const uint8_t data[4] = { 0, 0, 1, (uint8_t)frame };
+            if (pBitstream->copy(data, sizeof(data)) != RGY_ERR_NONE) {
+                return NV_ENC_ERR_OUT_OF_MEMORY;
+            }
+            pBitstream->setFrameIdx(frame);
+            return NV_ENC_SUCCESS;
+        };
+        funcs.write = [this](RGYBitstream *pBitstream) {
+            written.push_back(pBitstream->frameIdx());
+            return NV_ENC_SUCCESS;
+        };
+        return funcs;
+    }
+};
+
+//出力バッファをリングとして使いまわしながらエンコードを模擬する
+//各フレームの出力バッファは、再利用前にwaitOldestで取り出しの終了を待つ
+static NVENCSTATUS collector_test_encode(NVEncBitstreamCollector& collector, std::vector<EncodeBuffer>& buffers, int frames) {
+    for (int i = 0; i < frames; i++) {
+        EncodeBuffer *pEncodeBuffer = &buffers[i % buffers.size()];
+        NVENCSTATUS sts = NV_ENC_SUCCESS;
+        if (i >= (int)buffers.size() && (sts = collector.waitOldest(pEncodeBuffer)) != NV_ENC_SUCCESS) {
+            return sts;
+        }
+        pEncodeBuffer->stOutputBfr.dwBitstreamBufferSize = i;
+        if ((sts = collector.push(pEncodeBuffer)) != NV_ENC_SUCCESS) {
+            return sts;
+        }
+    }
+    return NV_ENC_SUCCESS;
+}
+
+RGY_TEST(bitstream_collector_invalid_call) {
+    CollectorTestEncoder encoder(1);
+    NVEncBitstreamCollector collector;
+    EncodeBuffer buffer = { 0 };
+    RGY_CHECK(collector.push(&buffer) == NV_ENC_ERR_INVALID_CALL);
+    auto funcs = encoder.funcs();
+    funcs.write = nullptr;
+    RGY_CHECK(collector.start(funcs) == NV_ENC_ERR_INVALID_PARAM);
+    RGY_CHECK(collector.start(encoder.funcs()) == NV_ENC_SUCCESS);
+    RGY_CHECK(collector.start(encoder.funcs()) == NV_ENC_ERR_INVALID_CALL);
+    RGY_CHECK(collector.finish() == NV_ENC_SUCCESS);
+}
+
+//エンコードの終了が遅れても、投入順に出力される
+RGY_TEST(bitstream_collector_order) {
+    static const int FRAMES = 64;
+    CollectorTestEncoder encoder(FRAMES);
+    encoder.busyCount = 2;
+    std::vector<EncodeBuffer> buffers(4);
+    memset(buffers.data(), 0, sizeof(buffers[0]) * buffers.size());
+    NVEncBitstreamCollector collector;
+    RGY_CHECK(collector.start(encoder.funcs()) == NV_ENC_SUCCESS);
+    RGY_CHECK(collector_test_encode(collector, buffers, FRAMES) == NV_ENC_SUCCESS);
+    RGY_CHECK(collector.finish() == NV_ENC_SUCCESS);
+    RGY_CHECK(collector.pending() == 0);
+    RGY_CHECK(collector.frames() == FRAMES);
+    RGY_CHECK((int)encoder.written.size() == FRAMES);
+    for (int i = 0; i < FRAMES; i++) {
+        RGY_CHECK(encoder.written[i] == i);
+        RGY_CHECK(encoder.waitCall[i] == encoder.busyCount + 1);
+    }
+}
+
+//取り出しでエラーが発生した場合、以降のフレームは出力せず、メインスレッドにエラーを返す
+RGY_TEST(bitstream_collector_error) {
+    static const int FRAMES = 32;
+    CollectorTestEncoder encoder(FRAMES);
+    encoder.failFrame = 5;
+    std::vector<EncodeBuffer> buffers(4);
+    memset(buffers.data(), 0, sizeof(buffers[0]) * buffers.size());
+    NVEncBitstreamCollector collector;
+    RGY_CHECK(collector.start(encoder.funcs()) == NV_ENC_SUCCESS);
+    RGY_CHECK(collector_test_encode(collector, buffers, FRAMES) == NV_ENC_ERR_GENERIC);
+    RGY_CHECK(collector.finish() == NV_ENC_ERR_GENERIC);
+    RGY_CHECK(collector.frames() == encoder.failFrame);
+    RGY_CHECK((int)encoder.written.size() == encoder.failFrame);
+    for (int i = 0; i < encoder.failFrame; i++) {
+        RGY_CHECK(encoder.written[i] == i);
+    }
+}
+
+//エンコードが終了しないまま中断しても、スレッドは終了する
+RGY_TEST(bitstream_collector_abort) {
+    CollectorTestEncoder encoder(1);
+    encoder.busyCount = -1;
+    EncodeBuffer buffer = { 0 };
+    NVEncBitstreamCollector collector;
+    RGY_CHECK(collector.start(encoder.funcs()) == NV_ENC_SUCCESS);
+    RGY_CHECK(collector.push(&buffer) == NV_ENC_SUCCESS);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    collector.abort();
+    RGY_CHECK(collector.error() != NV_ENC_SUCCESS);
+    RGY_CHECK(collector.waitOldest(&buffer) != NV_ENC_SUCCESS);
+    RGY_CHECK(collector.frames() == 0);
+    RGY_CHECK(encoder.written.size() == 0);
+}
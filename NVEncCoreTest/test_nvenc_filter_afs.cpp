@@ -0,0 +1,229 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <memory>
+#include "rgy_test.h"
+#include "rgy_log.h"
+#include "NVEncFilterAfs.h"
+
+//CPU版afs (--vpp-afs cpu=true) とGPU版の結果を比較する
+//  yuv420の色差のサンプリングと画面端の処理はビット単位では一致しないため、
+//  フレーム数とタイムスタンプ(=各フレームの判定結果)は完全一致、画素値は誤差を許容して比較する
+
+static const int AFS_TEST_WIDTH  = 320;
+static const int AFS_TEST_HEIGHT = 240;
+static const int AFS_TEST_FRAMES = 40;
+
+struct AfsTestFrames {
+    RGY_CSP csp;
+    int pixel_size;
+    int pitch;
+    std::vector<std::vector<uint8_t>> frames;
+};
+
+struct AfsTestResult {
+    std::vector<std::vector<uint8_t>> frames;
+    std::vector<int64_t> timestamp;
+    std::vector<int64_t> duration;
+};
+
+static void afs_test_set(uint8_t *ptr, int pixel_size, int value) {
+    if (pixel_size > 1) {
+        *(uint16_t *)ptr = (uint16_t)(value << 8);
+    } else {
+        *ptr = (uint8_t)value;
+    }
+}
+
+//24pの絵柄 (移動する矩形とグラデーション)
+//  Y(height行), U(height/2行), V(height/2行)をY面と同じpitchで配置する
+static std::vector<uint8_t> afs_test_progressive(const AfsTestFrames& prm, int index) {
+    std::vector<uint8_t> buf((size_t)prm.pitch * AFS_TEST_HEIGHT * 2, 0);
+    const int box_x = 40 + index * 6, box_y = 48 + index * 2;
+    for (int y = 0; y < AFS_TEST_HEIGHT; y++) {
+        for (int x = 0; x < AFS_TEST_WIDTH; x++) {
+            const bool box = box_x <= x && x < box_x + 64 && box_y <= y && y < box_y + 64;
+            const int luma = (box) ? 210 : 32 + ((x + y + index * 4) & 127);
+            afs_test_set(buf.data() + (size_t)prm.pitch * y + x * prm.pixel_size, prm.pixel_size, luma);
+        }
+    }
+    for (int y = 0; y < AFS_TEST_HEIGHT / 2; y++) {
+        for (int x = 0; x < AFS_TEST_WIDTH / 2; x++) {
+            const bool box = box_x <= x * 2 && x * 2 < box_x + 64 && box_y <= y * 2 && y * 2 < box_y + 64;
+            afs_test_set(buf.data() + (size_t)prm.pitch * (AFS_TEST_HEIGHT + y)         + x * prm.pixel_size, prm.pixel_size, (box) ?  96 : 128 + ((x + index) & 15));
+            afs_test_set(buf.data() + (size_t)prm.pitch * (AFS_TEST_HEIGHT * 3 / 2 + y) + x * prm.pixel_size, prm.pixel_size, (box) ? 176 : 128 - ((y + index) & 15));
+        }
+    }
+    return buf;
+}
+
+//24pの絵柄を2:3プルダウンして、30i(TFF)のフレーム列を作成する
+static AfsTestFrames afs_test_telecine(RGY_CSP csp) {
+    AfsTestFrames prm;
+    prm.csp = csp;
+    prm.pixel_size = (RGY_CSP_BIT_DEPTH[csp] > 8) ? 2 : 1;
+    prm.pitch = AFS_TEST_WIDTH * prm.pixel_size;
+
+    std::vector<int> fields;
+    for (int i = 0; (int)fields.size() < AFS_TEST_FRAMES * 2; i++) {
+        for (int j = 0; j < ((i & 1) ? 3 : 2); j++) {
+            fields.push_back(i);
+        }
+    }
+    std::vector<std::vector<uint8_t>> progressive;
+    for (int i = 0; i <= fields.back(); i++) {
+        progressive.push_back(afs_test_progressive(prm, i));
+    }
+    //各面の偶数行をトップフィールド、奇数行をボトムフィールドから取る
+    const int rows = AFS_TEST_HEIGHT * 2;
+    for (int i = 0; i < AFS_TEST_FRAMES; i++) {
+        const auto& top    = progressive[fields[i * 2 + 0]];
+        const auto& bottom = progressive[fields[i * 2 + 1]];
+        std::vector<uint8_t> frame(top.size());
+        for (int y = 0; y < rows; y++) {
+            const auto& src = (y & 1) ? bottom : top;
+            memcpy(frame.data() + (size_t)prm.pitch * y, src.data() + (size_t)prm.pitch * y, prm.pitch);
+        }
+        prm.frames.push_back(std::move(frame));
+    }
+    return prm;
+}
+
+static bool afs_test_download(AfsTestResult *result, const FrameInfo *frame, const AfsTestFrames& prm) {
+    std::vector<uint8_t> buf((size_t)prm.pitch * AFS_TEST_HEIGHT * 2, 0);
+    if (cudaMemcpy2D(buf.data(), prm.pitch, frame->ptr, frame->pitch, prm.pitch, AFS_TEST_HEIGHT * 3 / 2, cudaMemcpyDeviceToHost) != cudaSuccess) {
+        return false;
+    }
+    result->frames.push_back(std::move(buf));
+    result->timestamp.push_back(frame->timestamp);
+    result->duration.push_back(frame->duration);
+    return true;
+}
+
+static bool afs_test_run(const AfsTestFrames& prm, bool cpu, AfsTestResult *result) {
+    FrameInfo frameInfo = { 0 };
+    frameInfo.csp = prm.csp;
+    frameInfo.width = AFS_TEST_WIDTH;
+    frameInfo.height = AFS_TEST_HEIGHT;
+    frameInfo.picstruct = RGY_PICSTRUCT_FRAME_TFF;
+    frameInfo.deivce_mem = true;
+
+    shared_ptr<NVEncFilterParamAfs> param(new NVEncFilterParamAfs());
+    NVEncFilterAfs::set_preset(&param->afs, AFS_PRESET_ANIME);
+    param->afs.enable = true;
+    param->afs.tb_order = 1;
+    param->afs.cpu = cpu;
+    param->frameIn = frameInfo;
+    param->frameOut = frameInfo;
+    param->inFps = rgy_rational<int>(30000, 1001);
+    param->outTimebase = rgy_rational<int>(1001, 120000);
+    param->bOutOverwrite = false;
+
+    NVEncFilterAfs afs;
+    if (afs.init(param, shared_ptr<RGYLog>(new RGYLog(nullptr, RGY_LOG_ERROR))) != NV_ENC_SUCCESS) {
+        return false;
+    }
+    CUFrameBuf input(frameInfo);
+    if (input.alloc() != cudaSuccess) {
+        return false;
+    }
+    for (int i = 0; i <= (int)prm.frames.size() + 16; i++) {
+        FrameInfo *pInput = &input.frame;
+        FrameInfo drain = frameInfo;
+        if (i < (int)prm.frames.size()) {
+            if (cudaMemcpy2D(input.frame.ptr, input.frame.pitch, prm.frames[i].data(), prm.pitch, prm.pitch, AFS_TEST_HEIGHT * 3 / 2, cudaMemcpyHostToDevice) != cudaSuccess) {
+                return false;
+            }
+            input.frame.timestamp = i * 4;
+            input.frame.duration = 4;
+        } else {
+            drain.ptr = nullptr;
+            pInput = &drain;
+        }
+        FrameInfo *outFrames[1] = { nullptr };
+        int outNum = 0;
+        if (afs.filter(pInput, outFrames, &outNum) != NV_ENC_SUCCESS) {
+            return false;
+        }
+        if (outNum > 0 && !afs_test_download(result, outFrames[0], prm)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//各面の平均誤差 (8bit換算)
+static double afs_test_mean_diff(const AfsTestFrames& prm, const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, int plane) {
+    const int y_start = (plane == 0) ? 0 : AFS_TEST_HEIGHT + (plane - 1) * AFS_TEST_HEIGHT / 2;
+    const int height = (plane == 0) ? AFS_TEST_HEIGHT : AFS_TEST_HEIGHT / 2;
+    const int width  = (plane == 0) ? AFS_TEST_WIDTH  : AFS_TEST_WIDTH / 2;
+    double sum = 0.0;
+    for (int y = y_start; y < y_start + height; y++) {
+        for (int x = 0; x < width; x++) {
+            const uint8_t *pa = a.data() + (size_t)prm.pitch * y + x * prm.pixel_size;
+            const uint8_t *pb = b.data() + (size_t)prm.pitch * y + x * prm.pixel_size;
+            const int va = (prm.pixel_size > 1) ? *(const uint16_t *)pa >> 8 : *pa;
+            const int vb = (prm.pixel_size > 1) ? *(const uint16_t *)pb >> 8 : *pb;
+            sum += std::abs(va - vb);
+        }
+    }
+    return sum / (width * height);
+}
+
+static void afs_test_compare(RGY_CSP csp) {
+    int deviceCount = 0;
+    if (cudaGetDeviceCount(&deviceCount) != cudaSuccess || deviceCount == 0) {
+        RGY_SKIP("no CUDA device.");
+    }
+    const auto prm = afs_test_telecine(csp);
+    AfsTestResult gpu, cpu;
+    RGY_CHECK(afs_test_run(prm, false, &gpu));
+    RGY_CHECK(afs_test_run(prm, true,  &cpu));
+    //2:3プルダウンを解除してdropありなので、出力は入力の4/5程度になる
+    RGY_CHECK(gpu.frames.size() > 0 && gpu.frames.size() < prm.frames.size());
+    RGY_CHECK(cpu.frames.size() == gpu.frames.size());
+    RGY_CHECK(cpu.timestamp == gpu.timestamp);
+    RGY_CHECK(cpu.duration == gpu.duration);
+    for (size_t i = 0; i < gpu.frames.size(); i++) {
+        RGY_CHECK(afs_test_mean_diff(prm, cpu.frames[i], gpu.frames[i], 0) < 0.5);
+        RGY_CHECK(afs_test_mean_diff(prm, cpu.frames[i], gpu.frames[i], 1) < 2.0);
+        RGY_CHECK(afs_test_mean_diff(prm, cpu.frames[i], gpu.frames[i], 2) < 2.0);
+    }
+}
+
+RGY_TEST(afs_cpu_gpu_equivalence_yv12) {
+    afs_test_compare(RGY_CSP_YV12);
+}
+
+RGY_TEST(afs_cpu_gpu_equivalence_yv12_16) {
+    afs_test_compare(RGY_CSP_YV12_16);
+}
@@ -0,0 +1,306 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <memory>
+#include "rgy_test.h"
+#include "NVEncFilterResizeCpu.h"
+
+static const RGY_RESIZE_CPU RESIZE_CPU_TEST_ALGO[] = {
+    RGY_RESIZE_CPU_BILINEAR, RGY_RESIZE_CPU_BICUBIC,
+    RGY_RESIZE_CPU_SPLINE16, RGY_RESIZE_CPU_SPLINE36, RGY_RESIZE_CPU_SPLINE64,
+    RGY_RESIZE_CPU_LANCZOS2, RGY_RESIZE_CPU_LANCZOS3,
+};
+
+//--- 係数テーブル -----------------------------------------------------------------------
+RGY_TEST(resize_cpu_coef_normalized) {
+    static const int SIZES[][2] = {
+        { 1920, 1280 }, { 1280, 1920 }, { 64, 64 }, { 7, 3 }, { 3, 7 }, { 5, 1 }, { 2, 9 }, { 1, 4 },
+    };
+    for (auto algo : RESIZE_CPU_TEST_ALGO) {
+        for (const auto& size : SIZES) {
+            const auto coef = resize_cpu_get_coef(size[0], size[1], algo);
+            RGY_CHECK(coef->srcSize == size[0] && coef->dstSize == size[1] && coef->algo == algo);
+            RGY_CHECK(coef->taps >= 1 && coef->taps <= size[0]);
+            RGY_CHECK((int)coef->start.size() == size[1]);
+            RGY_CHECK((int)coef->weight.size() == coef->taps * size[1]);
+            for (int x = 0; x < size[1]; x++) {
+                //参照範囲は常に入力の範囲内
+                RGY_CHECK(0 <= coef->start[x] && coef->start[x] + coef->taps <= size[0]);
+                double sum = 0.0;
+                for (int t = 0; t < coef->taps; t++) {
+                    sum += coef->weight[(size_t)t * size[1] + x];
+                }
+                RGY_CHECK(std::abs(sum - 1.0) < 1e-5);
+            }
+        }
+    }
+}
+
+RGY_TEST(resize_cpu_coef_taps) {
+    //拡大時はフィルタの直径、縮小時は縮小率に合わせて広がる
+    RGY_CHECK(resize_cpu_get_coef(100, 200, RGY_RESIZE_CPU_BILINEAR)->taps == 2);
+    RGY_CHECK(resize_cpu_get_coef(200, 100, RGY_RESIZE_CPU_BILINEAR)->taps == 4);
+    RGY_CHECK(resize_cpu_get_coef(100, 200, RGY_RESIZE_CPU_SPLINE36)->taps == 6);
+    RGY_CHECK(resize_cpu_get_coef(200, 100, RGY_RESIZE_CPU_SPLINE36)->taps == 12);
+    RGY_CHECK(resize_cpu_get_coef(100, 200, RGY_RESIZE_CPU_SPLINE64)->taps == 8);
+    RGY_CHECK(resize_cpu_get_coef(100, 200, RGY_RESIZE_CPU_LANCZOS2)->taps == 4);
+    //入力が小さい場合は入力のサイズまで
+    RGY_CHECK(resize_cpu_get_coef(3, 200, RGY_RESIZE_CPU_SPLINE64)->taps == 3);
+}
+
+RGY_TEST(resize_cpu_coef_identity) {
+    //同じサイズでは、整数位置での重みは中心のみ1となる
+    for (auto algo : RESIZE_CPU_TEST_ALGO) {
+        const auto coef = resize_cpu_get_coef(64, 64, algo);
+        for (int x = 0; x < 64; x++) {
+            for (int t = 0; t < coef->taps; t++) {
+                const float expected = (coef->start[x] + t == x) ? 1.0f : 0.0f;
+                RGY_CHECK(std::abs(coef->weight[(size_t)t * 64 + x] - expected) < 1e-5f);
+            }
+        }
+    }
+}
+
+RGY_TEST(resize_cpu_coef_bilinear_half) {
+    //2:1縮小のbilinearは (1, 3, 3, 1) / 8
+    const auto coef = resize_cpu_get_coef(64, 32, RGY_RESIZE_CPU_BILINEAR);
+    for (int x = 1; x < 31; x++) {
+        RGY_CHECK(coef->start[x] == 2 * x - 1);
+        RGY_CHECK(std::abs(coef->weight[0 * 32 + x] - 0.125f) < 1e-6f);
+        RGY_CHECK(std::abs(coef->weight[1 * 32 + x] - 0.375f) < 1e-6f);
+        RGY_CHECK(std::abs(coef->weight[2 * 32 + x] - 0.375f) < 1e-6f);
+        RGY_CHECK(std::abs(coef->weight[3 * 32 + x] - 0.125f) < 1e-6f);
+    }
+}
+
+RGY_TEST(resize_cpu_coef_cache) {
+    const auto a = resize_cpu_get_coef(720, 480, RGY_RESIZE_CPU_SPLINE36);
+    RGY_CHECK(resize_cpu_get_coef(720, 480, RGY_RESIZE_CPU_SPLINE36) == a);
+    RGY_CHECK(resize_cpu_get_coef(720, 480, RGY_RESIZE_CPU_SPLINE16) != a);
+    RGY_CHECK(resize_cpu_get_coef(720, 360, RGY_RESIZE_CPU_SPLINE36) != a);
+    RGY_CHECK(resize_cpu_get_coef(480, 720, RGY_RESIZE_CPU_SPLINE36) != a);
+}
+
+//--- リサイズ ---------------------------------------------------------------------------
+//テスト用のフレームの色成分 (offset, stepはbyte単位)
+struct ResizeCpuTestPlane {
+    int offset, step, width, height;
+};
+
+struct ResizeCpuTestFrame {
+    FrameInfo frame;
+    std::vector<uint8_t> buf;
+    std::vector<ResizeCpuTestPlane> planes;
+    int pixel_size;
+
+    ResizeCpuTestFrame(RGY_CSP csp, int width, int height, uint8_t fill) : frame(), buf(), planes(), pixel_size(1) {
+        memset(&frame, 0, sizeof(frame));
+        pixel_size = (RGY_CSP_BIT_DEPTH[csp] > 8) ? 2 : 1;
+        frame.csp = csp;
+        frame.width = width;
+        frame.height = height;
+        //pitchは幅より大きくとり、書き込み範囲外が変化しないことを確認する
+        frame.pitch = width * pixel_size + 32;
+        buf.resize((size_t)frame.pitch * height * 3 + 64, fill);
+        frame.ptr = buf.data();
+        const int p = frame.pitch, px = pixel_size;
+        switch (csp) {
+        case RGY_CSP_NV12:
+        case RGY_CSP_P010:
+            planes = { { 0, px, width, height }, { p * height, px * 2, width / 2, height / 2 }, { p * height + px, px * 2, width / 2, height / 2 } };
+            break;
+        case RGY_CSP_YV12:
+        case RGY_CSP_YV12_16:
+            planes = { { 0, px, width, height }, { p * height, px, width / 2, height / 2 }, { p * height * 3 / 2, px, width / 2, height / 2 } };
+            break;
+        case RGY_CSP_YUV444:
+        case RGY_CSP_YUV444_16:
+            planes = { { 0, px, width, height }, { p * height, px, width, height }, { p * height * 2, px, width, height } };
+            break;
+        default:
+            break;
+        }
+    }
+    uint8_t *ptr(int iplane, int x, int y) {
+        const auto& plane = planes[iplane];
+        return buf.data() + plane.offset + (size_t)frame.pitch * y + plane.step * x;
+    }
+    int get(int iplane, int x, int y) {
+        return (pixel_size > 1) ? *(uint16_t *)ptr(iplane, x, y) : *ptr(iplane, x, y);
+    }
+    void set(int iplane, int x, int y, int value) {
+        if (pixel_size > 1) {
+            *(uint16_t *)ptr(iplane, x, y) = (uint16_t)value;
+        } else {
+            *ptr(iplane, x, y) = (uint8_t)value;
+        }
+    }
+    //いずれかの色成分に含まれる要素か
+    bool inside(size_t pos) const {
+        for (const auto& plane : planes) {
+            if (pos < (size_t)plane.offset) continue;
+            const size_t rel = pos - plane.offset;
+            const int y = (int)(rel / frame.pitch);
+            const int xb = (int)(rel % frame.pitch);
+            if (y < plane.height && xb % plane.step < pixel_size && xb / plane.step < plane.width) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+static const RGY_CSP RESIZE_CPU_TEST_CSP[] = {
+    RGY_CSP_YV12, RGY_CSP_NV12, RGY_CSP_P010, RGY_CSP_YV12_16, RGY_CSP_YUV444, RGY_CSP_YUV444_16,
+};
+
+static bool resize_cpu_test_run(ResizeCpuTestFrame& dst, ResizeCpuTestFrame& src, RGY_RESIZE_CPU algo, int threads) {
+    NVEncFilterResizeCpu resize;
+    if (resize.init(src.frame, dst.frame, algo, threads, nullptr) != NV_ENC_SUCCESS) {
+        return false;
+    }
+    return resize.resize(&dst.frame, &src.frame) == NV_ENC_SUCCESS;
+}
+
+RGY_TEST(resize_cpu_constant_planes) {
+    //色成分ごとに異なる一定値の画像は、どのアルゴリズム・サイズでもその値のまま
+    //  あわせて、各色成分の出力サイズと、色成分の外が書き換えられないことを確認する
+    static const int SIZES[][2] = { { 40, 30 }, { 96, 72 }, { 64, 48 }, { 18, 100 } };
+    static const int VALUES[3] = { 100, 60, 200 };
+    for (auto csp : RESIZE_CPU_TEST_CSP) {
+        for (auto algo : RESIZE_CPU_TEST_ALGO) {
+            for (const auto& size : SIZES) {
+                ResizeCpuTestFrame src(csp, 64, 48, 0);
+                for (int i = 0; i < 3; i++) {
+                    const int value = (src.pixel_size > 1) ? VALUES[i] << 8 : VALUES[i];
+                    for (int y = 0; y < src.planes[i].height; y++) {
+                        for (int x = 0; x < src.planes[i].width; x++) {
+                            src.set(i, x, y, value);
+                        }
+                    }
+                }
+                ResizeCpuTestFrame dst(csp, size[0], size[1], 0xAB);
+                RGY_CHECK(resize_cpu_test_run(dst, src, algo, 3));
+                for (int i = 0; i < 3; i++) {
+                    const int value = (dst.pixel_size > 1) ? VALUES[i] << 8 : VALUES[i];
+                    for (int y = 0; y < dst.planes[i].height; y++) {
+                        for (int x = 0; x < dst.planes[i].width; x++) {
+                            RGY_CHECK(dst.get(i, x, y) == value);
+                        }
+                    }
+                }
+                for (size_t pos = 0; pos < dst.buf.size(); pos++) {
+                    RGY_CHECK(dst.inside(pos) || dst.buf[pos] == 0xAB);
+                }
+            }
+        }
+    }
+}
+
+RGY_TEST(resize_cpu_same_size_is_copy) {
+    for (auto csp : RESIZE_CPU_TEST_CSP) {
+        for (auto algo : RESIZE_CPU_TEST_ALGO) {
+            ResizeCpuTestFrame src(csp, 64, 48, 0);
+            uint32_t seed = 12345;
+            for (int i = 0; i < 3; i++) {
+                for (int y = 0; y < src.planes[i].height; y++) {
+                    for (int x = 0; x < src.planes[i].width; x++) {
+                        seed = seed * 1664525u + 1013904223u;
+                        src.set(i, x, y, (src.pixel_size > 1) ? (int)(seed >> 16) : (int)(seed >> 24));
+                    }
+                }
+            }
+            ResizeCpuTestFrame dst(csp, 64, 48, 0);
+            RGY_CHECK(resize_cpu_test_run(dst, src, algo, 2));
+            for (int i = 0; i < 3; i++) {
+                for (int y = 0; y < src.planes[i].height; y++) {
+                    for (int x = 0; x < src.planes[i].width; x++) {
+                        RGY_CHECK(dst.get(i, x, y) == src.get(i, x, y));
+                    }
+                }
+            }
+        }
+    }
+}
+
+RGY_TEST(resize_cpu_bilinear_ramp) {
+    //水平方向のランプ v = k*x を2:1でbilinear縮小すると、内側は k*(2x+0.5)
+    for (auto csp : { RGY_CSP_YUV444, RGY_CSP_YUV444_16 }) {
+        ResizeCpuTestFrame src(csp, 64, 16, 0);
+        const int k = (src.pixel_size > 1) ? 1000 : 4;
+        for (int i = 0; i < 3; i++) {
+            for (int y = 0; y < 16; y++) {
+                for (int x = 0; x < 64; x++) {
+                    src.set(i, x, y, k * x);
+                }
+            }
+        }
+        ResizeCpuTestFrame dst(csp, 32, 8, 0);
+        RGY_CHECK(resize_cpu_test_run(dst, src, RGY_RESIZE_CPU_BILINEAR, 4));
+        for (int i = 0; i < 3; i++) {
+            for (int y = 0; y < 8; y++) {
+                for (int x = 1; x < 31; x++) {
+                    RGY_CHECK(dst.get(i, x, y) == k * (2 * x) + k / 2);
+                }
+            }
+        }
+    }
+}
+
+RGY_TEST(resize_cpu_threads) {
+    //band数によらず結果は同じ
+    ResizeCpuTestFrame src(RGY_CSP_YV12, 64, 48, 0);
+    uint32_t seed = 1;
+    for (int i = 0; i < 3; i++) {
+        for (int y = 0; y < src.planes[i].height; y++) {
+            for (int x = 0; x < src.planes[i].width; x++) {
+                seed = seed * 1664525u + 1013904223u;
+                src.set(i, x, y, (int)(seed >> 24));
+            }
+        }
+    }
+    ResizeCpuTestFrame dst1(RGY_CSP_YV12, 100, 70, 0);
+    ResizeCpuTestFrame dst4(RGY_CSP_YV12, 100, 70, 0);
+    RGY_CHECK(resize_cpu_test_run(dst1, src, RGY_RESIZE_CPU_LANCZOS3, 1));
+    RGY_CHECK(resize_cpu_test_run(dst4, src, RGY_RESIZE_CPU_LANCZOS3, 4));
+    RGY_CHECK(dst1.buf == dst4.buf);
+}
+
+RGY_TEST(resize_cpu_frame_mismatch) {
+    ResizeCpuTestFrame src(RGY_CSP_YV12, 64, 48, 0);
+    ResizeCpuTestFrame dst(RGY_CSP_YV12, 32, 24, 0);
+    ResizeCpuTestFrame other(RGY_CSP_YV12, 30, 24, 0);
+    NVEncFilterResizeCpu resize;
+    RGY_CHECK(resize.init(src.frame, dst.frame, RGY_RESIZE_CPU_SPLINE36, 1, nullptr) == NV_ENC_SUCCESS);
+    RGY_CHECK(resize.resize(&other.frame, &src.frame) == NV_ENC_ERR_INVALID_PARAM);
+    RGY_CHECK(resize.resize(&dst.frame, &src.frame) == NV_ENC_SUCCESS);
+}
@@ -0,0 +1,175 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "rgy_test.h"
+#include "rgy_autocrop.h"
+#include "rgy_log.h"
+#include "rgy_util.h"
+
+struct AutoCropTestBorder {
+    int left, up, right, bottom;
+};
+
+//黒帯(輝度16)の内側に、疑似乱数の絵柄を持つ輝度面を作成する
+static std::vector<uint8_t> autocrop_test_luma(int width, int height, const AutoCropTestBorder& border, uint32_t seed) {
+    std::vector<uint8_t> luma((size_t)width * height, 16);
+    for (int y = border.up; y < height - border.bottom; y++) {
+        for (int x = border.left; x < width - border.right; x++) {
+            seed = seed * 1664525u + 1013904223u;
+            luma[(size_t)y * width + x] = (uint8_t)(48 + (seed >> 24) % 188);
+        }
+    }
+    return luma;
+}
+
+static FrameInfo autocrop_test_frame(uint8_t *ptr, RGY_CSP csp, int width, int height, int pitch) {
+    FrameInfo frame = { 0 };
+    frame.ptr = ptr;
+    frame.csp = csp;
+    frame.width = width;
+    frame.height = height;
+    frame.pitch = pitch;
+    return frame;
+}
+
+RGY_TEST(autocrop_analyze_letterbox) {
+    const int width = 320, height = 180;
+    auto luma = autocrop_test_luma(width, height, { 0, 20, 0, 22 }, 1);
+    RGYAutoCrop autocrop;
+    autocrop.init(1, 2, 2);
+    sInputCrop crop;
+    RGY_CHECK(autocrop.analyze(autocrop_test_frame(luma.data(), RGY_CSP_NV12, width, height, width), &crop));
+    RGY_CHECK(crop.e.left == 0 && crop.e.up == 20 && crop.e.right == 0 && crop.e.bottom == 22);
+}
+
+//P010は上位bitに詰めて格納されている
+RGY_TEST(autocrop_analyze_pillarbox_p010) {
+    const int width = 320, height = 180;
+    const auto luma = autocrop_test_luma(width, height, { 40, 0, 42, 0 }, 2);
+    std::vector<uint16_t> luma16(luma.size());
+    for (size_t i = 0; i < luma.size(); i++) {
+        luma16[i] = (uint16_t)(luma[i] << 8);
+    }
+    RGYAutoCrop autocrop;
+    autocrop.init(4, 2, 2);
+    sInputCrop crop;
+    RGY_CHECK(autocrop.analyze(autocrop_test_frame((uint8_t *)luma16.data(), RGY_CSP_P010, width, height, width * 2), &crop));
+    RGY_CHECK(crop.e.left == 40 && crop.e.up == 0 && crop.e.right == 42 && crop.e.bottom == 0);
+}
+
+//全面が黒のフレームは投票に加えず、暗いシーンで大きく検出された値よりも多数のフレームで一致する値を採用する
+RGY_TEST(autocrop_vote) {
+    const int width = 320, height = 180;
+    RGYAutoCrop autocrop;
+    autocrop.init(1, 2, 2);
+    auto black = autocrop_test_luma(width, height, { 0, 0, 0, 0 }, 3);
+    std::fill(black.begin(), black.end(), 16);
+    RGY_CHECK(!autocrop.addFrame(autocrop_test_frame(black.data(), RGY_CSP_NV12, width, height, width)));
+    auto dark = autocrop_test_luma(width, height, { 0, 40, 0, 40 }, 4);
+    RGY_CHECK(autocrop.addFrame(autocrop_test_frame(dark.data(), RGY_CSP_NV12, width, height, width)));
+    for (uint32_t i = 0; i < 3; i++) {
+        auto luma = autocrop_test_luma(width, height, { 0, 21, 0, 21 }, 5 + i);
+        RGY_CHECK(autocrop.addFrame(autocrop_test_frame(luma.data(), RGY_CSP_NV12, width, height, width)));
+    }
+    RGY_CHECK(autocrop.totalFrames() == 5);
+    RGY_CHECK(autocrop.validFrames() == 4);
+    const auto crop = autocrop.result();
+    RGY_CHECK(crop.e.left == 0 && crop.e.up == 20 && crop.e.right == 0 && crop.e.bottom == 20); //2の倍数に切り捨て
+}
+
+#if ENABLE_RAW_READER
+//y4m(4:2:0 8bit)のファイルを作成する
+//先頭のフレームは全面が黒とし、以降は黒帯の内側に絵柄を持つフレームとする
+static bool autocrop_test_write_y4m(const char *filename, int width, int height, int frames, const AutoCropTestBorder& border) {
+    FILE *fp = fopen(filename, "wb");
+    if (fp == nullptr) {
+        return false;
+    }
+    fprintf(fp, "YUV4MPEG2 W%d H%d F30:1 Ip A1:1 C420jpeg\n", width, height);
+    const std::vector<uint8_t> chroma((size_t)width * height / 2, 128);
+    for (int i = 0; i < frames; i++) {
+        auto luma = autocrop_test_luma(width, height, border, 100 + i);
+        if (i == 0) {
+            std::fill(luma.begin(), luma.end(), 16);
+        }
+        fprintf(fp, "FRAME\n");
+        fwrite(luma.data(), 1, luma.size(), fp);
+        fwrite(chroma.data(), 1, chroma.size(), fp);
+    }
+    fclose(fp);
+    return true;
+}
+
+static RGY_ERR autocrop_test_detect_y4m(sInputCrop *crop, const char *filename, const AutoCropTestBorder& border) {
+    const int width = 320, height = 180;
+    if (!autocrop_test_write_y4m(filename, width, height, 100, border)) {
+        return RGY_ERR_FILE_OPEN;
+    }
+    VideoInfo info;
+    memset(&info, 0, sizeof(info));
+    info.type = RGY_INPUT_FMT_Y4M;
+    info.csp = RGY_CSP_NV12;
+    auto log = std::make_shared<RGYLog>(nullptr, RGY_LOG_QUIET);
+    const auto err = RGYAutoCropDetect(crop, char_to_tstring(filename).c_str(), &info, 0.0f, 4, log);
+    remove(filename);
+    return err;
+}
+
+RGY_TEST(autocrop_y4m_letterbox) {
+    sInputCrop crop;
+    RGY_CHECK(autocrop_test_detect_y4m(&crop, "rgy_test_autocrop_letterbox.y4m", { 0, 24, 0, 24 }) == RGY_ERR_NONE);
+    RGY_CHECK(crop.e.left == 0 && crop.e.up == 24 && crop.e.right == 0 && crop.e.bottom == 24);
+}
+
+RGY_TEST(autocrop_y4m_pillarbox) {
+    sInputCrop crop;
+    RGY_CHECK(autocrop_test_detect_y4m(&crop, "rgy_test_autocrop_pillarbox.y4m", { 40, 0, 40, 0 }) == RGY_ERR_NONE);
+    RGY_CHECK(crop.e.left == 40 && crop.e.up == 0 && crop.e.right == 40 && crop.e.bottom == 0);
+}
+
+//y4mでない入力はreaderの初期化に失敗し、cropは設定されない
+RGY_TEST(autocrop_y4m_invalid) {
+    const char *filename = "rgy_test_autocrop_invalid.y4m";
+    FILE *fp = fopen(filename, "wb");
+    RGY_CHECK(fp != nullptr);
+    fprintf(fp, "not a y4m file\n");
+    fclose(fp);
+    VideoInfo info;
+    memset(&info, 0, sizeof(info));
+    info.type = RGY_INPUT_FMT_Y4M;
+    info.csp = RGY_CSP_NV12;
+    sInputCrop crop;
+    const auto err = RGYAutoCropDetect(&crop, char_to_tstring(filename).c_str(), &info, 0.0f, 4, std::make_shared<RGYLog>(nullptr, RGY_LOG_QUIET));
+    remove(filename);
+    RGY_CHECK(err != RGY_ERR_NONE);
+    RGY_CHECK(crop.e.left == 0 && crop.e.up == 0 && crop.e.right == 0 && crop.e.bottom == 0);
+}
+#endif //#if ENABLE_RAW_READER
@@ -0,0 +1,732 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include "rgy_test.h"
+#include "rgy_bitstream_analyzer.h"
+
+//テスト用のbitstreamを作成する
+class BsaTestBitWriter {
+public:
+    BsaTestBitWriter() : m_buf(), m_nBits(0) {};
+    void bit(int b) {
+        if ((m_nBits & 7) == 0) {
+            m_buf.push_back(0);
+        }
+        if (b) {
+            m_buf.back() |= (uint8_t)(0x80 >> (m_nBits & 7));
+        }
+        m_nBits++;
+    }
+    void u(int n, uint32_t v) {
+        for (int i = n - 1; i >= 0; i--) {
+            bit((v >> i) & 1);
+        }
+    }
+    void ue(uint32_t v) {
+        const uint64_t x = (uint64_t)v + 1;
+        int len = 0;
+        while ((x >> len) > 1) len++;
+        u(len, 0);
+        for (int i = len; i >= 0; i--) {
+            bit((int)((x >> i) & 1));
+        }
+    }
+    void se(int v) {
+        ue((v > 0) ? (uint32_t)(2 * v - 1) : (uint32_t)(-2 * v));
+    }
+    //rbsp_trailing_bits
+    void trailing() {
+        bit(1);
+        while (m_nBits & 7) bit(0);
+    }
+    //スライスデータの代わりに疑似乱数を追加する
+    void junk(int bytes, uint32_t& seed) {
+        for (int i = 0; i < bytes; i++) {
+            seed = seed * 1664525u + 1013904223u;
+            u(8, seed >> 24);
+        }
+    }
+    const std::vector<uint8_t>& data() const { return m_buf; }
+    int bits() const { return m_nBits; }
+protected:
+    std::vector<uint8_t> m_buf;
+    int m_nBits;
+};
+
+//emulation prevention byteを挿入する (挿入した位置をepbに返す)
+static std::vector<uint8_t> bsa_test_escape(const std::vector<uint8_t>& rbsp, std::vector<size_t> *epb = nullptr) {
+    std::vector<uint8_t> out;
+    int zeros = 0;
+    for (auto b : rbsp) {
+        if (zeros >= 2 && b <= 3) {
+            if (epb) epb->push_back(out.size());
+            out.push_back(3);
+            zeros = 0;
+        }
+        out.push_back(b);
+        zeros = (b == 0) ? zeros + 1 : 0;
+    }
+    return out;
+}
+
+//scalarでのemulation prevention byteの除去 (比較用)
+static std::vector<uint8_t> bsa_test_unescape_ref(const uint8_t *src, size_t size) {
+    std::vector<uint8_t> out;
+    int zeros = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (zeros >= 2 && src[i] == 0x03) {
+            zeros = 0;
+            continue;
+        }
+        zeros = (src[i] == 0) ? zeros + 1 : 0;
+        out.push_back(src[i]);
+    }
+    return out;
+}
+
+static std::vector<uint8_t> bsa_test_unescape(const std::vector<uint8_t>& src, size_t size) {
+    std::vector<uint8_t> dst(size + 16);
+    dst.resize(rgy_nal_to_rbsp(dst.data(), src.data(), (uint32_t)size));
+    return dst;
+}
+
+//AnnexBのNALを追加する
+static void bsa_test_add_nal(std::vector<uint8_t>& au, const std::vector<uint8_t>& header, const BsaTestBitWriter& bw) {
+    static const uint8_t startcode[] = { 0x00, 0x00, 0x00, 0x01 };
+    au.insert(au.end(), startcode, startcode + sizeof(startcode));
+    au.insert(au.end(), header.begin(), header.end());
+    const auto payload = bsa_test_escape(bw.data());
+    au.insert(au.end(), payload.begin(), payload.end());
+}
+
+//scalarでのstart codeの検索 (比較用)
+static std::vector<nal_info> bsa_test_parse_nal_ref(uint8_t *data, uint32_t size, bool hevc) {
+    std::vector<nal_info> nal_list;
+    for (int i = 0; i < (int)size - 3; i++) {
+        if (data[i+0] == 0 && data[i+1] == 0 && data[i+2] == 1) {
+            nal_info nal;
+            nal.ptr = data + i - (i > 0 && data[i-1] == 0);
+            nal.type = (hevc) ? (data[i+3] & 0x7f) >> 1 : data[i+3] & 0x1f;
+            nal.size = (int)(data + size - nal.ptr);
+            if (nal_list.size()) {
+                nal_list.back().size = (int)(nal.ptr - nal_list.back().ptr);
+            }
+            nal_list.push_back(nal);
+            i += 3;
+        }
+    }
+    return nal_list;
+}
+
+//--- RGYBitReader -----------------------------------------------------------------------
+RGY_TEST(bitreader_exp_golomb) {
+    //符号長が16bit以上 (lz >= 16) の値や、バイト境界をまたぐ値を含める
+    static const uint32_t UE[] = {
+        0, 1, 2, 3, 6, 7, 8, 254, 255, 256, 1023, 65534, 65535, 65536, 1u << 20, (1u << 30) + 12345, 0x7ffffffe, 0xfffffffe,
+    };
+    static const int SE[] = { 0, 1, -1, 2, -2, 127, -128, 32767, -32768, 1 << 20, -(1 << 20) };
+    BsaTestBitWriter bw;
+    for (int rep = 0; rep < 3; rep++) {
+        bw.u(rep + 1, 1); //バイト境界からの位置をずらす
+        for (auto v : UE) bw.ue(v);
+        for (auto v : SE) bw.se(v);
+        bw.u(13, 0x1abc);
+        bw.u(1, 1);
+        bw.u(32 - rep, 0xdeadbeef >> rep);
+    }
+    auto data = bw.data();
+    const uint32_t size = (uint32_t)data.size();
+    data.resize(size + 8, 0);
+    RGYBitReader br(data.data(), size);
+    for (int rep = 0; rep < 3; rep++) {
+        RGY_CHECK(br.u(rep + 1) == 1);
+        for (auto v : UE) RGY_CHECK(br.ue() == v);
+        for (auto v : SE) RGY_CHECK(br.se() == v);
+        RGY_CHECK(br.u(13) == 0x1abc);
+        RGY_CHECK(br.u1() == 1);
+        RGY_CHECK(br.u(32 - rep) == (0xdeadbeef >> rep));
+        RGY_CHECK(!br.overrun());
+    }
+}
+
+RGY_TEST(bitreader_overrun) {
+    std::vector<uint8_t> data = { 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    {
+        RGYBitReader br(data.data(), 1);
+        RGY_CHECK(br.u(8) == 0xff);
+        RGY_CHECK(!br.overrun());
+        RGY_CHECK(br.u1() == 0);
+        RGY_CHECK(br.overrun());
+    }
+    {
+        //末尾を超える指数ゴロム符号
+        RGYBitReader br(data.data() + 1, 2);
+        RGY_CHECK(br.ue() == 0);
+        RGY_CHECK(br.overrun());
+    }
+    {
+        //末尾まで0が続く
+        std::vector<uint8_t> d = { 0x10, 0, 0, 0, 0, 0, 0, 0 };
+        RGYBitReader br(d.data(), 1);
+        br.skip(4);
+        RGY_CHECK(br.ue() == 0 && br.overrun());
+    }
+}
+
+//--- emulation prevention byte ------------------------------------------------------------
+RGY_TEST(nal_to_rbsp_matches_reference) {
+    //0が多いデータで、16byteのブロックの各位置にemulation prevention byteが来るようにする
+    uint32_t seed = 7;
+    for (int iter = 0; iter < 2000; iter++) {
+        const size_t size = iter % 200;
+        std::vector<uint8_t> src(size + 16);
+        for (size_t i = 0; i < size; i++) {
+            seed = seed * 1664525u + 1013904223u;
+            const uint32_t r = seed >> 24;
+            src[i] = (r < 96) ? 0 : ((r < 160) ? 3 : (uint8_t)(r & ((iter & 1) ? 0x03 : 0xff)));
+        }
+        const auto ref = bsa_test_unescape_ref(src.data(), size);
+        RGY_CHECK(bsa_test_unescape(src, size) == ref);
+    }
+}
+
+RGY_TEST(nal_to_rbsp_roundtrip) {
+    uint32_t seed = 99;
+    for (int iter = 0; iter < 500; iter++) {
+        std::vector<uint8_t> rbsp(17 + iter);
+        for (auto& b : rbsp) {
+            seed = seed * 1664525u + 1013904223u;
+            const uint32_t r = seed >> 24;
+            b = (r < 128) ? 0 : (uint8_t)(r & 0x03);
+        }
+        rbsp.back() = 0x80; //rbsp_trailing_bits
+        std::vector<size_t> epb;
+        auto nal = bsa_test_escape(rbsp, &epb);
+        RGY_CHECK(epb.size() > 0);
+        nal.resize(nal.size() + 16, 0xff);
+        RGY_CHECK(bsa_test_unescape(nal, nal.size() - 16) == rbsp);
+    }
+}
+
+RGY_TEST(nal_to_rbsp_split_at_any_position) {
+    //入力を途中で打ち切った場合 (スライスヘッダのみの変換)、結果は全体を変換した結果の先頭と一致する
+    //  00 00 | 03 のように、emulation prevention byteの途中で打ち切る場合を含む
+    std::vector<uint8_t> rbsp;
+    for (int i = 0; i < 64; i++) {
+        rbsp.push_back((uint8_t)(0x40 + i));
+        for (int j = 0; j < (i % 5) + 2; j++) rbsp.push_back(0);
+        rbsp.push_back((uint8_t)(i % 4));
+    }
+    auto nal = bsa_test_escape(rbsp);
+    nal.resize(nal.size() + 16, 0);
+    const size_t size = nal.size() - 16;
+    const auto all = bsa_test_unescape(nal, size);
+    RGY_CHECK(all == rbsp);
+    for (size_t cut = 0; cut <= size; cut++) {
+        const auto part = bsa_test_unescape(nal, cut);
+        RGY_CHECK(part.size() <= all.size());
+        RGY_CHECK(std::equal(part.begin(), part.end(), all.begin()));
+        RGY_CHECK(part == bsa_test_unescape_ref(nal.data(), cut));
+    }
+}
+
+//--- start codeの検索 ---------------------------------------------------------------------
+RGY_TEST(nal_start_code_matches_reference) {
+    uint32_t seed = 3;
+    for (int iter = 0; iter < 3000; iter++) {
+        const uint32_t size = iter % 300;
+        std::vector<uint8_t> data(size + 16);
+        for (uint32_t i = 0; i < size; i++) {
+            seed = seed * 1664525u + 1013904223u;
+            data[i] = (uint8_t)((seed >> 24) | 1);
+        }
+        //3byte/4byteのstart codeと、単独の0を入れる
+        const int count = (int)(size / 24) + 1;
+        for (int j = 0; j < count && size >= 8; j++) {
+            seed = seed * 1664525u + 1013904223u;
+            const uint32_t pos = (seed >> 8) % (size - 4);
+            data[pos + 0] = 0;
+            data[pos + 1] = 0;
+            if ((seed & 0x03) == 0) {
+                data[pos + 2] = 0;
+                data[pos + 3] = 1;
+            } else if ((seed & 0x03) == 1) {
+                data[pos + 2] = 2;
+            } else {
+                data[pos + 2] = 1;
+            }
+        }
+        for (int hevc = 0; hevc < 2; hevc++) {
+            const auto ref = bsa_test_parse_nal_ref(data.data(), size, hevc != 0);
+            const auto nal_list = (hevc) ? parse_nal_unit_hevc(data.data(), size) : parse_nal_unit_h264(data.data(), size);
+            RGY_CHECK(nal_list.size() == ref.size());
+            for (size_t i = 0; i < ref.size(); i++) {
+                RGY_CHECK(nal_list[i].ptr == ref[i].ptr);
+                RGY_CHECK(nal_list[i].type == ref[i].type);
+                RGY_CHECK(nal_list[i].size == ref[i].size);
+            }
+        }
+    }
+}
+
+//--- H.264 --------------------------------------------------------------------------------
+static const int BSA_TEST_H264_INIT_QP = 22;
+
+static void bsa_test_h264_header(std::vector<uint8_t>& au) {
+    BsaTestBitWriter sps;
+    sps.u(8, 100); //profile_idc (High)
+    sps.u(8, 0);   //constraint_set_flags
+    sps.u(8, 40);  //level_idc
+    sps.ue(0);     //seq_parameter_set_id
+    sps.ue(1);     //chroma_format_idc
+    sps.ue(0); sps.ue(0); //bit_depth
+    sps.u(1, 0);   //qpprime_y_zero_transform_bypass_flag
+    sps.u(1, 0);   //seq_scaling_matrix_present_flag
+    sps.ue(0);     //log2_max_frame_num_minus4
+    sps.ue(0);     //pic_order_cnt_type
+    sps.ue(2);     //log2_max_pic_order_cnt_lsb_minus4 (MaxPicOrderCntLsb = 64)
+    sps.ue(4);     //max_num_ref_frames
+    sps.u(1, 0);   //gaps_in_frame_num_value_allowed_flag
+    sps.ue(119); sps.ue(67);
+    sps.u(1, 1);   //frame_mbs_only_flag
+    sps.u(1, 1);   //direct_8x8_inference_flag
+    sps.u(1, 0);   //frame_cropping_flag
+    sps.u(1, 0);   //vui_parameters_present_flag
+    sps.trailing();
+    bsa_test_add_nal(au, { 0x67 }, sps);
+
+    BsaTestBitWriter pps;
+    pps.ue(0); pps.ue(0);
+    pps.u(1, 1);   //entropy_coding_mode_flag
+    pps.u(1, 0);   //bottom_field_pic_order_in_frame_present_flag
+    pps.ue(0);     //num_slice_groups_minus1
+    pps.ue(0); pps.ue(0); //num_ref_idx_default_active_minus1
+    pps.u(1, 0); pps.u(2, 0); //weighted_pred_flag, weighted_bipred_idc
+    pps.se(BSA_TEST_H264_INIT_QP - 26);
+    pps.se(0); pps.se(0);
+    pps.u(1, 1); pps.u(1, 0); pps.u(1, 0);
+    pps.trailing();
+    bsa_test_add_nal(au, { 0x68 }, pps);
+}
+
+struct BsaTestH264Slice {
+    int sliceType;  //0:P, 1:B, 2:I
+    bool idr;
+    int nalRefIdc;
+    int firstMb;
+    int pocLsb;
+    int refs[2];    //num_ref_idx_active_override (0なら上書きしない)
+    int qpDelta;
+    int listModifications; //ref_pic_list_modificationの数
+    int junk;       //スライスデータの代わりの疑似乱数のバイト数
+};
+
+static BsaTestBitWriter bsa_test_h264_slice(const BsaTestH264Slice& s, uint32_t& seed) {
+    BsaTestBitWriter bw;
+    bw.ue(s.firstMb);
+    bw.ue(s.sliceType);
+    bw.ue(0); //pic_parameter_set_id
+    bw.u(4, 0); //frame_num
+    if (s.idr) {
+        bw.ue(0); //idr_pic_id
+    }
+    bw.u(6, s.pocLsb);
+    if (s.sliceType == 1) {
+        bw.u(1, 1); //direct_spatial_mv_pred_flag
+    }
+    if (s.sliceType != 2) {
+        bw.u(1, s.refs[0] > 0);
+        if (s.refs[0] > 0) {
+            bw.ue(s.refs[0] - 1);
+            if (s.sliceType == 1) bw.ue(s.refs[1] - 1);
+        }
+        bw.u(1, s.listModifications > 0); //ref_pic_list_modification_flag_l0
+        if (s.listModifications > 0) {
+            for (int i = 0; i < s.listModifications; i++) {
+                bw.ue(i & 1);          //modification_of_pic_nums_idc
+                //abs_diff_pic_num_minus1 (長い符号で0のバイトを作る、先頭は数によって符号長を変えてbit位置をずらす)
+                bw.ue((i == 0) ? (1u << (s.listModifications % 16)) - 1 : (1u << 24) - 1 + i * 13);
+            }
+            bw.ue(3);
+        }
+        if (s.sliceType == 1) {
+            bw.u(1, 0); //ref_pic_list_modification_flag_l1
+        }
+    }
+    if (s.nalRefIdc) {
+        if (s.idr) {
+            bw.u(1, 0); bw.u(1, 0);
+        } else {
+            bw.u(1, 0); //adaptive_ref_pic_marking_mode_flag
+        }
+    }
+    if (s.sliceType != 2) {
+        bw.ue(0); //cabac_init_idc
+    }
+    bw.se(s.qpDelta);
+    bw.ue(0); //disable_deblocking_filter_idc
+    bw.junk(s.junk, seed);
+    bw.trailing();
+    return bw;
+}
+
+static void bsa_test_h264_add_slice(std::vector<uint8_t>& au, const BsaTestH264Slice& s, uint32_t& seed) {
+    bsa_test_add_nal(au, { (uint8_t)((s.nalRefIdc << 5) | ((s.idr) ? 5 : 1)) }, bsa_test_h264_slice(s, seed));
+}
+
+RGY_TEST(bitstream_analyzer_h264_slices) {
+    RGYBitstreamAnalyzer analyzer;
+    RGY_CHECK(analyzer.init(RGY_CODEC_H264) == RGY_ERR_NONE);
+    uint32_t seed = 1;
+    RGYBitstreamAUInfo info;
+
+    //IDR
+    std::vector<uint8_t> au;
+    bsa_test_h264_header(au);
+    const size_t headerSize = au.size();
+    bsa_test_h264_add_slice(au, { 2, true, 3, 0, 0, { 0, 0 }, 3, 0, 500 }, seed);
+    RGY_CHECK(analyzer.analyze(au.data(), (uint32_t)au.size(), info) == RGY_ERR_NONE);
+    RGY_CHECK(info.frametype == (RGY_FRAMETYPE_IDR | RGY_FRAMETYPE_REF));
+    RGY_CHECK(info.poc == 0);
+    RGY_CHECK(info.qp == BSA_TEST_H264_INIT_QP + 3);
+    RGY_CHECK(info.bytes == au.size());
+    RGY_CHECK(info.sliceSize.size() == 1 && info.sliceSize[0] == au.size() - headerSize);
+
+    //P (参照数を上書き)
+    au.clear();
+    bsa_test_h264_add_slice(au, { 0, false, 2, 0, 8, { 2, 0 }, 0, 0, 300 }, seed);
+    RGY_CHECK(analyzer.analyze(au.data(), (uint32_t)au.size(), info) == RGY_ERR_NONE);
+    RGY_CHECK(info.frametype == (RGY_FRAMETYPE_P | RGY_FRAMETYPE_REF));
+    RGY_CHECK(info.poc == 8 && info.qp == BSA_TEST_H264_INIT_QP);
+    RGY_CHECK(info.refCount[0] == 2 && info.refCount[1] == 0);
+
+    //非参照のB
+    au.clear();
+    bsa_test_h264_add_slice(au, { 1, false, 0, 0, 4, { 0, 0 }, -5, 0, 100 }, seed);
+    RGY_CHECK(analyzer.analyze(au.data(), (uint32_t)au.size(), info) == RGY_ERR_NONE);
+    RGY_CHECK(info.frametype == RGY_FRAMETYPE_B);
+    RGY_CHECK(info.poc == 4 && info.qp == BSA_TEST_H264_INIT_QP - 5);
+    RGY_CHECK(info.refCount[0] == 1 && info.refCount[1] == 1);
+
+    //I + P の2スライス
+    au.clear();
+    bsa_test_h264_add_slice(au, { 2, false, 2, 0, 40, { 0, 0 }, 0, 0, 200 }, seed);
+    const size_t slice0 = au.size();
+    bsa_test_h264_add_slice(au, { 0, false, 2, 4000, 40, { 3, 0 }, 4, 0, 150 }, seed);
+    RGY_CHECK(analyzer.analyze(au.data(), (uint32_t)au.size(), info) == RGY_ERR_NONE);
+    RGY_CHECK(info.frametype == (RGY_FRAMETYPE_P | RGY_FRAMETYPE_REF));
+    RGY_CHECK(info.poc == 40 && info.qp == BSA_TEST_H264_INIT_QP + 2);
+    RGY_CHECK(info.refCount[0] == 3);
+    RGY_CHECK(info.sliceSize.size() == 2 && info.sliceSize[0] == slice0 && info.sliceSize[1] == au.size() - slice0);
+
+    //POCのlsbの折り返し (MaxPicOrderCntLsb = 64)
+    au.clear();
+    bsa_test_h264_add_slice(au, { 0, false, 2, 0, 70 % 64, { 0, 0 }, 0, 0, 50 }, seed);
+    RGY_CHECK(analyzer.analyze(au.data(), (uint32_t)au.size(), info) == RGY_ERR_NONE);
+    RGY_CHECK(info.poc == 70);
+}
+
+RGY_TEST(bitstream_analyzer_h264_long_header) {
+    //スライスヘッダがRGY_BITSTREAM_ANALYZE_HEADER_BYTESより長い場合は全体を変換して解析する
+    //  打ち切る位置の付近にemulation prevention byteが来る場合も含めて確認する
+    bool epbAtBoundary = false;
+    for (int mods = 180; mods < 240; mods++) {
+        RGYBitstreamAnalyzer analyzer;
+        RGY_CHECK(analyzer.init(RGY_CODEC_H264) == RGY_ERR_NONE);
+        uint32_t seed = mods;
+        std::vector<uint8_t> au;
+        bsa_test_h264_header(au);
+        BsaTestH264Slice s = { 0, false, 2, 0, 2, { 0, 0 }, 7, mods, 64 };
+        const auto bw = bsa_test_h264_slice(s, seed);
+        std::vector<size_t> epb;
+        bsa_test_escape(bw.data(), &epb);
+        for (auto pos : epb) {
+            //NALの先頭からの位置 (start code 4byte + NALヘッダ 1byte)
+            const size_t nalPos = pos + 5;
+            epbAtBoundary |= (nalPos + 1 >= RGY_BITSTREAM_ANALYZE_HEADER_BYTES && nalPos <= RGY_BITSTREAM_ANALYZE_HEADER_BYTES + 1);
+        }
+        RGY_CHECK(bw.data().size() - s.junk > RGY_BITSTREAM_ANALYZE_HEADER_BYTES);
+        bsa_test_h264_add_slice(au, s, seed = mods);
+        RGYBitstreamAUInfo info;
+        RGY_CHECK(analyzer.analyze(au.data(), (uint32_t)au.size(), info) == RGY_ERR_NONE);
+        RGY_CHECK(info.frametype == (RGY_FRAMETYPE_P | RGY_FRAMETYPE_REF));
+        RGY_CHECK(info.qp == BSA_TEST_H264_INIT_QP + 7);
+        RGY_CHECK(info.poc == 2);
+    }
+    RGY_CHECK(epbAtBoundary);
+}
+
+RGY_TEST(bitstream_analyzer_missing_pps) {
+    RGYBitstreamAnalyzer analyzer;
+    RGY_CHECK(analyzer.init(RGY_CODEC_H264) == RGY_ERR_NONE);
+    uint32_t seed = 1;
+    std::vector<uint8_t> au;
+    bsa_test_h264_add_slice(au, { 2, true, 3, 0, 0, { 0, 0 }, 0, 0, 10 }, seed);
+    RGYBitstreamAUInfo info;
+    RGY_CHECK(analyzer.analyze(au.data(), (uint32_t)au.size(), info) == RGY_ERR_NOT_FOUND);
+    RGY_CHECK(analyzer.init(RGY_CODEC_MPEG2) == RGY_ERR_INVALID_CODEC);
+}
+
+//--- HEVC ---------------------------------------------------------------------------------
+static const int BSA_TEST_HEVC_INIT_QP = 30;
+
+static void bsa_test_hevc_header(std::vector<uint8_t>& au) {
+    BsaTestBitWriter sps;
+    sps.u(4, 0);  //sps_video_parameter_set_id
+    sps.u(3, 0);  //sps_max_sub_layers_minus1
+    sps.u(1, 1);  //sps_temporal_id_nesting_flag
+    sps.u(32, 0x60000000); sps.u(32, 0); sps.u(32, 0x5d); //profile_tier_level
+    sps.ue(0);    //sps_seq_parameter_set_id
+    sps.ue(1);    //chroma_format_idc
+    sps.ue(1920); sps.ue(1080);
+    sps.u(1, 0);  //conformance_window_flag
+    sps.ue(0); sps.ue(0);
+    sps.ue(4);    //log2_max_pic_order_cnt_lsb_minus4 (MaxPicOrderCntLsb = 256)
+    sps.u(1, 1);  //sps_sub_layer_ordering_info_present_flag
+    sps.ue(4); sps.ue(2); sps.ue(0);
+    sps.ue(0);    //log2_min_luma_coding_block_size_minus3
+    sps.ue(3);    //log2_diff_max_min_luma_coding_block_size (CTB 64x64)
+    sps.ue(0); sps.ue(3); sps.ue(1); sps.ue(1);
+    sps.u(1, 0);  //scaling_list_enabled_flag
+    sps.u(1, 1);  //amp_enabled_flag
+    sps.u(1, 1);  //sample_adaptive_offset_enabled_flag
+    sps.u(1, 0);  //pcm_enabled_flag
+    sps.ue(2);    //num_short_term_ref_pic_sets
+    //st_ref_pic_set(0): -1
+    sps.ue(1); sps.ue(0);
+    sps.ue(0); sps.u(1, 1);
+    //st_ref_pic_set(1): -1, -2, +1
+    sps.u(1, 0);  //inter_ref_pic_set_prediction_flag
+    sps.ue(2); sps.ue(1);
+    sps.ue(0); sps.u(1, 1);
+    sps.ue(0); sps.u(1, 1);
+    sps.ue(0); sps.u(1, 1);
+    sps.u(1, 0);  //long_term_ref_pics_present_flag
+    sps.u(1, 1);  //sps_temporal_mvp_enabled_flag
+    sps.u(1, 1);  //strong_intra_smoothing_enabled_flag
+    sps.u(1, 0);  //vui_parameters_present_flag
+    sps.u(1, 0);  //sps_extension_present_flag
+    sps.trailing();
+    bsa_test_add_nal(au, { 0x42, 0x01 }, sps);
+
+    BsaTestBitWriter pps;
+    pps.ue(0); pps.ue(0);
+    pps.u(1, 1);  //dependent_slice_segments_enabled_flag
+    pps.u(1, 0);  //output_flag_present_flag
+    pps.u(3, 0);  //num_extra_slice_header_bits
+    pps.u(1, 0);  //sign_data_hiding_enabled_flag
+    pps.u(1, 1);  //cabac_init_present_flag
+    pps.ue(0); pps.ue(0);
+    pps.se(BSA_TEST_HEVC_INIT_QP - 26);
+    pps.u(1, 0); pps.u(1, 0);
+    pps.u(1, 1); pps.ue(1); //cu_qp_delta_enabled_flag, diff_cu_qp_delta_depth
+    pps.se(0); pps.se(0);
+    pps.u(1, 0);  //pps_slice_chroma_qp_offsets_present_flag
+    pps.u(1, 0); pps.u(1, 0); //weighted_pred_flag, weighted_bipred_flag
+    pps.u(1, 0);  //transquant_bypass_enabled_flag
+    pps.u(1, 0); pps.u(1, 0); //tiles_enabled_flag, entropy_coding_sync_enabled_flag
+    pps.u(1, 1);  //pps_loop_filter_across_slices_enabled_flag
+    pps.u(1, 0);  //deblocking_filter_control_present_flag
+    pps.u(1, 0);  //pps_scaling_list_data_present_flag
+    pps.u(1, 0);  //lists_modification_present_flag
+    pps.ue(0);
+    pps.u(1, 0); pps.u(1, 0);
+    pps.trailing();
+    bsa_test_add_nal(au, { 0x44, 0x01 }, pps);
+}
+
+struct BsaTestHEVCSlice {
+    int nalType;
+    int sliceType;  //0:B, 1:P, 2:I
+    bool first;
+    bool dependent;
+    int address;
+    int pocLsb;
+    int rpsIdx;     //-1: スライスヘッダで指定 (-1, +1)
+    int refs[2];    //num_ref_idx_active_override (0なら上書きしない)
+    int qpDelta;
+    int junk;
+};
+
+static void bsa_test_hevc_add_slice(std::vector<uint8_t>& au, const BsaTestHEVCSlice& s, uint32_t& seed) {
+    BsaTestBitWriter bw;
+    const bool irap = s.nalType >= 16 && s.nalType <= 23;
+    const bool idr = s.nalType == 19 || s.nalType == 20;
+    bw.u(1, s.first);
+    if (irap) {
+        bw.u(1, 0); //no_output_of_prior_pics_flag
+    }
+    bw.ue(0); //slice_pic_parameter_set_id
+    if (!s.first) {
+        bw.u(1, s.dependent);
+        bw.u(9, s.address); //Ceil(Log2(PicSizeInCtbsY)) = Ceil(Log2(30 * 17))
+    }
+    if (!s.dependent) {
+        bw.ue(s.sliceType);
+        int refs[2] = { (s.refs[0] > 0) ? s.refs[0] : 1, (s.refs[1] > 0) ? s.refs[1] : 1 };
+        if (!idr) {
+            bw.u(8, s.pocLsb);
+            bw.u(1, s.rpsIdx >= 0); //short_term_ref_pic_set_sps_flag
+            if (s.rpsIdx >= 0) {
+                bw.u(1, s.rpsIdx);
+            } else {
+                bw.u(1, 0); //inter_ref_pic_set_prediction_flag
+                bw.ue(1); bw.ue(1);
+                bw.ue(0); bw.u(1, 1);
+                bw.ue(0); bw.u(1, 1);
+            }
+            bw.u(1, 1); //slice_temporal_mvp_enabled_flag
+        }
+        bw.u(1, 1); bw.u(1, 1); //slice_sao_luma_flag, slice_sao_chroma_flag
+        if (s.sliceType != 2) {
+            bw.u(1, s.refs[0] > 0);
+            if (s.refs[0] > 0) {
+                bw.ue(s.refs[0] - 1);
+                if (s.sliceType == 0) bw.ue(s.refs[1] - 1);
+            }
+            if (s.sliceType == 0) {
+                bw.u(1, 0); //mvd_l1_zero_flag
+            }
+            bw.u(1, 1); //cabac_init_flag
+            const bool collocatedFromL0 = true;
+            if (s.sliceType == 0) {
+                bw.u(1, collocatedFromL0);
+            }
+            if (refs[0] > 1) {
+                bw.ue(refs[0] - 1); //collocated_ref_idx
+            }
+            bw.ue(0); //five_minus_max_num_merge_cand
+        }
+        bw.se(s.qpDelta);
+    }
+    bw.u(1, 1); //byte_alignment
+    while (bw.bits() & 7) bw.bit(0);
+    bw.junk(s.junk, seed);
+    bw.trailing();
+    bsa_test_add_nal(au, { (uint8_t)(s.nalType << 1), 0x01 }, bw);
+}
+
+RGY_TEST(bitstream_analyzer_hevc_slices) {
+    RGYBitstreamAnalyzer analyzer;
+    RGY_CHECK(analyzer.init(RGY_CODEC_HEVC) == RGY_ERR_NONE);
+    uint32_t seed = 5;
+    RGYBitstreamAUInfo info;
+
+    std::vector<uint8_t> au;
+    bsa_test_hevc_header(au);
+    const size_t headerSize = au.size();
+    bsa_test_hevc_add_slice(au, { 19, 2, true, false, 0, 0, 0, { 0, 0 }, -2, 700 }, seed);
+    RGY_CHECK(analyzer.analyze(au.data(), (uint32_t)au.size(), info) == RGY_ERR_NONE);
+    RGY_CHECK(info.frametype == (RGY_FRAMETYPE_IDR | RGY_FRAMETYPE_REF));
+    RGY_CHECK(info.poc == 0 && info.qp == BSA_TEST_HEVC_INIT_QP - 2);
+    RGY_CHECK(info.bytes == au.size());
+    RGY_CHECK(info.sliceSize.size() == 1 && info.sliceSize[0] == au.size() - headerSize);
+
+    //TRAIL_R P
+    au.clear();
+    bsa_test_hevc_add_slice(au, { 1, 1, true, false, 0, 1, 0, { 0, 0 }, 1, 300 }, seed);
+    RGY_CHECK(analyzer.analyze(au.data(), (uint32_t)au.size(), info) == RGY_ERR_NONE);
+    RGY_CHECK(info.frametype == (RGY_FRAMETYPE_P | RGY_FRAMETYPE_REF));
+    RGY_CHECK(info.poc == 1 && info.qp == BSA_TEST_HEVC_INIT_QP + 1);
+    RGY_CHECK(info.refCount[0] == 1 && info.refCount[1] == 0);
+
+    //TRAIL_N B (スライスヘッダでRPSを指定、参照数を上書き)
+    au.clear();
+    bsa_test_hevc_add_slice(au, { 0, 0, true, false, 0, 2, -1, { 2, 1 }, 3, 200 }, seed);
+    RGY_CHECK(analyzer.analyze(au.data(), (uint32_t)au.size(), info) == RGY_ERR_NONE);
+    RGY_CHECK(info.frametype == RGY_FRAMETYPE_B);
+    RGY_CHECK(info.poc == 2 && info.qp == BSA_TEST_HEVC_INIT_QP + 3);
+    RGY_CHECK(info.refCount[0] == 2 && info.refCount[1] == 1);
+
+    //独立スライス + 従属スライス + 独立スライス
+    au.clear();
+    bsa_test_hevc_add_slice(au, { 1, 1, true, false, 0, 4, 1, { 0, 0 }, 0, 100 }, seed);
+    bsa_test_hevc_add_slice(au, { 1, 1, false, true, 170, 4, 1, { 0, 0 }, 0, 100 }, seed);
+    bsa_test_hevc_add_slice(au, { 1, 1, false, false, 340, 4, 1, { 3, 0 }, 4, 100 }, seed);
+    RGY_CHECK(analyzer.analyze(au.data(), (uint32_t)au.size(), info) == RGY_ERR_NONE);
+    RGY_CHECK(info.frametype == (RGY_FRAMETYPE_P | RGY_FRAMETYPE_REF));
+    RGY_CHECK(info.poc == 4);
+    RGY_CHECK(info.sliceSize.size() == 3);
+    RGY_CHECK(info.qp == (BSA_TEST_HEVC_INIT_QP * 3 + 4 + 1) / 3);
+    RGY_CHECK(info.refCount[0] == 3);
+
+    //POCのlsbの折り返し (MaxPicOrderCntLsb = 256)
+    const int pocLsb[] = { 100, 200, 250, 5 };
+    const int pocExpected[] = { 100, 200, 250, 261 };
+    for (int i = 0; i < 4; i++) {
+        au.clear();
+        bsa_test_hevc_add_slice(au, { 1, 1, true, false, 0, pocLsb[i], 0, { 0, 0 }, 0, 50 }, seed);
+        RGY_CHECK(analyzer.analyze(au.data(), (uint32_t)au.size(), info) == RGY_ERR_NONE);
+        RGY_CHECK(info.poc == pocExpected[i]);
+    }
+}
+
+//--- 処理速度 -----------------------------------------------------------------------------
+RGY_TEST(bitstream_analyzer_throughput) {
+    //大きなスライス (8 x 256KB) のAUを解析する速度と、emulation prevention byteの除去の速度を測定する
+    RGYBitstreamAnalyzer analyzer;
+    RGY_CHECK(analyzer.init(RGY_CODEC_H264) == RGY_ERR_NONE);
+    uint32_t seed = 11;
+    std::vector<uint8_t> au;
+    bsa_test_h264_header(au);
+    for (int i = 0; i < 8; i++) {
+        bsa_test_h264_add_slice(au, { 2, i == 0, 3, i * 1000, 0, { 0, 0 }, i, 0, 256 * 1024 }, seed);
+    }
+    const int loops = 50;
+    RGYBitstreamAUInfo info;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < loops; i++) {
+        RGY_CHECK(analyzer.analyze(au.data(), (uint32_t)au.size(), info) == RGY_ERR_NONE);
+    }
+    const double secAnalyze = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    RGY_CHECK(info.sliceSize.size() == 8);
+
+    std::vector<uint8_t> dst(au.size() + 16);
+    uint32_t rbspSize = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < loops; i++) {
+        rbspSize = rgy_nal_to_rbsp(dst.data(), au.data(), (uint32_t)au.size());
+    }
+    const double secRbsp = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    std::vector<uint8_t> ref;
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < loops; i++) {
+        ref = bsa_test_unescape_ref(au.data(), au.size());
+    }
+    const double secRbspRef = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    RGY_CHECK(rbspSize == ref.size() && memcmp(dst.data(), ref.data(), ref.size()) == 0);
+
+    const double mb = (double)au.size() * loops / (1024.0 * 1024.0);
+    fprintf(stdout, "  analyze: %.0f MB/s, nal_to_rbsp: %.0f MB/s (scalar reference %.0f MB/s)\n",
+        mb / (std::max)(secAnalyze, 1e-9), mb / (std::max)(secRbsp, 1e-9), mb / (std::max)(secRbspRef, 1e-9));
+}
@@ -0,0 +1,191 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include "rgy_test.h"
+#include "rgy_faw.h"
+
+static const int FAW_TEST_CHANNELS = 2;
+static const int FAW_TEST_BLOCK_BYTES = RGY_AAC_FRAME_SAMPLES * FAW_TEST_CHANNELS * sizeof(int16_t); //AACの1フレーム分のPCM
+
+//AAC-LC 48kHz 2chのADTSフレームを作成する (中身は疑似乱数)
+static std::vector<uint8_t> faw_test_adts_frame(int payloadBytes, uint32_t& seed) {
+    const int frameLength = 7 + payloadBytes;
+    std::vector<uint8_t> frame(frameLength);
+    frame[0] = 0xFF;
+    frame[1] = 0xF1; //MPEG-4, layer 0, CRCなし
+    frame[2] = (uint8_t)((1 << 6) | (3 << 2) | (FAW_TEST_CHANNELS >> 2)); //LC, 48kHz
+    frame[3] = (uint8_t)(((FAW_TEST_CHANNELS & 0x03) << 6) | (frameLength >> 11));
+    frame[4] = (uint8_t)((frameLength >> 3) & 0xFF);
+    frame[5] = (uint8_t)(((frameLength & 0x07) << 5) | 0x1F);
+    frame[6] = 0xFC;
+    for (int i = 7; i < frameLength; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        frame[i] = (uint8_t)(seed >> 24);
+    }
+    return frame;
+}
+
+//フレームごとにプリアンブルとADTSフレームを格納し、残りを無音としたバイト列 (フルサイズのPCMの中身)
+static std::vector<uint8_t> faw_test_payload(const std::vector<std::vector<uint8_t>>& frames, size_t blockBytes) {
+    std::vector<uint8_t> payload;
+    for (const auto& frame : frames) {
+        const size_t start = payload.size();
+        const int bits = (int)frame.size() * 8;
+        const uint8_t preamble[8] = { 0x72, 0xF8, 0x1F, 0x4E, 0x07, 0x00, (uint8_t)(bits & 0xFF), (uint8_t)(bits >> 8) };
+        payload.insert(payload.end(), preamble, preamble + sizeof(preamble));
+        payload.insert(payload.end(), frame.begin(), frame.end());
+        payload.resize(start + blockBytes, 0);
+    }
+    return payload;
+}
+
+static std::vector<std::vector<uint8_t>> faw_test_frames(int count) {
+    uint32_t seed = 12345;
+    std::vector<std::vector<uint8_t>> frames;
+    for (int i = 0; i < count; i++) {
+        frames.push_back(faw_test_adts_frame(200 + (i * 37) % 300, seed));
+    }
+    return frames;
+}
+
+//フルサイズ: バイト列がそのままPCM
+static std::vector<uint8_t> faw_test_full(const std::vector<std::vector<uint8_t>>& frames) {
+    return faw_test_payload(frames, FAW_TEST_BLOCK_BYTES);
+}
+
+//ハーフサイズ: 1byteずつ16bitの上位8bitに0x80をxorして格納する
+static std::vector<uint8_t> faw_test_half(const std::vector<std::vector<uint8_t>>& frames) {
+    const auto payload = faw_test_payload(frames, FAW_TEST_BLOCK_BYTES / 2);
+    std::vector<uint8_t> pcm(payload.size() * 2);
+    for (size_t i = 0; i < payload.size(); i++) {
+        pcm[i * 2 + 0] = 0;
+        pcm[i * 2 + 1] = payload[i] ^ 0x80;
+    }
+    return pcm;
+}
+
+//パケットに分割して入力し、取り出したフレームを返す
+static RGY_ERR faw_test_decode(RGYFAWDecoder& dec, std::vector<std::vector<uint8_t>>& out, const std::vector<uint8_t>& pcm, size_t packetBytes) {
+    for (size_t pos = 0; pos < pcm.size(); pos += packetBytes) {
+        const auto err = dec.decode(out, pcm.data() + pos, (std::min)(packetBytes, pcm.size() - pos));
+        if (err != RGY_ERR_NONE) {
+            return err;
+        }
+    }
+    return RGY_ERR_NONE;
+}
+
+RGY_TEST(faw_adts_header) {
+    uint32_t seed = 1;
+    const auto frame = faw_test_adts_frame(100, seed);
+    RGYAACHeader header;
+    RGY_CHECK(header.parse(frame.data(), frame.size()));
+    RGY_CHECK(header.profile == 1);
+    RGY_CHECK(header.sampleRate == 48000);
+    RGY_CHECK(header.channels() == 2);
+    RGY_CHECK(header.frameLength == 107);
+    RGY_CHECK(header.headerLength == 7);
+    RGY_CHECK(header.samples() == RGY_AAC_FRAME_SAMPLES);
+    const auto asc = header.audioSpecificConfig();
+    RGY_CHECK(asc.size() == 2 && asc[0] == 0x11 && asc[1] == 0x90); //AAC-LC 48kHz 2ch
+}
+
+RGY_TEST(faw_decode_full) {
+    const auto frames = faw_test_frames(100);
+    const auto pcm = faw_test_full(frames);
+    RGYAACHeader header;
+    RGY_CHECK(RGYFAWDecoder::detect(pcm.data(), FAW_TEST_BLOCK_BYTES * 4, &header) == RGY_FAW_FULL);
+    RGY_CHECK(header.sampleRate == 48000 && header.channels() == 2);
+    //パケットの境界がフレームやサンプルの途中にあってもよい
+    for (const size_t packetBytes : { (size_t)1001, (size_t)3840, pcm.size() }) {
+        RGYFAWDecoder dec;
+        dec.init(RGY_FAW_FULL, 0);
+        std::vector<std::vector<uint8_t>> out;
+        RGY_CHECK(faw_test_decode(dec, out, pcm, packetBytes) == RGY_ERR_NONE);
+        RGY_CHECK(out == frames);
+        RGY_CHECK(dec.skippedBytes() == 0);
+    }
+}
+
+RGY_TEST(faw_decode_half) {
+    const auto frames = faw_test_frames(100);
+    const auto pcm = faw_test_half(frames);
+    RGY_CHECK(RGYFAWDecoder::detect(pcm.data(), FAW_TEST_BLOCK_BYTES * 4, nullptr) == RGY_FAW_HALF);
+    for (const size_t packetBytes : { (size_t)1001, (size_t)3840 }) {
+        RGYFAWDecoder dec;
+        dec.init(RGY_FAW_HALF, 0);
+        std::vector<std::vector<uint8_t>> out;
+        RGY_CHECK(faw_test_decode(dec, out, pcm, packetBytes) == RGY_ERR_NONE);
+        RGY_CHECK(out == frames);
+    }
+}
+
+//16bit単位でバイトが入れ替わって格納されたフルサイズ
+RGY_TEST(faw_decode_full_swapped) {
+    const auto frames = faw_test_frames(20);
+    auto pcm = faw_test_full(frames);
+    for (size_t i = 0; i + 1 < pcm.size(); i += 2) {
+        std::swap(pcm[i], pcm[i + 1]);
+    }
+    RGYFAWDecoder dec;
+    dec.init(RGY_FAW_FULL, 0);
+    std::vector<std::vector<uint8_t>> out;
+    RGY_CHECK(faw_test_decode(dec, out, pcm, 4096) == RGY_ERR_NONE);
+    RGY_CHECK(out == frames);
+}
+
+//形式を指定しない場合は、入力から判定してから取り出す
+RGY_TEST(faw_decode_auto) {
+    const auto frames = faw_test_frames(50);
+    const auto pcm = faw_test_half(frames);
+    RGYFAWDecoder dec;
+    dec.init(RGY_FAW_NONE, 0);
+    std::vector<std::vector<uint8_t>> out;
+    RGY_CHECK(faw_test_decode(dec, out, pcm, 1920) == RGY_ERR_NONE);
+    RGY_CHECK(dec.mode() == RGY_FAW_HALF);
+    RGY_CHECK(out == frames);
+}
+
+//FAWでない音声は判定できず、一定量を超えるとエラーとなる
+RGY_TEST(faw_detect_none) {
+    std::vector<uint8_t> pcm(RGY_FAW_DETECT_MAX_BYTES + FAW_TEST_BLOCK_BYTES);
+    uint32_t seed = 7;
+    for (auto& b : pcm) {
+        seed = seed * 1664525u + 1013904223u;
+        b = (uint8_t)(seed >> 24) & 0xF7; //ADTSのsyncword(0xFFF)が現れないようにする
+    }
+    RGY_CHECK(RGYFAWDecoder::detect(pcm.data(), FAW_TEST_BLOCK_BYTES * 4, nullptr) == RGY_FAW_NONE);
+    RGYFAWDecoder dec;
+    dec.init(RGY_FAW_NONE, 0);
+    std::vector<std::vector<uint8_t>> out;
+    RGY_CHECK(faw_test_decode(dec, out, pcm, 65536) == RGY_ERR_INVALID_FORMAT);
+    RGY_CHECK(out.size() == 0);
+}
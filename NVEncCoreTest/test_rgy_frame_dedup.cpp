@@ -0,0 +1,206 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include "rgy_test.h"
+#include "rgy_frame_dedup.h"
+#include "rgy_simd.h"
+
+//比較する2平面 (bは差が小さい画素と大きい画素が混ざるよう、aに疑似乱数の差を加えたもの)
+struct DedupTestPlanes {
+    std::vector<uint8_t> a, b;
+    RGYDedupPlane planeA, planeB;
+};
+
+//shift=0なら8bit、それ以外は16bitの画素で、値は(8+shift)bitの範囲
+//P010のように上位bitに詰めた場合(shift=8)は16bitの全範囲を使用する
+static DedupTestPlanes dedup_test_planes(int width, int height, int shift, uint32_t seed) {
+    const int pixelSize = (shift) ? 2 : 1;
+    const int maxValue = (1 << (8 + shift)) - 1;
+    //右端のブロックを読む際にpitchの外を読まないことも確認できるよう、pitchは幅ちょうどにする
+    const int pitch = width * pixelSize;
+    DedupTestPlanes planes;
+    planes.a.resize((size_t)pitch * height);
+    planes.b.resize((size_t)pitch * height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            seed = seed * 1664525u + 1013904223u;
+            const int va = (int)((seed >> 8) % (uint32_t)(maxValue + 1));
+            seed = seed * 1664525u + 1013904223u;
+            int vb = 0;
+            switch ((seed >> 28) & 3) {
+            case 0:  vb = va; break;
+            case 1:  vb = (int)((seed >> 4) % (uint32_t)(maxValue + 1)); break;
+            case 2:  vb = ((seed >> 27) & 1) ? maxValue : 0; break; //飽和減算の確認用に両端の値
+            default: vb = va + (int)((seed >> 8) & 7) - 3; break;
+            }
+            vb = (std::max)(0, (std::min)(maxValue, vb));
+            if (shift) {
+                ((uint16_t *)(planes.a.data() + (size_t)pitch * y))[x] = (uint16_t)va;
+                ((uint16_t *)(planes.b.data() + (size_t)pitch * y))[x] = (uint16_t)vb;
+            } else {
+                planes.a[(size_t)pitch * y + x] = (uint8_t)va;
+                planes.b[(size_t)pitch * y + x] = (uint8_t)vb;
+            }
+        }
+    }
+    planes.planeA = { planes.a.data(), pitch, width, height };
+    planes.planeB = { planes.b.data(), pitch, width, height };
+    return planes;
+}
+
+//全ブロックについて、C版と結果が一致するかを確認する
+//ブロックの行数は1～16行(間引いた結果が奇数行・偶数行の両方)、右端のブロックは幅が1～15画素になる
+static bool dedup_test_compare(funcDedupBlockSad func, int shift) {
+    static const int SIZES[][2] = {
+        { 64, 48 }, { 67, 37 }, { 33, 18 }, { 17, 1 }, { 16, 2 }, { 31, 15 }, { 1920 + 7, 33 },
+    };
+    uint32_t seed = 100 + shift;
+    for (const auto& size : SIZES) {
+        const auto planes = dedup_test_planes(size[0], size[1], shift, seed++);
+        for (int y0 = 0; y0 < size[1]; y0 += RGY_DEDUP_BLOCK_SIZE) {
+            for (int y1 = y0 + 1; y1 <= (std::min)(y0 + RGY_DEDUP_BLOCK_SIZE, size[1]); y1++) {
+                for (int x0 = 0; x0 < size[0]; x0 += RGY_DEDUP_BLOCK_SIZE) {
+                    const int bw = (std::min)(RGY_DEDUP_BLOCK_SIZE, size[0] - x0);
+                    const uint32_t ref = dedup_block_sad_c(planes.planeA, planes.planeB, x0, bw, y0, y1, shift);
+                    const uint32_t sad = func(planes.planeA, planes.planeB, x0, bw, y0, y1, shift);
+                    if (sad != ref) {
+                        fprintf(stderr, "  shift %d, size %dx%d, block (%d, %d-%d) w%d: %u != %u (c)\n",
+                            shift, size[0], size[1], x0, y0, y1, bw, sad, ref);
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+//8bit / 9bit / 10bit / 12bit / 16bit(P010/P210)
+static const int DEDUP_TEST_SHIFT[] = { 0, 1, 2, 4, 8 };
+
+RGY_TEST(dedup_block_sad_sse2) {
+    for (auto shift : DEDUP_TEST_SHIFT) {
+        RGY_CHECK(dedup_test_compare(dedup_block_sad_sse2, shift));
+    }
+}
+
+RGY_TEST(dedup_block_sad_avx2) {
+    if (!(get_availableSIMD() & AVX2)) {
+        RGY_SKIP("AVX2 not available.");
+    }
+    for (auto shift : DEDUP_TEST_SHIFT) {
+        RGY_CHECK(dedup_test_compare(dedup_block_sad_avx2, shift));
+    }
+}
+
+//C版の値そのものの確認 (差は画素ごとにshiftしてから加算し、縦は1行おき)
+RGY_TEST(dedup_block_sad_c_value) {
+    std::vector<uint16_t> a(16 * 4, 0), b(16 * 4, 0);
+    for (int x = 0; x < 16; x++) {
+        b[x]          = 1023; //0行目: 1023>>2 = 255
+        b[16 * 1 + x] = 1023; //1行目は間引かれる
+        b[16 * 2 + x] = 3;    //2行目: 3>>2 = 0
+    }
+    const RGYDedupPlane pa = { (const uint8_t *)a.data(), 32, 16, 4 };
+    const RGYDedupPlane pb = { (const uint8_t *)b.data(), 32, 16, 4 };
+    RGY_CHECK(dedup_block_sad_c(pa, pb, 0, 16, 0, 4, 2) == 255 * 16);
+    RGY_CHECK(dedup_block_sad_c(pa, pb, 0, 16, 2, 4, 2) == 0);
+    RGY_CHECK(dedup_block_sad_c(pa, pb, 0, 16, 0, 2, 8) == 3 * 16);
+}
+
+static FrameInfo dedup_test_frame(std::vector<uint8_t>& buf, RGY_CSP csp, int width, int height, int pitch) {
+    FrameInfo frame = { 0 };
+    frame.ptr = buf.data();
+    frame.csp = csp;
+    frame.width = width;
+    frame.height = height;
+    frame.pitch = pitch;
+    return frame;
+}
+
+//輝度・色差のどちらかのブロックが閾値を超えたら重複とみなさない
+static void dedup_test_frames(RGY_CSP csp, int pixelSize, int valueShift) {
+    const int width = 120, height = 68, pitch = 128 * pixelSize;
+    std::vector<uint8_t> a((size_t)pitch * height * 3 / 2);
+    uint32_t seed = 7;
+    for (size_t i = 0; i < a.size(); i += pixelSize) {
+        seed = seed * 1664525u + 1013904223u;
+        if (pixelSize == 2) {
+            *(uint16_t *)&a[i] = (uint16_t)((seed >> 24) << valueShift);
+        } else {
+            a[i] = (uint8_t)(seed >> 24);
+        }
+    }
+    auto set = [&](std::vector<uint8_t>& buf, int plane, int x, int y, int value) {
+        uint8_t *ptr = buf.data() + (size_t)pitch * (plane ? height + y : y) + x * pixelSize;
+        if (pixelSize == 2) {
+            *(uint16_t *)ptr = (uint16_t)(value << valueShift);
+        } else {
+            *ptr = (uint8_t)value;
+        }
+    };
+    RGYFrameDedup dedup;
+    dedup.init(2.0f, 0);
+    RGY_CHECK(dedup.isDuplicate(dedup_test_frame(a, csp, width, height, pitch), dedup_test_frame(a, csp, width, height, pitch)));
+    //右下の幅の足りないブロック(x=112-119, 比較するのは2行)の1画素だけが変化: 平均は閾値以下
+    set(a, 0, 118, 66, 100);
+    auto b = a;
+    set(b, 0, 118, 66, 120);
+    RGY_CHECK(dedup.isDuplicate(dedup_test_frame(a, csp, width, height, pitch), dedup_test_frame(b, csp, width, height, pitch)));
+    //同じブロックの比較する全行が変化
+    for (int y = 64; y < height; y += 2) {
+        for (int x = 112; x < width; x++) {
+            set(b, 0, x, y, 255);
+        }
+    }
+    for (int y = 64; y < height; y += 2) {
+        for (int x = 112; x < width; x++) {
+            set(a, 0, x, y, 0);
+        }
+    }
+    RGY_CHECK(!dedup.isDuplicate(dedup_test_frame(a, csp, width, height, pitch), dedup_test_frame(b, csp, width, height, pitch)));
+    //色差のみが変化
+    b = a;
+    for (int x = 16; x < 32; x++) {
+        set(a, 1, x, 0, 0);
+        set(b, 1, x, 0, 200);
+    }
+    RGY_CHECK(!dedup.isDuplicate(dedup_test_frame(a, csp, width, height, pitch), dedup_test_frame(b, csp, width, height, pitch)));
+}
+
+RGY_TEST(dedup_is_duplicate_nv12) {
+    dedup_test_frames(RGY_CSP_NV12, 1, 0);
+}
+
+RGY_TEST(dedup_is_duplicate_p010) {
+    dedup_test_frames(RGY_CSP_P010, 2, 8);
+}
@@ -0,0 +1,140 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include "rgy_test.h"
+#include "rgy_frame_fanout.h"
+
+RGY_TEST(frame_fanout_refcount) {
+    RGYFrameFanout fanout;
+    RGY_CHECK(fanout.init(1, 2) != 0);
+    RGY_CHECK(fanout.init(2, 0) != 0);
+    RGY_CHECK(fanout.init(2, 2) == 0);
+
+    const int slot = fanout.acquire();
+    RGY_CHECK(slot >= 0);
+    fanout.publish(slot);
+    RGY_CHECK(fanout.pop(0) == slot);
+    RGY_CHECK(fanout.pop(1) == slot);
+
+    //すべての出力が解放するまでは再利用されない
+    fanout.release(slot);
+    RGY_CHECK(fanout.stats().inuse == 1);
+    const int slot2 = fanout.acquire();
+    RGY_CHECK(slot2 >= 0 && slot2 != slot);
+    fanout.release(slot);
+    RGY_CHECK(fanout.stats().inuse == 1);
+    //解放済みのスロットを重ねて解放しても参照カウントは負にならない
+    fanout.release(slot);
+    RGY_CHECK(fanout.stats().inuse == 1);
+    fanout.publish(slot2);
+
+    fanout.finish();
+    RGY_CHECK(fanout.pop(0) == slot2);
+    RGY_CHECK(fanout.pop(0) == -1);
+    RGY_CHECK(fanout.pop(1) == slot2);
+    RGY_CHECK(fanout.pop(1) == -1);
+    RGY_CHECK(fanout.stats().frames == 2);
+    RGY_CHECK(fanout.stats(0).frames == 2);
+}
+
+//遅い出力があると入力側が律速され、すべての出力に同じ順序でフレームが届く
+RGY_TEST(frame_fanout_scheduler) {
+    static const int FRAMES = 200;
+    static const int SLOTS = 3;
+    static const int OUTPUTS = 3;
+    RGYFrameFanout fanout;
+    RGY_CHECK(fanout.init(SLOTS, OUTPUTS) == 0);
+
+    std::atomic<int> slotFrame[SLOTS];
+    for (auto& f : slotFrame) {
+        f = -1;
+    }
+    int received[OUTPUTS] = { 0 };
+    bool ordered[OUTPUTS] = { 0 };
+    std::vector<std::thread> outputs;
+    for (int i = 0; i < OUTPUTS; i++) {
+        ordered[i] = true;
+        outputs.push_back(std::thread([&, i]() {
+            int slot = -1;
+            while ((slot = fanout.pop(i)) >= 0) {
+                if (slotFrame[slot] != received[i]) {
+                    ordered[i] = false;
+                }
+                received[i]++;
+                if (i == OUTPUTS - 1) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(200));
+                }
+                fanout.release(slot);
+            }
+        }));
+    }
+    int maxInuse = 0;
+    for (int i = 0; i < FRAMES; i++) {
+        const int slot = fanout.acquire();
+        if (slot < 0) {
+            break;
+        }
+        slotFrame[slot] = i;
+        fanout.publish(slot);
+        maxInuse = (std::max)(maxInuse, fanout.stats().inuse);
+    }
+    fanout.finish();
+    for (auto& th : outputs) {
+        th.join();
+    }
+    for (int i = 0; i < OUTPUTS; i++) {
+        RGY_CHECK(received[i] == FRAMES);
+        RGY_CHECK(ordered[i]);
+        RGY_CHECK(fanout.stats(i).maxQueue <= SLOTS);
+    }
+    const auto stats = fanout.stats();
+    RGY_CHECK(stats.frames == FRAMES);
+    RGY_CHECK(stats.inuse == 0);
+    RGY_CHECK(maxInuse <= SLOTS);
+    RGY_CHECK(stats.stalls > 0);
+}
+
+RGY_TEST(frame_fanout_abort) {
+    RGYFrameFanout fanout;
+    RGY_CHECK(fanout.init(2, 1) == 0);
+    fanout.publish(fanout.acquire());
+    fanout.publish(fanout.acquire());
+    //スロットが解放されないまま中断されても、入力側・出力側とも待機を抜ける
+    std::thread th([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        fanout.abort();
+    });
+    RGY_CHECK(fanout.acquire() == -1);
+    th.join();
+    RGY_CHECK(fanout.aborted());
+    RGY_CHECK(fanout.pop(0) == -1);
+}
@@ -0,0 +1,195 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include <cstring>
+#include <thread>
+#include <chrono>
+#include "rgy_test.h"
+#include "rgy_frame_shm.h"
+
+static RGYFrameShmInfo frame_shm_test_info(int width, int height) {
+    RGYFrameShmInfo info = { 0 };
+    info.width = width;
+    info.height = height;
+    info.csp = RGY_CSP_NV12;
+    info.picstruct = RGY_PICSTRUCT_FRAME;
+    info.fpsN = 30000;
+    info.fpsD = 1001;
+    info.sar[0] = info.sar[1] = 1;
+    info.frames = 0;
+    info.pitch = width;
+    info.planeOffset[0] = 0;
+    info.planeOffset[1] = width * height;
+    info.frameSize = width * height * 3 / 2;
+    return info;
+}
+
+static uint8_t frame_shm_test_pixel(int frame, uint32_t offset) {
+    return (uint8_t)(frame * 31 + offset * 7 + (offset >> 8));
+}
+
+//作成側と参照側で、フレームの内容・スロットの情報・終了の通知が受け渡されることを確認する
+RGY_TEST(frame_shm_roundtrip) {
+    const int frames = 50;
+    const auto info = frame_shm_test_info(64, 36);
+    RGYFrameShm producer;
+    const auto name = RGYFrameShm::genName(_T("RGYTestShm"));
+    RGY_CHECK(producer.create(name, info, 3) == RGY_ERR_NONE);
+    //スロット数より多くのフレームを渡し、空きスロットの待機を通過させる
+    RGYFrameShm consumer;
+    RGY_CHECK(consumer.open(name) == RGY_ERR_NONE);
+    RGY_CHECK(consumer.info()->width == info.width && consumer.info()->height == info.height);
+    RGY_CHECK(consumer.info()->csp == info.csp && consumer.info()->frameSize == info.frameSize);
+    RGY_CHECK(consumer.info()->planeOffset[1] == info.planeOffset[1]);
+    RGY_CHECK(producer.peerAlive() && consumer.peerAlive());
+
+    RGY_ERR errProducer = RGY_ERR_NONE;
+    std::thread th([&]() {
+        for (int i = 0; i < frames && errProducer == RGY_ERR_NONE; i++) {
+            RGYFrameShmSlot *slot = nullptr;
+            uint8_t *data = nullptr;
+            if ((errProducer = producer.acquireWrite(&slot, &data, 5000)) != RGY_ERR_NONE) {
+                break;
+            }
+            for (uint32_t j = 0; j < info.frameSize; j++) {
+                data[j] = frame_shm_test_pixel(i, j);
+            }
+            slot->pts = i * 2;
+            slot->duration = 2;
+            slot->picstruct = (i & 1) ? RGY_PICSTRUCT_FRAME_TFF : RGY_PICSTRUCT_FRAME;
+            slot->frameIdx = i;
+            errProducer = producer.submitWrite();
+        }
+        if (errProducer == RGY_ERR_NONE) {
+            errProducer = producer.finish(5000);
+        }
+    });
+
+    int received = 0;
+    int mismatch = 0;
+    RGY_ERR err = RGY_ERR_NONE;
+    for (;;) {
+        const RGYFrameShmSlot *slot = nullptr;
+        const uint8_t *data = nullptr;
+        if ((err = consumer.acquireRead(&slot, &data, 5000)) != RGY_ERR_NONE) {
+            break;
+        }
+        mismatch += slot->frameIdx != received || slot->pts != received * 2 || slot->duration != 2;
+        mismatch += slot->picstruct != ((received & 1) ? RGY_PICSTRUCT_FRAME_TFF : RGY_PICSTRUCT_FRAME);
+        for (uint32_t j = 0; j < info.frameSize; j++) {
+            if (data[j] != frame_shm_test_pixel(received, j)) {
+                mismatch++;
+                break;
+            }
+        }
+        received++;
+        RGY_CHECK(consumer.releaseRead() == RGY_ERR_NONE);
+    }
+    th.join();
+    RGY_CHECK(err == RGY_ERR_MORE_DATA);
+    RGY_CHECK(errProducer == RGY_ERR_NONE);
+    RGY_CHECK(received == frames);
+    RGY_CHECK(mismatch == 0);
+    //終了後の取得は、終了の通知を返し続ける
+    const RGYFrameShmSlot *slot = nullptr;
+    const uint8_t *data = nullptr;
+    RGY_CHECK(consumer.acquireRead(&slot, &data, 0) == RGY_ERR_MORE_DATA);
+}
+
+RGY_TEST(frame_shm_open_errors) {
+    const auto info = frame_shm_test_info(32, 16);
+    const auto name = RGYFrameShm::genName(_T("RGYTestShm"));
+    RGYFrameShm consumer;
+    RGY_CHECK(consumer.open(name) == RGY_ERR_NOT_FOUND);
+    RGYFrameShm producer;
+    RGY_CHECK(producer.create(name, info, 0) == RGY_ERR_INVALID_PARAM);
+    RGY_CHECK(producer.create(name, info, 2) == RGY_ERR_NONE);
+    RGYFrameShm producer2;
+    RGY_CHECK(producer2.create(name, info, 2) == RGY_ERR_ALREADY_INITIALIZED);
+    //作成側・参照側の取り違え
+    RGYFrameShmSlot *slotW = nullptr;
+    uint8_t *dataW = nullptr;
+    RGY_CHECK(consumer.open(name) == RGY_ERR_NONE);
+    RGY_CHECK(consumer.acquireWrite(&slotW, &dataW, 0) == RGY_ERR_INVALID_CALL);
+    RGY_CHECK(producer.releaseRead() == RGY_ERR_INVALID_CALL);
+    //作成側を閉じたあとは開けない
+    producer2.close();
+    consumer.close();
+    producer.close();
+    RGY_CHECK(consumer.open(name) == RGY_ERR_NOT_FOUND);
+}
+
+//参照側が開かないまま空きスロットがなくなった場合、待機を打ち切る
+RGY_TEST(frame_shm_attach_timeout) {
+    const auto info = frame_shm_test_info(32, 16);
+    RGYFrameShmSlot *slot = nullptr;
+    uint8_t *data = nullptr;
+    {
+        RGYFrameShm producer;
+        RGY_CHECK(producer.create(RGYFrameShm::genName(_T("RGYTestShm")), info, 2, 300) == RGY_ERR_NONE);
+        for (int i = 0; i < 2; i++) {
+            RGY_CHECK(producer.acquireWrite(&slot, &data, 0) == RGY_ERR_NONE);
+            RGY_CHECK(producer.submitWrite() == RGY_ERR_NONE);
+        }
+        const auto start = std::chrono::steady_clock::now();
+        RGY_CHECK(producer.acquireWrite(&slot, &data, INFINITE) == RGY_ERR_ABORTED);
+        const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        RGY_CHECK(elapsed < 5000);
+    }
+    {
+        //起動したプロセスが生きていれば、開かれていなくても待機を続ける
+        RGYFrameShm producer;
+        RGY_CHECK(producer.create(RGYFrameShm::genName(_T("RGYTestShm")), info, 1, 100) == RGY_ERR_NONE);
+        producer.setPeerProcess(rgy_frame_shm_pid());
+        RGY_CHECK(producer.acquireWrite(&slot, &data, 0) == RGY_ERR_NONE);
+        RGY_CHECK(producer.submitWrite() == RGY_ERR_NONE);
+        RGY_CHECK(producer.acquireWrite(&slot, &data, 400) == RGY_WRN_DEVICE_BUSY);
+    }
+}
+
+//参照側からの中断の通知で、作成側の待機が打ち切られる
+RGY_TEST(frame_shm_abort) {
+    const auto info = frame_shm_test_info(32, 16);
+    const auto name = RGYFrameShm::genName(_T("RGYTestShm"));
+    RGYFrameShm producer;
+    RGY_CHECK(producer.create(name, info, 1) == RGY_ERR_NONE);
+    RGYFrameShm consumer;
+    RGY_CHECK(consumer.open(name) == RGY_ERR_NONE);
+    RGYFrameShmSlot *slot = nullptr;
+    uint8_t *data = nullptr;
+    RGY_CHECK(producer.acquireWrite(&slot, &data, 0) == RGY_ERR_NONE);
+    RGY_CHECK(producer.submitWrite() == RGY_ERR_NONE);
+    std::thread th([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(150));
+        consumer.setAbort();
+    });
+    const auto err = producer.acquireWrite(&slot, &data, INFINITE);
+    th.join();
+    RGY_CHECK(err == RGY_ERR_ABORTED);
+    RGY_CHECK(producer.aborted() && consumer.aborted());
+}
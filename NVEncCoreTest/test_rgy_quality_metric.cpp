@@ -0,0 +1,303 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "rgy_test.h"
+#include "rgy_simd.h"
+#include "rgy_quality_metric.h"
+
+#if ENABLE_AVSW_READER
+
+//--- 各関数のC版との比較 ----------------------------------------------------------------
+
+//値がbitdepthの範囲の疑似乱数の画像 (16bitの場合はpitchはバイト単位)
+static std::vector<uint8_t> metric_test_image(int pitch, int height, int bitdepth, uint32_t seed) {
+    std::vector<uint8_t> buf((size_t)pitch * height);
+    if (bitdepth > 8) {
+        for (size_t i = 0; i < buf.size() / 2; i++) {
+            seed = seed * 1664525u + 1013904223u;
+            ((uint16_t *)buf.data())[i] = (uint16_t)((seed >> 8) & ((1 << bitdepth) - 1));
+        }
+    } else {
+        for (auto& v : buf) {
+            seed = seed * 1664525u + 1013904223u;
+            v = (uint8_t)(seed >> 24);
+        }
+    }
+    return buf;
+}
+
+//幅は1～70画素 (SIMDの幅の端数を含む)、開始位置は1画素ずらしてアラインされていない状態で比較する
+static bool metric_test_sse(decltype(&metric_sse8_c) func, decltype(&metric_sse8_c) ref, int bitdepth) {
+    const int bytes = (bitdepth > 8) ? 2 : 1;
+    uint32_t seed = 10 + bitdepth;
+    for (int width = 1; width <= 70; width++) {
+        for (int height = 1; height <= 5; height += 2) {
+            const int pitchA = (width + 1) * bytes + 6;
+            const int pitchB = (width + 1) * bytes + 38;
+            const auto a = metric_test_image(pitchA, height, bitdepth, seed++);
+            const auto b = metric_test_image(pitchB, height, bitdepth, seed++);
+            const uint64_t sse = func(a.data() + bytes, pitchA, b.data() + bytes, pitchB, width, height);
+            const uint64_t sseRef = ref(a.data() + bytes, pitchA, b.data() + bytes, pitchB, width, height);
+            if (sse != sseRef) {
+                fprintf(stderr, "  sse %d bit, %dx%d: %llu != %llu (c)\n", bitdepth, width, height, (unsigned long long)sse, (unsigned long long)sseRef);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+//ブロック数は1～21 (奇数個を含む)
+static bool metric_test_ssim4x4(decltype(&metric_ssim4x4_8_c) func, decltype(&metric_ssim4x4_8_c) ref, int bitdepth) {
+    const int bytes = (bitdepth > 8) ? 2 : 1;
+    uint32_t seed = 20 + bitdepth;
+    for (int blocks = 1; blocks <= 21; blocks++) {
+        const int pitchA = (blocks * 4 + 1) * bytes + 2;
+        const int pitchB = (blocks * 4 + 1) * bytes + 34;
+        const auto a = metric_test_image(pitchA, 4, bitdepth, seed++);
+        const auto b = metric_test_image(pitchB, 4, bitdepth, seed++);
+        std::vector<int32_t> sums(blocks * 4, -1), sumsRef(blocks * 4, -2);
+        func((int32_t (*)[4])sums.data(), a.data() + bytes, pitchA, b.data() + bytes, pitchB, blocks);
+        ref((int32_t (*)[4])sumsRef.data(), a.data() + bytes, pitchA, b.data() + bytes, pitchB, blocks);
+        if (sums != sumsRef) {
+            fprintf(stderr, "  ssim4x4 %d bit, %d blocks: mismatch\n", bitdepth, blocks);
+            return false;
+        }
+    }
+    return true;
+}
+
+RGY_TEST(metric_sse_avx2) {
+    if (!(get_availableSIMD() & AVX2)) {
+        RGY_SKIP("AVX2 not available.");
+    }
+    RGY_CHECK(metric_test_sse(metric_sse8_avx2, metric_sse8_c, 8));
+    RGY_CHECK(metric_test_sse(metric_sse16_avx2, metric_sse16_c, 10));
+    RGY_CHECK(metric_test_sse(metric_sse16_avx2, metric_sse16_c, RGY_METRIC_MAX_BIT_DEPTH));
+}
+
+RGY_TEST(metric_ssim4x4_avx2) {
+    if (!(get_availableSIMD() & AVX2)) {
+        RGY_SKIP("AVX2 not available.");
+    }
+    RGY_CHECK(metric_test_ssim4x4(metric_ssim4x4_8_avx2, metric_ssim4x4_8_c, 8));
+    RGY_CHECK(metric_test_ssim4x4(metric_ssim4x4_16_avx2, metric_ssim4x4_16_c, 10));
+    RGY_CHECK(metric_test_ssim4x4(metric_ssim4x4_16_avx2, metric_ssim4x4_16_c, RGY_METRIC_MAX_BIT_DEPTH));
+}
+
+//--- フレーム単位の計算 -----------------------------------------------------------------
+
+//デコーダを使用せず、calcFrameのみを呼び出す
+class MetricTestCalc : public RGYQualityMetric {
+public:
+    RGY_ERR initCalcOnly(int width, int height, RGY_CSP csp, int bitdepth, int threads) {
+        m_prm.width = width;
+        m_prm.height = height;
+        m_prm.sourceCsp = csp;
+        m_prm.chromafmt = RGY_CSP_CHROMA_FORMAT[csp];
+        m_prm.bitdepth = bitdepth;
+        m_prm.threads = threads;
+        m_pLog = std::make_shared<RGYLog>(nullptr, RGY_LOG_ERROR);
+        return initCalc();
+    }
+    int bands() const { return m_pool.threads(); }
+    RGYQualityMetricFrame calc(const RGYMetricFrame& a, const RGYMetricFrame& b) {
+        RGYQualityMetricFrame result;
+        calcFrame(result, a, b);
+        return result;
+    }
+};
+
+template<typename Type, typename Func>
+static void metric_test_fill(RGYMetricFrame& frame, int plane, Func func) {
+    for (int y = 0; y < frame.height(plane); y++) {
+        Type *ptr = (Type *)(frame.ptr(plane) + (size_t)frame.pitch(plane) * y);
+        for (int x = 0; x < frame.width(plane); x++) {
+            ptr[x] = (Type)func(x, y);
+        }
+    }
+}
+
+template<typename Type>
+static void metric_test_fill_frames(RGYMetricFrame& a, RGYMetricFrame& b, const int diff[RGY_METRIC_PLANES]) {
+    const int maxValue = (1 << a.bitdepth()) - 1;
+    uint32_t seed = 30;
+    for (int i = 0; i < a.planes(); i++) {
+        //差を加えても範囲内に収まる値にする
+        metric_test_fill<Type>(a, i, [&](int, int) {
+            seed = seed * 1664525u + 1013904223u;
+            return 8 + (int)((seed >> 8) % (uint32_t)(maxValue - 15));
+        });
+        metric_test_fill<Type>(b, i, [&](int x, int y) {
+            return ((const Type *)(a.ptr(i) + (size_t)a.pitch(i) * y))[x] + diff[i];
+        });
+    }
+}
+
+//各平面の画素すべてに一定の差を加えた場合のMSE/PSNR
+//幅・高さは奇数で、帯の境界は平面ごとに異なる
+static void metric_test_psnr(RGY_CSP csp, int bitdepth) {
+    const int width = 333, height = 271;
+    MetricTestCalc calc;
+    RGY_CHECK(calc.initCalcOnly(width, height, csp, bitdepth, 4) == RGY_ERR_NONE);
+    RGY_CHECK(calc.bands() == 4);
+    RGYMetricFrame a, b;
+    RGY_CHECK(a.alloc(width, height, RGY_CSP_CHROMA_FORMAT[csp], bitdepth) == RGY_ERR_NONE);
+    RGY_CHECK(b.alloc(width, height, RGY_CSP_CHROMA_FORMAT[csp], bitdepth) == RGY_ERR_NONE);
+    const int diff[RGY_METRIC_PLANES] = { 2, -3, 1 };
+    if (bitdepth > 8) {
+        metric_test_fill_frames<uint16_t>(a, b, diff);
+    } else {
+        metric_test_fill_frames<uint8_t>(a, b, diff);
+    }
+    const auto result = calc.calc(a, b);
+    double sse = 0.0, pixels = 0.0;
+    for (int i = 0; i < RGY_METRIC_PLANES; i++) {
+        RGY_CHECK(result.mse[i] == (double)(diff[i] * diff[i]));
+        sse += (double)(diff[i] * diff[i]) * a.width(i) * a.height(i);
+        pixels += (double)a.width(i) * a.height(i);
+    }
+    RGY_CHECK(std::abs(result.mseAll - sse / pixels) < 1e-12);
+    //輝度のPSNR: 8bitなら10*log10(255^2/4) = 42.1102dB
+    const double peak = (double)((1 << bitdepth) - 1);
+    const double psnrY = 10.0 * std::log10(peak * peak / result.mse[0]);
+    if (bitdepth == 8) {
+        RGY_CHECK(std::abs(psnrY - 42.1102) < 1e-4);
+    }
+}
+
+RGY_TEST(metric_calc_psnr_nv12) {
+    metric_test_psnr(RGY_CSP_NV12, 8);
+}
+
+RGY_TEST(metric_calc_psnr_p010) {
+    metric_test_psnr(RGY_CSP_P010, 10);
+}
+
+//x264と同じ定義の8x8の窓のSSIM (平坦な画像、または縦縞の画像では全窓で同じ値になる)
+static double metric_test_ssim_window(const double s1, const double s2, const double ss, const double s12, int bitdepth) {
+    const double peak = (double)((1 << bitdepth) - 1);
+    const double c1 = (0.01 * peak) * (0.01 * peak) * 64.0;
+    const double c2 = (0.03 * peak) * (0.03 * peak) * 64.0 * 63.0;
+    const double vars  = ss * 64.0 - s1 * s1 - s2 * s2;
+    const double covar = s12 * 64.0 - s1 * s2;
+    return (2.0 * s1 * s2 + c1) * (2.0 * covar + c2) / ((s1 * s1 + s2 * s2 + c1) * (vars + c2));
+}
+
+static void metric_test_ssim(RGY_CSP csp, int bitdepth) {
+    const int width = 333, height = 271;
+    const int scale = 1 << (bitdepth - 8);
+    MetricTestCalc calc;
+    RGY_CHECK(calc.initCalcOnly(width, height, csp, bitdepth, 4) == RGY_ERR_NONE);
+    RGYMetricFrame a, b;
+    RGY_CHECK(a.alloc(width, height, RGY_CSP_CHROMA_FORMAT[csp], bitdepth) == RGY_ERR_NONE);
+    RGY_CHECK(b.alloc(width, height, RGY_CSP_CHROMA_FORMAT[csp], bitdepth) == RGY_ERR_NONE);
+    auto fill = [&](RGYMetricFrame& frame, int plane, int v0, int v1) {
+        if (bitdepth > 8) {
+            metric_test_fill<uint16_t>(frame, plane, [&](int x, int) { return ((x & 1) ? v1 : v0) * scale; });
+        } else {
+            metric_test_fill<uint8_t>(frame, plane, [&](int x, int) { return (x & 1) ? v1 : v0; });
+        }
+    };
+    //輝度は平坦な100と110、色差は100/140の縦縞とその反転
+    fill(a, 0, 100, 100);
+    fill(b, 0, 110, 110);
+    for (int i = 1; i < RGY_METRIC_PLANES; i++) {
+        fill(a, i, 100, 140);
+        fill(b, i, 140, 100);
+    }
+    const double p = 100.0 * scale, q = 110.0 * scale, r = 140.0 * scale;
+    const double ssimY  = metric_test_ssim_window(64 * p, 64 * q, 64 * (p * p + q * q), 64 * p * q, bitdepth);
+    const double ssimUV = metric_test_ssim_window(32 * (p + r), 32 * (p + r), 64 * (p * p + r * r), 64 * p * r, bitdepth);
+    if (bitdepth == 8) {
+        RGY_CHECK(std::abs(ssimY - 0.995475) < 1e-6);
+        RGY_CHECK(std::abs(ssimUV + 0.865654) < 1e-6);
+    }
+    const auto result = calc.calc(a, b);
+    RGY_CHECK(std::abs(result.ssim[0] - ssimY) < 1e-9);
+    RGY_CHECK(std::abs(result.ssim[1] - ssimUV) < 1e-9);
+    RGY_CHECK(std::abs(result.ssim[2] - ssimUV) < 1e-9);
+    double pixels = 0.0, ssimAll = 0.0;
+    for (int i = 0; i < RGY_METRIC_PLANES; i++) {
+        ssimAll += ((i) ? ssimUV : ssimY) * a.width(i) * a.height(i);
+        pixels += (double)a.width(i) * a.height(i);
+    }
+    RGY_CHECK(std::abs(result.ssimAll - ssimAll / pixels) < 1e-9);
+    //同一の画像なら1
+    const auto same = calc.calc(a, a);
+    for (int i = 0; i < RGY_METRIC_PLANES; i++) {
+        RGY_CHECK(std::abs(same.ssim[i] - 1.0) < 1e-12);
+        RGY_CHECK(same.mse[i] == 0.0);
+    }
+}
+
+RGY_TEST(metric_calc_ssim_nv12) {
+    metric_test_ssim(RGY_CSP_NV12, 8);
+}
+
+RGY_TEST(metric_calc_ssim_p010) {
+    metric_test_ssim(RGY_CSP_P010, 10);
+}
+
+//帯の数によらず、1帯で計算した場合と同じ結果になる
+RGY_TEST(metric_calc_bands) {
+    const int width = 333, height = 271;
+    RGYMetricFrame a, b;
+    RGY_CHECK(a.alloc(width, height, RGY_CHROMAFMT_YUV420, 8) == RGY_ERR_NONE);
+    RGY_CHECK(b.alloc(width, height, RGY_CHROMAFMT_YUV420, 8) == RGY_ERR_NONE);
+    uint32_t seed = 40;
+    for (int i = 0; i < RGY_METRIC_PLANES; i++) {
+        metric_test_fill<uint8_t>(a, i, [&](int x, int y) {
+            seed = seed * 1664525u + 1013904223u;
+            return (x + y * 3 + (int)((seed >> 24) & 15)) & 255;
+        });
+        metric_test_fill<uint8_t>(b, i, [&](int x, int y) {
+            seed = seed * 1664525u + 1013904223u;
+            return (x + y * 3 + (int)((seed >> 24) & 31)) & 255;
+        });
+    }
+    MetricTestCalc calc1, calcN;
+    RGY_CHECK(calc1.initCalcOnly(width, height, RGY_CSP_NV12, 8, 1) == RGY_ERR_NONE);
+    RGY_CHECK(calcN.initCalcOnly(width, height, RGY_CSP_NV12, 8, 4) == RGY_ERR_NONE);
+    RGY_CHECK(calc1.bands() == 1 && calcN.bands() == 4);
+    const auto result1 = calc1.calc(a, b);
+    const auto resultN = calcN.calc(a, b);
+    for (int i = 0; i < RGY_METRIC_PLANES; i++) {
+        RGY_CHECK(result1.mse[i] == resultN.mse[i]);
+        RGY_CHECK(result1.mse[i] > 0.0);
+        RGY_CHECK(std::abs(result1.ssim[i] - resultN.ssim[i]) < 1e-12);
+        RGY_CHECK(result1.ssim[i] < 1.0);
+    }
+}
+
+#endif //#if ENABLE_AVSW_READER
@@ -0,0 +1,156 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include <deque>
+#include <algorithm>
+#include "rgy_test.h"
+#include "rgy_staging_ring.h"
+
+//GPUを使わずに、読み込みと転送の時間を模擬してステージングリングを動かす
+//  読み込みはperiodUsごとに1フレーム、転送は投入からlatencyUs後に、投入順に完了する
+class StagingRingSim {
+public:
+    StagingRingSim(RGYStagingRing& ring) : m_ring(ring), m_nowUs(0), m_lastEndUs(0), m_inflight(), m_order() {}
+
+    //framesフレームを読み込み、このうち空きスロットを待機したフレーム数を返す
+    int run(int frames, int64_t periodUs, int64_t latencyUs) {
+        int stalls = 0;
+        for (int i = 0; i < frames; i++) {
+            releaseUntil(m_nowUs);
+            int slot = m_ring.acquire();
+            if (slot < 0) {
+                //先頭の転送の完了まで待機する
+                stalls++;
+                const int64_t waitUs = m_inflight.front().first - m_nowUs;
+                m_ring.stall(waitUs);
+                m_nowUs += waitUs;
+                releaseUntil(m_nowUs);
+                slot = m_ring.acquire();
+                if (slot < 0) {
+                    return -1;
+                }
+            }
+            m_order.push_back(slot);
+            m_nowUs += periodUs;
+            m_ring.submit(slot, m_nowUs);
+            m_lastEndUs = (std::max)(m_lastEndUs, m_nowUs + latencyUs);
+            m_inflight.push_back(std::make_pair(m_lastEndUs, slot));
+        }
+        return stalls;
+    }
+    int64_t now() const { return m_nowUs; }
+    const std::vector<int>& order() const { return m_order; }
+protected:
+    void releaseUntil(int64_t nowUs) {
+        while (!m_inflight.empty() && m_inflight.front().first <= nowUs) {
+            m_ring.release(m_inflight.front().second, m_inflight.front().first);
+            m_inflight.pop_front();
+        }
+    }
+    RGYStagingRing& m_ring;
+    int64_t m_nowUs;
+    int64_t m_lastEndUs;
+    std::deque<std::pair<int64_t, int>> m_inflight;
+    std::vector<int> m_order;
+};
+
+RGY_TEST(staging_ring_acquire) {
+    RGYStagingRing ring;
+    ring.init(3, 4, false);
+    RGY_CHECK(ring.depth() == 3 && ring.slots() == 4);
+    RGY_CHECK(ring.acquire() == 0);
+    RGY_CHECK(ring.acquire() == 1);
+    RGY_CHECK(ring.acquire() == 2);
+    RGY_CHECK(ring.acquire() == -1); //段数を超えるスロットは使わない
+    RGY_CHECK(ring.stats().inflight == 3);
+    ring.submit(0, 100);
+    ring.release(0, 200);
+    ring.release(0, 300); //解放済みのスロットの解放は無視する
+    RGY_CHECK(ring.stats().inflight == 2);
+    RGY_CHECK(ring.stats().avgInflightUs == 100.0);
+    RGY_CHECK(ring.acquire() == 0);
+    RGY_CHECK(ring.acquire() == -1);
+}
+
+//転送の遅延が段数に収まれば待機は発生せず、スロットは順に使われる
+RGY_TEST(staging_ring_fixed_depth) {
+    RGYStagingRing ring;
+    ring.init(4, 4, false);
+    StagingRingSim sim(ring);
+    RGY_CHECK(sim.run(200, 1000, 2500) == 0);
+    RGY_CHECK(sim.now() == 200 * 1000);
+    for (size_t i = 0; i < sim.order().size(); i++) {
+        RGY_CHECK(sim.order()[i] == (int)(i % 4));
+    }
+    const auto stats = ring.stats();
+    RGY_CHECK(stats.frames == 200 && stats.stalls == 0 && stats.depth == 4);
+    RGY_CHECK(stats.avgPeriodUs == 1000.0);
+    RGY_CHECK(stats.avgInflightUs == 2500.0);
+}
+
+//段数が足りなければ、読み込みは転送の遅延に律速される
+RGY_TEST(staging_ring_fixed_depth_stall) {
+    RGYStagingRing ring;
+    ring.init(2, 2, false);
+    StagingRingSim sim(ring);
+    RGY_CHECK(sim.run(200, 1000, 5000) >= 90);
+    const auto stats = ring.stats();
+    RGY_CHECK(stats.depth == 2);
+    RGY_CHECK(stats.avgPeriodUs > 2500.0); //2スロットで(読み込み+転送)を交互に待つ
+}
+
+//自動調整では、待機が発生すると遅延を吸収できる段数まで増やし、遅延が小さくなると段数を減らす
+RGY_TEST(staging_ring_auto_tune) {
+    RGYStagingRing ring;
+    ring.init(2, RGY_STAGING_RING_DEPTH_MAX, true);
+    StagingRingSim sim(ring);
+    sim.run(1000, 1000, 5000);
+    auto stats = ring.stats();
+    RGY_CHECK(stats.depth >= 6 && stats.depth <= 8);
+    RGY_CHECK(sim.run(500, 1000, 5000) == 0);
+    const int64_t start = sim.now();
+    sim.run(100, 1000, 5000);
+    RGY_CHECK(sim.now() - start == 100 * 1000); //読み込みの速度で進む
+
+    //遅延が小さくなれば段数を減らし、その後も待機は発生しない
+    RGY_CHECK(sim.run(1000, 1000, 500) == 0);
+    stats = ring.stats();
+    RGY_CHECK(stats.depth <= 3);
+    RGY_CHECK(stats.maxDepth >= 6);
+    RGY_CHECK(sim.run(500, 1000, 500) == 0);
+}
+
+//段数の上限を超えては増やさない
+RGY_TEST(staging_ring_auto_tune_max) {
+    RGYStagingRing ring;
+    ring.init(2, 4, true);
+    StagingRingSim sim(ring);
+    RGY_CHECK(sim.run(1000, 1000, 20000) > 0);
+    const auto stats = ring.stats();
+    RGY_CHECK(stats.depth == 4 && stats.maxDepth == 4);
+}
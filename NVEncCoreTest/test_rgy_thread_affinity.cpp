@@ -0,0 +1,81 @@
+﻿// -----------------------------------------------------------------------------------------
+// QSVEnc/NVEnc by rigaya
+// -----------------------------------------------------------------------------------------
+// The MIT License
+//
+// Copyright (c) 2011-2016 rigaya
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// --------------------------------------------------------------------------------------------
+
+
+#include "rgy_test.h"
+#include "rgy_thread_affinity.h"
+
+RGY_TEST(cpu_mask_list) {
+    const auto mask = RGYCpuMask::fromList("0-7,64-71");
+    RGY_CHECK(mask.count() == 16);
+    RGY_CHECK(mask.words() == 2 && mask.word(0) == 0xff && mask.word(1) == 0xff);
+    RGY_CHECK(mask.test(64) && !mask.test(8) && !mask.test(72));
+    RGY_CHECK(mask.last() == 71);
+    RGY_CHECK(mask.to_string() == _T("0-7,64-71"));
+
+    //64個を超えるプロセッサ
+    const auto large = RGYCpuMask::fromList("0-255");
+    RGY_CHECK(large.count() == 256 && large.words() == 4 && large.word(3) == ~0ull);
+    RGY_CHECK(large.to_string() == _T("0-255"));
+}
+
+//オフラインのノードがあると番号は連続しない
+RGY_TEST(cpu_mask_list_sparse) {
+    const auto nodes = RGYCpuMask::fromList("0,2");
+    RGY_CHECK(nodes.count() == 2 && nodes.test(0) && !nodes.test(1) && nodes.test(2));
+    RGY_CHECK(nodes.to_string() == _T("0,2"));
+    RGY_CHECK(RGYCpuMask::fromList("0-1,3").count() == 3);
+    RGY_CHECK(RGYCpuMask::fromList("5").to_string() == _T("5"));
+}
+
+RGY_TEST(cpu_mask_list_invalid) {
+    RGY_CHECK(RGYCpuMask::fromList("").empty());
+    RGY_CHECK(RGYCpuMask::fromList(nullptr).empty());
+    RGY_CHECK(RGYCpuMask::fromList("abc").empty());
+    RGY_CHECK(RGYCpuMask::fromList("3-1").empty());
+    RGY_CHECK(RGYCpuMask::fromList("-1").empty());
+}
+
+RGY_TEST(cpu_mask_compare) {
+    RGY_CHECK(RGYCpuMask(0xf0).to_string() == _T("4-7"));
+    RGY_CHECK(RGYCpuMask(0xf0) == RGYCpuMask::fromList("4-7"));
+    //上位の空のワードは比較に影響しない
+    RGYCpuMask mask(0x1);
+    mask.setWord(2, 0);
+    RGY_CHECK(mask == RGYCpuMask(0x1));
+    RGY_CHECK(mask != RGYCpuMask(0x3));
+    RGY_CHECK(RGYCpuMask().empty() && RGYCpuMask().last() == -1);
+}
+
+RGY_TEST(thread_affinity_mask) {
+    RGYThreadAffinity affinity;
+    RGY_CHECK(affinity.parse(_T("main=0xf,output=numa")) == 0);
+    RGY_CHECK(affinity.getMask(RGY_THREAD_MAIN, -1) == RGYCpuMask(0xf));
+    RGY_CHECK(affinity.getMask(RGY_THREAD_OUTPUT, -1).empty()); //GPUのNUMAノードが不明なら制限しない
+    RGY_CHECK(affinity.getMask(RGY_THREAD_INPUT, 0).empty());
+    RGY_CHECK(affinity.parse(_T("main=0x0")) != 0);
+}
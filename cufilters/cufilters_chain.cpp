@@ -153,13 +153,11 @@ int cuFilterChain::init() {
         return 1;
     }
 
-    m_convert_yc48_to_yuv444_16 = get_convert_csp_func(RGY_CSP_YC48, RGY_CSP_YUV444_16, false);
-    if (m_convert_yc48_to_yuv444_16 == nullptr) {
+    if (m_convert_yc48_to_yuv444_16.getFunc(RGY_CSP_YC48, RGY_CSP_YUV444_16, false) == nullptr) {
         PrintMes(RGY_LOG_ERROR, _T("unsupported color format conversion, %s -> %s\n"), RGY_CSP_NAMES[RGY_CSP_YC48], RGY_CSP_NAMES[RGY_CSP_YUV444_16]);
         return 1;
     }
-    m_convert_yuv444_16_to_yc48 = get_convert_csp_func(RGY_CSP_YUV444_16, RGY_CSP_YC48, false);
-    if (m_convert_yuv444_16_to_yc48 == nullptr) {
+    if (m_convert_yuv444_16_to_yc48.getFunc(RGY_CSP_YUV444_16, RGY_CSP_YC48, false) == nullptr) {
         PrintMes(RGY_LOG_ERROR, _T("unsupported color format conversion, %s -> %s\n"), RGY_CSP_NAMES[RGY_CSP_YUV444_16], RGY_CSP_NAMES[RGY_CSP_YC48]);
         return 1;
     }
@@ -541,7 +539,7 @@ int cuFilterChain::proc(FrameInfo *pOutputFrame, const FrameInfo *pInputFrame, c
     ptr_array[0] = m_host[0].frame.ptr + m_host[0].frame.pitch * m_host[0].frame.height * 0;
     ptr_array[1] = m_host[0].frame.ptr + m_host[0].frame.pitch * m_host[0].frame.height * 1;
     ptr_array[2] = m_host[0].frame.ptr + m_host[0].frame.pitch * m_host[0].frame.height * 2;
-    m_convert_yc48_to_yuv444_16->func[0](
+    m_convert_yc48_to_yuv444_16.run(0,
         ptr_array, (const void **)&pInputFrame->ptr,
         pInputFrame->width, pInputFrame->pitch, pInputFrame->pitch,
         m_host[0].frame.pitch, pInputFrame->height, m_host[0].frame.height, crop);
@@ -583,7 +581,7 @@ int cuFilterChain::proc(FrameInfo *pOutputFrame, const FrameInfo *pInputFrame, c
     ptr_array[0] = m_host[1].frame.ptr + m_host[1].frame.pitch * m_host[1].frame.height * 0;
     ptr_array[1] = m_host[1].frame.ptr + m_host[1].frame.pitch * m_host[1].frame.height * 1;
     ptr_array[2] = m_host[1].frame.ptr + m_host[1].frame.pitch * m_host[1].frame.height * 2;
-    m_convert_yuv444_16_to_yc48->func[0](
+    m_convert_yuv444_16_to_yc48.run(0,
         (void **)&pOutputFrame->ptr, (const void **)ptr_array,
         m_host[1].frame.width, m_host[1].frame.pitch, m_host[1].frame.pitch,
         pOutputFrame->pitch, m_host[1].frame.height, pOutputFrame->height, crop);
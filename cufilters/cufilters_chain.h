@@ -74,8 +74,8 @@ private:
     CUFrameBuf m_dev[2];
     vector<unique_ptr<NVEncFilter>> m_vpFilters;
     shared_ptr<NVEncFilterParam>    m_pLastFilterParam;
-    const ConvertCSP *m_convert_yc48_to_yuv444_16;
-    const ConvertCSP *m_convert_yuv444_16_to_yc48;
+    RGYConvertCSP m_convert_yc48_to_yuv444_16;
+    RGYConvertCSP m_convert_yuv444_16_to_yc48;
 };
 
 